@@ -23,6 +23,7 @@
 #cmakedefine HAVE_ARPA_INET_H
 #cmakedefine HAVE_NETDB_H
 #cmakedefine HAVE_NETINET_TCP_H
+#cmakedefine HAVE_LINUX_TLS_H
 #cmakedefine HAVE_VALGRIND_H
 #cmakedefine HAVE_STDDEF_H
 #cmakedefine HAVE_STDALIGN_H
@@ -26,6 +26,7 @@
 #include <mstdlib/mstdlib.h>
 #include <mstdlib/mstdlib_formats.h>
 #include <mstdlib/mstdlib_text.h>
+#include "csv/m_csv_int.h"
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -79,7 +80,7 @@ static void M_csv_parse_count(const char *str, size_t len, char delim, char quot
 }
 
 
-static void M_csv_remove_quotes(char *str, char quote)
+void M_csv_remove_quotes(char *str, char quote)
 {
 	size_t len, i, cnt = 0;
 
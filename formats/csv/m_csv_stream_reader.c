@@ -0,0 +1,407 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2017 Monetra Technologies, LLC.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "m_config.h"
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_formats.h>
+#include "csv/m_csv_int.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define M_CSV_FAST_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define M_CSV_FAST_NEON
+#endif
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Row data is copied into row so cells can be NUL terminated and unquoted in
+ * place. Cells are tracked as offsets because row can be reallocated while the
+ * row is being read. */
+struct M_csv_reader {
+	char                   delim;
+	char                   quote;
+	M_uint32               flags;
+	M_csv_reader_row_func  row_func;
+	void                  *thunk;
+
+	char                  *row;
+	size_t                 row_len;
+	size_t                 row_size;
+	size_t                *cells;         /*!< Start of each cell in row. (size_t)-1 for an empty unquoted cell. */
+	const char           **cell_ptrs;
+	size_t                 num_cells;
+	size_t                 cells_size;
+	size_t                 cell_start;
+
+	M_bool                 on_quote;
+	M_bool                 quote_pending; /*!< On a quote and the last character was a quote. */
+	M_bool                 had_quote;
+	M_bool                 cell_cut;      /*!< An unquoted '\r' ends the cell data. */
+	M_bool                 row_has_data;
+	size_t                 num_rows;
+	M_bool                 stopped;
+};
+
+#define M_CSV_READER_CELL_NULL ((size_t)-1)
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static unsigned int M_csv_reader_ctz(unsigned int x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned int)__builtin_ctz(x);
+#else
+	unsigned int n = 0;
+
+	while (!(x & 1)) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Find the first of any of 4 characters. Returns len if none are present. */
+#if defined(M_CSV_FAST_SSE2)
+static size_t M_csv_scan(const unsigned char *p, size_t len, unsigned char c1, unsigned char c2, unsigned char c3, unsigned char c4)
+{
+	const __m128i v1 = _mm_set1_epi8((char)c1);
+	const __m128i v2 = _mm_set1_epi8((char)c2);
+	const __m128i v3 = _mm_set1_epi8((char)c3);
+	const __m128i v4 = _mm_set1_epi8((char)c4);
+	size_t        i;
+	unsigned int  mask;
+
+	for (i=0; i+16<=len; i+=16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+		__m128i m;
+
+		m    = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)),
+		                    _mm_or_si128(_mm_cmpeq_epi8(v, v3), _mm_cmpeq_epi8(v, v4)));
+		mask = (unsigned int)_mm_movemask_epi8(m);
+		if (mask != 0) {
+			return i + M_csv_reader_ctz(mask);
+		}
+	}
+
+	for (; i<len; i++) {
+		if (p[i] == c1 || p[i] == c2 || p[i] == c3 || p[i] == c4) {
+			return i;
+		}
+	}
+	return len;
+}
+#elif defined(M_CSV_FAST_NEON)
+static size_t M_csv_scan(const unsigned char *p, size_t len, unsigned char c1, unsigned char c2, unsigned char c3, unsigned char c4)
+{
+	const uint8x16_t v1 = vdupq_n_u8(c1);
+	const uint8x16_t v2 = vdupq_n_u8(c2);
+	const uint8x16_t v3 = vdupq_n_u8(c3);
+	const uint8x16_t v4 = vdupq_n_u8(c4);
+	size_t           i;
+	size_t           j;
+
+	for (i=0; i+16<=len; i+=16) {
+		uint8x16_t v = vld1q_u8(p + i);
+		uint8x16_t m;
+
+		uint64x2_t w;
+
+		m = vorrq_u8(vorrq_u8(vceqq_u8(v, v1), vceqq_u8(v, v2)),
+		             vorrq_u8(vceqq_u8(v, v3), vceqq_u8(v, v4)));
+		w = vreinterpretq_u64_u8(m);
+		/* Only look at the individual bytes when something matched. */
+		if ((vgetq_lane_u64(w, 0) | vgetq_lane_u64(w, 1)) != 0) {
+			for (j=i; ; j++) {
+				if (p[j] == c1 || p[j] == c2 || p[j] == c3 || p[j] == c4) {
+					return j;
+				}
+			}
+		}
+	}
+
+	for (; i<len; i++) {
+		if (p[i] == c1 || p[i] == c2 || p[i] == c3 || p[i] == c4) {
+			return i;
+		}
+	}
+	return len;
+}
+#else
+static size_t M_csv_scan(const unsigned char *p, size_t len, unsigned char c1, unsigned char c2, unsigned char c3, unsigned char c4)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		if (p[i] == c1 || p[i] == c2 || p[i] == c3 || p[i] == c4) {
+			return i;
+		}
+	}
+	return len;
+}
+#endif
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void M_csv_reader_add_bytes(M_csv_reader_t *reader, const char *data, size_t len)
+{
+	if (len == 0 || reader->cell_cut)
+		return;
+
+	/* Always leave room for the cell's NUL. */
+	if (reader->row_len + len + 1 > reader->row_size) {
+		reader->row_size = M_size_t_round_up_to_power_of_two(reader->row_len + len + 1);
+		reader->row      = M_realloc(reader->row, reader->row_size);
+	}
+	M_mem_copy(reader->row + reader->row_len, data, len);
+	reader->row_len += len;
+}
+
+/* Same handling of a finished cell as M_csv_parse. */
+static void M_csv_reader_end_cell(M_csv_reader_t *reader)
+{
+	char   *cell;
+	size_t  start = reader->cell_start;
+
+	if (reader->row_len + 1 > reader->row_size) {
+		reader->row_size = M_size_t_round_up_to_power_of_two(reader->row_len + 1);
+		reader->row      = M_realloc(reader->row, reader->row_size);
+	}
+	reader->row[reader->row_len++] = '\0';
+
+	cell = reader->row + start;
+	if (reader->had_quote) {
+		M_csv_remove_quotes(cell, reader->quote);
+	} else {
+		if (reader->flags & M_CSV_FLAG_TRIM_WHITESPACE) {
+			/* Trim whitespace if wasn't quoted */
+			M_str_trim(cell);
+		}
+		/* If empty string and wasn't quoted, record as NULL to differentiate */
+		if (M_str_isempty(cell)) {
+			start = M_CSV_READER_CELL_NULL;
+		}
+	}
+
+	if (reader->num_cells == reader->cells_size) {
+		reader->cells_size = reader->cells_size == 0 ? 16 : reader->cells_size * 2;
+		reader->cells      = M_realloc(reader->cells, reader->cells_size * sizeof(*reader->cells));
+		reader->cell_ptrs  = M_realloc(reader->cell_ptrs, reader->cells_size * sizeof(*reader->cell_ptrs));
+	}
+	reader->cells[reader->num_cells++] = start;
+
+	reader->cell_start = reader->row_len;
+	reader->had_quote  = M_FALSE;
+	reader->cell_cut   = M_FALSE;
+}
+
+static void M_csv_reader_end_row(M_csv_reader_t *reader)
+{
+	size_t i;
+
+	M_csv_reader_end_cell(reader);
+
+	for (i=0; i<reader->num_cells; i++) {
+		reader->cell_ptrs[i] = reader->cells[i] == M_CSV_READER_CELL_NULL ? NULL : reader->row + reader->cells[i];
+	}
+
+	if (!reader->row_func(reader->num_rows, reader->cell_ptrs, reader->num_cells, reader->thunk)) {
+		reader->stopped = M_TRUE;
+	}
+	reader->num_rows++;
+
+	reader->row_len      = 0;
+	reader->num_cells    = 0;
+	reader->cell_start   = 0;
+	reader->row_has_data = M_FALSE;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+M_csv_reader_t *M_csv_reader_create(char delim, char quote, M_uint32 flags, M_csv_reader_row_func row_func, void *thunk)
+{
+	M_csv_reader_t *reader;
+
+	if (row_func == NULL)
+		return NULL;
+
+	reader           = M_malloc_zero(sizeof(*reader));
+	reader->delim    = delim;
+	reader->quote    = quote;
+	reader->flags    = flags;
+	reader->row_func = row_func;
+	reader->thunk    = thunk;
+
+	return reader;
+}
+
+void M_csv_reader_destroy(M_csv_reader_t *reader)
+{
+	if (reader == NULL)
+		return;
+
+	M_free(reader->row);
+	M_free(reader->cells);
+	M_free(reader->cell_ptrs);
+	M_free(reader);
+}
+
+M_bool M_csv_reader_read(M_csv_reader_t *reader, const char *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	size_t               i = 0;
+	size_t               n;
+	unsigned char        c;
+
+	if (reader == NULL || (data == NULL && len != 0))
+		return M_FALSE;
+
+	while (i < len && !reader->stopped) {
+		if (reader->quote_pending) {
+			/* A doubled quote within quotes is an escaped quote. Anything
+ 			 * else means the quote closed the quoted data. */
+			reader->quote_pending = M_FALSE;
+			if (data[i] == reader->quote) {
+				M_csv_reader_add_bytes(reader, data+i, 1);
+				i++;
+				continue;
+			}
+			reader->on_quote = M_FALSE;
+		}
+
+		if (reader->on_quote) {
+			/* Everything up to the next quote is part of the cell. */
+			n = M_csv_scan(p+i, len-i, (unsigned char)reader->quote, (unsigned char)reader->quote, (unsigned char)reader->quote, (unsigned char)reader->quote);
+			if (n != len-i) {
+				n++;
+				reader->quote_pending = M_TRUE;
+			}
+			M_csv_reader_add_bytes(reader, data+i, n);
+			reader->row_has_data = M_TRUE;
+			i += n;
+			continue;
+		}
+
+		n = M_csv_scan(p+i, len-i, (unsigned char)reader->delim, (unsigned char)reader->quote, '\n', '\r');
+		if (n > 0) {
+			M_csv_reader_add_bytes(reader, data+i, n);
+			reader->row_has_data = M_TRUE;
+			i += n;
+			if (i == len) {
+				break;
+			}
+		}
+
+		c = p[i];
+		if (c == (unsigned char)reader->quote) {
+			reader->had_quote    = M_TRUE;
+			reader->on_quote     = M_TRUE;
+			reader->row_has_data = M_TRUE;
+			M_csv_reader_add_bytes(reader, data+i, 1);
+		} else if (c == (unsigned char)reader->delim) {
+			reader->row_has_data = M_TRUE;
+			M_csv_reader_end_cell(reader);
+		} else if (c == '\n') {
+			M_csv_reader_end_row(reader);
+		} else {
+			/* '\r' isn't part of the data. */
+			reader->cell_cut = M_TRUE;
+		}
+		i++;
+	}
+
+	return !reader->stopped;
+}
+
+M_bool M_csv_reader_finish(M_csv_reader_t *reader)
+{
+	if (reader == NULL)
+		return M_FALSE;
+
+	if (reader->stopped)
+		return M_FALSE;
+
+	/* The last row doesn't need to end with a new line. Quoted data that is never
+ 	 * closed runs to the end of the data. */
+	reader->quote_pending = M_FALSE;
+	reader->on_quote      = M_FALSE;
+	if (reader->row_has_data) {
+		M_csv_reader_end_row(reader);
+	}
+
+	return !reader->stopped;
+}
+
+size_t M_csv_reader_num_rows(const M_csv_reader_t *reader)
+{
+	if (reader == NULL)
+		return 0;
+	return reader->num_rows;
+}
+
+size_t M_csv_split_rows(const char *data, size_t len, char quote, size_t *offsets, size_t num_offsets)
+{
+	const unsigned char *p        = (const unsigned char *)data;
+	const unsigned char  q        = (unsigned char)quote;
+	size_t               num      = 0;
+	size_t               i        = 0;
+	size_t               target;
+	M_bool               on_quote = M_FALSE;
+
+	if (data == NULL || len == 0 || offsets == NULL || num_offsets == 0)
+		return 0;
+
+	offsets[num++] = 0;
+
+	/* Quote characters always toggle between quoted and unquoted data. An escaped
+ 	 * quote is two quotes so it doesn't change anything. Only a new line outside
+ 	 * of quotes can start a row. */
+	while (i < len && num < num_offsets) {
+		target = (len / num_offsets) * num;
+		if (on_quote) {
+			i += M_csv_scan(p+i, len-i, q, q, q, q);
+		} else if (i < target) {
+			/* Until we reach where the next piece should start only quotes matter. */
+			i += M_csv_scan(p+i, target-i, q, q, q, q);
+			if (i == target) {
+				continue;
+			}
+		} else {
+			i += M_csv_scan(p+i, len-i, q, '\n', '\n', '\n');
+		}
+		if (i >= len)
+			break;
+
+		if (p[i] == q) {
+			on_quote = on_quote ? M_FALSE : M_TRUE;
+		} else if (i+1 < len) {
+			offsets[num++] = i+1;
+		}
+		i++;
+	}
+
+	return num;
+}
@@ -271,6 +271,124 @@ const char *M_http_method_to_str(M_http_method_t method)
 	return NULL;
 }
 
+/* Names of M_http_header_id_t values. Index is the id - 1. */
+static const char * const M_http_header_names[] = {
+	"Accept",
+	"Accept-Charset",
+	"Accept-Encoding",
+	"Accept-Language",
+	"Accept-Ranges",
+	"Age",
+	"Allow",
+	"Authorization",
+	"Cache-Control",
+	"Connection",
+	"Content-Disposition",
+	"Content-Encoding",
+	"Content-Language",
+	"Content-Length",
+	"Content-Location",
+	"Content-Range",
+	"Content-Type",
+	"Cookie",
+	"Date",
+	"ETag",
+	"Expect",
+	"Expires",
+	"Forwarded",
+	"From",
+	"Host",
+	"If-Match",
+	"If-Modified-Since",
+	"If-None-Match",
+	"If-Range",
+	"If-Unmodified-Since",
+	"Keep-Alive",
+	"Last-Modified",
+	"Link",
+	"Location",
+	"Max-Forwards",
+	"Origin",
+	"Pragma",
+	"Proxy-Authenticate",
+	"Proxy-Authorization",
+	"Range",
+	"Referer",
+	"Retry-After",
+	"Server",
+	"Set-Cookie",
+	"Strict-Transport-Security",
+	"TE",
+	"Trailer",
+	"Transfer-Encoding",
+	"Upgrade",
+	"User-Agent",
+	"Vary",
+	"Via",
+	"Warning",
+	"WWW-Authenticate",
+	"X-Forwarded-For",
+	"X-Forwarded-Host",
+	"X-Forwarded-Proto",
+	"X-Requested-With",
+};
+
+/* Perfect hash of the lower case name into the index of the id. Built from the
+ * length and a few characters of each name in M_http_header_names. 0 is not
+ * a well known header. */
+static const unsigned char M_http_header_hash_ids[256] = {
+	 0, 29,  0, 20, 12,  0,  0,  0,  0,  0, 17, 16,  0,  0,  0, 48,
+	31,  0,  0,  0,  0,  0, 30,  0,  0,  0, 27,  0,  0,  0,  0, 26,
+	37,  9,  0,  0,  0,  0,  0,  0, 32,  0,  0,  0, 28,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 51,  0,  0,
+	10,  0, 52,  0,  0,  0,  0,  8,  0,  0,  0,  0, 45,  0,  0, 46,
+	 0,  0, 40,  0,  0, 11, 38,  0, 15,  0,  0,  0, 42,  0,  0,  0,
+	24,  0,  1,  0, 44,  0,  2,  0,  0,  0,  0, 33,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 58,  0,  0,
+	49,  0,  0,  0, 54,  0,  0,  0,  0,  0,  0, 53,  0,  0,  0,  0,
+	 0,  0, 22, 21,  0,  0,  7,  0,  0,  0,  0, 36, 14,  0,  0, 34,
+	 0,  0,  0,  0, 57,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0, 39,  0,  0,  0,  0,  0,  0,  0, 25,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0, 41,  0, 35,  0,  0,  0,  0,  0,
+	 0,  6,  0,  0,  0, 56,  0,  0,  0,  0,  0,  0, 55,  0,  0,  0,
+	 0,  0,  0,  4,  0,  0,  0,  0,  0,  3,  0, 47, 23,  0,  0,  5,
+	43,  0, 18,  0,  0,  0,  0,  0,  0,  0, 50, 19,  0,  0, 13,  0
+};
+
+M_http_header_id_t M_http_header_id_from_str(const char *key, size_t len)
+{
+	const char *name;
+	size_t      h;
+	size_t      id;
+
+	if (key == NULL || len < 2)
+		return M_HTTP_HEADER_UNKNOWN;
+
+	h  = len;
+	h += (size_t)(unsigned char)M_chr_tolower(key[0]) * 7;
+	h += (size_t)(unsigned char)M_chr_tolower(key[len-1]) * 10;
+	h += (size_t)(unsigned char)M_chr_tolower(key[len/2]) * 2;
+	h += (size_t)(unsigned char)M_chr_tolower(key[1]);
+
+	id = M_http_header_hash_ids[h & 0xFF];
+	if (id == 0)
+		return M_HTTP_HEADER_UNKNOWN;
+
+	/* Different names can have the same hash. */
+	name = M_http_header_names[id-1];
+	if (M_str_len(name) != len || !M_str_caseeq_max(name, key, len))
+		return M_HTTP_HEADER_UNKNOWN;
+
+	return (M_http_header_id_t)id;
+}
+
+const char *M_http_header_id_to_str(M_http_header_id_t id)
+{
+	if (id == M_HTTP_HEADER_UNKNOWN || (size_t)id > sizeof(M_http_header_names) / sizeof(*M_http_header_names))
+		return NULL;
+	return M_http_header_names[id-1];
+}
+
 const char *M_http_code_to_reason(M_uint32 code)
 {
 	switch (code) {
@@ -28,11 +28,105 @@
 #include <mstdlib/mstdlib_formats.h>
 #include "http/m_http_int.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define M_HTTP_FAST_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define M_HTTP_FAST_NEON
+#endif
+
 static size_t MAX_START_LEN    = 6*1024;
 static size_t MAX_HEADERS_SIZE = 8*1024;
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+static unsigned int M_http_reader_ctz(unsigned int x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned int)__builtin_ctz(x);
+#else
+	unsigned int n = 0;
+
+	while (!(x & 1)) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Find the first of either character. Returns len if neither is present. */
+#if defined(M_HTTP_FAST_SSE2)
+static size_t M_http_reader_scan(const unsigned char *p, size_t len, unsigned char c1, unsigned char c2)
+{
+	const __m128i v1 = _mm_set1_epi8((char)c1);
+	const __m128i v2 = _mm_set1_epi8((char)c2);
+	size_t        i;
+	unsigned int  mask;
+
+	for (i=0; i+16<=len; i+=16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+
+		mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)));
+		if (mask != 0) {
+			return i + M_http_reader_ctz(mask);
+		}
+	}
+
+	for (; i<len; i++) {
+		if (p[i] == c1 || p[i] == c2) {
+			return i;
+		}
+	}
+	return len;
+}
+#elif defined(M_HTTP_FAST_NEON)
+static size_t M_http_reader_scan(const unsigned char *p, size_t len, unsigned char c1, unsigned char c2)
+{
+	const uint8x16_t v1 = vdupq_n_u8(c1);
+	const uint8x16_t v2 = vdupq_n_u8(c2);
+	size_t           i;
+	size_t           j;
+
+	for (i=0; i+16<=len; i+=16) {
+		uint8x16_t v = vld1q_u8(p + i);
+		uint64x2_t w;
+
+		w = vreinterpretq_u64_u8(vorrq_u8(vceqq_u8(v, v1), vceqq_u8(v, v2)));
+		/* Only look at the individual bytes when something matched. */
+		if ((vgetq_lane_u64(w, 0) | vgetq_lane_u64(w, 1)) != 0) {
+			for (j=i; ; j++) {
+				if (p[j] == c1 || p[j] == c2) {
+					return j;
+				}
+			}
+		}
+	}
+
+	for (; i<len; i++) {
+		if (p[i] == c1 || p[i] == c2) {
+			return i;
+		}
+	}
+	return len;
+}
+#else
+static size_t M_http_reader_scan(const unsigned char *p, size_t len, unsigned char c1, unsigned char c2)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		if (p[i] == c1 || p[i] == c2) {
+			return i;
+		}
+	}
+	return len;
+}
+#endif
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 static M_http_error_t M_http_reader_start_func_default(M_http_message_type_t type, M_http_version_t version, M_http_method_t method, const char *uri, M_uint32 code, const char *reason, void *thunk)
 {
 	(void)type;
@@ -217,6 +311,13 @@ static M_http_error_t M_http_reader_trailer_done_func_default(void *thunk)
 	return M_HTTP_ERROR_SUCCESS;
 }
 
+static M_http_error_t M_http_reader_header_view_func_default(const M_http_header_view_t *header, void *thunk)
+{
+	(void)header;
+	(void)thunk;
+	return M_HTTP_ERROR_SUCCESS;
+}
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 static M_http_error_t M_http_read_version(M_parser_t *parser, M_http_version_t *version)
@@ -236,11 +337,12 @@ static M_http_error_t M_http_read_version(M_parser_t *parser, M_http_version_t *
 	return M_HTTP_ERROR_SUCCESS;
 }
 
-static M_http_error_t M_http_read_header_validate_kv(M_http_reader_t *httpr, const char *key, const char *val)
+static M_http_error_t M_http_read_header_validate_kv(M_http_reader_t *httpr, M_http_header_id_t id, const char *val, size_t val_len)
 {
-	M_int64 i64v;
+	char    *temp;
+	M_int64  i64v;
 
-	if (M_str_caseeq(key, "content-length")) {
+	if (id == M_HTTP_HEADER_CONTENT_LENGTH) {
 		if (httpr->have_body_len) {
 			return M_HTTP_ERROR_HEADER_DUPLICATE;
 		}
@@ -249,7 +351,7 @@ static M_http_error_t M_http_read_header_validate_kv(M_http_reader_t *httpr, con
 			httpr->have_body_len = M_FALSE;
 			httpr->body_len      = 0;
 		} else {
-			if (M_str_to_int64_ex(val, M_str_len(val), 10, &i64v, NULL) != M_STR_INT_SUCCESS) {
+			if (M_str_to_int64_ex(val, val_len, 10, &i64v, NULL) != M_STR_INT_SUCCESS) {
 				return M_HTTP_ERROR_CONTENT_LENGTH_MALFORMED;
 			}
 			if (i64v < 0) {
@@ -263,7 +365,7 @@ static M_http_error_t M_http_read_header_validate_kv(M_http_reader_t *httpr, con
 		}
 	}
 
-	if (M_str_caseeq(key, "transfer-encoding") && M_str_caseeq_start(val, "chunked")) {
+	if (id == M_HTTP_HEADER_TRANSFER_ENCODING && val_len >= 7 && M_str_caseeq_max(val, "chunked", 7)) {
 		if (httpr->data_type == M_HTTP_DATA_FORMAT_CHUNKED) {
 			return M_HTTP_ERROR_HEADER_DUPLICATE;
 		}
@@ -275,8 +377,8 @@ static M_http_error_t M_http_read_header_validate_kv(M_http_reader_t *httpr, con
 		httpr->data_type = M_HTTP_DATA_FORMAT_CHUNKED;
 	}
 
-	if (M_str_caseeq(key, "content-type")) {
-		if (M_str_caseeq_max(val, "multipart/form-data", 19)) {
+	if (id == M_HTTP_HEADER_CONTENT_TYPE && val_len != 0) {
+		if (val_len >= 19 && M_str_caseeq_max(val, "multipart/form-data", 19)) {
 			if (httpr->data_type == M_HTTP_DATA_FORMAT_MULTIPART) {
 				return M_HTTP_ERROR_HEADER_DUPLICATE;
 			}
@@ -286,27 +388,48 @@ static M_http_error_t M_http_read_header_validate_kv(M_http_reader_t *httpr, con
 			}
 		}
 
-		val = M_str_casestr(val, "boundary");
+		/* The value isn't NULL terminated. Content-Type is the only header
+		 * we need to pick apart further so copy it. */
+		temp = M_strdup_max(val, val_len);
+		val  = M_str_casestr(temp, "boundary");
 		if (val != NULL) {
 			val = M_str_chr(val, '=');
 			if (val == NULL) {
+				M_free(temp);
 				return M_HTTP_ERROR_MULTIPART_NOBOUNDARY;
 			}
 			/* Move past the '='. */
 			val++;
 			if (M_str_isempty(val) || M_str_len(val) > 70) {
+				M_free(temp);
 				return M_HTTP_ERROR_MULTIPART_NOBOUNDARY;
 			}
 			/* Mulipart boundaries are prefixed with -- to signify the start
 			 * of the given boundary. */
+			M_free(httpr->boundary);
 			M_asprintf(&httpr->boundary, "--%s", val);
 			httpr->boundary_len = M_str_len(httpr->boundary);
 		}
+		M_free(temp);
 	}
 
 	return M_HTTP_ERROR_SUCCESS;
 }
 
+/* The key and value callbacks take NULL terminated strings. Copies are only
+ * made when the user actually wants them. */
+static M_bool M_http_read_header_want_strs(M_http_reader_t *httpr)
+{
+	if (httpr->rstep == M_HTTP_READER_STEP_HEADER) {
+		return httpr->cbs.header_full_func != M_http_reader_header_full_func_default || httpr->cbs.header_func != M_http_reader_header_func_default;
+	} else if (httpr->rstep == M_HTTP_READER_STEP_TRAILER) {
+		return httpr->cbs.trailer_full_func != M_http_reader_trailer_full_func_default || httpr->cbs.trailer_func != M_http_reader_trailer_func_default;
+	} else if (httpr->rstep == M_HTTP_READER_STEP_MULTIPART_HEADER) {
+		return httpr->cbs.multipart_header_full_func != M_http_reader_multipart_header_full_func_default || httpr->cbs.multipart_header_func != M_http_reader_multipart_header_func_default;
+	}
+	return M_FALSE;
+}
+
 static M_http_error_t M_http_read_header_full_process(M_http_reader_t *httpr, const char *key, const char *val)
 {
 	M_http_error_t res = M_HTTP_ERROR_INVALIDUSE;
@@ -324,26 +447,33 @@ static M_http_error_t M_http_read_header_full_process(M_http_reader_t *httpr, co
 	return res;
 }
 
-static M_http_error_t M_http_read_header_process(M_http_reader_t *httpr, const char *key, const char *val)
+static M_http_error_t M_http_read_header_process(M_http_reader_t *httpr, M_http_header_id_t id, const char *key, const char *val, size_t val_len)
 {
-	M_http_error_t res = M_HTTP_ERROR_INVALIDUSE;
+	char           *sval;
+	M_http_error_t  res = M_HTTP_ERROR_INVALIDUSE;
 
 	/* Do some basic validating. */
 	if (httpr->rstep == M_HTTP_READER_STEP_HEADER) {
-		res = M_http_read_header_validate_kv(httpr, key, val);
+		res = M_http_read_header_validate_kv(httpr, id, val, val_len);
 		if (res != M_HTTP_ERROR_SUCCESS) {
 			return res;
 		}
 	}
 
+	/* No key means nobody wants the strings. */
+	if (key == NULL)
+		return M_HTTP_ERROR_SUCCESS;
+
 	/* Pass along the data to our callback. Key will appear for every value. */
+	sval = M_strdup_max(val, val_len);
 	if (httpr->rstep == M_HTTP_READER_STEP_HEADER) {
-		res = httpr->cbs.header_func(key, val, httpr->thunk);
+		res = httpr->cbs.header_func(key, sval, httpr->thunk);
 	} else if (httpr->rstep == M_HTTP_READER_STEP_TRAILER) {
-		res = httpr->cbs.trailer_func(key, val, httpr->thunk);
+		res = httpr->cbs.trailer_func(key, sval, httpr->thunk);
 	} else if (httpr->rstep == M_HTTP_READER_STEP_MULTIPART_HEADER) {
-		res = httpr->cbs.multipart_header_func(key, val, httpr->part_idx, httpr->thunk);
+		res = httpr->cbs.multipart_header_func(key, sval, httpr->part_idx, httpr->thunk);
 	}
+	M_free(sval);
 
 	return res;
 }
@@ -480,147 +610,172 @@ done:
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-static M_http_error_t M_http_read_header(M_http_reader_t *httpr, M_parser_t *parser, M_bool *full_read)
+static void M_http_read_header_trim(const char **s, size_t *len)
 {
-	M_parser_t      *header      = NULL;
-	M_parser_t     **kv          = NULL;
-	M_list_str_t    *subvals     = NULL;
-	char            *key         = NULL;
-	char            *val         = NULL;
-	char            *subval      = NULL;
-	size_t           num_kv      = 0;
-	size_t           num_subvals = 0;
-	size_t           i;
-	M_http_error_t   res         = M_HTTP_ERROR_SUCCESS;
-
-	*full_read = M_FALSE;
-	if (M_parser_len(parser) == 0)
-		return M_HTTP_ERROR_SUCCESS;
+	while (*len > 0 && M_chr_isspace(**s)) {
+		(*s)++;
+		(*len)--;
+	}
+	while (*len > 0 && M_chr_isspace((*s)[*len-1])) {
+		(*len)--;
+	}
+}
 
-	do {
-		/* An empty line means the end of the header. */
-		if (M_parser_compare_str(parser, "\r\n", 2, M_FALSE)) {
-			*full_read = M_TRUE;
-			M_parser_consume(parser, 2);
-			break;
+/* Find the end of the line and the separator between the key and value.
+ * Returns M_FALSE if there isn't a full line. colon will be line_len if
+ * there is no separator. */
+static M_bool M_http_read_header_find_line(const unsigned char *data, size_t len, size_t *line_len, size_t *colon)
+{
+	size_t pos        = 0;
+	size_t idx;
+	M_bool have_colon = M_FALSE;
+
+	while (pos < len) {
+		/* Once we have the separator we only care about the line ending. */
+		idx = pos + M_http_reader_scan(data + pos, len - pos, have_colon ? '\r' : ':', '\r');
+		if (idx >= len)
+			return M_FALSE;
+
+		if (data[idx] == ':') {
+			*colon     = idx;
+			have_colon = M_TRUE;
+		} else if (idx + 1 < len && data[idx + 1] == '\n') {
+			*line_len = idx;
+			if (!have_colon)
+				*colon = idx;
+			return M_TRUE;
 		}
+		pos = idx + 1;
+	}
 
-		header = M_parser_read_parser_until(parser, (const unsigned char *)"\r\n", 2, M_FALSE);
-		/* Not enough data so nothing to do. */
-		if (M_parser_len(header) == 0) {
-			break;
-		}
-		/* Eat the \r\n after the header. */
-		M_parser_consume(parser, 2);
+	return M_FALSE;
+}
 
-		httpr->header_len += M_parser_len(header);
-		if (httpr->header_len > MAX_HEADERS_SIZE) {
-			res = M_HTTP_ERROR_HEADER_LENGTH;
-			break;
-		}
+static M_http_error_t M_http_read_header_line(M_http_reader_t *httpr, const char *line, size_t line_len, size_t colon)
+{
+	M_http_header_view_t  view;
+	const char           *sub;
+	const char           *end;
+	const char           *next;
+	size_t                sub_len;
+	char                 *key     = NULL;
+	char                 *val     = NULL;
+	M_http_error_t        res     = M_HTTP_ERROR_SUCCESS;
+
+	httpr->header_len += line_len;
+	if (httpr->header_len > MAX_HEADERS_SIZE)
+		return M_HTTP_ERROR_HEADER_LENGTH;
+
+	/* Folding is deprecated and shouldn't be supported. */
+	if (M_chr_isspace(line[0]))
+		return M_HTTP_ERROR_HEADER_FOLD;
+
+	/* Validate we actually have a key. Spaces between the key and
+	 * separator (:) are _NOT_allowed. */
+	if (colon == line_len || colon == 0 || M_chr_isspace(line[colon-1]))
+		return M_HTTP_ERROR_HEADER_INVALID;
+
+	/* We support a header being sent without a value. Spaces between the
+	 * separator (:) and value are allowed and should be ignored. */
+	view.key     = line;
+	view.key_len = colon;
+	view.val     = line + colon + 1;
+	view.val_len = line_len - colon - 1;
+	M_http_read_header_trim(&view.val, &view.val_len);
+	if (view.val_len == 0)
+		view.val = NULL;
+	view.id      = M_http_header_id_from_str(view.key, view.key_len);
+
+	if (M_http_read_header_want_strs(httpr)) {
+		key = M_strdup_max(view.key, view.key_len);
+		val = M_strdup_max(view.val, view.val_len);
 
-		/* Folding is deprecated and shouldn't be supported. */
-		if (M_parser_consume_whitespace(header, M_PARSER_WHITESPACE_NONE) != 0) {
-			res = M_HTTP_ERROR_HEADER_FOLD;
-			break;
-		}
+		/* Record we saw this header. */
+		M_http_read_header_full_process(httpr, key, val);
+	}
 
-		/* Split the key from the value. */
-		kv = M_parser_split(header, ':', 2, M_PARSER_SPLIT_FLAG_NODELIM_ERROR, &num_kv);
-		if (kv == NULL || num_kv == 0) {
-			res = M_HTTP_ERROR_HEADER_INVALID;
-			break;
+	if (httpr->rstep == M_HTTP_READER_STEP_HEADER) {
+		res = httpr->cbs.header_view_func(&view, httpr->thunk);
+		if (res != M_HTTP_ERROR_SUCCESS) {
+			goto done;
 		}
+	}
+
+	/* Empty value means we don't need to process it any further.
+	 * Just inform the header was seen without a value. Some headers
+	 * can't be split because they're allowed to contain a ','. */
+	if (view.val_len == 0 || view.id == M_HTTP_HEADER_WWW_AUTHENTICATE || view.id == M_HTTP_HEADER_PROXY_AUTHORIZATION ||
+		view.id == M_HTTP_HEADER_CONTENT_TYPE || view.id == M_HTTP_HEADER_DATE)
+	{
+		res = M_http_read_header_process(httpr, view.id, key, view.val, view.val_len);
+		goto done;
+	}
 
-		/* Spaces between the key and separator (:) are _NOT_allowed. */
-		if (M_parser_truncate_whitespace(kv[0], M_PARSER_WHITESPACE_NONE) != 0) {
+	/* Values can be a separated list. We want to treat these as if
+	 * the header is appearing multiple times. */
+	sub = view.val;
+	end = view.val + view.val_len;
+	while (sub <= end) {
+		next = M_mem_chr(sub, ',', (size_t)(end - sub));
+		if (next == NULL)
+			next = end;
+
+		/* We can't have an empty entry in the value list. */
+		sub_len = (size_t)(next - sub);
+		M_http_read_header_trim(&sub, &sub_len);
+		if (sub_len == 0) {
 			res = M_HTTP_ERROR_HEADER_INVALID;
 			break;
 		}
 
-		/* Validate we actually have a key. */
-		if (M_parser_len(kv[0]) == 0) {
-			res = M_HTTP_ERROR_HEADER_INVALID;
+		res = M_http_read_header_process(httpr, view.id, key, sub, sub_len);
+		if (res != M_HTTP_ERROR_SUCCESS) {
 			break;
 		}
 
-		/* Get the key. */
-		key = M_parser_read_strdup(kv[0], M_parser_len(kv[0]));
+		sub = next + 1;
+	}
 
-		/* We support a header being sent without a value. If there is a value
- 		 * we'll pull it off. */
-		val = NULL;
-		if (num_kv == 2) {
-			/* Spaces between the separator (:) and value are allowed and should be ignored. Consume them. */
-			M_parser_consume_whitespace(kv[1], M_PARSER_WHITESPACE_NONE);
-			val = M_parser_read_strdup(kv[1], M_parser_len(kv[1]));
-			M_str_trim(val);
-		}
+done:
+	M_free(key);
+	M_free(val);
+	return res;
+}
 
-		/* Record we saw this header. */
-		M_http_read_header_full_process(httpr, key, val);
+static M_http_error_t M_http_read_header(M_http_reader_t *httpr, M_parser_t *parser, M_bool *full_read)
+{
+	const unsigned char *data;
+	size_t               len;
+	size_t               line_len  = 0;
+	size_t               colon     = 0;
+	M_http_error_t       res       = M_HTTP_ERROR_SUCCESS;
 
-		/* Empty value means we don't need to process it any further.
- 		 * Just inform the header was seen without a value. */
-		if (M_str_isempty(val)) {
-			res = M_http_read_header_process(httpr, key, val);
-			if (res != M_HTTP_ERROR_SUCCESS) {
-				break;
-			}
-			goto end_of_header;
-		}
+	*full_read = M_FALSE;
+	if (M_parser_len(parser) == 0)
+		return M_HTTP_ERROR_SUCCESS;
 
-		/* Values can be a separated list. We want to treat these as if
-		 * the header is appearing multiple times. */
-		subvals = M_http_split_header_vals(key, val);
-		if (subvals == NULL) {
-			res = M_HTTP_ERROR_HEADER_INVALID;
+	do {
+		/* An empty line means the end of the header. */
+		if (M_parser_compare_str(parser, "\r\n", 2, M_FALSE)) {
+			*full_read = M_TRUE;
+			M_parser_consume(parser, 2);
 			break;
 		}
 
-		num_subvals = M_list_str_len(subvals);
-		for (i=0; i<num_subvals; i++) {
-			subval = M_strdup(M_list_str_at(subvals, i));
-
-			/* We can't have an empty entry in the value list. */
-			M_str_trim(subval);
-			if (M_str_isempty(subval)) {
-				res = M_HTTP_ERROR_HEADER_INVALID;
-				break;
-			}
-
-			res = M_http_read_header_process(httpr, key, subval);
-			if (res != M_HTTP_ERROR_SUCCESS) {
-				break;
-			}
-
-			M_free(subval);
-			subval = NULL;
-		}
-
-		M_list_str_destroy(subvals);
-		M_free(subval);
-
-		if (res != M_HTTP_ERROR_SUCCESS) {
+		/* Headers are read directly out of the parser's buffer. Not enough
+		 * data means there is nothing to do. */
+		data = M_parser_peek(parser);
+		len  = M_parser_len(parser);
+		if (!M_http_read_header_find_line(data, len, &line_len, &colon)) {
 			break;
 		}
 
-end_of_header:
-		M_free(key);
-		M_free(val);
-		key = NULL;
-		val = NULL;
-		M_parser_split_free(kv, num_kv);
-		kv     = NULL;
-		num_kv = 0;
-		M_parser_destroy(header);
-		header = NULL;
+		res = M_http_read_header_line(httpr, (const char *)data, line_len, colon);
+
+		/* Eat the header and the \r\n after it. */
+		M_parser_consume(parser, line_len + 2);
 	} while (res == M_HTTP_ERROR_SUCCESS && !(*full_read));
 
-	M_free(key);
-	M_free(val);
-	M_parser_split_free(kv, num_kv);
-	M_parser_destroy(header);
 	return res;
 }
 
@@ -1321,6 +1476,7 @@ M_http_reader_t *M_http_reader_create(struct M_http_reader_callbacks *cbs, M_uin
 	httpr->cbs.trailer_full_func            = M_http_reader_trailer_full_func_default;
 	httpr->cbs.trailer_func                 = M_http_reader_trailer_func_default;
 	httpr->cbs.trailer_done_func            = M_http_reader_trailer_done_func_default;
+	httpr->cbs.header_view_func             = M_http_reader_header_view_func_default;
 											 
 	if (cbs != NULL) {
 		if (cbs->start_func                   != NULL) httpr->cbs.start_func                   = cbs->start_func;
@@ -1347,6 +1503,7 @@ M_http_reader_t *M_http_reader_create(struct M_http_reader_callbacks *cbs, M_uin
 		if (cbs->trailer_full_func            != NULL) httpr->cbs.trailer_full_func            = cbs->trailer_full_func;
 		if (cbs->trailer_func                 != NULL) httpr->cbs.trailer_func                 = cbs->trailer_func;
 		if (cbs->trailer_done_func            != NULL) httpr->cbs.trailer_done_func            = cbs->trailer_done_func;
+		if (cbs->header_view_func             != NULL) httpr->cbs.header_view_func             = cbs->header_view_func;
 	}
 
 	return httpr;
@@ -478,7 +478,8 @@ M_http_error_t M_http_simple_read(M_http_simple_read_t **simple, const unsigned
 		NULL, /* multipart_epilouge_done_cb */
 		NULL, /* M_http_simple_read_trailer_full_cb */
 		M_http_simple_read_trailer_cb,
-		NULL /* trailer_done_cb */
+		NULL, /* trailer_done_cb */
+		NULL  /* header_view_cb */
 	};
 
 	if (len_read == NULL)
@@ -29,6 +29,239 @@
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* Arena allocations are aligned enough for any node data and handed out from blocks
+ * that double in size up to a limit. Requests larger than a block get their own. */
+#define M_JSON_ARENA_ALIGN(x)  (((x) + 15) & ~((size_t)15))
+#define M_JSON_ARENA_BLOCK_MIN (4 * 1024)
+#define M_JSON_ARENA_BLOCK_MAX (1024 * 1024)
+
+typedef struct M_json_arena_block {
+	struct M_json_arena_block *next;
+} M_json_arena_block_t;
+
+struct M_json_arena {
+	size_t                refcount;
+	M_json_arena_block_t *blocks;
+	unsigned char        *pos;
+	size_t                left;
+	size_t                block_size;
+};
+
+M_json_arena_t *M_json_arena_create(void)
+{
+	M_json_arena_t *arena;
+
+	arena = M_malloc_zero(sizeof(*arena));
+	arena->block_size = M_JSON_ARENA_BLOCK_MIN;
+	return arena;
+}
+
+static void M_json_arena_release(M_json_arena_t *arena)
+{
+	M_json_arena_block_t *block;
+
+	if (arena == NULL)
+		return;
+
+	arena->refcount--;
+	if (arena->refcount > 0)
+		return;
+
+	while (arena->blocks != NULL) {
+		block         = arena->blocks;
+		arena->blocks = block->next;
+		M_free(block);
+	}
+	M_free(arena);
+}
+
+void *M_json_arena_alloc(M_json_arena_t *arena, size_t len)
+{
+	M_json_arena_block_t *block;
+	size_t                hdr_len = M_JSON_ARENA_ALIGN(sizeof(*block));
+	void                 *out;
+
+	len = M_JSON_ARENA_ALIGN(len);
+
+	if (len > arena->left) {
+		if (len > arena->block_size) {
+			block         = M_malloc(hdr_len + len);
+			block->next   = arena->blocks;
+			arena->blocks = block;
+			return (unsigned char *)block + hdr_len;
+		}
+
+		block         = M_malloc(hdr_len + arena->block_size);
+		block->next   = arena->blocks;
+		arena->blocks = block;
+		arena->pos    = (unsigned char *)block + hdr_len;
+		arena->left   = arena->block_size;
+		if (arena->block_size < M_JSON_ARENA_BLOCK_MAX)
+			arena->block_size *= 2;
+	}
+
+	out          = arena->pos;
+	arena->pos  += len;
+	arena->left -= len;
+	return out;
+}
+
+void M_json_node_hold_arena(M_json_node_t *node)
+{
+	if (node == NULL || node->arena == NULL || node->flags & M_JSON_NODE_FLAG_ARENA_REF)
+		return;
+
+	node->arena->refcount++;
+	node->flags |= M_JSON_NODE_FLAG_ARENA_REF;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void M_json_node_destroy_int(M_json_node_t *node);
+
+static void M_json_compact_grow(M_json_node_t *node)
+{
+	M_json_compact_t *compact = node->data.json_compact;
+	M_json_member_t  *members;
+	size_t            size;
+
+	if (compact->len < compact->size)
+		return;
+
+	/* The old members stay in the arena until it's released. */
+	size    = compact->size == 0 ? 4 : compact->size * 2;
+	members = M_json_arena_alloc(node->arena, size * sizeof(*members));
+	if (compact->len > 0)
+		M_mem_copy(members, compact->members, compact->len * sizeof(*members));
+	compact->members = members;
+	compact->size    = size;
+}
+
+static void M_json_compact_index(const M_json_node_t *node)
+{
+	M_json_compact_t *compact = node->data.json_compact;
+	size_t            i;
+
+	if (compact->index != NULL || compact->len <= M_JSON_COMPACT_INDEX_MIN)
+		return;
+
+	compact->index = M_hash_strvp_create(compact->len * 2, 75, M_HASH_STRVP_NONE, NULL);
+	for (i=0; i<compact->len; i++) {
+		M_hash_strvp_insert(compact->index, compact->members[i].key, compact->members[i].node);
+	}
+}
+
+/* Returns the position of the key in the object or the number of members if it's not present. */
+static size_t M_json_compact_find(const M_json_node_t *node, const char *key)
+{
+	const M_json_compact_t *compact = node->data.json_compact;
+	const M_json_node_t    *val;
+	size_t                  i;
+
+	M_json_compact_index(node);
+
+	if (compact->index != NULL) {
+		val = M_hash_strvp_get_direct(compact->index, key);
+		if (val == NULL)
+			return compact->len;
+		for (i=0; i<compact->len && compact->members[i].node != val; i++)
+			;
+		return i;
+	}
+
+	for (i=0; i<compact->len && !M_str_eq(compact->members[i].key, key); i++)
+		;
+	return i;
+}
+
+static M_bool M_json_compact_object_insert(M_json_node_t *node, const char *key, M_json_node_t *value)
+{
+	M_json_compact_t *compact = node->data.json_compact;
+	size_t            key_len;
+	size_t            idx;
+	char             *key_dup;
+
+	/* Same restriction the hashtable used for regular objects has. */
+	if (M_str_isempty(key))
+		return M_FALSE;
+
+	/* A repeated key replaces the value but keeps its place. */
+	idx = M_json_compact_find(node, key);
+	if (idx < compact->len) {
+		M_json_node_destroy_int(compact->members[idx].node);
+		compact->members[idx].node = value;
+		if (compact->index != NULL)
+			M_hash_strvp_insert(compact->index, key, value);
+		return M_TRUE;
+	}
+
+	key_len = M_str_len(key);
+	key_dup = M_json_arena_alloc(node->arena, key_len+1);
+	M_mem_copy(key_dup, key, key_len+1);
+
+	M_json_compact_grow(node);
+	compact->members[compact->len].key  = key_dup;
+	compact->members[compact->len].node = value;
+	compact->len++;
+	if (compact->index != NULL)
+		M_hash_strvp_insert(compact->index, key_dup, value);
+	return M_TRUE;
+}
+
+static M_bool M_json_compact_array_insert_at(M_json_node_t *node, M_json_node_t *value, size_t idx)
+{
+	M_json_compact_t *compact = node->data.json_compact;
+
+	/* Match where M_list_insert_at puts out of range values. */
+	if (idx > compact->len)
+		idx = compact->len == 0 ? 0 : compact->len-1;
+
+	M_json_compact_grow(node);
+	M_mem_move(compact->members+idx+1, compact->members+idx, (compact->len-idx) * sizeof(*compact->members));
+	compact->members[idx].key  = NULL;
+	compact->members[idx].node = value;
+	compact->len++;
+	return M_TRUE;
+}
+
+static M_bool M_json_compact_remove_node(M_json_node_t *parent_node, M_json_node_t *child_node, M_bool destroy_values)
+{
+	M_json_compact_t *compact = parent_node->data.json_compact;
+	size_t            i;
+
+	for (i=0; i<compact->len; i++) {
+		if (compact->members[i].node == child_node)
+			break;
+	}
+	if (i == compact->len)
+		return M_FALSE;
+
+	if (compact->index != NULL)
+		M_hash_strvp_remove(compact->index, compact->members[i].key, M_FALSE);
+	M_mem_move(compact->members+i, compact->members+i+1, (compact->len-i-1) * sizeof(*compact->members));
+	compact->len--;
+
+	if (destroy_values)
+		M_json_node_destroy_int(child_node);
+	return M_TRUE;
+}
+
+static void M_json_compact_clear(M_json_node_t *node)
+{
+	M_json_compact_t *compact = node->data.json_compact;
+	size_t            i;
+
+	for (i=0; i<compact->len; i++) {
+		M_json_node_destroy_int(compact->members[i].node);
+	}
+	M_hash_strvp_destroy(compact->index, M_FALSE);
+
+	node->data.json_compact  = NULL;
+	node->flags             &= ~(M_uint32)M_JSON_NODE_FLAG_COMPACT;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 static void M_json_node_clear(M_json_node_t *node)
 {
 	if (node == NULL)
@@ -36,16 +269,26 @@ static void M_json_node_clear(M_json_node_t *node)
 
 	switch (node->type) {
 		case M_JSON_TYPE_OBJECT:
+			if (node->flags & M_JSON_NODE_FLAG_COMPACT) {
+				M_json_compact_clear(node);
+				break;
+			}
 			M_hash_strvp_destroy(node->data.json_object, M_TRUE);
 			node->data.json_object = NULL;
 			break;
 		case M_JSON_TYPE_ARRAY:
+			if (node->flags & M_JSON_NODE_FLAG_COMPACT) {
+				M_json_compact_clear(node);
+				break;
+			}
 			M_list_destroy(node->data.json_array, M_TRUE);
 			node->data.json_array = NULL;
 			break;
 		case M_JSON_TYPE_STRING:
-			M_free(node->data.json_string);
-			node->data.json_string = NULL;
+			if (!(node->flags & M_JSON_NODE_FLAG_ARENA_STRING))
+				M_free(node->data.json_string);
+			node->data.json_string  = NULL;
+			node->flags            &= ~(M_uint32)M_JSON_NODE_FLAG_ARENA_STRING;
 			break;
 		case M_JSON_TYPE_INTEGER:
 			node->data.json_integer = 0;
@@ -62,11 +305,20 @@ static void M_json_node_clear(M_json_node_t *node)
 
 static void M_json_node_destroy_int(M_json_node_t *node)
 {
+	M_json_arena_t *arena = NULL;
+
 	if (node == NULL)
 		return;
 	M_json_node_clear(node);
 	node->parent = NULL;
-	M_free(node);
+
+	/* Arena nodes go away with the arena. Releasing has to be last because the node
+ 	 * itself might be the last thing in it. */
+	if (node->flags & M_JSON_NODE_FLAG_ARENA_REF)
+		arena = node->arena;
+	if (!(node->flags & M_JSON_NODE_FLAG_ARENA))
+		M_free(node);
+	M_json_arena_release(arena);
 }
 
 /*! A wrapper around node_destroy to accomidate the argument types when used with a base type. */
@@ -85,6 +337,9 @@ static M_bool M_json_object_remove_node(M_json_node_t *parent_node, M_json_node_
 	if (parent_node == NULL || parent_node->type != M_JSON_TYPE_OBJECT || child_node == NULL)
 		return M_FALSE;
 
+	if (parent_node->flags & M_JSON_NODE_FLAG_COMPACT)
+		return M_json_compact_remove_node(parent_node, child_node, destroy_values);
+
 	M_hash_strvp_enumerate(parent_node->data.json_object, &hashenum);
 	while (M_hash_strvp_enumerate_next(parent_node->data.json_object, hashenum, &key, &val)) {
 		if (child_node == (M_json_node_t *)val) {
@@ -107,6 +362,9 @@ static M_bool M_json_array_remove_node(M_json_node_t *parent_node, M_json_node_t
 	if (parent_node == NULL || parent_node->type != M_JSON_TYPE_ARRAY || child_node == NULL)
 		return M_FALSE;
 
+	if (parent_node->flags & M_JSON_NODE_FLAG_COMPACT)
+		return M_json_compact_remove_node(parent_node, child_node, destroy_values);
+
 	len = M_json_array_len(parent_node);
 	for (i=0; i<len; i++) {
 		if (child_node == M_json_array_at(parent_node, i)) {
@@ -186,6 +444,38 @@ M_json_node_t *M_json_node_create(M_json_type_t type)
 	return out;
 }
 
+M_json_node_t *M_json_node_create_arena(M_json_arena_t *arena, M_json_type_t type)
+{
+	M_json_node_t *out;
+
+	switch (type) {
+		case M_JSON_TYPE_OBJECT:
+		case M_JSON_TYPE_ARRAY:
+		case M_JSON_TYPE_STRING:
+		case M_JSON_TYPE_INTEGER:
+		case M_JSON_TYPE_DECIMAL:
+		case M_JSON_TYPE_BOOL:
+		case M_JSON_TYPE_NULL:
+			break;
+		default:
+			return NULL;
+	}
+
+	out = M_json_arena_alloc(arena, sizeof(*out));
+	M_mem_set(out, 0, sizeof(*out));
+	out->type  = type;
+	out->flags = M_JSON_NODE_FLAG_ARENA;
+	out->arena = arena;
+
+	if (type == M_JSON_TYPE_OBJECT || type == M_JSON_TYPE_ARRAY) {
+		out->data.json_compact = M_json_arena_alloc(arena, sizeof(*out->data.json_compact));
+		M_mem_set(out->data.json_compact, 0, sizeof(*out->data.json_compact));
+		out->flags |= M_JSON_NODE_FLAG_COMPACT;
+	}
+
+	return out;
+}
+
 void M_json_node_destroy(M_json_node_t *node)
 {
 	if (node == NULL)
@@ -255,6 +545,50 @@ void M_json_take_from_parent(M_json_node_t *node)
 		return;
 	M_json_node_take_or_destory(node, M_FALSE);
 	node->parent = NULL;
+
+	/* The node can outlive the rest of the tree it came from now. */
+	if (node->flags & M_JSON_NODE_FLAG_ARENA)
+		M_json_node_hold_arena(node);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void M_json_object_enumerate(const M_json_node_t *node, M_json_object_enum_t *objenum)
+{
+	M_mem_set(objenum, 0, sizeof(*objenum));
+	objenum->node = node;
+	if (!(node->flags & M_JSON_NODE_FLAG_COMPACT))
+		M_hash_strvp_enumerate(node->data.json_object, &objenum->hashenum);
+}
+
+M_bool M_json_object_enumerate_next(M_json_object_enum_t *objenum, const char **key, M_json_node_t **value)
+{
+	const M_json_compact_t *compact;
+	void                   *val;
+
+	if (objenum->node->flags & M_JSON_NODE_FLAG_COMPACT) {
+		compact = objenum->node->data.json_compact;
+		if (objenum->idx >= compact->len)
+			return M_FALSE;
+		if (key != NULL)
+			*key = compact->members[objenum->idx].key;
+		if (value != NULL)
+			*value = compact->members[objenum->idx].node;
+		objenum->idx++;
+		return M_TRUE;
+	}
+
+	if (!M_hash_strvp_enumerate_next(objenum->node->data.json_object, objenum->hashenum, key, &val))
+		return M_FALSE;
+	if (value != NULL)
+		*value = val;
+	return M_TRUE;
+}
+
+void M_json_object_enumerate_free(M_json_object_enum_t *objenum)
+{
+	M_hash_strvp_enumerate_free(objenum->hashenum);
+	objenum->hashenum = NULL;
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -263,6 +597,11 @@ M_json_node_t *M_json_object_value(const M_json_node_t *node, const char *key)
 {
 	if (node == NULL || node->type != M_JSON_TYPE_OBJECT || key == NULL)
 		return NULL;
+
+	if (node->flags & M_JSON_NODE_FLAG_COMPACT) {
+		size_t idx = M_json_compact_find(node, key);
+		return idx < node->data.json_compact->len ? node->data.json_compact->members[idx].node : NULL;
+	}
 	return M_hash_strvp_get_direct(node->data.json_object, key);
 }
 
@@ -288,19 +627,19 @@ M_bool M_json_object_value_bool(const M_json_node_t *node, const char *key)
 
 M_list_str_t *M_json_object_keys(const M_json_node_t *node)
 {
-	M_list_str_t        *keys;
-	M_hash_strvp_enum_t *hashenum;
-	const char          *key;
+	M_list_str_t         *keys;
+	M_json_object_enum_t  objenum;
+	const char           *key;
 
 	if (node == NULL || node->type != M_JSON_TYPE_OBJECT)
 		return NULL;
 
 	keys = M_list_str_create(M_LIST_STR_NONE);
-	M_hash_strvp_enumerate(node->data.json_object, &hashenum);
-	while (M_hash_strvp_enumerate_next(node->data.json_object, hashenum, &key, NULL)) {
+	M_json_object_enumerate(node, &objenum);
+	while (M_json_object_enumerate_next(&objenum, &key, NULL)) {
 		M_list_str_insert(keys, key);
 	}
-	M_hash_strvp_enumerate_free(hashenum);
+	M_json_object_enumerate_free(&objenum);
 
 	return keys;
 }
@@ -310,6 +649,8 @@ size_t M_json_object_num_children(const M_json_node_t *node)
 	if (node == NULL || node->type != M_JSON_TYPE_OBJECT)
 		return 0;
 
+	if (node->flags & M_JSON_NODE_FLAG_COMPACT)
+		return node->data.json_compact->len;
 	return M_hash_strvp_num_keys(node->data.json_object);
 }
 
@@ -318,6 +659,13 @@ M_bool M_json_object_insert(M_json_node_t *node, const char *key, M_json_node_t
 	if (node == NULL || node->type != M_JSON_TYPE_OBJECT || value == NULL || value->parent != NULL)
 		return M_FALSE;
 
+	if (node->flags & M_JSON_NODE_FLAG_COMPACT) {
+		if (!M_json_compact_object_insert(node, key, value))
+			return M_FALSE;
+		value->parent = node;
+		return M_TRUE;
+	}
+
 	if (M_hash_strvp_insert(node->data.json_object, key, (void *)value)) {
 		value->parent = node;
 		return M_TRUE;
@@ -403,6 +751,8 @@ size_t M_json_array_len(const M_json_node_t *node)
 {
 	if (node == NULL || node->type != M_JSON_TYPE_ARRAY)
 		return 0;
+	if (node->flags & M_JSON_NODE_FLAG_COMPACT)
+		return node->data.json_compact->len;
 	return M_list_len(node->data.json_array);
 }
 
@@ -413,6 +763,12 @@ M_json_node_t *M_json_array_at(const M_json_node_t *node, size_t idx)
 	if (node == NULL || node->type != M_JSON_TYPE_ARRAY)
 		return NULL;
 
+	if (node->flags & M_JSON_NODE_FLAG_COMPACT) {
+		if (idx >= node->data.json_compact->len)
+			return NULL;
+		return node->data.json_compact->members[idx].node;
+	}
+
 	value = M_list_at(node->data.json_array, idx);
 	return M_CAST_OFF_CONST(M_json_node_t *, value);
 }
@@ -442,6 +798,12 @@ M_bool M_json_array_insert(M_json_node_t *node, M_json_node_t *value)
 	if (node == NULL || node->type != M_JSON_TYPE_ARRAY || value == NULL || value->parent != NULL)
 		return M_FALSE;
 
+	if (node->flags & M_JSON_NODE_FLAG_COMPACT) {
+		M_json_compact_array_insert_at(node, value, node->data.json_compact->len);
+		value->parent = node;
+		return M_TRUE;
+	}
+
 	if (M_list_insert(node->data.json_array, value)) {
 		value->parent = node;
 		return M_TRUE;
@@ -526,6 +888,12 @@ M_bool M_json_array_insert_at(M_json_node_t *node, M_json_node_t *value, size_t
 	if (node == NULL || node->type != M_JSON_TYPE_ARRAY || value == NULL || value->parent != NULL)
 		return M_FALSE;
 
+	if (node->flags & M_JSON_NODE_FLAG_COMPACT) {
+		M_json_compact_array_insert_at(node, value, idx);
+		value->parent = node;
+		return M_TRUE;
+	}
+
 	if (M_list_insert_at(node->data.json_array, value, idx)) {
 		value->parent = node;
 		return M_TRUE;
@@ -33,23 +33,98 @@
 
 __BEGIN_DECLS
 
+typedef struct M_json_arena M_json_arena_t;
+
+/*! Flags describing how a node and its data are stored. */
+enum {
+	M_JSON_NODE_FLAG_NONE         = 0,
+	M_JSON_NODE_FLAG_ARENA        = 1 << 0, /*!< Node was allocated from the arena and isn't freed on its own. */
+	M_JSON_NODE_FLAG_ARENA_REF    = 1 << 1, /*!< Node holds a reference on the arena. The tree root and nodes
+	                                             taken out of an arena tree. */
+	M_JSON_NODE_FLAG_COMPACT      = 1 << 2, /*!< Object or array data is json_compact. */
+	M_JSON_NODE_FLAG_ARENA_STRING = 1 << 3  /*!< String was allocated from the arena and isn't freed on its own. */
+};
+
+/*! Member of a compact object or array. */
+typedef struct {
+	const char    *key;  /*!< Object key, allocated from the arena. NULL for arrays. */
+	M_json_node_t *node;
+} M_json_member_t;
+
+/*! Object or array read with M_JSON_READER_COMPACT. Members are kept in order in an
+ * array allocated from the arena. Objects are searched linearly until they have more than
+ * M_JSON_COMPACT_INDEX_MIN members, then a key index is built the first time one is
+ * looked up and kept up to date from then on. */
+typedef struct {
+	M_json_member_t *members;
+	size_t           len;
+	size_t           size;
+	M_hash_strvp_t  *index;   /*!< Key to node. */
+} M_json_compact_t;
+
+#define M_JSON_COMPACT_INDEX_MIN 8
+
 /*! JSON node. Represents multiple types of nodes. */
 struct M_json_node {
-	M_json_type_t  type;
-	M_json_node_t *parent;
+	M_json_type_t   type;
+	M_uint32        flags;    /*!< M_JSON_NODE_FLAG_*. */
+	M_json_node_t  *parent;
+	M_json_arena_t *arena;    /*!< Arena the node or its data came from. NULL when nothing does. */
 	/* The data for the various node types.
  	 * There is no data object for the NULL node type becuase it represents
 	 * null and does not need to store a value. */
 	union {
-		M_hash_strvp_t *json_object;  /*!< Object data (hashtable of other nodes). */
-		M_list_t       *json_array;   /*!< List of nodes. */
-		char           *json_string;  /*!< String. */
-		M_int64         json_integer; /*!< Integer. */
-		M_decimal_t     json_decimal; /*!< Decimal. */
-		M_bool          json_bool;    /*!< Bool. */
+		M_hash_strvp_t   *json_object;  /*!< Object data (hashtable of other nodes). */
+		M_list_t         *json_array;   /*!< List of nodes. */
+		M_json_compact_t *json_compact; /*!< Object or array data when M_JSON_NODE_FLAG_COMPACT is set. */
+		char             *json_string;  /*!< String. */
+		M_int64           json_integer; /*!< Integer. */
+		M_decimal_t       json_decimal; /*!< Decimal. */
+		M_bool            json_bool;    /*!< Bool. */
 	} data;
 };
 
+/*! Object member enumeration that works with both object representations. */
+typedef struct {
+	const M_json_node_t *node;
+	M_hash_strvp_enum_t *hashenum;
+	size_t               idx;
+} M_json_object_enum_t;
+
+void M_json_object_enumerate(const M_json_node_t *node, M_json_object_enum_t *objenum);
+M_bool M_json_object_enumerate_next(M_json_object_enum_t *objenum, const char **key, M_json_node_t **value);
+void M_json_object_enumerate_free(M_json_object_enum_t *objenum);
+
+/* Arena used by M_JSON_READER_COMPACT. The arena is created without any references and
+ * is freed when the last node holding one releases it. */
+M_json_arena_t *M_json_arena_create(void);
+void *M_json_arena_alloc(M_json_arena_t *arena, size_t len);
+M_json_node_t *M_json_node_create_arena(M_json_arena_t *arena, M_json_type_t type);
+void M_json_node_hold_arena(M_json_node_t *node);
+
+/* Location of a value inside of an open object or array. Used by M_json_reader_t to
+ * match values against a compiled JSONPath before the whole document has been read. */
+typedef struct {
+	M_json_type_t  type; /* M_JSON_TYPE_OBJECT or M_JSON_TYPE_ARRAY. */
+	char          *key;  /* Object: key of the current member. */
+	M_uint64       idx;  /* Array: offset of the current element. */
+} M_json_jsonpath_step_t;
+
+/* Offsets counting from the end of an array and negative steps need the length of the
+ * array, which isn't known while streaming. A trailing ".." can never match and is
+ * rejected as well. */
+M_bool M_json_jsonpath_streamable(const M_json_jsonpath_t *jsonpath);
+/* Whether the value reached through steps would be matched by M_json_jsonpath_foreach. */
+M_bool M_json_jsonpath_match_location(const M_json_jsonpath_t *jsonpath, const M_json_jsonpath_step_t *steps, size_t num_steps);
+
+/* Shared by M_json_write and M_json_writer_t. */
+void M_json_write_depth(M_buf_t *buf, size_t *depth, M_uint32 flags);
+void M_json_write_newline(M_buf_t *buf, M_uint32 flags);
+M_bool M_json_write_string(M_buf_t *buf, const char *s, M_uint32 flags);
+void M_json_write_integer(M_buf_t *buf, M_int64 val, M_uint32 flags);
+M_bool M_json_write_decimal(M_buf_t *buf, const M_decimal_t *val, M_uint32 flags);
+M_bool M_json_write_node(const M_json_node_t *node, M_buf_t *buf, size_t *depth, M_uint32 flags);
+
 __END_DECLS
 
 #endif /* __M_JSON_INT_H__ */
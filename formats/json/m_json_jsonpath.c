@@ -29,17 +29,58 @@
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-/*! Turn a string into an index. This will adjust negative numbers to count from the end of the array.
+typedef enum {
+	M_JSON_JSONPATH_SEG_RECURSIVE = 0, /* Blank segment, "..". */
+	M_JSON_JSONPATH_SEG_KEY,           /* Object key or "*". */
+	M_JSON_JSONPATH_SEG_INDEX_ALL,     /* "[*]". */
+	M_JSON_JSONPATH_SEG_INDEX          /* "[...]" offsets and slices. */
+} M_json_jsonpath_seg_type_t;
+
+/* One ',' separated part of an index segment. Values are stored as written
+ * because negative offsets can only be resolved against a given array. */
+typedef struct {
+	M_bool  is_slice;
+	M_bool  has_start;
+	M_int32 start;
+	M_bool  has_end;
+	M_int32 end;
+	M_int32 step;
+} M_json_jsonpath_idx_t;
+
+typedef struct {
+	M_json_jsonpath_seg_type_t  type;
+	char                       *key;       /* NULL when matching any key. */
+	M_json_jsonpath_idx_t      *idx;
+	size_t                      num_idx;
+	M_bool                      idx_valid; /* An exact index that isn't a number invalidates the whole segment. */
+} M_json_jsonpath_seg_t;
+
+struct M_json_jsonpath {
+	M_json_jsonpath_seg_t *segs;
+	size_t                 num_segs;
+};
+
+typedef struct {
+	const M_json_jsonpath_t    *jsonpath;
+	M_json_jsonpath_match_func  match_func;
+	void                       *thunk;
+	size_t                      num_matches;
+	M_bool                      stop;
+} M_json_jsonpath_ctx_t;
+
+typedef struct {
+	M_json_node_t **matches;
+	size_t          num_matches;
+} M_json_jsonpath_matches_t;
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/*! Adjust an index to count from the end of the array when negative.
  * On success out will never be < 0. Out can be >= array_len.
  */
-static M_bool M_json_jsonpath_search_array_offset_val(const char *val, size_t val_len, size_t array_len, M_uint32 *out)
+static M_bool M_json_jsonpath_search_array_offset_val(M_int32 offset, size_t array_len, M_uint32 *out)
 {
-	M_int32 offset;
-
 	*out = 0;
-	if (M_str_to_int32_ex(val, val_len, 10, &offset, NULL) != M_STR_INT_SUCCESS) {
-		return M_FALSE;
-	}
 
 	if (offset < 0) {
 		if ((M_int32)array_len + offset < 0) {
@@ -53,45 +94,38 @@ static M_bool M_json_jsonpath_search_array_offset_val(const char *val, size_t va
 	return M_TRUE;
 }
 
-static M_list_u64_t *M_json_jsonpath_search_array_offsets(const M_json_node_t *node, const char *segment)
+static void M_json_jsonpath_compile_idx(M_json_jsonpath_seg_t *seg, const char *segment)
 {
-	M_list_u64_t  *offsets;
-	size_t         seg_len;
-	size_t         array_len;
-	char         **comma_parts      = NULL;
-	size_t        *comma_parts_lens = NULL;
-	size_t         comma_num_parts  = 0;
-	char         **slice_parts      = NULL;
-	size_t        *slice_parts_lens = NULL;
-	size_t         slice_num_parts  = 0;
-	size_t         i;
-	M_int64        j;
-	M_uint32       slice_start;
-	M_uint32       slice_end;
-	M_int32        slice_step;
-
-	if (M_json_node_type(node) != M_JSON_TYPE_ARRAY)
-		return NULL;
-
-	array_len = M_json_array_len(node);
-	seg_len   = M_str_len(segment);
-
-	/* If we don't have any items in this node there is nothing to index. Or if there isn't any data between
- 	 * '[' and ']' then we don't have an offset to index. */
-	if (array_len == 0 || seg_len < 3)
-		return NULL;
-
-	/* The list is not sorted so we can have duplicates and out of order results can be returned, "[2,1]" */
-	offsets = M_list_u64_create(M_LIST_U64_NONE);
+	M_json_jsonpath_idx_t   idx;
+	size_t                  seg_len;
+	char                  **comma_parts      = NULL;
+	size_t                 *comma_parts_lens = NULL;
+	size_t                  comma_num_parts  = 0;
+	char                  **slice_parts      = NULL;
+	size_t                 *slice_parts_lens = NULL;
+	size_t                  slice_num_parts  = 0;
+	size_t                  i;
+
+	seg->idx_valid = M_FALSE;
+
+	/* If there isn't any data between '[' and ']' then we don't have an offset to index. */
+	seg_len = M_str_len(segment);
+	if (seg_len < 3)
+		return;
 
 	/* We're going to first explode on ',' and go though each of our indexes. If there isn't a ',' then
  	 * the first and only element expoded with be the value we want to deal with. */
 	comma_parts = M_str_explode(',', segment+1, seg_len-2, &comma_num_parts, &comma_parts_lens);
 	if (comma_parts == NULL || comma_num_parts == 0)
-		goto error;
+		goto done;
+
+	seg->idx = M_malloc_zero(comma_num_parts * sizeof(*seg->idx));
 
-	/* Go thoguh each of the elements we expoded with ',' */
+	/* Go thoguh each of the elements we expoded with ','. Parts that can never produce an
+ 	 * index are dropped here. */
 	for (i=0; i<comma_num_parts; i++) {
+		M_mem_set(&idx, 0, sizeof(idx));
+
 		/* we're going to explode on ':' and look for slices. If this isn't a slice and we have a single index
  		 * the value will be the first and only element exploded. */
 		slice_parts = M_str_explode(':', comma_parts[i], comma_parts_lens[i], &slice_num_parts, &slice_parts_lens);
@@ -99,85 +133,126 @@ static M_list_u64_t *M_json_jsonpath_search_array_offsets(const M_json_node_t *n
 			goto slice_done;
 		}
 
-		/* If we have a slice we're going to set some defaults. It's allowed to omit the start, end and step. */
-		slice_start = 0;
-		slice_end   = (M_uint32)array_len;
-		slice_step  = 1;
-
-		/* If we have 2 or more parts we have a slice. */
+		/* If we have 2 or more parts we have a slice. It's allowed to omit the start, end and step. */
 		if (slice_num_parts == 2 || slice_num_parts == 3) {
+			idx.is_slice = M_TRUE;
+			idx.step     = 1;
+
 			/* Start. */
 			if (slice_parts_lens[0] > 0) {
-				if (!M_json_jsonpath_search_array_offset_val(slice_parts[0], slice_parts_lens[0], array_len, &slice_start)) {
+				if (M_str_to_int32_ex(slice_parts[0], slice_parts_lens[0], 10, &idx.start, NULL) != M_STR_INT_SUCCESS) {
 					goto slice_done;
 				}
+				idx.has_start = M_TRUE;
 			}
 			/* End. */
 			if (slice_parts_lens[1] > 0) {
-				if (!M_json_jsonpath_search_array_offset_val(slice_parts[1], slice_parts_lens[1], array_len, &slice_end)) {
+				if (M_str_to_int32_ex(slice_parts[1], slice_parts_lens[1], 10, &idx.end, NULL) != M_STR_INT_SUCCESS) {
 					goto slice_done;
 				}
+				idx.has_end = M_TRUE;
 			}
 			/* Step. */
 			if (slice_num_parts == 3 && slice_parts_lens[2] > 0) {
-				if (M_str_to_int32_ex(slice_parts[2], slice_parts_lens[2], 10, &slice_step, NULL) != M_STR_INT_SUCCESS || slice_step == 0) {
+				if (M_str_to_int32_ex(slice_parts[2], slice_parts_lens[2], 10, &idx.step, NULL) != M_STR_INT_SUCCESS || idx.step == 0) {
 					goto slice_done;
 				}
 			}
-
-			/* Cases where we won't calculate anything. */
-			if ((slice_start == slice_end) ||
-				(slice_start > slice_end && slice_step > 0) ||
-				(slice_start < slice_end && slice_step < 0))
-			{
-				goto slice_done;
-			}
-
-			/* Determine the values for each index we want to look at. */
-			if (slice_start < slice_end) {
-				/* Count up. */
-				for (j=slice_start; j<slice_end; j+=slice_step) {
-					if (j >= 0 && j < (M_int64)array_len) {
-						M_list_u64_insert(offsets, (M_uint64)j);
-					}
-				}
-			} else {
-				/* Count down. */
-				for (j=slice_start-1; j>=slice_end; j+=slice_step) {
-					if (j >= 0 && j < (M_int64)array_len) {
-						M_list_u64_insert(offsets, (M_uint64)j);
-					}
-				}
-			}
 		} else {
 			/* 1 exact index. */
-			if (!M_json_jsonpath_search_array_offset_val(slice_parts[0], slice_parts_lens[0], array_len, &slice_start)) {
-				goto error;
-			}
-			/* Check that we have a valid index. */
-			if (slice_start < array_len) {
-				M_list_u64_insert(offsets, slice_start);
+			if (M_str_to_int32_ex(slice_parts[0], slice_parts_lens[0], 10, &idx.start, NULL) != M_STR_INT_SUCCESS) {
+				M_str_explode_free(slice_parts, slice_num_parts);
+				M_free(slice_parts_lens);
+				goto done;
 			}
 		}
 
+		seg->idx[seg->num_idx++] = idx;
+
 slice_done:
 		M_str_explode_free(slice_parts, slice_num_parts);
 		M_free(slice_parts_lens);
 	}
 
+	seg->idx_valid = M_TRUE;
+
+done:
 	M_str_explode_free(comma_parts, comma_num_parts);
 	M_free(comma_parts_lens);
+}
 
-	return offsets;
+static void M_json_jsonpath_search(const M_json_node_t *node, M_json_jsonpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive);
 
-error:
-	M_str_explode_free(slice_parts, slice_num_parts);
-	M_free(slice_parts_lens);
-	M_str_explode_free(comma_parts, comma_num_parts);
-	M_free(comma_parts_lens);
-	M_list_u64_destroy(offsets);
-	return NULL;
+static void M_json_jsonpath_search_array_offsets(const M_json_node_t *node, const M_json_jsonpath_seg_t *seg, M_json_jsonpath_ctx_t *ctx, size_t seg_offset)
+{
+	const M_json_jsonpath_idx_t *idx;
+	size_t                       array_len;
+	size_t                       i;
+	M_int64                      j;
+	M_uint32                     slice_start;
+	M_uint32                     slice_end;
+	M_int32                      slice_step;
+
+	array_len = M_json_array_len(node);
+
+	/* If we don't have any items in this node there is nothing to index. */
+	if (!seg->idx_valid || array_len == 0)
+		return;
+
+	/* An exact index before the end of the array invalidates the whole expression for this array so we
+ 	 * need to check them all before visiting anything. */
+	for (i=0; i<seg->num_idx; i++) {
+		if (!seg->idx[i].is_slice && !M_json_jsonpath_search_array_offset_val(seg->idx[i].start, array_len, &slice_start)) {
+			return;
+		}
+	}
+
+	/* Offsets are visited in the order given so we can have duplicates and out of order results, "[2,1]" */
+	for (i=0; i<seg->num_idx && !ctx->stop; i++) {
+		idx = &seg->idx[i];
 
+		if (!idx->is_slice) {
+			M_json_jsonpath_search_array_offset_val(idx->start, array_len, &slice_start);
+			/* Check that we have a valid index. */
+			if (slice_start < array_len) {
+				M_json_jsonpath_search(M_json_array_at(node, slice_start), ctx, seg_offset+1, M_FALSE);
+			}
+			continue;
+		}
+
+		slice_start = 0;
+		slice_end   = (M_uint32)array_len;
+		slice_step  = idx->step;
+		if (idx->has_start && !M_json_jsonpath_search_array_offset_val(idx->start, array_len, &slice_start))
+			continue;
+		if (idx->has_end && !M_json_jsonpath_search_array_offset_val(idx->end, array_len, &slice_end))
+			continue;
+
+		/* Cases where we won't calculate anything. */
+		if ((slice_start == slice_end) ||
+			(slice_start > slice_end && slice_step > 0) ||
+			(slice_start < slice_end && slice_step < 0))
+		{
+			continue;
+		}
+
+		/* Determine the values for each index we want to look at. */
+		if (slice_start < slice_end) {
+			/* Count up. */
+			for (j=slice_start; j<slice_end && !ctx->stop; j+=slice_step) {
+				if (j >= 0 && j < (M_int64)array_len) {
+					M_json_jsonpath_search(M_json_array_at(node, (size_t)j), ctx, seg_offset+1, M_FALSE);
+				}
+			}
+		} else {
+			/* Count down. */
+			for (j=slice_start-1; j>=slice_end && !ctx->stop; j+=slice_step) {
+				if (j >= 0 && j < (M_int64)array_len) {
+					M_json_jsonpath_search(M_json_array_at(node, (size_t)j), ctx, seg_offset+1, M_FALSE);
+				}
+			}
+		}
+	}
 }
 
 static void M_json_jsonpath_search_add_match(const M_json_node_t *node, M_json_node_t ***matches, size_t *num_matches)
@@ -189,24 +264,24 @@ static void M_json_jsonpath_search_add_match(const M_json_node_t *node, M_json_n
 	(*num_matches)++;
 }
 
-static void M_json_jsonpath_search(const M_json_node_t *node, M_list_str_t *segments, size_t seg_offset, M_bool search_recursive, M_json_node_t ***matches, size_t *num_matches)
+static void M_json_jsonpath_search(const M_json_node_t *node, M_json_jsonpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive)
 {
-	M_hash_strvp_enum_t *hashenum;
-	M_list_u64_t        *array_offsets;
-	const char          *seg;
-	const char          *key;
-	void                *val;
-	size_t               num_segments;
-	size_t               array_len;
-	size_t               array_offsets_len;
-	size_t               i;
-
-	if (node == NULL)
+	M_json_object_enum_t         objenum;
+	const M_json_jsonpath_seg_t *seg;
+	const char                  *key;
+	M_json_node_t               *val;
+	size_t                       num_segments;
+	size_t                       array_len;
+	size_t                       i;
+
+	if (node == NULL || ctx->stop)
 		return;
 
-	num_segments = M_list_str_len(segments)-seg_offset;
+	num_segments = ctx->jsonpath->num_segs-seg_offset;
 	if (num_segments == 0) {
-		M_json_jsonpath_search_add_match(node, matches, num_matches);
+		ctx->num_matches++;
+		if (!ctx->match_func(M_CAST_OFF_CONST(M_json_node_t *, node), ctx->thunk))
+			ctx->stop = M_TRUE;
 		return;
 	}
 
@@ -214,78 +289,197 @@ static void M_json_jsonpath_search(const M_json_node_t *node, M_list_str_t *segm
 	if (node->type != M_JSON_TYPE_OBJECT && node->type != M_JSON_TYPE_ARRAY)
 		return;
 
-	seg = M_list_str_at(segments, seg_offset);
+	seg = &ctx->jsonpath->segs[seg_offset];
 	/* A blank segment denotes we want to search recursively for the next pattern */
-	if (seg == NULL || *seg == '\0') {
+	if (seg->type == M_JSON_JSONPATH_SEG_RECURSIVE) {
 		/* Only recurse if there is something else to match */
 		if (num_segments > 1) {
-			M_json_jsonpath_search(node, segments, seg_offset+1, M_TRUE, matches, num_matches);
+			M_json_jsonpath_search(node, ctx, seg_offset+1, M_TRUE);
 		}
 		return;
 	}
 
 	if (node->type == M_JSON_TYPE_OBJECT) {
 		/* Invalid search. We can't index an object. */
-		if (*seg == '[')
+		if (seg->type != M_JSON_JSONPATH_SEG_KEY)
 			return;
 
-		M_hash_strvp_enumerate(node->data.json_object, &hashenum);
-		while (M_hash_strvp_enumerate_next(node->data.json_object, hashenum, &key, &val)) {
+		M_json_object_enumerate(node, &objenum);
+		while (!ctx->stop && M_json_object_enumerate_next(&objenum, &key, &val)) {
 			/* If a wildcard match, or an exact name match, its a match */
-			if (M_str_eq(seg, "*") || M_str_caseeq(seg, key)) {
-				M_json_jsonpath_search(val, segments, seg_offset+1, M_FALSE, matches, num_matches);
+			if (seg->key == NULL || M_str_caseeq(seg->key, key)) {
+				M_json_jsonpath_search(val, ctx, seg_offset+1, M_FALSE);
 			}
 
 			/* This should NOT be an "else if" to the prior statement as there could legitimately be additional
 			 * matches at deeper layers, and we need to search those too */
 			if (search_recursive) {
-				M_json_jsonpath_search(val, segments, seg_offset, M_TRUE, matches, num_matches);
+				M_json_jsonpath_search(val, ctx, seg_offset, M_TRUE);
 			}
 		}
-		M_hash_strvp_enumerate_free(hashenum);
+		M_json_object_enumerate_free(&objenum);
 	} else if (node->type == M_JSON_TYPE_ARRAY) {
 		array_len = M_json_array_len(node);
-		if (M_str_eq(seg, "[*]")) {
-			for (i=0; i<array_len; i++) {
-				M_json_jsonpath_search(M_json_array_at(node, i), segments, seg_offset+1, search_recursive, matches, num_matches);
+		if (seg->type == M_JSON_JSONPATH_SEG_INDEX_ALL) {
+			for (i=0; i<array_len && !ctx->stop; i++) {
+				M_json_jsonpath_search(M_json_array_at(node, i), ctx, seg_offset+1, search_recursive);
 			}
 		/* We have an indexed value lets try to find that index. */
-		} else if (*seg == '[') {
-			array_offsets     = M_json_jsonpath_search_array_offsets(node, seg);
-			array_offsets_len = M_list_u64_len(array_offsets);
-			for (i=0; i<array_offsets_len; i++) {
-				M_json_jsonpath_search(M_json_array_at(node, (size_t)M_list_u64_at(array_offsets, i)), segments, seg_offset+1, M_FALSE, matches, num_matches);
-			}
-			M_list_u64_destroy(array_offsets);
+		} else if (seg->type == M_JSON_JSONPATH_SEG_INDEX) {
+			M_json_jsonpath_search_array_offsets(node, seg, ctx, seg_offset);
 		}
 
 		/* This should NOT be an "else if" to the prior statement as there could legitimately be additional
 		 * matches at deeper layers, and we need to search those too */
 		if (search_recursive) {
-			for (i=0; i<array_len; i++) {
-				M_json_jsonpath_search(M_json_array_at(node, i), segments, seg_offset, M_TRUE, matches, num_matches);
+			for (i=0; i<array_len && !ctx->stop; i++) {
+				M_json_jsonpath_search(M_json_array_at(node, i), ctx, seg_offset, M_TRUE);
 			}
 		}
 	}
 }
 
-M_json_node_t **M_json_jsonpath(const M_json_node_t *node, const char *search, size_t *num_matches)
+static void M_json_jsonpath_compile_seg(M_json_jsonpath_t *jsonpath, const char *segment)
 {
-	M_json_node_t **matches          = NULL;
-	char          **segments;
-	char          **idx_segments;
-	M_list_str_t   *seg_list;
-	M_buf_t        *buf;
-	char           *out;
-	size_t          num_segments     = 0;
-	size_t          num_idx_segments = 0;
-	size_t          i;
-	size_t          j;
+	M_json_jsonpath_seg_t *seg = &jsonpath->segs[jsonpath->num_segs++];
+
+	if (*segment == '\0') {
+		seg->type = M_JSON_JSONPATH_SEG_RECURSIVE;
+	} else if (M_str_eq(segment, "[*]")) {
+		seg->type = M_JSON_JSONPATH_SEG_INDEX_ALL;
+	} else if (*segment == '[') {
+		seg->type = M_JSON_JSONPATH_SEG_INDEX;
+		M_json_jsonpath_compile_idx(seg, segment);
+	} else {
+		seg->type = M_JSON_JSONPATH_SEG_KEY;
+		if (!M_str_eq(segment, "*")) {
+			seg->key = M_strdup(segment);
+		}
+	}
+}
 
-	if (node == NULL || search == NULL || num_matches == NULL)
-		return NULL;
+static M_bool M_json_jsonpath_matches_cb(M_json_node_t *node, void *thunk)
+{
+	M_json_jsonpath_matches_t *m = thunk;
 
-	*num_matches = 0;
+	M_json_jsonpath_search_add_match(node, &m->matches, &m->num_matches);
+	return M_TRUE;
+}
+
+static M_bool M_json_jsonpath_first_cb(M_json_node_t *node, void *thunk)
+{
+	M_json_node_t **match = thunk;
+
+	*match = node;
+	return M_FALSE;
+}
+
+static M_bool M_json_jsonpath_match_array_offset(const M_json_jsonpath_seg_t *seg, M_uint64 offset)
+{
+	const M_json_jsonpath_idx_t *idx;
+	size_t                       i;
+
+	if (!seg->idx_valid)
+		return M_FALSE;
+
+	for (i=0; i<seg->num_idx; i++) {
+		idx = &seg->idx[i];
+
+		if (!idx->is_slice) {
+			if ((M_uint64)idx->start == offset)
+				return M_TRUE;
+			continue;
+		}
+
+		if (idx->has_start && offset < (M_uint64)idx->start)
+			continue;
+		if (idx->has_end && offset >= (M_uint64)idx->end)
+			continue;
+		if ((offset - (M_uint64)(idx->has_start ? idx->start : 0)) % (M_uint64)idx->step == 0)
+			return M_TRUE;
+	}
+
+	return M_FALSE;
+}
+
+/* Same walk as M_json_jsonpath_search but following a single location instead of
+ * visiting every node. Only valid for streamable expressions. */
+static M_bool M_json_jsonpath_match_steps(const M_json_jsonpath_t *jsonpath, const M_json_jsonpath_step_t *steps, size_t num_steps, size_t seg_offset, M_bool search_recursive)
+{
+	const M_json_jsonpath_seg_t *seg;
+
+	if (seg_offset == jsonpath->num_segs)
+		return num_steps == 0;
+
+	/* The node we're at isn't a container so nothing is under it. */
+	if (num_steps == 0)
+		return M_FALSE;
+
+	seg = &jsonpath->segs[seg_offset];
+	if (seg->type == M_JSON_JSONPATH_SEG_RECURSIVE)
+		return seg_offset+1 < jsonpath->num_segs && M_json_jsonpath_match_steps(jsonpath, steps, num_steps, seg_offset+1, M_TRUE);
+
+	if (steps->type == M_JSON_TYPE_OBJECT) {
+		if (seg->type != M_JSON_JSONPATH_SEG_KEY)
+			return M_FALSE;
+
+		if ((seg->key == NULL || M_str_caseeq(seg->key, steps->key)) && M_json_jsonpath_match_steps(jsonpath, steps+1, num_steps-1, seg_offset+1, M_FALSE))
+			return M_TRUE;
+	} else {
+		if (seg->type == M_JSON_JSONPATH_SEG_INDEX_ALL && M_json_jsonpath_match_steps(jsonpath, steps+1, num_steps-1, seg_offset+1, search_recursive))
+			return M_TRUE;
+		if (seg->type == M_JSON_JSONPATH_SEG_INDEX && M_json_jsonpath_match_array_offset(seg, steps->idx) && M_json_jsonpath_match_steps(jsonpath, steps+1, num_steps-1, seg_offset+1, M_FALSE))
+			return M_TRUE;
+	}
+
+	return search_recursive && M_json_jsonpath_match_steps(jsonpath, steps+1, num_steps-1, seg_offset, M_TRUE);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+M_bool M_json_jsonpath_streamable(const M_json_jsonpath_t *jsonpath)
+{
+	const M_json_jsonpath_idx_t *idx;
+	size_t                       i;
+	size_t                       j;
+
+	if (jsonpath == NULL || jsonpath->num_segs == 0 || jsonpath->segs[jsonpath->num_segs-1].type == M_JSON_JSONPATH_SEG_RECURSIVE)
+		return M_FALSE;
+
+	for (i=0; i<jsonpath->num_segs; i++) {
+		for (j=0; j<jsonpath->segs[i].num_idx; j++) {
+			idx = &jsonpath->segs[i].idx[j];
+			if (idx->start < 0 || (idx->has_end && idx->end < 0) || (idx->is_slice && idx->step < 0)) {
+				return M_FALSE;
+			}
+		}
+	}
+
+	return M_TRUE;
+}
+
+M_bool M_json_jsonpath_match_location(const M_json_jsonpath_t *jsonpath, const M_json_jsonpath_step_t *steps, size_t num_steps)
+{
+	if (jsonpath == NULL || (steps == NULL && num_steps != 0))
+		return M_FALSE;
+	return M_json_jsonpath_match_steps(jsonpath, steps, num_steps, 0, M_FALSE);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+M_json_jsonpath_t *M_json_jsonpath_compile(const char *search)
+{
+	M_json_jsonpath_t  *jsonpath;
+	char              **segments;
+	char              **idx_segments;
+	M_buf_t            *buf;
+	char               *out;
+	const char         *p;
+	size_t              num_segments     = 0;
+	size_t              num_idx_segments = 0;
+	size_t              max_segs         = 0;
+	size_t              i;
+	size_t              j;
 
 	/* All JSON search expressions must start with a '$'. */
 	if (M_str_len(search) < 1 || *search != '$')
@@ -298,11 +492,21 @@ M_json_node_t **M_json_jsonpath(const M_json_node_t *node, const char *search, s
 		return NULL;
 	}
 
+	/* Every '[' can start a segment. */
+	for (i=0; i<num_segments; i++) {
+		max_segs++;
+		for (p=M_str_chr(segments[i], '['); p!=NULL; p=M_str_chr(p+1, '[')) {
+			max_segs++;
+		}
+	}
+
+	jsonpath       = M_malloc_zero(sizeof(*jsonpath));
+	jsonpath->segs = M_malloc_zero(max_segs * sizeof(*jsonpath->segs));
+
 	/* Further split on '[' to pull out indexes */
-	seg_list = M_list_str_create(M_LIST_STR_NONE);
 	for (i=0; i<num_segments; i++) {
 		if (*(segments[i]) == '\0') {
-			M_list_str_insert(seg_list, "");
+			M_json_jsonpath_compile_seg(jsonpath, "");
 			continue;
 		}
 
@@ -320,7 +524,7 @@ M_json_node_t **M_json_jsonpath(const M_json_node_t *node, const char *search, s
 			/* First one may not start with '['. We need to check if the segement is something like:
 			 * 'abc'/'abc[1]' vs '[1]'. */
 			if (j == 0 && *(segments[i]) != '[') {
-				M_list_str_insert(seg_list, idx_segments[j]);
+				M_json_jsonpath_compile_seg(jsonpath, idx_segments[j]);
 				continue;
 			}
 
@@ -329,14 +533,85 @@ M_json_node_t **M_json_jsonpath(const M_json_node_t *node, const char *search, s
 			M_buf_add_byte(buf, '[');
 			M_buf_add_str(buf, idx_segments[j]);
 			out = M_buf_finish_str(buf, NULL);
-			M_list_str_insert(seg_list, out);
+			M_json_jsonpath_compile_seg(jsonpath, out);
 			M_free(out);
 		}
 		M_str_explode_free(idx_segments, num_idx_segments);
 	}
 	M_str_explode_free(segments, num_segments);
 
-	M_json_jsonpath_search(node, seg_list, 0, M_FALSE, &matches, num_matches);
-	M_list_str_destroy(seg_list);
+	return jsonpath;
+}
+
+void M_json_jsonpath_destroy(M_json_jsonpath_t *jsonpath)
+{
+	size_t i;
+
+	if (jsonpath == NULL)
+		return;
+
+	for (i=0; i<jsonpath->num_segs; i++) {
+		M_free(jsonpath->segs[i].key);
+		M_free(jsonpath->segs[i].idx);
+	}
+	M_free(jsonpath->segs);
+	M_free(jsonpath);
+}
+
+size_t M_json_jsonpath_foreach(const M_json_jsonpath_t *jsonpath, const M_json_node_t *node, M_json_jsonpath_match_func match_func, void *thunk)
+{
+	M_json_jsonpath_ctx_t ctx;
+
+	if (jsonpath == NULL || node == NULL || match_func == NULL)
+		return 0;
+
+	M_mem_set(&ctx, 0, sizeof(ctx));
+	ctx.jsonpath   = jsonpath;
+	ctx.match_func = match_func;
+	ctx.thunk      = thunk;
+
+	M_json_jsonpath_search(node, &ctx, 0, M_FALSE);
+	return ctx.num_matches;
+}
+
+M_json_node_t **M_json_jsonpath_eval(const M_json_jsonpath_t *jsonpath, const M_json_node_t *node, size_t *num_matches)
+{
+	M_json_jsonpath_matches_t m;
+
+	if (num_matches == NULL)
+		return NULL;
+	*num_matches = 0;
+
+	M_mem_set(&m, 0, sizeof(m));
+	M_json_jsonpath_foreach(jsonpath, node, M_json_jsonpath_matches_cb, &m);
+
+	*num_matches = m.num_matches;
+	return m.matches;
+}
+
+M_json_node_t *M_json_jsonpath_first(const M_json_jsonpath_t *jsonpath, const M_json_node_t *node)
+{
+	M_json_node_t *match = NULL;
+
+	M_json_jsonpath_foreach(jsonpath, node, M_json_jsonpath_first_cb, &match);
+	return match;
+}
+
+M_json_node_t **M_json_jsonpath(const M_json_node_t *node, const char *search, size_t *num_matches)
+{
+	M_json_jsonpath_t  *jsonpath;
+	M_json_node_t     **matches;
+
+	if (node == NULL || search == NULL || num_matches == NULL)
+		return NULL;
+
+	*num_matches = 0;
+
+	jsonpath = M_json_jsonpath_compile(search);
+	if (jsonpath == NULL)
+		return NULL;
+
+	matches = M_json_jsonpath_eval(jsonpath, node, num_matches);
+	M_json_jsonpath_destroy(jsonpath);
 	return matches;
 }
@@ -27,6 +27,14 @@
 #include <mstdlib/mstdlib_formats.h>
 #include "json/m_json_int.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define M_JSON_FAST_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define M_JSON_FAST_NEON
+#endif
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 static M_json_node_t *M_json_read_value(M_parser_t *parser, M_uint32 flags, M_json_error_t *error);
@@ -590,6 +598,629 @@ static void M_json_read_format_error_pos(M_parser_t *parser, size_t *error_line,
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* Fast path.
+ *
+ * Stage 1 classifies the input 64 bytes at a time into bit masks (quotes,
+ * backslashes, structural characters and whitespace), works out which bytes
+ * are inside of strings and records the offset of every structural character
+ * outside of a string, every unescaped quote and the first byte of every bare
+ * value (number, true, false, null). Stage 2 walks that index and builds the
+ * node tree directly, only looking at string contents and bare values.
+ *
+ * Only strict JSON is handled. Comments, unusual whitespace, the missing
+ * separators the recursive reader tolerates and every kind of error make the
+ * fast path give up and the recursive reader parses the document instead.
+ * Results, error codes and error positions are identical either way. */
+
+#define M_JSON_FAST_BLOCK 64
+
+enum {
+	M_JSON_FAST_CLS_SCALAR = 0,
+	M_JSON_FAST_CLS_QUOTE  = 1,
+	M_JSON_FAST_CLS_BSLASH = 2,
+	M_JSON_FAST_CLS_OP     = 3,
+	M_JSON_FAST_CLS_WS     = 4
+};
+
+typedef struct {
+	M_uint64 quote;
+	M_uint64 bslash;
+	M_uint64 op;
+	M_uint64 ws;
+} M_json_fast_block_t;
+
+typedef struct {
+	const unsigned char *data;
+	size_t               data_len;
+	M_uint32             flags;
+	M_uint32            *idx;      /*!< Offsets of indexed bytes. */
+	size_t               idx_len;
+	size_t               idx_size;
+	char                *key;      /*!< Scratch buffer object keys are decoded into. */
+	size_t               key_size;
+	M_json_arena_t      *arena;    /*!< Where nodes come from with M_JSON_READER_COMPACT. */
+} M_json_fast_t;
+
+static int M_json_fast_class(unsigned char c)
+{
+	switch (c) {
+		case '"':
+			return M_JSON_FAST_CLS_QUOTE;
+		case '\\':
+			return M_JSON_FAST_CLS_BSLASH;
+		case '{':
+		case '}':
+		case '[':
+		case ']':
+		case ':':
+		case ',':
+			return M_JSON_FAST_CLS_OP;
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+			return M_JSON_FAST_CLS_WS;
+		default:
+			break;
+	}
+	return M_JSON_FAST_CLS_SCALAR;
+}
+
+#if defined(M_JSON_FAST_SSE2)
+static void M_json_fast_classify(const unsigned char *p, M_json_fast_block_t *b)
+{
+	const __m128i quote  = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	const __m128i lower  = _mm_set1_epi8(0x20);
+	const __m128i obrace = _mm_set1_epi8('{');
+	const __m128i cbrace = _mm_set1_epi8('}');
+	const __m128i colon  = _mm_set1_epi8(':');
+	const __m128i comma  = _mm_set1_epi8(',');
+	const __m128i space  = _mm_set1_epi8(' ');
+	const __m128i tab    = _mm_set1_epi8('\t');
+	const __m128i nl     = _mm_set1_epi8('\n');
+	const __m128i cr     = _mm_set1_epi8('\r');
+	size_t        i;
+
+	M_mem_set(b, 0, sizeof(*b));
+	for (i=0; i<M_JSON_FAST_BLOCK; i+=16) {
+		__m128i v  = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+		/* '[' and ']' only differ from '{' and '}' by 0x20. */
+		__m128i vl = _mm_or_si128(v, lower);
+		__m128i op;
+		__m128i ws;
+
+		op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(vl, obrace), _mm_cmpeq_epi8(vl, cbrace)),
+		                  _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+		ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+		                  _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+
+		b->quote  |= ((M_uint64)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote))) << i;
+		b->bslash |= ((M_uint64)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, bslash))) << i;
+		b->op     |= ((M_uint64)(unsigned int)_mm_movemask_epi8(op)) << i;
+		b->ws     |= ((M_uint64)(unsigned int)_mm_movemask_epi8(ws)) << i;
+	}
+}
+#elif defined(M_JSON_FAST_NEON)
+static M_uint64 M_json_fast_neon_mask(uint8x16_t v)
+{
+	static const M_uint8 bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x16_t           m        = vandq_u8(v, vld1q_u8(bits));
+	uint8x8_t            lo       = vget_low_u8(m);
+	uint8x8_t            hi       = vget_high_u8(m);
+
+	/* Each lane has a distinct bit so summing the lanes is the same as or'ing them. */
+	lo = vpadd_u8(lo, lo);
+	lo = vpadd_u8(lo, lo);
+	lo = vpadd_u8(lo, lo);
+	hi = vpadd_u8(hi, hi);
+	hi = vpadd_u8(hi, hi);
+	hi = vpadd_u8(hi, hi);
+
+	return (M_uint64)vget_lane_u8(lo, 0) | ((M_uint64)vget_lane_u8(hi, 0) << 8);
+}
+
+static void M_json_fast_classify(const unsigned char *p, M_json_fast_block_t *b)
+{
+	const uint8x16_t quote  = vdupq_n_u8('"');
+	const uint8x16_t bslash = vdupq_n_u8('\\');
+	const uint8x16_t lower  = vdupq_n_u8(0x20);
+	const uint8x16_t obrace = vdupq_n_u8('{');
+	const uint8x16_t cbrace = vdupq_n_u8('}');
+	const uint8x16_t colon  = vdupq_n_u8(':');
+	const uint8x16_t comma  = vdupq_n_u8(',');
+	const uint8x16_t space  = vdupq_n_u8(' ');
+	const uint8x16_t tab    = vdupq_n_u8('\t');
+	const uint8x16_t nl     = vdupq_n_u8('\n');
+	const uint8x16_t cr     = vdupq_n_u8('\r');
+	size_t           i;
+
+	M_mem_set(b, 0, sizeof(*b));
+	for (i=0; i<M_JSON_FAST_BLOCK; i+=16) {
+		uint8x16_t v  = vld1q_u8(p + i);
+		/* '[' and ']' only differ from '{' and '}' by 0x20. */
+		uint8x16_t vl = vorrq_u8(v, lower);
+		uint8x16_t op;
+		uint8x16_t ws;
+
+		op = vorrq_u8(vorrq_u8(vceqq_u8(vl, obrace), vceqq_u8(vl, cbrace)),
+		              vorrq_u8(vceqq_u8(v, colon), vceqq_u8(v, comma)));
+		ws = vorrq_u8(vorrq_u8(vceqq_u8(v, space), vceqq_u8(v, tab)),
+		              vorrq_u8(vceqq_u8(v, nl), vceqq_u8(v, cr)));
+
+		b->quote  |= M_json_fast_neon_mask(vceqq_u8(v, quote)) << i;
+		b->bslash |= M_json_fast_neon_mask(vceqq_u8(v, bslash)) << i;
+		b->op     |= M_json_fast_neon_mask(op) << i;
+		b->ws     |= M_json_fast_neon_mask(ws) << i;
+	}
+}
+#else
+static void M_json_fast_classify(const unsigned char *p, M_json_fast_block_t *b)
+{
+	size_t i;
+
+	M_mem_set(b, 0, sizeof(*b));
+	for (i=0; i<M_JSON_FAST_BLOCK; i++) {
+		M_uint64 bit = ((M_uint64)1) << i;
+
+		switch (M_json_fast_class(p[i])) {
+			case M_JSON_FAST_CLS_QUOTE:
+				b->quote |= bit;
+				break;
+			case M_JSON_FAST_CLS_BSLASH:
+				b->bslash |= bit;
+				break;
+			case M_JSON_FAST_CLS_OP:
+				b->op |= bit;
+				break;
+			case M_JSON_FAST_CLS_WS:
+				b->ws |= bit;
+				break;
+			default:
+				break;
+		}
+	}
+}
+#endif
+
+static unsigned int M_json_fast_ctz(M_uint64 x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned int)__builtin_ctzll(x);
+#else
+	unsigned int n = 0;
+
+	while (!(x & 1)) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Every bit set after this has an odd number of set bits at or below it. Used to turn
+ * quote positions into a mask of the bytes inside of strings. */
+static M_uint64 M_json_fast_prefix_xor(M_uint64 x)
+{
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+/* Mark every byte that follows an odd length run of backslashes (is escaped).
+ * prev_escaped carries whether the first byte of the next block is escaped. */
+static M_uint64 M_json_fast_escaped(M_uint64 bslash, M_uint64 *prev_escaped)
+{
+	const M_uint64 even_bits = (M_uint64)0x55555555 << 32 | 0x55555555;
+	M_uint64       follows_escape;
+	M_uint64       odd_starts;
+	M_uint64       even_sequences;
+
+	bslash         &= ~*prev_escaped;
+	follows_escape  = (bslash << 1) | *prev_escaped;
+	/* Runs starting on an odd bit. Adding the run to its start carries past the end
+	 * of the run, leaving the bit after every run set (and detecting runs that
+	 * continue into the next block via overflow). */
+	odd_starts      = bslash & ~even_bits & ~follows_escape;
+	even_sequences  = odd_starts + bslash;
+	*prev_escaped   = (even_sequences < odd_starts) ? 1 : 0;
+
+	return (even_bits ^ (even_sequences << 1)) & follows_escape;
+}
+
+/* Stage 1. Returns M_FALSE if a string is left open. */
+static M_bool M_json_fast_index(M_json_fast_t *f)
+{
+	unsigned char       tail[M_JSON_FAST_BLOCK];
+	M_json_fast_block_t b;
+	M_uint64            prev_escaped = 0;
+	M_uint64            prev_instr   = 0;
+	M_uint64            prev_scalar  = 0;
+	size_t              pos;
+
+	f->idx_size = (f->data_len / 8) + M_JSON_FAST_BLOCK;
+	f->idx      = M_malloc(f->idx_size * sizeof(*f->idx));
+
+	for (pos=0; pos<f->data_len; pos+=M_JSON_FAST_BLOCK) {
+		const unsigned char *p = f->data + pos;
+		M_uint64             escaped;
+		M_uint64             quote;
+		M_uint64             instr;
+		M_uint64             scalar;
+		M_uint64             bits;
+
+		/* Pad the final partial block with whitespace, which is never indexed. */
+		if (f->data_len - pos < M_JSON_FAST_BLOCK) {
+			M_mem_set(tail, ' ', sizeof(tail));
+			M_mem_copy(tail, p, f->data_len - pos);
+			p = tail;
+		}
+		M_json_fast_classify(p, &b);
+
+		escaped     = M_json_fast_escaped(b.bslash, &prev_escaped);
+		quote       = b.quote & ~escaped;
+		/* Includes the opening quote but not the closing one. */
+		instr       = M_json_fast_prefix_xor(quote) ^ prev_instr;
+		prev_instr  = 0 - (instr >> 63);
+		scalar      = ~(b.op | b.ws | quote | instr);
+		bits        = (b.op & ~instr) | quote | (scalar & ~((scalar << 1) | prev_scalar));
+		prev_scalar = scalar >> 63;
+
+		if (f->idx_len + M_JSON_FAST_BLOCK > f->idx_size) {
+			f->idx_size *= 2;
+			f->idx       = M_realloc(f->idx, f->idx_size * sizeof(*f->idx));
+		}
+		while (bits != 0) {
+			f->idx[f->idx_len++] = (M_uint32)(pos + M_json_fast_ctz(bits));
+			bits &= bits - 1;
+		}
+	}
+
+	return prev_instr == 0;
+}
+
+/* Decode the string between the quotes at index i and i+1. out must be able to hold the raw
+ * string plus a NULL terminator, decoding never makes it longer. */
+static M_bool M_json_fast_decode_string(const M_json_fast_t *f, size_t i, char *out)
+{
+	const unsigned char *s   = f->data + f->idx[i] + 1;
+	const unsigned char *end = f->data + f->idx[i+1];
+	char                 uchr[8];
+	M_uint32             codepoint;
+	size_t               uchr_len;
+	size_t               len = 0;
+
+	while (s < end) {
+		if (*s != '\\') {
+			if (*s < 32)
+				return M_FALSE;
+			out[len++] = (char)*s++;
+			continue;
+		}
+
+		/* Stage 1 guarantees an escape never swallows the closing quote. */
+		switch (s[1]) {
+			case '"':
+			case '/':
+			case '\\':
+				out[len++] = (char)s[1];
+				break;
+			case 'b':
+				out[len++] = '\b';
+				break;
+			case 'f':
+				out[len++] = '\f';
+				break;
+			case 'n':
+				out[len++] = '\n';
+				break;
+			case 'r':
+				out[len++] = '\r';
+				break;
+			case 't':
+				out[len++] = '\t';
+				break;
+			case 'u':
+				if (end - s < 6                                                                        ||
+					!M_str_ishex_max((const char *)s+2, 4)                                             ||
+					M_str_to_uint32_ex((const char *)s+2, 4, 16, &codepoint, NULL) != M_STR_INT_SUCCESS ||
+					M_utf8_from_cp(uchr, sizeof(uchr), &uchr_len, codepoint) != M_UTF8_ERROR_SUCCESS)
+				{
+					return M_FALSE;
+				}
+				if (f->flags & M_JSON_READER_DONT_DECODE_UNICODE) {
+					M_mem_copy(out+len, s, 6);
+					len += 6;
+				} else {
+					M_mem_copy(out+len, uchr, uchr_len);
+					len += uchr_len;
+				}
+				s += 4;
+				break;
+			default:
+				return M_FALSE;
+		}
+		s += 2;
+	}
+
+	out[len] = '\0';
+	return M_TRUE;
+}
+
+static M_bool M_json_fast_read_key(M_json_fast_t *f, size_t i)
+{
+	size_t len = (size_t)(f->idx[i+1] - f->idx[i]);
+
+	if (len > f->key_size) {
+		f->key_size = M_MAX(len, 64);
+		f->key      = M_realloc(f->key, f->key_size);
+	}
+	return M_json_fast_decode_string(f, i, f->key);
+}
+
+static M_json_node_t *M_json_fast_node_create(const M_json_fast_t *f, M_json_type_t type)
+{
+	if (f->arena != NULL)
+		return M_json_node_create_arena(f->arena, type);
+	return M_json_node_create(type);
+}
+
+static M_json_node_t *M_json_fast_read_string(const M_json_fast_t *f, size_t i)
+{
+	M_json_node_t *node;
+	char          *out;
+	size_t         len = (size_t)(f->idx[i+1] - f->idx[i]);
+
+	/* Strings without escapes are a single copy out of the input either way. */
+	if (f->arena != NULL) {
+		out = M_json_arena_alloc(f->arena, len);
+		if (!M_json_fast_decode_string(f, i, out))
+			return NULL;
+		node                    = M_json_node_create_arena(f->arena, M_JSON_TYPE_STRING);
+		node->data.json_string  = out;
+		node->flags            |= M_JSON_NODE_FLAG_ARENA_STRING;
+		return node;
+	}
+
+	out = M_malloc(len);
+	if (!M_json_fast_decode_string(f, i, out)) {
+		M_free(out);
+		return NULL;
+	}
+
+	node                   = M_json_node_create(M_JSON_TYPE_STRING);
+	node->data.json_string = out;
+	return node;
+}
+
+/* Numbers, true, false and null. */
+static M_json_node_t *M_json_fast_read_scalar(const M_json_fast_t *f, size_t pos)
+{
+	M_json_node_t         *node;
+	const unsigned char   *s   = f->data + pos;
+	const char            *end = NULL;
+	M_decimal_t            decimal;
+	enum M_DECIMAL_RETVAL  rv;
+	M_int64                num = 0;
+	size_t                 len = 0;
+	size_t                 i;
+
+	while (pos+len < f->data_len) {
+		int cls = M_json_fast_class(s[len]);
+		/* A backslash is part of a bare value as far as stage 1 is concerned. */
+		if (cls != M_JSON_FAST_CLS_SCALAR && cls != M_JSON_FAST_CLS_BSLASH)
+			break;
+		len++;
+	}
+
+	switch (*s) {
+		case 't':
+		case 'f':
+			if ((len == 4 && M_mem_eq(s, "true", 4)) || (len == 5 && M_mem_eq(s, "false", 5))) {
+				node = M_json_fast_node_create(f, M_JSON_TYPE_BOOL);
+				M_json_set_bool(node, *s == 't' ? M_TRUE : M_FALSE);
+				return node;
+			}
+			return NULL;
+		case 'n':
+			if (len == 4 && M_mem_eq(s, "null", 4))
+				return M_json_fast_node_create(f, M_JSON_TYPE_NULL);
+			return NULL;
+		case '-':
+			break;
+		default:
+			if (!M_chr_isdigit((char)*s))
+				return NULL;
+			break;
+	}
+
+	/* Plain integers that can't overflow are the common case, skip the decimal conversion. */
+	i = (*s == '-') ? 1 : 0;
+	if (len > i && len - i <= 18) {
+		for ( ; i<len && M_chr_isdigit((char)s[i]); i++)
+			num = (num * 10) + (s[i] - '0');
+		if (i == len) {
+			node = M_json_fast_node_create(f, M_JSON_TYPE_INTEGER);
+			M_json_set_int(node, (*s == '-') ? -num : num);
+			return node;
+		}
+	}
+
+	/* Hand the remaining data to the conversion the same as the recursive reader does and
+	 * only accept the result if it stopped at the end of the value. */
+	rv = M_decimal_from_str((const char *)s, f->data_len - pos, &decimal, &end);
+	if (rv != M_DECIMAL_SUCCESS && !(rv == M_DECIMAL_TRUNCATION && f->flags & M_JSON_READER_ALLOW_DECIMAL_TRUNCATION))
+		return NULL;
+	if (end != (const char *)s + len)
+		return NULL;
+
+	if (M_decimal_num_decimals(&decimal) == 0) {
+		node = M_json_fast_node_create(f, M_JSON_TYPE_INTEGER);
+		M_json_set_int(node, M_decimal_to_int(&decimal, 0));
+	} else {
+		node = M_json_fast_node_create(f, M_JSON_TYPE_DECIMAL);
+		M_json_set_decimal(node, &decimal);
+	}
+	return node;
+}
+
+/* Create a container for the '{' or '[' at index i. *i is advanced past the container when it's
+ * empty otherwise past the opening character. */
+static M_json_node_t *M_json_fast_open(const M_json_fast_t *f, size_t *i, M_bool *is_empty)
+{
+	M_json_node_t *node;
+
+	if (f->data[f->idx[*i]] == '{') {
+		node      = M_json_fast_node_create(f, M_JSON_TYPE_OBJECT);
+		*is_empty = (*i+1 < f->idx_len && f->data[f->idx[*i+1]] == '}');
+	} else {
+		node      = M_json_fast_node_create(f, M_JSON_TYPE_ARRAY);
+		*is_empty = (*i+1 < f->idx_len && f->data[f->idx[*i+1]] == ']');
+	}
+
+	*i += *is_empty ? 2 : 1;
+	return node;
+}
+
+/* Stage 2. */
+static M_json_node_t *M_json_fast_build(M_json_fast_t *f, size_t *end_pos)
+{
+	M_json_node_t *root;
+	M_json_node_t *node;
+	M_json_node_t *child;
+	size_t         i = 0;
+	M_bool         is_empty;
+	unsigned char  c;
+
+	if (f->idx_len == 0 || (f->data[f->idx[0]] != '{' && f->data[f->idx[0]] != '['))
+		return NULL;
+
+	if (f->flags & M_JSON_READER_COMPACT)
+		f->arena = M_json_arena_create();
+
+	root = M_json_fast_open(f, &i, &is_empty);
+	node = root;
+	M_json_node_hold_arena(root);
+	if (is_empty) {
+		*end_pos = f->idx[i-1] + 1;
+		return root;
+	}
+
+	while (1) {
+		/* Key and separator. */
+		if (node->type == M_JSON_TYPE_OBJECT) {
+			if (i+2 >= f->idx_len || f->data[f->idx[i]] != '"' || f->data[f->idx[i+2]] != ':' || !M_json_fast_read_key(f, i))
+				goto fail;
+			if (f->flags & M_JSON_READER_OBJECT_UNIQUE_KEYS && M_json_object_value(node, f->key) != NULL)
+				goto fail;
+			i += 3;
+		}
+
+		/* Value. */
+		if (i >= f->idx_len)
+			goto fail;
+		is_empty = M_TRUE;
+		c        = f->data[f->idx[i]];
+		switch (c) {
+			case '{':
+			case '[':
+				child = M_json_fast_open(f, &i, &is_empty);
+				break;
+			case '"':
+				child  = M_json_fast_read_string(f, i);
+				i     += 2;
+				break;
+			case '}':
+			case ']':
+			case ':':
+			case ',':
+				goto fail;
+			default:
+				child = M_json_fast_read_scalar(f, f->idx[i]);
+				i++;
+				break;
+		}
+		if (child == NULL)
+			goto fail;
+
+		if ((node->type == M_JSON_TYPE_OBJECT && !M_json_object_insert(node, f->key, child)) ||
+			(node->type == M_JSON_TYPE_ARRAY && !M_json_array_insert(node, child)))
+		{
+			M_json_node_destroy(child);
+			goto fail;
+		}
+
+		if (!is_empty) {
+			node = child;
+			continue;
+		}
+
+		/* Member separator or the end of one or more containers. */
+		while (1) {
+			if (i >= f->idx_len)
+				goto fail;
+			c = f->data[f->idx[i++]];
+			if (c == ',')
+				break;
+			if (c != (node->type == M_JSON_TYPE_OBJECT ? '}' : ']'))
+				goto fail;
+			if (node == root) {
+				*end_pos = f->idx[i-1] + 1;
+				return root;
+			}
+			node = node->parent;
+		}
+	}
+
+fail:
+	M_json_node_destroy(root);
+	return NULL;
+}
+
+static M_json_node_t *M_json_read_fast(const char *data, size_t data_len, M_uint32 flags, size_t *processed_len)
+{
+	M_json_fast_t  f;
+	M_json_node_t *root = NULL;
+	size_t         pos  = 0;
+
+	if (data_len > M_UINT32_MAX)
+		return NULL;
+
+	M_mem_set(&f, 0, sizeof(f));
+	f.data     = (const unsigned char *)data;
+	f.data_len = data_len;
+	f.flags    = flags;
+
+	if (M_json_fast_index(&f))
+		root = M_json_fast_build(&f, &pos);
+
+	M_free(f.idx);
+	M_free(f.key);
+
+	if (root == NULL)
+		return NULL;
+
+	/* Trailing data is either whitespace or, when the caller wants to know how much was
+	 * read, left for them. Anything the recursive reader would treat differently (comments)
+	 * goes to it. */
+	while (pos < data_len && M_chr_isspace(data[pos]))
+		pos++;
+	if (pos < data_len && (processed_len == NULL || (!(flags & M_JSON_READER_DISALLOW_COMMENTS) && data[pos] == '/'))) {
+		M_json_node_destroy(root);
+		return NULL;
+	}
+
+	if (processed_len != NULL)
+		*processed_len = pos;
+	return root;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 M_json_node_t *M_json_read(const char *data, size_t data_len, M_uint32 flags, size_t *processed_len, M_json_error_t *error, size_t *error_line, size_t *error_pos)
 {
 	M_json_node_t  *root;
@@ -614,6 +1245,10 @@ M_json_node_t *M_json_read(const char *data, size_t data_len, M_uint32 flags, si
 		return NULL;
 	}
 
+	root = M_json_read_fast(data, data_len, flags, processed_len);
+	if (root != NULL)
+		return root;
+
 	parser = M_parser_create_const((const unsigned char *)data, data_len, M_PARSER_FLAG_TRACKLINES);
 	root   = M_json_read_value(parser, flags, error);
 	if (root == NULL) {
@@ -0,0 +1,839 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "m_config.h"
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_formats.h>
+#include "json/m_json_int.h"
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+typedef struct {
+	char                     *search;
+	M_json_jsonpath_t        *jsonpath;
+	M_json_reader_match_func  match_func;
+} M_json_reader_path_t;
+
+/* A matching subtree being materialized. */
+typedef struct {
+	const M_json_reader_path_t *path;
+	M_json_node_t              *root;
+	M_json_node_t              *node;  /*!< Container that mirrors the reader's current container. */
+	size_t                      skip;  /*!< Depth of a member being dropped because it couldn't be inserted. */
+} M_json_reader_build_t;
+
+typedef enum {
+	M_JSON_READER_STATE_VALUE = 0, /*!< Value or, directly after '[', the end of the array. */
+	M_JSON_READER_STATE_KEY,       /*!< Key or, directly after '{', the end of the object. */
+	M_JSON_READER_STATE_PAIR_SEP,  /*!< ':' between a key and value. */
+	M_JSON_READER_STATE_NEXT,      /*!< ',' or the end of the container. */
+	M_JSON_READER_STATE_DONE       /*!< Root is complete. */
+} M_json_reader_state_t;
+
+typedef enum {
+	M_JSON_READER_TOKEN_NONE = 0,
+	M_JSON_READER_TOKEN_STRING,
+	M_JSON_READER_TOKEN_STRING_ESCAPE,
+	M_JSON_READER_TOKEN_STRING_UNICODE,
+	M_JSON_READER_TOKEN_NUMBER,
+	M_JSON_READER_TOKEN_LITERAL,
+	M_JSON_READER_TOKEN_COMMENT_START,
+	M_JSON_READER_TOKEN_COMMENT_LINE,
+	M_JSON_READER_TOKEN_COMMENT_BLOCK,
+	M_JSON_READER_TOKEN_COMMENT_BLOCK_END
+} M_json_reader_token_t;
+
+/* A value being passed to callbacks and subtrees. */
+typedef struct {
+	M_json_type_t      type;
+	const char        *str;
+	M_int64            integer;
+	const M_decimal_t *decimal;
+	M_bool             boolean;
+} M_json_reader_value_t;
+
+struct M_json_reader {
+	struct M_json_reader_callbacks  cbs;
+	M_uint32                        flags;
+	void                           *thunk;
+	M_json_error_t                  error;
+	M_bool                          started;
+
+	M_json_reader_state_t           state;
+	M_bool                          allow_close;  /*!< The current container was just opened. */
+	M_json_reader_token_t           token;
+	M_bool                          token_is_key;
+	M_buf_t                        *buf;          /*!< Token being read. */
+	const char                     *literal;
+	size_t                          literal_len;  /*!< Number of literal characters matched. */
+	char                            uhex[5];
+	size_t                          uhex_len;
+
+	M_json_jsonpath_step_t         *frames;       /*!< Open objects and arrays. */
+	M_hash_strvp_t                **frame_keys;   /*!< Object keys seen per frame when they're required to be unique. */
+	size_t                          num_frames;
+	size_t                          frames_size;
+
+	M_json_reader_path_t           *paths;
+	size_t                          num_paths;
+	M_json_reader_build_t          *builds;
+	size_t                          num_builds;
+	size_t                          builds_size;
+
+	size_t                          offset;       /*!< Bytes consumed. */
+	size_t                          line;
+	size_t                          line_start;   /*!< Offset of the start of the current line. */
+};
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void M_json_reader_path_destroy(M_json_reader_path_t *path)
+{
+	M_json_jsonpath_destroy(path->jsonpath);
+	M_free(path->search);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static M_json_node_t *M_json_reader_node_create(const M_json_reader_value_t *val)
+{
+	M_json_node_t *node;
+
+	node = M_json_node_create(val->type);
+	switch (val->type) {
+		case M_JSON_TYPE_STRING:
+			M_json_set_string(node, val->str);
+			break;
+		case M_JSON_TYPE_INTEGER:
+			M_json_set_int(node, val->integer);
+			break;
+		case M_JSON_TYPE_DECIMAL:
+			M_json_set_decimal(node, val->decimal);
+			break;
+		case M_JSON_TYPE_BOOL:
+			M_json_set_bool(node, val->boolean);
+			break;
+		default:
+			break;
+	}
+	return node;
+}
+
+/* Hand a completed subtree to its callback. */
+static M_json_error_t M_json_reader_build_done(M_json_reader_t *reader, size_t idx)
+{
+	M_json_reader_build_t build = reader->builds[idx];
+
+	reader->num_builds--;
+	M_mem_move(reader->builds+idx, reader->builds+idx+1, (reader->num_builds - idx) * sizeof(*reader->builds));
+
+	return build.path->match_func(build.path->search, build.root, reader->thunk);
+}
+
+/* Start subtrees for every path matching the value about to be read, then add the value
+ * to every subtree being built. */
+static M_json_error_t M_json_reader_build_add(M_json_reader_t *reader, const M_json_reader_value_t *val)
+{
+	M_json_error_t res = M_JSON_ERROR_SUCCESS;
+	M_bool         is_container;
+	size_t         i;
+
+	for (i=0; i<reader->num_paths; i++) {
+		if (!M_json_jsonpath_match_location(reader->paths[i].jsonpath, reader->frames, reader->num_frames))
+			continue;
+		if (reader->num_builds == reader->builds_size) {
+			reader->builds_size = (reader->builds_size == 0) ? 4 : reader->builds_size * 2;
+			reader->builds      = M_realloc(reader->builds, reader->builds_size * sizeof(*reader->builds));
+		}
+		M_mem_set(&reader->builds[reader->num_builds], 0, sizeof(*reader->builds));
+		reader->builds[reader->num_builds].path = &reader->paths[i];
+		reader->num_builds++;
+	}
+
+	is_container = (val->type == M_JSON_TYPE_OBJECT || val->type == M_JSON_TYPE_ARRAY);
+	i            = reader->num_builds;
+	while (i-- > 0) {
+		M_json_reader_build_t *build = &reader->builds[i];
+		M_json_node_t         *node;
+		M_bool                 inserted;
+
+		if (build->skip > 0) {
+			if (is_container)
+				build->skip++;
+			continue;
+		}
+
+		node = M_json_reader_node_create(val);
+		if (build->root == NULL) {
+			build->root = node;
+		} else {
+			if (build->node->type == M_JSON_TYPE_OBJECT) {
+				inserted = M_json_object_insert(build->node, reader->frames[reader->num_frames-1].key, node);
+			} else {
+				inserted = M_json_array_insert(build->node, node);
+			}
+			/* Same as M_json_read, members that can't be inserted (empty key) are dropped. */
+			if (!inserted) {
+				M_json_node_destroy(node);
+				if (is_container)
+					build->skip = 1;
+				continue;
+			}
+		}
+
+		if (is_container) {
+			build->node = node;
+		} else if (build->root == node) {
+			res = M_json_reader_build_done(reader, i);
+			if (res != M_JSON_ERROR_SUCCESS) {
+				break;
+			}
+		}
+	}
+
+	return res;
+}
+
+static M_json_error_t M_json_reader_build_close(M_json_reader_t *reader)
+{
+	M_json_error_t res = M_JSON_ERROR_SUCCESS;
+	size_t         i   = reader->num_builds;
+
+	while (i-- > 0) {
+		M_json_reader_build_t *build = &reader->builds[i];
+
+		if (build->skip > 0) {
+			build->skip--;
+			continue;
+		}
+
+		build->node = build->node->parent;
+		if (build->node == NULL) {
+			res = M_json_reader_build_done(reader, i);
+			if (res != M_JSON_ERROR_SUCCESS) {
+				break;
+			}
+		}
+	}
+
+	return res;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void M_json_reader_value_done(M_json_reader_t *reader)
+{
+	reader->allow_close = M_FALSE;
+	reader->state       = (reader->num_frames == 0) ? M_JSON_READER_STATE_DONE : M_JSON_READER_STATE_NEXT;
+}
+
+static M_json_error_t M_json_reader_emit(M_json_reader_t *reader, const M_json_reader_value_t *val)
+{
+	const struct M_json_reader_callbacks *cbs = &reader->cbs;
+	M_json_error_t                        res = M_JSON_ERROR_SUCCESS;
+
+	switch (val->type) {
+		case M_JSON_TYPE_OBJECT:
+			if (cbs->object_start_func != NULL)
+				res = cbs->object_start_func(reader->thunk);
+			break;
+		case M_JSON_TYPE_ARRAY:
+			if (cbs->array_start_func != NULL)
+				res = cbs->array_start_func(reader->thunk);
+			break;
+		case M_JSON_TYPE_STRING:
+			if (cbs->string_func != NULL)
+				res = cbs->string_func(val->str, reader->thunk);
+			break;
+		case M_JSON_TYPE_INTEGER:
+			if (cbs->integer_func != NULL)
+				res = cbs->integer_func(val->integer, reader->thunk);
+			break;
+		case M_JSON_TYPE_DECIMAL:
+			if (cbs->decimal_func != NULL)
+				res = cbs->decimal_func(val->decimal, reader->thunk);
+			break;
+		case M_JSON_TYPE_BOOL:
+			if (cbs->bool_func != NULL)
+				res = cbs->bool_func(val->boolean, reader->thunk);
+			break;
+		case M_JSON_TYPE_NULL:
+			if (cbs->null_func != NULL)
+				res = cbs->null_func(reader->thunk);
+			break;
+		case M_JSON_TYPE_UNKNOWN:
+			break;
+	}
+	if (res == M_JSON_ERROR_SUCCESS && reader->num_paths > 0)
+		res = M_json_reader_build_add(reader, val);
+	if (res != M_JSON_ERROR_SUCCESS)
+		return res;
+
+	if (val->type == M_JSON_TYPE_OBJECT || val->type == M_JSON_TYPE_ARRAY) {
+		M_json_jsonpath_step_t *frame;
+
+		if (reader->num_frames == reader->frames_size) {
+			reader->frames_size = (reader->frames_size == 0) ? 16 : reader->frames_size * 2;
+			reader->frames      = M_realloc(reader->frames, reader->frames_size * sizeof(*reader->frames));
+			reader->frame_keys  = M_realloc(reader->frame_keys, reader->frames_size * sizeof(*reader->frame_keys));
+		}
+		frame = &reader->frames[reader->num_frames];
+		M_mem_set(frame, 0, sizeof(*frame));
+		frame->type = val->type;
+		reader->frame_keys[reader->num_frames] = NULL;
+		if (val->type == M_JSON_TYPE_OBJECT && reader->flags & M_JSON_READER_OBJECT_UNIQUE_KEYS)
+			reader->frame_keys[reader->num_frames] = M_hash_strvp_create(8, 75, M_HASH_STRVP_NONE, NULL);
+		reader->num_frames++;
+
+		reader->state       = (val->type == M_JSON_TYPE_OBJECT) ? M_JSON_READER_STATE_KEY : M_JSON_READER_STATE_VALUE;
+		reader->allow_close = M_TRUE;
+		return M_JSON_ERROR_SUCCESS;
+	}
+
+	M_json_reader_value_done(reader);
+	return M_JSON_ERROR_SUCCESS;
+}
+
+static M_json_error_t M_json_reader_close(M_json_reader_t *reader)
+{
+	M_json_jsonpath_step_t *frame = &reader->frames[reader->num_frames-1];
+	M_json_error_t          res   = M_JSON_ERROR_SUCCESS;
+
+	if (frame->type == M_JSON_TYPE_OBJECT && reader->cbs.object_end_func != NULL)
+		res = reader->cbs.object_end_func(reader->thunk);
+	if (frame->type == M_JSON_TYPE_ARRAY && reader->cbs.array_end_func != NULL)
+		res = reader->cbs.array_end_func(reader->thunk);
+	if (res == M_JSON_ERROR_SUCCESS && reader->num_builds > 0)
+		res = M_json_reader_build_close(reader);
+
+	M_free(frame->key);
+	M_hash_strvp_destroy(reader->frame_keys[reader->num_frames-1], M_FALSE);
+	reader->num_frames--;
+
+	M_json_reader_value_done(reader);
+	return res;
+}
+
+static M_json_error_t M_json_reader_string_done(M_json_reader_t *reader)
+{
+	M_json_jsonpath_step_t *frame;
+	M_hash_strvp_t         *keys;
+	M_json_reader_value_t   val;
+	M_json_error_t          res = M_JSON_ERROR_SUCCESS;
+
+	reader->token = M_JSON_READER_TOKEN_NONE;
+	/* Same as M_json_read, a decoded \u0000 ends the string. */
+	M_buf_add_byte(reader->buf, '\0');
+
+	if (!reader->token_is_key) {
+		M_mem_set(&val, 0, sizeof(val));
+		val.type = M_JSON_TYPE_STRING;
+		val.str  = M_buf_peek(reader->buf);
+		res      = M_json_reader_emit(reader, &val);
+		M_buf_truncate(reader->buf, 0);
+		return res;
+	}
+
+	frame = &reader->frames[reader->num_frames-1];
+	keys  = reader->frame_keys[reader->num_frames-1];
+	if (keys != NULL) {
+		if (M_hash_strvp_get(keys, M_buf_peek(reader->buf), NULL)) {
+			M_buf_truncate(reader->buf, 0);
+			return M_JSON_ERROR_DUPLICATE_KEY;
+		}
+		M_hash_strvp_insert(keys, M_buf_peek(reader->buf), NULL);
+	}
+	M_free(frame->key);
+	frame->key = M_strdup(M_buf_peek(reader->buf));
+	M_buf_truncate(reader->buf, 0);
+
+	if (reader->cbs.key_func != NULL)
+		res = reader->cbs.key_func(frame->key, reader->thunk);
+
+	reader->state       = M_JSON_READER_STATE_PAIR_SEP;
+	reader->allow_close = M_FALSE;
+	return res;
+}
+
+static M_json_error_t M_json_reader_number_done(M_json_reader_t *reader)
+{
+	M_json_reader_value_t  val;
+	M_decimal_t            decimal;
+	enum M_DECIMAL_RETVAL  rv;
+	const char            *end = NULL;
+
+	reader->token = M_JSON_READER_TOKEN_NONE;
+
+	rv = M_decimal_from_str(M_buf_peek(reader->buf), M_buf_len(reader->buf), &decimal, &end);
+	if ((rv != M_DECIMAL_SUCCESS && !(rv == M_DECIMAL_TRUNCATION && reader->flags & M_JSON_READER_ALLOW_DECIMAL_TRUNCATION)) ||
+		end != M_buf_peek(reader->buf) + M_buf_len(reader->buf))
+	{
+		return M_JSON_ERROR_INVALID_NUMBER;
+	}
+	M_buf_truncate(reader->buf, 0);
+
+	M_mem_set(&val, 0, sizeof(val));
+	if (M_decimal_num_decimals(&decimal) == 0) {
+		val.type    = M_JSON_TYPE_INTEGER;
+		val.integer = M_decimal_to_int(&decimal, 0);
+	} else {
+		val.type    = M_JSON_TYPE_DECIMAL;
+		val.decimal = &decimal;
+	}
+	return M_json_reader_emit(reader, &val);
+}
+
+static M_json_error_t M_json_reader_unicode_done(M_json_reader_t *reader)
+{
+	char     uchr[8];
+	size_t   uchr_len;
+	M_uint32 codepoint;
+
+	reader->token = M_JSON_READER_TOKEN_STRING;
+	if (reader->uhex_len != 4                                                                  ||
+		M_str_to_uint32_ex(reader->uhex, 4, 16, &codepoint, NULL) != M_STR_INT_SUCCESS          ||
+		M_utf8_from_cp(uchr, sizeof(uchr), &uchr_len, codepoint) != M_UTF8_ERROR_SUCCESS)
+	{
+		if (!(reader->flags & M_JSON_READER_REPLACE_BAD_CHARS))
+			return M_JSON_ERROR_INVALID_UNICODE_ESACPE;
+		M_buf_add_byte(reader->buf, '?');
+		return M_JSON_ERROR_SUCCESS;
+	}
+
+	if (reader->flags & M_JSON_READER_DONT_DECODE_UNICODE) {
+		M_buf_add_str(reader->buf, "\\u");
+		M_buf_add_bytes(reader->buf, reader->uhex, 4);
+	} else {
+		M_buf_add_bytes(reader->buf, uchr, uchr_len);
+	}
+	return M_JSON_ERROR_SUCCESS;
+}
+
+/* Start of a value. */
+static M_json_error_t M_json_reader_value_start(M_json_reader_t *reader, unsigned char c)
+{
+	M_json_reader_value_t val;
+
+	/* Root must be an object or array. */
+	if (reader->num_frames == 0 && c != '{' && c != '[')
+		return M_JSON_ERROR_INVALID_START;
+
+	M_mem_set(&val, 0, sizeof(val));
+	switch (c) {
+		case '{':
+			val.type = M_JSON_TYPE_OBJECT;
+			return M_json_reader_emit(reader, &val);
+		case '[':
+			val.type = M_JSON_TYPE_ARRAY;
+			return M_json_reader_emit(reader, &val);
+		case '"':
+			reader->token        = M_JSON_READER_TOKEN_STRING;
+			reader->token_is_key = M_FALSE;
+			return M_JSON_ERROR_SUCCESS;
+		case 't':
+		case 'f':
+		case 'n':
+			reader->token       = M_JSON_READER_TOKEN_LITERAL;
+			reader->literal     = (c == 't') ? "true" : ((c == 'f') ? "false" : "null");
+			reader->literal_len = 1;
+			return M_JSON_ERROR_SUCCESS;
+		case '-':
+		case '0':
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9':
+			reader->token = M_JSON_READER_TOKEN_NUMBER;
+			M_buf_add_byte(reader->buf, c);
+			return M_JSON_ERROR_SUCCESS;
+		case '}':
+		case ']':
+			return M_JSON_ERROR_EXPECTED_VALUE;
+		case '\0':
+			return M_JSON_ERROR_UNEXPECTED_TERMINATION;
+		default:
+			break;
+	}
+	return M_JSON_ERROR_INVALID_IDENTIFIER;
+}
+
+static M_json_error_t M_json_reader_structural(M_json_reader_t *reader, unsigned char c)
+{
+	M_json_jsonpath_step_t *frame;
+
+	if (M_chr_isspace((char)c))
+		return M_JSON_ERROR_SUCCESS;
+
+	if (c == '/' && !(reader->flags & M_JSON_READER_DISALLOW_COMMENTS)) {
+		reader->token = M_JSON_READER_TOKEN_COMMENT_START;
+		return M_JSON_ERROR_SUCCESS;
+	}
+
+	switch (reader->state) {
+		case M_JSON_READER_STATE_VALUE:
+			if (reader->allow_close && c == ']')
+				return M_json_reader_close(reader);
+			return M_json_reader_value_start(reader, c);
+
+		case M_JSON_READER_STATE_KEY:
+			if (reader->allow_close && c == '}')
+				return M_json_reader_close(reader);
+			if (c != '"')
+				return M_JSON_ERROR_INVALID_PAIR_START;
+			reader->token        = M_JSON_READER_TOKEN_STRING;
+			reader->token_is_key = M_TRUE;
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_STATE_PAIR_SEP:
+			if (c != ':')
+				return M_JSON_ERROR_MISSING_PAIR_SEPARATOR;
+			reader->state = M_JSON_READER_STATE_VALUE;
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_STATE_NEXT:
+			frame = &reader->frames[reader->num_frames-1];
+			if (frame->type == M_JSON_TYPE_OBJECT) {
+				if (c == '}')
+					return M_json_reader_close(reader);
+				if (c != ',')
+					return M_JSON_ERROR_OBJECT_UNEXPECTED_CHAR;
+				reader->state = M_JSON_READER_STATE_KEY;
+			} else {
+				if (c == ']')
+					return M_json_reader_close(reader);
+				if (c != ',')
+					return M_JSON_ERROR_ARRAY_UNEXPECTED_CHAR;
+				frame->idx++;
+				reader->state = M_JSON_READER_STATE_VALUE;
+			}
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_STATE_DONE:
+			break;
+	}
+
+	return M_JSON_ERROR_EXPECTED_END;
+}
+
+/* Process one byte. Sets consumed to M_FALSE if the byte ended a token and needs
+ * to be processed again. */
+static M_json_error_t M_json_reader_process(M_json_reader_t *reader, unsigned char c, M_bool *consumed)
+{
+	*consumed = M_TRUE;
+
+	switch (reader->token) {
+		case M_JSON_READER_TOKEN_NONE:
+			return M_json_reader_structural(reader, c);
+
+		case M_JSON_READER_TOKEN_STRING:
+			if (c == '"')
+				return M_json_reader_string_done(reader);
+			if (c == '\\') {
+				reader->token = M_JSON_READER_TOKEN_STRING_ESCAPE;
+			} else if (c < 32) {
+				if (!(reader->flags & M_JSON_READER_REPLACE_BAD_CHARS))
+					return (c == '\n') ? M_JSON_ERROR_UNEXPECTED_NEWLINE : M_JSON_ERROR_UNEXPECTED_CONTROL_CHAR;
+				M_buf_add_byte(reader->buf, '?');
+			} else {
+				M_buf_add_byte(reader->buf, c);
+			}
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_TOKEN_STRING_ESCAPE:
+			reader->token = M_JSON_READER_TOKEN_STRING;
+			switch (c) {
+				case '"':
+				case '/':
+				case '\\':
+					M_buf_add_byte(reader->buf, c);
+					break;
+				case 'b':
+					M_buf_add_byte(reader->buf, '\b');
+					break;
+				case 'f':
+					M_buf_add_byte(reader->buf, '\f');
+					break;
+				case 'n':
+					M_buf_add_byte(reader->buf, '\n');
+					break;
+				case 'r':
+					M_buf_add_byte(reader->buf, '\r');
+					break;
+				case 't':
+					M_buf_add_byte(reader->buf, '\t');
+					break;
+				case 'u':
+					reader->token    = M_JSON_READER_TOKEN_STRING_UNICODE;
+					reader->uhex_len = 0;
+					break;
+				default:
+					return M_JSON_ERROR_UNEXPECTED_ESCAPE;
+			}
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_TOKEN_STRING_UNICODE:
+			if (!M_chr_ishex((char)c)) {
+				/* Short escape, the character is part of the string. */
+				*consumed = M_FALSE;
+				return M_json_reader_unicode_done(reader);
+			}
+			reader->uhex[reader->uhex_len++] = (char)c;
+			if (reader->uhex_len == 4)
+				return M_json_reader_unicode_done(reader);
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_TOKEN_NUMBER:
+			if (M_chr_isdigit((char)c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+				M_buf_add_byte(reader->buf, c);
+				return M_JSON_ERROR_SUCCESS;
+			}
+			*consumed = M_FALSE;
+			return M_json_reader_number_done(reader);
+
+		case M_JSON_READER_TOKEN_LITERAL:
+			if ((unsigned char)reader->literal[reader->literal_len] != c)
+				return (*reader->literal == 'n') ? M_JSON_ERROR_INVALID_NULL : M_JSON_ERROR_INVALID_BOOL;
+			reader->literal_len++;
+			if (reader->literal[reader->literal_len] == '\0') {
+				M_json_reader_value_t val;
+
+				reader->token = M_JSON_READER_TOKEN_NONE;
+				M_mem_set(&val, 0, sizeof(val));
+				if (*reader->literal == 'n') {
+					val.type = M_JSON_TYPE_NULL;
+				} else {
+					val.type    = M_JSON_TYPE_BOOL;
+					val.boolean = (*reader->literal == 't') ? M_TRUE : M_FALSE;
+				}
+				return M_json_reader_emit(reader, &val);
+			}
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_TOKEN_COMMENT_START:
+			if (c == '*') {
+				reader->token = M_JSON_READER_TOKEN_COMMENT_BLOCK;
+			} else if (c == '/') {
+				reader->token = M_JSON_READER_TOKEN_COMMENT_LINE;
+			} else {
+				return M_JSON_ERROR_UNEXPECTED_COMMENT_START;
+			}
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_TOKEN_COMMENT_LINE:
+			if (c == '\n')
+				reader->token = M_JSON_READER_TOKEN_NONE;
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_TOKEN_COMMENT_BLOCK:
+			if (c == '*')
+				reader->token = M_JSON_READER_TOKEN_COMMENT_BLOCK_END;
+			return M_JSON_ERROR_SUCCESS;
+
+		case M_JSON_READER_TOKEN_COMMENT_BLOCK_END:
+			if (c == '/') {
+				reader->token = M_JSON_READER_TOKEN_NONE;
+			} else if (c != '*') {
+				reader->token = M_JSON_READER_TOKEN_COMMENT_BLOCK;
+			}
+			return M_JSON_ERROR_SUCCESS;
+	}
+
+	return M_JSON_ERROR_GENERIC;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+M_json_reader_t *M_json_reader_create(const struct M_json_reader_callbacks *cbs, M_uint32 flags, void *thunk)
+{
+	M_json_reader_t *reader;
+
+	reader = M_malloc_zero(sizeof(*reader));
+	if (cbs != NULL)
+		M_mem_copy(&reader->cbs, cbs, sizeof(reader->cbs));
+	reader->flags = flags;
+	reader->thunk = thunk;
+	reader->buf   = M_buf_create();
+	reader->line  = 1;
+
+	return reader;
+}
+
+void M_json_reader_destroy(M_json_reader_t *reader)
+{
+	size_t i;
+
+	if (reader == NULL)
+		return;
+
+	for (i=0; i<reader->num_builds; i++)
+		M_json_node_destroy(reader->builds[i].root);
+	M_free(reader->builds);
+
+	for (i=0; i<reader->num_paths; i++)
+		M_json_reader_path_destroy(&reader->paths[i]);
+	M_free(reader->paths);
+
+	for (i=0; i<reader->num_frames; i++) {
+		M_free(reader->frames[i].key);
+		M_hash_strvp_destroy(reader->frame_keys[i], M_FALSE);
+	}
+	M_free(reader->frames);
+	M_free(reader->frame_keys);
+
+	M_buf_cancel(reader->buf);
+	M_free(reader);
+}
+
+M_bool M_json_reader_add_jsonpath(M_json_reader_t *reader, const char *search, M_json_reader_match_func match_func)
+{
+	M_json_reader_path_t path;
+
+	if (reader == NULL || search == NULL || match_func == NULL || reader->started)
+		return M_FALSE;
+
+	M_mem_set(&path, 0, sizeof(path));
+	path.jsonpath = M_json_jsonpath_compile(search);
+	if (!M_json_jsonpath_streamable(path.jsonpath)) {
+		M_json_jsonpath_destroy(path.jsonpath);
+		return M_FALSE;
+	}
+	path.search     = M_strdup(search);
+	path.match_func = match_func;
+
+	/* Builds point at their path so paths can't be moved once reading starts, which is
+	 * why they can only be added before then. */
+	reader->paths = M_realloc(reader->paths, (reader->num_paths + 1) * sizeof(*reader->paths));
+	reader->paths[reader->num_paths++] = path;
+
+	return M_TRUE;
+}
+
+M_json_error_t M_json_reader_read(M_json_reader_t *reader, const char *data, size_t data_len)
+{
+	const unsigned char *s = (const unsigned char *)data;
+	size_t               i = 0;
+	M_bool               consumed;
+
+	if (reader == NULL || (data == NULL && data_len != 0))
+		return M_JSON_ERROR_MISUSE;
+	if (reader->error != M_JSON_ERROR_SUCCESS)
+		return reader->error;
+	reader->started = M_TRUE;
+
+	while (i < data_len) {
+		/* Copy runs of plain string characters in one go. */
+		if (reader->token == M_JSON_READER_TOKEN_STRING) {
+			size_t j = i;
+
+			while (j < data_len && s[j] != '"' && s[j] != '\\' && s[j] >= 32)
+				j++;
+			if (j != i) {
+				M_buf_add_bytes(reader->buf, s+i, j-i);
+				reader->offset += j-i;
+				i               = j;
+				continue;
+			}
+		}
+
+		reader->error = M_json_reader_process(reader, s[i], &consumed);
+		if (reader->error != M_JSON_ERROR_SUCCESS)
+			return reader->error;
+
+		if (consumed) {
+			if (s[i] == '\n') {
+				reader->line++;
+				reader->line_start = reader->offset + 1;
+			}
+			reader->offset++;
+			i++;
+		}
+	}
+
+	return M_JSON_ERROR_SUCCESS;
+}
+
+M_json_error_t M_json_reader_finish(M_json_reader_t *reader)
+{
+	if (reader == NULL)
+		return M_JSON_ERROR_MISUSE;
+	if (reader->error != M_JSON_ERROR_SUCCESS)
+		return reader->error;
+
+	switch (reader->token) {
+		case M_JSON_READER_TOKEN_NONE:
+		case M_JSON_READER_TOKEN_COMMENT_LINE:
+			break;
+		case M_JSON_READER_TOKEN_NUMBER:
+			/* Numbers can only be inside of a container which can't be closed. */
+			break;
+		case M_JSON_READER_TOKEN_STRING:
+		case M_JSON_READER_TOKEN_STRING_ESCAPE:
+		case M_JSON_READER_TOKEN_STRING_UNICODE:
+			reader->error = M_JSON_ERROR_UNCLOSED_STRING;
+			return reader->error;
+		case M_JSON_READER_TOKEN_LITERAL:
+			reader->error = (*reader->literal == 'n') ? M_JSON_ERROR_INVALID_NULL : M_JSON_ERROR_INVALID_BOOL;
+			return reader->error;
+		case M_JSON_READER_TOKEN_COMMENT_START:
+			reader->error = M_JSON_ERROR_UNEXPECTED_COMMENT_START;
+			return reader->error;
+		case M_JSON_READER_TOKEN_COMMENT_BLOCK:
+		case M_JSON_READER_TOKEN_COMMENT_BLOCK_END:
+			reader->error = M_JSON_ERROR_MISSING_COMMENT_CLOSE;
+			return reader->error;
+	}
+
+	if (reader->state == M_JSON_READER_STATE_DONE)
+		return M_JSON_ERROR_SUCCESS;
+
+	if (reader->num_frames == 0) {
+		reader->error = M_JSON_ERROR_UNEXPECTED_END;
+	} else if (reader->frames[reader->num_frames-1].type == M_JSON_TYPE_OBJECT) {
+		reader->error = M_JSON_ERROR_UNCLOSED_OBJECT;
+	} else {
+		reader->error = M_JSON_ERROR_UNCLOSED_ARRAY;
+	}
+	return reader->error;
+}
+
+void M_json_reader_error_pos(const M_json_reader_t *reader, size_t *error_line, size_t *error_pos)
+{
+	if (reader == NULL)
+		return;
+
+	if (error_line == NULL) {
+		if (error_pos != NULL)
+			*error_pos = reader->offset;
+		return;
+	}
+
+	*error_line = reader->line;
+	if (error_pos != NULL)
+		*error_pos = reader->offset - reader->line_start + 1;
+}
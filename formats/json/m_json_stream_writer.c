@@ -0,0 +1,326 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "m_config.h"
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_formats.h>
+#include "json/m_json_int.h"
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* An open object or array. */
+typedef struct {
+	M_json_type_t type;
+	size_t        count;     /*!< Number of members or elements written. */
+	M_bool        have_key;  /*!< Object: a key was written and needs a value. */
+} M_json_writer_frame_t;
+
+struct M_json_writer {
+	M_buf_t                  *buf;
+	M_bool                    own_buf;
+	M_json_writer_flush_func  flush_func;
+	size_t                    flush_size;
+	void                     *thunk;
+	M_uint32                  flags;
+	M_bool                    error;
+	M_bool                    done;        /*!< Root value has been written. */
+
+	M_json_writer_frame_t    *frames;
+	size_t                    num_frames;
+	size_t                    frames_size;
+};
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static M_bool M_json_writer_prettyprint(const M_json_writer_t *writer)
+{
+	return (writer->flags & (M_JSON_WRITER_PRETTYPRINT_SPACE|M_JSON_WRITER_PRETTYPRINT_TAB)) ? M_TRUE : M_FALSE;
+}
+
+static M_bool M_json_writer_flush(M_json_writer_t *writer, M_bool force)
+{
+	if (writer->flush_func == NULL || M_buf_len(writer->buf) == 0)
+		return M_TRUE;
+	if (!force && M_buf_len(writer->buf) < writer->flush_size)
+		return M_TRUE;
+
+	if (!writer->flush_func(writer->buf, writer->thunk)) {
+		writer->error = M_TRUE;
+		return M_FALSE;
+	}
+	return M_TRUE;
+}
+
+/* Check a value can be written and write what goes in front of it.
+ * Separators are written before each member and element because it isn't
+ * known if the previous one was the last. */
+static M_bool M_json_writer_value_start(M_json_writer_t *writer)
+{
+	M_json_writer_frame_t *frame;
+	size_t                 depth;
+
+	if (writer == NULL || writer->error || writer->done)
+		return M_FALSE;
+
+	if (writer->num_frames == 0)
+		return M_TRUE;
+
+	frame = &writer->frames[writer->num_frames-1];
+	if (frame->type == M_JSON_TYPE_OBJECT) {
+		/* Key and separator have already been written. */
+		if (!frame->have_key)
+			return M_FALSE;
+		frame->have_key = M_FALSE;
+		return M_TRUE;
+	}
+
+	if (frame->count > 0) {
+		M_buf_add_byte(writer->buf, ',');
+		M_json_write_newline(writer->buf, writer->flags);
+	}
+	depth = writer->num_frames;
+	M_json_write_depth(writer->buf, &depth, writer->flags);
+	frame->count++;
+	return M_TRUE;
+}
+
+static M_bool M_json_writer_value_done(M_json_writer_t *writer, M_bool success)
+{
+	if (!success) {
+		writer->error = M_TRUE;
+		return M_FALSE;
+	}
+
+	if (writer->num_frames == 0)
+		writer->done = M_TRUE;
+
+	return M_json_writer_flush(writer, M_FALSE);
+}
+
+static M_bool M_json_writer_begin(M_json_writer_t *writer, M_json_type_t type)
+{
+	M_json_writer_frame_t *frame;
+
+	if (!M_json_writer_value_start(writer))
+		return M_FALSE;
+
+	if (writer->num_frames == writer->frames_size) {
+		writer->frames_size = (writer->frames_size == 0) ? 16 : writer->frames_size * 2;
+		writer->frames      = M_realloc(writer->frames, writer->frames_size * sizeof(*writer->frames));
+	}
+	frame = &writer->frames[writer->num_frames++];
+	M_mem_set(frame, 0, sizeof(*frame));
+	frame->type = type;
+
+	M_buf_add_byte(writer->buf, (type == M_JSON_TYPE_OBJECT) ? '{' : '[');
+	M_json_write_newline(writer->buf, writer->flags);
+
+	return M_json_writer_flush(writer, M_FALSE);
+}
+
+static M_bool M_json_writer_end(M_json_writer_t *writer, M_json_type_t type)
+{
+	M_json_writer_frame_t *frame;
+	size_t                 depth;
+
+	if (writer == NULL || writer->error || writer->num_frames == 0)
+		return M_FALSE;
+
+	frame = &writer->frames[writer->num_frames-1];
+	if (frame->type != type || frame->have_key)
+		return M_FALSE;
+
+	if (frame->count > 0)
+		M_json_write_newline(writer->buf, writer->flags);
+	writer->num_frames--;
+	depth = writer->num_frames;
+	M_json_write_depth(writer->buf, &depth, writer->flags);
+	M_buf_add_byte(writer->buf, (type == M_JSON_TYPE_OBJECT) ? '}' : ']');
+
+	return M_json_writer_value_done(writer, M_TRUE);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+M_json_writer_t *M_json_writer_create(M_buf_t *buf, M_uint32 flags)
+{
+	M_json_writer_t *writer;
+
+	if (buf == NULL)
+		return NULL;
+
+	writer        = M_malloc_zero(sizeof(*writer));
+	writer->buf   = buf;
+	writer->flags = flags;
+
+	return writer;
+}
+
+M_json_writer_t *M_json_writer_create_flush(M_json_writer_flush_func flush_func, size_t flush_size, M_uint32 flags, void *thunk)
+{
+	M_json_writer_t *writer;
+
+	if (flush_func == NULL)
+		return NULL;
+
+	writer             = M_malloc_zero(sizeof(*writer));
+	writer->buf        = M_buf_create();
+	writer->own_buf    = M_TRUE;
+	writer->flush_func = flush_func;
+	writer->flush_size = flush_size;
+	writer->flags      = flags;
+	writer->thunk      = thunk;
+
+	return writer;
+}
+
+void M_json_writer_destroy(M_json_writer_t *writer)
+{
+	if (writer == NULL)
+		return;
+
+	if (writer->own_buf)
+		M_buf_cancel(writer->buf);
+	M_free(writer->frames);
+	M_free(writer);
+}
+
+M_bool M_json_writer_object_begin(M_json_writer_t *writer)
+{
+	return M_json_writer_begin(writer, M_JSON_TYPE_OBJECT);
+}
+
+M_bool M_json_writer_object_end(M_json_writer_t *writer)
+{
+	return M_json_writer_end(writer, M_JSON_TYPE_OBJECT);
+}
+
+M_bool M_json_writer_array_begin(M_json_writer_t *writer)
+{
+	return M_json_writer_begin(writer, M_JSON_TYPE_ARRAY);
+}
+
+M_bool M_json_writer_array_end(M_json_writer_t *writer)
+{
+	return M_json_writer_end(writer, M_JSON_TYPE_ARRAY);
+}
+
+M_bool M_json_writer_key(M_json_writer_t *writer, const char *key)
+{
+	M_json_writer_frame_t *frame;
+	size_t                 depth;
+
+	if (writer == NULL || writer->error || writer->num_frames == 0 || key == NULL)
+		return M_FALSE;
+
+	frame = &writer->frames[writer->num_frames-1];
+	if (frame->type != M_JSON_TYPE_OBJECT || frame->have_key)
+		return M_FALSE;
+
+	if (frame->count > 0) {
+		M_buf_add_byte(writer->buf, ',');
+		M_json_write_newline(writer->buf, writer->flags);
+	}
+	depth = writer->num_frames;
+	M_json_write_depth(writer->buf, &depth, writer->flags);
+	if (!M_json_write_string(writer->buf, key, writer->flags)) {
+		writer->error = M_TRUE;
+		return M_FALSE;
+	}
+
+	if (M_json_writer_prettyprint(writer))
+		M_buf_add_byte(writer->buf, ' ');
+	M_buf_add_byte(writer->buf, ':');
+	if (M_json_writer_prettyprint(writer))
+		M_buf_add_byte(writer->buf, ' ');
+
+	frame->have_key = M_TRUE;
+	frame->count++;
+	return M_TRUE;
+}
+
+M_bool M_json_writer_string(M_json_writer_t *writer, const char *val)
+{
+	if (val == NULL)
+		return M_json_writer_null(writer);
+
+	if (!M_json_writer_value_start(writer))
+		return M_FALSE;
+	return M_json_writer_value_done(writer, M_json_write_string(writer->buf, val, writer->flags));
+}
+
+M_bool M_json_writer_integer(M_json_writer_t *writer, M_int64 val)
+{
+	if (!M_json_writer_value_start(writer))
+		return M_FALSE;
+	M_json_write_integer(writer->buf, val, writer->flags);
+	return M_json_writer_value_done(writer, M_TRUE);
+}
+
+M_bool M_json_writer_decimal(M_json_writer_t *writer, const M_decimal_t *val)
+{
+	if (val == NULL)
+		return M_FALSE;
+
+	if (!M_json_writer_value_start(writer))
+		return M_FALSE;
+	return M_json_writer_value_done(writer, M_json_write_decimal(writer->buf, val, writer->flags));
+}
+
+M_bool M_json_writer_bool(M_json_writer_t *writer, M_bool val)
+{
+	if (!M_json_writer_value_start(writer))
+		return M_FALSE;
+	M_buf_add_str(writer->buf, val ? "true" : "false");
+	return M_json_writer_value_done(writer, M_TRUE);
+}
+
+M_bool M_json_writer_null(M_json_writer_t *writer)
+{
+	if (!M_json_writer_value_start(writer))
+		return M_FALSE;
+	M_buf_add_str(writer->buf, "null");
+	return M_json_writer_value_done(writer, M_TRUE);
+}
+
+M_bool M_json_writer_node(M_json_writer_t *writer, const M_json_node_t *node)
+{
+	size_t depth;
+
+	if (node == NULL)
+		return M_FALSE;
+
+	if (!M_json_writer_value_start(writer))
+		return M_FALSE;
+	depth = writer->num_frames;
+	return M_json_writer_value_done(writer, M_json_write_node(node, writer->buf, &depth, writer->flags));
+}
+
+M_bool M_json_writer_finish(M_json_writer_t *writer)
+{
+	if (writer == NULL || writer->error || !writer->done)
+		return M_FALSE;
+
+	return M_json_writer_flush(writer, M_TRUE);
+}
@@ -33,9 +33,7 @@
 static M_int64 JAVASCRIPT_MIN_INT = -9007199254740991LL;
 static M_int64 JAVASCRIPT_MAX_INT =  9007199254740991LL;
 
-static M_bool M_json_write_node(const M_json_node_t *node, M_buf_t *buf, size_t *depth, M_uint32 flags);
-
-static void M_json_write_depth(M_buf_t *buf, size_t *depth, M_uint32 flags)
+void M_json_write_depth(M_buf_t *buf, size_t *depth, M_uint32 flags)
 {
 	if (flags & M_JSON_WRITER_PRETTYPRINT_SPACE) {
 		M_buf_add_fill(buf, ' ', (*depth)*2);
@@ -44,7 +42,7 @@ static void M_json_write_depth(M_buf_t *buf, size_t *depth, M_uint32 flags)
 	}
 }
 
-static void M_json_write_newline(M_buf_t *buf, M_uint32 flags)
+void M_json_write_newline(M_buf_t *buf, M_uint32 flags)
 {
 	if (!(flags & (M_JSON_WRITER_PRETTYPRINT_SPACE|M_JSON_WRITER_PRETTYPRINT_TAB))) {
 		return;
@@ -59,10 +57,10 @@ static void M_json_write_newline(M_buf_t *buf, M_uint32 flags)
 
 static M_bool M_json_write_node_object(const M_json_node_t *node, M_buf_t *buf, size_t *depth, M_uint32 flags)
 {
-	M_hash_strvp_enum_t *hashenum;
-	const char          *key;
-	void                *value;
-	size_t               len;
+	M_json_object_enum_t  objenum;
+	const char           *key;
+	M_json_node_t        *value;
+	size_t                len;
 
 	if (buf == NULL || node == NULL || node->type != M_JSON_TYPE_OBJECT)
 		return M_FALSE;
@@ -71,12 +69,14 @@ static M_bool M_json_write_node_object(const M_json_node_t *node, M_buf_t *buf,
 	M_json_write_newline(buf, flags);
 	(*depth)++;
 
-	len = M_hash_strvp_enumerate(node->data.json_object, &hashenum);
-	while (M_hash_strvp_enumerate_next(node->data.json_object, hashenum, &key, &value)) {
+	len = M_json_object_num_children(node);
+	M_json_object_enumerate(node, &objenum);
+	while (M_json_object_enumerate_next(&objenum, &key, &value)) {
 		M_json_write_depth(buf, depth, flags);
-		M_buf_add_byte(buf, '"');
-		M_buf_add_str(buf, key); 
-		M_buf_add_byte(buf, '"');
+		if (!M_json_write_string(buf, key, flags)) {
+			M_json_object_enumerate_free(&objenum);
+			return M_FALSE;
+		}
 
 		if (flags & (M_JSON_WRITER_PRETTYPRINT_SPACE|M_JSON_WRITER_PRETTYPRINT_TAB))
 			M_buf_add_byte(buf, ' ');
@@ -84,8 +84,10 @@ static M_bool M_json_write_node_object(const M_json_node_t *node, M_buf_t *buf,
 		if (flags & (M_JSON_WRITER_PRETTYPRINT_SPACE|M_JSON_WRITER_PRETTYPRINT_TAB))
 			M_buf_add_byte(buf, ' ');
 
-		if (!M_json_write_node((const M_json_node_t *)value, buf, depth, flags))
+		if (!M_json_write_node(value, buf, depth, flags)) {
+			M_json_object_enumerate_free(&objenum);
 			return M_FALSE;
+		}
 
 		len--;
 		if (len > 0) {
@@ -93,7 +95,7 @@ static M_bool M_json_write_node_object(const M_json_node_t *node, M_buf_t *buf,
 		}
 		M_json_write_newline(buf, flags);
 	}
-	M_hash_strvp_enumerate_free(hashenum);
+	M_json_object_enumerate_free(&objenum);
 
 	(*depth)--;
 	M_json_write_depth(buf, depth, flags);
@@ -133,7 +135,14 @@ static M_bool M_json_write_node_array(const M_json_node_t *node, M_buf_t *buf, s
 	return M_TRUE;
 }
 
-static M_bool M_json_write_node_string(const M_json_node_t *node, M_buf_t *buf, M_uint32 flags)
+/* Characters that can be copied as is. Everything else is either escaped or
+ * needs to be checked for being a valid utf-8 sequence. */
+static M_bool M_json_write_string_plain(unsigned char c)
+{
+	return c >= 32 && c < 128 && c != '"' && c != '\\' && c != '/';
+}
+
+M_bool M_json_write_string(M_buf_t *buf, const char *s, M_uint32 flags)
 {
 	const char *p;
 	char        uchr[8];
@@ -141,14 +150,26 @@ static M_bool M_json_write_node_string(const M_json_node_t *node, M_buf_t *buf,
 	M_uint32    cp;
 	size_t      len;
 	size_t      i;
+	size_t      j;
 
-	if (buf == NULL || node == NULL || node->type != M_JSON_TYPE_STRING)
+	if (buf == NULL)
 		return M_FALSE;
 
 	M_buf_add_byte(buf, '"');
-	len = M_str_len(node->data.json_string);
+	len = M_str_len(s);
 	for (i=0; i<len; i++) {
-		c = node->data.json_string[i];
+		/* Add runs of characters that don't need escaping in one go. */
+		for (j=i; j<len && M_json_write_string_plain((unsigned char)s[j]); j++)
+			;
+		if (j != i) {
+			M_buf_add_bytes(buf, s+i, j-i);
+			i = j;
+			if (i == len) {
+				break;
+			}
+		}
+
+		c = s[i];
 		switch (c) {
 			case '\b':
 				M_buf_add_str(buf, "\\b");
@@ -184,7 +205,7 @@ static M_bool M_json_write_node_string(const M_json_node_t *node, M_buf_t *buf,
 					M_snprintf(uchr, sizeof(uchr), "%04X", c);
 					M_buf_add_str(buf, uchr);
 				} else if ((unsigned char)c > 127) {
-					if (M_utf8_get_cp(node->data.json_string+i, &cp, &p) != M_UTF8_ERROR_SUCCESS) {
+					if (M_utf8_get_cp(s+i, &cp, &p) != M_UTF8_ERROR_SUCCESS) {
 						if (flags & M_JSON_WRITER_REPLACE_BAD_CHARS) {
 							M_buf_add_byte(buf, '?');
 						} else {
@@ -194,7 +215,7 @@ static M_bool M_json_write_node_string(const M_json_node_t *node, M_buf_t *buf,
 					}
 
 					if (flags & M_JSON_WRITER_DONT_ENCODE_UNICODE) {
-						M_buf_add_bytes(buf, node->data.json_string+i, (size_t)(p - (node->data.json_string+i)));
+						M_buf_add_bytes(buf, s+i, (size_t)(p - (s+i)));
 					} else {
 						M_buf_add_str(buf, "\\u");
 						M_snprintf(uchr, sizeof(uchr), "%04X", cp);
@@ -204,7 +225,7 @@ static M_bool M_json_write_node_string(const M_json_node_t *node, M_buf_t *buf,
 					 * when we come back around to the start of the loop it will
 					 * move one forward. This needs to be the byte before the next
 					 * one that will be processed. */
-					i += (size_t)(p - (node->data.json_string+i)-1);
+					i += (size_t)(p - (s+i)-1);
 				} else {
 					M_buf_add_byte(buf, (unsigned char)c);
 				}
@@ -215,45 +236,74 @@ static M_bool M_json_write_node_string(const M_json_node_t *node, M_buf_t *buf,
 	return M_TRUE;
 }
 
-static M_bool M_json_write_node_integer(const M_json_node_t *node, M_buf_t *buf, M_uint32 flags)
+static M_bool M_json_write_node_string(const M_json_node_t *node, M_buf_t *buf, M_uint32 flags)
 {
-	if (buf == NULL || node == NULL || node->type != M_JSON_TYPE_INTEGER)
+	if (buf == NULL || node == NULL || node->type != M_JSON_TYPE_STRING)
 		return M_FALSE;
 
-	if (!(flags & M_JSON_WRITER_NUMBER_NOCOMPAT) && (node->data.json_integer < JAVASCRIPT_MIN_INT || node->data.json_integer > JAVASCRIPT_MAX_INT))
-		M_buf_add_byte(buf, '"');
+	return M_json_write_string(buf, node->data.json_string, flags);
+}
+
+void M_json_write_integer(M_buf_t *buf, M_int64 val, M_uint32 flags)
+{
+	M_bool quote = M_FALSE;
 
-	M_buf_add_int(buf, node->data.json_integer);
+	if (!(flags & M_JSON_WRITER_NUMBER_NOCOMPAT) && (val < JAVASCRIPT_MIN_INT || val > JAVASCRIPT_MAX_INT))
+		quote = M_TRUE;
 
-	if (node->data.json_integer < JAVASCRIPT_MIN_INT || node->data.json_integer > JAVASCRIPT_MAX_INT)
+	if (quote)
 		M_buf_add_byte(buf, '"');
 
-	return M_TRUE;
+	M_buf_add_int(buf, val);
+
+	if (quote)
+		M_buf_add_byte(buf, '"');
 }
 
-static M_bool M_json_write_node_decimal(const M_json_node_t *node, M_buf_t *buf, M_uint32 flags)
+M_bool M_json_write_decimal(M_buf_t *buf, const M_decimal_t *val, M_uint32 flags)
 {
 	M_int64 i64v;
 	M_uint8 num_places;
+	M_bool  quote = M_FALSE;
 	M_bool  ret;
 
-	if (buf == NULL || node == NULL || node->type != M_JSON_TYPE_DECIMAL)
+	if (buf == NULL || val == NULL)
 		return M_FALSE;
 
-	i64v       = M_decimal_to_int(&(node->data.json_decimal), 0);
-	num_places = M_decimal_num_decimals(&(node->data.json_decimal));
+	i64v       = M_decimal_to_int(val, 0);
+	num_places = M_decimal_num_decimals(val);
 
 	if (!(flags & M_JSON_WRITER_NUMBER_NOCOMPAT) && (num_places > 15 || i64v < JAVASCRIPT_MIN_INT || i64v > JAVASCRIPT_MAX_INT))
+		quote = M_TRUE;
+
+	if (quote)
 		M_buf_add_byte(buf, '"');
 
-	ret = M_buf_add_decimal(buf, &(node->data.json_decimal), M_FALSE, -1, 0);
+	ret = M_buf_add_decimal(buf, val, M_FALSE, -1, 0);
 
-	if (!(flags & M_JSON_WRITER_NUMBER_NOCOMPAT) && (num_places > 15 || i64v < JAVASCRIPT_MIN_INT || i64v > JAVASCRIPT_MAX_INT))
+	if (quote)
 		M_buf_add_byte(buf, '"');
 
 	return ret;
 }
 
+static M_bool M_json_write_node_integer(const M_json_node_t *node, M_buf_t *buf, M_uint32 flags)
+{
+	if (buf == NULL || node == NULL || node->type != M_JSON_TYPE_INTEGER)
+		return M_FALSE;
+
+	M_json_write_integer(buf, node->data.json_integer, flags);
+	return M_TRUE;
+}
+
+static M_bool M_json_write_node_decimal(const M_json_node_t *node, M_buf_t *buf, M_uint32 flags)
+{
+	if (buf == NULL || node == NULL || node->type != M_JSON_TYPE_DECIMAL)
+		return M_FALSE;
+
+	return M_json_write_decimal(buf, &(node->data.json_decimal), flags);
+}
+
 static M_bool M_json_write_node_bool(const M_json_node_t *node, M_buf_t *buf)
 {
 	if (buf == NULL || node == NULL || node->type != M_JSON_TYPE_BOOL)
@@ -276,7 +326,7 @@ static M_bool M_json_write_node_null(const M_json_node_t *node, M_buf_t *buf)
 	return M_TRUE;
 }
 
-static M_bool M_json_write_node(const M_json_node_t *node, M_buf_t *buf, size_t *depth, M_uint32 flags)
+M_bool M_json_write_node(const M_json_node_t *node, M_buf_t *buf, size_t *depth, M_uint32 flags)
 {
 	if (buf == NULL || node == NULL)
 		return M_FALSE;
@@ -25,16 +25,37 @@
 
 #include <mstdlib/mstdlib.h>
 #include <mstdlib/mstdlib_formats.h>
+#include "table/m_table_int.h"
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/* Storage for a column that isn't stored as strings. Row ids are allocated
+ * densely so they're used directly as the index into the value arrays. */
+typedef struct {
+	M_table_coltype_t   type;
+	size_t              size;        /* Number of row ids the arrays can hold. */
+	M_uint8            *isset;       /* Whether the row has a value. */
+	M_int64            *ints;        /* M_TABLE_COLTYPE_INT64 values. */
+	M_decimal_t        *decs;        /* M_TABLE_COLTYPE_DECIMAL values. */
+	char              **strs;        /* String form of numeric values. Created on request. */
+	size_t             *codes;       /* M_TABLE_COLTYPE_DICT index into dict. */
+	char              **dict;        /* Unique values for M_TABLE_COLTYPE_DICT. */
+	size_t              dict_len;
+	size_t              dict_size;
+	M_hash_stru64_t    *dict_lookup; /* Value -> index into dict. */
+} M_table_typed_col_t;
+
 struct M_table {
 	M_list_u64_t    *col_order;            /* List of column ids. */
 	M_hash_u64str_t *col_id_name;          /* Column ids -> column names. */
 	M_hash_stru64_t *col_name_id;          /* Column name -> column id. */
 
+	M_hash_u64vp_t  *typed_cols;           /* Column id -> M_table_typed_col_t for columns not stored as strings. */
+
 	M_list_u64_t    *row_order;            /* List of row ids. */
 	M_hash_u64vp_t  *rows;                 /* Row id -> M_hash_u64str_t (column id -> value) */
+	M_uint64         rowid_next;           /* Next row id that has never been used. */
+	M_list_u64_t    *rowid_free;           /* Row ids of removed rows that can be used again. */
 
 	M_rand_t        *rand;                 /* Used for generating ids. */
 	M_uint32         flags;                /* Flags from creation. */
@@ -48,6 +69,262 @@ struct M_table {
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+static M_table_typed_col_t *M_table_typed_col_create(M_table_coltype_t type)
+{
+	M_table_typed_col_t *tcol;
+
+	tcol       = M_malloc_zero(sizeof(*tcol));
+	tcol->type = type;
+	if (type == M_TABLE_COLTYPE_DICT)
+		tcol->dict_lookup = M_hash_stru64_create(8, 75, M_HASH_STRU64_NONE);
+
+	return tcol;
+}
+
+static void M_table_typed_col_destroy(void *arg)
+{
+	M_table_typed_col_t *tcol = arg;
+	size_t               i;
+
+	if (tcol == NULL)
+		return;
+
+	if (tcol->strs != NULL) {
+		for (i=0; i<tcol->size; i++) {
+			M_free(tcol->strs[i]);
+		}
+	}
+	for (i=0; i<tcol->dict_len; i++) {
+		M_free(tcol->dict[i]);
+	}
+
+	M_free(tcol->isset);
+	M_free(tcol->ints);
+	M_free(tcol->decs);
+	M_free(tcol->strs);
+	M_free(tcol->codes);
+	M_free(tcol->dict);
+	M_hash_stru64_destroy(tcol->dict_lookup);
+	M_free(tcol);
+}
+
+static M_table_typed_col_t *M_table_typed_col_duplicate(const M_table_typed_col_t *tcol)
+{
+	M_table_typed_col_t *rt;
+	size_t               i;
+
+	rt            = M_table_typed_col_create(tcol->type);
+	rt->size      = tcol->size;
+	rt->dict_len  = tcol->dict_len;
+	rt->dict_size = tcol->dict_len;
+
+	if (tcol->size != 0) {
+		rt->isset = M_memdup(tcol->isset, tcol->size * sizeof(*tcol->isset));
+		if (tcol->ints != NULL)
+			rt->ints = M_memdup(tcol->ints, tcol->size * sizeof(*tcol->ints));
+		if (tcol->decs != NULL)
+			rt->decs = M_memdup(tcol->decs, tcol->size * sizeof(*tcol->decs));
+		if (tcol->strs != NULL)
+			rt->strs = M_malloc_zero(tcol->size * sizeof(*tcol->strs));
+		if (tcol->codes != NULL) {
+			rt->codes = M_memdup(tcol->codes, tcol->size * sizeof(*tcol->codes));
+		}
+	}
+
+	if (tcol->dict_len != 0) {
+		rt->dict = M_malloc(tcol->dict_len * sizeof(*rt->dict));
+		for (i=0; i<tcol->dict_len; i++) {
+			rt->dict[i] = M_strdup(tcol->dict[i]);
+			M_hash_stru64_insert(rt->dict_lookup, rt->dict[i], i);
+		}
+	}
+
+	return rt;
+}
+
+static void M_table_typed_col_grow(M_table_typed_col_t *tcol, M_uint64 rowid)
+{
+	size_t size;
+
+	if (rowid < tcol->size)
+		return;
+
+	size = M_MAX(tcol->size * 2, 16);
+	while (size <= rowid)
+		size *= 2;
+
+	tcol->isset = M_realloc_zero(tcol->isset, size * sizeof(*tcol->isset));
+	switch (tcol->type) {
+		case M_TABLE_COLTYPE_INT64:
+			tcol->ints = M_realloc_zero(tcol->ints, size * sizeof(*tcol->ints));
+			tcol->strs = M_realloc_zero(tcol->strs, size * sizeof(*tcol->strs));
+			break;
+		case M_TABLE_COLTYPE_DECIMAL:
+			tcol->decs = M_realloc_zero(tcol->decs, size * sizeof(*tcol->decs));
+			tcol->strs = M_realloc_zero(tcol->strs, size * sizeof(*tcol->strs));
+			break;
+		case M_TABLE_COLTYPE_DICT:
+			tcol->codes = M_realloc_zero(tcol->codes, size * sizeof(*tcol->codes));
+			break;
+		case M_TABLE_COLTYPE_STRING:
+			break;
+	}
+	tcol->size = size;
+}
+
+static M_bool M_table_typed_col_isset(const M_table_typed_col_t *tcol, M_uint64 rowid)
+{
+	return rowid < tcol->size && tcol->isset[rowid];
+}
+
+static void M_table_typed_col_clear(M_table_typed_col_t *tcol, M_uint64 rowid)
+{
+	if (!M_table_typed_col_isset(tcol, rowid))
+		return;
+
+	tcol->isset[rowid] = 0;
+	if (tcol->strs != NULL) {
+		M_free(tcol->strs[rowid]);
+		tcol->strs[rowid] = NULL;
+	}
+}
+
+static M_bool M_table_typed_col_has_data(const M_table_typed_col_t *tcol)
+{
+	size_t i;
+
+	for (i=0; i<tcol->size; i++) {
+		if (tcol->isset[i]) {
+			return M_TRUE;
+		}
+	}
+	return M_FALSE;
+}
+
+/* Numeric values must be the entire string. An empty string is no value. */
+static M_bool M_table_typed_col_parse(const M_table_typed_col_t *tcol, const char *val, M_int64 *ival, M_decimal_t *dval)
+{
+	const char *end = NULL;
+	size_t      len = M_str_len(val);
+
+	switch (tcol->type) {
+		case M_TABLE_COLTYPE_INT64:
+			if (M_str_to_int64_ex(val, len, 10, ival, &end) != M_STR_INT_SUCCESS || end != val+len)
+				return M_FALSE;
+			break;
+		case M_TABLE_COLTYPE_DECIMAL:
+			if (M_decimal_from_str(val, len, dval, &end) != M_DECIMAL_SUCCESS || end != val+len)
+				return M_FALSE;
+			break;
+		case M_TABLE_COLTYPE_DICT:
+		case M_TABLE_COLTYPE_STRING:
+			break;
+	}
+	return M_TRUE;
+}
+
+static M_bool M_table_typed_col_valid(const M_table_typed_col_t *tcol, const char *val)
+{
+	M_int64     ival;
+	M_decimal_t dval;
+
+	if (M_str_isempty(val))
+		return M_TRUE;
+	return M_table_typed_col_parse(tcol, val, &ival, &dval);
+}
+
+static M_bool M_table_typed_col_set(M_table_typed_col_t *tcol, M_uint64 rowid, const char *val)
+{
+	M_int64     ival = 0;
+	M_decimal_t dval;
+	M_uint64    code;
+
+	if (val == NULL || (tcol->type != M_TABLE_COLTYPE_DICT && *val == '\0')) {
+		M_table_typed_col_clear(tcol, rowid);
+		return M_TRUE;
+	}
+
+	M_decimal_create(&dval);
+	if (!M_table_typed_col_parse(tcol, val, &ival, &dval))
+		return M_FALSE;
+
+	M_table_typed_col_clear(tcol, rowid);
+	M_table_typed_col_grow(tcol, rowid);
+
+	switch (tcol->type) {
+		case M_TABLE_COLTYPE_INT64:
+			tcol->ints[rowid] = ival;
+			break;
+		case M_TABLE_COLTYPE_DECIMAL:
+			M_decimal_duplicate(&tcol->decs[rowid], &dval);
+			break;
+		case M_TABLE_COLTYPE_DICT:
+			if (!M_hash_stru64_get(tcol->dict_lookup, val, &code)) {
+				if (tcol->dict_len == tcol->dict_size) {
+					tcol->dict_size = M_MAX(tcol->dict_size * 2, 16);
+					tcol->dict      = M_realloc(tcol->dict, tcol->dict_size * sizeof(*tcol->dict));
+				}
+				code                       = tcol->dict_len;
+				tcol->dict[tcol->dict_len] = M_strdup(val);
+				M_hash_stru64_insert(tcol->dict_lookup, val, code);
+				tcol->dict_len++;
+			}
+			tcol->codes[rowid] = (size_t)code;
+			break;
+		case M_TABLE_COLTYPE_STRING:
+			break;
+	}
+
+	tcol->isset[rowid] = 1;
+	return M_TRUE;
+}
+
+/* Numeric values are written into buf. Dictionary values are returned directly. */
+static const char *M_table_typed_col_get_buf(const M_table_typed_col_t *tcol, M_uint64 rowid, char *buf, size_t buf_len)
+{
+	if (!M_table_typed_col_isset(tcol, rowid))
+		return NULL;
+
+	switch (tcol->type) {
+		case M_TABLE_COLTYPE_INT64:
+			M_snprintf(buf, buf_len, "%lld", (long long)tcol->ints[rowid]);
+			return buf;
+		case M_TABLE_COLTYPE_DECIMAL:
+			if (M_decimal_to_str(&tcol->decs[rowid], buf, buf_len) != M_DECIMAL_SUCCESS)
+				return NULL;
+			return buf;
+		case M_TABLE_COLTYPE_DICT:
+			return tcol->dict[tcol->codes[rowid]];
+		case M_TABLE_COLTYPE_STRING:
+			break;
+	}
+	return NULL;
+}
+
+/* The string form of numeric values is kept until the value changes so the
+ * pointer can be returned like any other cell. */
+static const char *M_table_typed_col_get(M_table_typed_col_t *tcol, M_uint64 rowid)
+{
+	char        buf[64];
+	const char *val;
+
+	if (!M_table_typed_col_isset(tcol, rowid))
+		return NULL;
+
+	if (tcol->type == M_TABLE_COLTYPE_DICT)
+		return tcol->dict[tcol->codes[rowid]];
+
+	if (tcol->strs[rowid] == NULL) {
+		val = M_table_typed_col_get_buf(tcol, rowid, buf, sizeof(buf));
+		if (val == NULL)
+			return NULL;
+		tcol->strs[rowid] = M_strdup(val);
+	}
+	return tcol->strs[rowid];
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 static int table_colname_compar(const void *arg1, const void *arg2, void *thunk)
 {
 	M_table_t  *table = thunk;
@@ -73,16 +350,27 @@ static int table_colname_compar(const void *arg1, const void *arg2, void *thunk)
 	return table->primary_sort(&v1, &v2, table->sort_thunk);
 }
 
+static const char *M_table_cell_get_int(const M_table_t *table, M_uint64 rowid, M_uint64 colid)
+{
+	M_hash_u64str_t     *row_data;
+	M_table_typed_col_t *tcol;
+
+	if (M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol))
+		return M_table_typed_col_get(tcol, rowid);
+
+	if (!M_hash_u64vp_get(table->rows, rowid, (void **)&row_data))
+		return NULL;
+	return M_hash_u64str_get_direct(row_data, colid);
+}
+
 static int table_coldata_compar(const void *arg1, const void *arg2, void *thunk)
 {
-	M_table_t       *table = thunk;
-	M_hash_u64str_t *d1;
-	M_hash_u64str_t *d2;
-	const char      *v1    = NULL;
-	const char      *v2    = NULL;
-	M_uint64         id1   = 0;
-	M_uint64         id2   = 0;
-	int              ret;
+	M_table_t  *table = thunk;
+	const char *v1    = NULL;
+	const char *v2    = NULL;
+	M_uint64    id1   = 0;
+	M_uint64    id2   = 0;
+	int         ret;
 
 	/* Get the rowids that have been sent in. */
 	if (arg1 != NULL)
@@ -90,15 +378,13 @@ static int table_coldata_compar(const void *arg1, const void *arg2, void *thunk)
 	if (arg2 != NULL)
 		id2 = *(M_uint64 const *)arg2;
 
-	/* Get the row data for each rowid. */
-	d1 = M_hash_u64vp_get_direct(table->rows, id1);
-	d2 = M_hash_u64vp_get_direct(table->rows, id2);
-
 	/* Get the values that are actually going to be compared from the
  	 * ids that have been sent in. */
-	if (!M_hash_u64str_get(d1, table->sort_colid, &v1))
+	v1 = M_table_cell_get_int(table, id1, table->sort_colid);
+	v2 = M_table_cell_get_int(table, id2, table->sort_colid);
+	if (v1 == NULL)
 		v1 = "";
-	if (!M_hash_u64str_get(d2, table->sort_colid, &v2))
+	if (v2 == NULL)
 		v2 = "";
 
 	/* Sort based on the column name. */
@@ -107,9 +393,11 @@ static int table_coldata_compar(const void *arg1, const void *arg2, void *thunk)
 	/* If they're the same run a secondary sort if present. */
 	if (ret == 0 && table->secondary_sort != NULL) {
 		/* Get the value for the secondary column. */
-		if (!M_hash_u64str_get(d1, table->secondary_sort_colid, &v1))
+		v1 = M_table_cell_get_int(table, id1, table->secondary_sort_colid);
+		v2 = M_table_cell_get_int(table, id2, table->secondary_sort_colid);
+		if (v1 == NULL)
 			v1 = "";
-		if (!M_hash_u64str_get(d2, table->secondary_sort_colid, &v2))
+		if (v2 == NULL)
 			v2 = "";
 
 		/* Sort the secondary column. */
@@ -118,22 +406,205 @@ static int table_coldata_compar(const void *arg1, const void *arg2, void *thunk)
 	return ret;
 }
 
-static M_uint64 generate_id(M_table_t *table, M_bool is_cols)
+static M_uint64 generate_id(M_table_t *table)
 {
 	M_uint64 id;
 
 	do {
 		id = M_rand(table->rand);
-	} while (id != 0 && ((is_cols && M_hash_u64str_get(table->col_id_name, id, NULL)) || (!is_cols && M_hash_u64vp_get(table->rows, id, NULL))));
+	} while (id != 0 && M_hash_u64str_get(table->col_id_name, id, NULL));
 
 	return id;
 }
 
+/* Row ids are kept dense so typed columns can use them as an array index. */
+static M_uint64 M_table_rowid_alloc(M_table_t *table)
+{
+	if (M_list_u64_len(table->rowid_free) > 0)
+		return M_list_u64_take_last(table->rowid_free);
+	return table->rowid_next++;
+}
+
+static void M_table_rowid_release(M_table_t *table, M_uint64 rowid)
+{
+	M_hash_u64vp_enum_t *he;
+	M_table_typed_col_t *tcol;
+
+	M_hash_u64vp_remove(table->rows, rowid, M_TRUE);
+
+	M_hash_u64vp_enumerate(table->typed_cols, &he);
+	while (M_hash_u64vp_enumerate_next(table->typed_cols, he, NULL, (void **)&tcol)) {
+		M_table_typed_col_clear(tcol, rowid);
+	}
+	M_hash_u64vp_enumerate_free(he);
+
+	M_list_u64_insert(table->rowid_free, rowid);
+}
+
+static M_bool M_table_row_has_typed_data(const M_table_t *table, M_uint64 rowid)
+{
+	M_hash_u64vp_enum_t *he;
+	M_table_typed_col_t *tcol;
+	M_bool               have = M_FALSE;
+
+	M_hash_u64vp_enumerate(table->typed_cols, &he);
+	while (M_hash_u64vp_enumerate_next(table->typed_cols, he, NULL, (void **)&tcol)) {
+		if (M_table_typed_col_isset(tcol, rowid)) {
+			have = M_TRUE;
+			break;
+		}
+	}
+	M_hash_u64vp_enumerate_free(he);
+
+	return have;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+typedef struct {
+	M_uint64 key;
+	M_uint64 rowid;
+} M_table_sort_key_t;
+
+/* Stable LSD radix sort. Byte positions where every key is the same are skipped
+ * so small ranges of values only take a few passes. */
+static void M_table_sort_radix(M_table_sort_key_t *keys, size_t len)
+{
+	M_table_sort_key_t *tmp;
+	M_table_sort_key_t *src = keys;
+	M_table_sort_key_t *dst;
+	size_t              counts[256];
+	size_t              shift;
+	size_t              sum;
+	size_t              cnt;
+	size_t              i;
+
+	if (len < 2)
+		return;
+
+	tmp = M_malloc(len * sizeof(*tmp));
+	dst = tmp;
+
+	for (shift=0; shift<64; shift+=8) {
+		M_mem_set(counts, 0, sizeof(counts));
+		for (i=0; i<len; i++) {
+			counts[(src[i].key >> shift) & 0xFF]++;
+		}
+		if (counts[(src[0].key >> shift) & 0xFF] == len)
+			continue;
+
+		for (i=0, sum=0; i<256; i++) {
+			cnt       = counts[i];
+			counts[i] = sum;
+			sum      += cnt;
+		}
+		for (i=0; i<len; i++) {
+			dst[counts[(src[i].key >> shift) & 0xFF]++] = src[i];
+		}
+
+		dst = src;
+		src = (src == keys) ? tmp : keys;
+	}
+
+	if (src != keys)
+		M_mem_copy(keys, src, len * sizeof(*keys));
+	M_free(tmp);
+}
+
+static int table_dict_compar(const void *arg1, const void *arg2, void *thunk)
+{
+	M_table_t  *table = thunk;
+	const char *v1    = *(char * const *)arg1;
+	const char *v2    = *(char * const *)arg2;
+
+	return table->primary_sort(&v1, &v2, table->sort_thunk);
+}
+
+static int table_decimal_compar(const void *arg1, const void *arg2, void *thunk)
+{
+	const M_table_typed_col_t *tcol = thunk;
+	const M_table_sort_key_t  *k1   = arg1;
+	const M_table_sort_key_t  *k2   = arg2;
+
+	return M_decimal_cmp(&tcol->decs[k1->rowid], &tcol->decs[k2->rowid]);
+}
+
+/* Sort the row ids by the values in a typed column without going though strings.
+ * Rows without a value sort first the same way they do as an empty string. The
+ * sort is stable. */
+static void M_table_column_sort_typed(M_table_t *table, M_table_typed_col_t *tcol, M_uint64 *rowids, size_t len)
+{
+	M_table_sort_key_t *keys;
+	char              **dict  = NULL;
+	M_uint64           *ranks = NULL;
+	M_uint64            code;
+	M_uint64            rank  = 0;
+	size_t              nulls = 0;
+	size_t              num   = 0;
+	size_t              i;
+
+	/* Dictionary values are sorted once and each row sorts on the position
+	 * of its value. Values that compare equal share a position. */
+	if (tcol->type == M_TABLE_COLTYPE_DICT && tcol->dict_len > 0) {
+		dict = M_memdup(tcol->dict, tcol->dict_len * sizeof(*dict));
+		M_sort_qsort(dict, tcol->dict_len, sizeof(*dict), table_dict_compar, table);
+
+		ranks = M_malloc(tcol->dict_len * sizeof(*ranks));
+		for (i=0; i<tcol->dict_len; i++) {
+			M_hash_stru64_get(tcol->dict_lookup, dict[i], &code);
+			if (i > 0 && table_dict_compar(&dict[i-1], &dict[i], table) == 0) {
+				ranks[code] = rank;
+			} else {
+				ranks[code] = ++rank;
+			}
+		}
+		M_free(dict);
+	}
+
+	/* Rows without a value keep their order at the front. */
+	keys = M_malloc(len * sizeof(*keys));
+	for (i=0; i<len; i++) {
+		if (!M_table_typed_col_isset(tcol, rowids[i])) {
+			rowids[nulls++] = rowids[i];
+			continue;
+		}
+
+		keys[num].rowid = rowids[i];
+		switch (tcol->type) {
+			case M_TABLE_COLTYPE_INT64:
+				/* Flip the sign bit so negative values order before positive. */
+				keys[num].key = ((M_uint64)tcol->ints[rowids[i]]) ^ ((M_uint64)1 << 63);
+				break;
+			case M_TABLE_COLTYPE_DICT:
+				keys[num].key = ranks[tcol->codes[rowids[i]]];
+				break;
+			case M_TABLE_COLTYPE_DECIMAL:
+			case M_TABLE_COLTYPE_STRING:
+				keys[num].key = 0;
+				break;
+		}
+		num++;
+	}
+	if (tcol->type == M_TABLE_COLTYPE_DECIMAL) {
+		M_sort_mergesort(keys, num, sizeof(*keys), table_decimal_compar, tcol);
+	} else {
+		M_table_sort_radix(keys, num);
+	}
+
+	for (i=0; i<num; i++) {
+		rowids[nulls+i] = keys[i].rowid;
+	}
+
+	M_free(keys);
+	M_free(ranks);
+}
+
 static void M_table_column_sort_data_int(M_table_t *table, M_uint64 colid, M_sort_compar_t primary_sort, M_uint64 secondary_colid, M_sort_compar_t secondary_sort, void *thunk)
 {
-	M_uint64 *rowids;
-	size_t    len;
-	size_t    i;
+	M_table_typed_col_t *tcol = NULL;
+	M_uint64            *rowids;
+	size_t               len;
+	size_t               i;
 
 	if (table == NULL)
 		return;
@@ -160,7 +631,23 @@ static void M_table_column_sort_data_int(M_table_t *table, M_uint64 colid, M_sor
 	table->sort_colid           = colid;
 	table->secondary_sort_colid = secondary_colid;
 
-	M_sort_qsort(rowids, len, sizeof(rowids[0]), table_coldata_compar, table);
+	if (primary_sort == NULL)
+		M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol);
+
+	if (tcol != NULL) {
+		/* Typed columns sort on their values. A secondary sort is applied
+ 		 * first so the stable typed sort keeps it for equal values. */
+		if (secondary_sort != NULL) {
+			table->primary_sort   = secondary_sort;
+			table->sort_colid     = secondary_colid;
+			table->secondary_sort = NULL;
+			M_sort_mergesort(rowids, len, sizeof(rowids[0]), table_coldata_compar, table);
+			table->primary_sort   = (table->flags & M_TABLE_COLNAME_CASECMP) ? M_sort_compar_str_casecmp : M_sort_compar_str;
+		}
+		M_table_column_sort_typed(table, tcol, rowids, len);
+	} else {
+		M_sort_qsort(rowids, len, sizeof(rowids[0]), table_coldata_compar, table);
+	}
 
 	table->primary_sort         = NULL;
 	table->secondary_sort       = NULL;
@@ -195,6 +682,7 @@ static void M_table_column_remove_int(M_table_t *table, M_uint64 colid)
 	colname = M_hash_u64str_get_direct(table->col_id_name, colid);
 	M_hash_stru64_remove(table->col_name_id, colname);
 	M_hash_u64str_remove(table->col_id_name, colid);
+	M_hash_u64vp_remove(table->typed_cols, colid, M_TRUE);
 
 	/* Go though each row and remove the column data. */
 	M_hash_u64vp_enumerate(table->rows, &he);
@@ -220,7 +708,7 @@ static M_bool M_table_column_insert_at_int(M_table_t *table, size_t idx, const c
 		}
 	}
 
-	*colid = generate_id(table, M_TRUE);
+	*colid = generate_id(table);
 	M_list_u64_insert_at(table->col_order, *colid, idx);
 
 	if (!M_str_isempty(colname)) {
@@ -231,6 +719,66 @@ static M_bool M_table_column_insert_at_int(M_table_t *table, size_t idx, const c
 	return M_TRUE;
 }
 
+static M_bool M_table_column_set_type_int(M_table_t *table, M_uint64 colid, M_table_coltype_t type)
+{
+	M_table_typed_col_t *tcol     = NULL;
+	M_table_typed_col_t *new_tcol = NULL;
+	M_hash_u64vp_enum_t *he;
+	M_hash_u64str_t     *row_data;
+	const char          *val;
+	M_uint64             rowid;
+	size_t               len;
+	size_t               i;
+
+	M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol);
+	if ((tcol == NULL && type == M_TABLE_COLTYPE_STRING) || (tcol != NULL && tcol->type == type))
+		return M_TRUE;
+
+	/* Convert every value first so nothing changes if one can't be. */
+	len = M_list_u64_len(table->row_order);
+	if (type != M_TABLE_COLTYPE_STRING) {
+		new_tcol = M_table_typed_col_create(type);
+		for (i=0; i<len; i++) {
+			rowid = M_list_u64_at(table->row_order, i);
+			if (!M_table_typed_col_set(new_tcol, rowid, M_table_cell_get_int(table, rowid, colid))) {
+				M_table_typed_col_destroy(new_tcol);
+				return M_FALSE;
+			}
+		}
+	}
+
+	if (tcol == NULL) {
+		/* The values now live in the typed column. */
+		M_hash_u64vp_enumerate(table->rows, &he);
+		while (M_hash_u64vp_enumerate_next(table->rows, he, NULL, (void **)&row_data)) {
+			M_hash_u64str_remove(row_data, colid);
+		}
+		M_hash_u64vp_enumerate_free(he);
+	} else if (new_tcol == NULL) {
+		/* Move the values back into the rows as strings. */
+		for (i=0; i<len; i++) {
+			rowid = M_list_u64_at(table->row_order, i);
+			val   = M_table_typed_col_get(tcol, rowid);
+			if (val == NULL)
+				continue;
+
+			if (!M_hash_u64vp_get(table->rows, rowid, (void **)&row_data)) {
+				row_data = M_hash_u64str_create(8, 75, M_HASH_U64STR_NONE);
+				M_hash_u64vp_insert(table->rows, rowid, row_data);
+			}
+			M_hash_u64str_insert(row_data, colid, val);
+		}
+	}
+
+	if (new_tcol == NULL) {
+		M_hash_u64vp_remove(table->typed_cols, colid, M_TRUE);
+	} else {
+		M_hash_u64vp_insert(table->typed_cols, colid, new_tcol);
+	}
+
+	return M_TRUE;
+}
+
 static M_bool M_table_row_insert_at_int(M_table_t *table, size_t idx, M_uint64 *rowid)
 {
 	M_uint64 myrowid;
@@ -241,15 +789,19 @@ static M_bool M_table_row_insert_at_int(M_table_t *table, size_t idx, M_uint64 *
 	if (table == NULL || idx > M_list_u64_len(table->row_order))
 		return M_FALSE;
 
-	*rowid = generate_id(table, M_FALSE);
+	*rowid = M_table_rowid_alloc(table);
 	M_list_u64_insert_at(table->row_order, *rowid, idx);
 
 	return M_TRUE;
 }
 
-static void M_table_cell_set_int(M_table_t *table, M_uint64 rowid, M_uint64 colid, const char *val)
+static M_bool M_table_cell_set_int(M_table_t *table, M_uint64 rowid, M_uint64 colid, const char *val)
 {
-	M_hash_u64str_t *row_data;
+	M_hash_u64str_t     *row_data;
+	M_table_typed_col_t *tcol;
+
+	if (M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol))
+		return M_table_typed_col_set(tcol, rowid, val);
 
 	if (!M_hash_u64vp_get(table->rows, rowid, (void **)&row_data)) {
 		row_data = M_hash_u64str_create(8, 75, M_HASH_U64STR_NONE);
@@ -261,15 +813,8 @@ static void M_table_cell_set_int(M_table_t *table, M_uint64 rowid, M_uint64 coli
 	} else {
 		M_hash_u64str_insert(row_data, colid, val);
 	}
-}
 
-static const char *M_table_cell_get_int(const M_table_t *table, M_uint64 rowid, M_uint64 colid)
-{
-	M_hash_u64str_t *row_data;
-
-	if (!M_hash_u64vp_get(table->rows, rowid, (void **)&row_data))
-		return NULL;
-	return M_hash_u64str_get_direct(row_data, colid);
+	return M_TRUE;
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -289,10 +834,12 @@ M_table_t *M_table_create(M_uint32 flags)
 	if (flags & M_TABLE_COLNAME_CASECMP)
 		pflags |= M_HASH_STRU64_CASECMP;
 	table->col_name_id = M_hash_stru64_create(8, 75, pflags);
+	table->typed_cols  = M_hash_u64vp_create(8, 75, M_HASH_U64VP_NONE, M_table_typed_col_destroy);
 
 	/* Rows */
-	table->row_order = M_list_u64_create(M_LIST_U64_NONE);
-	table->rows      = M_hash_u64vp_create(8, 75, M_HASH_U64VP_NONE, (void (*)(void *))M_hash_u64str_destroy);
+	table->row_order  = M_list_u64_create(M_LIST_U64_NONE);
+	table->rows       = M_hash_u64vp_create(8, 75, M_HASH_U64VP_NONE, (void (*)(void *))M_hash_u64str_destroy);
+	table->rowid_free = M_list_u64_create(M_LIST_U64_NONE);
 
 	/* Other. */
 	table->rand  = M_rand_create(0);
@@ -309,8 +856,10 @@ void M_table_destroy(M_table_t *table)
 	M_list_u64_destroy(table->col_order);
 	M_hash_u64str_destroy(table->col_id_name);
 	M_hash_stru64_destroy(table->col_name_id);
+	M_hash_u64vp_destroy(table->typed_cols, M_TRUE);
 	M_list_u64_destroy(table->row_order);
 	M_hash_u64vp_destroy(table->rows, M_TRUE);
+	M_list_u64_destroy(table->rowid_free);
 
 	M_rand_destroy(table->rand);
 
@@ -474,6 +1023,7 @@ size_t M_table_column_remove_empty_columns(M_table_t *table)
 {
 	M_hash_u64vp_enum_t *he;
 	M_hash_u64str_t     *row_data;
+	M_table_typed_col_t *tcol;
 	const char          *colname;
 	M_uint64             colid;
 	size_t               len;
@@ -489,20 +1039,25 @@ size_t M_table_column_remove_empty_columns(M_table_t *table)
 		colid = M_list_u64_at(table->col_order, i);
 		have  = M_FALSE;
 
-		M_hash_u64vp_enumerate(table->rows, &he);
-		while (M_hash_u64vp_enumerate_next(table->rows, he, NULL, (void **)&row_data)) {
-			if (M_hash_u64str_get(row_data, colid, NULL)) {
-				have = M_TRUE;
-				break;
+		if (M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol)) {
+			have = M_table_typed_col_has_data(tcol);
+		} else {
+			M_hash_u64vp_enumerate(table->rows, &he);
+			while (M_hash_u64vp_enumerate_next(table->rows, he, NULL, (void **)&row_data)) {
+				if (M_hash_u64str_get(row_data, colid, NULL)) {
+					have = M_TRUE;
+					break;
+				}
 			}
+			M_hash_u64vp_enumerate_free(he);
 		}
-		M_hash_u64vp_enumerate_free(he);
 
 		if (!have) {
 			M_list_u64_remove_at(table->col_order, i);
 			colname = M_hash_u64str_get_direct(table->col_id_name, colid);
 			M_hash_stru64_remove(table->col_name_id, colname);
 			M_hash_u64str_remove(table->col_id_name, colid);
+			M_hash_u64vp_remove(table->typed_cols, colid, M_TRUE);
 			cnt++;
 		}
 	}
@@ -517,6 +1072,38 @@ size_t M_table_column_count(const M_table_t *table)
 	return M_list_u64_len(table->col_order);
 }
 
+M_bool M_table_column_set_type(M_table_t *table, const char *colname, M_table_coltype_t type)
+{
+	M_uint64 colid;
+
+	if (table == NULL || M_str_isempty(colname))
+		return M_FALSE;
+
+	if (!M_hash_stru64_get(table->col_name_id, colname, &colid))
+		return M_FALSE;
+
+	return M_table_column_set_type_int(table, colid, type);
+}
+
+M_bool M_table_column_set_type_at(M_table_t *table, size_t idx, M_table_coltype_t type)
+{
+	if (table == NULL || idx >= M_list_u64_len(table->col_order))
+		return M_FALSE;
+	return M_table_column_set_type_int(table, M_list_u64_at(table->col_order, idx), type);
+}
+
+M_table_coltype_t M_table_column_type(const M_table_t *table, size_t idx)
+{
+	M_table_typed_col_t *tcol;
+
+	if (table == NULL || idx >= M_list_u64_len(table->col_order))
+		return M_TABLE_COLTYPE_STRING;
+
+	if (!M_hash_u64vp_get(table->typed_cols, M_list_u64_at(table->col_order, idx), (void **)&tcol))
+		return M_TABLE_COLTYPE_STRING;
+	return tcol->type;
+}
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 size_t M_table_row_insert(M_table_t *table)
@@ -552,12 +1139,15 @@ M_bool M_table_row_insert_dict(M_table_t *table, const M_hash_dict_t *data, M_ui
 
 M_bool M_table_row_insert_dict_at(M_table_t *table, size_t idx, const M_hash_dict_t *data, M_uint32 flags)
 {
-	M_hash_dict_enum_t *he;
-	const char         *key;
-	const char         *val;
-	M_hash_u64str_t    *row_data;
-	M_uint64            colid;
-	M_uint64            rowid;
+	M_hash_dict_enum_t   *he;
+	M_hash_u64str_enum_t *hte;
+	const char           *key;
+	const char           *val;
+	M_hash_u64str_t      *row_data;
+	M_hash_u64str_t      *typed_data;
+	M_table_typed_col_t  *tcol;
+	M_uint64              colid;
+	M_uint64              rowid;
 
 	if (table == NULL || idx > M_list_u64_len(table->row_order))
 		return M_FALSE;
@@ -566,8 +1156,10 @@ M_bool M_table_row_insert_dict_at(M_table_t *table, size_t idx, const M_hash_dic
 	if (data == NULL || M_hash_dict_num_keys(data) == 0)
 		return M_table_row_insert_at(table, idx);
 
-	/* Put all the data into a row object. */
-	row_data = M_hash_u64str_create(8, 75, M_HASH_U64STR_NONE);
+	/* Put all the data into a row object. Values for typed columns are
+ 	 * validated now and set once the row exists. */
+	row_data   = M_hash_u64str_create(8, 75, M_HASH_U64STR_NONE);
+	typed_data = M_hash_u64str_create(8, 75, M_HASH_U64STR_NONE);
 	M_hash_dict_enumerate(data, &he);
 	while (M_hash_dict_enumerate_next(data, he, &key, &val)) {
 		if (!M_hash_stru64_get(table->col_name_id, key, &colid)) {
@@ -578,26 +1170,46 @@ M_bool M_table_row_insert_dict_at(M_table_t *table, size_t idx, const M_hash_dic
 				if (!M_table_column_insert_at_int(table, M_list_u64_len(table->col_order), key, &colid)) {
 					M_hash_dict_enumerate_free(he);
 					M_hash_u64str_destroy(row_data);
+					M_hash_u64str_destroy(typed_data);
 					return M_FALSE;
 				}
 			} else {
 				M_hash_dict_enumerate_free(he);
 				M_hash_u64str_destroy(row_data);
+				M_hash_u64str_destroy(typed_data);
 				return M_FALSE;
 			}
 		}
 		/* Add the data to the row */
-		M_hash_u64str_insert(row_data, colid, val);
+		if (M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol)) {
+			if (!M_table_typed_col_valid(tcol, val)) {
+				M_hash_dict_enumerate_free(he);
+				M_hash_u64str_destroy(row_data);
+				M_hash_u64str_destroy(typed_data);
+				return M_FALSE;
+			}
+			M_hash_u64str_insert(typed_data, colid, val);
+		} else {
+			M_hash_u64str_insert(row_data, colid, val);
+		}
 	}
 	M_hash_dict_enumerate_free(he);
 
 	/* Add our row to the table. */
 	if (!M_table_row_insert_at_int(table, idx, &rowid)) {
 		M_hash_u64str_destroy(row_data);
+		M_hash_u64str_destroy(typed_data);
 		return M_FALSE;
 	}
 	M_hash_u64vp_insert(table->rows, rowid, row_data);
 
+	M_hash_u64str_enumerate(typed_data, &hte);
+	while (M_hash_u64str_enumerate_next(typed_data, hte, &colid, &val)) {
+		M_table_cell_set_int(table, rowid, colid, val);
+	}
+	M_hash_u64str_enumerate_free(hte);
+	M_hash_u64str_destroy(typed_data);
+
 	return M_TRUE;
 }
 
@@ -610,7 +1222,7 @@ void M_table_row_remove(M_table_t *table, size_t idx)
 
 	rowid = M_list_u64_at(table->row_order, idx);
 	M_list_u64_remove_at(table->row_order, idx);
-	M_hash_u64vp_remove(table->rows, rowid, M_TRUE);
+	M_table_rowid_release(table, rowid);
 }
 
 size_t M_table_row_remove_empty_rows(M_table_t *table)
@@ -629,9 +1241,9 @@ size_t M_table_row_remove_empty_rows(M_table_t *table)
 		rowid = M_list_u64_at(table->row_order, i);
 		row_data = M_hash_u64vp_get_direct(table->rows, rowid);
 
-		if (row_data == NULL || M_hash_u64str_num_keys(row_data) == 0) {
+		if ((row_data == NULL || M_hash_u64str_num_keys(row_data) == 0) && !M_table_row_has_typed_data(table, rowid)) {
 			M_list_u64_remove_at(table->row_order, i);
-			M_hash_u64vp_remove(table->rows, rowid, M_TRUE);
+			M_table_rowid_release(table, rowid);
 			cnt++;
 		}
 	}
@@ -669,8 +1281,7 @@ M_bool M_table_cell_set(M_table_t *table, size_t row, const char *colname, const
 		}
 	}
 
-	M_table_cell_set_int(table, rowid, colid, val);
-	return M_TRUE;
+	return M_table_cell_set_int(table, rowid, colid, val);
 }
 
 M_bool M_table_cell_set_at(M_table_t *table, size_t row, size_t col, const char *val)
@@ -684,15 +1295,17 @@ M_bool M_table_cell_set_at(M_table_t *table, size_t row, size_t col, const char
 	rowid = M_list_u64_at(table->row_order, row);
 	colid = M_list_u64_at(table->col_order, col);
 
-	M_table_cell_set_int(table, rowid, colid, val);
-	return M_TRUE;
+	return M_table_cell_set_int(table, rowid, colid, val);
 }
 
 M_bool M_table_cell_set_dict(M_table_t *table, size_t row, const M_hash_dict_t *data, M_uint32 flags)
 {
-	M_hash_dict_enum_t *he;
-	const char         *key;
-	const char         *val;
+	M_hash_dict_enum_t  *he;
+	M_table_typed_col_t *tcol;
+	const char          *key;
+	const char          *val;
+	M_uint64             colid;
+	M_bool               ret = M_TRUE;
 
 	/* Validate the row flags. We don't want to start adding anything if
  	 * we're supposed to fail on missing column. */
@@ -707,14 +1320,26 @@ M_bool M_table_cell_set_dict(M_table_t *table, size_t row, const M_hash_dict_t *
 		M_hash_dict_enumerate_free(he);
 	}
 
+	/* Values for typed columns have to be valid too. */
+	M_hash_dict_enumerate(data, &he);
+	while (M_hash_dict_enumerate_next(data, he, &key, &val)) {
+		if (M_hash_stru64_get(table->col_name_id, key, &colid) && M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol) && !M_table_typed_col_valid(tcol, val)) {
+			M_hash_dict_enumerate_free(he);
+			return M_FALSE;
+		}
+	}
+	M_hash_dict_enumerate_free(he);
+
 	/* We know everythings good so let's start adding. */
 	M_hash_dict_enumerate(data, &he);
 	while (M_hash_dict_enumerate_next(data, he, &key, &val)) {
-		M_table_cell_set(table, row, key, val, flags);
+		if (!M_table_cell_set(table, row, key, val, flags)) {
+			ret = M_FALSE;
+		}
 	}
 	M_hash_dict_enumerate_free(he);
 
-	return M_TRUE;
+	return ret;
 }
 
 M_bool M_table_cell_clear(M_table_t *table, size_t row, const char *colname)
@@ -756,6 +1381,132 @@ const char *M_table_cell_at(const M_table_t *table, size_t row, size_t col)
 	return M_table_cell_get_int(table, rowid, colid);
 }
 
+const char *M_table_cell_at_buf(const M_table_t *table, size_t row, size_t col, char *buf, size_t buf_len)
+{
+	M_table_typed_col_t *tcol;
+	M_uint64             colid;
+	M_uint64             rowid;
+
+	if (table == NULL || row >= M_list_u64_len(table->row_order) || col >= M_list_u64_len(table->col_order))
+		return NULL;
+
+	rowid = M_list_u64_at(table->row_order, row);
+	colid = M_list_u64_at(table->col_order, col);
+
+	if (M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol))
+		return M_table_typed_col_get_buf(tcol, rowid, buf, buf_len);
+	return M_table_cell_get_int(table, rowid, colid);
+}
+
+M_bool M_table_cell_set_int64_at(M_table_t *table, size_t row, size_t col, M_int64 val)
+{
+	M_table_typed_col_t *tcol;
+	M_uint64             colid;
+	M_uint64             rowid;
+	char                 buf[32];
+
+	if (table == NULL || row >= M_list_u64_len(table->row_order) || col >= M_list_u64_len(table->col_order))
+		return M_FALSE;
+
+	rowid = M_list_u64_at(table->row_order, row);
+	colid = M_list_u64_at(table->col_order, col);
+
+	if (M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol) && tcol->type == M_TABLE_COLTYPE_INT64) {
+		M_table_typed_col_clear(tcol, rowid);
+		M_table_typed_col_grow(tcol, rowid);
+		tcol->ints[rowid]  = val;
+		tcol->isset[rowid] = 1;
+		return M_TRUE;
+	}
+
+	M_snprintf(buf, sizeof(buf), "%lld", (long long)val);
+	return M_table_cell_set_int(table, rowid, colid, buf);
+}
+
+M_bool M_table_cell_set_decimal_at(M_table_t *table, size_t row, size_t col, const M_decimal_t *val)
+{
+	M_table_typed_col_t *tcol;
+	M_uint64             colid;
+	M_uint64             rowid;
+	char                 buf[64];
+
+	if (table == NULL || val == NULL || row >= M_list_u64_len(table->row_order) || col >= M_list_u64_len(table->col_order))
+		return M_FALSE;
+
+	rowid = M_list_u64_at(table->row_order, row);
+	colid = M_list_u64_at(table->col_order, col);
+
+	if (M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol) && tcol->type == M_TABLE_COLTYPE_DECIMAL) {
+		M_table_typed_col_clear(tcol, rowid);
+		M_table_typed_col_grow(tcol, rowid);
+		M_decimal_duplicate(&tcol->decs[rowid], val);
+		tcol->isset[rowid] = 1;
+		return M_TRUE;
+	}
+
+	if (M_decimal_to_str(val, buf, sizeof(buf)) != M_DECIMAL_SUCCESS)
+		return M_FALSE;
+	return M_table_cell_set_int(table, rowid, colid, buf);
+}
+
+M_bool M_table_cell_int64_at(const M_table_t *table, size_t row, size_t col, M_int64 *val)
+{
+	M_table_typed_col_t *tcol;
+	M_uint64             colid;
+	M_uint64             rowid;
+	const char          *str;
+
+	if (table == NULL || val == NULL || row >= M_list_u64_len(table->row_order) || col >= M_list_u64_len(table->col_order))
+		return M_FALSE;
+
+	rowid = M_list_u64_at(table->row_order, row);
+	colid = M_list_u64_at(table->col_order, col);
+
+	if (M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol) && tcol->type == M_TABLE_COLTYPE_INT64) {
+		if (!M_table_typed_col_isset(tcol, rowid))
+			return M_FALSE;
+		*val = tcol->ints[rowid];
+		return M_TRUE;
+	}
+
+	str = M_table_cell_get_int(table, rowid, colid);
+	if (M_str_isempty(str))
+		return M_FALSE;
+	return M_str_to_int64_ex(str, M_str_len(str), 10, val, NULL) == M_STR_INT_SUCCESS;
+}
+
+M_bool M_table_cell_decimal_at(const M_table_t *table, size_t row, size_t col, M_decimal_t *val)
+{
+	M_table_typed_col_t *tcol;
+	M_uint64             colid;
+	M_uint64             rowid;
+	const char          *str;
+
+	if (table == NULL || val == NULL || row >= M_list_u64_len(table->row_order) || col >= M_list_u64_len(table->col_order))
+		return M_FALSE;
+
+	rowid = M_list_u64_at(table->row_order, row);
+	colid = M_list_u64_at(table->col_order, col);
+
+	if (M_hash_u64vp_get(table->typed_cols, colid, (void **)&tcol)) {
+		if (!M_table_typed_col_isset(tcol, rowid))
+			return M_FALSE;
+		if (tcol->type == M_TABLE_COLTYPE_DECIMAL) {
+			M_decimal_duplicate(val, &tcol->decs[rowid]);
+			return M_TRUE;
+		}
+		if (tcol->type == M_TABLE_COLTYPE_INT64) {
+			M_decimal_from_int(val, tcol->ints[rowid], 0);
+			return M_TRUE;
+		}
+	}
+
+	str = M_table_cell_get_int(table, rowid, colid);
+	if (M_str_isempty(str))
+		return M_FALSE;
+	return M_decimal_from_str(str, M_str_len(str), val, NULL) == M_DECIMAL_SUCCESS;
+}
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 M_bool M_table_merge(M_table_t **dest, M_table_t *src)
@@ -816,7 +1567,9 @@ M_table_t *M_table_duplicate(const M_table_t *table)
 	M_table_t           *rt;
 	M_hash_u64vp_enum_t *he;
 	M_hash_u64str_t     *row_data;
+	M_table_typed_col_t *tcol;
 	M_uint64             rowid;
+	M_uint64             colid;
 
 	if (table == NULL)
 		return NULL;
@@ -827,6 +1580,15 @@ M_table_t *M_table_duplicate(const M_table_t *table)
 	rt->col_id_name = M_hash_u64str_duplicate(table->col_id_name);
 	rt->col_name_id = M_hash_stru64_duplicate(table->col_name_id);
 	rt->row_order   = M_list_u64_duplicate(table->row_order);
+	rt->rowid_next  = table->rowid_next;
+	rt->rowid_free  = M_list_u64_duplicate(table->rowid_free);
+
+	rt->typed_cols = M_hash_u64vp_create(8, 75, M_HASH_U64VP_NONE, M_table_typed_col_destroy);
+	M_hash_u64vp_enumerate(table->typed_cols, &he);
+	while (M_hash_u64vp_enumerate_next(table->typed_cols, he, &colid, (void **)&tcol)) {
+		M_hash_u64vp_insert(rt->typed_cols, colid, M_table_typed_col_duplicate(tcol));
+	}
+	M_hash_u64vp_enumerate_free(he);
 
 	rt->rows = M_hash_u64vp_create(8, 75, M_HASH_U64VP_NONE, (void (*)(void *))M_hash_u64str_destroy);
 	M_hash_u64vp_enumerate(table->rows, &he);
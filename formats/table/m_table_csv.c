@@ -25,6 +25,7 @@
 
 #include <mstdlib/mstdlib.h>
 #include <mstdlib/mstdlib_formats.h>
+#include "table/m_table_int.h"
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -99,6 +100,7 @@ char *M_table_write_csv(const M_table_t *table, char delim, char quote, M_bool w
 	M_buf_t    *buf;
 	const char *const_temp;
 	const char  quoted_chars[] = { delim, quote, '\r', '\n', '\0' };
+	char        cell_buf[64];
 	size_t      numcols;
 	size_t      numrows;
 	size_t      i;
@@ -125,7 +127,7 @@ char *M_table_write_csv(const M_table_t *table, char delim, char quote, M_bool w
 
 	for (i=0; i<numrows; i++) {
 		for (j=0; j<numcols; j++) {
-			const_temp = M_table_cell_at(table, i, j);
+			const_temp = M_table_cell_at_buf(table, i, j, cell_buf, sizeof(cell_buf));
 			M_buf_add_str_quoted(buf, quote, quote, quoted_chars, M_FALSE, const_temp);
 			M_buf_add_byte(buf, (unsigned char)delim);
 		}
@@ -25,6 +25,7 @@
 
 #include <mstdlib/mstdlib.h>
 #include <mstdlib/mstdlib_formats.h>
+#include "table/m_table_int.h"
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -34,9 +35,11 @@ M_bool M_table_load_json(M_table_t *table, const char *data, size_t len)
 	M_table_t     *jtable;
 	M_json_node_t *json;
 	M_json_node_t *node;
+	M_json_node_t *vnode;
 	M_list_str_t  *keys;
 	const char    *colname;
 	const char    *val;
+	char           val_buf[64];
 	M_json_type_t  type;
 	M_bool         ret  = M_FALSE;
 	size_t         numelms;
@@ -73,6 +76,14 @@ M_bool M_table_load_json(M_table_t *table, const char *data, size_t len)
 		for (j=0; j<numkeys; j++) {
 			colname = M_list_str_at(keys, j);
 			val     = M_json_object_value_string(node, colname);
+			if (val == NULL) {
+				/* Numbers are written for typed columns. */
+				vnode = M_json_object_value(node, colname);
+				type  = M_json_node_type(vnode);
+				if ((type == M_JSON_TYPE_INTEGER || type == M_JSON_TYPE_DECIMAL) && M_json_get_value(vnode, val_buf, sizeof(val_buf))) {
+					val = val_buf;
+				}
+			}
 			if (val == NULL) {
 				M_list_str_destroy(keys);
 				goto done;
@@ -98,14 +109,18 @@ done:
 
 M_json_node_t *M_table_create_json(const M_table_t *table)
 {
-	M_json_node_t *json;
-	M_json_node_t *node;
-	const char    *colname;
-	const char    *val;
-	size_t         numrows;
-	size_t         numcols;
-	size_t         i;
-	size_t         j;
+	M_json_node_t     *json;
+	M_json_node_t     *node;
+	const char        *colname;
+	const char        *val;
+	char               val_buf[64];
+	M_table_coltype_t  coltype;
+	M_int64            ival;
+	M_decimal_t        dval;
+	size_t             numrows;
+	size_t             numcols;
+	size_t             i;
+	size_t             j;
 
 	if (table == NULL)
 		return NULL;
@@ -126,8 +141,21 @@ M_json_node_t *M_table_create_json(const M_table_t *table)
 
 		for (j=0; j<numcols; j++) {
 			colname = M_table_column_name(table, j);
-			val     = M_table_cell_at(table, i, j);
-			/* Don't add empty values. */
+			coltype = M_table_column_type(table, j);
+
+			/* Typed values are written as numbers. Empty values are not added. */
+			if (coltype == M_TABLE_COLTYPE_INT64) {
+				if (M_table_cell_int64_at(table, i, j, &ival))
+					M_json_object_insert_int(node, colname, ival);
+				continue;
+			}
+			if (coltype == M_TABLE_COLTYPE_DECIMAL) {
+				if (M_table_cell_decimal_at(table, i, j, &dval))
+					M_json_object_insert_decimal(node, colname, &dval);
+				continue;
+			}
+
+			val = M_table_cell_at_buf(table, i, j, val_buf, sizeof(val_buf));
 			if (val == NULL) {
 				continue;
 			}
@@ -25,6 +25,7 @@
 
 #include <mstdlib/mstdlib.h>
 #include <mstdlib/mstdlib_formats.h>
+#include "table/m_table_int.h"
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -217,6 +218,7 @@ static M_list_u64_t *write_determine_cell_widths(const M_table_t *table)
 {
 	M_list_u64_t *cell_widths;
 	const char   *const_temp;
+	char          cell_buf[64];
 	size_t        width;
 	size_t        num_rows;
 	size_t        num_cols;
@@ -245,7 +247,7 @@ static M_list_u64_t *write_determine_cell_widths(const M_table_t *table)
 	/* Go though all cells and see which is largest. */
 	for (i=0; i<num_rows; i++) {
 		for (j=0; j<num_cols; j++) {
-			const_temp = M_table_cell_at(table, i, j);
+			const_temp = M_table_cell_at_buf(table, i, j, cell_buf, sizeof(cell_buf));
 			width      = (size_t)M_list_u64_at(cell_widths, j);
 			len        = M_str_len(const_temp);
 			if (len > width) {
@@ -342,6 +344,7 @@ static void write_header_sep_line(const M_table_t *table, M_buf_t *buf, const M_
 static void write_data_lines(const M_table_t *table, M_buf_t *buf, const M_list_u64_t *cell_widths, M_uint32 flags)
 {
 	const char *const_temp;
+	char        cell_buf[64];
 	size_t      num_cols;
 	size_t      num_rows;
 	size_t      i;
@@ -355,7 +358,7 @@ static void write_data_lines(const M_table_t *table, M_buf_t *buf, const M_list_
 
 		for (j=0; j<num_cols; j++) {
 			/* Add the cell data. */
-			const_temp = M_table_cell_at(table, i, j);
+			const_temp = M_table_cell_at_buf(table, i, j, cell_buf, sizeof(cell_buf));
 			M_buf_add_str(buf, const_temp);
 
 			/* Add cell padding if needed. */
@@ -0,0 +1,63 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Monetra Technologies, LLC.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __M_XML_INT_H__
+#define __M_XML_INT_H__
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_formats.h>
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+__BEGIN_DECLS
+
+/*! Identify the various tags we can parse */
+typedef enum {
+	M_XML_TAG_PROCESSING_INSTRUCTION = 1,
+	M_XML_TAG_COMMENT                = 2,
+	M_XML_TAG_ELEMENT_START          = 3,
+	M_XML_TAG_ELEMENT_END            = 4,
+	M_XML_TAG_ELEMENT_EMPTY          = 5,
+	M_XML_TAG_CDATA                  = 6,
+	M_XML_TAG_DECLARATION            = 7
+} M_xml_reader_tags_t;
+
+typedef struct {
+	char                *name;          /*!< Named tag                            */
+	M_xml_reader_tags_t  type;          /*!< Type of XML tag being processed      */
+	size_t               processed_len; /*!< Number of bytes processed            */
+	size_t               tag_len;       /*!< Number of bytes in total tag size    */
+	size_t               len_left;      /*!< Number of bytes left to be processed */
+} M_xml_reader_tag_info_t;
+
+/* Shared by M_xml_read and M_xml_reader_t. */
+M_bool M_xml_read_tag_info(const char *data, size_t data_len, M_xml_reader_tag_info_t *info, M_xml_error_t *error);
+M_bool M_xml_read_attributes(M_hash_dict_t *attributes, const char *data, size_t data_len, M_uint32 flags, M_xml_error_t *error);
+char *M_xml_read_tag_data(const char *data, size_t data_len);
+char *M_xml_read_text_decode(const char *data, size_t data_len, M_uint32 flags);
+
+__END_DECLS
+
+#endif /* __M_XML_INT_H__ */
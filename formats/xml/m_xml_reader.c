@@ -26,28 +26,10 @@
 #include <mstdlib/mstdlib.h>
 #include <mstdlib/mstdlib_formats.h>
 #include "xml/m_xml_entities.h"
+#include "xml/m_xml_int.h"
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-/*! Identify the various tags we can parse */
-typedef enum {
-	M_XML_TAG_PROCESSING_INSTRUCTION = 1,
-	M_XML_TAG_COMMENT                = 2,
-	M_XML_TAG_ELEMENT_START          = 3,
-	M_XML_TAG_ELEMENT_END            = 4,
-	M_XML_TAG_ELEMENT_EMPTY          = 5,
-	M_XML_TAG_CDATA                  = 6,
-	M_XML_TAG_DECLARATION            = 7
-} M_xml_reader_tags_t;
-
-typedef struct {
-	char                *name;          /*!< Named tag                            */
-	M_xml_reader_tags_t  type;          /*!< Type of XML tag being processed      */
-	size_t               processed_len; /*!< Number of bytes processed            */
-	size_t               tag_len;       /*!< Number of bytes in total tag size    */
-	size_t               len_left;      /*!< Number of bytes left to be processed */
-} M_xml_reader_tag_info_t;
-
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 
@@ -196,7 +178,7 @@ static char *M_xml_read_name(const char *data, size_t data_len)
  *  \param[in]  error_len Length of error buffer
  *  \returns M_TRUE on success, M_FALSE on failure
  */
-static M_bool M_xml_read_tag_info(const char *data, size_t data_len, M_xml_reader_tag_info_t *info, M_xml_error_t *error)
+M_bool M_xml_read_tag_info(const char *data, size_t data_len, M_xml_reader_tag_info_t *info, M_xml_error_t *error)
 {
 	const char *ptr;
 	size_t      ptr_len;
@@ -435,12 +417,12 @@ static char *M_xml_read_strip_surrounding_quotes(const char *data)
 
 
 /*! Parse attributes into key/value pairs
- *  \param[in] node     Node to add attributes
- *  \param[in] data     Data to parse
- *  \param[in] data_len Length of data to parse
+ *  \param[in] attributes Where to add the attributes
+ *  \param[in] data       Data to parse
+ *  \param[in] data_len   Length of data to parse
  *  \returns M_TRUE on success, M_FALSE on failure
  */
-static M_bool M_xml_read_tag_attributes(M_xml_node_t *node, const char *data, size_t data_len, M_uint32 flags, M_xml_error_t *error)
+M_bool M_xml_read_attributes(M_hash_dict_t *attributes, const char *data, size_t data_len, M_uint32 flags, M_xml_error_t *error)
 {
 	char       *sdata;
 	char      **kvdata;
@@ -480,7 +462,10 @@ static M_bool M_xml_read_tag_attributes(M_xml_node_t *node, const char *data, si
 			if (!(flags & M_XML_READER_DONT_DECODE_ATTRS)) {
 				decoded_val = M_xml_attribute_decode(val, M_str_len(val));
 			}
-			if (!M_xml_node_insert_attribute(node, key, decoded_val!=NULL?decoded_val:val, 0, M_FALSE)) {
+			if (decoded_val != NULL)
+				val = decoded_val;
+			/* Same rules as M_xml_node_insert_attribute. */
+			if (M_str_isempty(key) || val == NULL || M_hash_dict_get(attributes, key, NULL)) {
 				*error = M_XML_ERROR_ATTR_EXISTS;
 				M_free(keytemp);
 				M_free(valtemp);
@@ -492,6 +477,7 @@ static M_bool M_xml_read_tag_attributes(M_xml_node_t *node, const char *data, si
 				M_free(kvdata);
 				return M_FALSE;
 			}
+			M_hash_dict_insert(attributes, key, val);
 			M_free(keytemp);
 			M_free(valtemp);
 			M_free(decoded_val);
@@ -504,6 +490,36 @@ static M_bool M_xml_read_tag_attributes(M_xml_node_t *node, const char *data, si
 	return M_TRUE;
 }
 
+static M_bool M_xml_read_tag_attributes(M_xml_node_t *node, const char *data, size_t data_len, M_uint32 flags, M_xml_error_t *error)
+{
+	M_hash_dict_t *attributes;
+
+	attributes = M_CAST_OFF_CONST(M_hash_dict_t *, M_xml_node_attributes(node));
+	if (attributes == NULL) {
+		*error = M_XML_ERROR_GENERIC;
+		return M_FALSE;
+	}
+	return M_xml_read_attributes(attributes, data, data_len, flags, error);
+}
+
+/*! Declaration data is everything after the name. */
+char *M_xml_read_tag_data(const char *data, size_t data_len)
+{
+	return M_strdup_trim_max(data, data_len);
+}
+
+/*! Text and CDATA are entity decoded unless the caller asked for them not to be. */
+char *M_xml_read_text_decode(const char *data, size_t data_len, M_uint32 flags)
+{
+	char *text = NULL;
+
+	if (!(flags & M_XML_READER_DONT_DECODE_TEXT))
+		text = M_xml_entities_decode(data, data_len);
+	if (text == NULL)
+		text = M_strdup_max(data, data_len);
+	return text;
+}
+
 /*! Handle logic for tag encountered
  * \return M_TRUE on success, M_FALSE on failure
  */
@@ -530,11 +546,14 @@ static M_bool M_xml_read_tag_process(M_xml_node_t **node, const char *data, size
 			}
 
 			if (info->type == M_XML_TAG_DECLARATION) {
-				if (!M_xml_node_set_tag_data(new_node, data)) {
+				text = M_xml_read_tag_data(data, data_len);
+				if (!M_xml_node_set_tag_data(new_node, text)) {
 					*error = M_XML_ERROR_GENERIC;
+					M_free(text);
 					M_xml_node_destroy(new_node);
 					return M_FALSE;
 				}
+				M_free(text);
 			} else {
 				if (!M_xml_read_tag_attributes(new_node, data, data_len, flags, error)) {
 					M_xml_node_destroy(new_node);
@@ -569,10 +588,8 @@ static M_bool M_xml_read_tag_process(M_xml_node_t **node, const char *data, size
 
 		case M_XML_TAG_CDATA:
 			/* Standard text data would be encoded, so we need to treat this as encoded */
-			if (!(flags & M_XML_READER_DONT_DECODE_TEXT)) {
-				text = M_xml_entities_decode(data, data_len);
-			}
-			new_node = M_xml_create_text(text!=NULL?text:data, 0, *node);
+			text     = M_xml_read_text_decode(data, data_len, flags);
+			new_node = M_xml_create_text(text, 0, *node);
 			M_free(text);
 			if (new_node == NULL) {
 				*error = M_XML_ERROR_GENERIC;
@@ -641,7 +658,6 @@ static size_t M_xml_read_text(M_xml_node_t *node, const char *data, size_t data_
 {
 	const char *ptr;
 	char       *branch_data;
-	char       *decoded_branch_data = NULL;
 	size_t      text_len;
 	size_t      processed_len;
 
@@ -663,20 +679,13 @@ static size_t M_xml_read_text(M_xml_node_t *node, const char *data, size_t data_
 	for ( ; text_len > 0 && M_chr_isspace(data[text_len-1]); text_len--)
 		;
 
-	branch_data = M_malloc(text_len + 1);
-	M_mem_copy(branch_data, data, text_len);
-	branch_data[text_len] = 0;
-	if (!(flags & M_XML_READER_DONT_DECODE_TEXT)) {
-		decoded_branch_data = M_xml_entities_decode(branch_data, text_len);
-	}
-	if (!M_xml_create_text(decoded_branch_data!=NULL?decoded_branch_data:branch_data, 0, node)) {
+	branch_data = M_xml_read_text_decode(data, text_len, flags);
+	if (!M_xml_create_text(branch_data, 0, node)) {
 		*error = M_XML_ERROR_GENERIC;
 		M_free(branch_data);
-		M_free(decoded_branch_data);
 		return 0;
 	}
 	M_free(branch_data);
-	M_free(decoded_branch_data);
 
 	return processed_len;
 }
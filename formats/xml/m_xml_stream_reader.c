@@ -0,0 +1,1049 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "m_config.h"
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_formats.h>
+#include "xml/m_xml_int.h"
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Steps that can match are tracked as bits. */
+#define M_XML_READER_MAX_STEPS 64
+
+typedef enum {
+	M_XML_READER_PRED_ATTR_ANY = 0, /*!< "[@*]" */
+	M_XML_READER_PRED_ATTR_HAS,     /*!< "[@attr]" */
+	M_XML_READER_PRED_ATTR_VAL      /*!< "[@attr=val]" */
+} M_xml_reader_pred_type_t;
+
+typedef struct {
+	M_xml_reader_pred_type_t  type;
+	char                     *name;
+	char                     *val;
+} M_xml_reader_pred_t;
+
+typedef struct {
+	char                *tag;
+	M_bool               recursive;  /*!< Preceded by "//", any number of levels can come before it. */
+	M_bool               has_pos;
+	size_t               pos_start;  /*!< 1 based. */
+	size_t               pos_end;    /*!< Exclusive. */
+	M_xml_reader_pred_t *preds;
+	size_t               num_preds;
+} M_xml_reader_step_t;
+
+typedef struct {
+	char                    *search;
+	M_xml_reader_step_t     *steps;
+	size_t                   num_steps;
+	size_t                   count_base;  /*!< Offset of this path's steps in a frame's counts. */
+	M_xml_reader_match_func  match_func;
+} M_xml_reader_path_t;
+
+/* A matching element being materialized. */
+typedef struct {
+	const M_xml_reader_path_t *path;
+	M_xml_node_t              *root;
+	M_xml_node_t              *node;  /*!< Element that mirrors the reader's current element. */
+} M_xml_reader_build_t;
+
+/* An open element. The first frame is the document. */
+typedef struct {
+	char     *name;
+	M_uint64 *active;  /*!< Per path, steps that can match a child of this element. */
+	size_t   *counts;  /*!< Per step, children that matched the step's tag. Used for positions. */
+} M_xml_reader_frame_t;
+
+typedef enum {
+	M_XML_READER_STATE_TEXT = 0, /*!< Text or whitespace between tags. */
+	M_XML_READER_STATE_TAG_HEAD, /*!< Start of a tag, before the type is known. */
+	M_XML_READER_STATE_TAG_BODY  /*!< Looking for the end of the tag. */
+} M_xml_reader_state_t;
+
+struct M_xml_reader {
+	struct M_xml_reader_callbacks  cbs;
+	M_uint32                       flags;
+	void                          *thunk;
+	M_xml_error_t                  error;
+	M_bool                         started;
+
+	M_xml_reader_state_t           state;
+	char                           tag_marker;      /*!< '-' or ']' for tags ending in "-->" or "]]>". 0 for an unquoted '>'. */
+	size_t                         tag_match;       /*!< Number of marker characters seen before a '>'. */
+	char                           tag_quote;
+	M_buf_t                       *buf;             /*!< Tag being read. */
+	M_buf_t                       *text;            /*!< Text being read. */
+	M_bool                         have_root;
+	M_bool                         root_done;
+
+	M_xml_reader_frame_t          *frames;
+	size_t                         num_frames;
+	size_t                         frames_size;
+
+	M_xml_reader_path_t           *paths;
+	size_t                         num_paths;
+	size_t                         num_steps;       /*!< Across all paths. */
+	M_xml_reader_build_t          *builds;
+	size_t                         num_builds;
+	size_t                         builds_size;
+
+	size_t                         offset;          /*!< Bytes consumed. */
+	size_t                         line;
+	size_t                         line_start;      /*!< Offset of the start of the current line. */
+	size_t                         tag_offset;      /*!< Location of the '<' starting the current tag. */
+	size_t                         tag_line;
+	size_t                         tag_line_start;
+	size_t                         err_offset;
+	size_t                         err_line;
+	size_t                         err_line_start;
+};
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void M_xml_reader_path_destroy(M_xml_reader_path_t *path)
+{
+	size_t i;
+	size_t j;
+
+	for (i=0; i<path->num_steps; i++) {
+		for (j=0; j<path->steps[i].num_preds; j++) {
+			M_free(path->steps[i].preds[j].name);
+			M_free(path->steps[i].preds[j].val);
+		}
+		M_free(path->steps[i].preds);
+		M_free(path->steps[i].tag);
+	}
+	M_free(path->steps);
+	M_free(path->search);
+}
+
+/* "[idx]" and "[position() ? idx]". "last()" and negative offsets aren't supported because
+ * the number of siblings isn't known when an element starts. */
+static M_bool M_xml_reader_path_parse_pos(M_xml_reader_step_t *step, const char *s, size_t len)
+{
+	char       *val;
+	const char *p;
+	const char *end = NULL;
+	const char *op  = "=";
+	M_int64     num;
+	M_bool      ret = M_FALSE;
+
+	val = M_strdup_trim_max(s, len);
+	p   = val;
+	if (M_str_eq_max(p, "position()", 10)) {
+		p += 10;
+		while (M_chr_isspace(*p))
+			p++;
+		if (M_str_eq_max(p, "<=", 2) || M_str_eq_max(p, ">=", 2)) {
+			op  = p;
+			p  += 2;
+		} else if (*p == '<' || *p == '>' || *p == '=') {
+			op  = p;
+			p++;
+		} else {
+			goto done;
+		}
+		while (M_chr_isspace(*p))
+			p++;
+	}
+
+	if (*p == '\0' || M_str_to_int64_ex(p, M_str_len(p), 10, &num, &end) != M_STR_INT_SUCCESS || *end != '\0' || num <= 0)
+		goto done;
+
+	step->has_pos = M_TRUE;
+	if (M_str_eq_max(op, "<=", 2)) {
+		step->pos_start = 1;
+		step->pos_end   = (size_t)num + 1;
+	} else if (M_str_eq_max(op, ">=", 2)) {
+		step->pos_start = (size_t)num;
+		step->pos_end   = SIZE_MAX;
+	} else if (*op == '<') {
+		step->pos_start = 1;
+		step->pos_end   = (size_t)num;
+	} else if (*op == '>') {
+		step->pos_start = (size_t)num + 1;
+		step->pos_end   = SIZE_MAX;
+	} else {
+		step->pos_start = (size_t)num;
+		step->pos_end   = (size_t)num + 1;
+	}
+	ret = M_TRUE;
+
+done:
+	M_free(val);
+	return ret;
+}
+
+static M_bool M_xml_reader_path_parse_pred(M_xml_reader_step_t *step, const char *s, size_t len)
+{
+	M_xml_reader_pred_t *pred;
+	const char          *eq;
+	size_t               val_len;
+
+	if (len == 0)
+		return M_FALSE;
+
+	if (*s != '@') {
+		/* Positions count the siblings with the step's tag so they have to come directly after it. */
+		if (step->has_pos || step->num_preds != 0)
+			return M_FALSE;
+		return M_xml_reader_path_parse_pos(step, s, len);
+	}
+	s++;
+	len--;
+
+	step->preds = M_realloc(step->preds, (step->num_preds + 1) * sizeof(*step->preds));
+	pred        = &step->preds[step->num_preds++];
+	M_mem_set(pred, 0, sizeof(*pred));
+
+	if (len == 1 && *s == '*') {
+		pred->type = M_XML_READER_PRED_ATTR_ANY;
+		return M_TRUE;
+	}
+
+	eq = M_mem_chr(s, '=', len);
+	if (eq == NULL) {
+		pred->type = M_XML_READER_PRED_ATTR_HAS;
+		pred->name = M_strdup_max(s, len);
+		return len != 0;
+	}
+
+	pred->type = M_XML_READER_PRED_ATTR_VAL;
+	pred->name = M_strdup_max(s, (size_t)(eq - s));
+	eq++;
+	val_len = len - (size_t)(eq - s);
+	if (val_len >= 2 && (*eq == '\'' || *eq == '"') && eq[val_len-1] == *eq) {
+		eq++;
+		val_len -= 2;
+	}
+	pred->val = M_strdup_max(eq, val_len);
+	return !M_str_isempty(pred->name);
+}
+
+static M_bool M_xml_reader_path_parse_step(M_xml_reader_step_t *step, const char *seg)
+{
+	const char *p;
+	const char *end;
+	size_t      len;
+
+	for (len=0; seg[len] != '\0' && seg[len] != '['; len++)
+		;
+	if (len == 0)
+		return M_FALSE;
+	step->tag = M_strdup_max(seg, len);
+	/* Moving up and selecting text can't be done on a stream. */
+	if (M_str_eq(step->tag, "..") || M_str_eq(step->tag, "text()"))
+		return M_FALSE;
+
+	p = seg + len;
+	while (*p == '[') {
+		end = M_str_chr(p, ']');
+		if (end == NULL || !M_xml_reader_path_parse_pred(step, p+1, (size_t)(end - p) - 1))
+			return M_FALSE;
+		p = end + 1;
+	}
+	return *p == '\0';
+}
+
+static M_bool M_xml_reader_path_parse(M_xml_reader_path_t *path, const char *search)
+{
+	char   **segs;
+	size_t   num_segs  = 0;
+	size_t   i;
+	M_bool   recursive = M_FALSE;
+	M_bool   ret       = M_TRUE;
+
+	segs = M_str_explode_str('/', search, &num_segs);
+	if (segs == NULL || num_segs == 0) {
+		M_str_explode_free(segs, num_segs);
+		return M_FALSE;
+	}
+
+	for (i=0; i<num_segs && ret; i++) {
+		M_xml_reader_step_t *step;
+
+		/* A leading '/' starts from the document, which is where every expression starts. */
+		if (i == 0 && *segs[i] == '\0')
+			continue;
+
+		/* Same as M_xml_xpath, a blank segment or "." searches recursively for the next one. */
+		if (*segs[i] == '\0' || M_str_eq(segs[i], ".")) {
+			recursive = M_TRUE;
+			continue;
+		}
+
+		if (path->num_steps == M_XML_READER_MAX_STEPS) {
+			ret = M_FALSE;
+			break;
+		}
+		path->steps = M_realloc(path->steps, (path->num_steps + 1) * sizeof(*path->steps));
+		step        = &path->steps[path->num_steps++];
+		M_mem_set(step, 0, sizeof(*step));
+		step->recursive = recursive;
+		recursive       = M_FALSE;
+
+		ret = M_xml_reader_path_parse_step(step, segs[i]);
+	}
+	M_str_explode_free(segs, num_segs);
+
+	if (recursive || path->num_steps == 0)
+		ret = M_FALSE;
+	return ret;
+}
+
+static M_bool M_xml_reader_tag_eq(const char *tag, const char *name, M_uint32 flags)
+{
+	const char *p;
+
+	/* Same as M_xml_xpath. */
+	if (M_str_len(tag) > 2 && M_str_eq_max(tag, "*:", 2)) {
+		tag += 2;
+		p    = M_str_chr(name, ':');
+		if (p != NULL) {
+			name = p+1;
+		}
+	}
+
+	if (M_str_eq(tag, "*"))
+		return M_TRUE;
+	if (flags & M_XML_READER_TAG_CASECMP)
+		return M_str_caseeq(tag, name);
+	return M_str_eq(tag, name);
+}
+
+static M_bool M_xml_reader_step_match_preds(const M_xml_reader_step_t *step, const M_hash_dict_t *attributes)
+{
+	const char *val;
+	size_t      i;
+
+	for (i=0; i<step->num_preds; i++) {
+		const M_xml_reader_pred_t *pred = &step->preds[i];
+
+		switch (pred->type) {
+			case M_XML_READER_PRED_ATTR_ANY:
+				if (M_hash_dict_num_keys(attributes) == 0)
+					return M_FALSE;
+				break;
+			case M_XML_READER_PRED_ATTR_HAS:
+				if (!M_hash_dict_get(attributes, pred->name, NULL))
+					return M_FALSE;
+				break;
+			case M_XML_READER_PRED_ATTR_VAL:
+				if (!M_hash_dict_get(attributes, pred->name, &val) || !M_str_eq(val, pred->val))
+					return M_FALSE;
+				break;
+		}
+	}
+	return M_TRUE;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void M_xml_reader_frame_push(M_xml_reader_t *reader, const char *name)
+{
+	M_xml_reader_frame_t *frame;
+
+	if (reader->num_frames == reader->frames_size) {
+		reader->frames_size = (reader->frames_size == 0) ? 16 : reader->frames_size * 2;
+		reader->frames      = M_realloc(reader->frames, reader->frames_size * sizeof(*reader->frames));
+		M_mem_set(reader->frames+reader->num_frames, 0, (reader->frames_size - reader->num_frames) * sizeof(*reader->frames));
+	}
+	frame       = &reader->frames[reader->num_frames++];
+	frame->name = M_strdup(name);
+
+	/* Paths can't change once reading starts so the match state is kept when the frame is popped. */
+	if (reader->num_paths == 0)
+		return;
+	if (frame->active == NULL) {
+		frame->active = M_malloc(reader->num_paths * sizeof(*frame->active));
+		frame->counts = M_malloc(reader->num_steps * sizeof(*frame->counts));
+	}
+	M_mem_set(frame->active, 0, reader->num_paths * sizeof(*frame->active));
+	M_mem_set(frame->counts, 0, reader->num_steps * sizeof(*frame->counts));
+}
+
+static void M_xml_reader_start(M_xml_reader_t *reader)
+{
+	size_t i;
+
+	reader->started = M_TRUE;
+
+	/* Every expression starts from the document. */
+	M_xml_reader_frame_push(reader, NULL);
+	for (i=0; i<reader->num_paths; i++) {
+		reader->frames[0].active[i] = 1;
+	}
+}
+
+static void M_xml_reader_attributes_copy(M_xml_node_t *node, const M_hash_dict_t *attributes)
+{
+	M_hash_dict_enum_t *hashenum;
+	const char         *key;
+	const char         *val;
+
+	M_hash_dict_enumerate(attributes, &hashenum);
+	while (M_hash_dict_enumerate_next(attributes, hashenum, &key, &val)) {
+		M_xml_node_insert_attribute(node, key, val, 0, M_FALSE);
+	}
+	M_hash_dict_enumerate_free(hashenum);
+}
+
+/* Hand a completed element to its callback. */
+static M_xml_error_t M_xml_reader_build_done(M_xml_reader_t *reader, size_t idx)
+{
+	M_xml_reader_build_t build = reader->builds[idx];
+
+	reader->num_builds--;
+	M_mem_move(reader->builds+idx, reader->builds+idx+1, (reader->num_builds - idx) * sizeof(*reader->builds));
+
+	return build.path->match_func(build.path->search, build.root, reader->thunk);
+}
+
+/* Start elements for every path matching the element that was just opened. */
+static void M_xml_reader_build_start(M_xml_reader_t *reader, const char *name, const M_hash_dict_t *attributes)
+{
+	M_xml_reader_frame_t *parent = &reader->frames[reader->num_frames-2];
+	M_xml_reader_frame_t *child  = &reader->frames[reader->num_frames-1];
+	size_t                i;
+	size_t                k;
+
+	for (i=0; i<reader->num_paths; i++) {
+		const M_xml_reader_path_t *path = &reader->paths[i];
+
+		for (k=0; k<path->num_steps; k++) {
+			const M_xml_reader_step_t *step = &path->steps[k];
+			size_t                     cnt;
+
+			if (!(parent->active[i] & ((M_uint64)1 << k)))
+				continue;
+
+			/* Let a recursive step match further down. */
+			if (step->recursive)
+				child->active[i] |= (M_uint64)1 << k;
+
+			if (!M_xml_reader_tag_eq(step->tag, name, reader->flags))
+				continue;
+			cnt = ++parent->counts[path->count_base + k];
+			if (step->has_pos && (cnt < step->pos_start || cnt >= step->pos_end))
+				continue;
+			if (!M_xml_reader_step_match_preds(step, attributes))
+				continue;
+
+			if (k+1 < path->num_steps) {
+				child->active[i] |= (M_uint64)1 << (k+1);
+				continue;
+			}
+
+			if (reader->num_builds == reader->builds_size) {
+				reader->builds_size = (reader->builds_size == 0) ? 4 : reader->builds_size * 2;
+				reader->builds      = M_realloc(reader->builds, reader->builds_size * sizeof(*reader->builds));
+			}
+			M_mem_set(&reader->builds[reader->num_builds], 0, sizeof(*reader->builds));
+			reader->builds[reader->num_builds].path = path;
+			reader->num_builds++;
+		}
+	}
+}
+
+/* Add a node to every element being built. */
+static M_xml_error_t M_xml_reader_build_add(M_xml_reader_t *reader, M_xml_node_type_t type, const char *name, const char *text, const M_hash_dict_t *attributes)
+{
+	size_t i;
+
+	for (i=0; i<reader->num_builds; i++) {
+		M_xml_reader_build_t *build = &reader->builds[i];
+		M_xml_node_t         *node  = NULL;
+
+		switch (type) {
+			case M_XML_NODE_TYPE_ELEMENT:
+				node = M_xml_create_element(name, build->node);
+				break;
+			case M_XML_NODE_TYPE_TEXT:
+				node = M_xml_create_text(text, 0, build->node);
+				break;
+			case M_XML_NODE_TYPE_PROCESSING_INSTRUCTION:
+				node = M_xml_create_processing_instruction(name, build->node);
+				break;
+			case M_XML_NODE_TYPE_DECLARATION:
+				node = M_xml_create_declaration_with_tag_data(name, text, build->node);
+				break;
+			case M_XML_NODE_TYPE_COMMENT:
+				node = M_xml_create_comment(text, build->node);
+				break;
+			case M_XML_NODE_TYPE_DOC:
+			case M_XML_NODE_TYPE_UNKNOWN:
+				break;
+		}
+		if (node == NULL)
+			return M_XML_ERROR_GENERIC;
+
+		if (attributes != NULL)
+			M_xml_reader_attributes_copy(node, attributes);
+
+		if (type == M_XML_NODE_TYPE_ELEMENT) {
+			if (build->root == NULL)
+				build->root = node;
+			build->node = node;
+		}
+	}
+	return M_XML_ERROR_SUCCESS;
+}
+
+static M_xml_error_t M_xml_reader_build_close(M_xml_reader_t *reader)
+{
+	M_xml_error_t res = M_XML_ERROR_SUCCESS;
+	size_t        i   = reader->num_builds;
+
+	while (i-- > 0) {
+		M_xml_reader_build_t *build = &reader->builds[i];
+
+		if (build->node == build->root) {
+			res = M_xml_reader_build_done(reader, i);
+			if (res != M_XML_ERROR_SUCCESS) {
+				break;
+			}
+			continue;
+		}
+		build->node = M_xml_node_parent(build->node);
+	}
+	return res;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static M_xml_error_t M_xml_reader_text(M_xml_reader_t *reader, const char *text)
+{
+	M_xml_error_t res = M_XML_ERROR_SUCCESS;
+
+	if (reader->cbs.text_func != NULL)
+		res = reader->cbs.text_func(text, reader->thunk);
+	if (res == M_XML_ERROR_SUCCESS && reader->num_builds > 0)
+		res = M_xml_reader_build_add(reader, M_XML_NODE_TYPE_TEXT, NULL, text, NULL);
+	return res;
+}
+
+/* Pass on text that ended at a tag or the end of the data. Same as M_xml_read, it's
+ * trimmed and whitespace only text is dropped. */
+static M_xml_error_t M_xml_reader_text_flush(M_xml_reader_t *reader)
+{
+	const char    *s;
+	char          *text;
+	size_t         len;
+	M_xml_error_t  res;
+
+	/* Leading whitespace is never added. */
+	s   = M_buf_peek(reader->text);
+	len = M_buf_len(reader->text);
+	for ( ; len > 0 && M_chr_isspace(s[len-1]); len--)
+		;
+	if (len == 0) {
+		M_buf_truncate(reader->text, 0);
+		return M_XML_ERROR_SUCCESS;
+	}
+
+	text = M_xml_read_text_decode(s, len, reader->flags);
+	M_buf_truncate(reader->text, 0);
+	res  = M_xml_reader_text(reader, text);
+	M_free(text);
+	return res;
+}
+
+static void M_xml_reader_text_add(M_xml_reader_t *reader, const char *data, size_t len)
+{
+	if (M_buf_len(reader->text) == 0) {
+		while (len > 0 && M_chr_isspace(*data)) {
+			data++;
+			len--;
+		}
+	}
+	M_buf_add_bytes(reader->text, data, len);
+}
+
+static M_xml_error_t M_xml_reader_element_end(M_xml_reader_t *reader)
+{
+	M_xml_reader_frame_t *frame = &reader->frames[reader->num_frames-1];
+	M_xml_error_t         res   = M_XML_ERROR_SUCCESS;
+
+	if (reader->cbs.element_end_func != NULL)
+		res = reader->cbs.element_end_func(frame->name, reader->thunk);
+	if (res == M_XML_ERROR_SUCCESS && reader->num_builds > 0)
+		res = M_xml_reader_build_close(reader);
+
+	M_free(frame->name);
+	frame->name = NULL;
+	reader->num_frames--;
+	if (reader->num_frames == 1)
+		reader->root_done = M_TRUE;
+	return res;
+}
+
+static M_xml_error_t M_xml_reader_element_start(M_xml_reader_t *reader, const char *name, const char *data, size_t data_len, M_bool empty)
+{
+	M_hash_dict_t *attributes;
+	M_xml_error_t  res = M_XML_ERROR_SUCCESS;
+
+	attributes = M_hash_dict_create(4, 75, M_HASH_DICT_KEYS_ORDERED|M_HASH_DICT_CASECMP);
+	if (!M_xml_read_attributes(attributes, data, data_len, reader->flags, &res)) {
+		M_hash_dict_destroy(attributes);
+		return res;
+	}
+
+	if (reader->cbs.element_start_func != NULL)
+		res = reader->cbs.element_start_func(name, attributes, reader->thunk);
+
+	M_xml_reader_frame_push(reader, name);
+	reader->have_root = M_TRUE;
+	if (res == M_XML_ERROR_SUCCESS && reader->num_paths > 0)
+		M_xml_reader_build_start(reader, name, attributes);
+	if (res == M_XML_ERROR_SUCCESS && reader->num_builds > 0)
+		res = M_xml_reader_build_add(reader, M_XML_NODE_TYPE_ELEMENT, name, NULL, attributes);
+	M_hash_dict_destroy(attributes);
+
+	if (res == M_XML_ERROR_SUCCESS && empty)
+		res = M_xml_reader_element_end(reader);
+	return res;
+}
+
+/* Same checks as M_xml_read_tag_process. */
+static M_xml_error_t M_xml_reader_element_close(M_xml_reader_t *reader, const char *name)
+{
+	const char *open_name;
+
+	if (reader->num_frames == 1)
+		return M_XML_ERROR_INELIGIBLE_FOR_CLOSE;
+
+	open_name = reader->frames[reader->num_frames-1].name;
+	if ((reader->flags & M_XML_READER_TAG_CASECMP && !M_str_caseeq(name, open_name)) || (!(reader->flags & M_XML_READER_TAG_CASECMP) && !M_str_eq(name, open_name)))
+		return M_XML_ERROR_UNEXPECTED_CLOSE;
+
+	return M_xml_reader_element_end(reader);
+}
+
+static M_xml_error_t M_xml_reader_processing_instruction(M_xml_reader_t *reader, const char *name, const char *data, size_t data_len)
+{
+	M_hash_dict_t *attributes;
+	M_xml_error_t  res = M_XML_ERROR_SUCCESS;
+
+	attributes = M_hash_dict_create(4, 75, M_HASH_DICT_KEYS_ORDERED|M_HASH_DICT_CASECMP);
+	if (M_xml_read_attributes(attributes, data, data_len, reader->flags, &res)) {
+		if (reader->cbs.processing_instruction_func != NULL)
+			res = reader->cbs.processing_instruction_func(name, attributes, reader->thunk);
+		if (res == M_XML_ERROR_SUCCESS && reader->num_builds > 0)
+			res = M_xml_reader_build_add(reader, M_XML_NODE_TYPE_PROCESSING_INSTRUCTION, name, NULL, attributes);
+	}
+	M_hash_dict_destroy(attributes);
+	return res;
+}
+
+static M_xml_error_t M_xml_reader_declaration(M_xml_reader_t *reader, const char *name, const char *data, size_t data_len)
+{
+	char          *tag_data;
+	M_xml_error_t  res = M_XML_ERROR_SUCCESS;
+
+	tag_data = M_xml_read_tag_data(data, data_len);
+	if (reader->cbs.declaration_func != NULL)
+		res = reader->cbs.declaration_func(name, tag_data, reader->thunk);
+	if (res == M_XML_ERROR_SUCCESS && reader->num_builds > 0)
+		res = M_xml_reader_build_add(reader, M_XML_NODE_TYPE_DECLARATION, name, tag_data, NULL);
+	M_free(tag_data);
+	return res;
+}
+
+static M_xml_error_t M_xml_reader_comment(M_xml_reader_t *reader, const char *data, size_t data_len)
+{
+	char          *comment;
+	M_xml_error_t  res = M_XML_ERROR_SUCCESS;
+
+	if (reader->flags & M_XML_READER_IGNORE_COMMENTS)
+		return M_XML_ERROR_SUCCESS;
+
+	comment = M_strdup_trim_max(data, data_len);
+	if (reader->cbs.comment_func != NULL)
+		res = reader->cbs.comment_func(comment, reader->thunk);
+	if (res == M_XML_ERROR_SUCCESS && reader->num_builds > 0)
+		res = M_xml_reader_build_add(reader, M_XML_NODE_TYPE_COMMENT, NULL, comment, NULL);
+	M_free(comment);
+	return res;
+}
+
+/* A complete tag is in the buffer. */
+static M_xml_error_t M_xml_reader_tag_done(M_xml_reader_t *reader)
+{
+	M_xml_reader_tag_info_t  info;
+	const char              *data;
+	char                    *text;
+	M_xml_error_t            res = M_XML_ERROR_GENERIC;
+
+	reader->state = M_XML_READER_STATE_TEXT;
+
+	M_mem_set(&info, 0, sizeof(info));
+	if (!M_xml_read_tag_info(M_buf_peek(reader->buf), M_buf_len(reader->buf), &info, &res)) {
+		M_free(info.name);
+		return res;
+	}
+	data = M_buf_peek(reader->buf) + info.processed_len;
+
+	switch (info.type) {
+		case M_XML_TAG_ELEMENT_START:
+		case M_XML_TAG_ELEMENT_EMPTY:
+			res = M_xml_reader_element_start(reader, info.name, data, info.len_left, info.type == M_XML_TAG_ELEMENT_EMPTY);
+			break;
+		case M_XML_TAG_ELEMENT_END:
+			res = M_xml_reader_element_close(reader, info.name);
+			break;
+		case M_XML_TAG_PROCESSING_INSTRUCTION:
+			res = M_xml_reader_processing_instruction(reader, info.name, data, info.len_left);
+			break;
+		case M_XML_TAG_DECLARATION:
+			res = M_xml_reader_declaration(reader, info.name, data, info.len_left);
+			break;
+		case M_XML_TAG_CDATA:
+			text = M_xml_read_text_decode(data, info.len_left, reader->flags);
+			res  = M_xml_reader_text(reader, text);
+			M_free(text);
+			break;
+		case M_XML_TAG_COMMENT:
+			res = M_xml_reader_comment(reader, data, info.len_left);
+			break;
+	}
+
+	M_free(info.name);
+	M_buf_truncate(reader->buf, 0);
+	return res;
+}
+
+/* Determine what kind of tag is in the buffer and how it ends. Returns M_FALSE if more data is
+ * needed to tell. Otherwise offset is where the search for the end starts. Mirrors M_xml_read_tag_info. */
+static M_bool M_xml_reader_tag_classify(M_xml_reader_t *reader, size_t *offset)
+{
+	const char *s   = M_buf_peek(reader->buf);
+	size_t      len = M_buf_len(reader->buf);
+	size_t      i   = 1;
+	size_t      rem;
+
+	while (i < len && M_chr_isspace(s[i]))
+		i++;
+	if (i == len)
+		return M_FALSE;
+
+	reader->tag_marker = 0;
+	reader->tag_match  = 0;
+	reader->tag_quote  = 0;
+	*offset            = i;
+	if (s[i] != '!')
+		return M_TRUE;
+
+	i++;
+	while (i < len && M_chr_isspace(s[i]))
+		i++;
+	if (i == len)
+		return M_FALSE;
+
+	rem = len - i;
+	if (M_mem_eq(s+i, "--", M_MIN(rem, 2))) {
+		if (rem < 2)
+			return M_FALSE;
+		reader->tag_marker = '-';
+		*offset            = i + 2;
+	} else if (M_mem_eq(s+i, "[CDATA[", M_MIN(rem, 7))) {
+		if (rem < 7)
+			return M_FALSE;
+		reader->tag_marker = ']';
+		*offset            = i + 7;
+	} else {
+		/* Declaration. */
+		*offset = i;
+	}
+	return M_TRUE;
+}
+
+/* Look for the end of the current tag. used is the number of bytes up to and including the end. */
+static M_bool M_xml_reader_tag_scan(M_xml_reader_t *reader, const char *data, size_t data_len, size_t *used)
+{
+	size_t i;
+
+	for (i=0; i<data_len; i++) {
+		char c = data[i];
+
+		if (reader->tag_marker != 0) {
+			/* Comments and CDATA don't honor quotes. */
+			if (c == reader->tag_marker) {
+				if (reader->tag_match < 2)
+					reader->tag_match++;
+			} else if (c == '>' && reader->tag_match == 2) {
+				*used = i + 1;
+				return M_TRUE;
+			} else {
+				reader->tag_match = 0;
+			}
+		} else if (reader->tag_quote != 0) {
+			if (c == reader->tag_quote)
+				reader->tag_quote = 0;
+		} else if (c == '\'' || c == '"') {
+			reader->tag_quote = c;
+		} else if (c == '>') {
+			*used = i + 1;
+			return M_TRUE;
+		}
+	}
+
+	*used = data_len;
+	return M_FALSE;
+}
+
+static void M_xml_reader_advance(M_xml_reader_t *reader, const char *data, size_t len)
+{
+	const char *p   = data;
+	const char *end = data + len;
+
+	while (p < end && (p = M_mem_chr(p, '\n', (size_t)(end - p))) != NULL) {
+		reader->line++;
+		reader->line_start = reader->offset + (size_t)(p - data) + 1;
+		p++;
+	}
+	reader->offset += len;
+}
+
+static M_xml_error_t M_xml_reader_fail(M_xml_reader_t *reader, M_xml_error_t error, M_bool at_tag)
+{
+	reader->error = error;
+	if (at_tag) {
+		reader->err_offset     = reader->tag_offset;
+		reader->err_line       = reader->tag_line;
+		reader->err_line_start = reader->tag_line_start;
+	} else {
+		reader->err_offset     = reader->offset;
+		reader->err_line       = reader->line;
+		reader->err_line_start = reader->line_start;
+	}
+	return error;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+M_xml_reader_t *M_xml_reader_create(const struct M_xml_reader_callbacks *cbs, M_uint32 flags, void *thunk)
+{
+	M_xml_reader_t *reader;
+
+	reader = M_malloc_zero(sizeof(*reader));
+	if (cbs != NULL)
+		M_mem_copy(&reader->cbs, cbs, sizeof(reader->cbs));
+	reader->flags = flags;
+	reader->thunk = thunk;
+	reader->buf   = M_buf_create();
+	reader->text  = M_buf_create();
+	reader->line  = 1;
+	return reader;
+}
+
+void M_xml_reader_destroy(M_xml_reader_t *reader)
+{
+	size_t i;
+
+	if (reader == NULL)
+		return;
+
+	for (i=0; i<reader->num_builds; i++)
+		M_xml_node_destroy(reader->builds[i].root);
+	M_free(reader->builds);
+
+	for (i=0; i<reader->num_paths; i++)
+		M_xml_reader_path_destroy(&reader->paths[i]);
+	M_free(reader->paths);
+
+	for (i=0; i<reader->frames_size; i++) {
+		M_free(reader->frames[i].name);
+		M_free(reader->frames[i].active);
+		M_free(reader->frames[i].counts);
+	}
+	M_free(reader->frames);
+
+	M_buf_cancel(reader->buf);
+	M_buf_cancel(reader->text);
+	M_free(reader);
+}
+
+M_bool M_xml_reader_add_xpath(M_xml_reader_t *reader, const char *search, M_xml_reader_match_func match_func)
+{
+	M_xml_reader_path_t path;
+
+	if (reader == NULL || search == NULL || match_func == NULL || reader->started)
+		return M_FALSE;
+
+	M_mem_set(&path, 0, sizeof(path));
+	if (!M_xml_reader_path_parse(&path, search)) {
+		M_xml_reader_path_destroy(&path);
+		return M_FALSE;
+	}
+	path.search     = M_strdup(search);
+	path.match_func = match_func;
+	path.count_base = reader->num_steps;
+
+	/* Builds point at their path so paths can't be moved once reading starts, which is
+	 * why they can only be added before then. */
+	reader->paths = M_realloc(reader->paths, (reader->num_paths + 1) * sizeof(*reader->paths));
+	reader->paths[reader->num_paths++] = path;
+	reader->num_steps += path.num_steps;
+	return M_TRUE;
+}
+
+M_xml_error_t M_xml_reader_read(M_xml_reader_t *reader, const char *data, size_t data_len)
+{
+	const char    *p;
+	size_t         i = 0;
+	size_t         len;
+	size_t         offset;
+	M_xml_error_t  res;
+
+	if (reader == NULL || (data == NULL && data_len != 0))
+		return M_XML_ERROR_MISUSE;
+	if (reader->error != M_XML_ERROR_SUCCESS)
+		return reader->error;
+	if (!reader->started)
+		M_xml_reader_start(reader);
+
+	while (i < data_len) {
+		switch (reader->state) {
+			case M_XML_READER_STATE_TEXT:
+				/* Same as M_xml_read, only whitespace can follow the root element. */
+				if (reader->root_done) {
+					for (len=0; i+len < data_len && M_chr_isspace(data[i+len]); len++)
+						;
+					M_xml_reader_advance(reader, data+i, len);
+					i += len;
+					if (i < data_len)
+						return M_xml_reader_fail(reader, M_XML_ERROR_EXPECTED_END, M_FALSE);
+					break;
+				}
+
+				p   = M_mem_chr(data+i, '<', data_len-i);
+				len = (p == NULL) ? data_len-i : (size_t)(p - (data+i));
+				/* Text is only held if something wants it. */
+				if (reader->cbs.text_func != NULL || reader->num_builds > 0)
+					M_xml_reader_text_add(reader, data+i, len);
+				M_xml_reader_advance(reader, data+i, len);
+				i += len;
+				if (p == NULL)
+					break;
+
+				reader->tag_offset     = reader->offset;
+				reader->tag_line       = reader->line;
+				reader->tag_line_start = reader->line_start;
+				res = M_xml_reader_text_flush(reader);
+				if (res != M_XML_ERROR_SUCCESS)
+					return M_xml_reader_fail(reader, res, M_TRUE);
+
+				M_buf_add_byte(reader->buf, '<');
+				M_xml_reader_advance(reader, data+i, 1);
+				i++;
+				reader->state = M_XML_READER_STATE_TAG_HEAD;
+				break;
+
+			case M_XML_READER_STATE_TAG_HEAD:
+				M_buf_add_byte(reader->buf, (unsigned char)data[i]);
+				M_xml_reader_advance(reader, data+i, 1);
+				i++;
+				if (!M_xml_reader_tag_classify(reader, &offset))
+					break;
+
+				reader->state = M_XML_READER_STATE_TAG_BODY;
+				/* Characters held while classifying can end the tag (such as "<!->"). */
+				if (M_xml_reader_tag_scan(reader, M_buf_peek(reader->buf)+offset, M_buf_len(reader->buf)-offset, &len)) {
+					res = M_xml_reader_tag_done(reader);
+					if (res != M_XML_ERROR_SUCCESS) {
+						return M_xml_reader_fail(reader, res, M_TRUE);
+					}
+				}
+				break;
+
+			case M_XML_READER_STATE_TAG_BODY:
+				if (M_xml_reader_tag_scan(reader, data+i, data_len-i, &len)) {
+					M_buf_add_bytes(reader->buf, data+i, len);
+					M_xml_reader_advance(reader, data+i, len);
+					i  += len;
+					res = M_xml_reader_tag_done(reader);
+					if (res != M_XML_ERROR_SUCCESS) {
+						return M_xml_reader_fail(reader, res, M_TRUE);
+					}
+					break;
+				}
+				M_buf_add_bytes(reader->buf, data+i, len);
+				M_xml_reader_advance(reader, data+i, len);
+				i += len;
+				break;
+		}
+	}
+
+	return M_XML_ERROR_SUCCESS;
+}
+
+M_xml_error_t M_xml_reader_finish(M_xml_reader_t *reader)
+{
+	M_xml_reader_tag_info_t info;
+	M_xml_error_t           res;
+
+	if (reader == NULL)
+		return M_XML_ERROR_MISUSE;
+	if (reader->error != M_XML_ERROR_SUCCESS)
+		return reader->error;
+	if (!reader->started)
+		M_xml_reader_start(reader);
+
+	if (reader->state != M_XML_READER_STATE_TEXT) {
+		/* Let the tag parser explain what's wrong with the partial tag. */
+		res = M_XML_ERROR_MISSING_CLOSE_TAG;
+		M_mem_set(&info, 0, sizeof(info));
+		if (M_xml_read_tag_info(M_buf_peek(reader->buf), M_buf_len(reader->buf), &info, &res))
+			res = M_XML_ERROR_MISSING_CLOSE_TAG;
+		M_free(info.name);
+		return M_xml_reader_fail(reader, res, M_TRUE);
+	}
+
+	res = M_xml_reader_text_flush(reader);
+	if (res != M_XML_ERROR_SUCCESS)
+		return M_xml_reader_fail(reader, res, M_FALSE);
+
+	if (reader->num_frames > 1)
+		return M_xml_reader_fail(reader, M_XML_ERROR_MISSING_CLOSE_TAG, M_FALSE);
+	if (!reader->have_root)
+		return M_xml_reader_fail(reader, M_XML_ERROR_NO_ELEMENTS, M_FALSE);
+	return M_XML_ERROR_SUCCESS;
+}
+
+void M_xml_reader_error_pos(const M_xml_reader_t *reader, size_t *error_line, size_t *error_pos)
+{
+	if (reader == NULL)
+		return;
+
+	if (error_line == NULL) {
+		if (error_pos != NULL)
+			*error_pos = reader->err_offset;
+		return;
+	}
+
+	*error_line = reader->err_line;
+	if (error_pos != NULL)
+		*error_pos = reader->err_offset - reader->err_line_start + 1;
+}
@@ -35,7 +35,9 @@ typedef enum {
 	M_XML_XPATH_MATCH_TYPE_ATTR_HAS,
 	M_XML_XPATH_MATCH_TYPE_ATTR_VAL,
 	M_XML_XPATH_MATCH_TYPE_POS,
-	M_XML_XPATH_MATCH_TYPE_TEXT
+	M_XML_XPATH_MATCH_TYPE_TEXT,
+	M_XML_XPATH_MATCH_TYPE_RECURSIVE,
+	M_XML_XPATH_MATCH_TYPE_PARENT
 } M_xml_xpath_match_type_t;
 
 typedef enum {
@@ -46,9 +48,45 @@ typedef enum {
 	M_XML_XPATH_POS_EQUALITY_GT,
 } M_xml_xpath_pos_equality_t;
 
+/* A parsed position predicate. The offset can only be resolved once we know
+ * how many nodes it applies to. */
+typedef struct {
+	M_xml_xpath_pos_equality_t equality;
+	M_int64                    offset;
+	M_bool                     is_last; /* offset is last() */
+} M_xml_xpath_pos_t;
+
+typedef struct {
+	M_xml_xpath_match_type_t  type;
+	char                     *name;   /* Tag name without a "*:" prefix or attribute name. */
+	M_bool                    any_ns; /* Tag name had a "*:" prefix. */
+	char                     *val;    /* Attribute value. */
+	M_xml_xpath_pos_t         pos;
+} M_xml_xpath_seg_t;
+
+struct M_xml_xpath {
+	M_xml_xpath_seg_t *segs;
+	size_t             num_segs;
+	size_t             start_offset;
+	M_uint32           flags;
+};
+
+typedef struct {
+	const M_xml_xpath_t    *xpath;
+	M_xml_xpath_match_func  match_func;
+	void                   *thunk;
+	size_t                  num_matches;
+	M_bool                  stop;
+} M_xml_xpath_ctx_t;
+
+typedef struct {
+	M_xml_node_t **matches;
+	size_t         num_matches;
+} M_xml_xpath_matches_t;
+
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
-static void M_xml_xpath_search(M_xml_node_t *node, M_list_str_t *segments, size_t seg_offset, M_uint32 flags, M_bool search_recursive, M_xml_node_t ***matches, size_t *num_matches);
+static void M_xml_xpath_search(M_xml_node_t *node, M_xml_xpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive);
 
 static M_xml_node_t *M_xml_node_find_doc(M_xml_node_t *node)
 {
@@ -59,8 +97,13 @@ static M_xml_node_t *M_xml_node_find_doc(M_xml_node_t *node)
 
 static M_xml_xpath_match_type_t M_xml_xpath_search_segment_type(const char *seg)
 {
-	if (seg == NULL || *seg == '\0')
-		return M_XML_XPATH_MATCH_TYPE_TAG;
+	/* A blank segment denotes we want to search recursively for the next pattern */
+	if (seg == NULL || *seg == '\0' || M_str_eq(seg, "."))
+		return M_XML_XPATH_MATCH_TYPE_RECURSIVE;
+
+	/* Are we moving up to the parent? */
+	if (M_str_eq(seg, ".."))
+		return M_XML_XPATH_MATCH_TYPE_PARENT;
 
 	if (*seg == '[') {
 		/* Invalid predicate. */
@@ -86,26 +129,29 @@ static M_xml_xpath_match_type_t M_xml_xpath_search_segment_type(const char *seg)
 	return M_XML_XPATH_MATCH_TYPE_TAG;
 }
 
-static M_bool M_xml_xpath_search_tag_eq(M_xml_node_t *node, const char *tag, M_uint32 flags)
+/* Recursive and parent segments are compared as tag names when they precede a position. */
+static M_bool M_xml_xpath_seg_is_tag(const M_xml_xpath_seg_t *seg)
+{
+	return seg->type == M_XML_XPATH_MATCH_TYPE_TAG || seg->type == M_XML_XPATH_MATCH_TYPE_RECURSIVE || seg->type == M_XML_XPATH_MATCH_TYPE_PARENT;
+}
+
+static M_bool M_xml_xpath_search_tag_eq(M_xml_node_t *node, const M_xml_xpath_seg_t *seg, M_uint32 flags)
 {
 	const char *name;
-	size_t      len;
 	char       *p;
 
 	name = M_xml_node_name(node);
 
-	len = M_str_len(tag);
-	if (len > 2 && M_str_eq_max(tag, "*:", 2)) {
-		tag += 2;
+	if (seg->any_ns) {
 		p = M_str_chr(name, ':');
 		if (p != NULL) {
 			name = p+1;
 		}
 	}
 
-	if (M_str_eq(tag, "*") ||
-		(flags & M_XML_READER_TAG_CASECMP && M_str_caseeq(tag, name)) ||
-		(!(flags & M_XML_READER_TAG_CASECMP) && M_str_eq(tag, name)))
+	if (M_str_eq(seg->name, "*") ||
+		(flags & M_XML_READER_TAG_CASECMP && M_str_caseeq(seg->name, name)) ||
+		(!(flags & M_XML_READER_TAG_CASECMP) && M_str_eq(seg->name, name)))
 	{
 		return M_TRUE;
 	}
@@ -113,20 +159,19 @@ static M_bool M_xml_xpath_search_tag_eq(M_xml_node_t *node, const char *tag, M_u
 	return M_FALSE;
 }
 
-static M_bool M_xml_xpath_search_match_node_pos_offset(const char *val, size_t val_len, size_t array_len, size_t *out_pos, size_t *out_max)
+static M_bool M_xml_xpath_compile_pos(const char *val, size_t val_len, M_xml_xpath_pos_t *pos)
 {
-	M_buf_t                    *buf;
-	char                       *myval;
-	char                       *p;
-	char                        sign;
-	M_xml_xpath_pos_equality_t  equality      = M_XML_XPATH_POS_EQUALITY_EQ;
-	M_int64                     offset        = 0;
-	const size_t                wlen_position = 10; /* M_str_len("position()"); */
-	const size_t                wlen_last     = 6; /* M_str_len("last()"); */
-	M_bool                      has_last      = M_FALSE;
-
-	*out_pos = 0;
-	*out_max = 1;
+	M_buf_t      *buf;
+	char         *myval;
+	char         *p;
+	char          sign;
+	const size_t  wlen_position = 10; /* M_str_len("position()"); */
+	const size_t  wlen_last     = 6; /* M_str_len("last()"); */
+	M_bool        has_last      = M_FALSE;
+
+	pos->equality = M_XML_XPATH_POS_EQUALITY_EQ;
+	pos->offset   = 0;
+	pos->is_last  = M_FALSE;
 
 	myval = M_strdup_trim(val);
 
@@ -146,21 +191,21 @@ static M_bool M_xml_xpath_search_match_node_pos_offset(const char *val, size_t v
 		/* Determine what kind of equality is being used. Store and move past it. */
 		if ((p = M_str_str(myval, "<=")) != NULL) {
 			p += 2;
-			equality = M_XML_XPATH_POS_EQUALITY_LTE;
+			pos->equality = M_XML_XPATH_POS_EQUALITY_LTE;
 		} else if ((p = M_str_str(myval, ">=")) != NULL) {
 			p += 2;
-			equality = M_XML_XPATH_POS_EQUALITY_GTE;
+			pos->equality = M_XML_XPATH_POS_EQUALITY_GTE;
 		} else if ((p = M_str_chr(myval, '<')) != NULL) {
 			p++;
-			equality = M_XML_XPATH_POS_EQUALITY_LT;
+			pos->equality = M_XML_XPATH_POS_EQUALITY_LT;
 		} else if ((p = M_str_chr(myval, '>')) != NULL) {
 			p++;
-			equality = M_XML_XPATH_POS_EQUALITY_GT;
+			pos->equality = M_XML_XPATH_POS_EQUALITY_GT;
 		} else if ((p = M_str_chr(myval, '=')) != NULL) {
 			/* '=' needs to come last but before else because 
  			 * str_chr would match "<=" or ">=" too. */
 			p++;
-			equality = M_XML_XPATH_POS_EQUALITY_EQ;
+			pos->equality = M_XML_XPATH_POS_EQUALITY_EQ;
 		} else {
 			/* Position requires modifier. */
 			M_free(myval);
@@ -189,54 +234,62 @@ static M_bool M_xml_xpath_search_match_node_pos_offset(const char *val, size_t v
 	if (M_str_isempty(myval)) {
 		/* If last was used we could have an empty value. In this case
  		 * the offset is the last offset. Otherwise it's an invalid expression. */
-		if (has_last) {
-			offset = (M_int64)array_len;
-		} else {
-			M_free(myval);
+		M_free(myval);
+		if (!has_last)
 			return M_FALSE;
-		}
-	} else {
-		/* Remove white space between the sign (if it exists) and the number. */
-		if (*myval == '-' || *myval == '+') {
-			sign   = *myval;
-			*myval = ' ';
-			p = myval;
-			while (M_chr_isspace(*p)) {
-				p++;
-			}
-			*(p-1) = sign;
-			M_str_trim(myval);
-		}
+		pos->is_last = M_TRUE;
+		return M_TRUE;
+	}
 
-		if (M_str_to_int64_ex(myval, val_len, 10, &offset, NULL) != M_STR_INT_SUCCESS) {
-			M_free(myval);
-			return M_FALSE;
+	/* Remove white space between the sign (if it exists) and the number. */
+	if (*myval == '-' || *myval == '+') {
+		sign   = *myval;
+		*myval = ' ';
+		p = myval;
+		while (M_chr_isspace(*p)) {
+			p++;
 		}
+		*(p-1) = sign;
+		M_str_trim(myval);
+	}
 
-		if (offset < 0) {
-			/* Negative means index from the right instead of the left. */
-			if ((M_int64)array_len + offset <= 0) {
-				M_free(myval);
-				return M_FALSE;
-			}
-			offset = (M_int64)array_len + offset;
-		} else if (offset == 0) {
-			/* 0 off set is invalid because XPath offsets start at 1. */
-			M_free(myval);
+	if (M_str_to_int64_ex(myval, val_len, 10, &pos->offset, NULL) != M_STR_INT_SUCCESS) {
+		M_free(myval);
+		return M_FALSE;
+	}
+	M_free(myval);
+
+	/* 0 off set is invalid because XPath offsets start at 1. */
+	if (pos->offset == 0)
+		return M_FALSE;
+
+	/* We have a positive value and last is present.
+ 	 * Can't index more than the last item. */
+	if (pos->offset > 0 && has_last)
+		return M_FALSE;
+
+	return M_TRUE;
+}
+
+static M_bool M_xml_xpath_search_match_node_pos_offset(const M_xml_xpath_pos_t *pos, size_t array_len, size_t *out_pos, size_t *out_max)
+{
+	M_int64 offset = pos->offset;
+
+	*out_pos = 0;
+	*out_max = 1;
+
+	if (pos->is_last) {
+		offset = (M_int64)array_len;
+	} else if (offset < 0) {
+		/* Negative means index from the right instead of the left. */
+		if ((M_int64)array_len + offset <= 0) {
 			return M_FALSE;
-		} else {
-			/* We have a positive value and last is present.
- 			 * Can't index more than the last item. */
-			if (has_last) {
-				M_free(myval);
-				return M_FALSE;
-			}
 		}
+		offset = (M_int64)array_len + offset;
 	}
-	M_free(myval);
 
 	/* Set the start and number of positions the expression can match. */
-	switch (equality) {
+	switch (pos->equality) {
 		case M_XML_XPATH_POS_EQUALITY_EQ:
 			*out_pos = (size_t)offset;
 			break;
@@ -261,7 +314,7 @@ static M_bool M_xml_xpath_search_match_node_pos_offset(const char *val, size_t v
 	return M_TRUE;
 }
 
-static void M_xml_xpath_search_match_node_tag(const char *seg, M_xml_node_t *node, M_list_str_t *segments, size_t seg_offset, M_uint32 flags, M_bool search_recursive, M_xml_node_t ***matches, size_t *num_matches)
+static void M_xml_xpath_search_match_node_tag(const M_xml_xpath_seg_t *seg, M_xml_node_t *node, M_xml_xpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive)
 {
 	M_xml_node_t *ptr;
 	size_t        num_children;
@@ -269,127 +322,73 @@ static void M_xml_xpath_search_match_node_tag(const char *seg, M_xml_node_t *nod
 
 	/* Iterate over children of this branch looking for matches */
 	num_children = M_xml_node_num_children(node);
-	for (i=0; i<num_children; i++) {
+	for (i=0; i<num_children && !ctx->stop; i++) {
 		ptr = M_xml_node_child(node, i);
 		if (M_xml_node_type(ptr) != M_XML_NODE_TYPE_ELEMENT)
 			continue;
 
-		if (M_xml_xpath_search_tag_eq(ptr, seg, flags)) {
-			M_xml_xpath_search(ptr, segments, seg_offset+1, flags, M_FALSE, matches, num_matches);
+		if (M_xml_xpath_search_tag_eq(ptr, seg, ctx->xpath->flags)) {
+			M_xml_xpath_search(ptr, ctx, seg_offset+1, M_FALSE);
 		}
 
 		/* This should NOT be an "else if" to the prior statement as there could legitimately be additional
 		 * matches at deeper layers, and we need to search those too */
 		if (search_recursive) {
-			M_xml_xpath_search(ptr, segments, seg_offset, flags, M_TRUE, matches, num_matches);
+			M_xml_xpath_search(ptr, ctx, seg_offset, M_TRUE);
 		}
 	}
 }
 
-static void M_xml_xpath_search_match_node_attr_any(const char *seg, M_xml_node_t *node, M_list_str_t *segments, size_t seg_offset, M_uint32 flags, M_bool search_recursive, M_xml_node_t ***matches, size_t *num_matches)
+static void M_xml_xpath_search_match_node_attr_any(const M_xml_xpath_seg_t *seg, M_xml_node_t *node, M_xml_xpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive)
 {
 	(void)seg;
 	(void)search_recursive;
 
 	if (M_hash_dict_num_keys(M_xml_node_attributes(node)) != 0) {
-		M_xml_xpath_search(node, segments, seg_offset+1, flags, M_FALSE, matches, num_matches);
+		M_xml_xpath_search(node, ctx, seg_offset+1, M_FALSE);
 	}
 }
 
-static void M_xml_xpath_search_match_node_attr_has(const char *seg, M_xml_node_t *node, M_list_str_t *segments, size_t seg_offset, M_uint32 flags, M_bool search_recursive, M_xml_node_t ***matches, size_t *num_matches)
+static void M_xml_xpath_search_match_node_attr_has(const M_xml_xpath_seg_t *seg, M_xml_node_t *node, M_xml_xpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive)
 {
-	char *attr;
-	
 	(void)search_recursive;
 
-	/* Silence coverity. Shouldn't be possible, should get [@] at end*/
-	if (M_str_len(seg) < 3)
-		return;
-
-	/* Remove [@] from the attribute name we need to match on. */
-	attr = M_strdup_max(seg+2, M_str_len(seg)-3);
-	if (M_xml_node_attribute(node, attr) != NULL) {
-		M_xml_xpath_search(node, segments, seg_offset+1, flags, M_FALSE, matches, num_matches);
+	if (M_xml_node_attribute(node, seg->name) != NULL) {
+		M_xml_xpath_search(node, ctx, seg_offset+1, M_FALSE);
 	}
-	M_free(attr);
 }
 
-static void M_xml_xpath_search_match_node_attr_val(const char *seg, M_xml_node_t *node, M_list_str_t *segments, size_t seg_offset, M_uint32 flags, M_bool search_recursive, M_xml_node_t ***matches, size_t *num_matches)
+static void M_xml_xpath_search_match_node_attr_val(const M_xml_xpath_seg_t *seg, M_xml_node_t *node, M_xml_xpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive)
 {
-	char    **parts;
-	M_buf_t  *buf   = NULL;
-	char     *attr;
-	char     *val;
-	char     *out;
-	size_t    num_parts = 0;
-	size_t    i;
-	size_t    start = 0;
-	size_t    len;
+	const char *val;
 
 	(void)search_recursive;
 
-	parts = M_str_explode_str('=', seg, &num_parts);
-	if (parts == NULL || num_parts == 0 || M_str_len(parts[0]) < 2) {
-		M_str_explode_free(parts, num_parts);
-		return;
-	}
-
-	/* Get the attribute. */
-	attr = M_strdup_max(parts[0]+2, M_str_len(parts[0])-2);
-
 	/* If the attribute doesn't exist in the node then we can't match a value. A value of NULL/"" is
  	 * not the same as the node not being present. */
-	if (M_xml_node_attribute(node, attr) == NULL) {
-		M_str_explode_free(parts, num_parts);
-		M_free(attr);
+	val = M_xml_node_attribute(node, seg->name);
+	if (val == NULL)
 		return;
-	}
-
-	/* Get the attribute value by putting the parts after the separtor '=' together. */
-	buf = M_buf_create();
-	for (i=1; i<num_parts; i++) {
-		if (parts[i] == NULL || *(parts[i]) == '\0') {
-			continue;
-		}
-		M_buf_add_str(buf, parts[i]);
-	}
-	M_str_explode_free(parts, num_parts);
-
-	/* The value "should" be wrapped in '' and end with ]. We need to remove these extra characters. */
-	out = M_buf_finish_str(buf, &len);
-	if (*out == '\'' || *out == '"') {
-		start++;
-		len--;
-	}
-	while (len > 0 && (out[start+len-1] == '\'' || out[start+len-1] == '"' || out[start+len-1] == ']')) {
-		len--;
-	}
-	val = M_strdup_max(out+start, len);
-	M_free(out);
 
 	/* Check if the node's value matches. */
-	if (M_str_eq(M_xml_node_attribute(node, attr), val)) {
-		M_xml_xpath_search(node, segments, seg_offset+1, flags, M_FALSE, matches, num_matches);
+	if (M_str_eq(val, seg->val)) {
+		M_xml_xpath_search(node, ctx, seg_offset+1, M_FALSE);
 	}
-
-	M_free(attr);
-	M_free(val);
 }
 
-static void M_xml_xpath_search_match_node_pos(const char *seg, M_xml_node_t *node, M_list_str_t *segments, size_t seg_offset, M_uint32 flags, M_bool search_recursive, M_xml_node_t ***matches, size_t *num_matches)
+static void M_xml_xpath_search_match_node_pos(const M_xml_xpath_seg_t *seg, M_xml_node_t *node, M_xml_xpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive)
 {
-	M_xml_node_t             *parent;
-	M_xml_node_t             *ptr;
-	char                     *val;
-	const char               *last_seg;
-	M_xml_xpath_match_type_t  match_type;
-	M_xml_node_type_t         node_type;
-	size_t                    off_pos;
-	size_t                    off_max;
-	size_t                    nidx               = 0;
-	size_t                    num_children;
-	size_t                    num_children_elems = 0;
-	size_t                    i;
+	M_xml_node_t            *parent;
+	M_xml_node_t            *ptr;
+	const M_xml_xpath_seg_t *last_seg;
+	M_bool                   last_is_tag;
+	M_xml_node_type_t        node_type;
+	size_t                   off_pos;
+	size_t                   off_max;
+	size_t                   nidx               = 0;
+	size_t                   num_children;
+	size_t                   num_children_elems = 0;
+	size_t                   i;
 
 	(void)search_recursive;
 
@@ -407,17 +406,17 @@ static void M_xml_xpath_search_match_node_pos(const char *seg, M_xml_node_t *nod
 		return;
 
 	/* Get the last segment and verify it's a tag. We need to match based on the tag name. */
-	last_seg   = M_list_str_at(segments, seg_offset-1);
-	match_type = M_xml_xpath_search_segment_type(last_seg);
-	if (match_type != M_XML_XPATH_MATCH_TYPE_TAG && match_type != M_XML_XPATH_MATCH_TYPE_TEXT)
+	last_seg    = &ctx->xpath->segs[seg_offset-1];
+	last_is_tag = M_xml_xpath_seg_is_tag(last_seg);
+	if (!last_is_tag && last_seg->type != M_XML_XPATH_MATCH_TYPE_TEXT)
 		return;
 
 	/* Determine how many elements of tag name are in the parent. */
 	for (i=0; i<num_children; i++) {
 		ptr       = M_xml_node_child(parent, i);
 		node_type = M_xml_node_type(ptr);
-		if ((match_type == M_XML_XPATH_MATCH_TYPE_TAG && node_type == M_XML_NODE_TYPE_ELEMENT && M_xml_xpath_search_tag_eq(ptr, last_seg, flags)) ||
-			(match_type == M_XML_XPATH_MATCH_TYPE_TEXT && node_type == M_XML_NODE_TYPE_TEXT))
+		if ((last_is_tag && node_type == M_XML_NODE_TYPE_ELEMENT && M_xml_xpath_search_tag_eq(ptr, last_seg, ctx->xpath->flags)) ||
+			(!last_is_tag && node_type == M_XML_NODE_TYPE_TEXT))
 		{
 			num_children_elems++;
 		}
@@ -425,18 +424,9 @@ static void M_xml_xpath_search_match_node_pos(const char *seg, M_xml_node_t *nod
 	if (num_children_elems == 0)
 		return;
 
-	/* Silence coverity. Shouldn't be possible, should always have at least [] */
-	if (M_str_len(seg) < 2)
-		return;
-
-	/* Strip off []. */
-	val = M_strdup_max(seg+1, M_str_len(seg)-2);
 	/* Get the position we need to check. */
-	if (!M_xml_xpath_search_match_node_pos_offset(val, M_str_len(val), num_children_elems, &off_pos, &off_max)) {
-		M_free(val);
+	if (!M_xml_xpath_search_match_node_pos_offset(&seg->pos, num_children_elems, &off_pos, &off_max))
 		return;
-	}
-	M_free(val);
 
 	/* Offsets are 1 based. */
 	if (off_pos == 0 || off_pos > num_children) {
@@ -454,7 +444,7 @@ static void M_xml_xpath_search_match_node_pos(const char *seg, M_xml_node_t *nod
 			continue;
 
 		/* If it's an element and it matches or it's a text node it is considered a possible node. */
-		if ((node_type == M_XML_NODE_TYPE_ELEMENT && M_xml_xpath_search_tag_eq(ptr, last_seg, flags)) ||
+		if ((node_type == M_XML_NODE_TYPE_ELEMENT && M_xml_xpath_search_tag_eq(ptr, last_seg, ctx->xpath->flags)) ||
 				(node_type == M_XML_NODE_TYPE_TEXT))
 		{
 			/* Increment the index. */
@@ -467,7 +457,7 @@ static void M_xml_xpath_search_match_node_pos(const char *seg, M_xml_node_t *nod
 			/* If the index is between the allowed indexes from the expression, be it a single index
  			 * or a range continue processing with this node. */
 			if (nidx >= off_pos && nidx < off_pos+off_max) {
-				M_xml_xpath_search(ptr, segments, seg_offset+1, flags, M_FALSE, matches, num_matches);
+				M_xml_xpath_search(ptr, ctx, seg_offset+1, M_FALSE);
 			}
 			/* Don't need to check later elements because we've found the node we're looking for. */
 			break;
@@ -475,7 +465,7 @@ static void M_xml_xpath_search_match_node_pos(const char *seg, M_xml_node_t *nod
 	}
 }
 
-static void M_xml_xpath_search_match_node_text(const char *seg, M_xml_node_t *node, M_list_str_t *segments, size_t seg_offset, M_uint32 flags, M_bool search_recursive, M_xml_node_t ***matches, size_t *num_matches)
+static void M_xml_xpath_search_match_node_text(const M_xml_xpath_seg_t *seg, M_xml_node_t *node, M_xml_xpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive)
 {
 	M_xml_node_t      *ptr;
 	M_xml_node_type_t  type;
@@ -485,14 +475,14 @@ static void M_xml_xpath_search_match_node_text(const char *seg, M_xml_node_t *no
 	(void)seg;
 
 	num_children = M_xml_node_num_children(node);	
-	for (i=0; i<num_children; i++) {
+	for (i=0; i<num_children && !ctx->stop; i++) {
 		ptr  = M_xml_node_child(node, i);
 		type = M_xml_node_type(ptr);
 
 		if (type == M_XML_NODE_TYPE_TEXT) {
-			M_xml_xpath_search(ptr, segments, seg_offset+1, flags, M_FALSE, matches, num_matches);
+			M_xml_xpath_search(ptr, ctx, seg_offset+1, M_FALSE);
 		} else if (search_recursive && type == M_XML_NODE_TYPE_ELEMENT) {
-			M_xml_xpath_search(ptr, segments, seg_offset, flags, M_TRUE, matches, num_matches);
+			M_xml_xpath_search(ptr, ctx, seg_offset, M_TRUE);
 		}
 	}
 }
@@ -506,19 +496,26 @@ static void M_xml_xpath_search_add_match(M_xml_node_t *node, M_xml_node_t ***mat
 	(*num_matches)++;
 }
 
-static void M_xml_xpath_search(M_xml_node_t *node, M_list_str_t *segments, size_t seg_offset, M_uint32 flags, M_bool search_recursive, M_xml_node_t ***matches, size_t *num_matches)
+static void M_xml_xpath_search_match(M_xml_node_t *node, M_xml_xpath_ctx_t *ctx)
 {
-	const char               *seg;
-	M_xml_node_type_t         type;
-	size_t                    num_segments;
-	M_xml_xpath_match_type_t  match_type;
+	ctx->num_matches++;
+	if (!ctx->match_func(node, ctx->thunk)) {
+		ctx->stop = M_TRUE;
+	}
+}
+
+static void M_xml_xpath_search(M_xml_node_t *node, M_xml_xpath_ctx_t *ctx, size_t seg_offset, M_bool search_recursive)
+{
+	const M_xml_xpath_seg_t *seg;
+	M_xml_node_type_t        type;
+	size_t                   num_segments;
 
-	if (node == NULL)
+	if (node == NULL || ctx->stop)
 		return;
 
-	num_segments = M_list_str_len(segments)-seg_offset;
+	num_segments = ctx->xpath->num_segs-seg_offset;
 	if (num_segments == 0) {
-		M_xml_xpath_search_add_match(node, matches, num_matches);
+		M_xml_xpath_search_match(node, ctx);
 		return;
 	}
 
@@ -526,45 +523,37 @@ static void M_xml_xpath_search(M_xml_node_t *node, M_list_str_t *segments, size_
 	if (type != M_XML_NODE_TYPE_ELEMENT && type != M_XML_NODE_TYPE_DOC && type != M_XML_NODE_TYPE_TEXT)
 		return;
 
-	seg = M_list_str_at(segments, seg_offset);
-	/* A blank segment denotes we want to search recursively for the next pattern */
-	if (seg == NULL || *seg == '\0' || M_str_eq(seg, ".")) {
-		/* Only recurse if there is something else to match */
-		if (num_segments > 1) {
-			M_xml_xpath_search(node, segments, seg_offset+1, flags, M_TRUE, matches, num_matches);
-		}
-		return;
-	}
-
-	/* Are we moving up to the parent? */
-	if (M_str_eq(seg, "..")) {
-		if (M_xml_node_parent(node) != NULL) {
-			node = M_xml_node_parent(node);
-		}
-		M_xml_xpath_search(node, segments, seg_offset+1, flags, M_FALSE, matches, num_matches);
-		return;
-	}
-
-	/* Determine the type of match we need to use. */
-	match_type = M_xml_xpath_search_segment_type(seg);
-	switch (match_type) {
+	seg = &ctx->xpath->segs[seg_offset];
+	switch (seg->type) {
+		case M_XML_XPATH_MATCH_TYPE_RECURSIVE:
+			/* Only recurse if there is something else to match */
+			if (num_segments > 1) {
+				M_xml_xpath_search(node, ctx, seg_offset+1, M_TRUE);
+			}
+			break;
+		case M_XML_XPATH_MATCH_TYPE_PARENT:
+			if (M_xml_node_parent(node) != NULL) {
+				node = M_xml_node_parent(node);
+			}
+			M_xml_xpath_search(node, ctx, seg_offset+1, M_FALSE);
+			break;
 		case M_XML_XPATH_MATCH_TYPE_TAG:
-			M_xml_xpath_search_match_node_tag(seg, node, segments, seg_offset, flags, search_recursive, matches, num_matches);
+			M_xml_xpath_search_match_node_tag(seg, node, ctx, seg_offset, search_recursive);
 			break;
 		case M_XML_XPATH_MATCH_TYPE_ATTR_ANY:
-			M_xml_xpath_search_match_node_attr_any(seg, node, segments, seg_offset, flags, search_recursive, matches, num_matches);
+			M_xml_xpath_search_match_node_attr_any(seg, node, ctx, seg_offset, search_recursive);
 			break;
 		case M_XML_XPATH_MATCH_TYPE_ATTR_HAS:
-			M_xml_xpath_search_match_node_attr_has(seg, node, segments, seg_offset, flags, search_recursive, matches, num_matches);
+			M_xml_xpath_search_match_node_attr_has(seg, node, ctx, seg_offset, search_recursive);
 			break;
 		case M_XML_XPATH_MATCH_TYPE_ATTR_VAL:
-			M_xml_xpath_search_match_node_attr_val(seg, node, segments, seg_offset, flags, search_recursive, matches, num_matches);
+			M_xml_xpath_search_match_node_attr_val(seg, node, ctx, seg_offset, search_recursive);
 			break;
 		case M_XML_XPATH_MATCH_TYPE_POS:
-			M_xml_xpath_search_match_node_pos(seg, node, segments, seg_offset, flags, search_recursive, matches, num_matches);
+			M_xml_xpath_search_match_node_pos(seg, node, ctx, seg_offset, search_recursive);
 			break;
 		case M_XML_XPATH_MATCH_TYPE_TEXT:
-			M_xml_xpath_search_match_node_text(seg, node, segments, seg_offset, flags, search_recursive, matches, num_matches);
+			M_xml_xpath_search_match_node_text(seg, node, ctx, seg_offset, search_recursive);
 			break;
 		case M_XML_XPATH_MATCH_TYPE_INVALID:
 			break;
@@ -573,26 +562,123 @@ static void M_xml_xpath_search(M_xml_node_t *node, M_list_str_t *segments, size_
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-M_xml_node_t **M_xml_xpath(M_xml_node_t *node, const char *search, M_uint32 flags, size_t *num_matches)
+static M_bool M_xml_xpath_compile_attr_val(M_xml_xpath_seg_t *seg, const char *segment)
 {
-	M_xml_node_t **matches           = NULL;
-	char         **segments;
-	char         **pred_segments;
-	M_list_str_t  *seg_list;
-	M_buf_t       *buf;
-	char          *out;
-	size_t         start_offset      = 0;
-	size_t         num_segments      = 0;
-	size_t         num_pred_segments = 0;
-	size_t         i;
-	size_t         j;
+	char    **parts;
+	M_buf_t  *buf;
+	char     *out;
+	size_t    num_parts = 0;
+	size_t    i;
+	size_t    start     = 0;
+	size_t    len;
 
-	if (num_matches == NULL) {
-		return NULL;
+	parts = M_str_explode_str('=', segment, &num_parts);
+	if (parts == NULL || num_parts == 0 || M_str_len(parts[0]) < 2) {
+		M_str_explode_free(parts, num_parts);
+		return M_FALSE;
 	}
-	*num_matches = 0;
 
-	if (node == NULL || search == NULL)
+	/* Get the attribute. */
+	seg->name = M_strdup_max(parts[0]+2, M_str_len(parts[0])-2);
+
+	/* Get the attribute value by putting the parts after the separtor '=' together. */
+	buf = M_buf_create();
+	for (i=1; i<num_parts; i++) {
+		if (parts[i] == NULL || *(parts[i]) == '\0') {
+			continue;
+		}
+		M_buf_add_str(buf, parts[i]);
+	}
+	M_str_explode_free(parts, num_parts);
+
+	/* The value "should" be wrapped in '' and end with ]. We need to remove these extra characters. */
+	out = M_buf_finish_str(buf, &len);
+	if (*out == '\'' || *out == '"') {
+		start++;
+		len--;
+	}
+	while (len > 0 && (out[start+len-1] == '\'' || out[start+len-1] == '"' || out[start+len-1] == ']')) {
+		len--;
+	}
+	seg->val = M_strdup_max(out+start, len);
+	M_free(out);
+
+	return M_TRUE;
+}
+
+/* Segments that can never match are rejected here instead of during the search. */
+static M_bool M_xml_xpath_compile_seg(M_xml_xpath_t *xpath, const char *segment)
+{
+	M_xml_xpath_seg_t *seg = &xpath->segs[xpath->num_segs++];
+	char              *val;
+	M_bool             ret;
+
+	seg->type = M_xml_xpath_search_segment_type(segment);
+	switch (seg->type) {
+		case M_XML_XPATH_MATCH_TYPE_TAG:
+		case M_XML_XPATH_MATCH_TYPE_RECURSIVE:
+		case M_XML_XPATH_MATCH_TYPE_PARENT:
+			if (M_str_len(segment) > 2 && M_str_eq_max(segment, "*:", 2)) {
+				seg->any_ns  = M_TRUE;
+				segment     += 2;
+			}
+			seg->name = M_strdup(segment);
+			return M_TRUE;
+		case M_XML_XPATH_MATCH_TYPE_ATTR_HAS:
+			/* Remove [@] from the attribute name we need to match on. */
+			seg->name = M_strdup_max(segment+2, M_str_len(segment)-3);
+			return M_TRUE;
+		case M_XML_XPATH_MATCH_TYPE_ATTR_VAL:
+			return M_xml_xpath_compile_attr_val(seg, segment);
+		case M_XML_XPATH_MATCH_TYPE_POS:
+			/* Strip off []. */
+			val = M_strdup_max(segment+1, M_str_len(segment)-2);
+			ret = M_xml_xpath_compile_pos(val, M_str_len(val), &seg->pos);
+			M_free(val);
+			return ret;
+		case M_XML_XPATH_MATCH_TYPE_ATTR_ANY:
+		case M_XML_XPATH_MATCH_TYPE_TEXT:
+			return M_TRUE;
+		case M_XML_XPATH_MATCH_TYPE_INVALID:
+			break;
+	}
+	return M_FALSE;
+}
+
+static M_bool M_xml_xpath_matches_cb(M_xml_node_t *node, void *thunk)
+{
+	M_xml_xpath_matches_t *m = thunk;
+
+	M_xml_xpath_search_add_match(node, &m->matches, &m->num_matches);
+	return M_TRUE;
+}
+
+static M_bool M_xml_xpath_first_cb(M_xml_node_t *node, void *thunk)
+{
+	M_xml_node_t **match = thunk;
+
+	*match = node;
+	return M_FALSE;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+M_xml_xpath_t *M_xml_xpath_compile(const char *search, M_uint32 flags)
+{
+	M_xml_xpath_t  *xpath;
+	char          **segments;
+	char          **pred_segments;
+	M_buf_t        *buf;
+	char           *out;
+	const char     *p;
+	size_t          num_segments      = 0;
+	size_t          num_pred_segments = 0;
+	size_t          max_segs          = 0;
+	M_bool          ret;
+	size_t          i;
+	size_t          j;
+
+	if (search == NULL)
 		return NULL;
 
 	segments = M_str_explode_str('/', search, &num_segments);
@@ -602,11 +688,22 @@ M_xml_node_t **M_xml_xpath(M_xml_node_t *node, const char *search, M_uint32 flag
 		return NULL;
 	}
 
+	/* Every '[' can start a segment. */
+	for (i=0; i<num_segments; i++) {
+		max_segs++;
+		for (p=M_str_chr(segments[i], '['); p!=NULL; p=M_str_chr(p+1, '[')) {
+			max_segs++;
+		}
+	}
+
+	xpath        = M_malloc_zero(sizeof(*xpath));
+	xpath->segs  = M_malloc_zero(max_segs * sizeof(*xpath->segs));
+	xpath->flags = flags;
+
 	/* Further split on '[' to pull out predicate filters. */
-	seg_list = M_list_str_create(M_LIST_STR_NONE);
 	for (i=0; i<num_segments; i++) {
 		if (*(segments[i]) == '\0') {
-			M_list_str_insert(seg_list, "");
+			M_xml_xpath_compile_seg(xpath, "");
 			continue;
 		}
 
@@ -624,91 +721,164 @@ M_xml_node_t **M_xml_xpath(M_xml_node_t *node, const char *search, M_uint32 flag
 			/* First one may not start with '['. We need to check if the segment is something like:
 			 * 'abc'/'abc[1]' vs '[1]'. */
 			if (j == 0 && *(segments[i]) != '[') {
-				M_list_str_insert(seg_list, pred_segments[j]);
-				continue;
+				ret = M_xml_xpath_compile_seg(xpath, pred_segments[j]);
+			} else if (pred_segments[j][M_str_len(pred_segments[j])-1] != ']') {
+				/* Verify that our predicate ends with a ']'. If it doesn't then this is an invaild expression. */
+				ret = M_FALSE;
+			} else {
+				/* Put the '[' back on the front of the segment and add it to our list of segments. */
+				buf = M_buf_create();
+				M_buf_add_byte(buf, '[');
+				M_buf_add_str(buf, pred_segments[j]);
+				out = M_buf_finish_str(buf, NULL);
+				ret = M_xml_xpath_compile_seg(xpath, out);
+				M_free(out);
 			}
-			
-			/* Verify that our predicate ends with a ']'. If it doesn't then this is an invaild expression. */
-			if (pred_segments[j][M_str_len(pred_segments[j])-1] != ']') {
+
+			if (!ret) {
 				M_str_explode_free(pred_segments, num_pred_segments);
 				M_str_explode_free(segments, num_segments);
-				M_list_str_destroy(seg_list);
+				M_xml_xpath_destroy(xpath);
 				return NULL;
 			}
-
-			/* Put the '[' back on the front of the segment and add it to our list of segments. */
-			buf = M_buf_create();
-			M_buf_add_byte(buf, '[');
-			M_buf_add_str(buf, pred_segments[j]);
-			out = M_buf_finish_str(buf, NULL);
-			M_list_str_insert(seg_list, out);
-			M_free(out);
 		}
 		M_str_explode_free(pred_segments, num_pred_segments);
 	}
 	M_str_explode_free(segments, num_segments);
 
-	if (M_list_str_len(seg_list) == 0) {
-		M_list_str_destroy(seg_list);
+	if (xpath->num_segs == 0) {
+		M_xml_xpath_destroy(xpath);
 		return NULL;
 	}
 
-	if (M_str_len(M_list_str_at(seg_list, 0)) == 0) {
-		/* If the first node is blank, that means the search pattern started with '/',
-		 * which means we need to scan to the doc node. Anything else is the start of
-		 * the search pattern, so we'll use the passed node for searching. */
-		node         = M_xml_node_find_doc(node);
-		start_offset = 1;
+	/* If the first segment is blank, that means the search pattern started with '/',
+	 * which means we need to scan to the doc node. Anything else is the start of
+	 * the search pattern, so we'll use the passed node for searching. */
+	if (xpath->segs[0].type == M_XML_XPATH_MATCH_TYPE_RECURSIVE && M_str_isempty(xpath->segs[0].name))
+		xpath->start_offset = 1;
+
+	return xpath;
+}
+
+void M_xml_xpath_destroy(M_xml_xpath_t *xpath)
+{
+	size_t i;
+
+	if (xpath == NULL)
+		return;
+
+	for (i=0; i<xpath->num_segs; i++) {
+		M_free(xpath->segs[i].name);
+		M_free(xpath->segs[i].val);
 	}
+	M_free(xpath->segs);
+	M_free(xpath);
+}
+
+size_t M_xml_xpath_foreach(const M_xml_xpath_t *xpath, M_xml_node_t *node, M_xml_xpath_match_func match_func, void *thunk)
+{
+	M_xml_xpath_ctx_t ctx;
+
+	if (xpath == NULL || node == NULL || match_func == NULL)
+		return 0;
+
+	M_mem_set(&ctx, 0, sizeof(ctx));
+	ctx.xpath      = xpath;
+	ctx.match_func = match_func;
+	ctx.thunk      = thunk;
+
+	if (xpath->start_offset != 0)
+		node = M_xml_node_find_doc(node);
 
-	if (M_list_str_len(seg_list) - start_offset != 0) {
+	if (xpath->num_segs - xpath->start_offset != 0) {
 		/* Only do the search if there is something to search */
-		M_xml_xpath_search(node, seg_list, start_offset, flags, M_FALSE, &matches, num_matches);
+		M_xml_xpath_search(node, &ctx, xpath->start_offset, M_FALSE);
 	} else {
 		/* Otherwise I suppose it makes sense to return the current node */
-		matches      = M_malloc(sizeof(*matches));
-		matches[0]   = node;
-		*num_matches = 1;
+		M_xml_xpath_search_match(node, &ctx);
+	}
+
+	return ctx.num_matches;
+}
+
+M_xml_node_t **M_xml_xpath_eval(const M_xml_xpath_t *xpath, M_xml_node_t *node, size_t *num_matches)
+{
+	M_xml_xpath_matches_t m;
+
+	if (num_matches == NULL)
+		return NULL;
+	*num_matches = 0;
+
+	M_mem_set(&m, 0, sizeof(m));
+	M_xml_xpath_foreach(xpath, node, M_xml_xpath_matches_cb, &m);
+
+	*num_matches = m.num_matches;
+	return m.matches;
+}
+
+M_xml_node_t *M_xml_xpath_first(const M_xml_xpath_t *xpath, M_xml_node_t *node)
+{
+	M_xml_node_t *match = NULL;
+
+	M_xml_xpath_foreach(xpath, node, M_xml_xpath_first_cb, &match);
+	return match;
+}
+
+M_xml_node_t **M_xml_xpath(M_xml_node_t *node, const char *search, M_uint32 flags, size_t *num_matches)
+{
+	M_xml_xpath_t  *xpath;
+	M_xml_node_t  **matches;
+
+	if (num_matches == NULL) {
+		return NULL;
 	}
+	*num_matches = 0;
+
+	if (node == NULL || search == NULL)
+		return NULL;
 
-	M_list_str_destroy(seg_list);
+	xpath = M_xml_xpath_compile(search, flags);
+	if (xpath == NULL)
+		return NULL;
+
+	matches = M_xml_xpath_eval(xpath, node, num_matches);
+	M_xml_xpath_destroy(xpath);
 	return matches;
 }
 
 const char *M_xml_xpath_text_first(M_xml_node_t *node, const char *search)
 {
-	M_xml_node_t **matches     = NULL;
+	M_xml_xpath_t *xpath;
 	M_xml_node_t  *match;
 	const char    *text        = NULL;
-	size_t         num_matches = 0;
 	size_t         num_children;
 	size_t         i;
 
-	matches = M_xml_xpath(node, search, M_XML_READER_NONE, &num_matches);
-	if (matches != NULL && num_matches > 0) {
-		match = matches[0];
+	xpath = M_xml_xpath_compile(search, M_XML_READER_NONE);
+	match = M_xml_xpath_first(xpath, node);
+	M_xml_xpath_destroy(xpath);
 
-		/* Check if we got a text node. (expression with /text()) */
-		if (M_xml_node_type(match) == M_XML_NODE_TYPE_TEXT) {
-			text = M_xml_node_text(match);
-		}
+	if (match == NULL)
+		return NULL;
 
-		/* Otherwise we have an element and we want to pull the first text node if it has one. */
-		num_children = M_xml_node_num_children(match);
-		for (i=0; i<num_children; i++) {
-			if (M_xml_node_type(M_xml_node_child(match, i)) == M_XML_NODE_TYPE_TEXT) {
-				text = M_xml_node_text(M_xml_node_child(match, i));
-				break;
-			}
-		}
+	/* Check if we got a text node. (expression with /text()) */
+	if (M_xml_node_type(match) == M_XML_NODE_TYPE_TEXT) {
+		text = M_xml_node_text(match);
 	}
 
-	M_free(matches);
+	/* Otherwise we have an element and we want to pull the first text node if it has one. */
+	num_children = M_xml_node_num_children(match);
+	for (i=0; i<num_children; i++) {
+		if (M_xml_node_type(M_xml_node_child(match, i)) == M_XML_NODE_TYPE_TEXT) {
+			text = M_xml_node_text(M_xml_node_child(match, i));
+			break;
+		}
+	}
 
 	/* The xpath succeeded, but there was no actual text.  Return blank text
 	 * rather than NULL to indicate that the node requested did exist, just
 	 * there was no text element in it. */
-	if (text == NULL && num_matches > 0) {
+	if (text == NULL) {
 		text = "";
 	}
 	return text;
@@ -351,6 +351,146 @@ M_API void M_csv_output_rows_buf(M_buf_t *buf, const M_csv_t *csv, M_list_str_t
 
 /*! @} */
 
+/*! \addtogroup m_csv_reader CSV Stream Reader
+ *  \ingroup m_csv
+ *
+ * Incremental CSV reader.
+ *
+ * Data is fed in chunks of any size as it's received or read from a file and a
+ * callback is called for each row as soon as it's complete. Quoted cells can span
+ * chunks. Only the row currently being read is held in memory so the size of the
+ * data being read is not limited by available memory.
+ *
+ * Cells are handled the same as M_csv_parse. Unlike M_csv_parse every cell in a row
+ * is passed to the callback, rows are not truncated or padded to the number of
+ * cells in the first row.
+ *
+ * Data that is already in memory, such as a memory mapped file, can be split into
+ * pieces with M_csv_split_rows and each piece read with its own reader in parallel.
+ * For example, by dispatching each piece to a M_threadpool_t. Row numbers passed to
+ * the callback are relative to the start of the piece.
+ *
+ * Example:
+ *
+ * \code{.c}
+ *     static M_bool row_cb(size_t row, const char * const *cells, size_t num_cells, void *thunk)
+ *     {
+ *         size_t i;
+ *
+ *         (void)thunk;
+ *
+ *         for (i=0; i<num_cells; i++) {
+ *             M_printf("%zu:%zu='%s'\n", row, i, cells[i]==NULL?"":cells[i]);
+ *         }
+ *         return M_TRUE;
+ *     }
+ *
+ *     M_csv_reader_t *reader;
+ *     char            chunk[8192];
+ *     size_t          len;
+ *
+ *     reader = M_csv_reader_create(',', '"', M_CSV_FLAG_NONE, row_cb, NULL);
+ *     while (M_fs_file_read(fd, chunk, sizeof(chunk), &len, M_FS_FILE_RW_NORMAL) == M_FS_ERROR_SUCCESS && len > 0) {
+ *         if (!M_csv_reader_read(reader, chunk, len)) {
+ *             break;
+ *         }
+ *     }
+ *     M_csv_reader_finish(reader);
+ *     M_csv_reader_destroy(reader);
+ * \endcode
+ *
+ * @{
+ */
+
+struct M_csv_reader;
+typedef struct M_csv_reader M_csv_reader_t;
+
+
+/*! Callback for each row.
+ *
+ * \param[in] row       Index of the row starting at 0. The header, if present, is row 0.
+ * \param[in] cells     Cells in the row. An empty cell that was not quoted is NULL.
+ *                      Cells are only valid for the duration of the callback.
+ * \param[in] num_cells Number of cells in the row.
+ * \param[in] thunk     Thunk passed to M_csv_reader_create.
+ *
+ * \return M_TRUE to continue. M_FALSE to stop reading.
+ */
+typedef M_bool (*M_csv_reader_row_func)(size_t row, const char * const *cells, size_t num_cells, void *thunk);
+
+
+/*! Create a CSV stream reader.
+ *
+ * \param[in] delim    CSV delimiter character. Typically comma (',').
+ * \param[in] quote    CSV quote character. Typically double quote ('"').
+ * \param[in] flags    Flags controlling parse behavior. From M_CSV_FLAGS.
+ * \param[in] row_func Callback for each row.
+ * \param[in] thunk    Thunk passed to row_func.
+ *
+ * \return Object. NULL if row_func is NULL.
+ */
+M_API M_csv_reader_t *M_csv_reader_create(char delim, char quote, M_uint32 flags, M_csv_reader_row_func row_func, void *thunk);
+
+
+/*! Destroy a CSV stream reader.
+ *
+ * \param[in] reader The reader.
+ */
+M_API void M_csv_reader_destroy(M_csv_reader_t *reader) M_FREE(1);
+
+
+/*! Read a chunk of data.
+ *
+ * The row callback is called for every row completed by this chunk.
+ *
+ * \param[in] reader The reader.
+ * \param[in] data   Data. Does not need to end on a row or cell boundary.
+ * \param[in] len    Length of data.
+ *
+ * \return M_TRUE on success. M_FALSE if the row callback stopped reading.
+ */
+M_API M_bool M_csv_reader_read(M_csv_reader_t *reader, const char *data, size_t len);
+
+
+/*! Finish reading.
+ *
+ * Passes the last row to the row callback if it did not end with a new line.
+ *
+ * \param[in] reader The reader.
+ *
+ * \return M_TRUE on success. M_FALSE if the row callback stopped reading.
+ */
+M_API M_bool M_csv_reader_finish(M_csv_reader_t *reader);
+
+
+/*! Number of rows that have been passed to the row callback.
+ *
+ * \param[in] reader The reader.
+ *
+ * \return Count.
+ */
+M_API size_t M_csv_reader_num_rows(const M_csv_reader_t *reader);
+
+
+/*! Split CSV data into pieces that start at the beginning of a row.
+ *
+ * The data is divided into pieces of about the same size that can be read
+ * independently of each other. Only quotes and new lines are considered so
+ * this is much faster than reading the data.
+ *
+ * \param[in]  data        The data.
+ * \param[in]  len         Length of data.
+ * \param[in]  quote       CSV quote character. Typically double quote ('"').
+ * \param[out] offsets     Start of each piece. The first is always 0. A piece ends
+ *                         where the next starts or at the end of the data.
+ * \param[in]  num_offsets Maximum number of pieces. Number of elements in offsets.
+ *
+ * \return Number of pieces. Less than num_offsets if there are not enough rows.
+ */
+M_API size_t M_csv_split_rows(const char *data, size_t len, char quote, size_t *offsets, size_t num_offsets);
+
+/*! @} */
+
 __END_DECLS
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
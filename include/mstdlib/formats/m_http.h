@@ -157,6 +157,83 @@ typedef enum {
 } M_http_data_format_t;
 
 
+/*! Well known header names. */
+typedef enum {
+	M_HTTP_HEADER_UNKNOWN = 0,               /*!< Not a well known header. */
+	M_HTTP_HEADER_ACCEPT,                    /*!< Accept. */
+	M_HTTP_HEADER_ACCEPT_CHARSET,            /*!< Accept-Charset. */
+	M_HTTP_HEADER_ACCEPT_ENCODING,           /*!< Accept-Encoding. */
+	M_HTTP_HEADER_ACCEPT_LANGUAGE,           /*!< Accept-Language. */
+	M_HTTP_HEADER_ACCEPT_RANGES,             /*!< Accept-Ranges. */
+	M_HTTP_HEADER_AGE,                       /*!< Age. */
+	M_HTTP_HEADER_ALLOW,                     /*!< Allow. */
+	M_HTTP_HEADER_AUTHORIZATION,             /*!< Authorization. */
+	M_HTTP_HEADER_CACHE_CONTROL,             /*!< Cache-Control. */
+	M_HTTP_HEADER_CONNECTION,                /*!< Connection. */
+	M_HTTP_HEADER_CONTENT_DISPOSITION,       /*!< Content-Disposition. */
+	M_HTTP_HEADER_CONTENT_ENCODING,          /*!< Content-Encoding. */
+	M_HTTP_HEADER_CONTENT_LANGUAGE,          /*!< Content-Language. */
+	M_HTTP_HEADER_CONTENT_LENGTH,            /*!< Content-Length. */
+	M_HTTP_HEADER_CONTENT_LOCATION,          /*!< Content-Location. */
+	M_HTTP_HEADER_CONTENT_RANGE,             /*!< Content-Range. */
+	M_HTTP_HEADER_CONTENT_TYPE,              /*!< Content-Type. */
+	M_HTTP_HEADER_COOKIE,                    /*!< Cookie. */
+	M_HTTP_HEADER_DATE,                      /*!< Date. */
+	M_HTTP_HEADER_ETAG,                      /*!< ETag. */
+	M_HTTP_HEADER_EXPECT,                    /*!< Expect. */
+	M_HTTP_HEADER_EXPIRES,                   /*!< Expires. */
+	M_HTTP_HEADER_FORWARDED,                 /*!< Forwarded. */
+	M_HTTP_HEADER_FROM,                      /*!< From. */
+	M_HTTP_HEADER_HOST,                      /*!< Host. */
+	M_HTTP_HEADER_IF_MATCH,                  /*!< If-Match. */
+	M_HTTP_HEADER_IF_MODIFIED_SINCE,         /*!< If-Modified-Since. */
+	M_HTTP_HEADER_IF_NONE_MATCH,             /*!< If-None-Match. */
+	M_HTTP_HEADER_IF_RANGE,                  /*!< If-Range. */
+	M_HTTP_HEADER_IF_UNMODIFIED_SINCE,       /*!< If-Unmodified-Since. */
+	M_HTTP_HEADER_KEEP_ALIVE,                /*!< Keep-Alive. */
+	M_HTTP_HEADER_LAST_MODIFIED,             /*!< Last-Modified. */
+	M_HTTP_HEADER_LINK,                      /*!< Link. */
+	M_HTTP_HEADER_LOCATION,                  /*!< Location. */
+	M_HTTP_HEADER_MAX_FORWARDS,              /*!< Max-Forwards. */
+	M_HTTP_HEADER_ORIGIN,                    /*!< Origin. */
+	M_HTTP_HEADER_PRAGMA,                    /*!< Pragma. */
+	M_HTTP_HEADER_PROXY_AUTHENTICATE,        /*!< Proxy-Authenticate. */
+	M_HTTP_HEADER_PROXY_AUTHORIZATION,       /*!< Proxy-Authorization. */
+	M_HTTP_HEADER_RANGE,                     /*!< Range. */
+	M_HTTP_HEADER_REFERER,                   /*!< Referer. */
+	M_HTTP_HEADER_RETRY_AFTER,               /*!< Retry-After. */
+	M_HTTP_HEADER_SERVER,                    /*!< Server. */
+	M_HTTP_HEADER_SET_COOKIE,                /*!< Set-Cookie. */
+	M_HTTP_HEADER_STRICT_TRANSPORT_SECURITY, /*!< Strict-Transport-Security. */
+	M_HTTP_HEADER_TE,                        /*!< TE. */
+	M_HTTP_HEADER_TRAILER,                   /*!< Trailer. */
+	M_HTTP_HEADER_TRANSFER_ENCODING,         /*!< Transfer-Encoding. */
+	M_HTTP_HEADER_UPGRADE,                   /*!< Upgrade. */
+	M_HTTP_HEADER_USER_AGENT,                /*!< User-Agent. */
+	M_HTTP_HEADER_VARY,                      /*!< Vary. */
+	M_HTTP_HEADER_VIA,                       /*!< Via. */
+	M_HTTP_HEADER_WARNING,                   /*!< Warning. */
+	M_HTTP_HEADER_WWW_AUTHENTICATE,          /*!< WWW-Authenticate. */
+	M_HTTP_HEADER_X_FORWARDED_FOR,           /*!< X-Forwarded-For. */
+	M_HTTP_HEADER_X_FORWARDED_HOST,          /*!< X-Forwarded-Host. */
+	M_HTTP_HEADER_X_FORWARDED_PROTO,         /*!< X-Forwarded-Proto. */
+	M_HTTP_HEADER_X_REQUESTED_WITH           /*!< X-Requested-With. */
+} M_http_header_id_t;
+
+
+/*! A header as it appears in a message.
+ *
+ * The key and value point into the data being parsed and are not NULL terminated.
+ */
+typedef struct {
+	M_http_header_id_t  id;      /*!< Well known header. M_HTTP_HEADER_UNKNOWN for any other header. */
+	const char         *key;     /*!< Header name. */
+	size_t              key_len; /*!< Length of key. */
+	const char         *val;     /*!< Value with surrounding whitespace removed. NULL if there is no value. */
+	size_t              val_len; /*!< Length of val. */
+} M_http_header_view_t;
+
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 /*! Convert a version string into a version value.
@@ -199,6 +276,27 @@ M_API M_http_method_t M_http_method_from_str(const char *method);
 M_API const char *M_http_method_to_str(M_http_method_t method);
 
 
+/*! Convert a header name into a well known header value.
+ *
+ * Names are compared case insensitive.
+ *
+ * \param[in] key Header name. Does not need to be NULL terminated.
+ * \param[in] len Length of key.
+ *
+ * \return Header. M_HTTP_HEADER_UNKNOWN if not a well known header.
+ */
+M_API M_http_header_id_t M_http_header_id_from_str(const char *key, size_t len);
+
+
+/*! Convert a well known header to its name.
+ *
+ * \param[in] id Header.
+ *
+ * \return String. NULL if M_HTTP_HEADER_UNKNOWN.
+ */
+M_API const char *M_http_header_id_to_str(M_http_header_id_t id);
+
+
 /*! Convert an http code to a string.
  *
  * Not all codes can be converted to a string.
@@ -653,6 +751,24 @@ typedef M_http_error_t (*M_http_reader_trailer_func)(const char *key, const char
  */
 typedef M_http_error_t (*M_http_reader_trailer_done_func)(void *thunk);
 
+/*! Function definition for reading headers without copying.
+ *
+ * Called once for every header line in the message header, after
+ * M_http_reader_header_full_func. The key and value point into the data passed
+ * to M_http_reader_read() and are only valid for the duration of the callback.
+ * Values are not split.
+ *
+ * Headers are only copied into NULL terminated strings when the
+ * M_http_reader_header_full_func or M_http_reader_header_func callbacks are set.
+ * Using only this callback avoids any allocation while reading the header.
+ *
+ * \param[in] header Header.
+ * \param[in] thunk  Thunk.
+ *
+ * \return Result
+ */
+typedef M_http_error_t (*M_http_reader_header_view_func)(const M_http_header_view_t *header, void *thunk);
+
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -689,6 +805,7 @@ struct M_http_reader_callbacks {
 	M_http_reader_trailer_full_func            trailer_full_func;
 	M_http_reader_trailer_func                 trailer_func;
 	M_http_reader_trailer_done_func            trailer_done_func;
+	M_http_reader_header_view_func             header_view_func;
 };
 
 
@@ -125,7 +125,17 @@ typedef enum {
 	                                                      byte sequence. Use this with care because "\u" will be put
 	                                                      in the string. Writing will produce "\\u" because the writer
 	                                                      will not understand this is a non-decoded unicode escape. */
-	M_JSON_READER_REPLACE_BAD_CHARS        = 1 << 4  /*!< Replace bad characters (invalid utf-8 sequences with "?"). */
+	M_JSON_READER_REPLACE_BAD_CHARS        = 1 << 4, /*!< Replace bad characters (invalid utf-8 sequences with "?"). */
+	M_JSON_READER_COMPACT                  = 1 << 5  /*!< Store the tree in a compact form. Nodes, object keys and
+	                                                      strings are allocated from a single arena owned by the
+	                                                      returned root instead of individually and objects are kept
+	                                                      as small arrays of members which are only indexed once
+	                                                      they grow large. All M_json functions work on the tree the
+	                                                      same as they do on a regular tree, including modifying it.
+	                                                      The arena is released once the root and every node taken
+	                                                      out of the tree have been destroyed. Documents only the
+	                                                      recursive reader handles (such as ones with comments) are
+	                                                      read into a regular tree. */
 } M_json_reader_flags_t;
 
 
@@ -312,6 +322,86 @@ M_API M_json_type_t M_json_node_type(const M_json_node_t *node);
  */
 M_API M_json_node_t **M_json_jsonpath(const M_json_node_t *node, const char *search, size_t *num_matches) M_MALLOC;
 
+/*! A compiled JSONPath expression. */
+struct M_json_jsonpath;
+typedef struct M_json_jsonpath M_json_jsonpath_t;
+
+
+/*! Callback for each node matched by a compiled JSONPath expression.
+ *
+ * \param[in] node  The matching node. This is a reference into the tree, not a copy.
+ * \param[in] thunk Thunk passed to M_json_jsonpath_foreach.
+ *
+ * \return M_TRUE to continue searching. M_FALSE to stop.
+ */
+typedef M_bool (*M_json_jsonpath_match_func)(M_json_node_t *node, void *thunk);
+
+
+/*! Compile a JSONPath expression so it can be evaluated repeatedly.
+ *
+ * The expression is parsed once, including any array offsets and slices. Evaluating
+ * a compiled expression does not need to parse the expression again. An object can
+ * be evaluated from multiple threads at the same time.
+ *
+ * \see M_json_jsonpath for information about supported JSONPath features.
+ *
+ * \param[in] search search expression
+ *
+ * \return Compiled expression on success, NULL if the expression is invalid.
+ *
+ * \see M_json_jsonpath_destroy
+ */
+M_API M_json_jsonpath_t *M_json_jsonpath_compile(const char *search) M_MALLOC;
+
+
+/*! Destroy a compiled JSONPath expression.
+ *
+ * \param[in] jsonpath The compiled expression.
+ */
+M_API void M_json_jsonpath_destroy(M_json_jsonpath_t *jsonpath) M_FREE(1);
+
+
+/*! Evaluate a compiled JSONPath expression.
+ *
+ * Equivalent to M_json_jsonpath.
+ *
+ * \param[in]  jsonpath    The compiled expression.
+ * \param[in]  node        The node.
+ * \param[out] num_matches Number of matches found
+ *
+ * \return array of M_json_node_t pointers on success (must free array, but not internal pointers), NULL on failure
+ *
+ * \see M_free
+ */
+M_API M_json_node_t **M_json_jsonpath_eval(const M_json_jsonpath_t *jsonpath, const M_json_node_t *node, size_t *num_matches) M_MALLOC;
+
+
+/*! Evaluate a compiled JSONPath expression calling a function for each match.
+ *
+ * Matches are passed in the same order M_json_jsonpath_eval would return them. No
+ * match array is allocated.
+ *
+ * \param[in] jsonpath   The compiled expression.
+ * \param[in] node       The node.
+ * \param[in] match_func Function called for each match. Returning M_FALSE stops the search.
+ * \param[in] thunk      Thunk passed to match_func.
+ *
+ * \return Number of times match_func was called.
+ */
+M_API size_t M_json_jsonpath_foreach(const M_json_jsonpath_t *jsonpath, const M_json_node_t *node, M_json_jsonpath_match_func match_func, void *thunk);
+
+
+/*! Evaluate a compiled JSONPath expression returning the first match.
+ *
+ * The search stops as soon as a match is found.
+ *
+ * \param[in] jsonpath The compiled expression.
+ * \param[in] node     The node.
+ *
+ * \return The first matching node, NULL if nothing matched.
+ */
+M_API M_json_node_t *M_json_jsonpath_first(const M_json_jsonpath_t *jsonpath, const M_json_node_t *node);
+
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -776,6 +866,436 @@ M_API char *M_json_get_value_dup(const M_json_node_t *node);
 
 /*! @} */
 
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/*! \addtogroup m_json_reader JSON Stream Reader
+ *  \ingroup m_json
+ *
+ * Push style reader for documents that are too large to hold in memory or
+ * that arrive in pieces. Data is fed in arbitrarily sized chunks and callbacks
+ * are called as each part of the document is parsed. Only the current
+ * nesting and the token being parsed are held in memory.
+ *
+ * The same rules and M_json_reader_flags_t flags as M_json_read are used with
+ * the exception that members and elements must be separated by ','.
+ *
+ * JSONPath expressions can be registered to materialize only matching
+ * subtrees as M_json_node_t objects. Because the document is never fully held
+ * only expressions that can be decided as the data is read are supported:
+ * "$", ".name", ".*", "..", "[*]", non-negative offsets "[0]", "[0,2]" and
+ * slices with non-negative start and end and a positive step "[0:4:2]".
+ *
+ * Example:
+ *
+ * \code{.c}
+ *     static M_json_error_t match_cb(const char *search, M_json_node_t *node, void *thunk)
+ *     {
+ *         (void)search;
+ *         (void)thunk;
+ *         M_printf("id=%lld\n", M_json_object_value_int(node, "id"));
+ *         M_json_node_destroy(node);
+ *         return M_JSON_ERROR_SUCCESS;
+ *     }
+ *
+ *     struct M_json_reader_callbacks  cbs;
+ *     M_json_reader_t                *reader;
+ *
+ *     M_mem_set(&cbs, 0, sizeof(cbs));
+ *     reader = M_json_reader_create(&cbs, M_JSON_READER_NONE, NULL);
+ *     M_json_reader_add_jsonpath(reader, "$.records[*]", match_cb);
+ *     while ((len = read_more(buf, sizeof(buf))) > 0) {
+ *         if (M_json_reader_read(reader, buf, len) != M_JSON_ERROR_SUCCESS)
+ *             break;
+ *     }
+ *     M_json_reader_finish(reader);
+ *     M_json_reader_destroy(reader);
+ * \endcode
+ *
+ * @{
+ */
+
+struct M_json_reader;
+typedef struct M_json_reader M_json_reader_t;
+
+/*! Function definition for the start or end of an object or array.
+ *
+ * \param[in] thunk Thunk.
+ *
+ * \return M_JSON_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_json_error_t (*M_json_reader_container_func)(void *thunk);
+
+/*! Function definition for an object key.
+ *
+ * \param[in] key   Key. Only valid for the duration of the callback.
+ * \param[in] thunk Thunk.
+ *
+ * \return M_JSON_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_json_error_t (*M_json_reader_key_func)(const char *key, void *thunk);
+
+/*! Function definition for a string value.
+ *
+ * \param[in] val   Value. Only valid for the duration of the callback.
+ * \param[in] thunk Thunk.
+ *
+ * \return M_JSON_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_json_error_t (*M_json_reader_string_func)(const char *val, void *thunk);
+
+/*! Function definition for an integer value.
+ *
+ * \param[in] val   Value.
+ * \param[in] thunk Thunk.
+ *
+ * \return M_JSON_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_json_error_t (*M_json_reader_integer_func)(M_int64 val, void *thunk);
+
+/*! Function definition for a decimal value.
+ *
+ * \param[in] val   Value. Only valid for the duration of the callback.
+ * \param[in] thunk Thunk.
+ *
+ * \return M_JSON_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_json_error_t (*M_json_reader_decimal_func)(const M_decimal_t *val, void *thunk);
+
+/*! Function definition for a bool value.
+ *
+ * \param[in] val   Value.
+ * \param[in] thunk Thunk.
+ *
+ * \return M_JSON_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_json_error_t (*M_json_reader_bool_func)(M_bool val, void *thunk);
+
+/*! Function definition for a null value.
+ *
+ * \param[in] thunk Thunk.
+ *
+ * \return M_JSON_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_json_error_t (*M_json_reader_null_func)(void *thunk);
+
+/*! Function definition for a JSONPath match.
+ *
+ * \param[in] search The expression that matched, as passed to M_json_reader_add_jsonpath.
+ * \param[in] node   The matching subtree. The callback takes ownership and must destroy it.
+ * \param[in] thunk  Thunk.
+ *
+ * \return M_JSON_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_json_error_t (*M_json_reader_match_func)(const char *search, M_json_node_t *node, void *thunk);
+
+
+/*! Callbacks for the parts of a document. Any can be NULL if not needed. */
+struct M_json_reader_callbacks {
+	M_json_reader_container_func object_start_func;
+	M_json_reader_container_func object_end_func;
+	M_json_reader_container_func array_start_func;
+	M_json_reader_container_func array_end_func;
+	M_json_reader_key_func       key_func;
+	M_json_reader_string_func    string_func;
+	M_json_reader_integer_func   integer_func;
+	M_json_reader_decimal_func   decimal_func;
+	M_json_reader_bool_func      bool_func;
+	M_json_reader_null_func      null_func;
+};
+
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/*! Create a JSON stream reader.
+ *
+ * \param[in] cbs   Callbacks for processing. Optional, pass NULL if only JSONPath matches are wanted.
+ * \param[in] flags M_json_reader_flags_t flags to control the behavior of the reader.
+ * \param[in] thunk Thunk passed to callbacks.
+ *
+ * \return Object.
+ */
+M_API M_json_reader_t *M_json_reader_create(const struct M_json_reader_callbacks *cbs, M_uint32 flags, void *thunk);
+
+
+/*! Destroy a JSON stream reader.
+ *
+ * \param[in] reader Reader.
+ */
+M_API void M_json_reader_destroy(M_json_reader_t *reader);
+
+
+/*! Materialize subtrees matching a JSONPath expression.
+ *
+ * Must be called before any data is read. Uses the same syntax and matching as
+ * M_json_jsonpath() except that offsets counting from the end of an array and
+ * negative slice steps aren't supported, because the length of an array isn't known
+ * until it has been read. Each matching value is delivered once, in document order.
+ * Nested matches (such as "$..name" where a match contains another match) are each
+ * delivered as their own tree.
+ *
+ * \param[in] reader     Reader.
+ * \param[in] search     JSONPath expression.
+ * \param[in] match_func Callback receiving each matching subtree.
+ *
+ * \return M_TRUE if the expression was added. M_FALSE if it is invalid or cannot be evaluated on a stream.
+ */
+M_API M_bool M_json_reader_add_jsonpath(M_json_reader_t *reader, const char *search, M_json_reader_match_func match_func);
+
+
+/*! Parse a chunk of data.
+ *
+ * Chunks can be split anywhere, including in the middle of a token. All data is
+ * consumed; partial tokens are held until the next chunk.
+ *
+ * Once an error has been returned the reader is stopped and will continue to return the error.
+ *
+ * \param[in] reader   Reader.
+ * \param[in] data     Data to parse.
+ * \param[in] data_len Length of data.
+ *
+ * \return M_JSON_ERROR_SUCCESS if the data was valid so far. Otherwise an error.
+ */
+M_API M_json_error_t M_json_reader_read(M_json_reader_t *reader, const char *data, size_t data_len);
+
+
+/*! Signal there is no more data.
+ *
+ * \param[in] reader Reader.
+ *
+ * \return M_JSON_ERROR_SUCCESS if a complete document was read. Otherwise an error.
+ */
+M_API M_json_error_t M_json_reader_finish(M_json_reader_t *reader);
+
+
+/*! Get the location of an error.
+ *
+ * \param[in]  reader     Reader.
+ * \param[out] error_line The line the error occurred. Optional, pass NULL if not needed.
+ * \param[out] error_pos  The column the error occurred if error_line is not NULL, otherwise the position
+ *                        in the stream the error occurred. Optional, pass NULL if not needed.
+ */
+M_API void M_json_reader_error_pos(const M_json_reader_t *reader, size_t *error_line, size_t *error_pos);
+
+/*! @} */
+
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/*! \addtogroup m_json_writer JSON Stream Writer
+ *  \ingroup m_json
+ *
+ * Incremental writer for generating documents without building a tree of
+ * M_json_node_t objects first. Output is appended to a caller supplied buffer
+ * or handed to a flush callback as it's generated. The output is the same as
+ * M_json_write for the same M_json_writer_flags_t flags.
+ *
+ * Output can be sent to an M_io_t object by using a flush callback that
+ * calls M_io_write_from_buf. Any data that could not be written stays in the
+ * buffer and is passed to the next flush.
+ *
+ * Example:
+ *
+ * \code{.c}
+ *     M_buf_t         *buf;
+ *     M_json_writer_t *writer;
+ *     char            *out;
+ *
+ *     buf    = M_buf_create();
+ *     writer = M_json_writer_create(buf, M_JSON_WRITER_NONE);
+ *
+ *     M_json_writer_object_begin(writer);
+ *     M_json_writer_key(writer, "id");
+ *     M_json_writer_integer(writer, 12);
+ *     M_json_writer_key(writer, "tags");
+ *     M_json_writer_array_begin(writer);
+ *     M_json_writer_string(writer, "a");
+ *     M_json_writer_string(writer, "b");
+ *     M_json_writer_array_end(writer);
+ *     M_json_writer_object_end(writer);
+ *
+ *     if (M_json_writer_finish(writer)) {
+ *         out = M_buf_finish_str(buf, NULL);
+ *         M_printf("%s\n", out);
+ *         M_free(out);
+ *     } else {
+ *         M_buf_cancel(buf);
+ *     }
+ *     M_json_writer_destroy(writer);
+ * \endcode
+ *
+ * Will output:
+ *
+ *     {"id":12,"tags":["a","b"]}
+ *
+ * @{
+ */
+
+struct M_json_writer;
+typedef struct M_json_writer M_json_writer_t;
+
+/*! Function definition for flushing generated data.
+ *
+ * \param[in,out] buf   Buffer holding the generated data. Data that was handled
+ *                      should be dropped from the buffer. Anything left in the
+ *                      buffer will be passed to the next flush.
+ * \param[in]     thunk Thunk.
+ *
+ * \return M_TRUE on success. M_FALSE on error which will stop the writer.
+ */
+typedef M_bool (*M_json_writer_flush_func)(M_buf_t *buf, void *thunk);
+
+
+/*! Create a JSON stream writer that appends to a buffer.
+ *
+ * \param[in] buf   Buffer to write to. Not owned by the writer.
+ * \param[in] flags M_json_writer_flags_t flags to control the output.
+ *
+ * \return Object.
+ */
+M_API M_json_writer_t *M_json_writer_create(M_buf_t *buf, M_uint32 flags);
+
+
+/*! Create a JSON stream writer that flushes data as it is generated.
+ *
+ * \param[in] flush_func Callback to receive data.
+ * \param[in] flush_size Amount of data to buffer before calling the flush callback.
+ *                       0 to call it after every write.
+ * \param[in] flags      M_json_writer_flags_t flags to control the output.
+ * \param[in] thunk      Thunk passed to the flush callback.
+ *
+ * \return Object. NULL if flush_func is NULL.
+ */
+M_API M_json_writer_t *M_json_writer_create_flush(M_json_writer_flush_func flush_func, size_t flush_size, M_uint32 flags, void *thunk);
+
+
+/*! Destroy a JSON stream writer.
+ *
+ * Data that has not been flushed is discarded.
+ *
+ * \param[in] writer Writer.
+ */
+M_API void M_json_writer_destroy(M_json_writer_t *writer);
+
+
+/*! Start an object.
+ *
+ * \param[in] writer Writer.
+ *
+ * \return M_TRUE on success. M_FALSE if a value can't be written at this point or there was an error.
+ */
+M_API M_bool M_json_writer_object_begin(M_json_writer_t *writer);
+
+
+/*! End the current object.
+ *
+ * \param[in] writer Writer.
+ *
+ * \return M_TRUE on success. M_FALSE if an object isn't open, a key is missing its value or there was an error.
+ */
+M_API M_bool M_json_writer_object_end(M_json_writer_t *writer);
+
+
+/*! Start an array.
+ *
+ * \param[in] writer Writer.
+ *
+ * \return M_TRUE on success. M_FALSE if a value can't be written at this point or there was an error.
+ */
+M_API M_bool M_json_writer_array_begin(M_json_writer_t *writer);
+
+
+/*! End the current array.
+ *
+ * \param[in] writer Writer.
+ *
+ * \return M_TRUE on success. M_FALSE if an array isn't open or there was an error.
+ */
+M_API M_bool M_json_writer_array_end(M_json_writer_t *writer);
+
+
+/*! Write the key for the next member of the current object.
+ *
+ * \param[in] writer Writer.
+ * \param[in] key    Key.
+ *
+ * \return M_TRUE on success. M_FALSE if not in an object, a key was already written or there was an error.
+ */
+M_API M_bool M_json_writer_key(M_json_writer_t *writer, const char *key);
+
+
+/*! Write a string value.
+ *
+ * \param[in] writer Writer.
+ * \param[in] val    Value. NULL writes null.
+ *
+ * \return M_TRUE on success. M_FALSE if a value can't be written at this point, the string is
+ *         not valid utf-8 (without M_JSON_WRITER_REPLACE_BAD_CHARS) or there was an error.
+ */
+M_API M_bool M_json_writer_string(M_json_writer_t *writer, const char *val);
+
+
+/*! Write an integer value.
+ *
+ * \param[in] writer Writer.
+ * \param[in] val    Value.
+ *
+ * \return M_TRUE on success. M_FALSE if a value can't be written at this point or there was an error.
+ */
+M_API M_bool M_json_writer_integer(M_json_writer_t *writer, M_int64 val);
+
+
+/*! Write a decimal value.
+ *
+ * \param[in] writer Writer.
+ * \param[in] val    Value.
+ *
+ * \return M_TRUE on success. M_FALSE if a value can't be written at this point or there was an error.
+ */
+M_API M_bool M_json_writer_decimal(M_json_writer_t *writer, const M_decimal_t *val);
+
+
+/*! Write a bool value.
+ *
+ * \param[in] writer Writer.
+ * \param[in] val    Value.
+ *
+ * \return M_TRUE on success. M_FALSE if a value can't be written at this point or there was an error.
+ */
+M_API M_bool M_json_writer_bool(M_json_writer_t *writer, M_bool val);
+
+
+/*! Write a null value.
+ *
+ * \param[in] writer Writer.
+ *
+ * \return M_TRUE on success. M_FALSE if a value can't be written at this point or there was an error.
+ */
+M_API M_bool M_json_writer_null(M_json_writer_t *writer);
+
+
+/*! Write a node and everything under it as a value.
+ *
+ * \param[in] writer Writer.
+ * \param[in] node   Node.
+ *
+ * \return M_TRUE on success. M_FALSE if a value can't be written at this point or there was an error.
+ */
+M_API M_bool M_json_writer_node(M_json_writer_t *writer, const M_json_node_t *node);
+
+
+/*! Complete the document.
+ *
+ * Flushes any remaining data when using a flush callback.
+ *
+ * \param[in] writer Writer.
+ *
+ * \return M_TRUE if a complete document was written. Otherwise M_FALSE.
+ */
+M_API M_bool M_json_writer_finish(M_json_writer_t *writer);
+
+/*! @} */
+
 __END_DECLS
 
 #endif /* __M_JSON_H__ */
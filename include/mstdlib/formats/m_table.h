@@ -41,6 +41,12 @@ __BEGIN_DECLS
  * JSON input and output conform to [csv2json](https://www.w3.org/TR/csv2json/)
  * Minimal Mode format.
  *
+ * Columns store their values as strings by default. A column can be given a
+ * type with M_table_column_set_type() which stores the values in contiguous
+ * arrays instead. Sorting a typed column without a comparison function sorts
+ * on the typed values, which is much faster than comparing strings. Typed
+ * values are written as numbers in JSON output.
+ *
  * @{
  */
 
@@ -73,6 +79,16 @@ typedef enum {
 	M_TABLE_MARKDOWN_LINEEND_WIN = 1 << 3  /*!< Use Windows line endings (\\r\\n). */
 } M_table_markdown_flags_t;
 
+
+/*! How values in a column are stored. */
+typedef enum {
+	M_TABLE_COLTYPE_STRING  = 0, /*!< Strings. Default. */
+	M_TABLE_COLTYPE_INT64,       /*!< 64 bit signed integers. */
+	M_TABLE_COLTYPE_DECIMAL,     /*!< Decimal numbers (M_decimal_t). */
+	M_TABLE_COLTYPE_DICT         /*!< Strings stored once with each cell referencing them. For
+	                                  columns with many repeated values. */
+} M_table_coltype_t;
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 /*! Create a table.
@@ -152,9 +168,13 @@ M_API M_bool M_table_column_idx(const M_table_t *table, const char *colname, siz
  *
  * Supports secondary column sorting when values in the primary column are equivalent.
  *
+ * If `primary_sort` is NULL and the column is typed the rows are sorted on the typed
+ * values. Cells without a value sort first. Otherwise values are compared as strings.
+ *
  * \param[in] table             Table.
  * \param[in] colname           Column name for primary sorting.
- * \param[in] primary_sort      Sort comparison function for `colname`.
+ * \param[in] primary_sort      Sort comparison function for `colname`. NULL for
+ *                              the default string or typed value comparison.
  * \param[in] secondary_colname Column name for secondary sorting. Only used when values from
  *                              primary sort are equivalent.
  * \param[in] secondary_sort    Sort comparison function for `secondary_colname`.
@@ -224,6 +244,46 @@ M_API size_t M_table_column_remove_empty_columns(M_table_t *table);
 M_API size_t M_table_column_count(const M_table_t *table);
 
 
+/*! Set how the values in a column are stored.
+ *
+ * Existing values are converted. Numeric columns only accept values that are
+ * entirely a number and setting an empty string clears the cell. Numeric values
+ * are normalized so the string returned for a cell may differ from what was set.
+ * For example "+05" in a M_TABLE_COLTYPE_INT64 column is returned as "5".
+ *
+ * \param[in] table   Table.
+ * \param[in] colname Column name.
+ * \param[in] type    Storage type.
+ *
+ * \return M_TRUE on success. Otherwise, M_FALSE. Fails if an existing value cannot
+ *         be converted in which case the column is not changed.
+ */
+M_API M_bool M_table_column_set_type(M_table_t *table, const char *colname, M_table_coltype_t type);
+
+
+/*! Set how the values in a column at a given index are stored.
+ *
+ * \param[in] table Table.
+ * \param[in] idx   Column index.
+ * \param[in] type  Storage type.
+ *
+ * \return M_TRUE on success. Otherwise, M_FALSE.
+ *
+ * \see M_table_column_set_type
+ */
+M_API M_bool M_table_column_set_type_at(M_table_t *table, size_t idx, M_table_coltype_t type);
+
+
+/*! Get how the values in a column are stored.
+ *
+ * \param[in] table Table.
+ * \param[in] idx   Column index.
+ *
+ * \return Storage type.
+ */
+M_API M_table_coltype_t M_table_column_type(const M_table_t *table, size_t idx);
+
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 /*! Inset a row into the table.
@@ -396,6 +456,60 @@ M_API const char *M_table_cell(const M_table_t *table, size_t row, const char *c
 M_API const char *M_table_cell_at(const M_table_t *table, size_t row, size_t col);
 
 
+/*! Set a cell to an integer.
+ *
+ * M_TABLE_COLTYPE_INT64 columns store the value directly. Other columns store
+ * it the same as M_table_cell_set_at() would with the string form.
+ *
+ * \param[in] table Table.
+ * \param[in] row   Row index.
+ * \param[in] col   Column index.
+ * \param[in] val   Value.
+ *
+ * \return M_TRUE on success. Otherwise, M_FALSE.
+ */
+M_API M_bool M_table_cell_set_int64_at(M_table_t *table, size_t row, size_t col, M_int64 val);
+
+
+/*! Set a cell to a decimal.
+ *
+ * M_TABLE_COLTYPE_DECIMAL columns store the value directly. Other columns store
+ * it the same as M_table_cell_set_at() would with the string form.
+ *
+ * \param[in] table Table.
+ * \param[in] row   Row index.
+ * \param[in] col   Column index.
+ * \param[in] val   Value.
+ *
+ * \return M_TRUE on success. Otherwise, M_FALSE.
+ */
+M_API M_bool M_table_cell_set_decimal_at(M_table_t *table, size_t row, size_t col, const M_decimal_t *val);
+
+
+/*! Get the data for a cell as an integer.
+ *
+ * \param[in]  table Table.
+ * \param[in]  row   Row index.
+ * \param[in]  col   Column index.
+ * \param[out] val   Value.
+ *
+ * \return M_TRUE if the cell has a value that is an integer. Otherwise, M_FALSE.
+ */
+M_API M_bool M_table_cell_int64_at(const M_table_t *table, size_t row, size_t col, M_int64 *val);
+
+
+/*! Get the data for a cell as a decimal.
+ *
+ * \param[in]  table Table.
+ * \param[in]  row   Row index.
+ * \param[in]  col   Column index.
+ * \param[out] val   Value.
+ *
+ * \return M_TRUE if the cell has a value that is a number. Otherwise, M_FALSE.
+ */
+M_API M_bool M_table_cell_decimal_at(const M_table_t *table, size_t row, size_t col, M_decimal_t *val);
+
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 /*! Merge two tables together.
@@ -501,6 +501,90 @@ M_API M_xml_node_t **M_xml_xpath(M_xml_node_t *node, const char *search, M_uint3
  */ 
 M_API const char *M_xml_xpath_text_first(M_xml_node_t *node, const char *search);
 
+/*! A compiled XPath expression. */
+struct M_xml_xpath;
+typedef struct M_xml_xpath M_xml_xpath_t;
+
+
+/*! Callback for each node matched by a compiled XPath expression.
+ *
+ * \param[in] node  The matching node. This is a reference into the tree, not a copy.
+ * \param[in] thunk Thunk passed to M_xml_xpath_foreach.
+ *
+ * \return M_TRUE to continue searching. M_FALSE to stop.
+ */
+typedef M_bool (*M_xml_xpath_match_func)(M_xml_node_t *node, void *thunk);
+
+
+/*! Compile an XPath expression so it can be evaluated repeatedly.
+ *
+ * The expression is parsed once, including any predicates. Evaluating a compiled
+ * expression does not need to parse the expression again. An object can be
+ * evaluated from multiple threads at the same time.
+ *
+ * Predicates that can never match, such as "[0]", are rejected.
+ *
+ * \see M_xml_xpath for information about supported XPath features.
+ *
+ * \param[in] search search expression
+ * \param[in] flags  M_xml_reader_flags_t flags to control the behavior of the search.
+ *                   valid flags are:
+ *                   - M_XML_READER_NONE
+ *                   - M_XML_READER_TAG_CASECMP
+ *
+ * \return Compiled expression on success, NULL if the expression is invalid.
+ *
+ * \see M_xml_xpath_destroy
+ */
+M_API M_xml_xpath_t *M_xml_xpath_compile(const char *search, M_uint32 flags) M_MALLOC;
+
+
+/*! Destroy a compiled XPath expression.
+ *
+ * \param[in] xpath The compiled expression.
+ */
+M_API void M_xml_xpath_destroy(M_xml_xpath_t *xpath) M_FREE(1);
+
+
+/*! Evaluate a compiled XPath expression.
+ *
+ * Equivalent to M_xml_xpath.
+ *
+ * \param[in]  xpath       The compiled expression.
+ * \param[in]  node        The node.
+ * \param[out] num_matches Number of matches found
+ *
+ * \return array of M_xml_node_t pointers on success (must free array, but not internal pointers), NULL on failure
+ */
+M_API M_xml_node_t **M_xml_xpath_eval(const M_xml_xpath_t *xpath, M_xml_node_t *node, size_t *num_matches) M_MALLOC;
+
+
+/*! Evaluate a compiled XPath expression calling a function for each match.
+ *
+ * Matches are passed in the same order M_xml_xpath_eval would return them. No
+ * match array is allocated.
+ *
+ * \param[in] xpath      The compiled expression.
+ * \param[in] node       The node.
+ * \param[in] match_func Function called for each match. Returning M_FALSE stops the search.
+ * \param[in] thunk      Thunk passed to match_func.
+ *
+ * \return Number of times match_func was called.
+ */
+M_API size_t M_xml_xpath_foreach(const M_xml_xpath_t *xpath, M_xml_node_t *node, M_xml_xpath_match_func match_func, void *thunk);
+
+
+/*! Evaluate a compiled XPath expression returning the first match.
+ *
+ * The search stops as soon as a match is found.
+ *
+ * \param[in] xpath The compiled expression.
+ * \param[in] node  The node.
+ *
+ * \return The first matching node, NULL if nothing matched.
+ */
+M_API M_xml_node_t *M_xml_xpath_first(const M_xml_xpath_t *xpath, M_xml_node_t *node);
+
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -707,6 +791,209 @@ M_API const char *M_xml_node_attribute(const M_xml_node_t *node, const char *key
 
 /*! @} */
 
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/*! \addtogroup m_xml_reader XML Stream Reader
+ *  \ingroup m_xml
+ *
+ * Push style reader for documents that are too large to hold in memory or
+ * that arrive in pieces. Data is fed in arbitrarily sized chunks and callbacks
+ * are called as each part of the document is parsed. Only the open elements
+ * and the tag or text being parsed are held in memory.
+ *
+ * The same rules, errors and M_xml_reader_flags_t flags as M_xml_read are used.
+ * Text is trimmed and entity decoded the same way and CDATA sections are passed
+ * as text.
+ *
+ * XPath expressions can be registered to materialize only matching elements
+ * as M_xml_node_t trees. Because the document is never fully held only
+ * expressions that can be decided when an element starts are supported:
+ * tags, "*", "*:tag", "//", "[@attr]", "[@attr=val]", "[@*]", "[idx]" and
+ * "[position() ? idx]". Positions cannot use "last()" and must directly follow
+ * the tag. Unlike M_xml_xpath positions only count sibling elements matching the
+ * tag, not text nodes. "..", "text()" and expressions matching the document
+ * itself are not supported.
+ *
+ * Example:
+ *
+ * \code{.c}
+ *     static M_xml_error_t match_cb(const char *search, M_xml_node_t *node, void *thunk)
+ *     {
+ *         (void)search;
+ *         (void)thunk;
+ *         M_printf("id=%s\n", M_xml_node_attribute(node, "id"));
+ *         M_xml_node_destroy(node);
+ *         return M_XML_ERROR_SUCCESS;
+ *     }
+ *
+ *     struct M_xml_reader_callbacks  cbs;
+ *     M_xml_reader_t                *reader;
+ *
+ *     M_mem_set(&cbs, 0, sizeof(cbs));
+ *     reader = M_xml_reader_create(&cbs, M_XML_READER_NONE, NULL);
+ *     M_xml_reader_add_xpath(reader, "/records/record", match_cb);
+ *     while ((len = read_more(buf, sizeof(buf))) > 0) {
+ *         if (M_xml_reader_read(reader, buf, len) != M_XML_ERROR_SUCCESS)
+ *             break;
+ *     }
+ *     M_xml_reader_finish(reader);
+ *     M_xml_reader_destroy(reader);
+ * \endcode
+ *
+ * @{
+ */
+
+struct M_xml_reader;
+typedef struct M_xml_reader M_xml_reader_t;
+
+/*! Function definition for the start of an element.
+ *
+ * Empty elements (<a/>) call the start and end functions.
+ *
+ * \param[in] name       Tag name. Only valid for the duration of the callback.
+ * \param[in] attributes Attributes. Only valid for the duration of the callback.
+ * \param[in] thunk      Thunk.
+ *
+ * \return M_XML_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_xml_error_t (*M_xml_reader_element_start_func)(const char *name, const M_hash_dict_t *attributes, void *thunk);
+
+/*! Function definition for the end of an element.
+ *
+ * \param[in] name  Tag name as it was given when the element started. Only valid for the duration of the callback.
+ * \param[in] thunk Thunk.
+ *
+ * \return M_XML_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_xml_error_t (*M_xml_reader_element_end_func)(const char *name, void *thunk);
+
+/*! Function definition for text or a comment.
+ *
+ * \param[in] text  Text. Only valid for the duration of the callback.
+ * \param[in] thunk Thunk.
+ *
+ * \return M_XML_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_xml_error_t (*M_xml_reader_text_func)(const char *text, void *thunk);
+
+/*! Function definition for a processing instruction.
+ *
+ * \param[in] name       Name. Only valid for the duration of the callback.
+ * \param[in] attributes Attributes. Only valid for the duration of the callback.
+ * \param[in] thunk      Thunk.
+ *
+ * \return M_XML_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_xml_error_t (*M_xml_reader_processing_instruction_func)(const char *name, const M_hash_dict_t *attributes, void *thunk);
+
+/*! Function definition for a declaration.
+ *
+ * \param[in] name     Name. Only valid for the duration of the callback.
+ * \param[in] tag_data Everything after the name. Only valid for the duration of the callback.
+ * \param[in] thunk    Thunk.
+ *
+ * \return M_XML_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_xml_error_t (*M_xml_reader_declaration_func)(const char *name, const char *tag_data, void *thunk);
+
+/*! Function definition for an XPath match.
+ *
+ * \param[in] search The expression that matched, as passed to M_xml_reader_add_xpath.
+ * \param[in] node   The matching element. The callback takes ownership and must destroy it.
+ * \param[in] thunk  Thunk.
+ *
+ * \return M_XML_ERROR_SUCCESS to continue. Any other value stops parsing and is returned as the result.
+ */
+typedef M_xml_error_t (*M_xml_reader_match_func)(const char *search, M_xml_node_t *node, void *thunk);
+
+
+/*! Callbacks for the parts of a document. Any can be NULL if not needed. */
+struct M_xml_reader_callbacks {
+	M_xml_reader_element_start_func          element_start_func;
+	M_xml_reader_element_end_func            element_end_func;
+	M_xml_reader_text_func                   text_func;
+	M_xml_reader_text_func                   comment_func;
+	M_xml_reader_processing_instruction_func processing_instruction_func;
+	M_xml_reader_declaration_func            declaration_func;
+};
+
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/*! Create an XML stream reader.
+ *
+ * \param[in] cbs   Callbacks for processing. Optional, pass NULL if only XPath matches are wanted.
+ * \param[in] flags M_xml_reader_flags_t flags to control the behavior of the reader.
+ * \param[in] thunk Thunk passed to callbacks.
+ *
+ * \return Object.
+ */
+M_API M_xml_reader_t *M_xml_reader_create(const struct M_xml_reader_callbacks *cbs, M_uint32 flags, void *thunk);
+
+
+/*! Destroy an XML stream reader.
+ *
+ * \param[in] reader Reader.
+ */
+M_API void M_xml_reader_destroy(M_xml_reader_t *reader);
+
+
+/*! Materialize elements matching an XPath expression.
+ *
+ * Must be called before any data is read. Expressions are evaluated from the
+ * document so "a/b" and "/a/b" are the same. Tags are compared using the
+ * M_XML_READER_TAG_CASECMP flag passed to M_xml_reader_create. Nested matches
+ * (such as "//a" where a match contains another match) are each delivered as
+ * their own tree.
+ *
+ * \param[in] reader     Reader.
+ * \param[in] search     XPath expression.
+ * \param[in] match_func Callback receiving each matching element.
+ *
+ * \return M_TRUE if the expression was added. M_FALSE if it is invalid or cannot be evaluated on a stream.
+ */
+M_API M_bool M_xml_reader_add_xpath(M_xml_reader_t *reader, const char *search, M_xml_reader_match_func match_func);
+
+
+/*! Parse a chunk of data.
+ *
+ * Chunks can be split anywhere, including in the middle of a tag. All data is
+ * consumed; partial tags and text are held until the next chunk.
+ *
+ * Once an error has been returned the reader is stopped and will continue to return the error.
+ *
+ * \param[in] reader   Reader.
+ * \param[in] data     Data to parse.
+ * \param[in] data_len Length of data.
+ *
+ * \return M_XML_ERROR_SUCCESS if the data was valid so far. Otherwise an error.
+ */
+M_API M_xml_error_t M_xml_reader_read(M_xml_reader_t *reader, const char *data, size_t data_len);
+
+
+/*! Signal there is no more data.
+ *
+ * \param[in] reader Reader.
+ *
+ * \return M_XML_ERROR_SUCCESS if a complete document was read. Otherwise an error.
+ */
+M_API M_xml_error_t M_xml_reader_finish(M_xml_reader_t *reader);
+
+
+/*! Get the location of an error.
+ *
+ * Errors in a tag are reported at the start of the tag.
+ *
+ * \param[in]  reader     Reader.
+ * \param[out] error_line The line the error occurred. Optional, pass NULL if not needed.
+ * \param[out] error_pos  The column the error occurred if error_line is not NULL, otherwise the position
+ *                        in the stream the error occurred. Optional, pass NULL if not needed.
+ */
+M_API void M_xml_reader_error_pos(const M_xml_reader_t *reader, size_t *error_line, size_t *error_pos);
+
+/*! @} */
+
 __END_DECLS
 
 #endif /* __M_XML_H__ */
@@ -394,6 +394,60 @@ M_API M_bool M_io_net_set_keepalives(M_io_t *io, M_uint64 idle_time_s, M_uint64
 M_API M_bool M_io_net_set_nagle(M_io_t *io, M_bool nagle_enabled);
 
 
+/*! Hand TLS record encryption or decryption for a connected socket to the kernel (kTLS).
+ *
+ * This is used by the TLS layer once a handshake completes and is not intended to be
+ * called directly. Only supported on Linux with the kernel TLS module loaded.
+ *
+ * Once enabled for sending, data written is encrypted by the kernel. Once enabled for
+ * receiving, each read returns the decrypted contents of a single TLS record prefixed
+ * with its 5 byte record header.
+ *
+ * \param[in] io              io object.
+ * \param[in] is_send         M_TRUE to offload encryption of sent data, M_FALSE for decryption of received data.
+ * \param[in] crypto_info     Kernel crypto parameters (Linux struct tls12_crypto_info_*).
+ * \param[in] crypto_info_len Length of crypto_info.
+ *
+ * \return M_TRUE if the kernel accepted the parameters. M_FALSE if not supported by the platform,
+ *         kernel or cipher, in which case the socket is unchanged.
+ */
+M_API M_bool M_io_net_ktls_enable(M_io_t *io, M_bool is_send, const void *crypto_info, size_t crypto_info_len);
+
+
+/*! Set the TLS record type for data written to a kernel TLS socket.
+ *
+ * Used by the TLS layer to send alerts and handshake messages once the kernel is
+ * encrypting. Each write is sent as a record of this type until it is reset to 0.
+ *
+ * \param[in] io          io object.
+ * \param[in] record_type TLS record content type. 0 for application data.
+ *
+ * \return M_TRUE on success, M_FALSE if kernel TLS isn't enabled for sending.
+ */
+M_API M_bool M_io_net_ktls_set_record_type(M_io_t *io, unsigned char record_type);
+
+
+/*! Write data from a file directly to the socket.
+ *
+ * The data is copied by the kernel without passing through user space. This bypasses
+ * every layer above the network layer so it can only be used when no layer transforms
+ * the data being written, or when kernel TLS is enabled for sending. When a TLS layer
+ * is present use M_tls_sendfile() instead.
+ *
+ * Only supported on Linux.
+ *
+ * \param[in]  io          io object.
+ * \param[in]  fd          File descriptor of the file to send.
+ * \param[in]  offset      Offset in the file to start sending from.
+ * \param[in]  len         Maximum number of bytes to send.
+ * \param[out] len_written Number of bytes sent.
+ *
+ * \return Result. M_IO_ERROR_WOULDBLOCK if the socket can't currently accept data, a WRITE
+ *         event will be delivered when it can. M_IO_ERROR_NOTIMPL if not supported on the platform.
+ */
+M_API M_io_error_t M_io_net_sendfile(M_io_t *io, int fd, M_uint64 offset, size_t len, size_t *len_written);
+
+
 /*! Set connect timeout.
  *
  * This is the timeout to wait for a connection to finish.
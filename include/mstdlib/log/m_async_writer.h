@@ -89,6 +89,25 @@ typedef void (*M_async_thunk_stop_cb_t)(void *thunk);
 typedef void (*M_async_thunk_destroy_cb_t)(void *thunk);
 
 
+/* Callback that turns data queued with M_async_writer_write_deferred() into the message that gets written.
+ *
+ * Called by the internal worker thread, right before the message is passed to the write callback.
+ *
+ * \param[in] data object passed into \a data parameter of M_async_writer_write_deferred().
+ * \return         message to write (owned by the writer after this call), or NULL if there's nothing to write.
+ */
+typedef char *(*M_async_render_cb_t)(void *data);
+
+
+/* Callback that will be used to destroy data queued with M_async_writer_write_deferred().
+ *
+ * Called once the data has been rendered, or if it's dropped from the queue without being rendered.
+ *
+ * \param[in] data object passed into \a data parameter of M_async_writer_write_deferred().
+ */
+typedef void (*M_async_data_destroy_cb_t)(void *data);
+
+
 /*! Opaque struct that manages state for the writer. */
 struct M_async_writer;
 typedef struct M_async_writer M_async_writer_t;
@@ -299,6 +318,29 @@ M_API void M_async_writer_set_max_bytes(M_async_writer_t *writer, size_t max_byt
 M_API M_bool M_async_writer_write(M_async_writer_t *writer, const char *msg);
 
 
+/*! Write a message to the writer, deferring creation of the message text to the worker thread (non-blocking).
+ *
+ * Same as M_async_writer_write(), except that instead of a finished message, the caller passes in an object
+ * that \a render_cb turns into the message on the internal worker thread. This moves the cost of formatting
+ * a message off of the calling thread.
+ *
+ * Since the final message size isn't known until the message is rendered, \a data_len is used in its place
+ * when enforcing the queue size limit.
+ *
+ * The writer takes ownership of \a data, even if the message couldn't be added to the queue. \a destroy_cb is
+ * called once the data isn't needed anymore.
+ *
+ * \param[in] writer     object we're operating on
+ * \param[in] data       object to pass to render_cb
+ * \param[in] data_len   approximate size of the message, counted against the queue size limit
+ * \param[in] render_cb  callback that creates the message from \a data
+ * \param[in] destroy_cb callback that destroys \a data, may be NULL
+ * \return               M_TRUE if message was added to queue, M_FALSE if it couldn't be added
+ */
+M_API M_bool M_async_writer_write_deferred(M_async_writer_t *writer, void *data, size_t data_len,
+	M_async_render_cb_t render_cb, M_async_data_destroy_cb_t destroy_cb);
+
+
 /*! Return the internal writer callback thunk.
  *
  * \warning
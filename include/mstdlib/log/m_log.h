@@ -221,7 +221,8 @@ typedef enum {
 	M_LOG_MODULE_UNSUPPORTED,  /*!< The given module type is not supported on this OS */
 	M_LOG_MODULE_NOT_FOUND,    /*!< The requested module has already been removed from the logger */
 	M_LOG_WRONG_MODULE,        /*!< Module-specific function was run on the wrong module */
-	M_LOG_GENERIC_FAIL         /*!< Generic internal module failure occurred (usually an IO error) */
+	M_LOG_GENERIC_FAIL,        /*!< Generic internal module failure occurred (usually an IO error) */
+	M_LOG_INVALID_FORMAT       /*!< Binary log format string is invalid, or format ID hasn't been registered */
 } M_log_error_t;
 
 
@@ -772,6 +773,117 @@ M_API M_log_error_t M_log_module_remove(M_log_t *log, M_log_module_t *module);
 
 
 
+/*! \addtogroup m_log_binary Binary Logging
+ *  \ingroup m_log
+ *
+ * Deferred formatting of high-volume log messages.
+ *
+ * Format strings are registered once with a caller-chosen numeric ID. When a message is logged with
+ * M_log_binary_printf(), the raw arguments are captured into a compact binary record instead of being
+ * formatted. Formatting only happens if a module that requires text accepts the message. File, stream and
+ * syslog modules queue the record and format it on their writer thread, so the cost on the logging thread
+ * is just copying the arguments. Modules that accept binary records (currently, membuf modules that have
+ * been switched to binary mode with M_log_module_membuf_set_binary()) store the record as-is. Other
+ * modules receive text formatted on the logging thread.
+ *
+ * Binary records can be turned back into text later with M_log_binary_decode(), either in the same process,
+ * or offline in a decoder that registers the same format strings under the same IDs.
+ *
+ * Records are stored in native byte order, so they must be decoded on a machine with the same architecture.
+ *
+ * Example:
+ * \code{.c}
+ * #define MY_FMT_CONN 1
+ *
+ * M_log_binary_register_format(log, MY_FMT_CONN, "connection %llu from %s:%u");
+ * ...
+ * M_log_binary_printf(log, MY_TAG_DEBUG, NULL, MY_FMT_CONN, conn_id, ipaddr, (unsigned int)port);
+ * \endcode
+ *
+ * @{
+ */
+
+/*! Format ID reserved for records holding already formatted text (written by binary membuf modules when
+ *  they receive a normal text message). Can't be passed to M_log_binary_register_format(). */
+#define M_LOG_BINARY_FORMAT_TEXT 0
+
+
+/*! Register a format string for use with M_log_binary_printf().
+ *
+ * The format string accepts the same conversions as M_printf(), with the exception of anything that doesn't
+ * consume an argument in a fixed way. The string is parsed when it's registered, and an error is returned if
+ * it contains an unsupported or invalid conversion.
+ *
+ * If a format string is already registered with the given ID, it's replaced.
+ *
+ * \param[in] log    logger object
+ * \param[in] fmt_id caller-chosen ID for this format (must not be \link M_LOG_BINARY_FORMAT_TEXT \endlink)
+ * \param[in] fmt    format string, accepts same tags as M_printf()
+ * \return           error code
+ */
+M_API M_log_error_t M_log_binary_register_format(M_log_t *log, M_uint32 fmt_id, const char *fmt);
+
+
+/*! Write a message to the log using a registered format, deferring formatting.
+ *
+ * Tag filtering is the same as for M_log_printf(). If no module accepts the tag, nothing is captured.
+ *
+ * The arguments must match the registered format string exactly, the same way they would need to for M_printf().
+ * String arguments are copied into the record, so they only need to be valid until this function returns.
+ *
+ * Filter callbacks are called as usual. Prefix callbacks are called at the time of the call and their output is
+ * used for any text output of the message, but they aren't applied when binary records are decoded (the
+ * per-message thunk is gone by then).
+ *
+ * \param[in] log       logger object
+ * \param[in] tag       user-defined tag attached to this message (must be a single power-of-two tag)
+ * \param[in] msg_thunk per-message thunk to pass to filter and prefix callbacks (only needs to be valid until function returns)
+ * \param[in] fmt_id    ID of format string previously passed to M_log_binary_register_format()
+ * \return              error code (\link M_LOG_INVALID_FORMAT \endlink if the format ID isn't registered)
+ */
+M_API M_log_error_t M_log_binary_printf(M_log_t *log, M_uint64 tag, void *msg_thunk, M_uint32 fmt_id, ...);
+
+
+/*! Write a message to the log using a registered format, deferring formatting (var arg).
+ *
+ * Same as M_log_binary_printf(), but accepts a variable argument list explicitly as a va_list.
+ *
+ * \param[in] log       logger object
+ * \param[in] tag       user-defined tag attached to this message (must be a single power-of-two tag)
+ * \param[in] msg_thunk per-message thunk to pass to filter and prefix callbacks (only needs to be valid until function returns)
+ * \param[in] fmt_id    ID of format string previously passed to M_log_binary_register_format()
+ * \param[in] ap        list of arguments passed in from the calling vararg function
+ * \return              error code
+ */
+M_API M_log_error_t M_log_binary_vprintf(M_log_t *log, M_uint64 tag, void *msg_thunk, M_uint32 fmt_id, va_list ap);
+
+
+/*! Decode binary log records into text.
+ *
+ * Output uses the log's current time format, tag names and line ending mode, and matches what M_log_write()
+ * would have output at the time the message was logged (except custom prefixes, see M_log_binary_printf()).
+ *
+ * Records whose format ID hasn't been registered are output as a placeholder line, instead of stopping the decode.
+ *
+ * Only complete records are decoded. If the data ends with a partial record (e.g., when decoding a stream in
+ * chunks), the number of bytes that were consumed is returned in \a len_consumed, and the remainder should
+ * be passed in again once more data is available.
+ *
+ * \param[in]  log          logger object holding the registered formats
+ * \param[in]  data         binary records (e.g., the contents of a binary membuf)
+ * \param[in]  data_len     length of data
+ * \param[out] out          buffer to append decoded text to
+ * \param[out] len_consumed number of bytes of data that were decoded, may be \c NULL
+ * \return                  error code (\link M_LOG_GENERIC_FAIL \endlink if a record was malformed)
+ */
+M_API M_log_error_t M_log_binary_decode(M_log_t *log, const unsigned char *data, size_t data_len, M_buf_t *out,
+	size_t *len_consumed);
+
+/*! @} */ /* End of Binary Logging group */
+
+
+
+
 /*! \addtogroup m_log_stream Stream Module
  *  \ingroup m_log
  *
@@ -1128,6 +1240,26 @@ M_API M_log_error_t M_log_module_add_membuf(M_log_t *log, size_t buf_size, M_uin
 	M_log_expire_cb expire_cb, void *expire_thunk, M_log_module_t **out_mod);
 
 
+/*! Switch a membuf module to binary mode (or back to text mode).
+ *
+ * In binary mode, messages written with M_log_binary_printf() are stored as raw binary records, without being
+ * formatted. Normal text messages are stored as records too, so the entire buffer returned by
+ * M_log_module_take_membuf() can be passed to M_log_binary_decode().
+ *
+ * Only switch modes before any messages have been written to the module, otherwise the buffer will contain a mix
+ * of text and binary records.
+ *
+ * \see M_log_binary_printf
+ * \see M_log_binary_decode
+ *
+ * \param[in] log    logger object
+ * \param[in] module handle of module to operate on
+ * \param[in] binary M_TRUE to store binary records, M_FALSE to store text (the default)
+ * \return           error code
+ */
+M_API M_log_error_t M_log_module_membuf_set_binary(M_log_t *log, M_log_module_t *module, M_bool binary);
+
+
 /*! Remove a membuf module from the log and return the internal memory store.
  *
  * This method should be used if you need to preserve the data stored in the buffer. If you just want
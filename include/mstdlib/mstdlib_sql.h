@@ -15,6 +15,7 @@
 
 #include <mstdlib/mstdlib.h>
 #include <mstdlib/mstdlib_thread.h>
+#include <mstdlib/mstdlib_io.h>
 
 #include <mstdlib/sql/m_sql.h>
 #include <mstdlib/sql/m_sql_stmt.h>
@@ -22,6 +23,7 @@
 #include <mstdlib/sql/m_sql_trans.h>
 #include <mstdlib/sql/m_sql_table.h>
 #include <mstdlib/sql/m_sql_trace.h>
+#include <mstdlib/sql/m_sql_bulkload.h>
 
 #endif /* __MSTDLIB_SQL_H__ */
 
@@ -199,6 +199,9 @@ __BEGIN_DECLS
 struct M_net_http_simple;
 typedef struct M_net_http_simple M_net_http_simple_t;
 
+struct M_net_http_pool;
+typedef struct M_net_http_pool M_net_http_pool_t;
+
 /*! Done callback called when the request has completed.
  *
  * Once this callback returns the M_net_http_simple_t object that called this
@@ -349,6 +352,26 @@ M_API void M_net_http_simple_set_tlsctx(M_net_http_simple_t *hs, M_tls_clientctx
 M_API void M_net_http_simple_set_iocreate(M_net_http_simple_t *hs, M_net_http_simple_iocreate_cb iocreate_cb);
 
 
+/*! Use a connection pool for the request.
+ *
+ * Connections are taken from the pool when one to the same server is idle and
+ * returned to it once the response has been read, when the server allows the
+ * connection to be kept alive. Redirects to the same server will reuse the
+ * connection.
+ *
+ * The I/O create callback is only called when a new connection is created.
+ * Idle connections keep any layers added when they were created.
+ *
+ * \param[in] hs   HTTP simple network object.
+ * \param[in] pool Connection pool. Must use the same event loop as hs.
+ *
+ * \return M_TRUE if the pool will be used. Otherwise, M_FALSE if the pool is on a different event loop.
+ *
+ * \see M_net_http_pool_create
+ */
+M_API M_bool M_net_http_simple_set_pool(M_net_http_simple_t *hs, M_net_http_pool_t *pool);
+
+
 /*! Set message data that should be sent with the request.
  *
  * This is optional. If this function is not called M_net_http_simple_send
@@ -393,6 +416,121 @@ M_API M_bool M_net_http_simple_send(M_net_http_simple_t *hs, const char *url, vo
 
 /*! @} */
 
+
+/*! \addtogroup m_net_http_pool HTTP Connection Pool
+ *  \ingroup m_net_http_simple
+ *
+ * Keep-alive connection pool for HTTP simple requests.
+ *
+ * Requests using a pool reuse an idle connection to the same server instead
+ * of going through DNS, TCP and TLS setup for every request. A server is
+ * identified by host, port and the TLS client context used for HTTPS.
+ * When a proxy is used connections are to the proxy.
+ *
+ * A connection is returned to the pool when the response was fully read and
+ * the server didn't ask for it to be closed. HTTP/1.0 responses must
+ * explicitly send "Connection: keep-alive". Sending "Connection: close" as a
+ * header with the request will prevent the connection from being pooled.
+ *
+ * Idle connections are closed once the idle timeout is reached or when the
+ * server closes them. A request that fails on a reused connection before any
+ * response data is received is retried on another connection when the method
+ * is idempotent (GET, HEAD, PUT, DELETE, OPTIONS, TRACE). Other methods report
+ * the error because the server may have acted on the request. Pipelining is not
+ * supported.
+ *
+ * Once the maximum number of connections to a server are in use, requests
+ * wait for one to be returned before being sent.
+ *
+ * Example:
+ *
+ * \code{.c}
+ *     M_net_http_pool_t   *pool;
+ *     M_net_http_simple_t *hs;
+ *
+ *     pool = M_net_http_pool_create(el);
+ *     M_net_http_pool_set_max_per_host(pool, 4);
+ *
+ *     hs = M_net_http_simple_create(el, dns, done_cb);
+ *     M_net_http_simple_set_pool(hs, pool);
+ *     if (!M_net_http_simple_send(hs, "https://example.com/", NULL)) {
+ *         M_net_http_simple_cancel(hs);
+ *     }
+ *
+ *     M_event_loop(el, M_TIMEOUT_INF);
+ *
+ *     M_net_http_pool_destroy(pool);
+ * \endcode
+ *
+ * @{
+ */
+
+/*! Create an HTTP connection pool.
+ *
+ * Defaults to a maximum of 6 connections per server and a 30 second idle timeout.
+ *
+ * \param[in] el Event loop to operate on. Requests using the pool must use this event loop.
+ *
+ * \return Pool on success. Otherwise NULL on error.
+ */
+M_API M_net_http_pool_t *M_net_http_pool_create(M_event_t *el);
+
+
+/*! Destroy an HTTP connection pool.
+ *
+ * Idle connections are closed. Requests that are using the pool can continue
+ * and their connections will be closed once they complete. The pool is freed
+ * once no requests are using it.
+ *
+ * \param[in] pool Connection pool.
+ */
+M_API void M_net_http_pool_destroy(M_net_http_pool_t *pool);
+
+
+/*! Set the maximum number of connections to a server.
+ *
+ * This is the number of connections in use and idle combined.
+ *
+ * \param[in] pool Connection pool.
+ * \param[in] max  Maximum connections. 0 for no limit.
+ */
+M_API void M_net_http_pool_set_max_per_host(M_net_http_pool_t *pool, size_t max);
+
+
+/*! Set how long a connection can be idle before it's closed.
+ *
+ * Only applies to connections returned to the pool after this is set.
+ *
+ * \param[in] pool    Connection pool.
+ * \param[in] idle_ms Idle timeout in milliseconds. 0 to keep connections until the server closes them.
+ */
+M_API void M_net_http_pool_set_idle_timeout(M_net_http_pool_t *pool, M_uint64 idle_ms);
+
+
+/*! Get how often connections were reused.
+ *
+ * The hit rate is hits / (hits + misses).
+ *
+ * \param[in]  pool   Connection pool.
+ * \param[out] hits   Number of requests that used an idle connection.
+ * \param[out] misses Number of requests that needed a new connection.
+ */
+M_API void M_net_http_pool_stats(M_net_http_pool_t *pool, M_uint64 *hits, M_uint64 *misses);
+
+
+/*! Get the number of connections to a server.
+ *
+ * \param[in]  pool Connection pool.
+ * \param[in]  host Host name.
+ * \param[in]  port Port.
+ * \param[out] idle Number of connections that are idle. Optional.
+ *
+ * \return Number of open connections. Both in use and idle.
+ */
+M_API size_t M_net_http_pool_host_connections(M_net_http_pool_t *pool, const char *host, M_uint16 port, size_t *idle);
+
+/*! @} */
+
 __END_DECLS
 
 #endif /* __M_NET_HTTP_SIMPLE_H__ */
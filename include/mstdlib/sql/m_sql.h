@@ -348,6 +348,12 @@ typedef enum {
 	M_SQL_CONNPOOL_FLAG_LOAD_BALANCE       = 1 << 2,  /*!< If there are multiple servers specified for the connection string,
 	                                                   *   this will load balance requests across the servers instead of using
 	                                                   *   them for failover. */
+	M_SQL_CONNPOOL_FLAG_NO_AFFINITY        = 1 << 3,  /*!< By default a connection released while no other thread is waiting
+	                                                   *   is reserved for the releasing thread so its next request can reclaim
+	                                                   *   it, along with its cached prepared statements, without taking the
+	                                                   *   pool lock.  Any other thread takes it over before establishing a new
+	                                                   *   connection or waiting.  This flag always returns connections to the
+	                                                   *   shared idle list instead. */
 } M_sql_connpool_flags_t;
 
 
@@ -473,7 +479,9 @@ M_API M_sql_error_t M_sql_connpool_start(M_sql_connpool_t *pool, char *error, si
 
 /*! Destroy the SQL connection pool and close all open connections.
  *
- *  All connections must be idle/unused or will return a failure.
+ *  All connections must be idle/unused or will return a failure.  This includes
+ *  requests started with M_sql_stmt_execute_async() or M_sql_trans_process_async()
+ *  that have not yet been delivered.
  *
  *  \param[in] pool  Pool object to be destroyed
  *  \return #M_SQL_ERROR_SUCCESS on successful pool destruction, otherwise one of the #M_sql_error_t errors.
@@ -482,6 +490,8 @@ M_API M_sql_error_t M_sql_connpool_destroy(M_sql_connpool_t *pool);
 
 
 /*! Count of active/connected SQL connections (but not ones that are in process of being brought online).
+ *
+ *  This includes idle connections, see M_sql_connpool_idle_conns().
  *
  *  \param[in] pool     Initialized pool object
  *  \param[in] readonly M_TRUE if querying for readonly connections, M_FALSE for primary
@@ -490,6 +500,157 @@ M_API M_sql_error_t M_sql_connpool_destroy(M_sql_connpool_t *pool);
  */
 M_API size_t M_sql_connpool_active_conns(M_sql_connpool_t *pool, M_bool readonly);
 
+
+/*! Count of connected SQL connections not currently in use.
+ *
+ *  Connections kept for reuse by the thread that last released them are idle, see
+ *  #M_SQL_CONNPOOL_FLAG_NO_AFFINITY.
+ *
+ *  \param[in] pool     Initialized pool object
+ *  \param[in] readonly M_TRUE if querying for readonly connections, M_FALSE for primary
+ *
+ *  \return count of idle SQL connections.
+ */
+M_API size_t M_sql_connpool_idle_conns(M_sql_connpool_t *pool, M_bool readonly);
+
+
+/*! Number of buckets in the histogram returned by M_sql_connpool_acquire_stats().
+ *
+ *  Bucket 0 counts acquisitions that took less than 1ms, each following bucket
+ *  has a limit 10x the previous (10ms, 100ms, 1s, 10s), and the last bucket counts
+ *  everything 10s and longer. */
+#define M_SQL_CONNPOOL_WAIT_BUCKETS 6
+
+
+/*! Statistics for obtaining connections from the pool.
+ *
+ *  Counts are cumulative since the pool was created.
+ *
+ *  \param[in]  pool          Initialized pool object
+ *  \param[in]  readonly      M_TRUE if querying for readonly connections, M_FALSE for primary
+ *  \param[out] wait_hist     Optional. Array of #M_SQL_CONNPOOL_WAIT_BUCKETS entries filled with the histogram
+ *                            of time spent waiting for a connection, including time spent establishing a new one.
+ *  \param[out] affinity_hits Optional. Number of times a thread reclaimed the connection it last released
+ *                            without taking the pool lock. See #M_SQL_CONNPOOL_FLAG_NO_AFFINITY.
+ */
+M_API void M_sql_connpool_acquire_stats(M_sql_connpool_t *pool, M_bool readonly, M_uint64 *wait_hist, M_uint64 *affinity_hits);
+
+
+/*! Percentage of its lifetime a connection has spent checked out of the pool.
+ *
+ *  Only completed statements and transactions are counted.  A connection that is
+ *  re-established, such as after a failure or idle timeout, starts over.
+ *
+ *  \param[in] pool     Initialized pool object
+ *  \param[in] readonly M_TRUE if querying for readonly connections, M_FALSE for primary
+ *  \param[in] id       Connection id, from 0 to the maximum number of connections - 1.
+ *
+ *  \return Utilization from 0 to 100.  0 if the connection is not established.
+ */
+M_API M_uint8 M_sql_connpool_conn_utilization(M_sql_connpool_t *pool, M_bool readonly, size_t id);
+
+
+/*! Configure the client-side prepared statement cache.
+ *
+ *  Each connection caches prepared statement handles so repeated queries don't need
+ *  to be prepared again.  Each distinct query is assigned a compact id shared by all
+ *  connections in the pool, so looking up a statement handle that is executed
+ *  more than once doesn't need the query text.
+ *
+ *  Handles are evicted least recently used first when a connection's cache is full.
+ *  If the number of distinct queries routinely executed exceeds the cache size,
+ *  queries are re-prepared constantly, which can be seen with M_sql_connpool_stmt_cache_stats().
+ *
+ *  Must be called before M_sql_connpool_start().
+ *
+ *  \param[in] pool        Initialized pool object by M_sql_connpool_create().
+ *  \param[in] max_stmts   Maximum statement handles cached per connection.  Default is 32.
+ *  \param[in] prepare_hot Number of most executed queries to prepare when a new connection is
+ *                         established, so requests using it don't each wait on a prepare.
+ *                         Must not exceed max_stmts.  Default is 0.
+ *  \return M_TRUE on success, M_FALSE on invalid use or if the pool is already started.
+ */
+M_API M_bool M_sql_connpool_set_stmt_cache(M_sql_connpool_t *pool, size_t max_stmts, size_t prepare_hot);
+
+
+/*! Statistics for the client-side prepared statement cache.
+ *
+ *  Counts are cumulative across all connections since the pool was created.
+ *
+ *  \param[in]  pool        Initialized pool object.
+ *  \param[out] hits        Optional. Executions that reused a cached statement handle.
+ *  \param[out] misses      Optional. Executions that had to prepare the query.
+ *  \param[out] evictions   Optional. Statement handles dropped because a connection's cache was full.
+ *  \param[out] num_queries Optional. Number of distinct queries seen.
+ */
+M_API void M_sql_connpool_stmt_cache_stats(M_sql_connpool_t *pool, M_uint64 *hits, M_uint64 *misses, M_uint64 *evictions, size_t *num_queries);
+
+
+/*! Enable the client-side cache of query results.
+ *
+ *  Only statements marked with M_sql_stmt_set_result_cache() are cached.  When
+ *  the memory limit is reached, the least recently used results are dropped.
+ *  May be called at any time, lowering the limit drops results as needed.
+ *
+ *  \param[in] pool      Initialized pool object by M_sql_connpool_create().
+ *  \param[in] max_bytes Approximate memory limit for cached results.  0 disables
+ *                       the cache, which is the default.
+ *  \return M_TRUE on success, M_FALSE on invalid use.
+ */
+M_API M_bool M_sql_connpool_set_result_cache(M_sql_connpool_t *pool, size_t max_bytes);
+
+
+/*! Drop cached results that depend on a table.
+ *
+ *  Modifications made with the M_sql_tabledata_*() functions invalidate the table
+ *  automatically.  Use this when a table is modified any other way.  Inside a
+ *  transaction use M_sql_trans_result_cache_invalidate() instead so the invalidation
+ *  happens when the transaction is committed.
+ *
+ *  \param[in] pool  Initialized pool object.
+ *  \param[in] table Name of the table as passed to M_sql_stmt_set_result_cache(), case
+ *                   insensitive.  NULL drops all cached results.
+ */
+M_API void M_sql_connpool_result_cache_invalidate(M_sql_connpool_t *pool, const char *table);
+
+
+/*! Statistics for the client-side result cache.
+ *
+ *  \param[in]  pool    Initialized pool object.
+ *  \param[out] hits    Optional. Executions served from the cache.
+ *  \param[out] misses  Optional. Executions of cacheable statements that had to query the server.
+ *  \param[out] entries Optional. Number of results currently cached.
+ *  \param[out] bytes   Optional. Approximate memory used by cached results.
+ */
+M_API void M_sql_connpool_result_cache_stats(M_sql_connpool_t *pool, M_uint64 *hits, M_uint64 *misses, size_t *entries, size_t *bytes);
+
+
+/*! Set the maximum number of worker threads used for asynchronous execution
+ *  via M_sql_stmt_execute_async() and M_sql_trans_process_async().
+ *
+ *  Worker threads are started on demand and exit after being idle.  Each worker
+ *  runs one request at a time and holds an SQL connection while doing so, so there
+ *  is little benefit to using more workers than connections.
+ *
+ *  \param[in] pool Initialized pool object.
+ *  \param[in] num  Maximum number of worker threads.  0 uses the maximum number of
+ *                  connections of the primary and read-only pools combined, which is the default.
+ *  \return M_TRUE on success, M_FALSE if asynchronous execution has already been used.
+ */
+M_API M_bool M_sql_connpool_set_async_workers(M_sql_connpool_t *pool, size_t num);
+
+
+/*! Statistics for asynchronous execution.
+ *
+ *  \param[in]  pool        Initialized pool object.
+ *  \param[out] queued      Optional. Number of requests waiting for a worker thread.
+ *  \param[out] running     Optional. Number of requests executing or waiting to be
+ *                          delivered to their event loop.
+ *  \param[out] wait_avg_ms Optional. Average time in milliseconds requests waited for a worker thread.
+ *  \param[out] wait_max_ms Optional. Longest time in milliseconds a request waited for a worker thread.
+ */
+M_API void M_sql_connpool_async_stats(M_sql_connpool_t *pool, size_t *queued, size_t *running, M_uint64 *wait_avg_ms, M_uint64 *wait_max_ms);
+
 /*! SQL server name and version
  *
  *  \param[in] pool  Initialized pool object
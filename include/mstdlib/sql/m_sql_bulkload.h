@@ -0,0 +1,169 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef __M_SQL_BULKLOAD_H__
+#define __M_SQL_BULKLOAD_H__
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#include <mstdlib/base/m_defs.h>
+#include <mstdlib/base/m_types.h>
+#include <mstdlib/sql/m_sql.h>
+#include <mstdlib/sql/m_sql_stmt.h>
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+__BEGIN_DECLS
+
+/*! \addtogroup m_sql_bulkload SQL Bulk Loading
+ *  \ingroup m_sql
+ *
+ * Load a large number of rows into a single table as fast as the database allows.
+ *
+ * Rows are bound using the normal \link m_sql_stmt_bind M_sql_stmt_bind_*() \endlink
+ * functions against the statement returned by M_sql_bulkload_stmt(), one row at a
+ * time, calling M_sql_bulkload_row_finish() after each row.  Rows are buffered and
+ * committed in batches, each batch in its own transaction.
+ *
+ * Drivers that have a native bulk load path use it, for instance PostgreSQL uses
+ * COPY.  Otherwise a batch is inserted using multi-row INSERT statements where
+ * supported, or a single prepared INSERT executed per row.
+ *
+ * Example:
+ * \code{.c}
+ *   M_sql_bulkload_t *bulk = M_sql_bulkload_create(pool, "users", 0);
+ *   M_sql_stmt_t     *stmt;
+ *   char              error[256];
+ *   M_sql_error_t     err = M_SQL_ERROR_SUCCESS;
+ *   size_t            i;
+ *
+ *   M_sql_bulkload_add_col(bulk, "id");
+ *   M_sql_bulkload_add_col(bulk, "name");
+ *
+ *   for (i=0; i<num_users && !M_sql_error_is_error(err); i++) {
+ *     stmt = M_sql_bulkload_stmt(bulk);
+ *     M_sql_stmt_bind_int64(stmt, users[i].id);
+ *     M_sql_stmt_bind_text_const(stmt, users[i].name, 0);
+ *     err = M_sql_bulkload_row_finish(bulk, error, sizeof(error));
+ *   }
+ *   if (!M_sql_error_is_error(err))
+ *     err = M_sql_bulkload_flush(bulk, error, sizeof(error));
+ *
+ *   M_sql_bulkload_destroy(bulk);
+ * \endcode
+ *
+ * @{
+ */
+
+struct M_sql_bulkload;
+/*! Bulk load object */
+typedef struct M_sql_bulkload M_sql_bulkload_t;
+
+
+/*! Create a bulk load object for a table.
+ *
+ *  \param[in] pool            Initialized and started connection pool.
+ *  \param[in] table_name      Name of the table to load.
+ *  \param[in] rows_per_commit Number of rows to buffer before committing them as a batch,
+ *                             0 for the default of 10000.
+ *  \return Bulk load object or NULL on misuse.
+ */
+M_API M_sql_bulkload_t *M_sql_bulkload_create(M_sql_connpool_t *pool, const char *table_name, size_t rows_per_commit);
+
+
+/*! Add a column to be loaded.
+ *
+ *  Columns must be added before the first row is bound, values are bound in the
+ *  order the columns were added.
+ *
+ *  \param[in] bulk     Bulk load object.
+ *  \param[in] col_name Column name.
+ *  \return M_TRUE on success, M_FALSE on misuse such as rows already having been bound.
+ */
+M_API M_bool M_sql_bulkload_add_col(M_sql_bulkload_t *bulk, const char *col_name);
+
+
+/*! Get the statement to bind the values of the current row to.
+ *
+ *  Only the \link m_sql_stmt_bind M_sql_stmt_bind_*() \endlink functions may be used on
+ *  the statement.  It must not be executed or destroyed.
+ *
+ *  \param[in] bulk Bulk load object.
+ *  \return Statement, or NULL if no columns have been added.
+ */
+M_API M_sql_stmt_t *M_sql_bulkload_stmt(M_sql_bulkload_t *bulk);
+
+
+/*! Mark the current row complete.
+ *
+ *  Once the buffered row count reaches the rows per commit the batch is committed.
+ *
+ *  \param[in]  bulk       Bulk load object.
+ *  \param[out] error      Buffer to hold error message.
+ *  \param[in]  error_size Size of error buffer.
+ *  \return #M_SQL_ERROR_SUCCESS on success.  #M_SQL_ERROR_INVALID_USE if the row does not
+ *          have a value for every column, the row is discarded.  Otherwise the error from
+ *          committing the batch, in which case the rows of the batch were not loaded.
+ */
+M_API M_sql_error_t M_sql_bulkload_row_finish(M_sql_bulkload_t *bulk, char *error, size_t error_size);
+
+
+/*! Commit all buffered rows.
+ *
+ *  Must be called once all rows have been added, otherwise the final rows are discarded.
+ *
+ *  \param[in]  bulk       Bulk load object.
+ *  \param[out] error      Buffer to hold error message.
+ *  \param[in]  error_size Size of error buffer.
+ *  \return #M_SQL_ERROR_SUCCESS on success, otherwise the error from committing the
+ *          batch in which case the rows of the batch were not loaded.
+ */
+M_API M_sql_error_t M_sql_bulkload_flush(M_sql_bulkload_t *bulk, char *error, size_t error_size);
+
+
+/*! Loading statistics.
+ *
+ *  Only committed rows are counted.  Time is measured from the first row bound.
+ *
+ *  \param[in]  bulk         Bulk load object.
+ *  \param[out] rows         Optional. Number of rows committed.
+ *  \param[out] elapsed_ms   Optional. Milliseconds spent loading.
+ *  \param[out] rows_per_sec Optional. Rows committed per second.
+ */
+M_API void M_sql_bulkload_stats(M_sql_bulkload_t *bulk, M_uint64 *rows, M_uint64 *elapsed_ms, M_uint64 *rows_per_sec);
+
+
+/*! Destroy the bulk load object.
+ *
+ *  Rows that have not been committed are discarded.
+ *
+ *  \param[in] bulk Bulk load object.
+ */
+M_API void M_sql_bulkload_destroy(M_sql_bulkload_t *bulk);
+
+/*! @} */
+
+__END_DECLS
+
+#endif /* __M_SQL_BULKLOAD_H__ */
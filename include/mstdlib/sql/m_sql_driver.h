@@ -54,7 +54,7 @@ __BEGIN_DECLS
  */
 
 /*! Current subsystem versioning for module compatibility tracking */
-#define M_SQL_DRIVER_VERSION 0x0100
+#define M_SQL_DRIVER_VERSION 0x0102
 
 /*! Private connection object structure from pool */
 struct M_sql_conn;
@@ -342,6 +342,79 @@ typedef M_bool (*M_sql_driver_cb_append_bitop_t)(M_sql_connpool_t *pool, M_buf_t
  */
 typedef char *(*M_sql_driver_cb_rewrite_indexname_t)(M_sql_connpool_t *pool, const char *index_name);
 
+/*! Enter pipeline mode on a connection so multiple statements can be sent to the server
+ *  without waiting for each result.
+ *
+ *  While in pipeline mode M_sql_driver_cb_prepare_t and M_sql_driver_cb_execute_t must only
+ *  queue the request, M_sql_driver_cb_execute_t should return #M_SQL_ERROR_SUCCESS once queued.
+ *  Results are retrieved in order via M_sql_driver_cb_pipeline_result_t after
+ *  M_sql_driver_cb_pipeline_flush_t has been called.  Any M_sql_driver_cb_prepare_destroy_t
+ *  calls made while in pipeline mode must be deferred until M_sql_driver_cb_pipeline_end_t.
+ *
+ *  \param[in]  conn       Initialized connection object, use M_sql_driver_conn_get_conn() to get driver-specific
+ *                         private connection handle.
+ *  \param[out] error      User-supplied error message buffer
+ *  \param[in]  error_size Size of user-supplied error message buffer
+ *  \return one of the M_sql_error_t conditions
+ */
+typedef M_sql_error_t (*M_sql_driver_cb_pipeline_begin_t)(M_sql_conn_t *conn, char *error, size_t error_size);
+
+/*! Send all queued requests to the server and mark the end of the pipeline.
+ *
+ *  \param[in]  conn       Initialized connection object, use M_sql_driver_conn_get_conn() to get driver-specific
+ *                         private connection handle.
+ *  \param[out] error      User-supplied error message buffer
+ *  \param[in]  error_size Size of user-supplied error message buffer
+ *  \return one of the M_sql_error_t conditions
+ */
+typedef M_sql_error_t (*M_sql_driver_cb_pipeline_flush_t)(M_sql_conn_t *conn, char *error, size_t error_size);
+
+/*! Retrieve the result for the next queued statement.
+ *
+ *  Called once per statement in the order they were queued.  A statement may have been
+ *  queued as multiple executions if its bound rows were split, all of them are consumed by
+ *  a single call.  Behaves like the tail end of M_sql_driver_cb_execute_t, if
+ *  #M_SQL_ERROR_SUCCESS_ROW is returned, rows are then retrieved via M_sql_driver_cb_fetch_t.
+ *
+ *  \param[in]  conn       Initialized connection object, use M_sql_driver_conn_get_conn() to get driver-specific
+ *                         private connection handle.
+ *  \param[in]  stmt       System statement object the result belongs to.
+ *  \param[out] error      User-supplied error message buffer
+ *  \param[in]  error_size Size of user-supplied error message buffer
+ *  \return one of the M_sql_error_t conditions
+ */
+typedef M_sql_error_t (*M_sql_driver_cb_pipeline_result_t)(M_sql_conn_t *conn, M_sql_stmt_t *stmt, char *error, size_t error_size);
+
+/*! Leave pipeline mode.
+ *
+ *  Any results not retrieved must be discarded, and deferred statement handle destruction
+ *  performed.
+ *
+ *  \param[in]  conn       Initialized connection object, use M_sql_driver_conn_get_conn() to get driver-specific
+ *                         private connection handle.
+ *  \return one of the M_sql_error_t conditions
+ */
+typedef M_sql_error_t (*M_sql_driver_cb_pipeline_end_t)(M_sql_conn_t *conn);
+
+/*! Load all rows bound to a statement into a table using the fastest method the
+ *  server provides, such as PostgreSQL's COPY.
+ *
+ *  Always called within a transaction.  The statement is never prepared, the driver
+ *  should only read bound parameters from it.  Bound columns are in the same order as
+ *  the column names provided.
+ *
+ *  \param[in]  conn       Initialized connection object, use M_sql_driver_conn_get_conn() to get driver-specific
+ *                         private connection handle.
+ *  \param[in]  table_name Table to load.
+ *  \param[in]  cols       Column names to load.
+ *  \param[in]  stmt       Statement holding the bound rows.  Use M_sql_driver_stmt_result_set_affected_rows()
+ *                         to record the number of rows loaded.
+ *  \param[out] error      User-supplied error message buffer
+ *  \param[in]  error_size Size of user-supplied error message buffer
+ *  \return one of the M_sql_error_t conditions
+ */
+typedef M_sql_error_t (*M_sql_driver_cb_bulkload_t)(M_sql_conn_t *conn, const char *table_name, const M_list_str_t *cols, M_sql_stmt_t *stmt, char *error, size_t error_size);
+
 /*! Flags advertised by SQL database (could be based on db version etc) */
 typedef enum {
 	M_SQL_DRIVER_FLAG_NONE                      = 0,       /*!< No flags */
@@ -388,6 +461,15 @@ typedef struct  {
 	M_sql_driver_cb_append_bitop_t       cb_append_bitop;       /*!< Required. Callback used to append a bit operation */
 	M_sql_driver_cb_rewrite_indexname_t  cb_rewrite_indexname;  /*!< Optional. Callback used to rewrite an index name to comply with DB requirements */
 	M_module_handle_t                    handle;                /*!< Handle for loaded driver - must be initialized to NULL in the driver structure */
+
+	/* Added in 0x0101. Pipeline callbacks must either all be registered or none. */
+	M_sql_driver_cb_pipeline_begin_t     cb_pipeline_begin;     /*!< Optional. Callback used to enter pipeline mode */
+	M_sql_driver_cb_pipeline_flush_t     cb_pipeline_flush;     /*!< Optional. Callback used to send queued pipeline requests */
+	M_sql_driver_cb_pipeline_result_t    cb_pipeline_result;    /*!< Optional. Callback used to retrieve the result of the next queued statement */
+	M_sql_driver_cb_pipeline_end_t       cb_pipeline_end;       /*!< Optional. Callback used to leave pipeline mode */
+
+	/* Added in 0x0102 */
+	M_sql_driver_cb_bulkload_t           cb_bulkload;           /*!< Optional. Callback used to bulk load rows into a table */
 } M_sql_driver_t;
 
 
@@ -669,10 +751,28 @@ M_API M_bool M_sql_driver_stmt_result_set_col_type(M_sql_stmt_t *stmt, size_t co
  */
 M_API M_buf_t *M_sql_driver_stmt_result_col_start(M_sql_stmt_t *stmt);
 
+/*! Store an integer column value natively rather than as text.
+ *
+ *  This is an alternative to M_sql_driver_stmt_result_col_start() for drivers
+ *  whose client library already returns integers in binary form.  The value is
+ *  kept in a per-column array so the integer and boolean accessors do not need
+ *  to parse it back out of a string.  Text is only produced if the caller asks
+ *  for it.
+ *
+ *  The column type should be #M_SQL_DATA_TYPE_BOOL or one of the integer types.
+ *  NULL columns must still be written via M_sql_driver_stmt_result_col_start().
+ *
+ *  \param[in] stmt Statement handle
+ *  \param[in] val  Integer value
+ *  \return M_TRUE on success, or M_FALSE on failure such as no more eligible
+ *          columns for row.
+ */
+M_API M_bool M_sql_driver_stmt_result_col_int64(M_sql_stmt_t *stmt, M_int64 val);
+
 /*! Finish a row worth of data.
  *
  *  This is required to be called after all the columns for a row are written using
- *  M_sql_driver_stmt_result_col_start().
+ *  M_sql_driver_stmt_result_col_start() or M_sql_driver_stmt_result_col_int64().
  *
  * \param[in] stmt Statement handle
  * \return M_TRUE on success, or M_FALSE on error, such as not all columns written.
@@ -31,6 +31,7 @@
 #include <mstdlib/sql/m_sql.h>
 #include <mstdlib/sql/m_sql_stmt.h>
 #include <mstdlib/formats/m_json.h>
+#include <mstdlib/io/m_io.h>
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -415,6 +416,74 @@ M_API void M_sql_report_state_cancel(M_sql_report_state_t *state);
 M_API M_sql_error_t M_sql_report_process_partial_json(const M_sql_report_t *report, M_sql_stmt_t *stmt, size_t max_rows, void *arg, M_json_node_t *json, M_sql_report_state_t **state, char *error, size_t error_size);
 
 
+/*! Prototype for the output callback used by M_sql_report_process_stream().
+ *
+ * \param[in] data     Report data to write.
+ * \param[in] data_len Length of data.
+ * \param[in] thunk    Argument passed to M_sql_report_process_stream().
+ *
+ * \return M_TRUE if all data was written, M_FALSE on failure which will cause report processing to stop.
+ */
+typedef M_bool (*M_sql_report_write_cb_t)(const unsigned char *data, size_t data_len, void *thunk);
+
+
+/*! Process the results from the SQL statement and hand the output to a callback as it is generated.
+ *
+ *  Output is written in chunks as rows are processed rather than built up in memory,
+ *  so memory use does not grow with the size of the report.  For this to hold for the
+ *  result set too, the statement should be executed with M_sql_stmt_set_max_fetch_rows()
+ *  so rows are fetched from the server in batches; the same result storage is reused for
+ *  each batch.
+ *
+ *  On failure the statement may still have rows remaining on the server, M_sql_stmt_destroy()
+ *  will take care of them.
+ *
+ * \param[in]  report      Initialized report object.
+ * \param[in]  stmt        Executed statement handle.
+ * \param[in]  arg         Custom user-supplied argument to be passed through to registered callbacks for column formatting.
+ * \param[in]  write_cb    Callback to write out report data.
+ * \param[in]  write_thunk Argument passed to write_cb.
+ * \param[out] error       Buffer to hold error message.
+ * \param[in]  error_size  Size of error buffer passed in.
+ * \return #M_SQL_ERROR_SUCCESS on success, or one of the #M_sql_error_t error conditions.  If the
+ *         write callback fails, #M_SQL_ERROR_USER_FAILURE is returned.
+ */
+M_API M_sql_error_t M_sql_report_process_stream(const M_sql_report_t *report, M_sql_stmt_t *stmt, void *arg, M_sql_report_write_cb_t write_cb, void *write_thunk, char *error, size_t error_size);
+
+
+/*! Process the results from the SQL statement and write the output to a file as it is generated.
+ *
+ *  See M_sql_report_process_stream().  The file is created, or truncated if it exists.
+ *
+ * \param[in]  report     Initialized report object.
+ * \param[in]  stmt       Executed statement handle.
+ * \param[in]  arg        Custom user-supplied argument to be passed through to registered callbacks for column formatting.
+ * \param[in]  path       Path of file to write.
+ * \param[out] error      Buffer to hold error message.
+ * \param[in]  error_size Size of error buffer passed in.
+ * \return #M_SQL_ERROR_SUCCESS on success, or one of the #M_sql_error_t error conditions.
+ */
+M_API M_sql_error_t M_sql_report_process_file(const M_sql_report_t *report, M_sql_stmt_t *stmt, void *arg, const char *path, char *error, size_t error_size);
+
+
+/*! Process the results from the SQL statement and write the output to an io object as it is generated.
+ *
+ *  See M_sql_report_process_stream().  Writes are blocking, so the io object must be
+ *  usable with the \link m_io_block M_io_block_*() \endlink functions, it must not be
+ *  associated with an event loop.
+ *
+ * \param[in]  report     Initialized report object.
+ * \param[in]  stmt       Executed statement handle.
+ * \param[in]  arg        Custom user-supplied argument to be passed through to registered callbacks for column formatting.
+ * \param[in]  io         Connected io object.
+ * \param[in]  timeout_ms Maximum time in milliseconds to wait for the io object to accept each chunk of data.
+ * \param[out] error      Buffer to hold error message.
+ * \param[in]  error_size Size of error buffer passed in.
+ * \return #M_SQL_ERROR_SUCCESS on success, or one of the #M_sql_error_t error conditions.
+ */
+M_API M_sql_error_t M_sql_report_process_io(const M_sql_report_t *report, M_sql_stmt_t *stmt, void *arg, M_io_t *io, M_uint64 timeout_ms, char *error, size_t error_size);
+
+
 /*! @} */
 
 __END_DECLS
@@ -29,6 +29,7 @@
 #include <mstdlib/base/m_defs.h>
 #include <mstdlib/base/m_types.h>
 #include <mstdlib/sql/m_sql.h>
+#include <mstdlib/io/m_event.h>
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -173,6 +174,39 @@ M_API M_sql_stmt_t *M_sql_stmt_groupinsert_prepare_buf(M_sql_connpool_t *pool, M
 M_API M_sql_error_t M_sql_stmt_execute(M_sql_connpool_t *pool, M_sql_stmt_t *stmt);
 
 
+/*! Callback for completion of M_sql_stmt_execute_async().
+ *
+ * \param[in] stmt  Statement that was executed.  Still owned by the caller.
+ * \param[in] err   Result of execution, same as M_sql_stmt_execute() would return.
+ * \param[in] thunk Thunk passed to M_sql_stmt_execute_async().
+ */
+typedef void (*M_sql_stmt_execute_cb)(M_sql_stmt_t *stmt, M_sql_error_t err, void *thunk);
+
+
+/*! Execute a single query without blocking the calling thread.
+ *
+ *  Behaves like M_sql_stmt_execute() but the query runs on a worker thread owned
+ *  by the pool, see M_sql_connpool_set_async_workers().  The callback is called
+ *  from the event loop once execution completes.
+ *
+ *  The statement must not be accessed or destroyed until the callback is called.
+ *  If M_sql_stmt_set_max_fetch_rows() was used, M_sql_stmt_fetch() is blocking
+ *  and it is better to fetch all rows.
+ *
+ *  Group insert statements from M_sql_stmt_groupinsert_prepare() can't be executed
+ *  asynchronously.
+ *
+ * \param[in] pool    Initialized and started #M_sql_connpool_t object
+ * \param[in] stmt    Initialized and prepared #M_sql_stmt_t object
+ * \param[in] event   Event loop the callback is called from.
+ * \param[in] done_cb Callback to call on completion.
+ * \param[in] thunk   Argument passed to the callback.
+ * \return M_TRUE if execution was queued, M_FALSE on misuse or if the pool is not started.
+ *         The callback is not called when M_FALSE is returned.
+ */
+M_API M_bool M_sql_stmt_execute_async(M_sql_connpool_t *pool, M_sql_stmt_t *stmt, M_event_t *event, M_sql_stmt_execute_cb done_cb, void *thunk);
+
+
 /*! Set the maximum number of rows to fetch/cache in the statement handle.
  *
  *  By default, all available rows are cached, if this is called, only
@@ -212,6 +246,32 @@ M_API M_bool M_sql_stmt_set_max_fetch_rows(M_sql_stmt_t *stmt, size_t num);
 M_API M_bool M_sql_stmt_set_master_only(M_sql_stmt_t *stmt);
 
 
+/*! Allow the result of this statement to be served from the pool's result cache.
+ *
+ *  The result cache must be enabled with M_sql_connpool_set_result_cache().  When
+ *  executed with M_sql_stmt_execute(), a result previously returned for the same
+ *  query and bound values is copied into the statement without contacting the
+ *  server.  Otherwise the query is executed and a successful result is stored.
+ *
+ *  Only use this for read-only queries that can tolerate data up to ttl_ms old.
+ *  Cached results are dropped early when a table they depend on is modified
+ *  through the M_sql_tabledata_*() functions, or by M_sql_connpool_result_cache_invalidate()
+ *  or M_sql_trans_result_cache_invalidate().  Modifications made any other way are
+ *  not detected.
+ *
+ *  Statements with M_sql_stmt_set_max_fetch_rows() set, or executed as part of a
+ *  transaction, are never cached.
+ *
+ *  May be called more than once to add additional tables the result depends on.
+ *
+ * \param[in] stmt   Initialized and not yet executed #M_sql_stmt_t object.
+ * \param[in] ttl_ms Maximum age of a cached result in milliseconds.  0 disables caching for the statement.
+ * \param[in] table  Optional. Name of a table the result depends on.
+ * \return M_TRUE on success, M_FALSE on misuse.
+ */
+M_API M_bool M_sql_stmt_set_result_cache(M_sql_stmt_t *stmt, M_uint64 ttl_ms, const char *table);
+
+
 /*! Retrieve whether there are still remaining rows on the server yet to be
  *  fetched by the client.
  *
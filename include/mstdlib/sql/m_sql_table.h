@@ -714,6 +714,63 @@ M_API M_sql_error_t M_sql_tabledata_upsert(M_sql_connpool_t *pool, const char *t
 M_API M_sql_error_t M_sql_tabledata_trans_upsert(M_sql_trans_t *sqltrans, const char *table_name, const M_sql_tabledata_t *fields, size_t num_fields, M_sql_tabledata_fetch_cb fetch_cb, M_sql_tabledata_notify_cb notify_cb, void *thunk, char *error, size_t error_len);
 
 
+/*! Operation performed on each record by M_sql_tabledata_bulk() */
+typedef enum {
+	M_SQL_TABLEDATA_BULK_ADD    = 0, /*!< Same as M_sql_tabledata_add() */
+	M_SQL_TABLEDATA_BULK_EDIT   = 1, /*!< Same as M_sql_tabledata_edit() */
+	M_SQL_TABLEDATA_BULK_UPSERT = 2  /*!< Same as M_sql_tabledata_upsert() */
+} M_sql_tabledata_bulk_op_t;
+
+/*! Result of a single batch processed by M_sql_tabledata_bulk() */
+typedef struct {
+	size_t        first_record;  /*!< Index of the first record in the batch */
+	size_t        num_records;   /*!< Number of records in the batch */
+	size_t        failed_record; /*!< Index of the record that caused the batch to fail.  Only valid if err is an error. */
+	M_sql_error_t err;           /*!< Result of the batch.  On error, no records in the batch were committed. */
+	char          error[256];    /*!< Error message if err is an error */
+} M_sql_tabledata_bulk_batch_t;
+
+/*! Add, edit or upsert many records in batches.
+ *
+ *  Each record is processed exactly as it would be by M_sql_tabledata_add(),
+ *  M_sql_tabledata_edit() or M_sql_tabledata_upsert(), but records are grouped
+ *  into batches with each batch committed as a single transaction.  Since every
+ *  record in a batch generates the same query, the prepared statement is reused
+ *  from the connection's statement cache rather than re-prepared per record.
+ *
+ *  A failure of any record rolls back its entire batch but does not stop other
+ *  batches from being processed.  Use the returned batch list to determine which
+ *  records need to be corrected and resubmitted.
+ *
+ *  If max_threads is greater than 1, batches are spread across that many threads,
+ *  each using its own pool connection.  The fetch_cb and notify_cb callbacks will
+ *  then be called concurrently (though never concurrently for the same record) so
+ *  must be thread safe.  There is no ordering guarantee between batches.
+ *
+ * \param[in]     pool              The handle to the SQL pool in use.
+ * \param[in]     op                Operation to perform on each record.
+ * \param[in]     table_name        Name of the table
+ * \param[in]     fields            List of fields (columns) in the table.
+ * \param[in]     num_fields        Number of fields in the list
+ * \param[in]     fetch_cb          Callback to be called to fetch each field/column.
+ * \param[in]     notify_cb         Optional. Callback to be called to be notified on successful completion of each record.
+ * \param[in]     thunks            One thunk per record, passed to fetch_cb for that record.
+ * \param[in]     num_records       Number of records (thunks).
+ * \param[in]     records_per_batch Number of records per transaction.  0 for a default of 100.
+ * \param[in]     max_threads       Maximum number of batches to process concurrently.  0 or 1 processes
+ *                                  batches serially in the calling thread.  Should not exceed the
+ *                                  number of connections in the pool.
+ * \param[out]    batches           Optional. Allocated list of per-batch results, must be M_free()'d.
+ * \param[out]    num_batches       Optional. Number of entries in batches.
+ * \param[in,out] error             Buffer to hold error if any.  On a batch failure, this is the error of
+ *                                  the first failed batch.
+ * \param[in]     error_len         Size of error buffer
+ * \return M_SQL_ERROR_SUCCESS if all batches succeeded.  Otherwise the error of the first failed batch, or
+ *         M_SQL_ERROR_USER_FAILURE on invalid usage of this function.
+ */
+M_API M_sql_error_t M_sql_tabledata_bulk(M_sql_connpool_t *pool, M_sql_tabledata_bulk_op_t op, const char *table_name, const M_sql_tabledata_t *fields, size_t num_fields, M_sql_tabledata_fetch_cb fetch_cb, M_sql_tabledata_notify_cb notify_cb, void * const *thunks, size_t num_records, size_t records_per_batch, size_t max_threads, M_sql_tabledata_bulk_batch_t **batches, size_t *num_batches, char *error, size_t error_len);
+
+
 /*! Convenience function to expand a list of tabledata fields base on an M_list_str_t list of
  *  virtual column names tied to a single table column that share the same attributes.  All
  *  virtual columns are always stored as text.
@@ -30,6 +30,7 @@
 #include <mstdlib/base/m_types.h>
 #include <mstdlib/sql/m_sql.h>
 #include <mstdlib/sql/m_sql_stmt.h>
+#include <mstdlib/formats/m_table.h>
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -145,6 +146,77 @@ M_API M_bool M_sql_connpool_add_trace(M_sql_connpool_t *pool, M_sql_trace_cb_t c
 M_API void M_sql_connpool_trace_stalls(M_sql_connpool_t *pool, M_uint64 max_query_s, M_uint64 max_trans_idle_s, M_uint64 max_trans_s);
 
 
+/*! Enable or disable the built-in query profiler.
+ *
+ *  The profiler aggregates statistics for every executed statement by its query
+ *  text, with string and numeric literals replaced by '?' so the same query issued
+ *  with different values is tracked as one.  It does not depend on
+ *  M_sql_connpool_add_trace().  When disabled (the default), the only cost per
+ *  execution is checking whether it is enabled.
+ *
+ *  Results served from the result cache (M_sql_stmt_set_result_cache()) are not
+ *  counted as they never reach the server.
+ *
+ *  Disabling the profiler keeps the statistics already collected, use
+ *  M_sql_connpool_profile_reset() to clear them.
+ *
+ *  \param[in] pool        Initialized pool object by M_sql_connpool_create().
+ *  \param[in] max_queries Maximum number of distinct queries to track.  Executions
+ *                         of queries not already tracked once the limit is reached
+ *                         are counted as dropped.  0 to disable.
+ *  \return M_FALSE on misuse.
+ */
+M_API M_bool M_sql_connpool_set_profile(M_sql_connpool_t *pool, size_t max_queries);
+
+
+/*! Clear all statistics collected by the query profiler.
+ *
+ *  \param[in] pool Initialized pool object by M_sql_connpool_create().
+ */
+M_API void M_sql_connpool_profile_reset(M_sql_connpool_t *pool);
+
+
+/*! Retrieve the statistics collected by the query profiler.
+ *
+ *  One row is returned per query, ordered by total time spent, most expensive
+ *  first.  All times are in microseconds.  Columns are:
+ *    - query      - Query with literals replaced by '?'
+ *    - count      - Number of executions
+ *    - errors     - Number of executions that failed
+ *    - total_us   - Total time spent preparing, executing and fetching rows
+ *    - avg_us     - Average of total_us per execution
+ *    - p99_us     - 99th percentile of time per execution, accurate to within
+ *                   12.5%
+ *    - max_us     - Longest execution
+ *    - prepare_us - Portion of total_us spent formatting and preparing the query
+ *    - execute_us - Portion of total_us spent executing the query
+ *    - fetch_us   - Portion of total_us spent fetching rows
+ *    - wait_us    - Time spent waiting for a connection from the pool, not included
+ *                   in total_us.  Only tracked for M_sql_stmt_execute(), statements
+ *                   in a transaction already hold a connection.
+ *    - rows       - Rows fetched
+ *    - bytes      - Size of the row data fetched
+ *
+ *  \param[in]  pool    Initialized pool object by M_sql_connpool_create().
+ *  \param[out] dropped Optional. Number of executions not tracked because the
+ *                      query limit was reached.
+ *  \return Table, must be destroyed with M_table_destroy().
+ */
+M_API M_table_t *M_sql_connpool_profile_table(M_sql_connpool_t *pool, M_uint64 *dropped);
+
+
+/*! Retrieve the statistics collected by the query profiler as JSON.
+ *
+ *  Output is an array of objects, one per query, with the same keys as the
+ *  columns returned by M_sql_connpool_profile_table().
+ *
+ *  \param[in] pool  Initialized pool object by M_sql_connpool_create().
+ *  \param[in] flags M_json_writer_flags_t flags controlling writing.
+ *  \return JSON string, must be M_free()'d.
+ */
+M_API char *M_sql_connpool_profile_json(M_sql_connpool_t *pool, M_uint32 flags);
+
+
 /*! Set a flag on the statement to ensure a #M_SQL_TRACE_TRANFAIL is not triggered
  *  in the event of a failure.
  *
@@ -144,6 +144,48 @@ M_API M_sql_error_t M_sql_trans_commit(M_sql_trans_t *trans, char *error, size_t
 M_API M_sql_error_t M_sql_trans_execute(M_sql_trans_t *trans, M_sql_stmt_t *stmt);
 
 
+/*! Execute multiple queries against the database as part of an open transaction,
+ *  sending them together where possible.
+ *
+ *  Drivers that support pipelining (PostgreSQL built against libpq 14 or newer) send
+ *  every statement before waiting on any result, so the batch costs a single round
+ *  trip rather than one per statement.  Other drivers execute the statements one at
+ *  a time.
+ *
+ *  Each statement receives its own result, use M_sql_stmt_get_error() and the
+ *  \link m_sql_stmt_result M_sql_stmt_result_*() \endlink functions on each one.
+ *  All rows are fetched for statements that return them, so statements in a batch
+ *  must not use M_sql_stmt_set_max_fetch_rows().
+ *
+ *  Once a statement fails, statements following it that were not already sent to the
+ *  server are not executed and fail with #M_SQL_ERROR_QUERY_FAILURE.  When pipelined
+ *  the server refuses anything after the failure within the same batch.  As with
+ *  M_sql_trans_execute(), the transaction should be rolled back on failure, which
+ *  M_sql_trans_process() handles automatically.
+ *
+ *  \param[in] trans     Initialized #M_sql_trans_t object.
+ *  \param[in] stmts     Array of initialized and prepared #M_sql_stmt_t objects, executed in order.
+ *  \param[in] num_stmts Number of statements in the array.
+ *  \return #M_SQL_ERROR_SUCCESS if all statements succeeded, otherwise the error of the first
+ *          statement that failed.
+ */
+M_API M_sql_error_t M_sql_trans_execute_batch(M_sql_trans_t *trans, M_sql_stmt_t **stmts, size_t num_stmts);
+
+
+/*! Drop cached results that depend on a table once the transaction commits.
+ *
+ *  Use this when modifying a table whose results may be cached, see
+ *  M_sql_stmt_set_result_cache().  Nothing is dropped if the transaction is
+ *  rolled back.  Modifications made with the M_sql_tabledata_*() functions do
+ *  this automatically.
+ *
+ *  \param[in] trans Initialized #M_sql_trans_t object.
+ *  \param[in] table Name of the table, case insensitive.  NULL drops all cached results.
+ *  \return M_TRUE on success, M_FALSE on misuse.
+ */
+M_API M_bool M_sql_trans_result_cache_invalidate(M_sql_trans_t *trans, const char *table);
+
+
 /*! Function prototype called by M_sql_trans_process(). 
  *
  *  Inside the function created, the integrator should perform each step of the SQL
@@ -270,6 +312,36 @@ typedef M_sql_error_t (*M_sql_trans_commands_t)(M_sql_trans_t *trans, void *arg,
  */
 M_API M_sql_error_t M_sql_trans_process(M_sql_connpool_t *pool, M_sql_isolation_t isolation, M_sql_trans_commands_t cmd, void *cmd_arg, char *error, size_t error_size);
 
+
+/*! Callback for completion of M_sql_trans_process_async().
+ *
+ *  \param[in] err   Result of the transaction, same as M_sql_trans_process() would return.
+ *  \param[in] error Error message.
+ *  \param[in] thunk Thunk passed to M_sql_trans_process_async().
+ */
+typedef void (*M_sql_trans_process_cb)(M_sql_error_t err, const char *error, void *thunk);
+
+
+/*! Run a transaction without blocking the calling thread.
+ *
+ *  Behaves like M_sql_trans_process() but the transaction runs on a worker thread
+ *  owned by the pool, see M_sql_connpool_set_async_workers().  The command callback
+ *  is called from the worker thread and must not touch objects owned by the event
+ *  loop.  The completion callback is called from the event loop.
+ *
+ *  \param[in] pool      Initialized and started pool object.
+ *  \param[in] isolation Requested isolation level.
+ *  \param[in] cmd       User-specified function to call to step through the sequence of SQL commands.
+ *  \param[in] cmd_arg   Argument to pass to the command function.  Must remain valid until
+ *                       the completion callback is called.
+ *  \param[in] event     Event loop the completion callback is called from.
+ *  \param[in] done_cb   Callback to call on completion.
+ *  \param[in] thunk     Argument passed to the completion callback.
+ *  \return M_TRUE if the transaction was queued, M_FALSE on misuse or if the pool is not started.
+ *          The callback is not called when M_FALSE is returned.
+ */
+M_API M_bool M_sql_trans_process_async(M_sql_connpool_t *pool, M_sql_isolation_t isolation, M_sql_trans_commands_t cmd, void *cmd_arg, M_event_t *event, M_sql_trans_process_cb done_cb, void *thunk);
+
 /*! Retrieve the #M_sql_connpool_t object from a transaction handle typically used within M_sql_trans_process()
  *  for using the SQL helpers like M_sql_query_append_updlock() and M_sql_query_append_bitop().
  *
@@ -88,6 +88,28 @@ typedef enum {
 } M_tls_init_t;
 
 
+/*! Client session cache statistics.
+ *
+ * \see M_tls_clientctx_get_session_statistic */
+typedef enum {
+	M_TLS_SESSION_STATISTIC_HITS      = 1, /*!< Number of connections a cached session was offered for resumption.
+	                                            The server may still choose not to resume. */
+	M_TLS_SESSION_STATISTIC_MISSES    = 2, /*!< Number of connections no cached session was available for. */
+	M_TLS_SESSION_STATISTIC_EVICTIONS = 3, /*!< Number of sessions dropped due to capacity limits or expiration. */
+	M_TLS_SESSION_STATISTIC_STORED    = 4  /*!< Number of sessions currently cached. */
+} M_tls_session_statistic_t;
+
+
+/*! Kernel TLS offload state of a connection.
+ *
+ * \see M_tls_get_ktls */
+typedef enum {
+	M_TLS_KTLS_NONE = 0,      /*!< All records are encrypted and decrypted in user space. */
+	M_TLS_KTLS_SEND = 1 << 0, /*!< The kernel encrypts data written. */
+	M_TLS_KTLS_RECV = 1 << 1  /*!< The kernel decrypts data read. */
+} M_tls_ktls_t;
+
+
 /*! Initialize the TLS library.
  *
  * If a TLS function is used without calling this function it
@@ -300,14 +322,90 @@ M_API M_bool M_tls_clientctx_set_verify_level(M_tls_clientctx_t *ctx, M_tls_veri
  *
  * Session resumption is enabled by default.
  *
+ * Sessions are cached by the client context keyed on host and port. They are
+ * stored as soon as they're received from the server (including TLSv1.3 tickets
+ * that arrive after the handshake) and are shared by all connections using
+ * the context. A cached session is only used by one connection at a time.
+ *
  * \param[in] ctx    Client context.
  * \param[in] enable M_TRUE to enable. M_FALSE to disable.
  *
  * \return M_TRUE on success, otherwise M_FALSE on error.
+ *
+ * \see M_tls_clientctx_set_session_cache_limits
  */
 M_API M_bool M_tls_clientctx_set_session_resumption(M_tls_clientctx_t *ctx, M_bool enable);
 
 
+/*! Set the capacity of the session cache.
+ *
+ * When more than max_hosts host and port combinations have sessions cached the
+ * least recently used host's sessions are evicted. When a host has more than
+ * max_per_host sessions the oldest is evicted.
+ *
+ * Defaults to 1024 hosts and 4 sessions per host.
+ *
+ * \param[in] ctx          Client context.
+ * \param[in] max_hosts    Maximum number of host and port combinations to cache sessions for. Must be greater than 0.
+ * \param[in] max_per_host Maximum number of sessions to cache per host and port. Must be greater than 0.
+ *
+ * \return M_TRUE on success, otherwise M_FALSE on error.
+ */
+M_API M_bool M_tls_clientctx_set_session_cache_limits(M_tls_clientctx_t *ctx, size_t max_hosts, size_t max_per_host);
+
+
+/*! Enable or disable TLSv1.2 and earlier session tickets.
+ *
+ * Disabled by default because ticket keys that are not rotated frequently by the
+ * server compromise perfect forward secrecy. Without tickets, TLSv1.2 and earlier
+ * resumption relies on the server's session cache. TLSv1.3 always uses tickets and
+ * is not affected by this setting.
+ *
+ * \param[in] ctx    Client context.
+ * \param[in] enable M_TRUE to enable. M_FALSE to disable.
+ *
+ * \return M_TRUE on success, otherwise M_FALSE on error.
+ */
+M_API M_bool M_tls_clientctx_set_session_tickets(M_tls_clientctx_t *ctx, M_bool enable);
+
+
+/*! Get a session cache statistic.
+ *
+ * Counters are cumulative for the life of the context.
+ *
+ * \param[in] ctx  Client context.
+ * \param[in] type Statistic to retrieve.
+ *
+ * \return Value of the statistic.
+ */
+M_API M_uint64 M_tls_clientctx_get_session_statistic(M_tls_clientctx_t *ctx, M_tls_session_statistic_t type);
+
+
+/*! Enable or disable kernel TLS (kTLS) offload.
+ *
+ * Once the handshake completes, record encryption and decryption is handed to the
+ * kernel so data is written and read directly to and from the socket. This allows
+ * files to be sent with M_tls_sendfile() without being copied through user space.
+ *
+ * Only supported on Linux with OpenSSL 3.x built with kTLS support. Connections fall
+ * back to user space encryption if the kernel TLS module isn't loaded or the kernel
+ * doesn't support the negotiated cipher. Use M_tls_get_ktls() to check whether a
+ * connection is offloaded.
+ *
+ * Must be set before the TLS layer is added. Connections using kTLS must not have any
+ * other layers between the network layer and the TLS layer, so the buffer layer normally
+ * added beneath TLS is not.
+ *
+ * Disabled by default.
+ *
+ * \param[in] ctx    Client context.
+ * \param[in] enable M_TRUE to enable. M_FALSE to disable.
+ *
+ * \return M_TRUE on success, otherwise M_FALSE if kTLS isn't supported by this build.
+ */
+M_API M_bool M_tls_clientctx_set_ktls(M_tls_clientctx_t *ctx, M_bool enable);
+
+
 /*! Retrieves a colon separated list of ciphers that are enabled.
  *
  * \param[in] ctx Client context.
@@ -411,6 +509,8 @@ M_API void M_tls_serverctx_destroy(M_tls_serverctx_t *ctx);
  *
  * This is not necessary if a certificate lists all expected host names as subject alt names.
  *
+ * Children use the parent's session ticket keys so a child can't have its own.
+ *
  * \param[in] ctx   Server context.
  * \param[in] child Child server context.
  *
@@ -653,6 +753,115 @@ M_API M_bool M_tls_serverctx_set_dhparam_file(M_tls_serverctx_t *ctx, const char
 M_API M_bool M_tls_serverctx_set_session_resumption(M_tls_serverctx_t *ctx, M_bool enable);
 
 
+/*! Length of a single session ticket key.
+ *
+ * A key is a 16 byte key name, a 32 byte HMAC-SHA256 secret and a 32 byte AES-256 key.
+ * This matches the 80 byte ticket key files used by other servers so the same key
+ * files can be shared.
+ */
+#define M_TLS_SERVERCTX_TICKET_KEY_LEN 80
+
+
+/*! Set the session ticket key ring.
+ *
+ * By default OpenSSL generates random ticket keys per context. Tickets issued by one
+ * process can't be used by another and are invalidated by a restart. Setting a key
+ * ring that is shared by all processes allows any of them to resume a session.
+ *
+ * The first key is used to encrypt new tickets. All keys are used to decrypt tickets.
+ * A client presenting a ticket encrypted with an older key will be issued a new ticket
+ * encrypted with the first key.
+ *
+ * Keys should be rotated periodically to preserve forward secrecy.
+ *
+ * SNI child contexts use the parent's key ring. Setting keys on a child is an error,
+ * as is adding a context that has keys as a child.
+ *
+ * \param[in] ctx      Server context.
+ * \param[in] keys     One or more concatenated keys each M_TLS_SERVERCTX_TICKET_KEY_LEN long.
+ *                     NULL to revert to OpenSSL's internal keys.
+ * \param[in] keys_len Length of keys. Must be a multiple of M_TLS_SERVERCTX_TICKET_KEY_LEN.
+ *
+ * \return M_TRUE on success, otherwise M_FALSE on error.
+ *
+ * \see M_tls_serverctx_set_ticket_keys_file
+ * \see M_tls_serverctx_rotate_ticket_key
+ */
+M_API M_bool M_tls_serverctx_set_ticket_keys(M_tls_serverctx_t *ctx, const unsigned char *keys, size_t keys_len);
+
+
+/*! Set the session ticket key ring from a file.
+ *
+ * The file contains raw concatenated keys, the first being used for encryption.
+ *
+ * \param[in] ctx  Server context.
+ * \param[in] path Path to the key file.
+ *
+ * \return M_TRUE on success, otherwise M_FALSE on error.
+ *
+ * \see M_tls_serverctx_set_ticket_keys
+ */
+M_API M_bool M_tls_serverctx_set_ticket_keys_file(M_tls_serverctx_t *ctx, const char *path);
+
+
+/*! Rotate the session ticket key ring.
+ *
+ * The key becomes the encryption key and previous keys are retained for decryption
+ * so outstanding tickets can still be used. Meant to be called periodically, such as
+ * from a timer. Not allowed on SNI child contexts.
+ *
+ * \param[in] ctx      Server context.
+ * \param[in] key      New key M_TLS_SERVERCTX_TICKET_KEY_LEN long. NULL to generate a random key,
+ *                     only useful if this is the only process issuing tickets.
+ * \param[in] key_len  Length of key.
+ * \param[in] max_keys Maximum number of keys to retain including the new one. Oldest keys
+ *                     are dropped. 0 will use the default of 2.
+ *
+ * \return M_TRUE on success, otherwise M_FALSE on error.
+ *
+ * \see M_tls_serverctx_set_ticket_keys
+ */
+M_API M_bool M_tls_serverctx_rotate_ticket_key(M_tls_serverctx_t *ctx, const unsigned char *key, size_t key_len, size_t max_keys);
+
+
+/*! Perform handshakes on a thread pool instead of the event thread.
+ *
+ * The key exchange and signing done during a handshake is CPU intensive. When
+ * many clients connect at once, performing handshakes on the event thread will
+ * delay processing of every other connection on that event loop.
+ *
+ * With a thread pool set, the event thread only moves data between the connection
+ * and the handshake, the handshake itself runs on the pool. Once the handshake
+ * completes all I/O happens on the event thread as normal.
+ *
+ * Can only be set once and applies to connections accepted after it is set. The pool
+ * must not be destroyed before the context. If the pool's queue fills, accepting will
+ * block the event thread until a slot is available, so the pool should be created
+ * with an unbounded queue (SIZE_MAX).
+ *
+ * \param[in] ctx  Server context.
+ * \param[in] pool Thread pool to use.
+ *
+ * \return M_TRUE on success, otherwise M_FALSE on error.
+ */
+M_API M_bool M_tls_serverctx_set_handshake_threadpool(M_tls_serverctx_t *ctx, M_threadpool_t *pool);
+
+
+/*! Enable or disable kernel TLS (kTLS) offload.
+ *
+ * Must be set before the TLS layer is added to the listener. Handshakes offloaded to
+ * a thread pool do not use kTLS.
+ *
+ * \param[in] ctx    Server context.
+ * \param[in] enable M_TRUE to enable. M_FALSE to disable.
+ *
+ * \return M_TRUE on success, otherwise M_FALSE if kTLS isn't supported by this build.
+ *
+ * \see M_tls_clientctx_set_ktls
+ */
+M_API M_bool M_tls_serverctx_set_ktls(M_tls_serverctx_t *ctx, M_bool enable);
+
+
 /*! Retrieves a colon separated list of ciphers that are enabled.
  *
  * \param[in] ctx Server context.
@@ -767,6 +976,38 @@ M_API char *M_tls_get_peer_cert(M_io_t *io, size_t id);
 M_API M_uint64 M_tls_get_negotiation_time_ms(M_io_t *io, size_t id);
 
 
+/*! Which directions of the connection are offloaded to kernel TLS.
+ *
+ * \param[in] io io object.
+ * \param[in] id Layer id.
+ *
+ * \return Bitmap of M_tls_ktls_t values.
+ *
+ * \see M_tls_clientctx_set_ktls
+ * \see M_tls_serverctx_set_ktls
+ */
+M_API M_tls_ktls_t M_tls_get_ktls(M_io_t *io, size_t id);
+
+
+/*! Send data from a file over the connection without copying it through user space.
+ *
+ * Requires the kernel to be encrypting sent data (M_TLS_KTLS_SEND). Can be mixed with
+ * M_io_write() as long as each call completes before the next is made.
+ *
+ * \param[in]  io          io object.
+ * \param[in]  id          Layer id.
+ * \param[in]  fd          File descriptor of the file to send.
+ * \param[in]  offset      Offset in the file to start sending from.
+ * \param[in]  len         Maximum number of bytes to send.
+ * \param[out] len_written Number of bytes sent.
+ *
+ * \return Result. M_IO_ERROR_WOULDBLOCK if the connection can't currently accept data, a WRITE
+ *         event will be delivered when it can. M_IO_ERROR_NOTIMPL if sent data isn't being
+ *         encrypted by the kernel, in which case M_io_write() must be used.
+ */
+M_API M_io_error_t M_tls_sendfile(M_io_t *io, size_t id, int fd, M_uint64 offset, size_t len, size_t *len_written);
+
+
 /*! Convert a protocol to string.
  *
  * Only single protocol should be specified. If multiple are provided
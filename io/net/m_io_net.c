@@ -47,6 +47,19 @@
 #ifndef _WIN32
 #  include <unistd.h>
 #endif
+#ifdef __linux__
+#  include <sys/sendfile.h>
+#endif
+#if defined(__linux__) && defined(HAVE_LINUX_TLS_H)
+#  include <linux/tls.h>
+#  define M_IO_NET_KTLS 1
+#  ifndef SOL_TLS
+#    define SOL_TLS 282
+#  endif
+#  ifndef TCP_ULP
+#    define TCP_ULP 31
+#  endif
+#endif
 #include "m_io_net_int.h"
 
 #ifndef HAVE_SOCKLEN_T
@@ -200,6 +213,89 @@ static void M_io_net_timeout_cb(M_event_t *event, M_event_type_t type, M_io_t *c
 #  define RECV_LEN_TYPE size_t
 #endif
 
+#ifdef M_IO_NET_KTLS
+/* TLS record header length and the application data record type */
+#  define M_IO_NET_KTLS_HDR_LEN 5
+#  define M_IO_NET_KTLS_APPDATA 23
+
+/* Once the kernel is decrypting, the TLS layer above still needs to know the type
+ * of each record (alerts, post handshake messages). Each read returns a single
+ * record's plaintext prefixed with a reconstructed record header. */
+static ssize_t M_io_net_ktls_recv(M_io_handle_t *handle, unsigned char *buf, size_t len)
+{
+	struct msghdr   msg;
+	struct cmsghdr *cmsg;
+	struct iovec    iov;
+	union {
+		struct cmsghdr hdr;
+		unsigned char  buf[CMSG_SPACE(sizeof(unsigned char))];
+	} cbuf;
+	unsigned char   rectype = M_IO_NET_KTLS_APPDATA;
+	ssize_t         retval;
+
+	if (len <= M_IO_NET_KTLS_HDR_LEN) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	M_mem_set(&msg, 0, sizeof(msg));
+	M_mem_set(&cbuf, 0, sizeof(cbuf));
+	iov.iov_base       = buf + M_IO_NET_KTLS_HDR_LEN;
+	iov.iov_len        = len - M_IO_NET_KTLS_HDR_LEN;
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = cbuf.buf;
+	msg.msg_controllen = sizeof(cbuf.buf);
+
+	retval = recvmsg(handle->data.net.sock, &msg, 0);
+	if (retval <= 0)
+		return retval;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg != NULL && cmsg->cmsg_level == SOL_TLS && cmsg->cmsg_type == TLS_GET_RECORD_TYPE)
+		rectype = *((unsigned char *)CMSG_DATA(cmsg));
+
+	buf[0] = rectype;
+	buf[1] = 0x03; /* Record layer version is always TLSv1.2 */
+	buf[2] = 0x03;
+	buf[3] = (unsigned char)((retval >> 8) & 0xFF);
+	buf[4] = (unsigned char)(retval & 0xFF);
+
+	return retval + M_IO_NET_KTLS_HDR_LEN;
+}
+
+
+/* Data written while the kernel is encrypting is sent as application data unless
+ * a record type is attached. */
+static ssize_t M_io_net_ktls_send_record(M_io_handle_t *handle, const unsigned char *buf, size_t len, int flags)
+{
+	struct msghdr   msg;
+	struct cmsghdr *cmsg;
+	struct iovec    iov;
+	union {
+		struct cmsghdr hdr;
+		unsigned char  buf[CMSG_SPACE(sizeof(unsigned char))];
+	} cbuf;
+
+	M_mem_set(&msg, 0, sizeof(msg));
+	M_mem_set(&cbuf, 0, sizeof(cbuf));
+	iov.iov_base       = M_CAST_OFF_CONST(unsigned char *, buf);
+	iov.iov_len        = len;
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = cbuf.buf;
+	msg.msg_controllen = sizeof(cbuf.buf);
+
+	cmsg               = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level   = SOL_TLS;
+	cmsg->cmsg_type    = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len     = CMSG_LEN(sizeof(unsigned char));
+	*((unsigned char *)CMSG_DATA(cmsg)) = handle->data.net.ktls_rectype;
+
+	return sendmsg(handle->data.net.sock, &msg, flags);
+}
+#endif
+
 static M_io_error_t M_io_net_read_cb_int(M_io_layer_t *layer, unsigned char *buf, size_t *read_len, M_io_meta_t *meta)
 {
 	ssize_t        retval;
@@ -208,7 +304,15 @@ static M_io_error_t M_io_net_read_cb_int(M_io_layer_t *layer, unsigned char *buf
 	(void)meta;
 
 	errno  = 0;
+#ifdef M_IO_NET_KTLS
+	if (handle->data.net.ktls_recv) {
+		retval = M_io_net_ktls_recv(handle, buf, *read_len);
+	} else {
+		retval = (ssize_t)recv(handle->data.net.sock, (RECV_TYPE)buf, (RECV_LEN_TYPE)*read_len, 0);
+	}
+#else
 	retval = (ssize_t)recv(handle->data.net.sock, (RECV_TYPE)buf, (RECV_LEN_TYPE)*read_len, 0);
+#endif
 	if (retval == 0) {
 		handle->data.net.last_error_sys = 0;
 		handle->data.net.last_error     = M_IO_ERROR_DISCONNECT;
@@ -258,7 +362,15 @@ static M_io_error_t M_io_net_write_cb_int(M_io_layer_t *layer, const unsigned ch
 #endif
 
 	errno  = 0;
+#ifdef M_IO_NET_KTLS
+	if (handle->data.net.ktls_rectype != 0) {
+		retval = M_io_net_ktls_send_record(handle, buf, *write_len, flags);
+	} else {
+		retval = (ssize_t)send(handle->data.net.sock, (SEND_TYPE)buf, (SEND_LEN_TYPE)*write_len, flags);
+	}
+#else
 	retval = (ssize_t)send(handle->data.net.sock, (SEND_TYPE)buf, (SEND_LEN_TYPE)*write_len, flags);
+#endif
 	if (retval == 0) {
 		handle->data.net.last_error = M_IO_ERROR_DISCONNECT;
 		err = M_IO_ERROR_DISCONNECT;
@@ -1570,6 +1682,137 @@ M_bool M_io_net_set_nagle(M_io_t *io, M_bool nagle_enabled)
 }
 
 
+M_bool M_io_net_ktls_enable(M_io_t *io, M_bool is_send, const void *crypto_info, size_t crypto_info_len)
+{
+	M_io_layer_t  *layer  = M_io_layer_acquire(io, 0, "NET");
+	M_io_handle_t *handle = M_io_layer_get_handle(layer);
+	M_bool         ret    = M_FALSE;
+
+	if (layer == NULL || handle == NULL)
+		return M_FALSE;
+
+	if (handle->is_netdns) {
+		if (handle->data.netdns.io != NULL)
+			ret = M_io_net_ktls_enable(handle->data.netdns.io, is_send, crypto_info, crypto_info_len);
+		M_io_layer_release(layer);
+		return ret;
+	}
+
+#ifdef M_IO_NET_KTLS
+	if (crypto_info != NULL && crypto_info_len != 0 && handle->state == M_IO_NET_STATE_CONNECTED && M_io_get_type(io) == M_IO_TYPE_STREAM) {
+		/* The upper layer protocol is attached once, the second direction gets EEXIST. Fails
+		 * with ENOENT if the kernel doesn't have TLS support. */
+		if (setsockopt(handle->data.net.sock, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0 || errno == EEXIST) {
+			/* Fails if the kernel doesn't support the cipher. */
+			if (setsockopt(handle->data.net.sock, SOL_TLS, is_send?TLS_TX:TLS_RX, crypto_info, (socklen_t)crypto_info_len) == 0) {
+				if (is_send) {
+					handle->data.net.ktls_send = M_TRUE;
+				} else {
+					handle->data.net.ktls_recv = M_TRUE;
+				}
+				ret = M_TRUE;
+			}
+		}
+	}
+#else
+	(void)is_send;
+	(void)crypto_info;
+	(void)crypto_info_len;
+#endif
+
+	M_io_layer_release(layer);
+	return ret;
+}
+
+
+M_bool M_io_net_ktls_set_record_type(M_io_t *io, unsigned char record_type)
+{
+	M_io_layer_t  *layer  = M_io_layer_acquire(io, 0, "NET");
+	M_io_handle_t *handle = M_io_layer_get_handle(layer);
+	M_bool         ret    = M_FALSE;
+
+	if (layer == NULL || handle == NULL)
+		return M_FALSE;
+
+	if (handle->is_netdns) {
+		if (handle->data.netdns.io != NULL)
+			ret = M_io_net_ktls_set_record_type(handle->data.netdns.io, record_type);
+	} else if (handle->data.net.ktls_send) {
+		handle->data.net.ktls_rectype = record_type;
+		ret                           = M_TRUE;
+	}
+
+	M_io_layer_release(layer);
+	return ret;
+}
+
+
+M_io_error_t M_io_net_sendfile(M_io_t *io, int fd, M_uint64 offset, size_t len, size_t *len_written)
+{
+	M_io_layer_t  *layer;
+	M_io_handle_t *handle;
+	M_io_error_t   err    = M_IO_ERROR_NOTIMPL;
+
+	if (len_written != NULL)
+		*len_written = 0;
+
+	if (io == NULL || fd < 0 || len == 0 || len_written == NULL)
+		return M_IO_ERROR_INVALID;
+
+	layer  = M_io_layer_acquire(io, 0, "NET");
+	handle = M_io_layer_get_handle(layer);
+	if (layer == NULL || handle == NULL)
+		return M_IO_ERROR_INVALID;
+
+	if (handle->is_netdns) {
+		err = M_IO_ERROR_NOTCONNECTED;
+		if (handle->data.netdns.io != NULL)
+			err = M_io_net_sendfile(handle->data.netdns.io, fd, offset, len, len_written);
+		M_io_layer_release(layer);
+		return err;
+	}
+
+	if (handle->state != M_IO_NET_STATE_CONNECTED || handle->data.net.ktls_rectype != 0) {
+		M_io_layer_release(layer);
+		return M_IO_ERROR_NOTCONNECTED;
+	}
+
+#ifdef __linux__
+	{
+		off_t                      off = (off_t)offset;
+		ssize_t                    retval;
+		M_io_posix_sigpipe_state_t sigpipe_state;
+
+		/* sendfile() has no MSG_NOSIGNAL equivalent */
+		M_io_posix_sigpipe_block(&sigpipe_state);
+		errno  = 0;
+		retval = sendfile(handle->data.net.sock, fd, &off, len);
+		M_io_posix_sigpipe_unblock(&sigpipe_state);
+
+		if (retval == 0) {
+			/* Offset is at or past the end of the file */
+			err = M_IO_ERROR_INVALID;
+		} else {
+			if (retval < 0) {
+				M_io_net_resolve_error(handle);
+				err = handle->data.net.last_error;
+			} else {
+				*len_written = (size_t)retval;
+				err          = M_IO_ERROR_SUCCESS;
+			}
+			M_io_net_readwrite_err(io, layer, M_FALSE, err, len, *len_written);
+		}
+	}
+#else
+	(void)fd;
+	(void)offset;
+#endif
+
+	M_io_layer_release(layer);
+	return err;
+}
+
+
 M_bool M_io_net_set_connect_timeout_ms(M_io_t *io, M_uint64 timeout_ms)
 {
 	M_io_layer_t  *layer  = M_io_layer_acquire(io, 0, "NET");
@@ -64,6 +64,9 @@ struct M_io_handle_net {
 	int                  last_error_sys; /*!< Last recorded system error                                     */
 #endif
 	M_io_error_t         last_error;     /*!< Last recorded error mapped                                     */
+	M_bool               ktls_send;      /*!< Kernel TLS encrypts data written                               */
+	M_bool               ktls_recv;      /*!< Kernel TLS decrypts data read, reads are returned as records   */
+	unsigned char        ktls_rectype;   /*!< Record type to send non application data writes as (0 = none) */
 };
 
 struct M_io_handle_netdns {
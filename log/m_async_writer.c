@@ -33,6 +33,15 @@ typedef enum {
 	M_ASYNC_WRITER_DESTROYING              /* Destroying the writer. */
 } writer_state_t;
 
+/* Queued message. Either finished message text, or data that's rendered into text by the worker thread. */
+typedef struct {
+	char                      *text;
+	void                      *data;
+	M_async_render_cb_t        render_cb;
+	M_async_data_destroy_cb_t  destroy_cb;
+	size_t                     len;         /* number of bytes counted against max_bytes. */
+} writer_msg_t;
+
 struct M_async_writer {
 	/* Set once per create, or on explicit function call. */
 	size_t              max_bytes;     /* maximum number of text bytes allowed in queue (does not include overhead). */
@@ -52,7 +61,7 @@ struct M_async_writer {
 	M_thread_cond_t    *cond_alive;     /* when triggered, indicates that the internal thread is still alive. */
 
 	/* Reset on start. */
-	M_llist_str_t      *msgs;
+	M_llist_t          *msgs;          /* writer_msg_t, newest first. */
 	size_t              stored_bytes;  /* current number of text bytes stored in queue (does not include overhead). */
 	M_uint64            num_dropped;   /* number of messages that have been dropped since last call to pop(). */
 
@@ -65,6 +74,38 @@ struct M_async_writer {
 } /* typedef'd as M_async_writer_t in header. */;
 
 
+static void writer_msg_destroy(void *arg)
+{
+	writer_msg_t *wmsg = arg;
+
+	if (wmsg == NULL) {
+		return;
+	}
+
+	if (wmsg->data != NULL && wmsg->destroy_cb != NULL) {
+		wmsg->destroy_cb(wmsg->data);
+	}
+	M_free(wmsg->text);
+	M_free(wmsg);
+}
+
+
+/* Turn deferred data into message text. Called by the worker thread, without the lock held. */
+static void writer_msg_render(writer_msg_t *wmsg)
+{
+	if (wmsg->data == NULL) {
+		return;
+	}
+
+	wmsg->text = wmsg->render_cb(wmsg->data);
+	wmsg->len  = M_str_len(wmsg->text);
+	if (wmsg->destroy_cb != NULL) {
+		wmsg->destroy_cb(wmsg->data);
+	}
+	wmsg->data = NULL;
+}
+
+
 static void destroy_int(M_async_writer_t *writer)
 {
 	if (writer->destroy_cb != NULL) {
@@ -77,7 +118,7 @@ static void destroy_int(M_async_writer_t *writer)
 	M_thread_cond_destroy(writer->cond_done);
 	M_thread_cond_destroy(writer->cond_alive);
 
-	M_llist_str_destroy(writer->msgs);
+	M_llist_destroy(writer->msgs, M_TRUE);
 
 	M_free(writer);
 }
@@ -101,9 +142,9 @@ static M_bool in_flush(M_async_writer_t *writer)
  *
  * If this method returns NULL and sets cmd to 0, it means that we've received a stop request.
  */
-static char *pop_one(M_async_writer_t *writer, M_uint64 *num_dropped, M_uint64 *cmd)
+static writer_msg_t *pop_one(M_async_writer_t *writer, M_uint64 *num_dropped, M_uint64 *cmd)
 {
-	char *ret;
+	writer_msg_t *ret;
 
 	if (writer == NULL || cmd == NULL) {
 		return NULL;
@@ -122,7 +163,7 @@ static char *pop_one(M_async_writer_t *writer, M_uint64 *num_dropped, M_uint64 *
 	 *   (2) A stop or destroy request has been received.
 	 *   (3) A write command has been set, and force_command is true.
 	 */
-	while (M_llist_str_len(writer->msgs) == 0 && writer->state == M_ASYNC_WRITER_RUNNING
+	while (M_llist_len(writer->msgs) == 0 && writer->state == M_ASYNC_WRITER_RUNNING
 		&& (!writer->force_command || writer->write_command == 0)) {
 		M_thread_cond_wait(writer->cond_updated, writer->lock);
 
@@ -134,7 +175,7 @@ static char *pop_one(M_async_writer_t *writer, M_uint64 *num_dropped, M_uint64 *
 	}
 
 	if (writer->state == M_ASYNC_WRITER_DESTROYING || writer->state == M_ASYNC_WRITER_STOPPED
-		|| (in_flush(writer) && M_llist_str_len(writer->msgs) == 0)) {
+		|| (in_flush(writer) && M_llist_len(writer->msgs) == 0)) {
 		if (num_dropped != NULL) {
 			if (writer->state == M_ASYNC_WRITER_STOPPED) {
 				/* If we're not destroying the writer, just leave number of dropped messages in writer. They can be
@@ -143,7 +184,7 @@ static char *pop_one(M_async_writer_t *writer, M_uint64 *num_dropped, M_uint64 *
 				*num_dropped = 0;
 			} else {
 				/* When exiting, include messages left in queue in number of dropped messages reported to caller. */
-				*num_dropped = writer->num_dropped + M_llist_str_len(writer->msgs);
+				*num_dropped = writer->num_dropped + M_llist_len(writer->msgs);
 			}
 		}
 		M_thread_mutex_unlock(writer->lock);
@@ -152,9 +193,9 @@ static char *pop_one(M_async_writer_t *writer, M_uint64 *num_dropped, M_uint64 *
 		return NULL;
 	}
 
-	if (M_llist_str_len(writer->msgs) > 0) {
-		ret = M_llist_str_take_node(M_llist_str_last(writer->msgs));
-		writer->stored_bytes -= M_str_len(ret);
+	if (M_llist_len(writer->msgs) > 0) {
+		ret = M_llist_take_node(M_llist_last(writer->msgs));
+		writer->stored_bytes -= ret->len;
 
 		/* Report number of dropped messages to caller, then reset the drop counter. */
 		if (num_dropped != NULL) {
@@ -177,26 +218,30 @@ static char *pop_one(M_async_writer_t *writer, M_uint64 *num_dropped, M_uint64 *
 /* If we popped a message, but then failed to write it, use this to add it back onto the back end of the queue,
  * and update the number of dropped messages accordingly.
  */
-static void replace_one(M_async_writer_t *writer, char *msg, M_uint64 num_dropped)
+static void replace_one(M_async_writer_t *writer, writer_msg_t *msg, M_uint64 num_dropped)
 {
-	size_t msg_len = M_str_len(msg);
-
-	if (writer == NULL || msg_len == 0) {
+	if (writer == NULL || msg->len == 0) {
+		writer_msg_destroy(msg);
 		return;
 	}
 
 	M_thread_mutex_lock(writer->lock);
 
-	if (writer->num_dropped == 0 && writer->stored_bytes + msg_len <= writer->max_bytes) {
+	if (writer->num_dropped == 0 && writer->stored_bytes + msg->len <= writer->max_bytes) {
 		/* If no newer messages have been dropped in the time since we tried to write the old message,
 		 * and if we have room to add the old message back onto the tail end of the buffer:
 		 */
-		M_llist_str_insert_after(M_llist_str_last(writer->msgs), msg);
-		writer->stored_bytes += msg_len;
+		if (M_llist_len(writer->msgs) == 0) {
+			M_llist_insert(writer->msgs, msg);
+		} else {
+			M_llist_insert_after(M_llist_last(writer->msgs), msg);
+		}
+		writer->stored_bytes += msg->len;
 	} else {
 		/* If newer messages have been dropped, or if the old message won't fit in the queue,
 		 * just drop the old message.
 		 */
+		writer_msg_destroy(msg);
 		writer->num_dropped++;
 	}
 
@@ -214,9 +259,10 @@ static void *write_thread(void *arg)
 	M_bool            destroying;
 
 	while (M_TRUE) {
-		char     *msg;
-		M_uint64  cmd          = 0;
-		M_bool    msg_consumed = M_TRUE;
+		writer_msg_t *wmsg;
+		char         *msg          = NULL;
+		M_uint64      cmd          = 0;
+		M_bool        msg_consumed = M_TRUE;
 
 		/* Wait until at least one message is available, then pop the oldest one from the queue.
 		 *
@@ -224,7 +270,13 @@ static void *write_thread(void *arg)
 		 * counter to zero.
 		 */
 		num_dropped = 0;
-		msg         = pop_one(writer, &num_dropped, &cmd);
+		wmsg        = pop_one(writer, &num_dropped, &cmd);
+
+		/* Deferred messages are rendered here, outside of the lock, so producers aren't held up by it. */
+		if (wmsg != NULL) {
+			writer_msg_render(wmsg);
+			msg = wmsg->text;
+		}
 
 		/* If any messages were dropped, write a message about it. Do this before exit check so that we
 		 * can report any remaining messages in queue as dropped on exit.
@@ -232,12 +284,12 @@ static void *write_thread(void *arg)
 		if (num_dropped > 0) {
 			char tmp[128];
 			M_snprintf(tmp, sizeof(tmp), "%llu messages were dropped (%s)%s", num_dropped,
-				(msg == NULL && cmd == 0)? "log shutdown" : "buffer full", writer->line_end);
+				(wmsg == NULL && cmd == 0)? "log shutdown" : "buffer full", writer->line_end);
 			msg_consumed = writer->write_cb(tmp, 0, writer->write_thunk);
 		}
 
 		/* NULL message and 0 command indicates that message queue wants us to stop processing. */
-		if (msg == NULL && cmd == 0) {
+		if (wmsg == NULL && cmd == 0) {
 			break;
 		}
 
@@ -247,7 +299,7 @@ static void *write_thread(void *arg)
 		 * If we already tried sending a drop message and it wasn't accepted, don't bother trying to send
 		 * a message again.
 		 */
-		if (msg_consumed) {
+		if (msg_consumed && (msg != NULL || cmd != 0)) {
 			msg_consumed = writer->write_cb(msg, cmd, writer->write_thunk);
 			/* If a command was set, signal that it's done (in case anyone is blocking on it). */
 			if (cmd != 0) {
@@ -261,11 +313,11 @@ static void *write_thread(void *arg)
 		/* If either the drop message wasn't accepted, or the main message wasn't accepted, replace the
 		 * message on the queue and correct the number of dropped messages.
 		 */
-		if (!msg_consumed && msg != NULL) {
-			replace_one(writer, msg, num_dropped);
+		if (!msg_consumed && wmsg != NULL) {
+			replace_one(writer, wmsg, num_dropped);
+		} else {
+			writer_msg_destroy(wmsg);
 		}
-
-		M_free(msg);
 	}
 
 	/* Set flag and notify any listening threads that the internal thread has finished. */
@@ -303,7 +355,8 @@ M_async_writer_t *M_async_writer_create(size_t max_bytes, M_async_write_cb_t wri
 	void *write_thunk, M_async_thunk_stop_cb_t stop_cb, M_async_thunk_destroy_cb_t destroy_cb,
 	M_async_writer_line_end_mode_t mode)
 {
-	M_async_writer_t *writer;
+	struct M_llist_callbacks  cbs = { NULL, NULL, NULL, writer_msg_destroy };
+	M_async_writer_t         *writer;
 
 	if (write_cb == NULL) {
 		return NULL;
@@ -324,7 +377,7 @@ M_async_writer_t *M_async_writer_create(size_t max_bytes, M_async_write_cb_t wri
 	writer->state          = M_ASYNC_WRITER_STOPPED;
 	writer->command_done   = M_TRUE;
 
-	writer->msgs = M_llist_str_create(M_LLIST_STR_NONE);
+	writer->msgs = M_llist_create(&cbs, M_LLIST_NONE);
 
 	switch(mode) {
 		case M_LOG_LINE_END_WINDOWS:
@@ -622,17 +675,10 @@ void M_async_writer_set_max_bytes(M_async_writer_t *writer, size_t max_bytes)
 }
 
 
-M_bool M_async_writer_write(M_async_writer_t *writer, const char *msg)
+/* Add message to queue, dropping older messages if needed. Takes ownership of wmsg. */
+static M_bool write_int(M_async_writer_t *writer, writer_msg_t *wmsg)
 {
 	M_bool msg_added = M_FALSE;
-	size_t msg_len;
-
-	msg_len = M_str_len(msg);
-
-	/* If queue is not allocated, or if message is zero length, ignore the message completely. */
-	if (writer == NULL || msg_len == 0) {
-		return M_FALSE;
-	}
 
 	M_thread_mutex_lock(writer->lock);
 
@@ -644,7 +690,7 @@ M_bool M_async_writer_write(M_async_writer_t *writer, const char *msg)
 	/* If the message itself is too big to fit in the queue, drop it without wiping out the existing contents
 	 * of the queue.
 	 */
-	if (msg_len > writer->max_bytes) {
+	if (wmsg->len > writer->max_bytes) {
 		if (writer->num_dropped < M_UINT64_MAX) {
 			writer->num_dropped++;
 		}
@@ -652,7 +698,7 @@ M_bool M_async_writer_write(M_async_writer_t *writer, const char *msg)
 	}
 
 	/* Insert message into queue. If insertion failed, drop the message. */
-	if (M_llist_str_insert_first(writer->msgs, msg) == NULL) {
+	if (M_llist_insert_first(writer->msgs, wmsg) == NULL) {
 		if (writer->num_dropped < M_UINT64_MAX) {
 			writer->num_dropped++;
 		}
@@ -662,16 +708,14 @@ M_bool M_async_writer_write(M_async_writer_t *writer, const char *msg)
 	msg_added = M_TRUE;
 
 	/* If adding the new message will exceed our queue size limit, drop oldest messages until we have room. */
-	writer->stored_bytes += msg_len;
+	writer->stored_bytes += wmsg->len;
 	while (writer->stored_bytes > writer->max_bytes) {
-		char   *old;
-		size_t  old_len;
+		writer_msg_t *old;
 
-		old     = M_llist_str_take_node(M_llist_str_last(writer->msgs));
-		old_len = M_str_len(old);
-		M_free(old);
+		old = M_llist_take_node(M_llist_last(writer->msgs));
+		writer->stored_bytes -= old->len;
+		writer_msg_destroy(old);
 
-		writer->stored_bytes -= old_len;
 		if (writer->num_dropped < M_UINT64_MAX) {
 			writer->num_dropped++;
 		}
@@ -680,12 +724,61 @@ M_bool M_async_writer_write(M_async_writer_t *writer, const char *msg)
 	done:
 	if (msg_added) {
 		M_thread_cond_broadcast(writer->cond_updated);
+	} else {
+		writer_msg_destroy(wmsg);
 	}
 	M_thread_mutex_unlock(writer->lock);
 	return msg_added;
 }
 
 
+M_bool M_async_writer_write(M_async_writer_t *writer, const char *msg)
+{
+	writer_msg_t *wmsg;
+	size_t        msg_len;
+
+	msg_len = M_str_len(msg);
+
+	/* If queue is not allocated, or if message is zero length, ignore the message completely. */
+	if (writer == NULL || msg_len == 0) {
+		return M_FALSE;
+	}
+
+	wmsg       = M_malloc_zero(sizeof(*wmsg));
+	wmsg->text = M_strdup(msg);
+	wmsg->len  = msg_len;
+
+	return write_int(writer, wmsg);
+}
+
+
+M_bool M_async_writer_write_deferred(M_async_writer_t *writer, void *data, size_t data_len,
+	M_async_render_cb_t render_cb, M_async_data_destroy_cb_t destroy_cb)
+{
+	writer_msg_t *wmsg;
+
+	if (data == NULL) {
+		return M_FALSE;
+	}
+
+	/* Writer owns the data from here on, even if we don't queue it. */
+	if (writer == NULL || render_cb == NULL || data_len == 0) {
+		if (destroy_cb != NULL) {
+			destroy_cb(data);
+		}
+		return M_FALSE;
+	}
+
+	wmsg             = M_malloc_zero(sizeof(*wmsg));
+	wmsg->data       = data;
+	wmsg->render_cb  = render_cb;
+	wmsg->destroy_cb = destroy_cb;
+	wmsg->len        = data_len;
+
+	return write_int(writer, wmsg);
+}
+
+
 void *M_async_writer_get_thunk(M_async_writer_t *writer)
 {
 	if (writer == NULL) {
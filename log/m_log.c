@@ -124,13 +124,12 @@ static void log_module_destroy(void *modptr)
  *
  * TODO: update M_time_to_str() to provide the functionality we need for this (will need to support useconds)
  */
-static char *get_current_time_str(const char *time_format, size_t *out_len)
+char *log_time_str(const char *time_format, const M_timeval_t *tv, size_t *out_len)
 {
 	static const char *days_of_week[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
 	static const char *months_of_year[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul",
 		"Aug", "Sep", "Oct", "Nov", "Dec" };
 
-	M_timeval_t       tv;
 	M_time_localtm_t  ltime;
 	M_int64           abs_gmtoff;
 	M_buf_t          *buf;
@@ -141,17 +140,14 @@ static char *get_current_time_str(const char *time_format, size_t *out_len)
 		*out_len = 0;
 	}
 
-	if (M_str_isempty(time_format)) {
+	if (M_str_isempty(time_format) || tv == NULL) {
 		return NULL;
 	}
 
 	fmt_len = M_str_len(time_format);
 	buf     = M_buf_create();
 
-	/* Get current time. Use gettimeofday so we have access to microseconds. */
-	M_mem_set(&tv, 0, sizeof(tv));
-	M_time_gettimeofday(&tv);
-	M_time_tolocal(tv.tv_sec, &ltime, NULL);
+	M_time_tolocal(tv->tv_sec, &ltime, NULL);
 
 	abs_gmtoff = M_ABS(ltime.gmtoff);
 
@@ -163,7 +159,7 @@ static char *get_current_time_str(const char *time_format, size_t *out_len)
 		i++;
 		switch(time_format[i]) {
 			case 't': /* Unix timestamp */
-				M_buf_add_int(buf, tv.tv_sec);
+				M_buf_add_int(buf, tv->tv_sec);
 				break;
 			case 'M': /* Month (2-digit) */
 				M_buf_add_int_just(buf, ltime.month, 2);
@@ -193,10 +189,10 @@ static char *get_current_time_str(const char *time_format, size_t *out_len)
 				M_buf_add_int_just(buf, ltime.sec, 2);
 				break;
 			case 'l': /* Millisecond (3-digit) */
-				M_buf_add_int_just(buf, tv.tv_usec / 1000, 3);
+				M_buf_add_int_just(buf, tv->tv_usec / 1000, 3);
 				break;
 			case 'u': /* Microsecond (6-digit) */
-				M_buf_add_int_just(buf, tv.tv_usec, 6);
+				M_buf_add_int_just(buf, tv->tv_usec, 6);
 				break;
 			case 'z': /* Timezone offset (no colon) */
 				M_buf_add_char(buf, (ltime.gmtoff > 0)? '+' : '-');
@@ -224,6 +220,48 @@ static char *get_current_time_str(const char *time_format, size_t *out_len)
 }
 
 
+static char *get_current_time_str(const char *time_format, size_t *out_len)
+{
+	M_timeval_t tv;
+
+	/* Get current time. Use gettimeofday so we have access to microseconds. */
+	M_mem_set(&tv, 0, sizeof(tv));
+	M_time_gettimeofday(&tv);
+
+	return log_time_str(time_format, &tv, out_len);
+}
+
+
+void log_add_line_prefix_locked(M_log_t *log, M_buf_t *buf, const char *time_str, size_t time_str_len, M_uint64 tag,
+	void *msg_thunk, M_bool use_prefix_cb)
+{
+	const char *name_str;
+	size_t      name_str_len;
+
+	/* Time string. */
+	M_buf_add_bytes(buf, time_str, time_str_len);
+
+	/* Tag name. */
+	name_str     = M_hash_u64str_get_direct(log->tag_to_name, tag);
+	name_str_len = M_str_len(name_str);
+	if (name_str_len > 0) {
+		M_buf_add_str(buf, " [");
+		M_buf_add_bytes(buf, name_str, name_str_len);
+		M_buf_add_str(buf, "]");
+		if (log->pad_names && name_str_len < log->max_name_width) {
+			M_buf_add_fill(buf, ' ', log->max_name_width - name_str_len);
+		}
+	}
+
+	/* Prefix */
+	if (log->prefix_cb == NULL || !use_prefix_cb) {
+		M_buf_add_str(buf, ": ");
+	} else {
+		log->prefix_cb(buf, tag, log->prefix_thunk, msg_thunk);
+	}
+}
+
+
 /* ---- PUBLIC: tag list helpers ---- */
 
 M_uint64 M_log_all_tags_lt(M_uint64 tag)
@@ -284,6 +322,8 @@ const char *M_log_err_to_str(M_log_error_t err)
 			return "module-specific function was run on the wrong module";
 		case M_LOG_GENERIC_FAIL:
 			return "internal error";
+		case M_LOG_INVALID_FORMAT:
+			return "binary log format string is invalid, or format ID hasn't been registered";
 	}
 	return "unknown";
 }
@@ -317,6 +357,7 @@ void M_log_destroy(M_log_t *log)
 	M_thread_rwlock_destroy(log->rwlock);
 	M_hash_u64str_destroy(log->tag_to_name);
 	M_hash_multi_destroy(log->name_to_tag);
+	M_hash_u64vp_destroy(log->binary_formats, M_TRUE);
 
 	if (log->prefix_thunk && log->destroy_prefix_thunk_cb)
 		log->destroy_prefix_thunk_cb(log->prefix_thunk);
@@ -583,6 +624,36 @@ M_log_error_t M_log_vprintf(M_log_t *log, M_uint64 tag, void *msg_thunk, const c
 }
 
 
+/* Remove modules that have become invalid. Log must not be locked. */
+static void purge_expired_modules(M_log_t *log)
+{
+	M_llist_node_t *node;
+
+	M_thread_rwlock_lock(log->rwlock, M_THREAD_RWLOCK_TYPE_WRITE);
+
+	node = M_llist_first(log->modules);
+	while (node != NULL) {
+		M_llist_node_t *curr;
+		M_log_module_t *mod;
+
+		curr = node;
+		mod  = M_llist_node_val(curr);
+		node = M_llist_node_next(curr);
+
+		if (mod->module_check_cb != NULL && !mod->module_check_cb(mod)) {
+			/* Remove fom log without deleting module, add module to list of expired modules. */
+			mod = M_llist_take_node(curr);
+			if (mod != NULL && mod->module_expire_cb != NULL) {
+				mod->module_expire_cb(mod, mod->module_expire_thunk);
+			}
+			/* Destroy the module. */
+			log_module_destroy(mod);
+		}
+	}
+	M_thread_rwlock_unlock(log->rwlock);
+}
+
+
 M_log_error_t M_log_write(M_log_t *log, M_uint64 tag, void *msg_thunk, const char *msg)
 {
 	M_log_error_t   ret              = M_LOG_SUCCESS;
@@ -590,8 +661,6 @@ M_log_error_t M_log_write(M_log_t *log, M_uint64 tag, void *msg_thunk, const cha
 	M_buf_t        *buf              = NULL;
 	char           *time_str         = NULL;
 	size_t          time_str_len     = 0;
-	const char     *name_str         = NULL;
-	size_t          name_str_len     = 0;
 	const char     *line_start       = NULL;
 	M_bool          has_expired_mods = M_FALSE;
 
@@ -619,10 +688,6 @@ M_log_error_t M_log_write(M_log_t *log, M_uint64 tag, void *msg_thunk, const cha
 		goto done;
 	}
 
-	/* Get tag name (if any). */
-	name_str     = M_hash_u64str_get_direct(log->tag_to_name, tag);
-	name_str_len = M_str_len(name_str);
-
 	/* Loop over each line of log message. */
 	line_start = msg;
 	buf        = M_buf_create();
@@ -637,25 +702,8 @@ M_log_error_t M_log_write(M_log_t *log, M_uint64 tag, void *msg_thunk, const cha
 		/* Clear out old contents of buffer. */
 		M_buf_truncate(buf, 0);
 
-		/* Time string. */
-		M_buf_add_bytes(buf, time_str, time_str_len);
-
-		/* Tag name. */
-		if (name_str_len > 0) {
-			M_buf_add_str(buf, " [");
-			M_buf_add_bytes(buf, name_str, name_str_len);
-			M_buf_add_str(buf, "]");
-			if (log->pad_names && name_str_len < log->max_name_width) {
-				M_buf_add_fill(buf, ' ', log->max_name_width - name_str_len);
-			}
-		}
-
-		/* Prefix */
-		if (log->prefix_cb == NULL) {
-			M_buf_add_str(buf, ": ");
-		} else {
-			log->prefix_cb(buf, tag, log->prefix_thunk, msg_thunk);
-		}
+		/* Time string, tag name and prefix. */
+		log_add_line_prefix_locked(log, buf, time_str, time_str_len, tag, msg_thunk, M_TRUE);
 
 		/* Current line of message. */
 		M_buf_add_bytes(buf, line_start, line_len);
@@ -712,34 +760,113 @@ done:
 
 	/* Clean up any expired modules. */
 	if (has_expired_mods) {
-		M_thread_rwlock_lock(log->rwlock, M_THREAD_RWLOCK_TYPE_WRITE);
+		purge_expired_modules(log);
+	}
 
-		node = M_llist_first(log->modules);
-		while (node != NULL) {
-			M_llist_node_t *curr;
-			M_log_module_t *mod;
+	return ret;
+}
 
-			curr = node;
-			mod  = M_llist_node_val(curr);
-			node = M_llist_node_next(curr);
 
-			if (mod->module_check_cb != NULL && !mod->module_check_cb(mod)) {
-				/* Remove fom log without deleting module, add module to list of expired modules. */
-				mod = M_llist_take_node(curr);
-				if (mod != NULL && mod->module_expire_cb != NULL) {
-					mod->module_expire_cb(mod, mod->module_expire_thunk);
-				}
-				/* Destroy the module. */
-				log_module_destroy(mod);
-			}
-		}
-		M_thread_rwlock_unlock(log->rwlock);
-	}
+M_log_error_t M_log_binary_printf(M_log_t *log, M_uint64 tag, void *msg_thunk, M_uint32 fmt_id, ...)
+{
+	M_log_error_t ret;
+	va_list       ap;
+
+	va_start(ap, fmt_id);
+	ret = M_log_binary_vprintf(log, tag, msg_thunk, fmt_id, ap);
+	va_end(ap);
 
 	return ret;
 }
 
 
+M_log_error_t M_log_binary_vprintf(M_log_t *log, M_uint64 tag, void *msg_thunk, M_uint32 fmt_id, va_list ap)
+{
+	log_binary_fmt_t     *fmt;
+	log_binary_msg_t     *msg;
+	const unsigned char  *rec;
+	size_t                rec_len;
+	M_llist_node_t       *node;
+	M_list_str_t         *lines            = NULL;
+	M_bool                has_expired_mods = M_FALSE;
+
+	if (log == NULL || fmt_id == M_LOG_BINARY_FORMAT_TEXT) {
+		return M_LOG_INVALID_PARAMS;
+	}
+
+	if (!M_uint64_is_power_of_two(tag)) {
+		return M_LOG_INVALID_TAG;
+	}
+
+	M_thread_rwlock_lock(log->rwlock, M_THREAD_RWLOCK_TYPE_READ);
+
+	/* Same early-out as M_log_vprintf(), nothing is captured for tags no module is listening to. */
+	if (!M_log_check_tag_used(log, tag)) {
+		M_thread_rwlock_unlock(log->rwlock);
+		return M_LOG_SUCCESS;
+	}
+
+	fmt = M_hash_u64vp_get_direct(log->binary_formats, fmt_id);
+	if (fmt == NULL) {
+		M_thread_rwlock_unlock(log->rwlock);
+		return M_LOG_INVALID_FORMAT;
+	}
+
+	/* Capture the raw arguments, formatting is deferred until something actually needs text. */
+	msg = log_binary_msg_create_locked(log, fmt, fmt_id, tag, msg_thunk, ap);
+	rec = log_binary_msg_record(msg, &rec_len);
+
+	node = M_llist_first(log->modules);
+	while (node != NULL) {
+		M_log_module_t *mod = M_llist_node_val(node);
+		size_t          i;
+
+		node = M_llist_node_next(node);
+
+		if ((mod->accepted_tags & tag) == 0 || mod->module_write_cb == NULL) {
+			continue;
+		}
+
+		if (mod->module_check_cb != NULL && !mod->module_check_cb(mod)) {
+			has_expired_mods = M_TRUE;
+			continue;
+		}
+
+		if (mod->filter_cb != NULL && !mod->filter_cb(tag, mod->filter_thunk, msg_thunk)) {
+			continue;
+		}
+
+		/* Modules that store records, or that format on their own writer thread. */
+		if (mod->module_write_binary_cb != NULL) {
+			mod->module_write_binary_cb(mod, rec, rec_len, tag);
+			continue;
+		}
+		if (mod->module_write_deferred_cb != NULL) {
+			mod->module_write_deferred_cb(mod, msg, tag);
+			continue;
+		}
+
+		/* Everything else gets text lines, formatted once and shared between modules. */
+		if (lines == NULL) {
+			lines = log_binary_msg_lines(msg);
+		}
+		for (i=0; i<M_list_str_len(lines); i++) {
+			mod->module_write_cb(mod, M_list_str_at(lines, i), tag);
+		}
+	}
+
+	M_thread_rwlock_unlock(log->rwlock);
+
+	M_list_str_destroy(lines);
+	log_binary_msg_release(msg);
+
+	if (has_expired_mods) {
+		purge_expired_modules(log);
+	}
+
+	return M_LOG_SUCCESS;
+}
+
 void M_log_emergency(M_log_t *log, const char *msg)
 {
 	/* NOTE: this is an emergency method, intended to be called from a signal handler as a last-gasp
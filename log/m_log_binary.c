@@ -0,0 +1,957 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Implementation of binary (deferred formatting) log records.
+ *
+ * Record layout (native byte order, records are meant to be decoded on the same architecture):
+ *
+ *   M_uint32 rec_len   total length of the record, including this header
+ *   M_uint32 fmt_id    format ID passed to M_log_binary_register_format(), or M_LOG_BINARY_FORMAT_TEXT
+ *   M_uint64 tag       tag the message was logged with
+ *   M_int64  tv_sec    time the message was logged
+ *   M_int64  tv_usec
+ *   ...      args      one entry per argument consumed by the format string:
+ *                        - integers, characters, pointers and '*' widths: 8 bytes (M_int64 / M_uint64)
+ *                        - floating point: 8 bytes (double)
+ *                        - strings: M_uint32 length, followed by the string bytes (no NULL terminator). A NULL
+ *                          string is stored as length LOG_BINARY_STR_NULL with no bytes.
+ */
+#include "m_config.h"
+#include <m_log_int.h>
+
+#define LOG_BINARY_HDR_LEN    32
+#define LOG_BINARY_MAX_FLAGS  8
+#define LOG_BINARY_STR_NULL   M_UINT32_MAX /* String length used for a NULL string, decoded as "<NULL>". */
+
+
+typedef enum {
+	LOG_BINARY_TYPE_INT = 0,
+	LOG_BINARY_TYPE_SHORT,
+	LOG_BINARY_TYPE_CHAR,
+	LOG_BINARY_TYPE_LONG,
+	LOG_BINARY_TYPE_LONGLONG,
+	LOG_BINARY_TYPE_SIZET,
+	LOG_BINARY_TYPE_VOIDP,
+	LOG_BINARY_TYPE_DOUBLE,
+	LOG_BINARY_TYPE_STR
+} log_binary_type_t;
+
+
+/* Piece of a parsed format string: either literal text, or a single conversion specifier. */
+typedef struct {
+	char              *literal;                       /* Literal text (NULL if this is a conversion). */
+	size_t             literal_len;
+
+	char               flags[LOG_BINARY_MAX_FLAGS];   /* '-', '+', '#', '0', ' ' (NULL terminated). */
+	M_bool             width_star;
+	size_t             width;
+	M_bool             have_prec;
+	M_bool             prec_star;
+	size_t             prec;
+	log_binary_type_t  type;
+	M_bool             is_signed;
+	char               conv;                          /* Conversion character used when decoding. */
+} log_binary_piece_t;
+
+
+struct log_binary_fmt {
+	log_binary_piece_t *pieces;
+	size_t              num_pieces;
+	volatile M_uint32   refcnt;     /* Queued messages hold a reference, the format can be replaced while they wait. */
+};
+
+
+struct log_binary_msg {
+	volatile M_uint32   refcnt;
+	log_binary_fmt_t   *fmt;
+	unsigned char      *data;        /* Record, followed by the line prefix and time format (NULL terminated). */
+	size_t              rec_len;
+	const char         *prefix;      /* Points into data. */
+	const char         *time_format; /* Points into data. */
+	const char         *line_end;    /* Static string, see line_end_to_str(). */
+};
+
+
+
+/* ---- PRIVATE: format parsing ---- */
+
+static void fmt_add_literal(M_list_t *pieces, M_buf_t *literal)
+{
+	log_binary_piece_t *piece;
+
+	if (M_buf_len(literal) == 0)
+		return;
+
+	piece              = M_malloc_zero(sizeof(*piece));
+	piece->literal_len = M_buf_len(literal);
+	piece->literal     = M_strdup_max(M_buf_peek(literal), piece->literal_len);
+	M_buf_truncate(literal, 0);
+
+	M_list_insert(pieces, piece);
+}
+
+
+/* Mirrors the control parsing done by M_vbprintf() (m_str_fmt.c), so that we consume exactly the same arguments.
+ * fmt is positioned right after the '%'. Returns number of bytes consumed, or 0 on error.
+ */
+static size_t fmt_parse_control(const char *fmt, log_binary_piece_t *piece)
+{
+	size_t i         = 0;
+	size_t num_flags = 0;
+	M_bool have_len  = M_FALSE;
+
+	piece->type      = LOG_BINARY_TYPE_INT;
+	piece->is_signed = M_FALSE;
+
+	while (fmt[i] == '-' || fmt[i] == '+' || fmt[i] == '#' || fmt[i] == '0' || fmt[i] == ' ') {
+		if (num_flags >= LOG_BINARY_MAX_FLAGS - 1)
+			return 0;
+		piece->flags[num_flags++] = fmt[i];
+		i++;
+	}
+
+	for ( ; fmt[i] != '\0'; i++) {
+		switch (fmt[i]) {
+			case '.':
+				if (have_len)
+					return 0;
+				have_len         = M_TRUE;
+				piece->have_prec = M_TRUE;
+				break;
+
+			case '0': case '1': case '2': case '3': case '4':
+			case '5': case '6': case '7': case '8': case '9':
+				if (have_len) {
+					piece->prec = piece->prec * 10 + (size_t)(fmt[i] - '0');
+				} else {
+					piece->width = piece->width * 10 + (size_t)(fmt[i] - '0');
+				}
+				break;
+
+			case '*':
+				if (have_len) {
+					piece->prec_star = M_TRUE;
+				} else {
+					piece->width_star = M_TRUE;
+				}
+				break;
+
+			case 'h':
+				if (piece->type == LOG_BINARY_TYPE_INT) {
+					piece->type = LOG_BINARY_TYPE_SHORT;
+				} else if (piece->type == LOG_BINARY_TYPE_SHORT) {
+					piece->type = LOG_BINARY_TYPE_CHAR;
+				} else {
+					return 0;
+				}
+				break;
+			case 'l':
+				if (piece->type == LOG_BINARY_TYPE_INT) {
+					piece->type = LOG_BINARY_TYPE_LONG;
+				} else if (piece->type == LOG_BINARY_TYPE_LONG) {
+					piece->type = LOG_BINARY_TYPE_LONGLONG;
+				} else {
+					return 0;
+				}
+				break;
+			case 'I':
+				if (piece->type != LOG_BINARY_TYPE_INT)
+					return 0;
+				if (M_str_eq_max(fmt + i + 1, "64", 2)) {
+					piece->type = LOG_BINARY_TYPE_LONGLONG;
+					i += 2;
+				} else if (M_str_eq_max(fmt + i + 1, "32", 2)) {
+					i += 2;
+				} else {
+					piece->type = LOG_BINARY_TYPE_SIZET;
+				}
+				break;
+			case 'z':
+				if (piece->type != LOG_BINARY_TYPE_INT)
+					return 0;
+				piece->type = LOG_BINARY_TYPE_SIZET;
+				break;
+
+			/* Integers are always decoded as 64-bit values, the value is truncated to the requested
+			 * type when it's captured. */
+			case 'd':
+			case 'i':
+				piece->is_signed = M_TRUE;
+				/* Falls through. */
+			case 'o':
+			case 'O':
+			case 'u':
+			case 'x':
+			case 'X':
+				piece->conv = fmt[i];
+				return i + 1;
+
+			case 'p':
+			case 'P':
+				piece->type = LOG_BINARY_TYPE_VOIDP;
+				piece->conv = fmt[i];
+				return i + 1;
+
+			case 'e':
+			case 'E':
+			case 'f':
+			case 'F':
+			case 'g':
+			case 'G':
+				piece->type = LOG_BINARY_TYPE_DOUBLE;
+				piece->conv = fmt[i];
+				return i + 1;
+
+			case 'c':
+				piece->type      = LOG_BINARY_TYPE_INT;
+				piece->is_signed = M_TRUE;
+				piece->conv      = fmt[i];
+				return i + 1;
+
+			case 's':
+				piece->type = LOG_BINARY_TYPE_STR;
+				piece->conv = fmt[i];
+				return i + 1;
+
+			default:
+				return 0;
+		}
+	}
+
+	/* Hit end of string in the middle of a conversion. */
+	return 0;
+}
+
+
+static void piece_destroy(void *arg)
+{
+	log_binary_piece_t *piece = arg;
+
+	if (piece == NULL)
+		return;
+
+	M_free(piece->literal);
+	M_free(piece);
+}
+
+
+log_binary_fmt_t *log_binary_fmt_create(const char *fmt)
+{
+	struct M_list_callbacks  cbs     = { NULL, NULL, NULL, piece_destroy };
+	log_binary_fmt_t        *bfmt    = NULL;
+	M_list_t                *pieces;
+	M_buf_t                 *literal;
+	size_t                   i;
+
+	if (fmt == NULL)
+		return NULL;
+
+	pieces  = M_list_create(&cbs, M_LIST_NONE);
+	literal = M_buf_create();
+
+	i = 0;
+	while (fmt[i] != '\0') {
+		log_binary_piece_t *piece;
+		size_t              len;
+
+		if (fmt[i] != '%') {
+			M_buf_add_byte(literal, (unsigned char)fmt[i]);
+			i++;
+			continue;
+		}
+		i++;
+
+		/* Escaped percent sign ('%%' --> '%'). */
+		if (fmt[i] == '%') {
+			M_buf_add_byte(literal, '%');
+			i++;
+			continue;
+		}
+
+		fmt_add_literal(pieces, literal);
+
+		piece = M_malloc_zero(sizeof(*piece));
+		len   = fmt_parse_control(fmt + i, piece);
+		if (len == 0) {
+			piece_destroy(piece);
+			goto done;
+		}
+		M_list_insert(pieces, piece);
+		i += len;
+	}
+	fmt_add_literal(pieces, literal);
+
+	/* Flatten into an array, this is walked on every message. */
+	bfmt             = M_malloc_zero(sizeof(*bfmt));
+	bfmt->refcnt     = 1;
+	bfmt->num_pieces = M_list_len(pieces);
+	if (bfmt->num_pieces > 0) {
+		bfmt->pieces = M_malloc_zero(sizeof(*bfmt->pieces) * bfmt->num_pieces);
+	}
+	for (i=0; i<bfmt->num_pieces; i++) {
+		log_binary_piece_t *piece = M_list_take_first(pieces);
+		M_mem_copy(&bfmt->pieces[i], piece, sizeof(*piece));
+		M_free(piece); /* Contents now owned by array. */
+	}
+
+done:
+	M_buf_cancel(literal);
+	M_list_destroy(pieces, M_TRUE);
+	return bfmt;
+}
+
+
+void log_binary_fmt_destroy(void *fmt)
+{
+	log_binary_fmt_t *bfmt = fmt;
+	size_t            i;
+
+	if (bfmt == NULL)
+		return;
+
+	if (M_atomic_dec_u32(&bfmt->refcnt) != 1)
+		return;
+
+	for (i=0; i<bfmt->num_pieces; i++) {
+		M_free(bfmt->pieces[i].literal);
+	}
+	M_free(bfmt->pieces);
+	M_free(bfmt);
+}
+
+
+
+/* ---- PRIVATE: record encoding ---- */
+
+static M_int64 get_signed_arg(log_binary_type_t type, va_list *ap)
+{
+	switch (type) {
+		case LOG_BINARY_TYPE_SHORT:
+			return (short)va_arg(*ap, int);
+		case LOG_BINARY_TYPE_CHAR:
+			return (char)va_arg(*ap, int);
+		case LOG_BINARY_TYPE_LONG:
+			return va_arg(*ap, long);
+		case LOG_BINARY_TYPE_LONGLONG:
+			return va_arg(*ap, M_int64);
+		case LOG_BINARY_TYPE_SIZET:
+			return va_arg(*ap, ssize_t);
+		case LOG_BINARY_TYPE_VOIDP:
+			return (M_int64)(M_intptr)va_arg(*ap, void *);
+		case LOG_BINARY_TYPE_INT:
+		case LOG_BINARY_TYPE_DOUBLE:
+		case LOG_BINARY_TYPE_STR:
+			break;
+	}
+	return va_arg(*ap, int);
+}
+
+
+static M_uint64 get_unsigned_arg(log_binary_type_t type, va_list *ap)
+{
+	switch (type) {
+		case LOG_BINARY_TYPE_SHORT:
+			return (unsigned short)va_arg(*ap, unsigned int);
+		case LOG_BINARY_TYPE_CHAR:
+			return (unsigned char)va_arg(*ap, unsigned int);
+		case LOG_BINARY_TYPE_LONG:
+			return va_arg(*ap, unsigned long);
+		case LOG_BINARY_TYPE_LONGLONG:
+			return va_arg(*ap, M_uint64);
+		case LOG_BINARY_TYPE_SIZET:
+			return va_arg(*ap, size_t);
+		case LOG_BINARY_TYPE_VOIDP:
+			return (M_uint64)(M_uintptr)va_arg(*ap, void *);
+		case LOG_BINARY_TYPE_INT:
+		case LOG_BINARY_TYPE_DOUBLE:
+		case LOG_BINARY_TYPE_STR:
+			break;
+	}
+	return va_arg(*ap, unsigned int);
+}
+
+
+static void record_add_hdr(M_buf_t *buf, M_uint32 rec_len, M_uint32 fmt_id, M_uint64 tag, const M_timeval_t *tv)
+{
+	M_int64 sec  = tv->tv_sec;
+	M_int64 usec = tv->tv_usec;
+
+	M_buf_add_bytes(buf, &rec_len, sizeof(rec_len));
+	M_buf_add_bytes(buf, &fmt_id, sizeof(fmt_id));
+	M_buf_add_bytes(buf, &tag, sizeof(tag));
+	M_buf_add_bytes(buf, &sec, sizeof(sec));
+	M_buf_add_bytes(buf, &usec, sizeof(usec));
+}
+
+
+static void record_add_args(M_buf_t *buf, const log_binary_fmt_t *fmt, va_list *ap)
+{
+	size_t i;
+
+	for (i=0; i<fmt->num_pieces; i++) {
+		const log_binary_piece_t *piece = &fmt->pieces[i];
+		M_int64                   sval;
+		M_uint64                  uval;
+		double                    dval;
+		const char               *str;
+		M_uint32                  str_len;
+
+		if (piece->literal != NULL)
+			continue;
+
+		if (piece->width_star) {
+			sval = va_arg(*ap, int);
+			M_buf_add_bytes(buf, &sval, sizeof(sval));
+		}
+		if (piece->prec_star) {
+			sval = va_arg(*ap, int);
+			M_buf_add_bytes(buf, &sval, sizeof(sval));
+		}
+
+		switch (piece->type) {
+			case LOG_BINARY_TYPE_DOUBLE:
+				dval = va_arg(*ap, double);
+				M_buf_add_bytes(buf, &dval, sizeof(dval));
+				break;
+			case LOG_BINARY_TYPE_STR:
+				str     = va_arg(*ap, const char *);
+				str_len = (str == NULL)? LOG_BINARY_STR_NULL : (M_uint32)M_MIN(M_str_len(str), LOG_BINARY_STR_NULL - 1);
+				M_buf_add_bytes(buf, &str_len, sizeof(str_len));
+				if (str != NULL)
+					M_buf_add_bytes(buf, str, str_len);
+				break;
+			default:
+				if (piece->is_signed) {
+					sval = get_signed_arg(piece->type, ap);
+					M_buf_add_bytes(buf, &sval, sizeof(sval));
+				} else {
+					uval = get_unsigned_arg(piece->type, ap);
+					M_buf_add_bytes(buf, &uval, sizeof(uval));
+				}
+				break;
+		}
+	}
+}
+
+
+void log_binary_record_add_text(M_buf_t *buf, M_uint64 tag, const char *line, size_t line_len)
+{
+	M_timeval_t tv;
+	M_uint32    str_len = (M_uint32)M_MIN(line_len, M_UINT32_MAX - LOG_BINARY_HDR_LEN - sizeof(M_uint32));
+
+	M_mem_set(&tv, 0, sizeof(tv));
+	M_time_gettimeofday(&tv);
+
+	record_add_hdr(buf, (M_uint32)(LOG_BINARY_HDR_LEN + sizeof(str_len) + str_len), M_LOG_BINARY_FORMAT_TEXT, tag, &tv);
+	M_buf_add_bytes(buf, &str_len, sizeof(str_len));
+	M_buf_add_bytes(buf, line, str_len);
+}
+
+
+
+/* ---- PRIVATE: record decoding ---- */
+
+typedef struct {
+	M_uint32    rec_len;
+	M_uint32    fmt_id;
+	M_uint64    tag;
+	M_timeval_t tv;
+} record_hdr_t;
+
+
+static M_bool record_read_hdr(const unsigned char *rec, size_t rec_len, record_hdr_t *hdr)
+{
+	M_int64 sec;
+	M_int64 usec;
+
+	if (rec_len < LOG_BINARY_HDR_LEN)
+		return M_FALSE;
+
+	M_mem_copy(&hdr->rec_len, rec, sizeof(hdr->rec_len));
+	M_mem_copy(&hdr->fmt_id, rec + 4, sizeof(hdr->fmt_id));
+	M_mem_copy(&hdr->tag, rec + 8, sizeof(hdr->tag));
+	M_mem_copy(&sec, rec + 16, sizeof(sec));
+	M_mem_copy(&usec, rec + 24, sizeof(usec));
+
+	hdr->tv.tv_sec  = sec;
+	hdr->tv.tv_usec = usec;
+
+	if (hdr->rec_len < LOG_BINARY_HDR_LEN || hdr->rec_len > rec_len)
+		return M_FALSE;
+	return M_TRUE;
+}
+
+
+static M_bool record_read_8(const unsigned char *rec, size_t rec_len, size_t *pos, void *out)
+{
+	if (rec_len - *pos < 8)
+		return M_FALSE;
+	M_mem_copy(out, rec + *pos, 8);
+	*pos += 8;
+	return M_TRUE;
+}
+
+
+static M_bool record_read_str(const unsigned char *rec, size_t rec_len, size_t *pos, const char **str, M_uint32 *str_len)
+{
+	if (rec_len - *pos < sizeof(*str_len))
+		return M_FALSE;
+	M_mem_copy(str_len, rec + *pos, sizeof(*str_len));
+	*pos += sizeof(*str_len);
+
+	if (*str_len == LOG_BINARY_STR_NULL) {
+		*str     = NULL;
+		*str_len = 0;
+		return M_TRUE;
+	}
+
+	if (rec_len - *pos < *str_len)
+		return M_FALSE;
+	*str  = (const char *)(rec + *pos);
+	*pos += *str_len;
+	return M_TRUE;
+}
+
+
+/* Rebuild a conversion specifier with any '*' arguments substituted, so it can be handed to M_bprintf() with
+ * a single value. Non-positive '*' values are ignored, same as M_vbprintf(). */
+static void piece_build_spec(const log_binary_piece_t *piece, M_int64 width, M_int64 prec, char *spec, size_t spec_len)
+{
+	size_t len;
+
+	len = M_snprintf(spec, spec_len, "%%%s", piece->flags);
+	if (piece->width_star) {
+		if (width > 0) {
+			len += M_snprintf(spec + len, spec_len - len, "%lld", width);
+		}
+	} else if (piece->width > 0) {
+		len += M_snprintf(spec + len, spec_len - len, "%zu", piece->width);
+	}
+	if (piece->have_prec) {
+		if (piece->prec_star) {
+			len += M_snprintf(spec + len, spec_len - len, (prec > 0)? ".%lld" : ".", prec);
+		} else {
+			len += M_snprintf(spec + len, spec_len - len, ".%zu", piece->prec);
+		}
+	}
+	if (piece->type != LOG_BINARY_TYPE_DOUBLE && piece->type != LOG_BINARY_TYPE_STR &&
+		piece->type != LOG_BINARY_TYPE_VOIDP && piece->conv != 'c') {
+		len += M_snprintf(spec + len, spec_len - len, "ll");
+	}
+	M_snprintf(spec + len, spec_len - len, "%c", piece->conv);
+}
+
+
+static M_bool record_format_args(M_buf_t *buf, const log_binary_fmt_t *fmt, const unsigned char *rec, size_t rec_len)
+{
+	size_t pos = LOG_BINARY_HDR_LEN;
+	size_t i;
+
+	for (i=0; i<fmt->num_pieces; i++) {
+		const log_binary_piece_t *piece = &fmt->pieces[i];
+		char                      spec[64];
+		M_int64                   width  = 0;
+		M_int64                   prec   = 0;
+		M_int64                   sval;
+		M_uint64                  uval;
+		double                    dval;
+		const char               *str;
+		char                     *str_dup;
+		M_uint32                  str_len;
+
+		if (piece->literal != NULL) {
+			M_buf_add_bytes(buf, piece->literal, piece->literal_len);
+			continue;
+		}
+
+		if (piece->width_star && !record_read_8(rec, rec_len, &pos, &width))
+			return M_FALSE;
+		if (piece->prec_star && !record_read_8(rec, rec_len, &pos, &prec))
+			return M_FALSE;
+
+		piece_build_spec(piece, width, prec, spec, sizeof(spec));
+
+		switch (piece->type) {
+			case LOG_BINARY_TYPE_DOUBLE:
+				if (!record_read_8(rec, rec_len, &pos, &dval))
+					return M_FALSE;
+				M_bprintf(buf, spec, dval);
+				break;
+			case LOG_BINARY_TYPE_STR:
+				if (!record_read_str(rec, rec_len, &pos, &str, &str_len))
+					return M_FALSE;
+				/* NULL is passed through so it's output as "<NULL>", same as M_log_printf(). */
+				str_dup = (str == NULL)? NULL : M_strdup_max(str, str_len);
+				M_bprintf(buf, spec, str_dup);
+				M_free(str_dup);
+				break;
+			case LOG_BINARY_TYPE_VOIDP:
+				if (!record_read_8(rec, rec_len, &pos, &uval))
+					return M_FALSE;
+				M_bprintf(buf, spec, (void *)(M_uintptr)uval);
+				break;
+			default:
+				if (piece->conv == 'c') {
+					if (!record_read_8(rec, rec_len, &pos, &sval))
+						return M_FALSE;
+					M_bprintf(buf, spec, (int)sval);
+				} else if (piece->is_signed) {
+					if (!record_read_8(rec, rec_len, &pos, &sval))
+						return M_FALSE;
+					M_bprintf(buf, spec, sval);
+				} else {
+					if (!record_read_8(rec, rec_len, &pos, &uval))
+						return M_FALSE;
+					M_bprintf(buf, spec, uval);
+				}
+				break;
+		}
+	}
+
+	return M_TRUE;
+}
+
+
+/* Format the message portion of a record (no timestamp, prefix or line ending). Returns NULL if the record is
+ * malformed. */
+static char *record_format(const log_binary_fmt_t *fmt, const unsigned char *rec, size_t rec_len)
+{
+	record_hdr_t  hdr;
+	M_buf_t      *buf;
+	char         *msg;
+
+	if (fmt == NULL || !record_read_hdr(rec, rec_len, &hdr))
+		return NULL;
+
+	buf = M_buf_create();
+	if (!record_format_args(buf, fmt, rec, hdr.rec_len)) {
+		M_buf_cancel(buf);
+		return NULL;
+	}
+
+	/* An empty buffer finishes as NULL, don't let an empty message look like a malformed record. */
+	msg = M_buf_finish_str(buf, NULL);
+	if (msg == NULL) {
+		msg = M_strdup("");
+	}
+	return msg;
+}
+
+
+/* Trim whitespace from end of buffer, back to (but not past) the given start position. */
+static void buf_trim_end_from(M_buf_t *buf, size_t start)
+{
+	size_t      len = M_buf_len(buf);
+	const char *ptr = M_buf_peek(buf);
+
+	while (len > start && M_chr_isspace(*(ptr + len - 1))) {
+		len--;
+	}
+	M_buf_truncate(buf, len);
+}
+
+
+/* Output each line of a message the same way M_log_write() would. If lines isn't NULL, each line is added to it
+ * instead of being appended to out. */
+static void add_lines(M_buf_t *out, M_list_str_t *lines, const char *time_str, size_t time_str_len,
+	const char *prefix, const char *line_end_str, const char *msg)
+{
+	const char *line_start = msg;
+
+	while (!M_str_isempty(line_start)) {
+		const char *line_end;
+		size_t      line_len;
+		size_t      start;
+
+		line_end = M_str_find_first_from_charset(line_start, "\r\n");
+		line_len = (line_end == NULL)? M_str_len(line_start) : (size_t)(line_end - line_start);
+
+		start = M_buf_len(out);
+		M_buf_add_bytes(out, time_str, time_str_len);
+		M_buf_add_str(out, prefix);
+		M_buf_add_bytes(out, line_start, line_len);
+		buf_trim_end_from(out, start);
+		M_buf_add_str(out, line_end_str);
+
+		if (lines != NULL) {
+			char *line = M_strdup_max(M_buf_peek(out) + start, M_buf_len(out) - start);
+			M_list_str_insert(lines, line);
+			M_free(line);
+			M_buf_truncate(out, start);
+		}
+
+		line_start = M_str_find_first_not_from_charset(line_end, "\r\n");
+	}
+}
+
+
+/* Output each line of a decoded message. Assumes log is locked. */
+static void decode_add_lines_locked(M_log_t *log, M_buf_t *out, const record_hdr_t *hdr, const char *msg)
+{
+	M_buf_t *prefix_buf;
+	char    *prefix;
+	char    *time_str;
+	size_t   time_str_len;
+
+	prefix_buf = M_buf_create();
+	log_add_line_prefix_locked(log, prefix_buf, NULL, 0, hdr->tag, NULL, M_FALSE);
+	prefix     = M_buf_finish_str(prefix_buf, NULL);
+	time_str   = log_time_str(log->time_format, &hdr->tv, &time_str_len);
+
+	add_lines(out, NULL, time_str, time_str_len, prefix, log->line_end_str, msg);
+
+	M_free(time_str);
+	M_free(prefix);
+}
+
+
+/* Render a captured message, either into out or (if lines isn't NULL) as separate lines. */
+static void msg_format(const log_binary_msg_t *msg, M_buf_t *out, M_list_str_t *lines)
+{
+	record_hdr_t  hdr;
+	char         *text;
+	char         *time_str;
+	size_t        time_str_len;
+
+	if (!record_read_hdr(msg->data, msg->rec_len, &hdr))
+		return;
+
+	text = record_format(msg->fmt, msg->data, msg->rec_len);
+	if (text == NULL)
+		return;
+
+	time_str = log_time_str(msg->time_format, &hdr.tv, &time_str_len);
+	add_lines(out, lines, time_str, time_str_len, msg->prefix, msg->line_end, text);
+
+	M_free(time_str);
+	M_free(text);
+}
+
+
+
+/* ---- PRIVATE: captured messages ---- */
+
+log_binary_msg_t *log_binary_msg_create_locked(M_log_t *log, log_binary_fmt_t *fmt, M_uint32 fmt_id, M_uint64 tag,
+	void *msg_thunk, va_list ap)
+{
+	log_binary_msg_t *msg;
+	M_buf_t          *buf;
+	M_timeval_t       tv;
+	va_list           ap_add;
+	M_uint32          rec_len;
+	size_t            prefix_off;
+	size_t            time_format_off;
+	size_t            data_len;
+
+	M_mem_set(&tv, 0, sizeof(tv));
+	M_time_gettimeofday(&tv);
+
+	/* Record, line prefix and time format share a single allocation. The record length isn't known until the
+	 * arguments have been added, so it's filled in afterwards instead of walking the arguments twice.
+	 */
+	buf = M_buf_create();
+	record_add_hdr(buf, 0, fmt_id, tag, &tv);
+	va_copy(ap_add, ap);
+	record_add_args(buf, fmt, &ap_add);
+	va_end(ap_add);
+	rec_len = (M_uint32)M_MIN(M_buf_len(buf), M_UINT32_MAX);
+
+	/* Prefix callback needs the per-message thunk, so it has to run now. Everything else is done at format time. */
+	prefix_off = M_buf_len(buf);
+	log_add_line_prefix_locked(log, buf, NULL, 0, tag, msg_thunk, M_TRUE);
+	M_buf_add_byte(buf, '\0');
+
+	time_format_off = M_buf_len(buf);
+	M_buf_add_str(buf, log->time_format);
+	M_buf_add_byte(buf, '\0');
+
+	msg              = M_malloc_zero(sizeof(*msg));
+	msg->refcnt      = 1;
+	msg->fmt         = fmt;
+	msg->data        = M_buf_finish(buf, &data_len);
+	msg->rec_len     = rec_len;
+	msg->prefix      = (const char *)(msg->data + prefix_off);
+	msg->time_format = (const char *)(msg->data + time_format_off);
+	msg->line_end    = log->line_end_str;
+	M_mem_copy(msg->data, &rec_len, sizeof(rec_len));
+
+	M_atomic_inc_u32(&fmt->refcnt);
+
+	return msg;
+}
+
+
+void log_binary_msg_retain(log_binary_msg_t *msg)
+{
+	if (msg == NULL)
+		return;
+	M_atomic_inc_u32(&msg->refcnt);
+}
+
+
+void log_binary_msg_release(void *arg)
+{
+	log_binary_msg_t *msg = arg;
+
+	if (msg == NULL || M_atomic_dec_u32(&msg->refcnt) != 1)
+		return;
+
+	log_binary_fmt_destroy(msg->fmt);
+	M_free(msg->data);
+	M_free(msg);
+}
+
+
+const unsigned char *log_binary_msg_record(const log_binary_msg_t *msg, size_t *rec_len)
+{
+	*rec_len = msg->rec_len;
+	return msg->data;
+}
+
+
+M_list_str_t *log_binary_msg_lines(const log_binary_msg_t *msg)
+{
+	M_list_str_t *lines = M_list_str_create(M_LIST_STR_NONE);
+	M_buf_t      *buf   = M_buf_create();
+
+	msg_format(msg, buf, lines);
+
+	M_buf_cancel(buf);
+	return lines;
+}
+
+
+char *log_binary_msg_text(void *arg)
+{
+	M_buf_t *buf = M_buf_create();
+
+	msg_format(arg, buf, NULL);
+
+	if (M_buf_len(buf) == 0) {
+		M_buf_cancel(buf);
+		return NULL;
+	}
+	return M_buf_finish_str(buf, NULL);
+}
+
+
+
+/* ---- PUBLIC: binary log functions ---- */
+
+M_log_error_t M_log_binary_register_format(M_log_t *log, M_uint32 fmt_id, const char *fmt)
+{
+	log_binary_fmt_t *bfmt;
+
+	if (log == NULL || fmt_id == M_LOG_BINARY_FORMAT_TEXT || fmt == NULL) {
+		return M_LOG_INVALID_PARAMS;
+	}
+
+	bfmt = log_binary_fmt_create(fmt);
+	if (bfmt == NULL) {
+		return M_LOG_INVALID_FORMAT;
+	}
+
+	M_thread_rwlock_lock(log->rwlock, M_THREAD_RWLOCK_TYPE_WRITE);
+
+	if (log->binary_formats == NULL) {
+		log->binary_formats = M_hash_u64vp_create(16, 75, M_HASH_U64VP_NONE, log_binary_fmt_destroy);
+	}
+	/* Replaces (and destroys) any format previously registered with the same ID. */
+	M_hash_u64vp_insert(log->binary_formats, fmt_id, bfmt);
+
+	M_thread_rwlock_unlock(log->rwlock);
+
+	return M_LOG_SUCCESS;
+}
+
+
+M_log_error_t M_log_binary_decode(M_log_t *log, const unsigned char *data, size_t data_len, M_buf_t *out,
+	size_t *len_consumed)
+{
+	size_t        pos = 0;
+	M_log_error_t ret = M_LOG_SUCCESS;
+
+	if (len_consumed != NULL) {
+		*len_consumed = 0;
+	}
+
+	if (log == NULL || (data == NULL && data_len > 0) || out == NULL) {
+		return M_LOG_INVALID_PARAMS;
+	}
+
+	M_thread_rwlock_lock(log->rwlock, M_THREAD_RWLOCK_TYPE_READ);
+
+	while (data_len - pos >= LOG_BINARY_HDR_LEN) {
+		const unsigned char *rec = data + pos;
+		record_hdr_t         hdr;
+		M_uint32             rec_len;
+
+		/* Stop at a partial record, caller can feed the rest of it in on the next call. */
+		M_mem_copy(&rec_len, rec, sizeof(rec_len));
+		if (rec_len > data_len - pos)
+			break;
+
+		if (!record_read_hdr(rec, data_len - pos, &hdr)) {
+			ret = M_LOG_GENERIC_FAIL;
+			break;
+		}
+
+		if (hdr.fmt_id == M_LOG_BINARY_FORMAT_TEXT) {
+			/* Already formatted (timestamp, prefix and line end included). */
+			size_t      str_pos = LOG_BINARY_HDR_LEN;
+			const char *str;
+			M_uint32    str_len;
+
+			if (!record_read_str(rec, hdr.rec_len, &str_pos, &str, &str_len)) {
+				ret = M_LOG_GENERIC_FAIL;
+				break;
+			}
+			M_buf_add_bytes(out, str, str_len);
+		} else {
+			const log_binary_fmt_t *fmt = M_hash_u64vp_get_direct(log->binary_formats, hdr.fmt_id);
+			char                   *msg = NULL;
+
+			if (fmt != NULL) {
+				msg = record_format(fmt, rec, hdr.rec_len);
+				if (msg == NULL) {
+					ret = M_LOG_GENERIC_FAIL;
+					break;
+				}
+			} else {
+				M_asprintf(&msg, "<unregistered binary log format ID %u>", hdr.fmt_id);
+			}
+			decode_add_lines_locked(log, out, &hdr, msg);
+			M_free(msg);
+		}
+
+		pos += hdr.rec_len;
+	}
+
+	M_thread_rwlock_unlock(log->rwlock);
+
+	if (len_consumed != NULL) {
+		*len_consumed = pos;
+	}
+
+	return ret;
+}
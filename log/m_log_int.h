@@ -50,6 +50,27 @@ typedef M_bool (*M_log_check_cb)(M_log_module_t *mod);
 typedef void (*M_log_write_cb)(M_log_module_t *mod, const char *msg, M_uint64 tag);
 
 
+/* Module-specific callback to accept a filtered binary log record (see m_log_binary.c for the record layout).
+ *
+ * Modules that set this receive records from M_log_binary_printf() as-is, instead of formatted text lines.
+ */
+typedef void (*M_log_write_binary_cb)(M_log_module_t *mod, const unsigned char *rec, size_t rec_len, M_uint64 tag);
+
+
+/* Binary log message captured by M_log_binary_printf() (record, plus what's needed to format it later). Reference
+ * counted, so it can be queued on several modules at once. Opaque outside of m_log_binary.c.
+ */
+typedef struct log_binary_msg log_binary_msg_t;
+
+
+/* Module-specific callback to accept a filtered binary log message, to be formatted later by the module itself.
+ *
+ * Used by modules with an async writer, so the message is formatted on the writer thread instead of the logging
+ * thread. The module must take its own reference with log_binary_msg_retain() if it keeps the message.
+ */
+typedef void (*M_log_write_deferred_cb)(M_log_module_t *mod, log_binary_msg_t *msg, M_uint64 tag);
+
+
 /* Module-specific callback that asks the module to reopen any internal resources (file stream, tcp connection, etc.) */
 typedef M_log_error_t (*M_log_reopen_cb)(M_log_module_t *mod);
 
@@ -109,6 +130,8 @@ struct M_log {
 	M_log_prefix_cb                 prefix_cb;
 	void                           *prefix_thunk;
 	M_log_destroy_cb                destroy_prefix_thunk_cb;
+
+	M_hash_u64vp_t                 *binary_formats;       /* Format ID -> log_binary_fmt_t, for M_log_binary_printf(). */
 } /* M_log_t */;
 
 
@@ -126,6 +149,8 @@ struct M_log_module {
 	void                            *module_thunk;
 	M_log_check_cb                   module_check_cb;
 	M_log_write_cb                   module_write_cb;
+	M_log_write_binary_cb            module_write_binary_cb; /* Optional, if NULL module only receives text. */
+	M_log_write_deferred_cb          module_write_deferred_cb; /* Optional, formats binary messages itself. */
 	M_log_reopen_cb                  module_reopen_cb;
 	M_log_suspend_cb                 module_suspend_cb;
 	M_log_resume_cb                  module_resume_cb;
@@ -153,6 +178,97 @@ M_bool module_present_locked(M_log_t *log, M_log_module_t *module);
 void module_remove_locked(M_log_t *log, M_log_module_t *module);
 
 
+/* Internal helper that formats the given time according to the given log time format string.
+ * Returns NULL if the format string is empty.
+ *
+ * Implemented in m_log.c
+ */
+char *log_time_str(const char *time_format, const M_timeval_t *tv, size_t *out_len);
+
+
+/* Internal helper that adds the timestamp, tag name and prefix to the start of a log line. Assumes you've already
+ * locked the log. If use_prefix_cb is M_FALSE, the default prefix is always used.
+ *
+ * Implemented in m_log.c
+ */
+void log_add_line_prefix_locked(M_log_t *log, M_buf_t *buf, const char *time_str, size_t time_str_len, M_uint64 tag,
+	void *msg_thunk, M_bool use_prefix_cb);
+
+
+/* Parsed format string registered with M_log_binary_register_format(). Opaque outside of m_log_binary.c. */
+typedef struct log_binary_fmt log_binary_fmt_t;
+
+
+/* Parse a printf-style format string into a binary log format. Returns NULL if the format string is invalid.
+ *
+ * Implemented in m_log_binary.c
+ */
+log_binary_fmt_t *log_binary_fmt_create(const char *fmt);
+
+
+/* Release a binary log format, it's destroyed once no captured messages reference it (void * so it can be used as a
+ * hashtable value destructor).
+ *
+ * Implemented in m_log_binary.c
+ */
+void log_binary_fmt_destroy(void *fmt);
+
+
+/* Capture a binary log message for the given format and argument list, stamped with the current time. The line
+ * prefix (tag name and prefix callback output) and time format are copied from the log. Assumes the log is locked.
+ *
+ * Returned message holds one reference, release it with log_binary_msg_release().
+ *
+ * Implemented in m_log_binary.c
+ */
+log_binary_msg_t *log_binary_msg_create_locked(M_log_t *log, log_binary_fmt_t *fmt, M_uint32 fmt_id, M_uint64 tag,
+	void *msg_thunk, va_list ap);
+
+
+/* Take an additional reference to a captured message.
+ *
+ * Implemented in m_log_binary.c
+ */
+void log_binary_msg_retain(log_binary_msg_t *msg);
+
+
+/* Release a reference to a captured message, destroying it when it's the last one (void * so it can be used as
+ * an M_async_data_destroy_cb_t).
+ *
+ * Implemented in m_log_binary.c
+ */
+void log_binary_msg_release(void *msg);
+
+
+/* Get the binary record of a captured message.
+ *
+ * Implemented in m_log_binary.c
+ */
+const unsigned char *log_binary_msg_record(const log_binary_msg_t *msg, size_t *rec_len);
+
+
+/* Format a captured message into text lines, each with timestamp, prefix and line ending, same as M_log_write().
+ *
+ * Implemented in m_log_binary.c
+ */
+M_list_str_t *log_binary_msg_lines(const log_binary_msg_t *msg);
+
+
+/* Format a captured message into text, all lines concatenated (void * so it can be used as an M_async_render_cb_t).
+ * Returns NULL if there's nothing to output.
+ *
+ * Implemented in m_log_binary.c
+ */
+char *log_binary_msg_text(void *msg);
+
+
+/* Encode a binary log record that holds an already formatted text line (M_LOG_BINARY_FORMAT_TEXT).
+ *
+ * Implemented in m_log_binary.c
+ */
+void log_binary_record_add_text(M_buf_t *buf, M_uint64 tag, const char *line, size_t line_len);
+
+
 /* Master list of commands that may be passed internally to m_async_writer.
  *
  * Must be composable, so these should only be powers of two.
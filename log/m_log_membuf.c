@@ -58,8 +58,6 @@ static void log_write_cb(M_log_module_t *mod, const char *msg, M_uint64 tag)
 	module_thunk_t *mdata;
 	size_t          msg_len = M_str_len(msg);
 
-	(void)tag;
-
 	if (msg_len == 0 || mod == NULL || mod->module_thunk == NULL) {
 		return;
 	}
@@ -75,6 +73,9 @@ static void log_write_cb(M_log_module_t *mod, const char *msg, M_uint64 tag)
 	 * a single message, instead of truncating it. We figure a no-truncation
 	 * guarantee is more useful than a strict membuf size limit.
 	 */
+	} else if (mod->module_write_binary_cb != NULL) {
+		/* Binary mode, wrap already formatted text in a record so the buffer can be decoded as a whole. */
+		log_binary_record_add_text(mdata->buf, tag, msg, msg_len);
 	} else {
 		M_buf_add_bytes(mdata->buf, msg, msg_len);
 	}
@@ -82,6 +83,27 @@ static void log_write_cb(M_log_module_t *mod, const char *msg, M_uint64 tag)
 }
 
 
+static void log_write_binary_cb(M_log_module_t *mod, const unsigned char *rec, size_t rec_len, M_uint64 tag)
+{
+	module_thunk_t *mdata;
+
+	(void)tag;
+
+	if (rec_len == 0 || mod == NULL || mod->module_thunk == NULL) {
+		return;
+	}
+
+	mdata = mod->module_thunk;
+
+	M_thread_mutex_lock(mdata->lock);
+	/* Same size limit behavior as log_write_cb(). */
+	if (M_buf_len(mdata->buf) <= mdata->max_size) {
+		M_buf_add_bytes(mdata->buf, rec, rec_len);
+	}
+	M_thread_mutex_unlock(mdata->lock);
+}
+
+
 static M_bool log_check_cb(M_log_module_t *mod)
 {
 	/* Return M_FALSE, if we've exceeded our max time and the module needs to be purged. */
@@ -166,6 +188,30 @@ M_log_error_t M_log_module_add_membuf(M_log_t *log, size_t buf_size, M_uint64 bu
 }
 
 
+M_log_error_t M_log_module_membuf_set_binary(M_log_t *log, M_log_module_t *module, M_bool binary)
+{
+	M_log_error_t ret = M_LOG_SUCCESS;
+
+	if (log == NULL || module == NULL) {
+		return M_LOG_INVALID_PARAMS;
+	}
+
+	M_thread_rwlock_lock(log->rwlock, M_THREAD_RWLOCK_TYPE_WRITE);
+
+	if (!module_present_locked(log, module)) {
+		ret = M_LOG_MODULE_NOT_FOUND;
+	} else if (module->type != M_LOG_MODULE_MEMBUF) {
+		ret = M_LOG_WRONG_MODULE;
+	} else {
+		module->module_write_binary_cb = (binary)? log_write_binary_cb : NULL;
+	}
+
+	M_thread_rwlock_unlock(log->rwlock);
+
+	return ret;
+}
+
+
 M_log_error_t M_log_module_take_membuf(M_log_t *log, M_log_module_t *module, M_buf_t **out_buf)
 {
 	if (out_buf != NULL) {
@@ -82,6 +82,26 @@ static void log_write_cb(M_log_module_t *mod, const char *msg, M_uint64 tag)
 }
 
 
+static void log_write_deferred_cb(M_log_module_t *mod, log_binary_msg_t *msg, M_uint64 tag)
+{
+	M_async_writer_t *writer;
+	size_t            rec_len;
+
+	(void)tag;
+
+	if (msg == NULL || mod == NULL || mod->module_thunk == NULL) {
+		return;
+	}
+
+	writer = mod->module_thunk;
+
+	/* Message is formatted by the writer thread, record length stands in for the text length in the queue. */
+	log_binary_msg_retain(msg);
+	log_binary_msg_record(msg, &rec_len);
+	M_async_writer_write_deferred(writer, msg, rec_len, log_binary_msg_text, log_binary_msg_release);
+}
+
+
 static M_log_error_t log_suspend_cb(M_log_module_t *module)
 {
 	M_async_writer_t *writer;
@@ -187,6 +207,7 @@ M_log_error_t M_log_module_add_stream(M_log_t *log, M_stream_type_t type, size_t
 	mod->module_thunk                     = M_async_writer_create(max_queue_bytes, writer_write_cb, iostream, NULL,
 		NULL, log->line_end_writer_mode);
 	mod->module_write_cb                  = log_write_cb;
+	mod->module_write_deferred_cb         = log_write_deferred_cb;
 	mod->module_suspend_cb                = log_suspend_cb;
 	mod->module_resume_cb                 = log_resume_cb;
 	mod->module_emergency_cb              = log_emergency_cb;
@@ -52,6 +52,7 @@ typedef struct {
 	M_syslog_facility_t  facility;
 	char                *product;
 	M_bool               suspended;
+	const char          *line_end_str;
 } writer_thunk_t;
 
 
@@ -63,6 +64,14 @@ typedef struct {
 } module_thunk_t;
 
 
+/* Binary log message queued on the writer, formatted by the writer thread. */
+typedef struct {
+	log_binary_msg_t    *msg;
+	const char          *line_end_str;
+	M_syslog_priority_t  priority;
+} deferred_msg_t;
+
+
 
 /* ---- PRIVATE: misc. helper functions ---- */
 
@@ -85,6 +94,57 @@ static M_syslog_priority_t char_to_priority(char c_val)
 }
 
 
+/* Add a log line to buf in the form the writer thread expects: tabs expanded, truncated to the syslog limit, and
+ * followed by the priority byte.
+ */
+static void add_line(M_buf_t *buf, const char *line, const char *line_end_str, M_syslog_priority_t priority)
+{
+	size_t start = M_buf_len(buf);
+
+	/* Copy message bytes to buf, expand tabs during transfer. */
+	M_buf_add_str_replace(buf, line, "\t", M_SYSLOG_TAB_REPLACE);
+
+	/* Truncate if message greater than syslog limit. Make sure we still end with the line ending sequence. */
+	if (M_buf_len(buf) - start > M_SYSLOG_MAX_CHARS) {
+		M_buf_truncate(buf, start + M_SYSLOG_MAX_CHARS - M_str_len(line_end_str));
+		M_buf_add_str(buf, line_end_str);
+	}
+
+	M_buf_add_char(buf, priority_to_char(priority));
+}
+
+
+static char *deferred_msg_render(void *arg)
+{
+	deferred_msg_t *dmsg = arg;
+	M_list_str_t   *lines;
+	M_buf_t        *buf;
+	size_t          i;
+
+	lines = log_binary_msg_lines(dmsg->msg);
+	buf   = M_buf_create();
+	for (i=0; i<M_list_str_len(lines); i++) {
+		add_line(buf, M_list_str_at(lines, i), dmsg->line_end_str, dmsg->priority);
+	}
+	M_list_str_destroy(lines);
+
+	if (M_buf_len(buf) == 0) {
+		M_buf_cancel(buf);
+		return NULL;
+	}
+	return M_buf_finish_str(buf, NULL);
+}
+
+
+static void deferred_msg_destroy(void *arg)
+{
+	deferred_msg_t *dmsg = arg;
+
+	log_binary_msg_release(dmsg->msg);
+	M_free(dmsg);
+}
+
+
 
 /* ---- PRIVATE: callbacks for internal async_writer object. ---- */
 
@@ -132,12 +192,27 @@ static M_bool writer_write_cb(char *msg, M_uint64 cmd, void *thunk)
 		return M_TRUE;
 	}
 
-	/* Parse priority byte off of end of message. */
-	priority         = (int)(char_to_priority(msg[msg_len - 1]));
-	msg[msg_len - 1] = '\0';
+	/* Send each line to syslog. Messages formatted by the writer thread may hold several lines, each one ends with
+	 * the line ending sequence followed by its priority byte.
+	 */
+	while (msg_len > 0) {
+		const char *line_end = M_str_str(msg, wdata->line_end_str);
+		size_t      len      = msg_len;
 
-	/* Send message to syslog. */
-	syslog(priority | (int)wdata->facility, "%s", msg);
+		if (line_end != NULL) {
+			len = M_MIN(msg_len, (size_t)(line_end - msg) + M_str_len(wdata->line_end_str) + 1);
+		}
+
+		/* Parse priority byte off of end of line. */
+		priority     = (int)(char_to_priority(msg[len - 1]));
+		msg[len - 1] = '\0';
+
+		/* Send line to syslog. */
+		syslog(priority | (int)wdata->facility, "%s", msg);
+
+		msg     += len;
+		msg_len -= len;
+	}
 
 	return M_TRUE;
 }
@@ -169,25 +244,40 @@ static void log_write_cb(M_log_module_t *mod, const char *msg, M_uint64 tag)
 		return;
 	}
 
-	mdata = mod->module_thunk;
+	mdata    = mod->module_thunk;
+	priority = mdata->tag_to_priority[M_uint64_log2(tag)];
 
-	/* Copy message bytes to buf, expand tabs during transfer. */
 	buf = M_buf_create();
-	M_buf_add_str_replace(buf, msg, "\t", M_SYSLOG_TAB_REPLACE);
+	add_line(buf, msg, mdata->line_end_str, priority);
 
-	/* Truncate if message greater than syslog limit. Make sure we still end with the line ending sequence. */
-	if (M_buf_len(buf) > M_SYSLOG_MAX_CHARS) {
-		M_buf_truncate(buf, M_SYSLOG_MAX_CHARS - M_str_len(mdata->line_end_str));
-		M_buf_add_str(buf, mdata->line_end_str);
-	}
+	M_async_writer_write(mdata->writer, M_buf_peek(buf));
 
-	priority = mdata->tag_to_priority[M_uint64_log2(tag)];
+	M_buf_cancel(buf);
+}
 
-	M_buf_add_char(buf, priority_to_char(priority));
 
-	M_async_writer_write(mdata->writer, M_buf_peek(buf));
+static void log_write_deferred_cb(M_log_module_t *mod, log_binary_msg_t *msg, M_uint64 tag)
+{
+	module_thunk_t *mdata;
+	deferred_msg_t *dmsg;
+	size_t          rec_len;
 
-	M_buf_cancel(buf);
+	if (msg == NULL || mod == NULL || mod->module_thunk == NULL) {
+		return;
+	}
+
+	mdata = mod->module_thunk;
+
+	/* Priority is looked up now, the tag mapping may change before the writer thread gets to the message. */
+	dmsg               = M_malloc_zero(sizeof(*dmsg));
+	dmsg->msg          = msg;
+	dmsg->line_end_str = mdata->line_end_str;
+	dmsg->priority     = mdata->tag_to_priority[M_uint64_log2(tag)];
+	log_binary_msg_retain(msg);
+
+	/* Record length stands in for the text length in the queue. */
+	log_binary_msg_record(msg, &rec_len);
+	M_async_writer_write_deferred(mdata->writer, dmsg, rec_len, deferred_msg_render, deferred_msg_destroy);
 }
 
 
@@ -330,8 +420,9 @@ M_log_error_t M_log_module_add_syslog(M_log_t *log, const char *product, M_syslo
 	}
 
 	/* Set up thunk for internal writer. */
-	wdata           = M_malloc_zero(sizeof(*wdata));
-	wdata->facility = facility;
+	wdata               = M_malloc_zero(sizeof(*wdata));
+	wdata->facility     = facility;
+	wdata->line_end_str = log->line_end_str;
 	if (product == NULL) {
 		wdata->product = NULL;
 	} else {
@@ -355,6 +446,7 @@ M_log_error_t M_log_module_add_syslog(M_log_t *log, const char *product, M_syslo
 	mod->flush_on_destroy                 = log->flush_on_destroy;
 	mod->module_thunk                     = mdata;
 	mod->module_write_cb                  = log_write_cb;
+	mod->module_write_deferred_cb         = log_write_deferred_cb;
 	mod->module_reopen_cb                 = log_reopen_cb;
 	mod->module_suspend_cb                = log_suspend_cb;
 	mod->module_resume_cb                 = log_resume_cb;
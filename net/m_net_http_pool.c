@@ -0,0 +1,546 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2019 Monetra Technologies, LLC.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "m_net_int.h"
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Connections for a given server. Idle connections are kept with the most
+ * recently used first. A host is removed once it doesn't have any
+ * connections or waiting requests. */
+struct M_net_http_pool_host {
+	char              *key;
+	char              *host;
+	M_uint16           port;
+	M_tls_clientctx_t *ctx;
+	size_t             active;  /*!< Connections currently in use by a request. */
+	M_llist_t         *idle;    /*!< M_net_http_pool_conn_t */
+	M_llist_t         *waiters; /*!< M_net_http_simple_t waiting for a connection. */
+};
+
+typedef struct {
+	M_net_http_pool_t      *pool;
+	M_net_http_pool_host_t *phost;
+	M_io_t                 *io;
+	M_event_timer_t        *timer;
+	M_llist_node_t         *node;
+} M_net_http_pool_conn_t;
+
+/* A waiting request that has been given a connection. */
+typedef struct {
+	M_net_http_simple_t *hs;
+	M_io_t              *io;
+} M_net_http_pool_start_t;
+
+struct M_net_http_pool {
+	M_event_t         *el;
+	M_thread_mutex_t  *lock;
+	M_hash_strvp_t    *hosts;        /*!< Key is host, port and TLS context. */
+
+	size_t             max_per_host;
+	M_uint64           idle_timeout_ms;
+
+	M_uint64           hits;
+	M_uint64           misses;
+
+	size_t             refs;         /*!< Requests using the pool and queued tasks. */
+	M_bool             task_pending;
+	M_bool             destroyed;
+};
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void M_net_http_pool_io_destroy_cb(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
+{
+	(void)el;
+	(void)etype;
+	(void)thunk;
+	M_io_destroy(io);
+}
+
+static void M_net_http_pool_io_close(M_io_t *io)
+{
+	M_io_state_t state;
+
+	if (io == NULL)
+		return;
+
+	state = M_io_get_state(io);
+	if (state == M_IO_STATE_CONNECTED || state == M_IO_STATE_DISCONNECTING) {
+		M_event_edit_io_cb(io, M_net_http_pool_io_destroy_cb, NULL);
+		M_io_disconnect(io);
+	} else {
+		M_io_destroy(io);
+	}
+}
+
+/* Must be called while locked. */
+static void M_net_http_pool_host_cleanup(M_net_http_pool_t *pool, M_net_http_pool_host_t *phost)
+{
+	if (phost->active != 0 || M_llist_len(phost->idle) != 0 || M_llist_len(phost->waiters) != 0)
+		return;
+
+	/* Destroys the host. */
+	M_hash_strvp_remove(pool->hosts, phost->key, M_TRUE);
+}
+
+static void M_net_http_pool_host_destroy(void *arg)
+{
+	M_net_http_pool_host_t *phost = arg;
+
+	if (phost == NULL)
+		return;
+
+	M_llist_destroy(phost->idle, M_FALSE);
+	M_llist_destroy(phost->waiters, M_FALSE);
+	M_tls_clientctx_destroy(phost->ctx);
+	M_free(phost->host);
+	M_free(phost->key);
+	M_free(phost);
+}
+
+static M_net_http_pool_host_t *M_net_http_pool_host_get(M_net_http_pool_t *pool, const char *host, M_uint16 port, M_tls_clientctx_t *ctx)
+{
+	M_net_http_pool_host_t *phost;
+	char                   *key;
+
+	/* The context is part of the key because a connection made with one
+	 * context can't be used by a request wanting a different one. */
+	M_asprintf(&key, "%s:%u/%p", host, (unsigned int)port, (void *)ctx);
+
+	phost = M_hash_strvp_get_direct(pool->hosts, key);
+	if (phost != NULL) {
+		M_free(key);
+		return phost;
+	}
+
+	phost          = M_malloc_zero(sizeof(*phost));
+	phost->key     = key;
+	phost->host    = M_strdup(host);
+	phost->port    = port;
+	phost->ctx     = ctx;
+	phost->idle    = M_llist_create(NULL, M_LLIST_NONE);
+	phost->waiters = M_llist_create(NULL, M_LLIST_NONE);
+	/* Hold a reference so the pointer in the key can't be reused. */
+	M_tls_clientctx_upref(ctx);
+
+	M_hash_strvp_insert(pool->hosts, key, phost);
+	return phost;
+}
+
+/* Must be called while locked. The caller is responsible for the conn's io. */
+static void M_net_http_pool_conn_remove(M_net_http_pool_conn_t *conn)
+{
+	M_llist_remove_node(conn->node);
+	M_event_timer_remove(conn->timer);
+	M_free(conn);
+}
+
+static M_bool M_net_http_pool_free_if_done(M_net_http_pool_t *pool)
+{
+	if (!pool->destroyed || pool->refs != 0)
+		return M_FALSE;
+
+	M_thread_mutex_unlock(pool->lock);
+
+	M_hash_strvp_destroy(pool->hosts, M_TRUE);
+	M_thread_mutex_destroy(pool->lock);
+	M_free(pool);
+	return M_TRUE;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Hand a connection to a waiting request if there is capacity. Must be called
+ * while locked. Waiting requests are started from the event loop so a request
+ * is never started from within another request's callbacks. */
+static void M_net_http_pool_dispatch_task(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk);
+
+static void M_net_http_pool_schedule_dispatch(M_net_http_pool_t *pool, M_net_http_pool_host_t *phost)
+{
+	if (pool->task_pending || M_llist_len(phost->waiters) == 0)
+		return;
+
+	if (!pool->destroyed && pool->max_per_host != 0 && M_llist_len(phost->idle) == 0 && phost->active >= pool->max_per_host)
+		return;
+
+	if (M_event_queue_task(pool->el, M_net_http_pool_dispatch_task, pool)) {
+		pool->task_pending = M_TRUE;
+		pool->refs++;
+	}
+}
+
+static void M_net_http_pool_dispatch_task(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
+{
+	M_net_http_pool_t       *pool   = thunk;
+	M_net_http_pool_host_t  *phost;
+	M_net_http_pool_conn_t  *conn;
+	M_net_http_pool_start_t *start;
+	M_hash_strvp_enum_t     *he;
+	M_llist_t               *starts;
+	const char              *key;
+
+	(void)el;
+	(void)etype;
+	(void)io;
+
+	starts = M_llist_create(NULL, M_LLIST_NONE);
+
+	M_thread_mutex_lock(pool->lock);
+	pool->task_pending = M_FALSE;
+	pool->refs--;
+
+	M_hash_strvp_enumerate(pool->hosts, &he);
+	while (M_hash_strvp_enumerate_next(pool->hosts, he, &key, (void **)&phost)) {
+		while (M_llist_len(phost->waiters) != 0) {
+			start = M_malloc_zero(sizeof(*start));
+			if (M_llist_len(phost->idle) != 0) {
+				conn      = M_llist_node_val(M_llist_first(phost->idle));
+				start->io = conn->io;
+				M_net_http_pool_conn_remove(conn);
+				pool->hits++;
+			} else if (pool->destroyed || pool->max_per_host == 0 || phost->active < pool->max_per_host) {
+				pool->misses++;
+			} else {
+				M_free(start);
+				break;
+			}
+
+			phost->active++;
+			start->hs = M_llist_take_node(M_llist_first(phost->waiters));
+			M_llist_insert(starts, start);
+		}
+	}
+	M_hash_strvp_enumerate_free(he);
+
+	/* Requests being started hold a reference so the pool can't go away. */
+	M_thread_mutex_unlock(pool->lock);
+
+	/* Can't hold the lock because a request failing to start will
+	 * release its connection. */
+	while (M_llist_len(starts) != 0) {
+		start = M_llist_take_node(M_llist_first(starts));
+		M_net_http_simple_pool_start(start->hs, start->io);
+		M_free(start);
+	}
+	M_llist_destroy(starts, M_FALSE);
+
+	M_thread_mutex_lock(pool->lock);
+	if (!M_net_http_pool_free_if_done(pool)) {
+		M_thread_mutex_unlock(pool->lock);
+	}
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void M_net_http_pool_conn_close(M_net_http_pool_conn_t *conn)
+{
+	M_net_http_pool_t      *pool  = conn->pool;
+	M_net_http_pool_host_t *phost = conn->phost;
+	M_io_t                 *io    = conn->io;
+
+	M_thread_mutex_lock(pool->lock);
+	M_net_http_pool_conn_remove(conn);
+	M_net_http_pool_io_close(io);
+	M_net_http_pool_schedule_dispatch(pool, phost);
+	M_net_http_pool_host_cleanup(pool, phost);
+	M_thread_mutex_unlock(pool->lock);
+}
+
+static void M_net_http_pool_idle_timeout_cb(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
+{
+	M_net_http_pool_conn_t *conn = thunk;
+
+	(void)el;
+	(void)etype;
+	(void)io;
+
+	/* Auto removed. */
+	conn->timer = NULL;
+	M_net_http_pool_conn_close(conn);
+}
+
+static void M_net_http_pool_idle_cb(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
+{
+	M_net_http_pool_conn_t *conn = thunk;
+	unsigned char           byte;
+	size_t                  len  = 0;
+
+	(void)el;
+
+	/* Nothing should happen on an idle connection. The server closing it or
+	 * sending unsolicited data both mean it can't be used anymore. A read
+	 * event without data can happen when a lower layer, such as TLS,
+	 * processed data of its own. */
+	switch (etype) {
+		case M_EVENT_TYPE_READ:
+			if (M_io_read(io, &byte, 1, &len) == M_IO_ERROR_WOULDBLOCK)
+				break;
+			M_net_http_pool_conn_close(conn);
+			break;
+		case M_EVENT_TYPE_DISCONNECTED:
+		case M_EVENT_TYPE_ERROR:
+			M_net_http_pool_conn_close(conn);
+			break;
+		case M_EVENT_TYPE_CONNECTED:
+		case M_EVENT_TYPE_WRITE:
+		case M_EVENT_TYPE_ACCEPT:
+		case M_EVENT_TYPE_OTHER:
+			break;
+	}
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+M_net_http_pool_acquire_t M_net_http_pool_acquire(M_net_http_pool_t *pool, const char *host, M_uint16 port, M_tls_clientctx_t *ctx, M_net_http_simple_t *hs, M_net_http_pool_host_t **phost, M_io_t **io)
+{
+	M_net_http_pool_conn_t    *conn;
+	M_net_http_pool_acquire_t  ret;
+
+	*io = NULL;
+
+	M_thread_mutex_lock(pool->lock);
+	*phost = M_net_http_pool_host_get(pool, host, port, ctx);
+
+	/* Reuse the most recently used connection that's still good. */
+	while (M_llist_len((*phost)->idle) != 0) {
+		conn = M_llist_node_val(M_llist_first((*phost)->idle));
+		*io  = conn->io;
+		M_net_http_pool_conn_remove(conn);
+
+		if (M_io_get_state(*io) == M_IO_STATE_CONNECTED)
+			break;
+
+		M_net_http_pool_io_close(*io);
+		*io = NULL;
+	}
+
+	if (*io != NULL) {
+		(*phost)->active++;
+		pool->hits++;
+		ret = M_NET_HTTP_POOL_ACQUIRE_IDLE;
+	} else if (pool->max_per_host == 0 || (*phost)->active < pool->max_per_host) {
+		(*phost)->active++;
+		pool->misses++;
+		ret = M_NET_HTTP_POOL_ACQUIRE_NEW;
+	} else {
+		M_llist_insert((*phost)->waiters, hs);
+		ret = M_NET_HTTP_POOL_ACQUIRE_WAIT;
+	}
+
+	M_thread_mutex_unlock(pool->lock);
+	return ret;
+}
+
+void M_net_http_pool_release(M_net_http_pool_t *pool, M_net_http_pool_host_t *phost, M_io_t *io, M_bool keepalive)
+{
+	M_net_http_pool_conn_t *conn;
+
+	M_thread_mutex_lock(pool->lock);
+
+	phost->active--;
+
+	if (io != NULL && keepalive && !pool->destroyed && M_io_get_state(io) == M_IO_STATE_CONNECTED) {
+		conn        = M_malloc_zero(sizeof(*conn));
+		conn->pool  = pool;
+		conn->phost = phost;
+		conn->io    = io;
+		conn->node  = M_llist_insert_first(phost->idle, conn);
+		M_event_edit_io_cb(io, M_net_http_pool_idle_cb, conn);
+		if (pool->idle_timeout_ms != 0) {
+			conn->timer = M_event_timer_oneshot(pool->el, pool->idle_timeout_ms, M_TRUE, M_net_http_pool_idle_timeout_cb, conn);
+		}
+	} else {
+		M_net_http_pool_io_close(io);
+	}
+
+	M_net_http_pool_schedule_dispatch(pool, phost);
+	M_net_http_pool_host_cleanup(pool, phost);
+
+	M_thread_mutex_unlock(pool->lock);
+}
+
+void M_net_http_pool_cancel_wait(M_net_http_pool_t *pool, M_net_http_pool_host_t *phost, M_net_http_simple_t *hs)
+{
+	M_thread_mutex_lock(pool->lock);
+	M_llist_remove_val(phost->waiters, hs, M_LLIST_MATCH_VAL);
+	M_net_http_pool_host_cleanup(pool, phost);
+	M_thread_mutex_unlock(pool->lock);
+}
+
+M_bool M_net_http_pool_attach(M_net_http_pool_t *pool, M_event_t *el)
+{
+	M_bool ret = M_FALSE;
+
+	M_thread_mutex_lock(pool->lock);
+	/* Connections are tied to the event loop they were created on. */
+	if (!pool->destroyed && pool->el == el) {
+		pool->refs++;
+		ret = M_TRUE;
+	}
+	M_thread_mutex_unlock(pool->lock);
+
+	return ret;
+}
+
+void M_net_http_pool_detach(M_net_http_pool_t *pool)
+{
+	M_thread_mutex_lock(pool->lock);
+	pool->refs--;
+	if (!M_net_http_pool_free_if_done(pool)) {
+		M_thread_mutex_unlock(pool->lock);
+	}
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+M_net_http_pool_t *M_net_http_pool_create(M_event_t *el)
+{
+	M_net_http_pool_t *pool;
+
+	if (el == NULL)
+		return NULL;
+
+	pool                  = M_malloc_zero(sizeof(*pool));
+	pool->el              = el;
+	pool->lock            = M_thread_mutex_create(M_THREAD_MUTEXATTR_NONE);
+	pool->hosts           = M_hash_strvp_create(8, 75, M_HASH_STRVP_CASECMP, M_net_http_pool_host_destroy);
+	pool->max_per_host    = 6;
+	pool->idle_timeout_ms = 30000;
+
+	return pool;
+}
+
+void M_net_http_pool_destroy(M_net_http_pool_t *pool)
+{
+	M_net_http_pool_host_t *phost;
+	M_net_http_pool_conn_t *conn;
+	M_hash_strvp_enum_t    *he;
+	M_list_t               *hosts;
+	const char             *key;
+	size_t                  len;
+	size_t                  i;
+
+	if (pool == NULL)
+		return;
+
+	M_thread_mutex_lock(pool->lock);
+	pool->destroyed = M_TRUE;
+
+	/* Closing idle connections can remove hosts so they can't be
+	 * removed while enumerating. */
+	hosts = M_list_create(NULL, M_LIST_NONE);
+	M_hash_strvp_enumerate(pool->hosts, &he);
+	while (M_hash_strvp_enumerate_next(pool->hosts, he, &key, (void **)&phost)) {
+		M_list_insert(hosts, phost);
+	}
+	M_hash_strvp_enumerate_free(he);
+
+	len = M_list_len(hosts);
+	for (i=0; i<len; i++) {
+		phost = M_CAST_OFF_CONST(M_net_http_pool_host_t *, M_list_at(hosts, i));
+		while (M_llist_len(phost->idle) != 0) {
+			/* Destroyed outright because the event loop may not run
+			 * again to finish a graceful disconnect. */
+			conn = M_llist_node_val(M_llist_first(phost->idle));
+			M_io_destroy(conn->io);
+			M_net_http_pool_conn_remove(conn);
+		}
+		/* Requests still waiting get their own connections. */
+		M_net_http_pool_schedule_dispatch(pool, phost);
+		M_net_http_pool_host_cleanup(pool, phost);
+	}
+	M_list_destroy(hosts, M_FALSE);
+
+	if (!M_net_http_pool_free_if_done(pool)) {
+		M_thread_mutex_unlock(pool->lock);
+	}
+}
+
+void M_net_http_pool_set_max_per_host(M_net_http_pool_t *pool, size_t max)
+{
+	if (pool == NULL)
+		return;
+
+	M_thread_mutex_lock(pool->lock);
+	pool->max_per_host = max;
+	M_thread_mutex_unlock(pool->lock);
+}
+
+void M_net_http_pool_set_idle_timeout(M_net_http_pool_t *pool, M_uint64 idle_ms)
+{
+	if (pool == NULL)
+		return;
+
+	M_thread_mutex_lock(pool->lock);
+	pool->idle_timeout_ms = idle_ms;
+	M_thread_mutex_unlock(pool->lock);
+}
+
+void M_net_http_pool_stats(M_net_http_pool_t *pool, M_uint64 *hits, M_uint64 *misses)
+{
+	if (hits != NULL)
+		*hits = 0;
+	if (misses != NULL)
+		*misses = 0;
+
+	if (pool == NULL)
+		return;
+
+	M_thread_mutex_lock(pool->lock);
+	if (hits != NULL)
+		*hits = pool->hits;
+	if (misses != NULL)
+		*misses = pool->misses;
+	M_thread_mutex_unlock(pool->lock);
+}
+
+size_t M_net_http_pool_host_connections(M_net_http_pool_t *pool, const char *host, M_uint16 port, size_t *idle)
+{
+	M_net_http_pool_host_t *phost;
+	M_hash_strvp_enum_t    *he;
+	const char             *key;
+	size_t                  active = 0;
+	size_t                  myidle;
+
+	if (idle == NULL)
+		idle = &myidle;
+	*idle = 0;
+
+	if (pool == NULL || M_str_isempty(host))
+		return 0;
+
+	M_thread_mutex_lock(pool->lock);
+	/* A host can have connections under multiple TLS contexts. */
+	M_hash_strvp_enumerate(pool->hosts, &he);
+	while (M_hash_strvp_enumerate_next(pool->hosts, he, &key, (void **)&phost)) {
+		if (phost->port != port || !M_str_caseeq(phost->host, host))
+			continue;
+		active += phost->active;
+		*idle  += M_llist_len(phost->idle);
+	}
+	M_hash_strvp_enumerate_free(he);
+	M_thread_mutex_unlock(pool->lock);
+
+	return active + *idle;
+}
@@ -45,6 +45,15 @@ struct M_net_http_simple {
 	M_io_t            *io;
 	M_parser_t        *read_parser;
 	M_buf_t           *header_buf;
+	char              *url;
+
+	M_net_http_pool_t      *pool;
+	M_net_http_pool_host_t *pool_host;
+	M_bool                  pool_waiting;
+	M_bool                  io_reused;
+	M_bool                  io_keepalive;
+	unsigned char          *request;     /*!< Copy of the request headers for retrying on a new connection. */
+	size_t                  request_len;
 
 	char              *proxy_server;
 	char              *proxy_auth;
@@ -88,7 +97,27 @@ static void io_disconnect_and_destroy(M_net_http_simple_t *hs)
 {
 	M_io_state_t state;
 
-	if (hs == NULL || hs->io == NULL)
+	if (hs == NULL)
+		return;
+
+	if (hs->pool_waiting) {
+		M_net_http_pool_cancel_wait(hs->pool, hs->pool_host, hs);
+		hs->pool_waiting = M_FALSE;
+		hs->pool_host    = NULL;
+		return;
+	}
+
+	/* The pool decides if the connection is kept or closed. */
+	if (hs->pool_host != NULL) {
+		M_net_http_pool_release(hs->pool, hs->pool_host, hs->io, hs->io_keepalive);
+		hs->pool_host    = NULL;
+		hs->io           = NULL;
+		hs->io_reused    = M_FALSE;
+		hs->io_keepalive = M_FALSE;
+		return;
+	}
+
+	if (hs->io == NULL)
 		return;
 
 	state = M_io_get_state(hs->io);
@@ -113,9 +142,17 @@ static void M_net_http_simple_destroy(M_net_http_simple_t *hs)
 	M_buf_cancel(hs->header_buf);
 	M_http_simple_read_destroy(hs->simple);
 	M_hash_dict_destroy(hs->headers);
+	M_free(hs->user_agent);
+	M_free(hs->content_type);
+	M_free(hs->charset);
 	M_free(hs->message);
 	M_free(hs->proxy_server);
 	M_free(hs->proxy_auth);
+	M_free(hs->url);
+	M_free(hs->request);
+
+	if (hs->pool != NULL)
+		M_net_http_pool_detach(hs->pool);
 
 	M_free(hs);
 }
@@ -198,6 +235,10 @@ static void call_done(M_net_http_simple_t *hs)
 	M_event_timer_stop(hs->timer_stall);
 	M_event_timer_stop(hs->timer_overall);
 
+	/* Give the connection back before the callback so a request made
+	 * from within the callback can use it. */
+	io_disconnect_and_destroy(hs);
+
 	hs->done_cb(hs->neterr, hs->httperr, hs->simple, hs->error, hs->thunk);
 
 	/* DO NOT USE hs after this point. Nothing can set
@@ -282,6 +323,16 @@ static void M_net_http_simple_ready_send(M_net_http_simple_t *hs)
 	io_disconnect_and_destroy(hs);
 }
 
+/* The server the connection is made to. */
+static void connection_target(M_net_http_simple_t *hs, const char *url, char **hostname, M_uint16 *port)
+{
+	if (hs->proxy_server == NULL) {
+		split_url(url, hostname, port, NULL);
+	} else {
+		split_url(hs->proxy_server, hostname, port, NULL);
+	}
+}
+
 static M_bool setup_io(M_net_http_simple_t *hs, const char *url)
 {
 	char         *hostname;
@@ -289,11 +340,7 @@ static M_bool setup_io(M_net_http_simple_t *hs, const char *url)
 	M_io_error_t  ioerr;
 	size_t        lid;
 
-	if (hs->proxy_server == NULL) {
-		split_url(url, &hostname, &port, NULL);
-	} else {
-		split_url(hs->proxy_server, &hostname, &port, NULL);
-	}
+	connection_target(hs, url, &hostname, &port);
 	ioerr = M_io_net_client_create(&hs->io, hs->dns, hostname, port, M_IO_NET_ANY);
 	M_free(hostname);
 	if (ioerr != M_IO_ERROR_SUCCESS) {
@@ -427,6 +474,83 @@ static M_bool write_data(M_io_t *io, M_net_http_simple_t *hs)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+static M_bool connect_io(M_net_http_simple_t *hs);
+
+/* Put the object back into the state it was in before it tried to send the
+ * request so it can be sent on a different connection. */
+static void reset_request(M_net_http_simple_t *hs)
+{
+	io_disconnect_and_destroy(hs);
+
+	M_buf_truncate(hs->header_buf, 0);
+	M_buf_add_bytes(hs->header_buf, hs->request, hs->request_len);
+	hs->message_pos = 0;
+
+	hs->neterr   = M_NET_ERROR_SUCCESS;
+	hs->error[0] = '\0';
+}
+
+/* A server can close an idle connection at the same time we send a request
+ * on it. When nothing was received, send it again on another connection.
+ * The server could have acted on the request so only requests that are safe
+ * to repeat are retried. */
+static M_bool retry_reused_io(M_net_http_simple_t *hs)
+{
+	if (!hs->io_reused || M_parser_len(hs->read_parser) != 0)
+		return M_FALSE;
+
+	switch (hs->method) {
+		case M_HTTP_METHOD_GET:
+		case M_HTTP_METHOD_HEAD:
+		case M_HTTP_METHOD_PUT:
+		case M_HTTP_METHOD_DELETE:
+		case M_HTTP_METHOD_OPTIONS:
+		case M_HTTP_METHOD_TRACE:
+			break;
+		default:
+			return M_FALSE;
+	}
+
+	reset_request(hs);
+	if (!connect_io(hs))
+		call_done(hs);
+	return M_TRUE;
+}
+
+/* Only a connection where the full request was sent and the full response
+ * was read can be used by another request. */
+static M_bool keepalive_allowed(M_net_http_simple_t *hs)
+{
+	char             *conn;
+	M_http_version_t  version;
+	M_bool            ret;
+
+	if (hs->pool_host == NULL || hs->io == NULL)
+		return M_FALSE;
+
+	if (M_buf_len(hs->header_buf) != 0 || hs->message_pos != hs->message_len || M_parser_len(hs->read_parser) != 0)
+		return M_FALSE;
+
+	/* We asked for the connection to be closed. */
+	if (M_str_casestr(M_hash_dict_get_direct(hs->headers, "Connection"), "close") != NULL)
+		return M_FALSE;
+
+	/* Persistent connections are the default with 1.1 but have to be
+	 * asked for with 1.0. */
+	conn    = M_http_simple_read_header(hs->simple, "Connection");
+	version = M_http_simple_read_version(hs->simple);
+	if (version == M_HTTP_VERSION_1_1) {
+		ret = M_str_casestr(conn, "close") == NULL;
+	} else {
+		ret = version == M_HTTP_VERSION_1_0 && M_str_casestr(conn, "keep-alive") != NULL;
+	}
+	M_free(conn);
+
+	return ret;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 static void run_cb(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
 {
 	M_net_http_simple_t *hs = thunk;
@@ -454,6 +578,7 @@ static void run_cb(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
 			M_parser_mark(hs->read_parser);
 			httperr = M_http_simple_read_parser(&hs->simple, hs->read_parser, M_HTTP_SIMPLE_READ_NONE);
 			if (httperr == M_HTTP_ERROR_SUCCESS) {
+				hs->io_keepalive = keepalive_allowed(hs);
 				process_response(hs);
 			} else if (httperr == M_HTTP_ERROR_MOREDATA || httperr == M_HTTP_ERROR_SUCCESS_MORE_POSSIBLE) {
 				/* More possible means we didn't get a content-length so we don't
@@ -486,6 +611,8 @@ static void run_cb(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
 			 *
 			 * We'll do a final check on the data because we might not have gotten
 			 * content-length and this is how we'd know when all data is sent. */
+			if (retry_reused_io(hs))
+				break;
 			httperr = M_http_simple_read_parser(&hs->simple, hs->read_parser, M_HTTP_SIMPLE_READ_NONE);
 			if (httperr == M_HTTP_ERROR_SUCCESS || httperr == M_HTTP_ERROR_SUCCESS_MORE_POSSIBLE) {
 				process_response(hs);
@@ -496,6 +623,8 @@ static void run_cb(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
 			call_done(hs);
             break;
         case M_EVENT_TYPE_ERROR:
+			if (retry_reused_io(hs))
+				break;
 			hs->neterr = M_net_io_error_to_net_error(M_io_get_error(io));
 			M_io_get_error_string(io, hs->error, sizeof(hs->error));
 			call_done(hs);
@@ -508,6 +637,99 @@ static void run_cb(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+static M_bool start_new_io(M_net_http_simple_t *hs)
+{
+	/* Create our io object. */
+	if (!setup_io(hs, hs->url)) {
+		/* Let the pool know the connection it reserved won't be used. */
+		io_disconnect_and_destroy(hs);
+		return M_FALSE;
+	}
+
+	timer_start_connect(hs);
+
+	/* Add the object to the io object to the loop. */
+	if (!M_event_add(hs->el, hs->io, run_cb, hs)) {
+		hs->neterr = M_NET_ERROR_INTERNAL;
+		M_snprintf(hs->error, sizeof(hs->error), "Event error: Failed to start");
+		io_disconnect_and_destroy(hs);
+		return M_FALSE;
+	}
+
+	return M_TRUE;
+}
+
+/* An idle connection is already established so the request can be written
+ * right away. */
+static M_bool start_reused_io(M_net_http_simple_t *hs, M_io_t *io)
+{
+	hs->io        = io;
+	hs->io_reused = M_TRUE;
+	M_event_edit_io_cb(io, run_cb, hs);
+	return write_data(io, hs);
+}
+
+static M_bool connect_io(M_net_http_simple_t *hs)
+{
+	M_tls_clientctx_t *ctx = NULL;
+	M_io_t            *io;
+	char              *hostname;
+	M_uint16           port;
+	M_bool             ret = M_TRUE;
+	M_bool             done = M_FALSE;
+
+	if (hs->pool == NULL)
+		return start_new_io(hs);
+
+	if (M_str_caseeq_start(hs->url, "https://"))
+		ctx = hs->ctx;
+
+	connection_target(hs, hs->url, &hostname, &port);
+	while (!done) {
+		switch (M_net_http_pool_acquire(hs->pool, hostname, port, ctx, hs, &hs->pool_host, &io)) {
+			case M_NET_HTTP_POOL_ACQUIRE_WAIT:
+				hs->pool_waiting = M_TRUE;
+				done             = M_TRUE;
+				break;
+			case M_NET_HTTP_POOL_ACQUIRE_NEW:
+				ret  = start_new_io(hs);
+				done = M_TRUE;
+				break;
+			case M_NET_HTTP_POOL_ACQUIRE_IDLE:
+				if (start_reused_io(hs, io)) {
+					done = M_TRUE;
+					break;
+				}
+				/* The connection went bad while idle. Try another. */
+				reset_request(hs);
+				break;
+		}
+	}
+	M_free(hostname);
+
+	return ret;
+}
+
+void M_net_http_simple_pool_start(M_net_http_simple_t *hs, M_io_t *io)
+{
+	hs->pool_waiting = M_FALSE;
+
+	if (io == NULL) {
+		if (!start_new_io(hs))
+			call_done(hs);
+		return;
+	}
+
+	if (start_reused_io(hs, io))
+		return;
+
+	reset_request(hs);
+	if (!connect_io(hs))
+		call_done(hs);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
 M_net_http_simple_t *M_net_http_simple_create(M_event_t *el, M_dns_t *dns, M_net_http_simple_done_cb done_cb)
 {
 	M_net_http_simple_t *hs;
@@ -601,6 +823,24 @@ void M_net_http_simple_set_iocreate(M_net_http_simple_t *hs, M_net_http_simple_i
 	hs->iocreate_cb = iocreate_cb;
 }
 
+M_bool M_net_http_simple_set_pool(M_net_http_simple_t *hs, M_net_http_pool_t *pool)
+{
+	if (hs == NULL || pool == NULL || hs->pool_host != NULL)
+		return M_FALSE;
+
+	if (hs->pool == pool)
+		return M_TRUE;
+
+	if (!M_net_http_pool_attach(pool, hs->el))
+		return M_FALSE;
+
+	if (hs->pool != NULL)
+		M_net_http_pool_detach(hs->pool);
+	hs->pool = pool;
+
+	return M_TRUE;
+}
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 void M_net_http_simple_set_message(M_net_http_simple_t *hs, M_http_method_t method, const char *user_agent, const char *content_type, const char *charset, const M_hash_dict_t *headers, const unsigned char *message, size_t message_len)
@@ -663,13 +903,8 @@ M_bool M_net_http_simple_send(M_net_http_simple_t *hs, const char *url, void *th
 
 	hs->thunk = thunk;
 
-	/* Create our io object. */
-	if (!setup_io(hs, url))
-		return M_FALSE;
-
-	/* Setup read and write buffer. */
-	hs->header_buf  = M_buf_create();
-	hs->read_parser = M_parser_create(M_PARSER_FLAG_NONE);
+	M_free(hs->url);
+	hs->url = M_strdup(url);
 
 	/* Add the data to the write buf. */
 	split_url(url, &host, &port, &uri);
@@ -691,19 +926,22 @@ M_bool M_net_http_simple_send(M_net_http_simple_t *hs, const char *url, void *th
 	M_free(host);
 	M_free(uri);
 
+	/* Keep the request around in case it needs to be sent
+	 * again on a different connection. */
+	if (hs->pool != NULL) {
+		M_free(hs->request);
+		hs->request_len = M_buf_len(hs->header_buf);
+		hs->request     = M_memdup(M_buf_peek(hs->header_buf), hs->request_len);
+	}
+
+	/* Get a connection and start sending. */
+	if (!connect_io(hs))
+		return M_FALSE;
+
 	/* Start/reset our timers. */
-	timer_start_connect(hs);
 	timer_start_stall(hs);
 	/* Will only ever be started once. */
 	timer_start_overall(hs);
 
-	/* Add the object to the io object to the loop. */
-	if (!M_event_add(hs->el, hs->io, run_cb, hs)) {
-		hs->neterr = M_NET_ERROR_INTERNAL;
-		M_snprintf(hs->error, sizeof(hs->error), "Event error: Failed to start");
-		io_disconnect_and_destroy(hs);
-		return M_FALSE;
-	}
-
 	return M_TRUE;
 }
@@ -34,4 +34,34 @@
 
 M_net_error_t M_net_io_error_to_net_error(M_io_error_t ioerr);
 
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+typedef struct M_net_http_pool_host M_net_http_pool_host_t;
+
+typedef enum {
+	M_NET_HTTP_POOL_ACQUIRE_IDLE = 0, /*!< An idle connection was handed out. */
+	M_NET_HTTP_POOL_ACQUIRE_NEW,      /*!< A new connection can be created. */
+	M_NET_HTTP_POOL_ACQUIRE_WAIT      /*!< The host is at its connection limit. The request will be
+	                                       started with M_net_http_simple_pool_start once one is available. */
+} M_net_http_pool_acquire_t;
+
+/* Get a connection for a request. phost must be passed to release (or cancel_wait
+ * when waiting). io is only set for M_NET_HTTP_POOL_ACQUIRE_IDLE. */
+M_net_http_pool_acquire_t M_net_http_pool_acquire(M_net_http_pool_t *pool, const char *host, M_uint16 port, M_tls_clientctx_t *ctx, M_net_http_simple_t *hs, M_net_http_pool_host_t **phost, M_io_t **io);
+
+/* Return a connection. It's kept if keepalive is set otherwise it's closed. io
+ * can be NULL if a new connection failed to be created. */
+void M_net_http_pool_release(M_net_http_pool_t *pool, M_net_http_pool_host_t *phost, M_io_t *io, M_bool keepalive);
+
+/* Stop waiting for a connection. */
+void M_net_http_pool_cancel_wait(M_net_http_pool_t *pool, M_net_http_pool_host_t *phost, M_net_http_simple_t *hs);
+
+/* Requests hold a reference to the pool. Attach fails if the pool isn't on the same event loop. */
+M_bool M_net_http_pool_attach(M_net_http_pool_t *pool, M_event_t *el);
+void M_net_http_pool_detach(M_net_http_pool_t *pool);
+
+/* Start a request that was waiting for a connection. io is NULL if a new
+ * connection needs to be created. */
+void M_net_http_simple_pool_start(M_net_http_simple_t *hs, M_io_t *io);
+
 #endif /* __M_NET_INT_H__ */
@@ -0,0 +1,261 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "m_config.h"
+#include <mstdlib/mstdlib_sql.h>
+#include <mstdlib/mstdlib_io.h>
+#include <mstdlib/sql/m_sql_driver.h>
+#include "base/m_defs_int.h"
+#include "m_sql_int.h"
+
+/* Drivers only provide blocking calls so requests are run on worker threads
+ * and the result is handed back to the caller's event loop. Workers are only
+ * spawned when there is work and exit after being idle for a while. */
+#define M_SQL_ASYNC_IDLE_MS 10000
+
+struct M_sql_async {
+	M_thread_mutex_t      *lock;
+	M_threadpool_t        *threadpool;
+	M_threadpool_parent_t *parent;
+
+	size_t                 queued;        /*!< Requests waiting for a worker */
+	size_t                 running;       /*!< Requests executing or waiting to be delivered */
+	M_uint64               completed;     /*!< Requests delivered */
+	M_uint64               wait_total_ms; /*!< Sum of time completed requests spent waiting for a worker */
+	M_uint64               wait_max_ms;   /*!< Longest time a request spent waiting for a worker */
+};
+
+typedef struct {
+	M_sql_async_t          *async;
+	M_sql_connpool_t       *pool;
+	M_event_t              *event;
+	M_timeval_t             queued_tv;
+	M_sql_error_t           err;
+	void                   *thunk;
+
+	/* Statement */
+	M_sql_stmt_t           *stmt;
+	M_sql_stmt_execute_cb   stmt_cb;
+
+	/* Transaction */
+	M_sql_isolation_t       isolation;
+	M_sql_trans_commands_t  cmd;
+	void                   *cmd_arg;
+	M_sql_trans_process_cb  trans_cb;
+	char                    error[256];
+} M_sql_async_req_t;
+
+
+M_sql_async_t *M_sql_async_create(size_t workers)
+{
+	M_sql_async_t *async;
+
+	if (workers == 0)
+		workers = 1;
+
+	async             = M_malloc_zero(sizeof(*async));
+	async->lock       = M_thread_mutex_create(M_THREAD_MUTEXATTR_NONE);
+	/* Unbounded queue so dispatching never blocks the event loop. */
+	async->threadpool = M_threadpool_create(0, workers, M_SQL_ASYNC_IDLE_MS, SIZE_MAX);
+	async->parent     = M_threadpool_parent_create(async->threadpool);
+
+	return async;
+}
+
+
+M_bool M_sql_async_in_use(M_sql_async_t *async)
+{
+	M_bool in_use;
+
+	if (async == NULL)
+		return M_FALSE;
+
+	M_thread_mutex_lock(async->lock);
+	in_use = (async->queued != 0 || async->running != 0) ? M_TRUE : M_FALSE;
+	M_thread_mutex_unlock(async->lock);
+
+	return in_use;
+}
+
+
+void M_sql_async_destroy(M_sql_async_t *async)
+{
+	if (async == NULL)
+		return;
+
+	/* Delivery happens before the task returns to the threadpool. */
+	M_threadpool_parent_wait(async->parent);
+	M_threadpool_parent_destroy(async->parent);
+	M_threadpool_destroy(async->threadpool);
+	M_thread_mutex_destroy(async->lock);
+	M_free(async);
+}
+
+
+void M_sql_async_stats(M_sql_async_t *async, size_t *queued, size_t *running, M_uint64 *wait_avg_ms, M_uint64 *wait_max_ms)
+{
+	size_t   q   = 0;
+	size_t   r   = 0;
+	M_uint64 avg = 0;
+	M_uint64 max = 0;
+
+	if (async != NULL) {
+		M_thread_mutex_lock(async->lock);
+		q   = async->queued;
+		r   = async->running;
+		max = async->wait_max_ms;
+		if (async->completed != 0)
+			avg = async->wait_total_ms / async->completed;
+		M_thread_mutex_unlock(async->lock);
+	}
+
+	if (queued != NULL)
+		*queued = q;
+	if (running != NULL)
+		*running = r;
+	if (wait_avg_ms != NULL)
+		*wait_avg_ms = avg;
+	if (wait_max_ms != NULL)
+		*wait_max_ms = max;
+}
+
+
+/* Runs in the caller's event loop. */
+static void M_sql_async_deliver(M_event_t *event, M_event_type_t type, M_io_t *io, void *cb_arg)
+{
+	M_sql_async_req_t *req   = cb_arg;
+	M_sql_async_t     *async = req->async;
+
+	(void)event;
+	(void)type;
+	(void)io;
+
+	/* Update before calling the callback so the pool can be destroyed from
+	 * within it. */
+	M_thread_mutex_lock(async->lock);
+	async->running--;
+	async->completed++;
+	M_thread_mutex_unlock(async->lock);
+
+	if (req->stmt_cb != NULL) {
+		req->stmt_cb(req->stmt, req->err, req->thunk);
+	} else {
+		req->trans_cb(req->err, req->error, req->thunk);
+	}
+
+	M_free(req);
+}
+
+
+/* Runs on a worker thread. */
+static void M_sql_async_task(void *arg)
+{
+	M_sql_async_req_t *req   = arg;
+	M_sql_async_t     *async = req->async;
+	M_uint64           wait_ms;
+
+	wait_ms = M_time_elapsed(&req->queued_tv);
+
+	M_thread_mutex_lock(async->lock);
+	async->queued--;
+	async->running++;
+	async->wait_total_ms += wait_ms;
+	if (wait_ms > async->wait_max_ms)
+		async->wait_max_ms = wait_ms;
+	M_thread_mutex_unlock(async->lock);
+
+	if (req->stmt != NULL) {
+		req->err = M_sql_stmt_execute(req->pool, req->stmt);
+	} else {
+		req->err = M_sql_trans_process(req->pool, req->isolation, req->cmd, req->cmd_arg, req->error, sizeof(req->error));
+	}
+
+	M_event_queue_task(req->event, M_sql_async_deliver, req);
+}
+
+
+static M_bool M_sql_async_dispatch(M_sql_async_req_t *req)
+{
+	M_sql_async_t *async = M_sql_connpool_get_async(req->pool);
+
+	if (async == NULL)
+		return M_FALSE;
+
+	req->async = async;
+	M_time_elapsed_start(&req->queued_tv);
+
+	M_thread_mutex_lock(async->lock);
+	async->queued++;
+	M_thread_mutex_unlock(async->lock);
+
+	M_threadpool_dispatch(async->parent, M_sql_async_task, (void **)&req, 1);
+	return M_TRUE;
+}
+
+
+M_bool M_sql_stmt_execute_async(M_sql_connpool_t *pool, M_sql_stmt_t *stmt, M_event_t *event, M_sql_stmt_execute_cb done_cb, void *thunk)
+{
+	M_sql_async_req_t *req;
+
+	/* Group inserts are tied to the thread that prepared them because the
+	 * group lock is held until execute. */
+	if (pool == NULL || stmt == NULL || event == NULL || done_cb == NULL || stmt->group_lock != NULL)
+		return M_FALSE;
+
+	req          = M_malloc_zero(sizeof(*req));
+	req->pool    = pool;
+	req->event   = event;
+	req->stmt    = stmt;
+	req->stmt_cb = done_cb;
+	req->thunk   = thunk;
+
+	if (!M_sql_async_dispatch(req)) {
+		M_free(req);
+		return M_FALSE;
+	}
+	return M_TRUE;
+}
+
+
+M_bool M_sql_trans_process_async(M_sql_connpool_t *pool, M_sql_isolation_t isolation, M_sql_trans_commands_t cmd, void *cmd_arg, M_event_t *event, M_sql_trans_process_cb done_cb, void *thunk)
+{
+	M_sql_async_req_t *req;
+
+	if (pool == NULL || cmd == NULL || event == NULL || done_cb == NULL)
+		return M_FALSE;
+
+	req            = M_malloc_zero(sizeof(*req));
+	req->pool      = pool;
+	req->event     = event;
+	req->isolation = isolation;
+	req->cmd       = cmd;
+	req->cmd_arg   = cmd_arg;
+	req->trans_cb  = done_cb;
+	req->thunk     = thunk;
+
+	if (!M_sql_async_dispatch(req)) {
+		M_free(req);
+		return M_FALSE;
+	}
+	return M_TRUE;
+}
@@ -0,0 +1,251 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "m_config.h"
+#include <mstdlib/mstdlib_sql.h>
+#include <mstdlib/sql/m_sql_driver.h>
+#include "base/m_defs_int.h"
+#include "m_sql_int.h"
+
+#define M_SQL_BULKLOAD_ROWS_PER_COMMIT 10000
+
+struct M_sql_bulkload {
+	M_sql_connpool_t *pool;
+	char             *table_name;
+	M_list_str_t     *cols;
+	size_t            rows_per_commit;
+	M_sql_stmt_t     *stmt;       /*!< Holds the bound rows of the current batch */
+	size_t            num_rows;   /*!< Rows in the current batch */
+	M_uint64          total_rows; /*!< Rows committed */
+	M_timeval_t       start_tv;
+	M_uint64          elapsed_ms; /*!< Time spent up to the last commit */
+};
+
+
+M_sql_bulkload_t *M_sql_bulkload_create(M_sql_connpool_t *pool, const char *table_name, size_t rows_per_commit)
+{
+	M_sql_bulkload_t *bulk;
+
+	if (pool == NULL || M_str_isempty(table_name))
+		return NULL;
+
+	if (rows_per_commit == 0)
+		rows_per_commit = M_SQL_BULKLOAD_ROWS_PER_COMMIT;
+
+	bulk                  = M_malloc_zero(sizeof(*bulk));
+	bulk->pool            = pool;
+	bulk->table_name      = M_strdup(table_name);
+	bulk->cols            = M_list_str_create(M_LIST_STR_NONE);
+	bulk->rows_per_commit = rows_per_commit;
+
+	return bulk;
+}
+
+
+M_bool M_sql_bulkload_add_col(M_sql_bulkload_t *bulk, const char *col_name)
+{
+	if (bulk == NULL || M_str_isempty(col_name) || bulk->stmt != NULL)
+		return M_FALSE;
+
+	return M_list_str_insert(bulk->cols, col_name);
+}
+
+
+M_sql_stmt_t *M_sql_bulkload_stmt(M_sql_bulkload_t *bulk)
+{
+	M_buf_t *query;
+	size_t   len;
+	size_t   i;
+
+	if (bulk == NULL)
+		return NULL;
+
+	if (bulk->stmt != NULL)
+		return bulk->stmt;
+
+	len = M_list_str_len(bulk->cols);
+	if (len == 0)
+		return NULL;
+
+	/* Used as is by drivers without a native bulk load */
+	query = M_buf_create();
+	M_buf_add_str(query, "INSERT INTO \"");
+	M_buf_add_str(query, bulk->table_name);
+	M_buf_add_str(query, "\" (");
+	for (i=0; i<len; i++) {
+		if (i != 0)
+			M_buf_add_str(query, ", ");
+		M_buf_add_str(query, "\"");
+		M_buf_add_str(query, M_list_str_at(bulk->cols, i));
+		M_buf_add_str(query, "\"");
+	}
+	M_buf_add_str(query, ") VALUES (");
+	for (i=0; i<len; i++) {
+		if (i != 0)
+			M_buf_add_str(query, ", ");
+		M_buf_add_str(query, "?");
+	}
+	M_buf_add_str(query, ")");
+
+	bulk->stmt = M_sql_stmt_create();
+	if (M_sql_stmt_prepare_buf(bulk->stmt, query) != M_SQL_ERROR_SUCCESS) {
+		M_sql_stmt_destroy(bulk->stmt);
+		bulk->stmt = NULL;
+		return NULL;
+	}
+
+	M_time_elapsed_start(&bulk->start_tv);
+
+	return bulk->stmt;
+}
+
+
+static M_sql_error_t M_sql_bulkload_trans(M_sql_trans_t *trans, void *arg, char *error, size_t error_size)
+{
+	M_sql_bulkload_t     *bulk   = arg;
+	M_sql_conn_t         *conn   = M_sql_trans_get_conn(trans);
+	const M_sql_driver_t *driver = M_sql_conn_get_driver(conn);
+	M_sql_error_t         err;
+
+	/* Older driver structures don't have the callback at all */
+	if ((driver->driver_sys_version & 0xFF) < 0x02 || driver->cb_bulkload == NULL) {
+		err = M_sql_trans_execute(trans, bulk->stmt);
+		if (M_sql_error_is_error(err))
+			M_snprintf(error, error_size, "%s", M_sql_stmt_get_error_string(bulk->stmt));
+		return err;
+	}
+
+	M_sql_stmt_result_clear(bulk->stmt);
+	bulk->stmt->bind_row_offset = 0;
+
+	err = driver->cb_bulkload(conn, bulk->table_name, bulk->cols, bulk->stmt, error, error_size);
+
+	/* Catch a connectivity or rollback error */
+	M_sql_conn_set_state_from_error(conn, err);
+
+	return err;
+}
+
+
+M_sql_error_t M_sql_bulkload_flush(M_sql_bulkload_t *bulk, char *error, size_t error_size)
+{
+	M_sql_error_t err;
+	M_sql_stmt_t *stmt;
+	char          myerror[256];
+
+	if (error == NULL || error_size == 0) {
+		error      = myerror;
+		error_size = sizeof(myerror);
+	}
+	M_mem_set(error, 0, error_size);
+
+	if (bulk == NULL) {
+		M_snprintf(error, error_size, "invalid use");
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	if (bulk->num_rows == 0)
+		return M_SQL_ERROR_SUCCESS;
+
+	/* Drop the empty row started by the last M_sql_bulkload_row_finish() */
+	stmt = bulk->stmt;
+	if (stmt->bind_row_cnt > 0 && stmt->bind_rows[stmt->bind_row_cnt-1].col_cnt == 0)
+		stmt->bind_row_cnt--;
+
+	err = M_sql_trans_process(bulk->pool, M_SQL_ISOLATION_READCOMMITTED, M_sql_bulkload_trans, bulk, error, error_size);
+	if (!M_sql_error_is_error(err)) {
+		bulk->total_rows += bulk->num_rows;
+		err               = M_SQL_ERROR_SUCCESS;
+	}
+	bulk->elapsed_ms = M_time_elapsed(&bulk->start_tv);
+
+	M_sql_stmt_bind_clear(stmt);
+	M_sql_stmt_result_clear(stmt);
+	bulk->num_rows = 0;
+
+	return err;
+}
+
+
+M_sql_error_t M_sql_bulkload_row_finish(M_sql_bulkload_t *bulk, char *error, size_t error_size)
+{
+	M_sql_stmt_t *stmt;
+	size_t        col_cnt = 0;
+
+	if (bulk == NULL || bulk->stmt == NULL) {
+		M_snprintf(error, error_size, "no row bound");
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	stmt = bulk->stmt;
+	if (stmt->bind_row_cnt > 0)
+		col_cnt = stmt->bind_rows[stmt->bind_row_cnt-1].col_cnt;
+
+	if (col_cnt != M_list_str_len(bulk->cols)) {
+		M_snprintf(error, error_size, "row has %zu columns, expected %zu", col_cnt, M_list_str_len(bulk->cols));
+		M_sql_stmt_bind_clear_row(stmt);
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	bulk->num_rows++;
+	if (bulk->num_rows >= bulk->rows_per_commit)
+		return M_sql_bulkload_flush(bulk, error, error_size);
+
+	M_sql_stmt_bind_new_row(stmt);
+	return M_SQL_ERROR_SUCCESS;
+}
+
+
+void M_sql_bulkload_stats(M_sql_bulkload_t *bulk, M_uint64 *rows, M_uint64 *elapsed_ms, M_uint64 *rows_per_sec)
+{
+	M_uint64 r   = 0;
+	M_uint64 ms  = 0;
+	M_uint64 rps = 0;
+
+	if (bulk != NULL) {
+		r  = bulk->total_rows;
+		ms = bulk->elapsed_ms;
+		/* Anything under a millisecond counts as one */
+		rps = (r * 1000) / M_MAX(ms, 1);
+	}
+
+	if (rows != NULL)
+		*rows = r;
+	if (elapsed_ms != NULL)
+		*elapsed_ms = ms;
+	if (rows_per_sec != NULL)
+		*rows_per_sec = rps;
+}
+
+
+void M_sql_bulkload_destroy(M_sql_bulkload_t *bulk)
+{
+	if (bulk == NULL)
+		return;
+
+	M_sql_stmt_destroy(bulk->stmt);
+	M_list_str_destroy(bulk->cols);
+	M_free(bulk->table_name);
+	M_free(bulk);
+}
@@ -31,6 +31,7 @@
 typedef struct {
 	M_sql_conn_t        *conn;
 	M_sql_driver_stmt_t *stmt;
+	M_bool               removing; /*!< Being removed rather than evicted, for statistics */
 } M_sql_stmt_cache_t;
 
 
@@ -53,8 +54,23 @@ typedef struct {
 	size_t             host_idx;       /*!< Index of current host being used.  Incremented on failure of current index or when load balancing.
 	                                    *   May also revert when host_offline_t expires. */
 	size_t             num_hosts;      /*!< Number of hosts referenced by connection string (for load balancing or failover) */
-	size_t             num_waiters;    /*!< Count of waiters for an SQL connection to become idle */
+	volatile M_uint32  num_waiters;    /*!< Count of waiters for an SQL connection to become idle.  Modified with
+	                                    *   pool->lock held, but read atomically by the affinity fast path */
 	M_thread_cond_t   *cond;           /*!< Conditional used by waiters */
+
+	/* Thread affinity.  A connection released while nobody is waiting is parked rather than
+	 * returned to the idle list.  It stays in used_conns so the accounting against max_conns
+	 * is unchanged, and can be claimed without the pool lock by the thread that parked it
+	 * (via its affinity slot), or by anyone holding the pool lock. */
+	M_sql_conn_t     **by_id;          /*!< Established connections indexed by id, requires pool->lock to modify */
+	volatile M_uint32 *parked;         /*!< Per connection id, 1 if parked and claimable with M_atomic_cas32() */
+	volatile M_uint32  num_parked;     /*!< Number of connections currently parked */
+	volatile M_uint32 *affinity;       /*!< Indexed by hash of thread id, holds id + 1 of last connection parked by that thread */
+	size_t             affinity_mask;  /*!< Number of affinity slots - 1 */
+
+	/* Acquisition statistics, updated atomically */
+	volatile M_uint64  wait_hist[M_SQL_CONNPOOL_WAIT_BUCKETS]; /*!< Histogram of time spent in M_sql_connpool_acquire_conn() */
+	volatile M_uint64  affinity_hits;  /*!< Acquisitions satisfied from the thread's affinity slot */
 } M_sql_connpool_data_t;
 
 
@@ -65,7 +81,10 @@ struct M_sql_conn {
 	M_bool                 in_trans;         /*!< M_TRUE if in an SQL transaction, M_FALSE if a single SQL query */
 	M_sql_conn_state_t     state;            /*!< State of connection, used for forcing disconnects and tracking rollbacks */
 	M_sql_driver_conn_t   *conn;             /*!< Driver-specific connection object */
-	M_cache_strvp_t       *stmt_cache;       /*!< Client-side prepared statement cache */
+	M_cache_t             *stmt_cache;       /*!< Client-side prepared statement cache, keyed by statement registry id */
+	M_cache_strvp_t       *stmt_cache_sql;   /*!< Client-side prepared statement cache for queries without a registry id,
+	                                          *   keyed by query.  Created on first use. */
+	M_bool                 destroying;       /*!< Connection is being destroyed, cached statements aren't evicted */
 	M_sql_connpool_t      *pool;             /*!< Pointer to parent pool */
 	M_sql_connpool_data_t *pool_data;        /*!< Pointer to parent sub-pool (primary vs readonly) */
 
@@ -73,6 +92,8 @@ struct M_sql_conn {
 	M_timeval_t            start_tv;         /*!< Time connection was started (really before connect), but use this for reconnect_time_s too */
 	M_timeval_t            last_used_tv;     /*!< Time connection was last used, this is used for max_idle_time_s */
 	M_uint64               connect_time_ms;  /*!< This is how many milliseconds the connection took to establish */
+	M_timeval_t            busy_tv;          /*!< Time connection was last acquired from the pool */
+	volatile M_uint64      busy_ms;          /*!< Total milliseconds spent acquired, updated atomically on release */
 
 	/* Stall Monitoring, require lock of pool->lock to modify/read */
 	M_timeval_t            trans_start_tv;   /*!< Time transaction was started (if in_trans) */
@@ -111,6 +132,19 @@ struct M_sql_connpool {
 	M_rand_t                *rand;              /*!< Random state used for generating random ids and timers */
 
 	M_hash_strvp_t          *group_insert;      /*!< Query -> Stmt reference for group insert optimization */
+
+	M_sql_async_t           *async;             /*!< Worker threads for asynchronous execution, created on first use */
+	size_t                   async_workers;     /*!< Maximum worker threads, 0 to use the connection count */
+
+	M_sql_stmt_registry_t   *stmt_registry;     /*!< Query -> id shared by all connections' statement caches */
+	size_t                   stmt_cache_size;   /*!< Maximum prepared statements cached per connection */
+	size_t                   stmt_prepare_hot;  /*!< Number of most used statements to prepare on new connections */
+	volatile M_uint64        stmt_cache_hits;   /*!< Statement cache lookups that found a handle */
+	volatile M_uint64        stmt_cache_misses; /*!< Statement cache lookups that required a new prepare */
+	volatile M_uint64        stmt_cache_evicts; /*!< Handles dropped because a cache was full */
+
+	M_sql_result_cache_t    *result_cache;      /*!< Results of statements marked cacheable, disabled by default */
+	M_sql_profile_t         *profile;           /*!< Per-query execution statistics, disabled by default */
 };
 
 
@@ -200,6 +234,17 @@ static M_sql_error_t M_sql_driver_init(M_sql_driver_t **driver, M_sql_driver_t *
 		goto done;
 	}
 
+	/* Pipeline callbacks only exist in newer driver structures, and are all or nothing */
+	if (((*driver)->driver_sys_version & 0xFF) >= 0x01) {
+		M_bool has_any = ((*driver)->cb_pipeline_begin || (*driver)->cb_pipeline_flush || (*driver)->cb_pipeline_result || (*driver)->cb_pipeline_end) ? M_TRUE : M_FALSE;
+		M_bool has_all = ((*driver)->cb_pipeline_begin && (*driver)->cb_pipeline_flush && (*driver)->cb_pipeline_result && (*driver)->cb_pipeline_end) ? M_TRUE : M_FALSE;
+		if (has_any != has_all) {
+			M_snprintf(error, error_size, "Malformed module, incomplete pipeline callback(s)");
+			err = M_SQL_ERROR_CONN_DRIVERLOAD;
+			goto done;
+		}
+	}
+
 	/* Run driver custom init routine */
 	if ((*driver)->cb_init) {
 		if (!(*driver)->cb_init(error, error_size)) {
@@ -332,6 +377,10 @@ static M_sql_connpool_t *M_sql_connpool_init(M_sql_driver_t *driver, const char
 	pool->flags                   = flags;
 	pool->rand                    = M_rand_create(0);
 	pool->group_insert            = M_hash_strvp_create(16, 75, M_HASH_STRVP_NONE, NULL);
+	pool->stmt_registry           = M_sql_stmt_registry_create();
+	pool->stmt_cache_size         = 32;
+	pool->result_cache            = M_sql_result_cache_create();
+	pool->profile                 = M_sql_profile_create();
 
 	return pool;
 }
@@ -365,6 +414,11 @@ static M_bool M_sql_connpool_add_subpool(M_sql_connpool_t *pool, M_bool is_reado
 	data->used_conns     = M_queue_create(NULL, NULL);
 	data->info           = M_malloc_zero(sizeof(*data->info) * max_conns);
 	data->max_conns      = max_conns;
+	data->by_id          = M_malloc_zero(sizeof(*data->by_id) * max_conns);
+	data->parked         = M_malloc_zero(sizeof(*data->parked) * max_conns);
+	/* Oversize so threads rarely share a slot */
+	data->affinity_mask  = M_size_t_round_up_to_power_of_two(max_conns * 4) - 1;
+	data->affinity       = M_malloc_zero(sizeof(*data->affinity) * (data->affinity_mask + 1));
 	data->host_offline_t = M_malloc_zero(sizeof(*data->host_offline_t) * data->num_hosts);
 	return M_TRUE;
 }
@@ -382,7 +436,9 @@ static void M_sql_conn_destroy(M_sql_conn_t *conn, M_bool graceful)
 	M_time_elapsed_start(&conn->last_used_tv);
 
 	/* Clear cached statement handles */
-	M_cache_strvp_destroy(conn->stmt_cache);
+	conn->destroying = M_TRUE;
+	M_cache_destroy(conn->stmt_cache);
+	M_cache_strvp_destroy(conn->stmt_cache_sql);
 
 	if (conn->conn)
 		conn->pool->driver->cb_disconnect(conn->conn);
@@ -399,11 +455,49 @@ static void M_sql_stmt_cache_remove(void *arg)
 	M_sql_stmt_cache_t *cache = arg;
 	if (arg == NULL)
 		return;
+	if (!cache->removing && !cache->conn->destroying)
+		M_atomic_inc_u64(&cache->conn->pool->stmt_cache_evicts);
 	cache->conn->pool->driver->cb_prepare_destroy(cache->stmt);
 	M_free(cache);
 }
 
 
+/*! Prepare the most used statements on a new connection so the first requests
+ *  using it don't each pay for a prepare. */
+static void M_sql_conn_prepare_hot(M_sql_conn_t *conn)
+{
+	M_sql_connpool_t *pool   = conn->pool;
+	M_sql_driver_t   *driver = pool->driver;
+	M_uint32         *ids;
+	size_t            num_ids;
+	size_t            i;
+	char              error[256];
+
+	ids     = M_malloc_zero(sizeof(*ids) * pool->stmt_prepare_hot);
+	num_ids = M_sql_stmt_registry_hot(pool->stmt_registry, ids, pool->stmt_prepare_hot);
+
+	for (i=0; i<num_ids; i++) {
+		M_sql_stmt_t        *stmt  = M_sql_stmt_registry_template(pool->stmt_registry, ids[i]);
+		M_sql_driver_stmt_t *dstmt = NULL;
+
+		if (stmt == NULL)
+			continue;
+
+		/* Formatting may depend on the connection, only use it if it matches */
+		stmt->query_prepared = driver->cb_queryformat(conn, stmt->query_user, stmt->query_param_cnt, M_sql_driver_stmt_bind_rows(stmt), error, sizeof(error));
+		if (M_str_eq(stmt->query_prepared, M_sql_stmt_registry_query(pool->stmt_registry, ids[i]))) {
+			/* Same as execution, the handle is cached even on failure */
+			driver->cb_prepare(&dstmt, conn, stmt, error, sizeof(error));
+			M_sql_conn_set_stmt_cache(conn, stmt, dstmt);
+		}
+
+		M_sql_stmt_destroy(stmt);
+	}
+
+	M_free(ids);
+}
+
+
 /*! Requires pool to already be locked */
 static size_t M_sql_connpool_get_host_idx(M_sql_connpool_t *pool, M_bool readonly)
 {
@@ -468,6 +562,7 @@ static void M_sql_connpool_mark_host_idx_failed(M_sql_connpool_t *pool, size_t h
 
 static M_sql_error_t M_sql_conn_create(M_sql_conn_t **conn, M_sql_connpool_t *pool, size_t id, M_bool is_readonly, char *error, size_t error_size)
 {
+	struct M_cache_callbacks stmt_cache_cbs = { NULL, NULL, NULL, M_sql_stmt_cache_remove };
 	M_sql_error_t          err;
 	M_sql_connpool_data_t *pool_data = is_readonly?&pool->pool_readonly:&pool->pool_primary;
 	char                   myerror[512];
@@ -483,7 +578,7 @@ static M_sql_error_t M_sql_conn_create(M_sql_conn_t **conn, M_sql_connpool_t *po
 	(*conn)->id              = id;
 	(*conn)->pool            = pool;
 	(*conn)->pool_data       = pool_data;
-	(*conn)->stmt_cache      = M_cache_strvp_create(32, M_CACHE_STRVP_NONE /* Not CASECMP */, M_sql_stmt_cache_remove);
+	(*conn)->stmt_cache      = M_cache_create(pool->stmt_cache_size, NULL /* Key is the id itself */, NULL, M_CACHE_NONE, &stmt_cache_cbs);
 	(*conn)->state           = M_SQL_CONN_STATE_OK;
 
 	M_thread_mutex_lock(pool->lock);
@@ -506,6 +601,9 @@ static M_sql_error_t M_sql_conn_create(M_sql_conn_t **conn, M_sql_connpool_t *po
 			goto fail;
 	}
 
+	if (pool->stmt_prepare_hot > 0)
+		M_sql_conn_prepare_hot(*conn);
+
 	M_time_elapsed_start(&(*conn)->last_used_tv);
 	M_sql_trace_message_conn(M_SQL_TRACE_CONNECTED, *conn, M_SQL_ERROR_SUCCESS, NULL);
 
@@ -563,6 +661,7 @@ static M_sql_error_t M_sql_connpool_spawn(M_sql_connpool_t *pool, M_sql_connpool
 				pool->sql_serverversion = M_strdup(pool->driver->cb_serverversion(conn->conn));
 			}
 			/* Add connection to pool as idle */
+			pool_data->by_id[i] = conn;
 			M_llist_insert(pool_data->conns, conn);
 		}
 	}
@@ -668,12 +767,80 @@ M_bool M_sql_connpool_add_trace(M_sql_connpool_t *pool, M_sql_trace_cb_t cb, voi
 }
 
 
+/*! Atomic read of a value that is otherwise updated with M_atomic_*() */
+static M_uint32 M_sql_connpool_atomic_get32(volatile M_uint32 *ptr)
+{
+	return M_atomic_add_u32(ptr, 0);
+}
+
+
+static size_t M_sql_connpool_affinity_slot(const M_sql_connpool_data_t *pool_data)
+{
+	/* Thread ids tend to be aligned pointers, so mix before masking */
+	M_uint64 hash = (M_uint64)M_thread_self() * 0x9E3779B97F4A7C15ULL;
+	return (size_t)(hash >> 32) & pool_data->affinity_mask;
+}
+
+
+/*! Claim a parked connection.  Returns NULL if the connection wasn't parked. */
+static M_sql_conn_t *M_sql_connpool_unpark(M_sql_connpool_data_t *pool_data, size_t id)
+{
+	if (!M_atomic_cas32(&pool_data->parked[id], 1, 0))
+		return NULL;
+	M_atomic_dec_u32(&pool_data->num_parked);
+	return pool_data->by_id[id];
+}
+
+
+/*! Requires pool to already be locked. Claims any parked connection. */
+static M_sql_conn_t *M_sql_connpool_unpark_any(M_sql_connpool_data_t *pool_data)
+{
+	M_sql_conn_t *conn;
+	size_t        i;
+
+	if (pool_data->max_conns == 0 || M_sql_connpool_atomic_get32(&pool_data->num_parked) == 0)
+		return NULL;
+
+	for (i=0; i<pool_data->max_conns; i++) {
+		conn = M_sql_connpool_unpark(pool_data, i);
+		if (conn != NULL)
+			return conn;
+	}
+	return NULL;
+}
+
+
+/*! Requires pool to already be locked. Moves all parked connections to the idle list. */
+static void M_sql_connpool_unpark_all(M_sql_connpool_data_t *pool_data)
+{
+	M_sql_conn_t *conn;
+
+	while ((conn = M_sql_connpool_unpark_any(pool_data)) != NULL) {
+		M_queue_remove(pool_data->used_conns, conn);
+		M_llist_insert(pool_data->conns, conn);
+	}
+}
+
+
+/*! Requires pool to already be locked. Destroys a connection and frees its id. */
+static void M_sql_connpool_conn_remove(M_sql_connpool_data_t *pool_data, M_sql_conn_t *conn, M_sql_conn_info_t info, M_bool graceful)
+{
+	pool_data->info[conn->id]  = info;
+	pool_data->by_id[conn->id] = NULL;
+	M_sql_conn_destroy(conn, graceful);
+}
+
+
 static M_sql_error_t M_sql_connpool_stop(M_sql_connpool_t *pool)
 {
 	M_sql_conn_t *conn;
 
 	M_thread_mutex_lock(pool->lock);
 
+	/* Parked connections are idle even though they're tracked as used */
+	M_sql_connpool_unpark_all(&pool->pool_primary);
+	M_sql_connpool_unpark_all(&pool->pool_readonly);
+
 	/* If in active use, fail to destroy */
 	if (M_queue_len(pool->pool_primary.used_conns) || pool->pool_primary.num_waiters || pool->pool_primary.new_conns ||
 	    M_queue_len(pool->pool_readonly.used_conns) || pool->pool_readonly.num_waiters || pool->pool_readonly.new_conns) {
@@ -800,17 +967,27 @@ M_sql_error_t M_sql_connpool_destroy(M_sql_connpool_t *pool)
 	if (pool == NULL)
 		return M_SQL_ERROR_SUCCESS;
 
+	if (M_sql_async_in_use(pool->async))
+		return M_SQL_ERROR_INUSE;
+
 	err = M_sql_connpool_stop(pool);
 	if (err != M_SQL_ERROR_SUCCESS)
 		return err;
 
 	/* Clean up */
+	M_sql_async_destroy(pool->async);
 	M_llist_destroy(pool->pool_primary.conns, M_TRUE);
 	M_queue_destroy(pool->pool_primary.used_conns);
 	M_llist_destroy(pool->pool_readonly.conns, M_TRUE);
 	M_queue_destroy(pool->pool_readonly.used_conns);
 	M_free(pool->pool_primary.info);
 	M_free(pool->pool_readonly.info);
+	M_free(pool->pool_primary.by_id);
+	M_free(pool->pool_readonly.by_id);
+	M_free(M_CAST_OFF_CONST(M_uint32 *, pool->pool_primary.parked));
+	M_free(M_CAST_OFF_CONST(M_uint32 *, pool->pool_readonly.parked));
+	M_free(M_CAST_OFF_CONST(M_uint32 *, pool->pool_primary.affinity));
+	M_free(M_CAST_OFF_CONST(M_uint32 *, pool->pool_readonly.affinity));
 	M_thread_cond_destroy(pool->pool_primary.cond);
 	M_thread_cond_destroy(pool->pool_readonly.cond);
 	M_free(pool->pool_primary.host_offline_t);
@@ -822,12 +999,147 @@ M_sql_error_t M_sql_connpool_destroy(M_sql_connpool_t *pool)
 	pool->driver->cb_destroypool(pool->dpool);
 	M_rand_destroy(pool->rand);
 	M_hash_strvp_destroy(pool->group_insert, M_TRUE);
+	M_sql_stmt_registry_destroy(pool->stmt_registry);
+	M_sql_result_cache_destroy(pool->result_cache);
+	M_sql_profile_destroy(pool->profile);
 	M_thread_mutex_destroy(pool->lock);
 	M_free(pool);
 	return M_SQL_ERROR_SUCCESS;
 }
 
 
+M_bool M_sql_connpool_set_stmt_cache(M_sql_connpool_t *pool, size_t max_stmts, size_t prepare_hot)
+{
+	if (pool == NULL || max_stmts == 0 || prepare_hot > max_stmts)
+		return M_FALSE;
+
+	M_thread_mutex_lock(pool->lock);
+	if (pool->started) {
+		M_thread_mutex_unlock(pool->lock);
+		return M_FALSE;
+	}
+
+	pool->stmt_cache_size  = max_stmts;
+	pool->stmt_prepare_hot = prepare_hot;
+	M_thread_mutex_unlock(pool->lock);
+	return M_TRUE;
+}
+
+
+void M_sql_connpool_stmt_cache_stats(M_sql_connpool_t *pool, M_uint64 *hits, M_uint64 *misses, M_uint64 *evictions, size_t *num_queries)
+{
+	if (hits != NULL)
+		*hits = (pool == NULL)?0:M_atomic_add_u64(&pool->stmt_cache_hits, 0);
+	if (misses != NULL)
+		*misses = (pool == NULL)?0:M_atomic_add_u64(&pool->stmt_cache_misses, 0);
+	if (evictions != NULL)
+		*evictions = (pool == NULL)?0:M_atomic_add_u64(&pool->stmt_cache_evicts, 0);
+	if (num_queries != NULL)
+		*num_queries = (pool == NULL)?0:M_sql_stmt_registry_len(pool->stmt_registry);
+}
+
+
+M_bool M_sql_connpool_set_result_cache(M_sql_connpool_t *pool, size_t max_bytes)
+{
+	if (pool == NULL)
+		return M_FALSE;
+
+	M_sql_result_cache_set_max_bytes(pool->result_cache, max_bytes);
+	return M_TRUE;
+}
+
+
+void M_sql_connpool_result_cache_invalidate(M_sql_connpool_t *pool, const char *table)
+{
+	if (pool == NULL)
+		return;
+
+	M_sql_result_cache_invalidate(pool->result_cache, table);
+}
+
+
+void M_sql_connpool_result_cache_stats(M_sql_connpool_t *pool, M_uint64 *hits, M_uint64 *misses, size_t *entries, size_t *bytes)
+{
+	M_sql_result_cache_stats((pool == NULL)?NULL:pool->result_cache, hits, misses, entries, bytes);
+}
+
+
+M_sql_result_cache_t *M_sql_connpool_get_result_cache(M_sql_connpool_t *pool)
+{
+	if (pool == NULL)
+		return NULL;
+	return pool->result_cache;
+}
+
+
+M_sql_profile_t *M_sql_connpool_get_profile(M_sql_connpool_t *pool)
+{
+	if (pool == NULL)
+		return NULL;
+	return pool->profile;
+}
+
+
+M_bool M_sql_connpool_set_async_workers(M_sql_connpool_t *pool, size_t num)
+{
+	M_bool rv = M_FALSE;
+
+	if (pool == NULL)
+		return M_FALSE;
+
+	M_thread_mutex_lock(pool->lock);
+	if (pool->async == NULL) {
+		pool->async_workers = num;
+		rv                  = M_TRUE;
+	}
+	M_thread_mutex_unlock(pool->lock);
+
+	return rv;
+}
+
+
+M_sql_async_t *M_sql_connpool_get_async(M_sql_connpool_t *pool)
+{
+	M_sql_async_t *async;
+	size_t         workers;
+
+	if (pool == NULL)
+		return NULL;
+
+	M_thread_mutex_lock(pool->lock);
+	if (!pool->started) {
+		M_thread_mutex_unlock(pool->lock);
+		return NULL;
+	}
+
+	if (pool->async == NULL) {
+		/* More workers than connections would only wait on the pool. */
+		workers = pool->async_workers;
+		if (workers == 0)
+			workers = pool->pool_primary.max_conns + pool->pool_readonly.max_conns;
+		pool->async = M_sql_async_create(workers);
+	}
+	async = pool->async;
+	M_thread_mutex_unlock(pool->lock);
+
+	return async;
+}
+
+
+void M_sql_connpool_async_stats(M_sql_connpool_t *pool, size_t *queued, size_t *running, M_uint64 *wait_avg_ms, M_uint64 *wait_max_ms)
+{
+	M_sql_async_t *async = NULL;
+
+	if (pool != NULL) {
+		M_thread_mutex_lock(pool->lock);
+		async = pool->async;
+		M_thread_mutex_unlock(pool->lock);
+	}
+
+	M_sql_async_stats(async, queued, running, wait_avg_ms, wait_max_ms);
+}
+
+
 size_t M_sql_connpool_active_conns(M_sql_connpool_t *pool, M_bool readonly)
 {
 	size_t                 cnt;
@@ -851,6 +1163,75 @@ size_t M_sql_connpool_active_conns(M_sql_connpool_t *pool, M_bool readonly)
 }
 
 
+size_t M_sql_connpool_idle_conns(M_sql_connpool_t *pool, M_bool readonly)
+{
+	size_t                 cnt;
+	M_sql_connpool_data_t *pool_data;
+	if (pool == NULL)
+		return 0;
+
+	M_thread_mutex_lock(pool->lock);
+
+	if (readonly) {
+		pool_data = &pool->pool_readonly;
+	} else {
+		pool_data = &pool->pool_primary;
+	}
+	/* Parked connections are tracked as used but aren't checked out */
+	cnt = M_llist_len(pool_data->conns) + M_sql_connpool_atomic_get32(&pool_data->num_parked);
+
+	M_thread_mutex_unlock(pool->lock);
+
+	return cnt;
+}
+
+
+void M_sql_connpool_acquire_stats(M_sql_connpool_t *pool, M_bool readonly, M_uint64 *wait_hist, M_uint64 *affinity_hits)
+{
+	M_sql_connpool_data_t *pool_data = NULL;
+	size_t                 i;
+
+	if (pool != NULL)
+		pool_data = (readonly && pool->pool_readonly.max_conns > 0)?&pool->pool_readonly:&pool->pool_primary;
+
+	if (wait_hist != NULL) {
+		for (i=0; i<M_SQL_CONNPOOL_WAIT_BUCKETS; i++) {
+			wait_hist[i] = (pool_data == NULL)?0:M_atomic_add_u64(&pool_data->wait_hist[i], 0);
+		}
+	}
+
+	if (affinity_hits != NULL)
+		*affinity_hits = (pool_data == NULL)?0:M_atomic_add_u64(&pool_data->affinity_hits, 0);
+}
+
+
+M_uint8 M_sql_connpool_conn_utilization(M_sql_connpool_t *pool, M_bool readonly, size_t id)
+{
+	M_sql_connpool_data_t *pool_data;
+	M_sql_conn_t          *conn;
+	M_uint64               busy_ms;
+	M_uint64               up_ms;
+	M_uint8                pct       = 0;
+
+	if (pool == NULL)
+		return 0;
+
+	pool_data = (readonly && pool->pool_readonly.max_conns > 0)?&pool->pool_readonly:&pool->pool_primary;
+
+	M_thread_mutex_lock(pool->lock);
+	if (id < pool_data->max_conns && (conn = pool_data->by_id[id]) != NULL) {
+		/* Only completed acquisitions are counted */
+		busy_ms = M_atomic_add_u64(&conn->busy_ms, 0);
+		up_ms   = M_time_elapsed(&conn->start_tv);
+		if (up_ms != 0)
+			pct = (M_uint8)M_MIN(100, (busy_ms * 100) / up_ms);
+	}
+	M_thread_mutex_unlock(pool->lock);
+
+	return pct;
+}
+
+
 static size_t M_sql_connpool_get_unused_id(M_sql_connpool_data_t *pool_data)
 {
 	size_t i;
@@ -864,6 +1245,19 @@ static size_t M_sql_connpool_get_unused_id(M_sql_connpool_data_t *pool_data)
 }
 
 
+/*! Requires pool to already be locked */
+static void M_sql_connpool_set_trans(M_sql_conn_t *conn, M_bool for_trans)
+{
+	/* Mark if this connection is used by a transaction rather than a single statement */
+	conn->in_trans = for_trans;
+
+	if (for_trans) {
+		M_time_elapsed_start(&conn->trans_start_tv);
+		M_time_elapsed_start(&conn->trans_last_tv);
+	}
+}
+
+
 static void M_sql_connpool_set_used(M_sql_connpool_data_t *pool_data, M_sql_conn_t *conn, M_bool for_trans, M_bool is_new)
 {
 	if (pool_data == NULL || conn == NULL)
@@ -873,16 +1267,72 @@ static void M_sql_connpool_set_used(M_sql_connpool_data_t *pool_data, M_sql_conn
 	M_queue_insert(pool_data->used_conns, conn);
 
 	/* If a new connection, since we added it to used_conns, decrement */
-	if (is_new)
+	if (is_new) {
 		pool_data->new_conns--;
+		pool_data->by_id[conn->id] = conn;
+	}
 
-	/* Mark if this connection is used by a transaction rather than a single statement */
-	conn->in_trans = for_trans;
+	M_sql_connpool_set_trans(conn, for_trans);
+}
+
+
+/*! Record statistics for a connection handed out by M_sql_connpool_acquire_conn() */
+static void M_sql_connpool_acquired(M_sql_connpool_data_t *pool_data, M_sql_conn_t *conn, const M_timeval_t *start_tv)
+{
+	M_uint64 wait_ms = M_time_elapsed(start_tv);
+	size_t   bucket  = 0;
+	M_uint64 limit   = 1;
+
+	while (bucket < M_SQL_CONNPOOL_WAIT_BUCKETS - 1 && wait_ms >= limit) {
+		bucket++;
+		limit *= 10;
+	}
+	M_atomic_inc_u64(&pool_data->wait_hist[bucket]);
+
+	M_time_elapsed_start(&conn->busy_tv);
+}
+
+
+/*! Lock-free acquisition of the connection this thread last released, if it is still parked. */
+static M_sql_conn_t *M_sql_connpool_acquire_affinity(M_sql_connpool_t *pool, M_sql_connpool_data_t *pool_data, M_bool for_trans)
+{
+	M_sql_conn_t *conn;
+	M_uint32      slot_id;
+
+	if (pool->flags & M_SQL_CONNPOOL_FLAG_NO_AFFINITY)
+		return NULL;
+
+	/* Don't jump the queue */
+	if (M_sql_connpool_atomic_get32(&pool_data->num_waiters) != 0)
+		return NULL;
+
+	slot_id = M_sql_connpool_atomic_get32(&pool_data->affinity[M_sql_connpool_affinity_slot(pool_data)]);
+	if (slot_id == 0)
+		return NULL;
+
+	conn = M_sql_connpool_unpark(pool_data, slot_id - 1);
+	if (conn == NULL)
+		return NULL;
+
+	if (pool->max_idle_time_s > 0 && (M_time_elapsed(&conn->last_used_tv) / 1000) > (M_uint64)pool->max_idle_time_s) {
+		/* Stale, let the normal path establish a replacement */
+		M_thread_mutex_lock(pool->lock);
+		M_queue_remove(pool_data->used_conns, conn);
+		M_sql_connpool_conn_remove(pool_data, conn, M_SQL_CONN_INFO_NEW, M_TRUE);
+		M_thread_cond_signal(pool_data->cond);
+		M_thread_mutex_unlock(pool->lock);
+		return NULL;
+	}
 
 	if (for_trans) {
-		M_time_elapsed_start(&conn->trans_start_tv);
-		M_time_elapsed_start(&conn->trans_last_tv);
+		/* Stall monitoring fields require the lock */
+		M_thread_mutex_lock(pool->lock);
+		M_sql_connpool_set_trans(conn, M_TRUE);
+		M_thread_mutex_unlock(pool->lock);
 	}
+
+	M_atomic_inc_u64(&pool_data->affinity_hits);
+	return conn;
 }
 
 
@@ -890,13 +1340,31 @@ M_sql_conn_t *M_sql_connpool_acquire_conn(M_sql_connpool_t *pool, M_bool readonl
 {
 	M_bool                 just_woken     = M_FALSE;
 	M_bool                 newconn_failed = M_FALSE;
+	M_bool                 my_turn;
 	M_sql_conn_t          *conn           = NULL;
 	M_sql_connpool_data_t *pool_data      = NULL;
 	size_t                 id             = 0;
+	M_timeval_t            start_tv;
 
 	if (pool == NULL)
 		return NULL;
 
+	M_time_elapsed_start(&start_tv);
+
+	/* Select appropriate pool, max_conns can't change once the pool is started */
+	if (readonly && pool->pool_readonly.max_conns > 0) {
+		pool_data = &pool->pool_readonly;
+	} else {
+		pool_data = &pool->pool_primary;
+		readonly  = M_FALSE; /* Override */
+	}
+
+	conn = M_sql_connpool_acquire_affinity(pool, pool_data, for_trans);
+	if (conn != NULL) {
+		M_sql_connpool_acquired(pool_data, conn, &start_tv);
+		return conn;
+	}
+
 	do {
 		M_thread_mutex_lock(pool->lock);
 
@@ -905,14 +1373,6 @@ M_sql_conn_t *M_sql_connpool_acquire_conn(M_sql_connpool_t *pool, M_bool readonl
 			return NULL;
 		}
 
-		/* Select appropriate pool */
-		if (readonly && pool->pool_readonly.max_conns > 0) {
-			pool_data = &pool->pool_readonly;
-		} else {
-			pool_data = &pool->pool_primary;
-			readonly  = M_FALSE; /* Override */
-		}
-
 		/* Ugh, we just tried to reconnect, and it failed. We need to decrement
 		 * the new_conns counter and de-reserve the id that failed and try the
 		 * whole shebang over again */
@@ -924,23 +1384,45 @@ M_sql_conn_t *M_sql_connpool_acquire_conn(M_sql_connpool_t *pool, M_bool readonl
 
 		/* Loop until there's an available connection, and we don't want to accidentally
 		 * not wait our turn, so if there's waiters, wait our turn.  If connections are
-		 * growable, then we might need to spawn a new one. */
-		while ((pool_data->num_waiters && !just_woken) ||
-		       (M_llist_len(pool_data->conns) == 0 && (M_queue_len(pool_data->used_conns) + pool_data->new_conns) == pool_data->max_conns)) {
-			pool_data->num_waiters++;
+		 * growable, then we might need to spawn a new one.  Connections parked for
+		 * another thread's affinity are idle, so they're taken over rather than spawning
+		 * a new connection or waiting. */
+		for ( ; ; ) {
+			my_turn = (pool_data->num_waiters == 0 || just_woken)?M_TRUE:M_FALSE;
+
+			if (my_turn && M_llist_len(pool_data->conns) != 0)
+				break;
+
+			if (my_turn && (conn = M_sql_connpool_unpark_any(pool_data)) != NULL)
+				break;
+
+			if (my_turn && (M_queue_len(pool_data->used_conns) + pool_data->new_conns) < pool_data->max_conns)
+				break;
+
+			/* Register as a waiter before checking for parked connections.  A connection
+			 * parked concurrently will see us and go through the normal release path. */
+			M_atomic_inc_u32(&pool_data->num_waiters);
+			if (my_turn && (conn = M_sql_connpool_unpark_any(pool_data)) != NULL) {
+				M_atomic_dec_u32(&pool_data->num_waiters);
+				break;
+			}
 			M_thread_cond_wait(pool_data->cond, pool->lock);
-			pool_data->num_waiters--;
+			M_atomic_dec_u32(&pool_data->num_waiters);
 			just_woken = M_TRUE;
 		}
 
-		conn = M_llist_take_node(M_llist_first(pool_data->conns));
+		/* A parked connection is already in used_conns */
+		if (conn != NULL) {
+			M_queue_remove(pool_data->used_conns, conn);
+		} else {
+			conn = M_llist_take_node(M_llist_first(pool_data->conns));
+		}
 
 		/* Check conn for max_idle_time_s */
 		if (conn && pool->max_idle_time_s > 0 && (M_time_elapsed(&conn->last_used_tv) / 1000) > (M_uint64)pool->max_idle_time_s) {
 			/* We hit a connection sitting idle too long, we actually need to destroy it and see if there's
 			 * a less stale one (if not, it should end up auto-creating a new one on the next loop) */
-			pool_data->info[conn->id] = M_SQL_CONN_INFO_NEW;
-			M_sql_conn_destroy(conn, M_TRUE);
+			M_sql_connpool_conn_remove(pool_data, conn, M_SQL_CONN_INFO_NEW, M_TRUE);
 			M_thread_mutex_unlock(pool->lock);
 			conn = NULL;
 			continue;
@@ -979,10 +1461,60 @@ M_sql_conn_t *M_sql_connpool_acquire_conn(M_sql_connpool_t *pool, M_bool readonl
 		}
 	} while(newconn_failed || conn == NULL);
 
+	M_sql_connpool_acquired(pool_data, conn, &start_tv);
 	return conn;
 }
 
 
+/*! Park a released connection for reuse by the same thread without taking the pool lock.
+ *  Returns M_FALSE if the connection must go through the normal release path. */
+static M_bool M_sql_connpool_release_affinity(M_sql_conn_t *conn)
+{
+	M_sql_connpool_t      *pool      = conn->pool;
+	M_sql_connpool_data_t *pool_data = conn->pool_data;
+	volatile M_uint32     *slot;
+	M_uint32               old_id;
+
+	if (pool->flags & M_SQL_CONNPOOL_FLAG_NO_AFFINITY)
+		return M_FALSE;
+
+	/* Anything out of the ordinary is handled by the normal path */
+	if (M_sql_conn_get_state(conn) != M_SQL_CONN_STATE_OK || conn->curr_stmt != NULL)
+		return M_FALSE;
+
+	if (pool->reconnect_time_s > 0 && (M_time_elapsed(&conn->start_tv) / 1000) > (M_uint64)pool->reconnect_time_s)
+		return M_FALSE;
+
+	/* Waiters get the connection handed to them */
+	if (M_sql_connpool_atomic_get32(&pool_data->num_waiters) != 0)
+		return M_FALSE;
+
+	if (conn->in_trans) {
+		M_thread_mutex_lock(pool->lock);
+		conn->in_trans = M_FALSE;
+		M_thread_mutex_unlock(pool->lock);
+	}
+
+	/* Keep last used time to track max_idle_time_s */
+	M_time_elapsed_start(&conn->last_used_tv);
+
+	slot = &pool_data->affinity[M_sql_connpool_affinity_slot(pool_data)];
+	do {
+		old_id = M_sql_connpool_atomic_get32(slot);
+	} while (!M_atomic_cas32(slot, old_id, (M_uint32)conn->id + 1));
+
+	M_atomic_inc_u32(&pool_data->num_parked);
+	M_atomic_cas32(&pool_data->parked[conn->id], 0, 1);
+
+	/* A waiter may have registered after the check above, before it could see the
+	 * connection parked.  If nobody took it, release it normally so they're woken. */
+	if (M_sql_connpool_atomic_get32(&pool_data->num_waiters) != 0 && M_sql_connpool_unpark(pool_data, conn->id) != NULL)
+		return M_FALSE;
+
+	return M_TRUE;
+}
+
+
 void M_sql_connpool_release_conn(M_sql_conn_t *conn)
 {
 	M_sql_connpool_t      *pool;
@@ -995,6 +1527,11 @@ void M_sql_connpool_release_conn(M_sql_conn_t *conn)
 	pool        = conn->pool;
 	pool_data   = conn->pool_data;
 
+	M_atomic_add_u64(&conn->busy_ms, M_time_elapsed(&conn->busy_tv));
+
+	if (M_sql_connpool_release_affinity(conn))
+		return;
+
 	M_thread_mutex_lock(pool->lock);
 
 	is_readonly = (&pool->pool_readonly == pool_data);
@@ -1004,13 +1541,11 @@ void M_sql_connpool_release_conn(M_sql_conn_t *conn)
 
 	/* If connection is failed, destroy it */
 	if (M_sql_conn_get_state(conn) == M_SQL_CONN_STATE_FAILED) {
-		pool_data->info[conn->id] = M_SQL_CONN_INFO_FAILED;
 		M_sql_connpool_mark_host_idx_failed(pool, conn->host_idx, is_readonly);
-		M_sql_conn_destroy(conn, M_FALSE);
+		M_sql_connpool_conn_remove(pool_data, conn, M_SQL_CONN_INFO_FAILED, M_FALSE);
 	} else if (pool->reconnect_time_s > 0 && (M_time_elapsed(&conn->start_tv) / 1000) > (M_uint64)pool->reconnect_time_s) {
 		/* Force reconnect due to maximum uptime.  Used for rebalancing. */
-		pool_data->info[conn->id] = M_SQL_CONN_INFO_NEW;
-		M_sql_conn_destroy(conn, M_TRUE);
+		M_sql_connpool_conn_remove(pool_data, conn, M_SQL_CONN_INFO_NEW, M_TRUE);
 	} else {
 		/* Might be set to rollback, clear condition as we're guaranteed it was
 		 * rolled back if we're here. */
@@ -1286,55 +1821,84 @@ M_bool M_sql_driver_conn_in_trans(M_sql_conn_t *conn)
 }
 
 
-M_sql_driver_stmt_t *M_sql_conn_get_stmt_cache(M_sql_conn_t *conn, const char *query)
+static M_sql_stmt_cache_t *M_sql_conn_stmt_cache_lookup(M_sql_conn_t *conn, M_uint32 id, const char *query)
+{
+	void *cache = NULL;
+
+	if (id != 0) {
+		M_cache_get(conn->stmt_cache, (void *)((M_uintptr)id), &cache);
+		return cache;
+	}
+
+	return M_cache_strvp_get_direct(conn->stmt_cache_sql, query);
+}
+
+
+M_sql_driver_stmt_t *M_sql_conn_get_stmt_cache(M_sql_conn_t *conn, M_sql_stmt_t *stmt)
 {
 	M_sql_stmt_cache_t *cache;
+	M_uint32            id;
 
-	if (conn == NULL || M_str_isempty(query))
+	if (conn == NULL || stmt == NULL || M_str_isempty(stmt->query_prepared))
 		return NULL;
 
-	cache = M_cache_strvp_get_direct(conn->stmt_cache, query);
+	id    = M_sql_stmt_registry_id(conn->pool->stmt_registry, stmt);
+	cache = M_sql_conn_stmt_cache_lookup(conn, id, stmt->query_prepared);
 
-	if (cache == NULL)
+	if (cache == NULL) {
+		M_atomic_inc_u64(&conn->pool->stmt_cache_misses);
 		return NULL;
+	}
 
+	M_atomic_inc_u64(&conn->pool->stmt_cache_hits);
 	return cache->stmt;
 }
 
 
-void M_sql_conn_set_stmt_cache(M_sql_conn_t *conn, const char *query, M_sql_driver_stmt_t *stmt)
+void M_sql_conn_set_stmt_cache(M_sql_conn_t *conn, M_sql_stmt_t *stmt, M_sql_driver_stmt_t *dstmt)
 {
 	M_sql_stmt_cache_t *cache;
+	M_uint32            id;
 
-	if (conn == NULL || M_str_isempty(query))
+	if (conn == NULL || stmt == NULL || M_str_isempty(stmt->query_prepared))
 		return;
 
-	cache = M_cache_strvp_get_direct(conn->stmt_cache, query);
+	id    = M_sql_stmt_registry_stmt_id(conn->pool->stmt_registry, stmt);
+	cache = M_sql_conn_stmt_cache_lookup(conn, id, stmt->query_prepared);
 
 	if (cache != NULL) {
 		/* If statement handles match, no-op */
-		if (stmt == cache->stmt) {
+		if (dstmt == cache->stmt) {
 			return;
 		}
 
 		/* If we have a cached value, and the input statement handle doesn't match, clear existing */
 		/* XXX: if the connection is locked by a transaction, we really need to delay this as
 		 *      some servers may execute commands within a txn */
-		if (stmt != cache->stmt) {
-			M_cache_strvp_remove(conn->stmt_cache, query);
+		cache->removing = M_TRUE;
+		if (id != 0) {
+			M_cache_remove(conn->stmt_cache, (void *)((M_uintptr)id));
+		} else {
+			M_cache_strvp_remove(conn->stmt_cache_sql, stmt->query_prepared);
 		}
 	}
 
 	/* Don't cache a NULL handle */
-	if (stmt == NULL)
+	if (dstmt == NULL)
 		return;
 
 	cache = M_malloc_zero(sizeof(*cache));
 	cache->conn = conn;
-	cache->stmt = stmt;
-	M_cache_strvp_insert(conn->stmt_cache, query, cache);
+	cache->stmt = dstmt;
+
+	if (id != 0) {
+		M_cache_insert(conn->stmt_cache, (void *)((M_uintptr)id), cache);
+		return;
+	}
 
-	return;
+	if (conn->stmt_cache_sql == NULL)
+		conn->stmt_cache_sql = M_cache_strvp_create(conn->pool->stmt_cache_size, M_CACHE_STRVP_NONE /* Not CASECMP */, M_sql_stmt_cache_remove);
+	M_cache_strvp_insert(conn->stmt_cache_sql, stmt->query_prepared, cache);
 }
 
 
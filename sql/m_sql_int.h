@@ -96,12 +96,15 @@ void M_sql_conn_set_state_from_error(M_sql_conn_t *conn, M_sql_error_t err);
  *  prepared statement handle caching is used as an optimization as it may reduce
  *  load due to query string parsing, or server round trips by being able to reference
  *  a handle already available on the server-side.
+ *
+ *  Also resolves the statement's id in the pool's statement registry, which is the
+ *  cache key used by M_sql_conn_set_stmt_cache().
  * 
  *  \param[in] conn  Connection acquired with M_sql_connpool_acquireconn()
- *  \param[in] query Query string already pre-processed by the DB driver backend.
+ *  \param[in] stmt  Statement with the query already pre-processed by the DB driver backend.
  *  \return Pointer to record in cache, or NULL if no statement handle is cached
  */
-M_sql_driver_stmt_t *M_sql_conn_get_stmt_cache(M_sql_conn_t *conn, const char *query);
+M_sql_driver_stmt_t *M_sql_conn_get_stmt_cache(M_sql_conn_t *conn, M_sql_stmt_t *stmt);
 
 /*! Insert a prepared statement handle to be cached into the connection object.
  * 
@@ -110,14 +113,29 @@ M_sql_driver_stmt_t *M_sql_conn_get_stmt_cache(M_sql_conn_t *conn, const char *q
  *  replace it with the new handle.
  * 
  *  \param[in] conn  Connection acquired with M_sql_connpool_acquireconn()
- *  \param[in] query Query string already pre-processed by the DB driver backend.
- *  \param[in] stmt  Statement handle associated with query, or NULL if requesting to
+ *  \param[in] stmt  Statement previously passed to M_sql_conn_get_stmt_cache().
+ *  \param[in] dstmt Statement handle associated with query, or NULL if requesting to
  *                   remove an existing association.
  */
-void M_sql_conn_set_stmt_cache(M_sql_conn_t *conn, const char *query, M_sql_driver_stmt_t *stmt);
+void M_sql_conn_set_stmt_cache(M_sql_conn_t *conn, M_sql_stmt_t *stmt, M_sql_driver_stmt_t *dstmt);
+
+/*! Execute multiple statements on a connection in order.  If the driver supports
+ *  pipelining, all statements are sent before any result is read.
+ *
+ *  Once a statement fails, statements that were not already sent to the server are
+ *  not executed.
+ *
+ *  \param[in] conn      Connection acquired with M_sql_connpool_acquireconn()
+ *  \param[in] stmts     Prepared statement objects to be executed
+ *  \param[in] num_stmts Number of statements
+ *  \return first error encountered, or #M_SQL_ERROR_SUCCESS
+ */
+M_sql_error_t M_sql_conn_execute_batch(M_sql_conn_t *conn, M_sql_stmt_t **stmts, size_t num_stmts);
 
 M_bool M_sql_stmt_result_clear(M_sql_stmt_t *stmt);
 M_bool M_sql_stmt_result_clear_data(M_sql_stmt_t *stmt);
+/*! Size of the row data currently held by a statement's result */
+size_t M_sql_stmt_result_data_len(M_sql_stmt_t *stmt);
 
 M_uint64 M_sql_stmt_duration_start_ms(M_sql_stmt_t *stmt);
 M_uint64 M_sql_stmt_duration_last_ms(M_sql_stmt_t *stmt);
@@ -139,6 +157,85 @@ M_sql_trace_cb_t M_sql_connpool_get_cb(M_sql_connpool_t *pool, void **cb_arg);
  */
 void M_sql_connpool_close_groupinsert(M_sql_connpool_t *pool, M_sql_stmt_t *stmt);
 
+/* ----- Asynchronous execution ------ */
+
+struct M_sql_async;
+typedef struct M_sql_async M_sql_async_t;
+
+/*! Create the worker threads used for asynchronous execution.
+ *
+ *  \param[in] workers Maximum number of worker threads.
+ */
+M_sql_async_t *M_sql_async_create(size_t workers);
+
+/*! Whether there are asynchronous requests that have not been delivered. */
+M_bool M_sql_async_in_use(M_sql_async_t *async);
+
+/*! Stop the worker threads.  Must not be in use. */
+void M_sql_async_destroy(M_sql_async_t *async);
+
+void M_sql_async_stats(M_sql_async_t *async, size_t *queued, size_t *running, M_uint64 *wait_avg_ms, M_uint64 *wait_max_ms);
+
+/*! Retrieve the pool's asynchronous execution handle, creating it on first use.
+ *
+ *  \param[in] pool Pointer to initialized pool object.
+ *  \return handle, or NULL if the pool is not started.
+ */
+M_sql_async_t *M_sql_connpool_get_async(M_sql_connpool_t *pool);
+
+/* ----- Statement Registry ------ */
+
+/*! Maximum number of distinct queries assigned an id per pool */
+#define M_SQL_STMT_REGISTRY_MAX 4096
+
+struct M_sql_stmt_registry;
+typedef struct M_sql_stmt_registry M_sql_stmt_registry_t;
+
+M_sql_stmt_registry_t *M_sql_stmt_registry_create(void);
+
+void M_sql_stmt_registry_destroy(M_sql_stmt_registry_t *reg);
+
+/*! Look up or assign the id for the statement's formatted query.
+ *
+ *  The id is remembered in the statement handle so re-executing the same
+ *  handle doesn't need a lookup.
+ *
+ *  \param[in] reg  Registry
+ *  \param[in] stmt Statement with query_prepared set
+ *  \return id, or 0 if the registry is full.
+ */
+M_uint32 M_sql_stmt_registry_id(M_sql_stmt_registry_t *reg, M_sql_stmt_t *stmt);
+
+/*! Id a statement was assigned by M_sql_stmt_registry_id(), if it still matches
+ *  the statement's formatted query.
+ *
+ *  \return id, or 0 if none.
+ */
+M_uint32 M_sql_stmt_registry_stmt_id(M_sql_stmt_registry_t *reg, M_sql_stmt_t *stmt);
+
+/*! Number of queries that have been assigned an id */
+size_t M_sql_stmt_registry_len(M_sql_stmt_registry_t *reg);
+
+/*! Retrieve the ids of the most executed queries, most executed first.
+ *
+ *  \param[in]  reg     Registry
+ *  \param[out] ids     Array to fill
+ *  \param[in]  max_ids Size of ids array
+ *  \return number of ids filled in.
+ */
+size_t M_sql_stmt_registry_hot(M_sql_stmt_registry_t *reg, M_uint32 *ids, size_t max_ids);
+
+/*! Create a statement that can be passed to the driver's prepare callback for
+ *  an id.  The query is not formatted, and parameters are bound as NULLs of
+ *  the types originally used.
+ *
+ *  \return statement to be destroyed with M_sql_stmt_destroy(), or NULL if invalid id.
+ */
+M_sql_stmt_t *M_sql_stmt_registry_template(M_sql_stmt_registry_t *reg, M_uint32 id);
+
+/*! Formatted query for an id, valid for the life of the registry */
+const char *M_sql_stmt_registry_query(M_sql_stmt_registry_t *reg, M_uint32 id);
+
 /* ----- Statement Info ------ */
 
 /*! Definition for statement bind column */
@@ -183,9 +280,14 @@ typedef struct {
 	size_t offset; /*!< Start offset in row buffer to cell. Always a multiple of the Alignment (M_SAFE_ALIGNMENT) */
 	size_t length; /*!< Length of data, always in string form, INCLUDING NULL terminator, except for BLOBs.  A
 	                *   length of 0 indicates a NULL column */
+	M_bool native; /*!< Value is held in the column's entry in col_int rather than the row buffer, offset
+	                *   is unused and length is non-zero */
 } M_sql_stmt_result_cellinfo_t;
 
 
+/*! Space needed to format a native integer cell as text, including NULL terminator */
+#define M_SQL_STMT_RESULT_INT_TEXT_LEN 24
+
 /*! Result descriptor */
 typedef struct {
 	M_sql_stmt_result_coldef_t   *col_defs;      /*!< Array of Description/Definition of columns */
@@ -201,6 +303,10 @@ typedef struct {
 	                                              *   a specific cell based on row and col is  (row * num_cols + col) */
 	M_buf_t                     **rows;          /*!< Array of buffers to hold rows.  Multiple columns are stored in the buffer
 	                                              *   at alignment offsets.  The size of the array is equal to alloc_rows */
+	M_int64                     **col_int;       /*!< Array of num_cols, each either NULL or an array of alloc_rows integers
+	                                              *   for cells the driver stored natively rather than as text */
+	char                        **col_text;      /*!< Array of num_cols, each either NULL or alloc_rows slots of
+	                                              *   M_SQL_STMT_RESULT_INT_TEXT_LEN holding native cells formatted on demand */
 	size_t                        curr_col;      /*!< State Tracking. Current column being added, 1-based */
 	size_t                        total_rows;    /*!< Total number of rows fetched */
 } M_sql_stmt_result_t;
@@ -218,9 +324,21 @@ struct M_sql_stmt {
 	char  *query_user;       /*!< User-supplied query */
 	char  *query_prepared;   /*!< Preprocessed query */
 	size_t query_param_cnt;  /*!< Count of parameters in supplied query */
+	M_uint32 query_id;       /*!< Registry id of query_prepared last time it was looked up, 0 if none */
+	M_uint32 query_id_gen;   /*!< Generation of the registry query_id came from */
 	size_t max_fetch_rows;   /*!< User-specified maximum number of rows to cache/fetch at a time, per M_sql_stmt_fetch() */
 	M_bool master_only;      /*!< Controlled by the caller to enforce routing to the read/write pool not the read-only pool */
 	M_bool ignore_tranfail;  /*!< Do not emit #M_SQL_TRACE_TRANFAIL messages */
+	M_uint64 cache_ttl_ms;   /*!< How long the result may be served from the pool's result cache, 0 if not cacheable */
+	M_list_str_t *cache_tables; /*!< Tables whose modification invalidates the cached result */
+
+	/* Profiling, only collected while the pool's profiler is enabled */
+	M_bool   prof_enabled;    /*!< Timings are being collected for the current execution */
+	M_uint64 prof_wait_us;    /*!< Time spent waiting for a connection */
+	M_uint64 prof_prepare_us; /*!< Time spent formatting and preparing the query */
+	M_uint64 prof_execute_us; /*!< Time spent executing the query */
+	M_uint64 prof_fetch_us;   /*!< Time spent fetching rows */
+	M_uint64 prof_bytes;      /*!< Size of the row data fetched */
 
 	M_timeval_t start_tv; /*!< Start of execution */
 	M_timeval_t last_tv;  /*!< End of execution, but before row fetching */
@@ -255,4 +373,86 @@ struct M_sql_stmt {
 };
 
 
+/* ----- Result Cache ------ */
+
+/*! Free a result not attached to a statement handle */
+void M_sql_stmt_result_destroy(M_sql_stmt_result_t *result);
+
+/*! Copy the rows currently held by a result.
+ *
+ *  \param[in]  result Result to copy.
+ *  \param[out] size   Optional. Approximate memory used by the copy.
+ *  \return copy, or NULL if there is no result set.
+ */
+M_sql_stmt_result_t *M_sql_stmt_result_duplicate(const M_sql_stmt_result_t *result, size_t *size);
+
+struct M_sql_result_cache;
+typedef struct M_sql_result_cache M_sql_result_cache_t;
+
+M_sql_result_cache_t *M_sql_result_cache_create(void);
+
+void M_sql_result_cache_destroy(M_sql_result_cache_t *cache);
+
+/*! Set the memory limit, evicting entries if needed.  0 disables the cache. */
+void M_sql_result_cache_set_max_bytes(M_sql_result_cache_t *cache, size_t max_bytes);
+
+/*! Whether a statement's result should be looked up and stored.
+ *
+ *  \return key to pass to M_sql_result_cache_fetch() and M_sql_result_cache_store(),
+ *          or NULL if not cacheable.
+ */
+char *M_sql_result_cache_key(M_sql_result_cache_t *cache, M_sql_stmt_t *stmt);
+
+/*! Look up a result and, if found, place a copy in the statement as if it had
+ *  been executed.
+ *
+ *  \param[in]     cache     Cache
+ *  \param[in,out] stmt      Statement
+ *  \param[in]     key       Key from M_sql_result_cache_key()
+ *  \param[out]    gen       Generation to pass to M_sql_result_cache_store() on a miss.
+ *  \return M_TRUE on hit, M_FALSE on miss.
+ */
+M_bool M_sql_result_cache_fetch(M_sql_result_cache_t *cache, M_sql_stmt_t *stmt, const char *key, M_uint64 *gen);
+
+/*! Store the result of a statement that was executed after M_sql_result_cache_fetch()
+ *  returned gen.  Not stored if a table it depends on was invalidated since. */
+void M_sql_result_cache_store(M_sql_result_cache_t *cache, M_sql_stmt_t *stmt, const char *key, M_uint64 gen);
+
+/*! Drop results depending on a table, or all results if table is NULL */
+void M_sql_result_cache_invalidate(M_sql_result_cache_t *cache, const char *table);
+
+void M_sql_result_cache_stats(M_sql_result_cache_t *cache, M_uint64 *hits, M_uint64 *misses, size_t *entries, size_t *bytes);
+
+/*! Retrieve the pool's result cache */
+M_sql_result_cache_t *M_sql_connpool_get_result_cache(M_sql_connpool_t *pool);
+
+
+/* ----- Profiler ------ */
+
+struct M_sql_profile;
+typedef struct M_sql_profile M_sql_profile_t;
+
+M_sql_profile_t *M_sql_profile_create(void);
+void M_sql_profile_destroy(M_sql_profile_t *profile);
+
+/*! Set the limit of distinct queries tracked.  0 disables profiling but keeps
+ *  collected statistics. */
+void M_sql_profile_set_max_queries(M_sql_profile_t *profile, size_t max_queries);
+
+/*! Whether executions should collect timings.  Cheap enough to call on every execution. */
+M_bool M_sql_profile_enabled(M_sql_profile_t *profile);
+
+void M_sql_profile_reset(M_sql_profile_t *profile);
+
+/*! Add the timings collected by a statement that has finished executing and
+ *  fetching, and stop collecting for it. */
+void M_sql_profile_record(M_sql_profile_t *profile, M_sql_stmt_t *stmt);
+
+/*! Microseconds elapsed since start_tv was set with M_time_gettimeofday() */
+M_uint64 M_sql_profile_elapsed_us(const M_timeval_t *start_tv);
+
+/*! Retrieve the pool's profiler */
+M_sql_profile_t *M_sql_connpool_get_profile(M_sql_connpool_t *pool);
+
+
 #endif
@@ -0,0 +1,485 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "m_config.h"
+#include <mstdlib/mstdlib_sql.h>
+#include <mstdlib/mstdlib_formats.h>
+#include <mstdlib/sql/m_sql_driver.h>
+#include "base/m_defs_int.h"
+#include "m_sql_int.h"
+
+/* Execution times are kept in a log-linear histogram so percentiles can be
+ * reported without storing every sample.  Each power of two is split into
+ * M_SQL_PROFILE_SUB buckets, so a percentile is accurate to within 1/8th. */
+#define M_SQL_PROFILE_SUB_BITS 3
+#define M_SQL_PROFILE_SUB      (1 << M_SQL_PROFILE_SUB_BITS)
+#define M_SQL_PROFILE_MAX_BITS 40 /* ~12 days in microseconds */
+#define M_SQL_PROFILE_BUCKETS  (M_SQL_PROFILE_SUB * (M_SQL_PROFILE_MAX_BITS - M_SQL_PROFILE_SUB_BITS + 2))
+
+typedef struct {
+	char     *query;      /*!< Normalized query */
+	M_uint64  count;
+	M_uint64  errors;
+	M_uint64  total_us;   /*!< Prepare + execute + fetch */
+	M_uint64  max_us;
+	M_uint64  prepare_us;
+	M_uint64  execute_us;
+	M_uint64  fetch_us;
+	M_uint64  wait_us;    /*!< Waiting for a connection */
+	M_uint64  rows;
+	M_uint64  bytes;
+	M_uint64  hist[M_SQL_PROFILE_BUCKETS];
+} M_sql_profile_entry_t;
+
+struct M_sql_profile {
+	M_thread_mutex_t  *lock;
+	volatile M_uint32  enabled;     /*!< Read without the lock on every execution */
+	size_t             max_queries; /*!< Limit of distinct queries tracked, 0 if disabled */
+	M_hash_strvp_t    *entries;     /*!< Normalized query -> M_sql_profile_entry_t */
+	M_uint64           dropped;     /*!< Executions not tracked because max_queries was reached */
+};
+
+
+static void M_sql_profile_entry_destroy(void *arg)
+{
+	M_sql_profile_entry_t *entry = arg;
+
+	if (entry == NULL)
+		return;
+
+	M_free(entry->query);
+	M_free(entry);
+}
+
+
+M_sql_profile_t *M_sql_profile_create(void)
+{
+	M_sql_profile_t *profile = M_malloc_zero(sizeof(*profile));
+
+	profile->lock    = M_thread_mutex_create(M_THREAD_MUTEXATTR_NONE);
+	profile->entries = M_hash_strvp_create(16, 75, M_HASH_STRVP_NONE, M_sql_profile_entry_destroy);
+
+	return profile;
+}
+
+
+void M_sql_profile_destroy(M_sql_profile_t *profile)
+{
+	if (profile == NULL)
+		return;
+
+	M_hash_strvp_destroy(profile->entries, M_TRUE);
+	M_thread_mutex_destroy(profile->lock);
+	M_free(profile);
+}
+
+
+void M_sql_profile_set_max_queries(M_sql_profile_t *profile, size_t max_queries)
+{
+	if (profile == NULL)
+		return;
+
+	M_thread_mutex_lock(profile->lock);
+	profile->max_queries = max_queries;
+	M_atomic_cas32(&profile->enabled, (max_queries == 0)?1:0, (max_queries == 0)?0:1);
+	M_thread_mutex_unlock(profile->lock);
+}
+
+
+M_bool M_sql_profile_enabled(M_sql_profile_t *profile)
+{
+	if (profile == NULL)
+		return M_FALSE;
+	return M_atomic_add_u32(&profile->enabled, 0) != 0;
+}
+
+
+void M_sql_profile_reset(M_sql_profile_t *profile)
+{
+	if (profile == NULL)
+		return;
+
+	M_thread_mutex_lock(profile->lock);
+	M_hash_strvp_destroy(profile->entries, M_TRUE);
+	profile->entries = M_hash_strvp_create(16, 75, M_HASH_STRVP_NONE, M_sql_profile_entry_destroy);
+	profile->dropped = 0;
+	M_thread_mutex_unlock(profile->lock);
+}
+
+
+M_uint64 M_sql_profile_elapsed_us(const M_timeval_t *start_tv)
+{
+	M_timeval_t now;
+	M_int64     us;
+
+	M_time_gettimeofday(&now);
+	us = ((M_int64)(now.tv_sec - start_tv->tv_sec) * 1000000) + (M_int64)(now.tv_usec - start_tv->tv_usec);
+
+	/* Clock stepped backwards */
+	if (us < 0)
+		return 0;
+	return (M_uint64)us;
+}
+
+
+static void M_sql_profile_normalize_number(const char **ptr)
+{
+	const char *p = *ptr;
+
+	while (M_chr_isdigit(*p))
+		p++;
+
+	if (*p == '.') {
+		p++;
+		while (M_chr_isdigit(*p))
+			p++;
+	}
+
+	if ((*p == 'e' || *p == 'E') && (M_chr_isdigit(p[1]) || ((p[1] == '+' || p[1] == '-') && M_chr_isdigit(p[2])))) {
+		p += 2;
+		while (M_chr_isdigit(*p))
+			p++;
+	}
+
+	*ptr = p;
+}
+
+
+/* Replace string and numeric literals with '?' and collapse whitespace so the
+ * same query issued with different literal values is tracked as one query.
+ * Quoted identifiers are left as-is. */
+static char *M_sql_profile_normalize(const char *query)
+{
+	M_buf_t    *buf  = M_buf_create();
+	const char *p    = query;
+	char        prev = ' ';
+
+	while (*p != '\0') {
+		if (M_chr_isspace(*p)) {
+			while (M_chr_isspace(*p))
+				p++;
+			if (prev != ' ' && *p != '\0') {
+				M_buf_add_byte(buf, ' ');
+				prev = ' ';
+			}
+			continue;
+		}
+
+		if (*p == '\'') {
+			/* Quotes are escaped by doubling them */
+			p++;
+			while (*p != '\0') {
+				if (*p == '\'' && p[1] == '\'') {
+					p += 2;
+					continue;
+				}
+				if (*p == '\'') {
+					p++;
+					break;
+				}
+				p++;
+			}
+			M_buf_add_byte(buf, '?');
+			prev = '?';
+			continue;
+		}
+
+		if (*p == '"' || *p == '`') {
+			char quote = *p;
+
+			M_buf_add_byte(buf, (unsigned char)*p);
+			p++;
+			while (*p != '\0' && *p != quote) {
+				M_buf_add_byte(buf, (unsigned char)*p);
+				p++;
+			}
+			if (*p == quote) {
+				M_buf_add_byte(buf, (unsigned char)*p);
+				p++;
+			}
+			prev = quote;
+			continue;
+		}
+
+		/* Digits that are part of an identifier such as "table1" are not literals */
+		if ((M_chr_isdigit(*p) || (*p == '.' && M_chr_isdigit(p[1]))) && !M_chr_isalnum(prev) && prev != '_' && prev != '$') {
+			M_sql_profile_normalize_number(&p);
+			M_buf_add_byte(buf, '?');
+			prev = '?';
+			continue;
+		}
+
+		M_buf_add_byte(buf, (unsigned char)*p);
+		prev = *p;
+		p++;
+	}
+
+	return M_buf_finish_str(buf, NULL);
+}
+
+
+static size_t M_sql_profile_bucket(M_uint64 us)
+{
+	M_uint8 e;
+
+	if (us < M_SQL_PROFILE_SUB)
+		return (size_t)us;
+
+	if (us >= ((M_uint64)1 << (M_SQL_PROFILE_MAX_BITS + 1)))
+		us = ((M_uint64)1 << (M_SQL_PROFILE_MAX_BITS + 1)) - 1;
+
+	e = M_uint64_log2(us);
+	return ((size_t)(e - M_SQL_PROFILE_SUB_BITS + 1) * M_SQL_PROFILE_SUB) + (size_t)((us >> (e - M_SQL_PROFILE_SUB_BITS)) & (M_SQL_PROFILE_SUB - 1));
+}
+
+
+/* Largest value that falls into the bucket */
+static M_uint64 M_sql_profile_bucket_max(size_t bucket)
+{
+	size_t shift;
+
+	if (bucket < M_SQL_PROFILE_SUB)
+		return (M_uint64)bucket;
+
+	shift = (bucket / M_SQL_PROFILE_SUB) - 1;
+	return (((M_uint64)(M_SQL_PROFILE_SUB + (bucket % M_SQL_PROFILE_SUB)) + 1) << shift) - 1;
+}
+
+
+/* Must hold lock */
+static M_uint64 M_sql_profile_percentile(const M_sql_profile_entry_t *entry, M_uint64 pct)
+{
+	M_uint64 target;
+	M_uint64 seen = 0;
+	size_t   i;
+
+	if (entry->count == 0)
+		return 0;
+
+	/* Rank of the sample, rounded up */
+	target = ((entry->count * pct) + 99) / 100;
+
+	for (i=0; i<M_SQL_PROFILE_BUCKETS; i++) {
+		seen += entry->hist[i];
+		if (seen >= target)
+			return M_MIN(M_sql_profile_bucket_max(i), entry->max_us);
+	}
+
+	return entry->max_us;
+}
+
+
+void M_sql_profile_record(M_sql_profile_t *profile, M_sql_stmt_t *stmt)
+{
+	M_sql_profile_entry_t *entry;
+	char                  *query;
+	M_uint64               total_us;
+	M_uint64               wait_us;
+
+	if (profile == NULL || stmt == NULL || !stmt->prof_enabled)
+		return;
+
+	stmt->prof_enabled = M_FALSE;
+	query              = M_sql_profile_normalize(stmt->query_user);
+	wait_us            = stmt->prof_wait_us;
+	stmt->prof_wait_us = 0;
+	total_us           = stmt->prof_prepare_us + stmt->prof_execute_us + stmt->prof_fetch_us;
+
+	M_thread_mutex_lock(profile->lock);
+
+	entry = M_hash_strvp_get_direct(profile->entries, query);
+	if (entry == NULL) {
+		/* Profiling may have been disabled while the statement executed */
+		if (M_hash_strvp_num_keys(profile->entries) >= profile->max_queries) {
+			if (profile->max_queries != 0)
+				profile->dropped++;
+			M_thread_mutex_unlock(profile->lock);
+			M_free(query);
+			return;
+		}
+		entry        = M_malloc_zero(sizeof(*entry));
+		entry->query = query;
+		query        = NULL;
+		M_hash_strvp_insert(profile->entries, entry->query, entry);
+	}
+
+	entry->count++;
+	if (M_sql_error_is_error(stmt->last_error))
+		entry->errors++;
+	entry->total_us   += total_us;
+	entry->max_us      = M_MAX(entry->max_us, total_us);
+	entry->prepare_us += stmt->prof_prepare_us;
+	entry->execute_us += stmt->prof_execute_us;
+	entry->fetch_us   += stmt->prof_fetch_us;
+	entry->wait_us    += wait_us;
+	entry->rows       += (stmt->result != NULL)?stmt->result->total_rows:0;
+	entry->bytes      += stmt->prof_bytes;
+	entry->hist[M_sql_profile_bucket(total_us)]++;
+
+	M_thread_mutex_unlock(profile->lock);
+
+	M_free(query);
+}
+
+
+static const char * const M_sql_profile_cols[] = {
+	"query",
+	"count",
+	"errors",
+	"total_us",
+	"avg_us",
+	"p99_us",
+	"max_us",
+	"prepare_us",
+	"execute_us",
+	"fetch_us",
+	"wait_us",
+	"rows",
+	"bytes",
+	NULL
+};
+
+
+static int M_sql_profile_sort_total_desc(const void *arg1, const void *arg2, void *thunk)
+{
+	const M_sql_profile_entry_t *e1 = *(M_sql_profile_entry_t * const *)arg1;
+	const M_sql_profile_entry_t *e2 = *(M_sql_profile_entry_t * const *)arg2;
+
+	(void)thunk;
+
+	if (e1->total_us == e2->total_us)
+		return M_str_cmpsort(e1->query, e2->query);
+	return (e1->total_us > e2->total_us)?-1:1;
+}
+
+
+static M_table_t *M_sql_profile_table(M_sql_profile_t *profile)
+{
+	M_table_t              *table = M_table_create(M_TABLE_NONE);
+	M_sql_profile_entry_t **list;
+	M_hash_strvp_enum_t    *hashenum;
+	void                   *val;
+	size_t                  num;
+	size_t                  i;
+
+	for (i=0; M_sql_profile_cols[i] != NULL; i++) {
+		M_table_column_insert(table, M_sql_profile_cols[i]);
+		if (i != 0) {
+			M_table_column_set_type_at(table, i, M_TABLE_COLTYPE_INT64);
+		}
+	}
+
+	if (profile == NULL)
+		return table;
+
+	M_thread_mutex_lock(profile->lock);
+
+	num  = M_hash_strvp_num_keys(profile->entries);
+	list = M_malloc_zero(sizeof(*list) * (num + 1));
+	i    = 0;
+	M_hash_strvp_enumerate(profile->entries, &hashenum);
+	while (M_hash_strvp_enumerate_next(profile->entries, hashenum, NULL, &val)) {
+		list[i++] = val;
+	}
+	M_hash_strvp_enumerate_free(hashenum);
+
+	/* Most expensive queries first */
+	M_sort_qsort(list, num, sizeof(*list), M_sql_profile_sort_total_desc, NULL);
+
+	for (i=0; i<num; i++) {
+		const M_sql_profile_entry_t *entry = list[i];
+		size_t                       row   = M_table_row_insert(table);
+
+		M_table_cell_set_at(table, row, 0, entry->query);
+		M_table_cell_set_int64_at(table, row, 1, (M_int64)entry->count);
+		M_table_cell_set_int64_at(table, row, 2, (M_int64)entry->errors);
+		M_table_cell_set_int64_at(table, row, 3, (M_int64)entry->total_us);
+		M_table_cell_set_int64_at(table, row, 4, (M_int64)(entry->total_us / entry->count));
+		M_table_cell_set_int64_at(table, row, 5, (M_int64)M_sql_profile_percentile(entry, 99));
+		M_table_cell_set_int64_at(table, row, 6, (M_int64)entry->max_us);
+		M_table_cell_set_int64_at(table, row, 7, (M_int64)entry->prepare_us);
+		M_table_cell_set_int64_at(table, row, 8, (M_int64)entry->execute_us);
+		M_table_cell_set_int64_at(table, row, 9, (M_int64)entry->fetch_us);
+		M_table_cell_set_int64_at(table, row, 10, (M_int64)entry->wait_us);
+		M_table_cell_set_int64_at(table, row, 11, (M_int64)entry->rows);
+		M_table_cell_set_int64_at(table, row, 12, (M_int64)entry->bytes);
+	}
+
+	M_thread_mutex_unlock(profile->lock);
+
+	M_free(list);
+	return table;
+}
+
+
+static M_uint64 M_sql_profile_dropped(M_sql_profile_t *profile)
+{
+	M_uint64 dropped;
+
+	if (profile == NULL)
+		return 0;
+
+	M_thread_mutex_lock(profile->lock);
+	dropped = profile->dropped;
+	M_thread_mutex_unlock(profile->lock);
+
+	return dropped;
+}
+
+
+M_bool M_sql_connpool_set_profile(M_sql_connpool_t *pool, size_t max_queries)
+{
+	if (pool == NULL)
+		return M_FALSE;
+
+	M_sql_profile_set_max_queries(M_sql_connpool_get_profile(pool), max_queries);
+	return M_TRUE;
+}
+
+
+void M_sql_connpool_profile_reset(M_sql_connpool_t *pool)
+{
+	M_sql_profile_reset(M_sql_connpool_get_profile(pool));
+}
+
+
+M_table_t *M_sql_connpool_profile_table(M_sql_connpool_t *pool, M_uint64 *dropped)
+{
+	M_sql_profile_t *profile = M_sql_connpool_get_profile(pool);
+
+	if (dropped != NULL)
+		*dropped = M_sql_profile_dropped(profile);
+
+	return M_sql_profile_table(profile);
+}
+
+
+char *M_sql_connpool_profile_json(M_sql_connpool_t *pool, M_uint32 flags)
+{
+	M_table_t *table = M_sql_connpool_profile_table(pool, NULL);
+	char      *out;
+
+	out = M_table_write_json(table, flags);
+	M_table_destroy(table);
+	return out;
+}
@@ -24,6 +24,7 @@
 #include "m_config.h"
 #include <mstdlib/mstdlib_sql.h>
 #include <mstdlib/mstdlib_formats.h>
+#include <mstdlib/mstdlib_io.h>
 #include "base/m_defs_int.h"
 #include "m_sql_int.h"
 
@@ -1083,3 +1084,129 @@ M_sql_error_t M_sql_report_process_json(const M_sql_report_t *report, M_sql_stmt
 	}
 	return M_SQL_ERROR_SUCCESS;
 }
+
+
+/* Rows processed between checks of the output size when streaming, and how
+ * much output is collected before it is written out. */
+#define M_SQL_REPORT_STREAM_ROWS  256
+#define M_SQL_REPORT_STREAM_FLUSH (64 * 1024)
+
+M_sql_error_t M_sql_report_process_stream(const M_sql_report_t *report, M_sql_stmt_t *stmt, void *arg, M_sql_report_write_cb_t write_cb, void *write_thunk, char *error, size_t error_size)
+{
+	M_buf_t              *buf;
+	M_sql_report_state_t *state = NULL;
+	M_sql_error_t         err;
+
+	if (write_cb == NULL) {
+		M_snprintf(error, error_size, "invalid parameters passed");
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	buf = M_buf_create();
+	do {
+		err = M_sql_report_process_partial(report, stmt, M_SQL_REPORT_STREAM_ROWS, arg, buf, &state, error, error_size);
+		if (M_sql_error_is_error(err))
+			break;
+
+		/* Collect a reasonable amount before writing, rows may be small */
+		if (M_buf_len(buf) == 0 || (err == M_SQL_ERROR_SUCCESS_ROW && M_buf_len(buf) < M_SQL_REPORT_STREAM_FLUSH))
+			continue;
+
+		if (!write_cb((const unsigned char *)M_buf_peek(buf), M_buf_len(buf), write_thunk)) {
+			M_snprintf(error, error_size, "write callback failed");
+			M_sql_report_state_cancel(state);
+			err = M_SQL_ERROR_USER_FAILURE;
+			break;
+		}
+		M_buf_truncate(buf, 0);
+	} while (err == M_SQL_ERROR_SUCCESS_ROW);
+
+	M_buf_cancel(buf);
+	return err;
+}
+
+
+typedef struct {
+	M_fs_file_t  *fd;
+	M_fs_error_t  res;
+} M_sql_report_file_t;
+
+static M_bool M_sql_report_write_file(const unsigned char *data, size_t data_len, void *thunk)
+{
+	M_sql_report_file_t *file = thunk;
+
+	file->res = M_fs_file_write(file->fd, data, data_len, NULL, M_FS_FILE_RW_FULLBUF);
+	return (file->res == M_FS_ERROR_SUCCESS) ? M_TRUE : M_FALSE;
+}
+
+M_sql_error_t M_sql_report_process_file(const M_sql_report_t *report, M_sql_stmt_t *stmt, void *arg, const char *path, char *error, size_t error_size)
+{
+	M_sql_report_file_t file;
+	M_sql_error_t       err;
+
+	M_mem_set(&file, 0, sizeof(file));
+
+	if (M_str_isempty(path)) {
+		M_snprintf(error, error_size, "invalid parameters passed");
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	file.res = M_fs_file_open(&file.fd, path, 0, M_FS_FILE_MODE_WRITE|M_FS_FILE_MODE_OVERWRITE, NULL);
+	if (file.res != M_FS_ERROR_SUCCESS) {
+		M_snprintf(error, error_size, "unable to open %s: error %d", path, (int)file.res);
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	err = M_sql_report_process_stream(report, stmt, arg, M_sql_report_write_file, &file, error, error_size);
+	if (err == M_SQL_ERROR_USER_FAILURE && file.res != M_FS_ERROR_SUCCESS) {
+		M_snprintf(error, error_size, "unable to write %s: error %d", path, (int)file.res);
+	}
+
+	M_fs_file_close(file.fd);
+	return err;
+}
+
+
+typedef struct {
+	M_io_t       *io;
+	M_uint64      timeout_ms;
+	M_io_error_t  res;
+} M_sql_report_io_t;
+
+static M_bool M_sql_report_write_io(const unsigned char *data, size_t data_len, void *thunk)
+{
+	M_sql_report_io_t *rio = thunk;
+	size_t             len;
+
+	while (data_len > 0) {
+		len      = 0;
+		rio->res = M_io_block_write(rio->io, data, data_len, &len, rio->timeout_ms);
+		if (rio->res != M_IO_ERROR_SUCCESS)
+			return M_FALSE;
+		data     += len;
+		data_len -= len;
+	}
+	return M_TRUE;
+}
+
+M_sql_error_t M_sql_report_process_io(const M_sql_report_t *report, M_sql_stmt_t *stmt, void *arg, M_io_t *io, M_uint64 timeout_ms, char *error, size_t error_size)
+{
+	M_sql_report_io_t rio;
+	M_sql_error_t     err;
+
+	if (io == NULL) {
+		M_snprintf(error, error_size, "invalid parameters passed");
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	M_mem_set(&rio, 0, sizeof(rio));
+	rio.io         = io;
+	rio.timeout_ms = timeout_ms;
+
+	err = M_sql_report_process_stream(report, stmt, arg, M_sql_report_write_io, &rio, error, error_size);
+	if (err == M_SQL_ERROR_USER_FAILURE && rio.res != M_IO_ERROR_SUCCESS) {
+		M_snprintf(error, error_size, "io write failed: %s", M_io_error_string(rio.res));
+	}
+
+	return err;
+}
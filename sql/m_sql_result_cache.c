@@ -0,0 +1,370 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "m_config.h"
+#include <mstdlib/mstdlib_sql.h>
+#include <mstdlib/sql/m_sql_driver.h>
+#include "base/m_defs_int.h"
+#include "m_sql_int.h"
+
+/* A query may be running while a table it reads is modified and invalidated,
+ * so its result would be stale as soon as it is stored.  Every invalidation
+ * takes a new generation and records it against the table; a result is only
+ * stored if none of its tables were invalidated after the generation seen
+ * before the query was executed. */
+
+typedef struct {
+	char                *key;
+	M_sql_stmt_result_t *result;        /*!< NULL if the statement returned no result set */
+	size_t               affected_rows;
+	size_t               bytes;         /*!< Approximate memory used by the entry */
+	M_timeval_t          stored_tv;
+	M_uint64             ttl_ms;
+	M_list_str_t        *tables;        /*!< Tables the result depends on, NULL if none */
+	M_llist_node_t      *node;          /*!< Position in lru */
+} M_sql_result_cache_entry_t;
+
+struct M_sql_result_cache {
+	M_thread_mutex_t *lock;
+	M_hash_strvp_t   *entries;   /*!< Key -> M_sql_result_cache_entry_t */
+	M_llist_t        *lru;       /*!< Entries, least recently used first */
+	M_hash_stru64_t  *table_gen; /*!< Table -> generation of last invalidation */
+	M_uint64          gen;       /*!< Current generation */
+	M_uint64          all_gen;   /*!< Generation of last invalidation of all tables */
+	size_t            max_bytes; /*!< Memory limit, 0 if disabled */
+	size_t            bytes;     /*!< Memory used by all entries */
+	M_uint64          hits;
+	M_uint64          misses;
+};
+
+
+static void M_sql_result_cache_entry_destroy(void *arg)
+{
+	M_sql_result_cache_entry_t *entry = arg;
+
+	if (entry == NULL)
+		return;
+
+	M_free(entry->key);
+	M_sql_stmt_result_destroy(entry->result);
+	M_list_str_destroy(entry->tables);
+	M_free(entry);
+}
+
+
+M_sql_result_cache_t *M_sql_result_cache_create(void)
+{
+	M_sql_result_cache_t *cache = M_malloc_zero(sizeof(*cache));
+
+	cache->lock      = M_thread_mutex_create(M_THREAD_MUTEXATTR_NONE);
+	cache->entries   = M_hash_strvp_create(16, 75, M_HASH_STRVP_NONE, M_sql_result_cache_entry_destroy);
+	cache->lru       = M_llist_create(NULL, M_LLIST_NONE);
+	cache->table_gen = M_hash_stru64_create(16, 75, M_HASH_STRU64_CASECMP);
+
+	return cache;
+}
+
+
+void M_sql_result_cache_destroy(M_sql_result_cache_t *cache)
+{
+	if (cache == NULL)
+		return;
+
+	/* Entries are owned by the hashtable */
+	M_llist_destroy(cache->lru, M_FALSE);
+	M_hash_strvp_destroy(cache->entries, M_TRUE);
+	M_hash_stru64_destroy(cache->table_gen);
+	M_thread_mutex_destroy(cache->lock);
+	M_free(cache);
+}
+
+
+/* Must hold lock */
+static void M_sql_result_cache_remove(M_sql_result_cache_t *cache, M_sql_result_cache_entry_t *entry)
+{
+	cache->bytes -= entry->bytes;
+	M_llist_remove_node(entry->node);
+	M_hash_strvp_remove(cache->entries, entry->key, M_TRUE);
+}
+
+
+/* Must hold lock */
+static void M_sql_result_cache_trim(M_sql_result_cache_t *cache, size_t needed)
+{
+	M_llist_node_t *node;
+
+	while (cache->bytes + needed > cache->max_bytes && (node = M_llist_first(cache->lru)) != NULL) {
+		M_sql_result_cache_remove(cache, M_llist_node_val(node));
+	}
+}
+
+
+void M_sql_result_cache_set_max_bytes(M_sql_result_cache_t *cache, size_t max_bytes)
+{
+	if (cache == NULL)
+		return;
+
+	M_thread_mutex_lock(cache->lock);
+	cache->max_bytes = max_bytes;
+	M_sql_result_cache_trim(cache, 0);
+	M_thread_mutex_unlock(cache->lock);
+}
+
+
+char *M_sql_result_cache_key(M_sql_result_cache_t *cache, M_sql_stmt_t *stmt)
+{
+	M_buf_t *buf;
+	size_t   rows;
+	size_t   i;
+	M_bool   enabled;
+
+	if (cache == NULL || stmt == NULL || stmt->cache_ttl_ms == 0 || M_str_isempty(stmt->query_user))
+		return NULL;
+
+	/* Rows are only partially held when fetching in chunks, and group inserts
+	 * and multiple bound rows are writes. */
+	rows = stmt->bind_row_cnt;
+	if (rows > 0 && stmt->bind_rows[rows-1].col_cnt == 0)
+		rows--;
+	if (stmt->max_fetch_rows != 0 || stmt->group_lock != NULL || rows > 1)
+		return NULL;
+
+	M_thread_mutex_lock(cache->lock);
+	enabled = (cache->max_bytes != 0) ? M_TRUE : M_FALSE;
+	M_thread_mutex_unlock(cache->lock);
+	if (!enabled)
+		return NULL;
+
+	/* Everything is length prefixed so different queries and values can't
+	 * produce the same key. */
+	buf = M_buf_create();
+	M_buf_add_uint(buf, M_str_len(stmt->query_user));
+	M_buf_add_byte(buf, ':');
+	M_buf_add_str(buf, stmt->query_user);
+
+	for (i=0; rows == 1 && i<stmt->bind_rows[0].col_cnt; i++) {
+		M_buf_add_byte(buf, '|');
+		M_buf_add_uint(buf, (M_uint64)M_sql_driver_stmt_bind_get_type(stmt, 0, i));
+		if (M_sql_driver_stmt_bind_isnull(stmt, 0, i)) {
+			M_buf_add_byte(buf, 'N');
+			continue;
+		}
+		M_buf_add_byte(buf, '=');
+
+		switch (M_sql_driver_stmt_bind_get_type(stmt, 0, i)) {
+			case M_SQL_DATA_TYPE_BOOL:
+				M_buf_add_byte(buf, M_sql_driver_stmt_bind_get_bool(stmt, 0, i) ? '1' : '0');
+				break;
+			case M_SQL_DATA_TYPE_INT16:
+				M_buf_add_int(buf, M_sql_driver_stmt_bind_get_int16(stmt, 0, i));
+				break;
+			case M_SQL_DATA_TYPE_INT32:
+				M_buf_add_int(buf, M_sql_driver_stmt_bind_get_int32(stmt, 0, i));
+				break;
+			case M_SQL_DATA_TYPE_INT64:
+				M_buf_add_int(buf, M_sql_driver_stmt_bind_get_int64(stmt, 0, i));
+				break;
+			case M_SQL_DATA_TYPE_TEXT:
+				M_buf_add_uint(buf, M_sql_driver_stmt_bind_get_text_len(stmt, 0, i));
+				M_buf_add_byte(buf, ':');
+				M_buf_add_bytes(buf, M_sql_driver_stmt_bind_get_text(stmt, 0, i), M_sql_driver_stmt_bind_get_text_len(stmt, 0, i));
+				break;
+			case M_SQL_DATA_TYPE_BINARY:
+				M_buf_add_encode(buf, M_sql_driver_stmt_bind_get_binary(stmt, 0, i), M_sql_driver_stmt_bind_get_binary_len(stmt, 0, i), 0, M_BINCODEC_HEX);
+				break;
+			case M_SQL_DATA_TYPE_UNKNOWN:
+				break;
+		}
+	}
+
+	return M_buf_finish_str(buf, NULL);
+}
+
+
+M_bool M_sql_result_cache_fetch(M_sql_result_cache_t *cache, M_sql_stmt_t *stmt, const char *key, M_uint64 *gen)
+{
+	M_sql_result_cache_entry_t *entry;
+	M_sql_stmt_result_t        *result   = NULL;
+	size_t                      affected = 0;
+
+	if (gen != NULL)
+		*gen = 0;
+
+	if (cache == NULL || stmt == NULL || key == NULL)
+		return M_FALSE;
+
+	M_thread_mutex_lock(cache->lock);
+	if (gen != NULL)
+		*gen = cache->gen;
+
+	entry = M_hash_strvp_get_direct(cache->entries, key);
+	if (entry != NULL && M_time_elapsed(&entry->stored_tv) >= entry->ttl_ms) {
+		M_sql_result_cache_remove(cache, entry);
+		entry = NULL;
+	}
+
+	if (entry == NULL) {
+		cache->misses++;
+		M_thread_mutex_unlock(cache->lock);
+		return M_FALSE;
+	}
+
+	cache->hits++;
+	if (entry->node != M_llist_last(cache->lru))
+		M_llist_move_after(entry->node, M_llist_last(cache->lru));
+	result   = M_sql_stmt_result_duplicate(entry->result, NULL);
+	affected = entry->affected_rows;
+	M_thread_mutex_unlock(cache->lock);
+
+	/* Fill in the statement as if it had been executed */
+	M_sql_stmt_result_clear(stmt);
+	M_mem_set(stmt->error_msg, 0, sizeof(stmt->error_msg));
+	M_time_elapsed_start(&stmt->start_tv);
+	M_time_elapsed_start(&stmt->last_tv);
+	stmt->result        = result;
+	stmt->affected_rows = affected;
+	stmt->last_error    = M_SQL_ERROR_SUCCESS;
+
+	return M_TRUE;
+}
+
+
+/* Must hold lock */
+static M_bool M_sql_result_cache_is_stale(M_sql_result_cache_t *cache, M_list_str_t *tables, M_uint64 gen)
+{
+	size_t i;
+
+	if (cache->all_gen > gen)
+		return M_TRUE;
+
+	for (i=0; i<M_list_str_len(tables); i++) {
+		M_uint64 table_gen = 0;
+
+		if (M_hash_stru64_get(cache->table_gen, M_list_str_at(tables, i), &table_gen) && table_gen > gen) {
+			return M_TRUE;
+		}
+	}
+
+	return M_FALSE;
+}
+
+
+void M_sql_result_cache_store(M_sql_result_cache_t *cache, M_sql_stmt_t *stmt, const char *key, M_uint64 gen)
+{
+	M_sql_result_cache_entry_t *entry;
+	M_sql_result_cache_entry_t *old;
+
+	if (cache == NULL || stmt == NULL || key == NULL || stmt->last_error != M_SQL_ERROR_SUCCESS)
+		return;
+
+	/* Copy outside of the lock, results can be large */
+	entry                = M_malloc_zero(sizeof(*entry));
+	entry->key           = M_strdup(key);
+	entry->result        = M_sql_stmt_result_duplicate(stmt->result, &entry->bytes);
+	entry->affected_rows = stmt->affected_rows;
+	entry->ttl_ms        = stmt->cache_ttl_ms;
+	entry->bytes        += sizeof(*entry) + M_str_len(key);
+	if (stmt->cache_tables != NULL)
+		entry->tables = M_list_str_duplicate(stmt->cache_tables);
+	M_time_elapsed_start(&entry->stored_tv);
+
+	M_thread_mutex_lock(cache->lock);
+
+	if (entry->bytes > cache->max_bytes || M_sql_result_cache_is_stale(cache, entry->tables, gen)) {
+		M_thread_mutex_unlock(cache->lock);
+		M_sql_result_cache_entry_destroy(entry);
+		return;
+	}
+
+	/* Another thread may have stored the same query while we were executing */
+	old = M_hash_strvp_get_direct(cache->entries, key);
+	if (old != NULL)
+		M_sql_result_cache_remove(cache, old);
+
+	M_sql_result_cache_trim(cache, entry->bytes);
+
+	entry->node   = M_llist_insert(cache->lru, entry);
+	cache->bytes += entry->bytes;
+	M_hash_strvp_insert(cache->entries, entry->key, entry);
+
+	M_thread_mutex_unlock(cache->lock);
+}
+
+
+void M_sql_result_cache_invalidate(M_sql_result_cache_t *cache, const char *table)
+{
+	M_llist_node_t *node;
+
+	if (cache == NULL)
+		return;
+
+	M_thread_mutex_lock(cache->lock);
+	cache->gen++;
+
+	if (table == NULL) {
+		cache->all_gen = cache->gen;
+	} else {
+		M_hash_stru64_insert(cache->table_gen, table, cache->gen);
+	}
+
+	node = M_llist_first(cache->lru);
+	while (node != NULL) {
+		M_sql_result_cache_entry_t *entry = M_llist_node_val(node);
+
+		node = M_llist_node_next(node);
+
+		if (table == NULL || M_list_str_index_of(entry->tables, table, M_LIST_STR_MATCH_VAL, NULL)) {
+			M_sql_result_cache_remove(cache, entry);
+		}
+	}
+
+	M_thread_mutex_unlock(cache->lock);
+}
+
+
+void M_sql_result_cache_stats(M_sql_result_cache_t *cache, M_uint64 *hits, M_uint64 *misses, size_t *entries, size_t *bytes)
+{
+	M_uint64 h = 0;
+	M_uint64 m = 0;
+	size_t   e = 0;
+	size_t   b = 0;
+
+	if (cache != NULL) {
+		M_thread_mutex_lock(cache->lock);
+		h = cache->hits;
+		m = cache->misses;
+		e = M_llist_len(cache->lru);
+		b = cache->bytes;
+		M_thread_mutex_unlock(cache->lock);
+	}
+
+	if (hits != NULL)
+		*hits = h;
+	if (misses != NULL)
+		*misses = m;
+	if (entries != NULL)
+		*entries = e;
+	if (bytes != NULL)
+		*bytes = b;
+}
@@ -63,6 +63,7 @@ void M_sql_stmt_destroy(M_sql_stmt_t *stmt)
 
 	M_free(stmt->query_user);
 	M_free(stmt->query_prepared);
+	M_list_str_destroy(stmt->cache_tables);
 	M_thread_mutex_destroy(stmt->group_lock);
 	M_thread_cond_destroy(stmt->group_cond);
 	M_free(stmt);
@@ -160,6 +161,7 @@ static M_sql_error_t M_sql_stmt_fetch_int(M_sql_stmt_t *stmt, M_bool is_execute_
 {
 	M_sql_conn_t         *conn;
 	const M_sql_driver_t *driver;
+	M_timeval_t           prof_tv;
 
 	if (stmt == NULL) {
 		return M_SQL_ERROR_INVALID_USE;
@@ -184,10 +186,18 @@ static M_sql_error_t M_sql_stmt_fetch_int(M_sql_stmt_t *stmt, M_bool is_execute_
 		M_sql_trace_message_stmt(M_SQL_TRACE_FETCH_START, stmt);
 	}
 
+	if (stmt->prof_enabled)
+		M_time_gettimeofday(&prof_tv);
+
 	do {
 		stmt->last_error = driver->cb_fetch(conn, stmt, stmt->error_msg, sizeof(stmt->error_msg));
 	} while (stmt->last_error == M_SQL_ERROR_SUCCESS_ROW && (is_execute_fetchall || M_sql_stmt_result_num_rows(stmt) < stmt->max_fetch_rows));
 
+	if (stmt->prof_enabled) {
+		stmt->prof_fetch_us += M_sql_profile_elapsed_us(&prof_tv);
+		stmt->prof_bytes    += M_sql_stmt_result_data_len(stmt);
+	}
+
 	/* Don't clean up handles if more rows are left to be fetched! */
 	if (stmt->last_error == M_SQL_ERROR_SUCCESS_ROW)
 		return M_SQL_ERROR_SUCCESS_ROW;
@@ -212,6 +222,7 @@ static M_sql_error_t M_sql_conn_execute_rows(M_sql_conn_t *conn, M_sql_stmt_t *s
 	size_t                rows_executed; /*! For multiple-insert queries, this may be a value > 1 */
 	const M_sql_driver_t *driver = M_sql_conn_get_driver(conn);
 	M_sql_error_t         err    = M_SQL_ERROR_SUCCESS;
+	M_timeval_t           prof_tv;
 
 	/* Make sure we start at offset 0 */
 	stmt->bind_row_offset = 0;
@@ -219,6 +230,9 @@ static M_sql_error_t M_sql_conn_execute_rows(M_sql_conn_t *conn, M_sql_stmt_t *s
 	/* Number of rows might be 0 if there are no bound parameters, so we want
 	 * to account for this possibility by making it a do { } while */
 	do {
+		if (stmt->prof_enabled)
+			M_time_gettimeofday(&prof_tv);
+
 		/* Call query format callback (clear existing format *first* as it may be invalid) */
 		M_free(stmt->query_prepared);
 		stmt->query_prepared = driver->cb_queryformat(conn, stmt->query_user, stmt->query_param_cnt, M_sql_driver_stmt_bind_rows(stmt), stmt->error_msg, sizeof(stmt->error_msg));
@@ -228,12 +242,17 @@ static M_sql_error_t M_sql_conn_execute_rows(M_sql_conn_t *conn, M_sql_stmt_t *s
 		}
 
 		/* Lookup existing driver statement handle for formatted query from connection */
-		stmt->dstmt = M_sql_conn_get_stmt_cache(conn, stmt->query_prepared);
+		stmt->dstmt = M_sql_conn_get_stmt_cache(conn, stmt);
 
 		/* Call the sql driver's prepare callback, passing in existing statement handle if any.
 		 * Add returned handle to cache (even if NULL, which will clear the cached handle). */
 		err = driver->cb_prepare(&stmt->dstmt, conn, stmt, stmt->error_msg, sizeof(stmt->error_msg));
-		M_sql_conn_set_stmt_cache(conn, stmt->query_prepared, stmt->dstmt);
+		M_sql_conn_set_stmt_cache(conn, stmt, stmt->dstmt);
+
+		if (stmt->prof_enabled) {
+			stmt->prof_prepare_us += M_sql_profile_elapsed_us(&prof_tv);
+			M_time_gettimeofday(&prof_tv);
+		}
 
 		if (err != M_SQL_ERROR_SUCCESS)
 			goto done;
@@ -241,11 +260,13 @@ static M_sql_error_t M_sql_conn_execute_rows(M_sql_conn_t *conn, M_sql_stmt_t *s
 		/* Execute the query */
 		rows_executed = 1; /* Assume, driver may update */
 		err = driver->cb_execute(conn, stmt, &rows_executed, stmt->error_msg, sizeof(stmt->error_msg));
+		if (stmt->prof_enabled)
+			stmt->prof_execute_us += M_sql_profile_elapsed_us(&prof_tv);
 		if (err != M_SQL_ERROR_SUCCESS && err != M_SQL_ERROR_SUCCESS_ROW) {
 			/* If there is a generic failure, invalidate the prepared statement handle as it could
 			 * be invalid to reuse */
 			if (err == M_SQL_ERROR_QUERY_FAILURE) {
-				M_sql_conn_set_stmt_cache(conn, stmt->query_prepared, NULL);
+				M_sql_conn_set_stmt_cache(conn, stmt, NULL);
 			}
 			goto done;
 		}
@@ -260,14 +281,9 @@ done:
 }
 
 
-M_sql_error_t M_sql_conn_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt)
+/*! Reset the statement for a new execution and validate the bound parameters */
+static M_sql_error_t M_sql_conn_execute_start(M_sql_conn_t *conn, M_sql_stmt_t *stmt)
 {
-	M_sql_error_t         err = M_SQL_ERROR_SUCCESS;
-
-	if (conn == NULL || stmt == NULL) {
-		return M_SQL_ERROR_INVALID_USE;
-	}
-
 	/* Cache connection handle, mostly for M_sql_stmt_fetch() */
 	stmt->conn       = conn;
 	stmt->last_error = M_SQL_ERROR_SUCCESS;
@@ -276,6 +292,13 @@ M_sql_error_t M_sql_conn_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt)
 	/* Start timer so we know how long it is taking */
 	M_time_elapsed_start(&stmt->start_tv);
 
+	/* Connection wait time was already collected by the caller, if any */
+	stmt->prof_enabled    = M_sql_profile_enabled(M_sql_connpool_get_profile(M_sql_driver_conn_get_pool(conn)));
+	stmt->prof_prepare_us = 0;
+	stmt->prof_execute_us = 0;
+	stmt->prof_fetch_us   = 0;
+	stmt->prof_bytes      = 0;
+
 	/* Record in connection handle for stall tracking */
 	M_sql_conn_use_stmt(conn, stmt);
 
@@ -289,22 +312,19 @@ M_sql_error_t M_sql_conn_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt)
 
 	if (M_str_isempty(stmt->query_user)) {
 		M_snprintf(stmt->error_msg, sizeof(stmt->error_msg), "Query not prepared");
-		err = M_SQL_ERROR_QUERY_NOTPREPARED;
-		goto done;
+		return M_SQL_ERROR_QUERY_NOTPREPARED;
 	}
 
 	/* If no parameters bound, but expected some, error out */
 	if (stmt->query_param_cnt && stmt->bind_row_cnt == 0) {
 		M_snprintf(stmt->error_msg, sizeof(stmt->error_msg), "No parameters bound, expected %zu", stmt->query_param_cnt);
-		err = M_SQL_ERROR_QUERY_WRONGNUMPARAMS;
-		goto done;
+		return M_SQL_ERROR_QUERY_WRONGNUMPARAMS;
 	}
 
 	/* If parameters bound, but doesn't match the expected count, error out */
 	if (stmt->bind_row_cnt != 0 && stmt->query_param_cnt != stmt->bind_rows[0].col_cnt) {
 		M_snprintf(stmt->error_msg, sizeof(stmt->error_msg), "Expected %zu params, have %zu", stmt->query_param_cnt, stmt->bind_rows[0].col_cnt);
-		err = M_SQL_ERROR_QUERY_WRONGNUMPARAMS;
-		goto done;
+		return M_SQL_ERROR_QUERY_WRONGNUMPARAMS;
 	}
 
 	/* Validate all rows have the same count of parameters and that they don't have different types */
@@ -313,8 +333,7 @@ M_sql_error_t M_sql_conn_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt)
 		for (i=1; i<stmt->bind_row_cnt; i++) {
 			if (stmt->bind_rows[i].col_cnt != stmt->bind_rows[0].col_cnt) {
 				M_snprintf(stmt->error_msg, sizeof(stmt->error_msg), "Row %zu has %zu params, expected %zu", i, stmt->bind_rows[i].col_cnt, stmt->bind_rows[0].col_cnt);
-				err = M_SQL_ERROR_QUERY_WRONGNUMPARAMS;
-				goto done;
+				return M_SQL_ERROR_QUERY_WRONGNUMPARAMS;
 			}
 		}
 		for (i=0; i<stmt->bind_rows[0].col_cnt; i++) {
@@ -325,8 +344,7 @@ M_sql_error_t M_sql_conn_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt)
 				M_sql_data_type_t mytype = stmt->bind_rows[j].cols[i].type;
 				if (type != M_SQL_DATA_TYPE_UNKNOWN && mytype != type) {
 					M_snprintf(stmt->error_msg, sizeof(stmt->error_msg), "Row %zu column %zu has type %u, expected %u", j, i, mytype, type);
-					err = M_SQL_ERROR_PREPARE_INVALID;
-					goto done;
+					return M_SQL_ERROR_PREPARE_INVALID;
 				}
 				type = mytype; /* Cache for future checks */
 			}
@@ -336,17 +354,17 @@ M_sql_error_t M_sql_conn_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt)
 	/* Clear any existing results */
 	M_sql_stmt_result_clear(stmt);
 
-	/* Make sure if there are rows of bound paramters, and the SQL server can't handle
-	 * all rows in one execution that they are executed back to back until complete or
-	 * error. */
-	err = M_sql_conn_execute_rows(conn, stmt);
-	if (err != M_SQL_ERROR_SUCCESS && err != M_SQL_ERROR_SUCCESS_ROW)
-		goto done;
+	return M_SQL_ERROR_SUCCESS;
+}
+
 
+/*! Record the execution result, prefetch rows if requested and release handles when done */
+static M_sql_error_t M_sql_conn_execute_finish(M_sql_stmt_t *stmt, M_sql_error_t err)
+{
 	/* Mark time before rows are fetched */
-	M_time_elapsed_start(&stmt->last_tv);
+	if (err == M_SQL_ERROR_SUCCESS || err == M_SQL_ERROR_SUCCESS_ROW)
+		M_time_elapsed_start(&stmt->last_tv);
 
-done:
 	stmt->last_error = err;
 
 	M_sql_trace_message_stmt(M_SQL_TRACE_EXECUTE_FINISH, stmt);
@@ -362,6 +380,8 @@ done:
 
 	/* If there's still rows to be fetched, don't release the statement or connection handles */
 	if (!M_sql_stmt_has_remaining_rows(stmt)) {
+		if (stmt->prof_enabled)
+			M_sql_profile_record(M_sql_connpool_get_profile(M_sql_driver_conn_get_pool(stmt->conn)), stmt);
 		M_sql_conn_release_stmt(stmt->conn);
 		stmt->dstmt = NULL;
 		stmt->conn  = NULL;
@@ -372,6 +392,158 @@ done:
 }
 
 
+M_sql_error_t M_sql_conn_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt)
+{
+	M_sql_error_t err;
+
+	if (conn == NULL || stmt == NULL) {
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	err = M_sql_conn_execute_start(conn, stmt);
+
+	/* Make sure if there are rows of bound paramters, and the SQL server can't handle
+	 * all rows in one execution that they are executed back to back until complete or
+	 * error. */
+	if (err == M_SQL_ERROR_SUCCESS)
+		err = M_sql_conn_execute_rows(conn, stmt);
+
+	return M_sql_conn_execute_finish(stmt, err);
+}
+
+
+static M_bool M_sql_driver_has_pipeline(const M_sql_driver_t *driver)
+{
+	/* Older driver structures don't have the pipeline callbacks at all */
+	if ((driver->driver_sys_version & 0xFF) < 0x01)
+		return M_FALSE;
+
+	return driver->cb_pipeline_begin != NULL ? M_TRUE : M_FALSE;
+}
+
+
+static void M_sql_stmt_batch_skip(M_sql_stmt_t *stmt)
+{
+	M_sql_stmt_result_clear(stmt);
+	stmt->last_error = M_SQL_ERROR_QUERY_FAILURE;
+	M_snprintf(stmt->error_msg, sizeof(stmt->error_msg), "not executed, prior statement in batch failed");
+}
+
+
+M_sql_error_t M_sql_conn_execute_batch(M_sql_conn_t *conn, M_sql_stmt_t **stmts, size_t num_stmts)
+{
+	const M_sql_driver_t *driver;
+	M_sql_error_t         err       = M_SQL_ERROR_SUCCESS;
+	M_sql_error_t         first_err = M_SQL_ERROR_SUCCESS;
+	M_sql_error_t         flush_err = M_SQL_ERROR_SUCCESS;
+	char                  error[256];
+	size_t                num_sent  = 0;
+	size_t                i;
+
+	if (conn == NULL || stmts == NULL || num_stmts == 0) {
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	/* Results are consumed in order, a statement can't be left with rows pending */
+	for (i=0; i<num_stmts; i++) {
+		if (stmts[i] == NULL)
+			return M_SQL_ERROR_INVALID_USE;
+		if (stmts[i]->max_fetch_rows != 0) {
+			M_snprintf(stmts[i]->error_msg, sizeof(stmts[i]->error_msg), "batched statements must fetch all rows");
+			stmts[i]->last_error = M_SQL_ERROR_INVALID_USE;
+			return M_SQL_ERROR_INVALID_USE;
+		}
+	}
+
+	driver = M_sql_conn_get_driver(conn);
+
+	/* No benefit to a pipeline for a single statement */
+	if (num_stmts == 1 || !M_sql_driver_has_pipeline(driver)) {
+		for (i=0; i<num_stmts; i++) {
+			if (M_sql_error_is_error(first_err)) {
+				M_sql_stmt_batch_skip(stmts[i]);
+				continue;
+			}
+			first_err = M_sql_conn_execute(conn, stmts[i]);
+		}
+		return first_err;
+	}
+
+	M_mem_set(error, 0, sizeof(error));
+	err = driver->cb_pipeline_begin(conn, error, sizeof(error));
+	if (err != M_SQL_ERROR_SUCCESS) {
+		for (i=0; i<num_stmts; i++) {
+			M_sql_stmt_result_clear(stmts[i]);
+			stmts[i]->last_error = err;
+			M_str_cpy(stmts[i]->error_msg, sizeof(stmts[i]->error_msg), error);
+		}
+		return err;
+	}
+
+	/* Queue everything.  A statement that fails before reaching the server stops
+	 * the batch, those already queued are still sent so their results are known. */
+	for (i=0; i<num_stmts; i++) {
+		err = M_sql_conn_execute_start(conn, stmts[i]);
+		if (err == M_SQL_ERROR_SUCCESS)
+			err = M_sql_conn_execute_rows(conn, stmts[i]);
+		if (err != M_SQL_ERROR_SUCCESS)
+			break;
+		num_sent++;
+	}
+
+	if (num_sent) {
+		M_mem_set(error, 0, sizeof(error));
+		flush_err = driver->cb_pipeline_flush(conn, error, sizeof(error));
+	}
+
+	for (i=0; i<num_sent; i++) {
+		M_sql_stmt_t *stmt = stmts[i];
+		M_sql_error_t serr;
+
+		M_sql_conn_use_stmt(conn, stmt);
+
+		if (flush_err != M_SQL_ERROR_SUCCESS) {
+			serr = flush_err;
+			M_str_cpy(stmt->error_msg, sizeof(stmt->error_msg), error);
+		} else {
+			M_timeval_t prof_tv;
+
+			if (stmt->prof_enabled)
+				M_time_gettimeofday(&prof_tv);
+			serr = driver->cb_pipeline_result(conn, stmt, stmt->error_msg, sizeof(stmt->error_msg));
+			if (stmt->prof_enabled)
+				stmt->prof_execute_us += M_sql_profile_elapsed_us(&prof_tv);
+		}
+
+		/* Same as M_sql_conn_execute_rows(), don't reuse a handle after a generic failure */
+		if (serr == M_SQL_ERROR_QUERY_FAILURE)
+			M_sql_conn_set_stmt_cache(conn, stmt, NULL);
+
+		serr = M_sql_conn_execute_finish(stmt, serr);
+		if (M_sql_error_is_error(serr) && !M_sql_error_is_error(first_err))
+			first_err = serr;
+	}
+
+	/* Statement that failed to queue, and anything after it */
+	if (num_sent != num_stmts) {
+		M_sql_conn_use_stmt(conn, stmts[num_sent]);
+		err = M_sql_conn_execute_finish(stmts[num_sent], err);
+		if (!M_sql_error_is_error(first_err))
+			first_err = err;
+
+		for (i=num_sent+1; i<num_stmts; i++) {
+			M_sql_stmt_batch_skip(stmts[i]);
+		}
+	}
+
+	err = driver->cb_pipeline_end(conn);
+	if (M_sql_error_is_error(err) && !M_sql_error_is_error(first_err))
+		first_err = err;
+
+	return first_err;
+}
+
+
 M_sql_stmt_t *M_sql_conn_execute_simple(M_sql_conn_t *conn, const char *query, M_bool skip_sanity_checks)
 {
 	M_sql_stmt_t *stmt = M_sql_stmt_create();
@@ -400,7 +572,17 @@ M_sql_error_t M_sql_stmt_execute(M_sql_connpool_t *pool, M_sql_stmt_t *stmt)
 	M_sql_trans_t *trans       = NULL;
 	M_bool         is_readonly = M_str_caseeq_max(stmt->query_user, "SELECT", 6) && !stmt->master_only;
 	M_bool         rollback    = M_FALSE;
-
+	char          *cache_key   = NULL;
+	M_uint64       cache_gen   = 0;
+	M_bool         profile     = M_sql_profile_enabled(M_sql_connpool_get_profile(pool));
+	M_timeval_t    prof_tv;
+
+	/* Serve from the result cache if the statement allows it */
+	cache_key = M_sql_result_cache_key(M_sql_connpool_get_result_cache(pool), stmt);
+	if (cache_key != NULL && M_sql_result_cache_fetch(M_sql_connpool_get_result_cache(pool), stmt, cache_key, &cache_gen)) {
+		M_free(cache_key);
+		return M_SQL_ERROR_SUCCESS;
+	}
 
 	/* If doing a group insert, handle this scenario */
 	if (stmt->group_lock) {
@@ -441,6 +623,10 @@ M_sql_error_t M_sql_stmt_execute(M_sql_connpool_t *pool, M_sql_stmt_t *stmt)
 		}
 
 		/* Either begin transaction or acquire connection */
+		stmt->prof_wait_us = 0;
+		if (profile)
+			M_time_gettimeofday(&prof_tv);
+
 		if (M_sql_driver_stmt_bind_rows(stmt) > 1 || stmt->group_lock) {
 			err = M_sql_trans_begin(&trans, pool, M_SQL_ISOLATION_READCOMMITTED, stmt->error_msg, sizeof(stmt->error_msg));
 			if (M_sql_error_is_error(err)) {
@@ -467,6 +653,9 @@ M_sql_error_t M_sql_stmt_execute(M_sql_connpool_t *pool, M_sql_stmt_t *stmt)
 			}
 		}
 
+		if (profile)
+			stmt->prof_wait_us = M_sql_profile_elapsed_us(&prof_tv);
+
 		/* Make sure we start at offset when making decisions */
 		stmt->bind_row_offset = 0;
 
@@ -539,6 +728,12 @@ done:
 		M_thread_mutex_unlock(stmt->group_lock);
 	}
 
+	if (cache_key != NULL) {
+		if (err == M_SQL_ERROR_SUCCESS)
+			M_sql_result_cache_store(M_sql_connpool_get_result_cache(pool), stmt, cache_key, cache_gen);
+		M_free(cache_key);
+	}
+
 	return err;
 }
 
@@ -560,6 +755,20 @@ M_bool M_sql_stmt_set_master_only(M_sql_stmt_t *stmt)
 	return M_TRUE;
 }
 
+M_bool M_sql_stmt_set_result_cache(M_sql_stmt_t *stmt, M_uint64 ttl_ms, const char *table)
+{
+	if (stmt == NULL)
+		return M_FALSE;
+
+	stmt->cache_ttl_ms = ttl_ms;
+	if (!M_str_isempty(table)) {
+		if (stmt->cache_tables == NULL)
+			stmt->cache_tables = M_list_str_create(M_LIST_STR_SORTASC|M_LIST_STR_SET|M_LIST_STR_CASECMP);
+		M_list_str_insert(stmt->cache_tables, table);
+	}
+	return M_TRUE;
+}
+
 
 M_bool M_sql_stmt_has_remaining_rows(M_sql_stmt_t *stmt)
 {
@@ -586,6 +795,9 @@ M_sql_error_t M_sql_stmt_fetch(M_sql_stmt_t *stmt)
 	if (stmt->last_error != M_SQL_ERROR_SUCCESS_ROW && stmt->conn != NULL) {
 		M_sql_conn_t *conn = stmt->conn;
 
+		if (stmt->prof_enabled)
+			M_sql_profile_record(M_sql_connpool_get_profile(M_sql_driver_conn_get_pool(conn)), stmt);
+
 		M_sql_conn_release_stmt(conn);
 
 		stmt->conn         = NULL;
@@ -0,0 +1,293 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Monetra Technologies, LLC.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "m_config.h"
+#include <mstdlib/mstdlib_sql.h>
+#include <mstdlib/mstdlib_thread.h>
+#include <mstdlib/sql/m_sql_driver.h>
+#include "base/m_defs_int.h"
+#include "m_sql_int.h"
+
+/* Assigns each distinct formatted query a small integer id shared by every
+ * connection in a pool, so per-connection statement caches don't need the
+ * query text as a key.  Entries are never removed (ids must stay valid for
+ * the life of the pool), so the number of distinct queries is capped.  Queries
+ * past the cap get id 0 and are cached by text instead. */
+
+typedef struct {
+	char              *query;      /*!< Formatted query, as passed to the driver */
+	char              *query_user; /*!< Query as supplied by the user */
+	size_t             param_cnt;  /*!< Parameters per row */
+	size_t             num_rows;   /*!< Rows the query was formatted for */
+	M_sql_data_type_t *types;      /*!< Type of each parameter, param_cnt entries */
+	volatile M_uint64  uses;       /*!< Number of times the query was executed */
+} M_sql_stmt_registry_entry_t;
+
+struct M_sql_stmt_registry {
+	M_thread_rwlock_t            *lock;
+	M_hash_stru64_t              *ids;         /*!< Query -> id */
+	M_sql_stmt_registry_entry_t **entries;     /*!< Indexed by id - 1, M_SQL_STMT_REGISTRY_MAX entries, immutable once set */
+	M_uint32                      num_entries; /*!< Number of entries, modified with write lock held */
+	M_uint32                      gen;         /*!< Unique per registry so a statement can tell which registry its id came from */
+};
+
+static volatile M_uint32 M_sql_stmt_registry_gen = 0;
+
+
+M_sql_stmt_registry_t *M_sql_stmt_registry_create(void)
+{
+	M_sql_stmt_registry_t *reg = M_malloc_zero(sizeof(*reg));
+
+	reg->lock    = M_thread_rwlock_create();
+	reg->ids     = M_hash_stru64_create(64, 75, M_HASH_STRU64_NONE);
+	reg->entries = M_malloc_zero(sizeof(*reg->entries) * M_SQL_STMT_REGISTRY_MAX);
+	reg->gen     = M_atomic_inc_u32(&M_sql_stmt_registry_gen) + 1;
+
+	return reg;
+}
+
+
+void M_sql_stmt_registry_destroy(M_sql_stmt_registry_t *reg)
+{
+	M_uint32 i;
+
+	if (reg == NULL)
+		return;
+
+	for (i=0; i<reg->num_entries; i++) {
+		M_free(reg->entries[i]->query);
+		M_free(reg->entries[i]->query_user);
+		M_free(reg->entries[i]->types);
+		M_free(reg->entries[i]);
+	}
+	M_free(reg->entries);
+	M_hash_stru64_destroy(reg->ids);
+	M_thread_rwlock_destroy(reg->lock);
+	M_free(reg);
+}
+
+
+static M_sql_stmt_registry_entry_t *M_sql_stmt_registry_entry_create(M_sql_stmt_t *stmt)
+{
+	M_sql_stmt_registry_entry_t *entry = M_malloc_zero(sizeof(*entry));
+	size_t                       num_rows;
+	size_t                       i;
+
+	entry->query      = M_strdup(stmt->query_prepared);
+	entry->query_user = M_strdup(stmt->query_user);
+	entry->param_cnt  = stmt->query_param_cnt;
+
+	/* The query text depends on how many rows are sent at once */
+	num_rows          = M_sql_driver_stmt_bind_rows(stmt);
+	entry->num_rows   = num_rows;
+
+	if (entry->param_cnt != 0 && num_rows != 0) {
+		entry->types = M_malloc_zero(sizeof(*entry->types) * entry->param_cnt);
+		for (i=0; i<entry->param_cnt; i++) {
+			entry->types[i] = M_sql_driver_stmt_bind_get_col_type(stmt, i);
+		}
+	}
+
+	return entry;
+}
+
+
+M_uint32 M_sql_stmt_registry_stmt_id(M_sql_stmt_registry_t *reg, M_sql_stmt_t *stmt)
+{
+	if (reg == NULL || stmt == NULL || stmt->query_id == 0 || stmt->query_id_gen != reg->gen)
+		return 0;
+
+	/* Entries are never modified once assigned, so no lock is needed */
+	if (!M_str_eq(reg->entries[stmt->query_id - 1]->query, stmt->query_prepared))
+		return 0;
+
+	return stmt->query_id;
+}
+
+
+M_uint32 M_sql_stmt_registry_id(M_sql_stmt_registry_t *reg, M_sql_stmt_t *stmt)
+{
+	M_uint64 id    = 0;
+	M_bool   found;
+
+	if (reg == NULL || stmt == NULL || M_str_isempty(stmt->query_prepared))
+		return 0;
+
+	/* Reused statement handles remember their id, the text only needs comparing */
+	id = M_sql_stmt_registry_stmt_id(reg, stmt);
+	if (id != 0) {
+		M_atomic_inc_u64(&reg->entries[id - 1]->uses);
+		return (M_uint32)id;
+	}
+
+	M_thread_rwlock_lock(reg->lock, M_THREAD_RWLOCK_TYPE_READ);
+	found = M_hash_stru64_get(reg->ids, stmt->query_prepared, &id);
+	M_thread_rwlock_unlock(reg->lock);
+
+	if (!found) {
+		M_thread_rwlock_lock(reg->lock, M_THREAD_RWLOCK_TYPE_WRITE);
+		/* Someone else may have registered it in the meantime */
+		if (!M_hash_stru64_get(reg->ids, stmt->query_prepared, &id) && reg->num_entries < M_SQL_STMT_REGISTRY_MAX) {
+			reg->entries[reg->num_entries] = M_sql_stmt_registry_entry_create(stmt);
+			reg->num_entries++;
+			id = reg->num_entries;
+			M_hash_stru64_insert(reg->ids, stmt->query_prepared, id);
+		}
+		M_thread_rwlock_unlock(reg->lock);
+	}
+
+	stmt->query_id     = (M_uint32)id;
+	stmt->query_id_gen = reg->gen;
+
+	if (id != 0)
+		M_atomic_inc_u64(&reg->entries[id - 1]->uses);
+
+	return (M_uint32)id;
+}
+
+
+size_t M_sql_stmt_registry_len(M_sql_stmt_registry_t *reg)
+{
+	size_t len;
+
+	if (reg == NULL)
+		return 0;
+
+	M_thread_rwlock_lock(reg->lock, M_THREAD_RWLOCK_TYPE_READ);
+	len = reg->num_entries;
+	M_thread_rwlock_unlock(reg->lock);
+
+	return len;
+}
+
+
+size_t M_sql_stmt_registry_hot(M_sql_stmt_registry_t *reg, M_uint32 *ids, size_t max_ids)
+{
+	M_uint64 *uses;
+	M_uint64  cnt;
+	size_t    num = 0;
+	size_t    i;
+	size_t    j;
+
+	if (reg == NULL || ids == NULL || max_ids == 0)
+		return 0;
+
+	uses = M_malloc_zero(sizeof(*uses) * max_ids);
+
+	M_thread_rwlock_lock(reg->lock, M_THREAD_RWLOCK_TYPE_READ);
+	/* Insertion into a short list sorted by most used, max_ids is small */
+	for (i=0; i<reg->num_entries; i++) {
+		cnt = M_atomic_add_u64(&reg->entries[i]->uses, 0);
+		if (num == max_ids && cnt <= uses[num - 1])
+			continue;
+
+		if (num < max_ids)
+			num++;
+
+		for (j=num - 1; j > 0 && uses[j - 1] < cnt; j--) {
+			uses[j] = uses[j - 1];
+			ids[j]  = ids[j - 1];
+		}
+		uses[j] = cnt;
+		ids[j]  = (M_uint32)i + 1;
+	}
+	M_thread_rwlock_unlock(reg->lock);
+
+	M_free(uses);
+	return num;
+}
+
+
+M_sql_stmt_t *M_sql_stmt_registry_template(M_sql_stmt_registry_t *reg, M_uint32 id)
+{
+	M_sql_stmt_registry_entry_t *entry;
+	M_sql_stmt_t                *stmt;
+	size_t                       row;
+	size_t                       i;
+
+	if (reg == NULL || id == 0)
+		return NULL;
+
+	M_thread_rwlock_lock(reg->lock, M_THREAD_RWLOCK_TYPE_READ);
+	entry = (id <= reg->num_entries)?reg->entries[id - 1]:NULL;
+	M_thread_rwlock_unlock(reg->lock);
+
+	if (entry == NULL)
+		return NULL;
+
+	stmt                  = M_sql_stmt_create();
+	stmt->query_user      = M_strdup(entry->query_user);
+	stmt->query_param_cnt = entry->param_cnt;
+	stmt->query_id        = id;
+	stmt->query_id_gen    = reg->gen;
+
+	/* Drivers may derive parameter types from bound values, so bind NULLs of the
+	 * original types */
+	for (row=0; entry->types != NULL && row<entry->num_rows; row++) {
+		if (row != 0)
+			M_sql_stmt_bind_new_row(stmt);
+
+		for (i=0; i<entry->param_cnt; i++) {
+			switch (entry->types[i]) {
+				case M_SQL_DATA_TYPE_BOOL:
+					M_sql_stmt_bind_bool_null(stmt);
+					break;
+				case M_SQL_DATA_TYPE_INT16:
+					M_sql_stmt_bind_int16_null(stmt);
+					break;
+				case M_SQL_DATA_TYPE_INT32:
+					M_sql_stmt_bind_int32_null(stmt);
+					break;
+				case M_SQL_DATA_TYPE_INT64:
+					M_sql_stmt_bind_int64_null(stmt);
+					break;
+				case M_SQL_DATA_TYPE_BINARY:
+					M_sql_stmt_bind_binary_const(stmt, NULL, 0);
+					break;
+				case M_SQL_DATA_TYPE_TEXT:
+				default:
+					M_sql_stmt_bind_text_const(stmt, NULL, 0);
+					break;
+			}
+		}
+	}
+
+	return stmt;
+}
+
+
+const char *M_sql_stmt_registry_query(M_sql_stmt_registry_t *reg, M_uint32 id)
+{
+	const char *query = NULL;
+
+	if (reg == NULL || id == 0)
+		return NULL;
+
+	M_thread_rwlock_lock(reg->lock, M_THREAD_RWLOCK_TYPE_READ);
+	if (id <= reg->num_entries)
+		query = reg->entries[id - 1]->query;
+	M_thread_rwlock_unlock(reg->lock);
+
+	return query;
+}
@@ -26,6 +26,42 @@
 #include "base/m_defs_int.h"
 #include "m_sql_int.h"
 
+static void M_sql_stmt_result_free_col_text(M_sql_stmt_result_t *result)
+{
+	size_t i;
+
+	if (result->col_text == NULL)
+		return;
+
+	for (i=0; i<result->num_cols; i++)
+		M_free(result->col_text[i]);
+	M_free(result->col_text);
+	result->col_text = NULL;
+}
+
+
+size_t M_sql_stmt_result_data_len(M_sql_stmt_t *stmt)
+{
+	size_t len = 0;
+	size_t i;
+
+	if (stmt == NULL || stmt->result == NULL)
+		return 0;
+
+	for (i=0; i<stmt->result->num_rows; i++) {
+		len += M_buf_len(stmt->result->rows[i]);
+	}
+
+	/* Native values aren't held in the row buffers */
+	for (i=0; stmt->result->col_int != NULL && i<stmt->result->num_rows * stmt->result->num_cols; i++) {
+		if (stmt->result->cellinfo[i].native)
+			len += sizeof(**stmt->result->col_int);
+	}
+
+	return len;
+}
+
+
 M_bool M_sql_stmt_result_clear_data(M_sql_stmt_t *stmt)
 {
 	size_t i;
@@ -53,37 +89,116 @@ M_bool M_sql_stmt_result_clear_data(M_sql_stmt_t *stmt)
 		M_mem_set(stmt->result->cellinfo, 0, sizeof(*stmt->result->cellinfo) * stmt->result->alloc_rows * stmt->result->num_cols);
 	}
 
+	/* Native integer arrays are overwritten as rows are added, but text formatted
+	 * from them is only valid for the rows it was formatted from */
+	M_sql_stmt_result_free_col_text(stmt->result);
+
 	return M_TRUE;
 }
 
-M_bool M_sql_stmt_result_clear(M_sql_stmt_t *stmt)
+void M_sql_stmt_result_destroy(M_sql_stmt_result_t *result)
 {
 	size_t i;
 
-	if (stmt == NULL)
-		return M_FALSE;
-
-	stmt->affected_rows = 0;
-	if (!stmt->result)
-		return M_TRUE;
+	if (result == NULL)
+		return;
 
 	/* Free Column Definitions */
-	M_free(stmt->result->col_defs);
-	M_hash_stridx_destroy(stmt->result->col_name);
+	M_free(result->col_defs);
+	M_hash_stridx_destroy(result->col_name);
 
 	/* Free Row MetaData */
-	M_free(stmt->result->cellinfo);
+	M_free(result->cellinfo);
 
 	/* Free Row Data */
-	if (stmt->result->rows) {
-		for (i=0; i<stmt->result->alloc_rows; i++) {
-			M_buf_cancel(stmt->result->rows[i]);
+	if (result->rows) {
+		for (i=0; i<result->alloc_rows; i++) {
+			M_buf_cancel(result->rows[i]);
+		}
+	}
+	M_free(result->rows);
+
+	/* Free native column data */
+	if (result->col_int) {
+		for (i=0; i<result->num_cols; i++) {
+			M_free(result->col_int[i]);
 		}
 	}
-	M_free(stmt->result->rows);
+	M_free(result->col_int);
+	M_sql_stmt_result_free_col_text(result);
 
 	/* Free full result */
-	M_free(stmt->result);
+	M_free(result);
+}
+
+
+M_sql_stmt_result_t *M_sql_stmt_result_duplicate(const M_sql_stmt_result_t *result, size_t *size)
+{
+	M_sql_stmt_result_t *dup;
+	size_t               len;
+	size_t               i;
+
+	if (size != NULL)
+		*size = 0;
+
+	if (result == NULL || result->num_cols == 0)
+		return NULL;
+
+	/* Only complete rows are copied, and only as many as are in use */
+	dup             = M_malloc_zero(sizeof(*dup));
+	dup->num_cols   = result->num_cols;
+	dup->num_rows   = result->num_rows;
+	dup->alloc_rows = result->num_rows;
+	dup->total_rows = result->num_rows;
+	dup->col_defs   = M_memdup(result->col_defs, sizeof(*dup->col_defs) * dup->num_cols);
+	dup->col_name   = M_hash_stridx_create(16, 75, M_HASH_STRIDX_CASECMP);
+	len             = sizeof(*dup) + sizeof(*dup->col_defs) * dup->num_cols;
+
+	for (i=0; i<dup->num_cols; i++) {
+		if (!M_str_isempty(dup->col_defs[i].name)) {
+			M_hash_stridx_insert(dup->col_name, dup->col_defs[i].name, i);
+		}
+	}
+
+	if (dup->num_rows != 0) {
+		dup->cellinfo = M_memdup(result->cellinfo, sizeof(*dup->cellinfo) * dup->num_rows * dup->num_cols);
+		dup->rows     = M_malloc_zero(sizeof(*dup->rows) * dup->num_rows);
+		len          += (sizeof(*dup->cellinfo) * dup->num_cols + sizeof(*dup->rows)) * dup->num_rows;
+
+		for (i=0; i<dup->num_rows; i++) {
+			dup->rows[i] = M_buf_create();
+			M_buf_add_bytes(dup->rows[i], M_buf_peek(result->rows[i]), M_buf_len(result->rows[i]));
+			len += M_buf_len(result->rows[i]);
+		}
+
+		if (result->col_int != NULL) {
+			dup->col_int = M_malloc_zero(sizeof(*dup->col_int) * dup->num_cols);
+			for (i=0; i<dup->num_cols; i++) {
+				if (result->col_int[i] == NULL)
+					continue;
+				dup->col_int[i] = M_memdup(result->col_int[i], sizeof(*dup->col_int[i]) * dup->num_rows);
+				len            += sizeof(*dup->col_int[i]) * dup->num_rows;
+			}
+		}
+	}
+
+	if (size != NULL)
+		*size = len;
+
+	return dup;
+}
+
+
+M_bool M_sql_stmt_result_clear(M_sql_stmt_t *stmt)
+{
+	if (stmt == NULL)
+		return M_FALSE;
+
+	stmt->affected_rows = 0;
+	if (!stmt->result)
+		return M_TRUE;
+
+	M_sql_stmt_result_destroy(stmt->result);
 	stmt->result = NULL;
 
 	return M_TRUE;
@@ -174,6 +289,41 @@ M_sql_error_t M_sql_stmt_result_isnull(M_sql_stmt_t *stmt, size_t row, size_t co
 }
 
 
+/* Returns the native cell value if the driver stored it natively, otherwise
+ * the caller must parse the text form */
+static M_bool M_sql_stmt_result_native(M_sql_stmt_t *stmt, size_t row, size_t col, M_int64 *val)
+{
+	if (stmt == NULL || stmt->result == NULL || col >= stmt->result->num_cols || row >= stmt->result->num_rows)
+		return M_FALSE;
+
+	if (!stmt->result->cellinfo[row * stmt->result->num_cols + col].native)
+		return M_FALSE;
+
+	*val = stmt->result->col_int[col][row];
+	return M_TRUE;
+}
+
+
+/* Text is only produced for native cells when asked for.  Slots are fixed
+ * size so formatting one cell never moves another that was already returned. */
+static const char *M_sql_stmt_result_native_text(M_sql_stmt_result_t *result, size_t row, size_t col)
+{
+	char *slot;
+
+	if (result->col_text == NULL)
+		result->col_text = M_malloc_zero(sizeof(*result->col_text) * result->num_cols);
+
+	if (result->col_text[col] == NULL)
+		result->col_text[col] = M_malloc_zero(result->alloc_rows * M_SQL_STMT_RESULT_INT_TEXT_LEN);
+
+	slot = result->col_text[col] + (row * M_SQL_STMT_RESULT_INT_TEXT_LEN);
+	if (*slot == '\0')
+		M_snprintf(slot, M_SQL_STMT_RESULT_INT_TEXT_LEN, "%lld", result->col_int[col][row]);
+
+	return slot;
+}
+
+
 M_sql_error_t M_sql_stmt_result_text(M_sql_stmt_t *stmt, size_t row, size_t col, const char **text)
 {
 	if (stmt == NULL || stmt->result == NULL || col >= stmt->result->num_cols || row >= stmt->result->num_rows || text == NULL)
@@ -184,6 +334,11 @@ M_sql_error_t M_sql_stmt_result_text(M_sql_stmt_t *stmt, size_t row, size_t col,
 	if (stmt->result->col_defs[col].type == M_SQL_DATA_TYPE_UNKNOWN || stmt->result->col_defs[col].type == M_SQL_DATA_TYPE_BINARY)
 		return M_SQL_ERROR_INVALID_TYPE;
 
+	if (stmt->result->cellinfo[row * stmt->result->num_cols + col].native) {
+		*text = M_sql_stmt_result_native_text(stmt->result, row, col);
+		return M_SQL_ERROR_SUCCESS;
+	}
+
 	if (stmt->result->cellinfo[row * stmt->result->num_cols + col].length != 0) {
 		*text = M_buf_peek(stmt->result->rows[row]);
 		/* Should never be NULL, but not bad to check anyhow I guess */
@@ -199,6 +354,7 @@ M_sql_error_t M_sql_stmt_result_text(M_sql_stmt_t *stmt, size_t row, size_t col,
 M_sql_error_t M_sql_stmt_result_bool(M_sql_stmt_t *stmt, size_t row, size_t col, M_bool *val)
 {
 	const char   *text = NULL;
+	M_int64       i64;
 	M_sql_error_t err;
 
 	if (val == NULL)
@@ -206,6 +362,13 @@ M_sql_error_t M_sql_stmt_result_bool(M_sql_stmt_t *stmt, size_t row, size_t col,
 
 	*val = M_FALSE;
 
+	if (M_sql_stmt_result_native(stmt, row, col, &i64)) {
+		if (i64 != 0 && i64 != 1)
+			return M_SQL_ERROR_INVALID_TYPE;
+		*val = (i64 == 1)?M_TRUE:M_FALSE;
+		return M_SQL_ERROR_SUCCESS;
+	}
+
 	err  = M_sql_stmt_result_text(stmt, row, col, &text);
 	if (err != M_SQL_ERROR_SUCCESS)
 		return err;
@@ -248,6 +411,7 @@ M_sql_error_t M_sql_stmt_result_int16(M_sql_stmt_t *stmt, size_t row, size_t col
 M_sql_error_t M_sql_stmt_result_int32(M_sql_stmt_t *stmt, size_t row, size_t col, M_int32 *val)
 {
 	const char   *text = NULL;
+	M_int64       i64;
 	M_sql_error_t err;
 
 	if (val == NULL)
@@ -255,6 +419,13 @@ M_sql_error_t M_sql_stmt_result_int32(M_sql_stmt_t *stmt, size_t row, size_t col
 
 	*val = 0;
 
+	if (M_sql_stmt_result_native(stmt, row, col, &i64)) {
+		if (i64 > M_INT32_MAX || i64 < M_INT32_MIN)
+			return M_SQL_ERROR_INVALID_TYPE;
+		*val = (M_int32)i64;
+		return M_SQL_ERROR_SUCCESS;
+	}
+
 	err  = M_sql_stmt_result_text(stmt, row, col, &text);
 	if (err != M_SQL_ERROR_SUCCESS)
 		return err;
@@ -280,6 +451,9 @@ M_sql_error_t M_sql_stmt_result_int64(M_sql_stmt_t *stmt, size_t row, size_t col
 
 	*val = 0;
 
+	if (M_sql_stmt_result_native(stmt, row, col, val))
+		return M_SQL_ERROR_SUCCESS;
+
 	err  = M_sql_stmt_result_text(stmt, row, col, &text);
 	if (err != M_SQL_ERROR_SUCCESS)
 		return err;
@@ -615,23 +789,21 @@ static void M_sql_driver_stmt_result_col_end(M_sql_stmt_t *stmt)
 	col                                 = stmt->result->curr_col-1;
 	row                                 = stmt->result->num_rows-1;
 	cell                                = row * stmt->result->num_cols + col;
-	stmt->result->cellinfo[cell].length = M_buf_len(stmt->result->rows[row]) - stmt->result->cellinfo[cell].offset;
+	if (!stmt->result->cellinfo[cell].native)
+		stmt->result->cellinfo[cell].length = M_buf_len(stmt->result->rows[row]) - stmt->result->cellinfo[cell].offset;
 
 	stmt->result->curr_col++;
 
 }
 
 
-M_buf_t *M_sql_driver_stmt_result_col_start(M_sql_stmt_t *stmt)
+/* Close out the prior column, starting a new row if needed, and return the
+ * row and column to be filled in next */
+static M_bool M_sql_driver_stmt_result_col_next(M_sql_stmt_t *stmt, size_t *row, size_t *col)
 {
-	size_t row;
-	size_t col;
-	size_t cell;
-	size_t len;
-
 	/* Not initialized */
 	if (stmt == NULL || stmt->result == NULL || stmt->result->num_cols == 0)
-		return NULL;
+		return M_FALSE;
 
 	/* curr_col == 0 only exists when there is no open row yet, validate all allocations */
 	if (stmt->result->curr_col == 0) {
@@ -641,28 +813,50 @@ M_buf_t *M_sql_driver_stmt_result_col_start(M_sql_stmt_t *stmt)
 
 		/* Allocate space for rows using powers of 2 */
 		if (stmt->result->num_rows > stmt->result->alloc_rows) {
+			size_t i;
+
 			stmt->result->alloc_rows = M_size_t_round_up_to_power_of_two(stmt->result->num_rows);
 			stmt->result->cellinfo   = M_realloc_zero(stmt->result->cellinfo, (stmt->result->alloc_rows * stmt->result->num_cols) * sizeof(*stmt->result->cellinfo));
 			stmt->result->rows       = M_realloc_zero(stmt->result->rows, stmt->result->alloc_rows * sizeof(*stmt->result->rows));
+			for (i=0; stmt->result->col_int != NULL && i<stmt->result->num_cols; i++) {
+				if (stmt->result->col_int[i] != NULL) {
+					stmt->result->col_int[i] = M_realloc(stmt->result->col_int[i], stmt->result->alloc_rows * sizeof(*stmt->result->col_int[i]));
+				}
+			}
+			M_sql_stmt_result_free_col_text(stmt->result);
 		}
 
-		row = stmt->result->num_rows-1;
+		*row = stmt->result->num_rows-1;
 		/* Allocate buffer if not yet allocated */
-		if (stmt->result->rows[row] == NULL) {
-			stmt->result->rows[row] = M_buf_create();
+		if (stmt->result->rows[*row] == NULL) {
+			stmt->result->rows[*row] = M_buf_create();
 		}
 	} else {
 		/* Not starting a new row ... just close the prior column */
 		M_sql_driver_stmt_result_col_end(stmt);
 	}
 
-	col   = stmt->result->curr_col-1;
+	*col = stmt->result->curr_col-1;
 
 	/* Can't add more columns than we're allowed */
-	if (col >= stmt->result->num_cols)
+	if (*col >= stmt->result->num_cols)
+		return M_FALSE;
+
+	*row = stmt->result->num_rows-1;
+	return M_TRUE;
+}
+
+
+M_buf_t *M_sql_driver_stmt_result_col_start(M_sql_stmt_t *stmt)
+{
+	size_t row;
+	size_t col;
+	size_t cell;
+	size_t len;
+
+	if (!M_sql_driver_stmt_result_col_next(stmt, &row, &col))
 		return NULL;
 
-	row   = stmt->result->num_rows-1;
 	len   = M_buf_len(stmt->result->rows[row]);
 
 	/* Align offset for safety */
@@ -678,6 +872,30 @@ M_buf_t *M_sql_driver_stmt_result_col_start(M_sql_stmt_t *stmt)
 }
 
 
+M_bool M_sql_driver_stmt_result_col_int64(M_sql_stmt_t *stmt, M_int64 val)
+{
+	size_t row;
+	size_t col;
+	size_t cell;
+
+	if (!M_sql_driver_stmt_result_col_next(stmt, &row, &col))
+		return M_FALSE;
+
+	/* Column storage is only allocated once a driver stores a native value in it */
+	if (stmt->result->col_int == NULL)
+		stmt->result->col_int = M_malloc_zero(stmt->result->num_cols * sizeof(*stmt->result->col_int));
+	if (stmt->result->col_int[col] == NULL)
+		stmt->result->col_int[col] = M_malloc(stmt->result->alloc_rows * sizeof(*stmt->result->col_int[col]));
+
+	stmt->result->col_int[col][row]     = val;
+	cell                                = row * stmt->result->num_cols + col;
+	stmt->result->cellinfo[cell].native = M_TRUE;
+	stmt->result->cellinfo[cell].length = sizeof(val);
+
+	return M_TRUE;
+}
+
+
 M_bool M_sql_driver_stmt_result_row_finish(M_sql_stmt_t *stmt)
 {
 	if (stmt == NULL || stmt->result == NULL || stmt->result->curr_col != stmt->result->num_cols) {
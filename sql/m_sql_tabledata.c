@@ -1602,6 +1602,10 @@ static M_sql_error_t M_sql_tabledata_add_do_int(M_sql_trans_t *sqltrans, void *a
 
 	rv = M_sql_trans_execute(sqltrans, stmt);
 
+	/* Cached results of the table are stale once this commits */
+	if (!M_sql_error_is_error(rv))
+		M_sql_trans_result_cache_invalidate(sqltrans, txn->table_name);
+
 done:
 	if (request)
 		M_buf_cancel(request);
@@ -2057,6 +2061,9 @@ static M_sql_error_t M_sql_tabledata_edit_do(M_sql_trans_t *sqltrans, void *arg,
 	if (M_sql_error_is_error(err))
 		goto done;
 
+	/* Cached results of the table are stale once this commits */
+	M_sql_trans_result_cache_invalidate(sqltrans, txn->table_name);
+
 	if (M_sql_stmt_result_affected_rows(stmt) > 1) {
 		err = M_SQL_ERROR_USER_FAILURE;
 		M_snprintf(error, error_len, "more than one row would be updated");
@@ -2162,6 +2169,166 @@ M_sql_error_t M_sql_tabledata_trans_upsert(M_sql_trans_t *sqltrans, const char *
 	return M_sql_tabledata_edit_int(NULL, sqltrans, table_name, M_TRUE, fields, num_fields, fetch_cb, notify_cb, thunk, error, error_len);
 }
 
+#define M_SQL_TABLEDATA_BULK_DEFAULT_RECORDS 100
+
+typedef struct {
+	M_sql_connpool_t             *pool;
+	M_sql_tabledata_bulk_op_t     op;
+	const char                   *table_name;
+	const M_sql_tabledata_t      *fields;
+	size_t                        num_fields;
+	M_sql_tabledata_fetch_cb      fetch_cb;
+	M_sql_tabledata_notify_cb     notify_cb;
+	void * const                 *thunks;
+	M_sql_tabledata_bulk_batch_t *batch;
+} M_sql_tabledata_bulk_task_t;
+
+
+static M_sql_error_t M_sql_tabledata_bulk_do(M_sql_trans_t *sqltrans, void *arg, char *error, size_t error_len)
+{
+	M_sql_tabledata_bulk_task_t *task = arg;
+	size_t                       i;
+
+	for (i=0; i<task->batch->num_records; i++) {
+		size_t                idx = task->batch->first_record + i;
+		M_sql_tabledata_txn_t txn;
+		M_sql_error_t         err;
+
+		M_sql_tabledata_txn_create(&txn, (task->op == M_SQL_TABLEDATA_BULK_ADD)?M_TRUE:M_FALSE, task->table_name, task->fields, task->num_fields, task->fetch_cb, task->notify_cb, task->thunks[idx]);
+		txn.edit_insert_not_found = (task->op == M_SQL_TABLEDATA_BULK_UPSERT)?M_TRUE:M_FALSE;
+
+		if (txn.is_add) {
+			err = M_sql_tabledata_add_do(sqltrans, &txn, error, error_len);
+		} else {
+			err = M_sql_tabledata_edit_do(sqltrans, &txn, error, error_len);
+		}
+
+		M_sql_tabledata_txn_destroy(&txn);
+
+		if (M_sql_error_is_error(err)) {
+			task->batch->failed_record = idx;
+			return err;
+		}
+	}
+
+	return M_SQL_ERROR_SUCCESS;
+}
+
+
+/* Runs on a worker thread when processing in parallel. */
+static void M_sql_tabledata_bulk_task(void *arg)
+{
+	M_sql_tabledata_bulk_task_t *task = arg;
+
+	task->batch->err = M_sql_trans_process(task->pool, M_SQL_ISOLATION_SERIALIZABLE, M_sql_tabledata_bulk_do, task, task->batch->error, sizeof(task->batch->error));
+}
+
+
+M_sql_error_t M_sql_tabledata_bulk(M_sql_connpool_t *pool, M_sql_tabledata_bulk_op_t op, const char *table_name, const M_sql_tabledata_t *fields, size_t num_fields, M_sql_tabledata_fetch_cb fetch_cb, M_sql_tabledata_notify_cb notify_cb, void * const *thunks, size_t num_records, size_t records_per_batch, size_t max_threads, M_sql_tabledata_bulk_batch_t **batches, size_t *num_batches, char *error, size_t error_len)
+{
+	M_sql_tabledata_bulk_batch_t  *blist = NULL;
+	M_sql_tabledata_bulk_task_t   *tasks = NULL;
+	size_t                         cnt;
+	size_t                         i;
+	M_sql_error_t                  err   = M_SQL_ERROR_USER_FAILURE;
+
+	if (batches != NULL)
+		*batches = NULL;
+	if (num_batches != NULL)
+		*num_batches = 0;
+
+	if (pool == NULL) {
+		M_snprintf(error, error_len, "must specify pool");
+		return err;
+	}
+	if (M_str_isempty(table_name)) {
+		M_snprintf(error, error_len, "missing table name");
+		return err;
+	}
+	if (fields == NULL || num_fields == 0) {
+		M_snprintf(error, error_len, "fields specified invalid");
+		return err;
+	}
+	if (thunks == NULL || num_records == 0) {
+		M_snprintf(error, error_len, "no records specified");
+		return err;
+	}
+	if (op != M_SQL_TABLEDATA_BULK_ADD && op != M_SQL_TABLEDATA_BULK_EDIT && op != M_SQL_TABLEDATA_BULK_UPSERT) {
+		M_snprintf(error, error_len, "invalid operation");
+		return err;
+	}
+	if (!M_sql_tabledata_validate_fields(fields, num_fields, error, error_len))
+		return err;
+
+	if (records_per_batch == 0)
+		records_per_batch = M_SQL_TABLEDATA_BULK_DEFAULT_RECORDS;
+
+	/* Batch ranges are known upfront so every batch has an entry in the
+	 * report regardless of the order they complete in. */
+	cnt   = (num_records + records_per_batch - 1) / records_per_batch;
+	blist = M_malloc_zero(sizeof(*blist) * cnt);
+	tasks = M_malloc_zero(sizeof(*tasks) * cnt);
+	for (i=0; i<cnt; i++) {
+		blist[i].first_record  = i * records_per_batch;
+		blist[i].num_records   = M_MIN(records_per_batch, num_records - blist[i].first_record);
+		blist[i].failed_record = blist[i].first_record;
+		blist[i].err           = M_SQL_ERROR_UNSET;
+
+		tasks[i].pool          = pool;
+		tasks[i].op            = op;
+		tasks[i].table_name    = table_name;
+		tasks[i].fields        = fields;
+		tasks[i].num_fields    = num_fields;
+		tasks[i].fetch_cb      = fetch_cb;
+		tasks[i].notify_cb     = notify_cb;
+		tasks[i].thunks        = thunks;
+		tasks[i].batch         = &blist[i];
+	}
+
+	if (max_threads > cnt)
+		max_threads = cnt;
+
+	if (max_threads <= 1) {
+		for (i=0; i<cnt; i++) {
+			M_sql_tabledata_bulk_task(&tasks[i]);
+		}
+	} else {
+		M_threadpool_t        *threadpool = M_threadpool_create(max_threads, max_threads, 0, SIZE_MAX);
+		M_threadpool_parent_t *parent     = M_threadpool_parent_create(threadpool);
+		void                 **args       = M_malloc(sizeof(*args) * cnt);
+
+		for (i=0; i<cnt; i++) {
+			args[i] = &tasks[i];
+		}
+		M_threadpool_dispatch(parent, M_sql_tabledata_bulk_task, args, cnt);
+		M_threadpool_parent_wait(parent);
+		M_threadpool_parent_destroy(parent);
+		M_threadpool_destroy(threadpool);
+		M_free(args);
+	}
+
+	err = M_SQL_ERROR_SUCCESS;
+	for (i=0; i<cnt; i++) {
+		if (M_sql_error_is_error(blist[i].err)) {
+			err = blist[i].err;
+			M_snprintf(error, error_len, "batch %zu (record %zu): %s", i, blist[i].failed_record, blist[i].error);
+			break;
+		}
+	}
+
+	M_free(tasks);
+	if (batches != NULL) {
+		*batches = blist;
+	} else {
+		M_free(blist);
+	}
+	if (num_batches != NULL)
+		*num_batches = cnt;
+
+	return err;
+}
+
+
 M_sql_tabledata_t *M_sql_tabledata_append_virtual_list(const M_sql_tabledata_t *fields, size_t *num_fields, const char *table_column, const M_list_str_t *field_names, size_t max_len, M_sql_tabledata_flags_t flags)
 {
 	size_t             len;
@@ -31,6 +31,8 @@ struct M_sql_trans {
 	M_timeval_t   last_tv;
 	M_sql_conn_t *conn;
 	char          error[512];
+	M_list_str_t *invalidate;     /*!< Tables to invalidate in the result cache on commit */
+	M_bool        invalidate_all; /*!< Invalidate the whole result cache on commit */
 };
 
 
@@ -42,6 +44,7 @@ static void M_sql_trans_release(M_sql_trans_t *trans)
 	if (trans->conn)
 		M_sql_connpool_release_conn(trans->conn);
 
+	M_list_str_destroy(trans->invalidate);
 	M_free(trans);
 }
 
@@ -187,6 +190,19 @@ M_sql_error_t M_sql_trans_commit(M_sql_trans_t *trans, char *error, size_t error
 	/* Catch a commit/connectivity error */
 	M_sql_conn_set_state_from_error(trans->conn, err);
 
+	if (err == M_SQL_ERROR_SUCCESS) {
+		M_sql_result_cache_t *cache = M_sql_connpool_get_result_cache(M_sql_trans_get_pool(trans));
+		size_t                i;
+
+		if (trans->invalidate_all) {
+			M_sql_result_cache_invalidate(cache, NULL);
+		} else {
+			for (i=0; i<M_list_str_len(trans->invalidate); i++) {
+				M_sql_result_cache_invalidate(cache, M_list_str_at(trans->invalidate, i));
+			}
+		}
+	}
+
 	/* Regardless of the error, we still release the connection and free trans */
 	M_sql_trans_release(trans);
 	return err;
@@ -224,6 +240,53 @@ M_sql_error_t M_sql_trans_execute(M_sql_trans_t *trans, M_sql_stmt_t *stmt)
 }
 
 
+M_sql_error_t M_sql_trans_execute_batch(M_sql_trans_t *trans, M_sql_stmt_t **stmts, size_t num_stmts)
+{
+	M_sql_error_t err;
+	M_bool        have_msg = M_FALSE;
+	size_t        i;
+
+	if (trans == NULL || stmts == NULL || num_stmts == 0) {
+		return M_SQL_ERROR_INVALID_USE;
+	}
+
+	if (M_sql_conn_get_state(trans->conn) != M_SQL_CONN_STATE_OK) {
+		for (i=0; i<num_stmts; i++) {
+			if (stmts[i] == NULL)
+				continue;
+			M_snprintf(stmts[i]->error_msg, sizeof(stmts[i]->error_msg), "rollback required");
+			stmts[i]->last_error = M_SQL_ERROR_QUERY_DEADLOCK;
+		}
+		return M_SQL_ERROR_QUERY_DEADLOCK;
+	}
+
+	M_time_elapsed_start(&trans->last_tv);
+
+	err = M_sql_conn_execute_batch(trans->conn, stmts, num_stmts);
+
+	for (i=0; i<num_stmts; i++) {
+		M_sql_error_t stmt_err = M_sql_stmt_get_error(stmts[i]);
+
+		if (!M_sql_error_is_error(stmt_err))
+			continue;
+
+		/* Keep the message of the first failure for M_sql_trans_process() */
+		if (!have_msg) {
+			M_str_cpy(trans->error, sizeof(trans->error), M_sql_stmt_get_error_string(stmts[i]));
+			have_msg = M_TRUE;
+		}
+
+		/* Catch a connectivity or rollback error */
+		M_sql_conn_set_state_from_error(trans->conn, stmt_err);
+	}
+
+	/* Leaving pipeline mode may fail without any statement failing */
+	M_sql_conn_set_state_from_error(trans->conn, err);
+
+	return err;
+}
+
+
 M_uint64 M_sql_trans_duration_start_ms(M_sql_trans_t *trans)
 {
 	if (trans == NULL)
@@ -338,3 +401,19 @@ M_sql_connpool_t *M_sql_trans_get_pool(M_sql_trans_t *trans)
 	return M_sql_driver_conn_get_pool(trans->conn);
 }
 
+M_bool M_sql_trans_result_cache_invalidate(M_sql_trans_t *trans, const char *table)
+{
+	if (trans == NULL)
+		return M_FALSE;
+
+	if (table == NULL) {
+		trans->invalidate_all = M_TRUE;
+		return M_TRUE;
+	}
+
+	if (trans->invalidate == NULL)
+		trans->invalidate = M_list_str_create(M_LIST_STR_SORTASC|M_LIST_STR_SET|M_LIST_STR_CASECMP);
+	M_list_str_insert(trans->invalidate, table);
+	return M_TRUE;
+}
+
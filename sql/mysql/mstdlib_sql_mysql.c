@@ -876,7 +876,33 @@ static M_sql_error_t mysql_cb_fetch(M_sql_conn_t *conn, M_sql_stmt_t *stmt, char
 
 	/* Output the current row of data */
 	for (i=0; i<result->num_cols; i++) {
-		M_buf_t *buf = M_sql_driver_stmt_result_col_start(stmt);
+		M_buf_t *buf;
+
+		/* Integers are fixed size so can't be truncated, store them natively */
+		if (!result->col_isnull[i]) {
+			M_bool is_int = M_TRUE;
+			switch (result->bind[i].buffer_type) {
+				case MYSQL_TYPE_TINY:
+					M_sql_driver_stmt_result_col_int64(stmt, *((M_int8 *)result->bind[i].buffer));
+					break;
+				case MYSQL_TYPE_SHORT:
+					M_sql_driver_stmt_result_col_int64(stmt, *((M_int16 *)result->bind[i].buffer));
+					break;
+				case MYSQL_TYPE_LONG:
+					M_sql_driver_stmt_result_col_int64(stmt, *((M_int32 *)result->bind[i].buffer));
+					break;
+				case MYSQL_TYPE_LONGLONG:
+					M_sql_driver_stmt_result_col_int64(stmt, *((M_int64 *)result->bind[i].buffer));
+					break;
+				default:
+					is_int = M_FALSE;
+					break;
+			}
+			if (is_int)
+				continue;
+		}
+
+		buf = M_sql_driver_stmt_result_col_start(stmt);
 
 		/* NULL column encountered, record nothing */
 		if (result->col_isnull[i])
@@ -909,18 +935,6 @@ static M_sql_error_t mysql_cb_fetch(M_sql_conn_t *conn, M_sql_stmt_t *stmt, char
 			case MYSQL_TYPE_STRING:
 				M_buf_add_bytes(buf, (const char *)result->bind[i].buffer, result->col_length[i]);
 				break;
-			case MYSQL_TYPE_TINY:
-				M_buf_add_int(buf, *((M_int8 *)result->bind[i].buffer));
-				break;
-			case MYSQL_TYPE_SHORT:
-				M_buf_add_int(buf, *((M_int16 *)result->bind[i].buffer));
-				break;
-			case MYSQL_TYPE_LONG:
-				M_buf_add_int(buf, *((M_int32 *)result->bind[i].buffer));
-				break;
-			case MYSQL_TYPE_LONGLONG:
-				M_buf_add_int(buf, *((M_int64 *)result->bind[i].buffer));
-				break;
 			default:
 				M_snprintf(error, error_size, "column %zu unrecognized data type: %d", i, (int)result->bind[i].buffer_type);
 				return M_SQL_ERROR_INVALID_USE;
@@ -1104,6 +1118,12 @@ static M_sql_driver_t M_sql_mysql = {
 	mysql_cb_append_bitop,        /* Callback used to append a bit operation */
 	NULL,                         /* Callback used to rewrite an index name to comply with DB requirements */
 	NULL,                         /* Handle for loaded driver - must be initialized to NULL */
+
+	NULL,                         /* Callback used to enter pipeline mode */
+	NULL,                         /* Callback used to send queued pipeline requests */
+	NULL,                         /* Callback used to retrieve the result of the next queued statement */
+	NULL,                         /* Callback used to leave pipeline mode */
+	NULL,                         /* Callback used to bulk load rows into a table */
 };
 
 /*! Defines function that references M_sql_driver_t M_sql_##name for module loading */
@@ -1445,6 +1445,12 @@ static M_sql_driver_t M_sql_oracle = {
 	oracle_cb_rewrite_indexname,   /* Callback used to rewrite an index name to comply with DB requirements */
 
 	NULL,                          /* Handle for loaded driver - must be initialized to NULL */
+
+	NULL,                          /* Callback used to enter pipeline mode */
+	NULL,                          /* Callback used to send queued pipeline requests */
+	NULL,                          /* Callback used to retrieve the result of the next queued statement */
+	NULL,                          /* Callback used to leave pipeline mode */
+	NULL,                          /* Callback used to bulk load rows into a table */
 };
 
 /*! Defines function that references M_sql_driver_t M_sql_##name for module loading */
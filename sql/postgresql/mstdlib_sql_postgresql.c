@@ -40,9 +40,13 @@ struct M_sql_driver_connpool {
 
 
 struct M_sql_driver_conn {
-	PGconn *conn;         /*!< PostgreSQL connection handle */
-	char    version[32];  /*!< Cached server version */
-	size_t  stmt_id;      /*!< Prepared statements require a key/name, we'll use an integer counter */
+	PGconn   *conn;          /*!< PostgreSQL connection handle */
+	char      version[32];   /*!< Cached server version */
+	size_t    stmt_id;       /*!< Prepared statements require a key/name, we'll use an integer counter */
+	M_bool    in_pipeline;   /*!< Requests are being queued rather than executed */
+	M_bool    synced;        /*!< Pipeline sync point has been sent */
+	M_list_t *pipeline;      /*!< Queued requests awaiting their result, pgsql_pipeline_entry_t */
+	M_list_t *pipeline_free; /*!< Statement handles to destroy once the pipeline ends */
 };
 
 
@@ -74,6 +78,20 @@ struct M_sql_driver_stmt {
 };
 
 
+typedef enum {
+	PGSQL_PIPELINE_PREPARE = 0, /*!< Server-side statement preparation */
+	PGSQL_PIPELINE_EXECUTE      /*!< Execution of a prepared statement */
+} pgsql_pipeline_type_t;
+
+
+typedef struct {
+	pgsql_pipeline_type_t  type;
+	M_sql_stmt_t          *stmt;          /*!< Statement the request was queued for */
+	M_sql_driver_stmt_t   *dstmt;         /*!< Driver statement handle used for the request */
+	size_t                 rows_executed; /*!< Number of bound rows sent with an execution */
+} pgsql_pipeline_entry_t;
+
+
 static M_thread_mutex_t *pgsql_lock         = NULL;
 static pgthreadlock_t    pgsql_prior_lockfn = NULL;
 
@@ -312,12 +330,30 @@ static const char *pgsql_cb_serverversion(M_sql_driver_conn_t *conn)
 }
 
 
+static void pgsql_free_stmt(M_sql_driver_stmt_t *stmt);
+
 static void pgsql_cb_disconnect(M_sql_driver_conn_t *conn)
 {
+	M_sql_driver_stmt_t *dstmt;
+
 	if (conn == NULL)
 		return;
 	if (conn->conn != NULL)
 		PQfinish(conn->conn);
+
+	if (conn->pipeline != NULL) {
+		void *entry;
+		while ((entry = M_list_take_first(conn->pipeline)) != NULL)
+			M_free(entry);
+		M_list_destroy(conn->pipeline, M_TRUE);
+	}
+
+	if (conn->pipeline_free != NULL) {
+		while ((dstmt = M_list_take_first(conn->pipeline_free)) != NULL)
+			pgsql_free_stmt(dstmt);
+		M_list_destroy(conn->pipeline_free, M_TRUE);
+	}
+
 	M_free(conn);
 }
 
@@ -369,10 +405,31 @@ static void pgsql_free_stmt(M_sql_driver_stmt_t *stmt)
 }
 
 
+static void pgsql_pipeline_queue(M_sql_driver_conn_t *dconn, pgsql_pipeline_type_t type, M_sql_stmt_t *stmt, M_sql_driver_stmt_t *dstmt, size_t rows_executed)
+{
+	pgsql_pipeline_entry_t *entry = M_malloc_zero(sizeof(*entry));
+
+	entry->type          = type;
+	entry->stmt          = stmt;
+	entry->dstmt         = dstmt;
+	entry->rows_executed = rows_executed;
+
+	M_list_insert(dconn->pipeline, entry);
+}
+
+
 static void pgsql_cb_prepare_destroy(M_sql_driver_stmt_t *stmt)
 {
 	M_sql_conn_t          *conn  = stmt->conn;
 	M_sql_driver_conn_t   *dconn = M_sql_driver_conn_get_conn(conn);
+
+	/* Can't run the DEALLOCATE in the middle of a pipeline, and a queued request
+	 * may still reference this handle.  Destroyed when the pipeline ends. */
+	if (dconn->in_pipeline) {
+		M_list_insert(dconn->pipeline_free, stmt);
+		return;
+	}
+
 	if (M_sql_conn_get_state(conn) != M_SQL_CONN_STATE_FAILED) {
 		char                   query[256];
 		PGresult              *res;
@@ -562,6 +619,20 @@ static M_sql_error_t pgsql_cb_prepare(M_sql_driver_stmt_t **driver_stmt, M_sql_c
 	}
 
 	M_snprintf(psid, sizeof(psid), "ps%zu", (*driver_stmt)->id);
+
+	/* The result is read back with the rest of the pipeline */
+	if (dconn->in_pipeline) {
+		if (!PQsendPrepare(dconn->conn, psid, M_sql_driver_stmt_get_query(stmt), (int)(*driver_stmt)->bind.cnt, (*driver_stmt)->bind.oids)) {
+			err = M_SQL_ERROR_CONN_LOST;
+			M_snprintf(error, error_size, "PQsendPrepare failed: %s", PQerrorMessage(dconn->conn));
+			pgsql_sanitize_error(error);
+			goto done;
+		}
+		pgsql_pipeline_queue(dconn, PGSQL_PIPELINE_PREPARE, stmt, *driver_stmt, 0);
+		err = M_SQL_ERROR_SUCCESS;
+		goto done;
+	}
+
 	res = PQprepare(dconn->conn, psid, M_sql_driver_stmt_get_query(stmt), (int)(*driver_stmt)->bind.cnt, (*driver_stmt)->bind.oids);
 	if (res == NULL) {
 		err = M_SQL_ERROR_PREPARE_INVALID;
@@ -656,31 +727,13 @@ static void pgsql_clear_remaining_data(M_sql_conn_t *conn)
 }
 
 
-static M_sql_error_t pgsql_cb_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt, size_t *rows_executed, char *error, size_t error_size)
+/*! Read the result of an execution, also used for pipelined executions */
+static M_sql_error_t pgsql_execute_result(M_sql_conn_t *conn, M_sql_stmt_t *stmt, M_sql_driver_stmt_t *dstmt, size_t rows_executed, char *error, size_t error_size)
 {
 	M_sql_driver_conn_t   *dconn = M_sql_driver_conn_get_conn(conn);
-	M_sql_driver_stmt_t   *dstmt = M_sql_driver_stmt_get_stmt(stmt);
-	char                   psid[32];
 	M_sql_error_t          err;
 	size_t                 affected_rows = 0;
 
-	M_snprintf(psid, sizeof(psid), "ps%zu", dstmt->id);
-
-	/* https://www.postgresql.org/message-id/20160331195656.17bc0e3b%40slate.meme.com */
-
-	if (!PQsendQueryPrepared(dconn->conn, psid, (int)dstmt->bind.cnt, dstmt->bind.values,
-	    dstmt->bind.lengths, dstmt->bind.formats, 0 /* Always text response, we can't handle every OID otherwise */)) {
-		M_snprintf(error, error_size, "PQsendQueryPrepared failed: %s", PQerrorMessage(dconn->conn));
-		pgsql_sanitize_error(error);
-		return M_SQL_ERROR_CONN_LOST;
-	}
-
-	if (!PQsetSingleRowMode(dconn->conn)) {
-		M_snprintf(error, error_size, "PQsetSingleRowMode failed: %s", PQerrorMessage(dconn->conn));
-		pgsql_sanitize_error(error);
-		return M_SQL_ERROR_CONN_LOST;
-	}
-
 	dstmt->res = PQgetResult(dconn->conn);
 	if (dstmt->res == NULL) {
 		M_snprintf(error, error_size, "PQgetResult failed: %s", PQerrorMessage(dconn->conn));
@@ -704,6 +757,13 @@ static M_sql_error_t pgsql_cb_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt, si
 		case PGRES_SINGLE_TUPLE:
 			err = M_SQL_ERROR_SUCCESS_ROW;
 			break;
+#ifdef LIBPQ_HAS_PIPELINING
+		case PGRES_PIPELINE_ABORTED:
+			/* Server skips everything after a failure until the sync point */
+			err = M_SQL_ERROR_QUERY_FAILURE;
+			M_snprintf(error, error_size, "not executed, prior statement in batch failed");
+			break;
+#endif
 		default:
 			err = pgsql_resolve_error(PQresultErrorField(dstmt->res, PG_DIAG_SQLSTATE), 0);
 			M_snprintf(error, error_size, "%s: %s", PQresultErrorField(dstmt->res, PG_DIAG_SQLSTATE), PQresultErrorMessage(dstmt->res));
@@ -721,16 +781,12 @@ static M_sql_error_t pgsql_cb_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt, si
 		pgsql_clear_remaining_data(conn);
 	}
 
-	/* Get number of rows that are processed at once, supports
-	 * comma-delimited values for inserting multiple rows. */
-	*rows_executed = pgsql_num_process_rows(M_sql_driver_stmt_bind_rows(stmt));
-
 	/* Special case for using INSERT ... ON CONFLICT DO NOTHING, if affected rows doesn't
 	 * match executed rows, there must have been a conflict, modify the error code */
 	if (err == M_SQL_ERROR_SUCCESS &&
 	    M_str_caseeq_max(M_sql_driver_stmt_get_query(stmt), "INSERT", 6) &&
-	    affected_rows != (*rows_executed)) {
-		M_snprintf(error, error_size, "CONFLICT DETECTED ON INSERT (affected %zu vs expected %zu)", affected_rows, *rows_executed);
+	    affected_rows != rows_executed) {
+		M_snprintf(error, error_size, "CONFLICT DETECTED ON INSERT (affected %zu vs expected %zu)", affected_rows, rows_executed);
 		err = M_SQL_ERROR_QUERY_CONSTRAINT;
 	}
 
@@ -738,6 +794,46 @@ static M_sql_error_t pgsql_cb_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt, si
 }
 
 
+static M_sql_error_t pgsql_cb_execute(M_sql_conn_t *conn, M_sql_stmt_t *stmt, size_t *rows_executed, char *error, size_t error_size)
+{
+	M_sql_driver_conn_t   *dconn = M_sql_driver_conn_get_conn(conn);
+	M_sql_driver_stmt_t   *dstmt = M_sql_driver_stmt_get_stmt(stmt);
+	char                   psid[32];
+
+	M_snprintf(psid, sizeof(psid), "ps%zu", dstmt->id);
+
+	/* https://www.postgresql.org/message-id/20160331195656.17bc0e3b%40slate.meme.com */
+
+	if (!PQsendQueryPrepared(dconn->conn, psid, (int)dstmt->bind.cnt, dstmt->bind.values,
+	    dstmt->bind.lengths, dstmt->bind.formats, 0 /* Always text response, we can't handle every OID otherwise */)) {
+		M_snprintf(error, error_size, "PQsendQueryPrepared failed: %s", PQerrorMessage(dconn->conn));
+		pgsql_sanitize_error(error);
+		return M_SQL_ERROR_CONN_LOST;
+	}
+
+	/* Single row mode applies to the request at the head of libpq's queue.  In a
+	 * pipeline that may be an earlier queued request (such as our own prepare),
+	 * so pipelined executions receive their rows as one complete result. */
+	if (!dconn->in_pipeline && !PQsetSingleRowMode(dconn->conn)) {
+		M_snprintf(error, error_size, "PQsetSingleRowMode failed: %s", PQerrorMessage(dconn->conn));
+		pgsql_sanitize_error(error);
+		return M_SQL_ERROR_CONN_LOST;
+	}
+
+	/* Get number of rows that are processed at once, supports
+	 * comma-delimited values for inserting multiple rows. */
+	*rows_executed = pgsql_num_process_rows(M_sql_driver_stmt_bind_rows(stmt));
+
+	/* Result is read back via pgsql_cb_pipeline_result() */
+	if (dconn->in_pipeline) {
+		pgsql_pipeline_queue(dconn, PGSQL_PIPELINE_EXECUTE, stmt, dstmt, *rows_executed);
+		return M_SQL_ERROR_SUCCESS;
+	}
+
+	return pgsql_execute_result(conn, stmt, dstmt, *rows_executed, error, error_size);
+}
+
+
 /* XXX: Fetch Cancel ? */
 
 static M_sql_error_t pgsql_cb_fetch(M_sql_conn_t *conn, M_sql_stmt_t *stmt, char *error, size_t error_size)
@@ -794,6 +890,13 @@ static M_sql_error_t pgsql_cb_fetch(M_sql_conn_t *conn, M_sql_stmt_t *stmt, char
 		M_sql_driver_stmt_result_row_finish(stmt);
 	}
 
+	/* A complete result set is always the final result for the query, either the
+	 * terminator of single row mode or every row of a pipelined execution. */
+	if (status == PGRES_TUPLES_OK) {
+		err = M_SQL_ERROR_SUCCESS;
+		goto done;
+	}
+
 	/* Fetch next row */
 	PQclear(dstmt->res);
 	dstmt->res = PQgetResult(dconn->conn);
@@ -896,11 +999,346 @@ static M_sql_error_t pgsql_cb_commit(M_sql_conn_t *conn, char *error, size_t err
 }
 
 
+/*! Escape a value for COPY text format */
+static void pgsql_copy_add_escaped(M_buf_t *buf, const char *data, size_t len)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		switch (data[i]) {
+			case '\\':
+				M_buf_add_str(buf, "\\\\");
+				break;
+			case '\t':
+				M_buf_add_str(buf, "\\t");
+				break;
+			case '\n':
+				M_buf_add_str(buf, "\\n");
+				break;
+			case '\r':
+				M_buf_add_str(buf, "\\r");
+				break;
+			default:
+				M_buf_add_byte(buf, (unsigned char)data[i]);
+				break;
+		}
+	}
+}
+
+
+static M_bool pgsql_copy_add_row(M_buf_t *buf, M_sql_stmt_t *stmt, size_t row, size_t num_cols, char *error, size_t error_size)
+{
+	const M_uint8 *bin;
+	size_t         len;
+	size_t         i;
+	size_t         j;
+
+	for (i=0; i<num_cols; i++) {
+		if (i != 0)
+			M_buf_add_byte(buf, '\t');
+
+		if (M_sql_driver_stmt_bind_isnull(stmt, row, i)) {
+			M_buf_add_str(buf, "\\N");
+			continue;
+		}
+
+		switch (M_sql_driver_stmt_bind_get_type(stmt, row, i)) {
+			case M_SQL_DATA_TYPE_BOOL:
+				M_buf_add_byte(buf, M_sql_driver_stmt_bind_get_bool(stmt, row, i) ? '1' : '0');
+				break;
+			case M_SQL_DATA_TYPE_INT16:
+				M_buf_add_int(buf, M_sql_driver_stmt_bind_get_int16(stmt, row, i));
+				break;
+			case M_SQL_DATA_TYPE_INT32:
+				M_buf_add_int(buf, M_sql_driver_stmt_bind_get_int32(stmt, row, i));
+				break;
+			case M_SQL_DATA_TYPE_INT64:
+				M_buf_add_int(buf, M_sql_driver_stmt_bind_get_int64(stmt, row, i));
+				break;
+			case M_SQL_DATA_TYPE_TEXT:
+				pgsql_copy_add_escaped(buf, M_sql_driver_stmt_bind_get_text(stmt, row, i), M_sql_driver_stmt_bind_get_text_len(stmt, row, i));
+				break;
+			case M_SQL_DATA_TYPE_BINARY:
+				/* bytea hex input format, the backslash itself needs escaping */
+				bin = M_sql_driver_stmt_bind_get_binary(stmt, row, i);
+				len = M_sql_driver_stmt_bind_get_binary_len(stmt, row, i);
+				M_buf_add_str(buf, "\\\\x");
+				for (j=0; j<len; j++)
+					M_buf_add_bytehex(buf, bin[j], M_FALSE);
+				break;
+			default:
+				M_snprintf(error, error_size, "Unknown parameter type for row %zu, col %zu", row, i);
+				return M_FALSE;
+		}
+	}
+	M_buf_add_byte(buf, '\n');
+
+	return M_TRUE;
+}
+
+
+static M_sql_error_t pgsql_cb_bulkload(M_sql_conn_t *conn, const char *table_name, const M_list_str_t *cols, M_sql_stmt_t *stmt, char *error, size_t error_size)
+{
+#define PGSQL_COPY_CHUNK (64 * 1024)
+	M_sql_driver_conn_t *dconn     = M_sql_driver_conn_get_conn(conn);
+	size_t               num_rows  = M_sql_driver_stmt_bind_rows(stmt);
+	size_t               num_cols  = M_sql_driver_stmt_bind_cnt(stmt);
+	M_sql_error_t        err       = M_SQL_ERROR_SUCCESS;
+	const char          *abort_msg = NULL;
+	M_buf_t             *buf;
+	PGresult            *res;
+	size_t               row;
+	size_t               i;
+
+	/* Text rather than binary format, binary requires every value to exactly
+	 * match the column type while the server converts text for us. */
+	buf = M_buf_create();
+	M_buf_add_str(buf, "COPY \"");
+	M_buf_add_str(buf, table_name);
+	M_buf_add_str(buf, "\" (");
+	for (i=0; i<M_list_str_len(cols); i++) {
+		if (i != 0)
+			M_buf_add_str(buf, ", ");
+		M_buf_add_str(buf, "\"");
+		M_buf_add_str(buf, M_list_str_at(cols, i));
+		M_buf_add_str(buf, "\"");
+	}
+	M_buf_add_str(buf, ") FROM STDIN");
+
+	res = PQexec(dconn->conn, M_buf_peek(buf));
+	M_buf_truncate(buf, 0);
+	if (res == NULL) {
+		M_snprintf(error, error_size, "COPY failed - NULL: %s", PQerrorMessage(dconn->conn));
+		pgsql_sanitize_error(error);
+		M_buf_cancel(buf);
+		return M_SQL_ERROR_CONN_LOST;
+	}
+	if (PQresultStatus(res) != PGRES_COPY_IN) {
+		err = pgsql_resolve_error(PQresultErrorField(res, PG_DIAG_SQLSTATE), 0);
+		M_snprintf(error, error_size, "COPY failed: %s: %s", PQresultErrorField(res, PG_DIAG_SQLSTATE), PQresultErrorMessage(res));
+		pgsql_sanitize_error(error);
+		PQclear(res);
+		pgsql_clear_remaining_data(conn);
+		M_buf_cancel(buf);
+		return err;
+	}
+	PQclear(res);
+
+	for (row=0; row<num_rows; row++) {
+		if (!pgsql_copy_add_row(buf, stmt, row, num_cols, error, error_size)) {
+			abort_msg = error;
+			break;
+		}
+
+		if (M_buf_len(buf) >= PGSQL_COPY_CHUNK || row == num_rows - 1) {
+			if (PQputCopyData(dconn->conn, M_buf_peek(buf), (int)M_buf_len(buf)) != 1) {
+				M_snprintf(error, error_size, "PQputCopyData failed: %s", PQerrorMessage(dconn->conn));
+				pgsql_sanitize_error(error);
+				M_buf_cancel(buf);
+				return M_SQL_ERROR_CONN_LOST;
+			}
+			M_buf_truncate(buf, 0);
+		}
+	}
+	M_buf_cancel(buf);
+
+	/* A message aborts the copy, the server then reports a failure */
+	if (PQputCopyEnd(dconn->conn, abort_msg) != 1) {
+		M_snprintf(error, error_size, "PQputCopyEnd failed: %s", PQerrorMessage(dconn->conn));
+		pgsql_sanitize_error(error);
+		return M_SQL_ERROR_CONN_LOST;
+	}
+
+	res = PQgetResult(dconn->conn);
+	if (res == NULL) {
+		M_snprintf(error, error_size, "PQgetResult failed: %s", PQerrorMessage(dconn->conn));
+		pgsql_sanitize_error(error);
+		return M_SQL_ERROR_CONN_LOST;
+	}
+
+	if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+		M_sql_driver_stmt_result_set_affected_rows(stmt, (size_t)M_str_to_uint64(PQcmdTuples(res)));
+	} else if (abort_msg != NULL) {
+		err = M_SQL_ERROR_INVALID_USE;
+	} else {
+		err = pgsql_resolve_error(PQresultErrorField(res, PG_DIAG_SQLSTATE), 0);
+		M_snprintf(error, error_size, "%s: %s", PQresultErrorField(res, PG_DIAG_SQLSTATE), PQresultErrorMessage(res));
+		pgsql_sanitize_error(error);
+	}
+	PQclear(res);
+	pgsql_clear_remaining_data(conn);
+
+	return err;
+}
+
+
+#ifdef LIBPQ_HAS_PIPELINING
+
+static M_sql_error_t pgsql_cb_pipeline_begin(M_sql_conn_t *conn, char *error, size_t error_size)
+{
+	M_sql_driver_conn_t *dconn = M_sql_driver_conn_get_conn(conn);
+
+	if (!PQenterPipelineMode(dconn->conn)) {
+		M_snprintf(error, error_size, "PQenterPipelineMode failed: %s", PQerrorMessage(dconn->conn));
+		pgsql_sanitize_error(error);
+		return M_SQL_ERROR_CONN_LOST;
+	}
+
+	if (dconn->pipeline == NULL)
+		dconn->pipeline = M_list_create(NULL, M_LIST_NONE);
+	if (dconn->pipeline_free == NULL)
+		dconn->pipeline_free = M_list_create(NULL, M_LIST_NONE);
+
+	dconn->in_pipeline = M_TRUE;
+	dconn->synced      = M_FALSE;
+	return M_SQL_ERROR_SUCCESS;
+}
+
+
+static M_sql_error_t pgsql_cb_pipeline_flush(M_sql_conn_t *conn, char *error, size_t error_size)
+{
+	M_sql_driver_conn_t *dconn = M_sql_driver_conn_get_conn(conn);
+
+	/* In blocking mode libpq reads incoming data while it waits to write, so a
+	 * large pipeline can't deadlock against the server's output buffer. */
+	dconn->synced = M_TRUE;
+	if (!PQpipelineSync(dconn->conn)) {
+		M_snprintf(error, error_size, "PQpipelineSync failed: %s", PQerrorMessage(dconn->conn));
+		pgsql_sanitize_error(error);
+		return M_SQL_ERROR_CONN_LOST;
+	}
+
+	return M_SQL_ERROR_SUCCESS;
+}
+
+
+static M_sql_error_t pgsql_pipeline_prepare_result(M_sql_conn_t *conn, char *error, size_t error_size)
+{
+	M_sql_driver_conn_t *dconn = M_sql_driver_conn_get_conn(conn);
+	M_sql_error_t        err   = M_SQL_ERROR_SUCCESS;
+	PGresult            *res;
+
+	res = PQgetResult(dconn->conn);
+	if (res == NULL) {
+		M_snprintf(error, error_size, "PQgetResult failed: %s", PQerrorMessage(dconn->conn));
+		pgsql_sanitize_error(error);
+		return M_SQL_ERROR_CONN_LOST;
+	}
+
+	if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+		err = pgsql_resolve_error(PQresultErrorField(res, PG_DIAG_SQLSTATE), 0);
+		if (err != M_SQL_ERROR_SUCCESS) {
+			M_snprintf(error, error_size, "PQsendPrepare failed: %s: %s", PQresultErrorField(res, PG_DIAG_SQLSTATE), PQresultErrorMessage(res));
+			pgsql_sanitize_error(error);
+		}
+	}
+
+	PQclear(res);
+	pgsql_clear_remaining_data(conn);
+	return err;
+}
+
+
+static M_sql_error_t pgsql_cb_pipeline_result(M_sql_conn_t *conn, M_sql_stmt_t *stmt, char *error, size_t error_size)
+{
+	M_sql_driver_conn_t    *dconn = M_sql_driver_conn_get_conn(conn);
+	M_sql_error_t           err   = M_SQL_ERROR_SUCCESS;
+	M_sql_driver_stmt_t    *last  = NULL;
+	pgsql_pipeline_entry_t *entry;
+
+	/* A statement may have been queued as a prepare plus one or more executions
+	 * if its bound rows were split.  The first failure is the one reported. */
+	while ((entry = M_CAST_OFF_CONST(pgsql_pipeline_entry_t *, M_list_first(dconn->pipeline))) != NULL && entry->stmt == stmt) {
+		M_sql_error_t myerr;
+
+		entry = M_list_take_first(dconn->pipeline);
+
+		if (M_sql_error_is_error(err)) {
+			pgsql_clear_remaining_data(conn);
+			M_free(entry);
+			continue;
+		}
+
+		/* Rows can only be returned for the final execution */
+		if (err == M_SQL_ERROR_SUCCESS_ROW && last != NULL && last->res != NULL) {
+			PQclear(last->res);
+			last->res = NULL;
+			pgsql_clear_remaining_data(conn);
+		}
+
+		if (entry->type == PGSQL_PIPELINE_PREPARE) {
+			myerr = pgsql_pipeline_prepare_result(conn, error, error_size);
+		} else {
+			myerr = pgsql_execute_result(conn, stmt, entry->dstmt, entry->rows_executed, error, error_size);
+		}
+
+		if (entry->type == PGSQL_PIPELINE_EXECUTE || M_sql_error_is_error(myerr))
+			err = myerr;
+		last = entry->dstmt;
+
+		M_free(entry);
+	}
+
+	return err;
+}
+
+
+static M_sql_error_t pgsql_cb_pipeline_end(M_sql_conn_t *conn)
+{
+	M_sql_driver_conn_t    *dconn = M_sql_driver_conn_get_conn(conn);
+	M_sql_error_t           err   = M_SQL_ERROR_SUCCESS;
+	pgsql_pipeline_entry_t *entry;
+	M_sql_driver_stmt_t    *dstmt;
+	PGresult               *res;
+
+	if (!dconn->synced) {
+		dconn->synced = M_TRUE;
+		PQpipelineSync(dconn->conn);
+	}
+
+	/* Discard any results that were never requested */
+	while ((entry = M_list_take_first(dconn->pipeline)) != NULL) {
+		if (entry->dstmt->res != NULL) {
+			PQclear(entry->dstmt->res);
+			entry->dstmt->res = NULL;
+		}
+		pgsql_clear_remaining_data(conn);
+		M_free(entry);
+	}
+
+	/* Consume the sync point */
+	while ((res = PQgetResult(dconn->conn)) != NULL) {
+		ExecStatusType status = PQresultStatus(res);
+		PQclear(res);
+		if (status == PGRES_PIPELINE_SYNC)
+			break;
+	}
+
+	if (!PQexitPipelineMode(dconn->conn)) {
+		char msg[256];
+		M_snprintf(msg, sizeof(msg), "PQexitPipelineMode failed: %s", PQerrorMessage(dconn->conn));
+		pgsql_sanitize_error(msg);
+		M_sql_driver_trace_message(M_FALSE, NULL, conn, M_SQL_ERROR_CONN_LOST, msg);
+		err = M_SQL_ERROR_CONN_LOST;
+	}
+	dconn->in_pipeline = M_FALSE;
+
+	/* Statement handles released during the pipeline can now be deallocated */
+	while ((dstmt = M_list_take_first(dconn->pipeline_free)) != NULL) {
+		pgsql_cb_prepare_destroy(dstmt);
+	}
+
+	return err;
+}
+
+#endif
+
+
 static M_sql_driver_t M_sql_postgresql = {
 	M_SQL_DRIVER_VERSION,         /* Driver/Module subsystem version */
 	"postgresql",                 /* Short name of module */
 	"PostgreSQL driver for mstdlib",  /* Display name of module */
-	"1.0.2",                      /* Internal module version */
+	"1.0.3",                      /* Internal module version */
 
 	NULL,                         /* Callback used for getting connection-specific flags */
 	pgsql_cb_init,                /* Callback used for module initialization. */
@@ -927,6 +1365,19 @@ static M_sql_driver_t M_sql_postgresql = {
 	NULL,                         /* Callback used to rewrite an index name to comply with DB requirements */
 
 	NULL,                         /* Handle for loaded driver - must be initialized to NULL */
+
+#ifdef LIBPQ_HAS_PIPELINING
+	pgsql_cb_pipeline_begin,      /* Callback used to enter pipeline mode */
+	pgsql_cb_pipeline_flush,      /* Callback used to send queued pipeline requests */
+	pgsql_cb_pipeline_result,     /* Callback used to retrieve the result of the next queued statement */
+	pgsql_cb_pipeline_end,        /* Callback used to leave pipeline mode */
+#else
+	NULL,                         /* Callback used to enter pipeline mode */
+	NULL,                         /* Callback used to send queued pipeline requests */
+	NULL,                         /* Callback used to retrieve the result of the next queued statement */
+	NULL,                         /* Callback used to leave pipeline mode */
+#endif
+	pgsql_cb_bulkload,            /* Callback used to bulk load rows into a table */
 };
 
 /*! Defines function that references M_sql_driver_t M_sql_##name for module loading */
@@ -881,27 +881,33 @@ static M_sql_error_t sqlite_cb_fetch(M_sql_conn_t *conn, M_sql_stmt_t *stmt, cha
 
 		/* Output the current row of data */
 		for (i=0; i<(size_t)sqlite3_column_count(driver_stmt->stmt); i++) {
-			M_buf_t *buf  = M_sql_driver_stmt_result_col_start(stmt);
 			int      type = sqlite3_column_type(driver_stmt->stmt, (int)i);
 
-			switch (type) {
-				case SQLITE_INTEGER:
-					M_buf_add_int(buf, sqlite3_column_int64(driver_stmt->stmt, (int)i));
-					break;
-				case SQLITE_BLOB:
-					M_buf_add_bytes(buf, sqlite3_column_blob(driver_stmt->stmt, (int)i), (size_t)sqlite3_column_bytes(driver_stmt->stmt, (int)i));
-					break;
-				case SQLITE_NULL:
-					/* Append nothing */
-					break;
-				default:
-					M_buf_add_str(buf, (const char *)sqlite3_column_text(driver_stmt->stmt, (int)i));
-					break;
-			}
+			/* Integers are stored natively so they don't need to be formatted and re-parsed */
+			if (type == SQLITE_INTEGER && M_sql_stmt_result_col_type(stmt, i, NULL) != M_SQL_DATA_TYPE_BINARY) {
+				M_sql_driver_stmt_result_col_int64(stmt, sqlite3_column_int64(driver_stmt->stmt, (int)i));
+			} else {
+				M_buf_t *buf  = M_sql_driver_stmt_result_col_start(stmt);
 
-			if (type != SQLITE_NULL) {
-				/* All columns with data require NULL termination, even binary.  Otherwise its considered a NULL column. */
-				M_buf_add_byte(buf, 0); /* Manually add NULL terminator */
+				switch (type) {
+					case SQLITE_INTEGER:
+						M_buf_add_int(buf, sqlite3_column_int64(driver_stmt->stmt, (int)i));
+						break;
+					case SQLITE_BLOB:
+						M_buf_add_bytes(buf, sqlite3_column_blob(driver_stmt->stmt, (int)i), (size_t)sqlite3_column_bytes(driver_stmt->stmt, (int)i));
+						break;
+					case SQLITE_NULL:
+						/* Append nothing */
+						break;
+					default:
+						M_buf_add_str(buf, (const char *)sqlite3_column_text(driver_stmt->stmt, (int)i));
+						break;
+				}
+
+				if (type != SQLITE_NULL) {
+					/* All columns with data require NULL termination, even binary.  Otherwise its considered a NULL column. */
+					M_buf_add_byte(buf, 0); /* Manually add NULL terminator */
+				}
 			}
 
 			/* NOTE: Funky FixUp! */
@@ -1081,6 +1087,12 @@ static M_sql_driver_t M_sql_sqlite = {
 	NULL,                         /* Callback used to rewrite an index name to comply with DB requirements */
 
 	NULL,                         /* Handle for loaded driver - must be initialized to NULL */
+
+	NULL,                         /* Callback used to enter pipeline mode */
+	NULL,                         /* Callback used to send queued pipeline requests */
+	NULL,                         /* Callback used to retrieve the result of the next queued statement */
+	NULL,                         /* Callback used to leave pipeline mode */
+	NULL,                         /* Callback used to bulk load rows into a table */
 };
 
 /*! Defines function that references M_sql_driver_t M_sql_##name for module loading */
@@ -256,6 +256,204 @@ START_TEST(check_write_cell_edit)
 END_TEST
 
 
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+typedef struct {
+	M_buf_t *buf;
+	size_t   num_cols;
+	size_t   stop_after;
+} reader_thunk_t;
+
+static void reader_add_cell(M_buf_t *buf, const char *cell)
+{
+	if (cell == NULL) {
+		M_buf_add_str(buf, "<NULL>");
+	} else {
+		M_buf_add_byte(buf, '[');
+		M_buf_add_str(buf, cell);
+		M_buf_add_byte(buf, ']');
+	}
+	M_buf_add_byte(buf, '|');
+}
+
+/* M_csv uses the first row to determine the number of columns so the reader
+ * rows are truncated or padded the same way for comparison. */
+static M_bool reader_row_cb(size_t row, const char * const *cells, size_t num_cells, void *thunk)
+{
+	reader_thunk_t *rt = thunk;
+	size_t          i;
+
+	(void)row;
+
+	if (rt->num_cols == 0)
+		rt->num_cols = num_cells;
+
+	for (i=0; i<rt->num_cols; i++)
+		reader_add_cell(rt->buf, i < num_cells ? cells[i] : NULL);
+	M_buf_add_byte(rt->buf, '\n');
+
+	if (rt->stop_after != 0 && row+1 >= rt->stop_after)
+		return M_FALSE;
+	return M_TRUE;
+}
+
+static char *reader_parse_expected(const char *data, M_uint32 flags)
+{
+	M_csv_t *csv;
+	M_buf_t *buf = M_buf_create();
+	size_t   num_rows;
+	size_t   num_cols;
+	size_t   i;
+	size_t   j;
+
+	csv = M_csv_parse(data, M_str_len(data), ',', '"', flags);
+	if (csv != NULL) {
+		num_rows = M_csv_get_numrows(csv);
+		num_cols = M_csv_get_numcols(csv);
+		for (i=0; i<num_cols; i++)
+			reader_add_cell(buf, M_csv_get_header(csv, i));
+		if (num_cols > 0)
+			M_buf_add_byte(buf, '\n');
+		for (i=0; i<num_rows; i++) {
+			for (j=0; j<num_cols; j++)
+				reader_add_cell(buf, M_csv_get_cellbynum(csv, i, j));
+			M_buf_add_byte(buf, '\n');
+		}
+	}
+	M_csv_destroy(csv);
+
+	return M_buf_finish_str(buf, NULL);
+}
+
+static char *reader_parse_chunked(const char *data, size_t len, M_uint32 flags, size_t chunk_size)
+{
+	M_csv_reader_t *reader;
+	reader_thunk_t  rt;
+	size_t          pos;
+	size_t          n;
+
+	M_mem_set(&rt, 0, sizeof(rt));
+	rt.buf = M_buf_create();
+	reader = M_csv_reader_create(',', '"', flags, reader_row_cb, &rt);
+
+	for (pos=0; pos<len; pos+=n) {
+		n = M_MIN(chunk_size, len - pos);
+		ck_assert_msg(M_csv_reader_read(reader, data + pos, n), "read failed at %zu", pos);
+	}
+	ck_assert_msg(M_csv_reader_finish(reader), "finish failed");
+	M_csv_reader_destroy(reader);
+
+	return M_buf_finish_str(rt.buf, NULL);
+}
+
+static const char *reader_data[] = {
+	CSV_DATA,
+	CSV_DATA_SIMPLE,
+	"a,b,c\n1,\"two \"\"quoted\"\" words\",3\n4,\"multi\nline\r\ncell\",6\n",
+	"a,b\n\"\"\"\",\"\"\n\"x\"\"\",y\n",
+	"a,b,c\n  1 , 2 ,\" 3 \"\n\n\n4,5,6",
+	"a;b,c\r\n1\r2,3\r\n,,\r\n",
+	"h1,h2\nx,\"unterminated\nquote",
+	"single",
+	"a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q,r,s,t,u,v,w,x,y,z\n"
+	"0123456789abcdef0123456789abcdef,\"0123456789abcdef,0123456789abcdef\"\"0123456789abcdef\"\n",
+	NULL
+};
+
+START_TEST(check_reader_chunks)
+{
+	M_uint32 flags[] = { M_CSV_FLAG_NONE, M_CSV_FLAG_TRIM_WHITESPACE };
+	char    *expected;
+	char    *out;
+	size_t   len;
+	size_t   chunk;
+	size_t   i;
+	size_t   f;
+
+	for (i=0; reader_data[i] != NULL; i++) {
+		len = M_str_len(reader_data[i]);
+		for (f=0; f<sizeof(flags)/sizeof(*flags); f++) {
+			expected = reader_parse_expected(reader_data[i], flags[f]);
+			for (chunk=1; chunk<=len; chunk++) {
+				out = reader_parse_chunked(reader_data[i], len, flags[f], chunk);
+				ck_assert_msg(M_str_eq(out, expected), "data %zu, flags %u, chunk %zu: got '%s', expected '%s'", i, flags[f], chunk, out, expected);
+				M_free(out);
+			}
+			M_free(expected);
+		}
+	}
+}
+END_TEST
+
+START_TEST(check_reader_split)
+{
+	M_buf_t *buf = M_buf_create();
+	M_buf_t *parts;
+	char    *data;
+	char    *expected;
+	char    *out;
+	size_t   offsets[8];
+	size_t   num_offsets = sizeof(offsets)/sizeof(*offsets);
+	size_t   num;
+	size_t   len;
+	size_t   end;
+	size_t   i;
+
+	M_buf_add_str(buf, "id,name,note\n");
+	for (i=0; i<200; i++)
+		M_bprintf(buf, "%zu,\"name %zu\",\"line one\nline \"\"two\"\"\"\n", i, i);
+	data = M_buf_finish_str(buf, &len);
+
+	expected = reader_parse_chunked(data, len, M_CSV_FLAG_NONE, len);
+
+	num = M_csv_split_rows(data, len, '"', offsets, num_offsets);
+	ck_assert_msg(num == num_offsets, "got %zu pieces, expected %zu", num, num_offsets);
+	ck_assert_msg(offsets[0] == 0, "first piece does not start at 0");
+
+	/* Each piece is read on its own and the output joined back together. The
+	 * column count is taken from the first row of each piece so it always
+	 * matches since every row has the same number of cells. */
+	parts = M_buf_create();
+	for (i=0; i<num; i++) {
+		end = (i+1 < num) ? offsets[i+1] : len;
+		ck_assert_msg(end > offsets[i], "piece %zu is empty", i);
+		ck_assert_msg(offsets[i] == 0 || data[offsets[i]-1] == '\n', "piece %zu does not start a row", i);
+		out = reader_parse_chunked(data + offsets[i], end - offsets[i], M_CSV_FLAG_NONE, 4096);
+		M_buf_add_str(parts, out);
+		M_free(out);
+	}
+	ck_assert_msg(M_str_eq(M_buf_peek(parts), expected), "split output doesn't match");
+	M_buf_cancel(parts);
+
+	/* Not enough rows for the requested number of pieces. */
+	num = M_csv_split_rows("a,b\n1,2\n", 8, '"', offsets, num_offsets);
+	ck_assert_msg(num == 2 && offsets[1] == 4, "got %zu pieces for two rows", num);
+
+	M_free(expected);
+	M_free(data);
+}
+END_TEST
+
+START_TEST(check_reader_stop)
+{
+	M_csv_reader_t *reader;
+	reader_thunk_t  rt;
+
+	M_mem_set(&rt, 0, sizeof(rt));
+	rt.buf        = M_buf_create();
+	rt.stop_after = 2;
+	reader        = M_csv_reader_create(',', '"', M_CSV_FLAG_NONE, reader_row_cb, &rt);
+
+	ck_assert_msg(!M_csv_reader_read(reader, CSV_DATA, M_str_len(CSV_DATA)), "read should have been stopped");
+	ck_assert_msg(M_csv_reader_num_rows(reader) == 2, "expected 2 rows, got %zu", M_csv_reader_num_rows(reader));
+	ck_assert_msg(!M_csv_reader_read(reader, "a,b\n", 4), "read after stop should fail");
+	ck_assert_msg(M_csv_reader_num_rows(reader) == 2, "rows read after stop");
+
+	M_csv_reader_destroy(reader);
+	M_buf_cancel(rt.buf);
+}
+END_TEST
+
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -274,6 +472,9 @@ int main(void)
 	add_test(suite, check_write_change_headers);
 	add_test(suite, check_write_filter);
 	add_test(suite, check_write_cell_edit);
+	add_test(suite, check_reader_chunks);
+	add_test(suite, check_reader_split);
+	add_test(suite, check_reader_stop);
 
 	sr = srunner_create(suite);
 	if (getenv("CK_LOG_FILE_NAME")==NULL) srunner_set_log(sr, "check_csv.log");
@@ -463,7 +463,8 @@ static M_http_reader_t *gen_reader(void *thunk)
 		multipart_epilouge_done_func,
 		trailer_full_func,
 		trailer_func,
-		trailer_done_func
+		trailer_done_func,
+		NULL /* header_view_func */
 	};
 
 	hr = M_http_reader_create(&cbs, M_HTTP_READER_NONE, thunk);
@@ -1201,6 +1202,111 @@ START_TEST(check_body_len)
 }
 END_TEST
 
+/* Long header values so the vectorized scan has full blocks to look through. */
+#define http_header_view \
+"POST /api/v2/user HTTP/1.1\r\n" \
+"host: localhost:8666\r\n" \
+"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n" \
+"Accept:  text/html, application/xhtml+xml \t\r\n" \
+"X-Custom-Header-Name: abc\r\n" \
+"Empty:\r\n" \
+"CONTENT-LENGTH: 4\r\n" \
+"\r\n" \
+"abcd"
+
+static M_http_error_t header_view_func(const M_http_header_view_t *header, void *thunk)
+{
+	M_buf_t *buf = thunk;
+
+	M_bprintf(buf, "%d|%.*s|", (int)header->id, (int)header->key_len, header->key);
+	if (header->val == NULL) {
+		M_buf_add_str(buf, "(null)");
+	} else {
+		M_buf_add_bytes(buf, header->val, header->val_len);
+	}
+	M_buf_add_byte(buf, '\n');
+	return M_HTTP_ERROR_SUCCESS;
+}
+
+START_TEST(check_header_view)
+{
+	struct M_http_reader_callbacks  cbs;
+	M_http_reader_t                *hr;
+	M_buf_t                        *buf;
+	char                           *out;
+	char                           *expected;
+	size_t                          len      = M_str_len(http_header_view);
+	size_t                          len_read;
+	size_t                          avail;
+	size_t                          i;
+	M_http_error_t                  res;
+
+	M_mem_set(&cbs, 0, sizeof(cbs));
+	cbs.header_view_func = header_view_func;
+
+	M_asprintf(&expected,
+		"%d|host|localhost:8666\n"
+		"%d|User-Agent|Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\n"
+		"%d|Accept|text/html, application/xhtml+xml\n"
+		"%d|X-Custom-Header-Name|abc\n"
+		"%d|Empty|(null)\n"
+		"%d|CONTENT-LENGTH|4\n",
+		(int)M_HTTP_HEADER_HOST, (int)M_HTTP_HEADER_USER_AGENT, (int)M_HTTP_HEADER_ACCEPT,
+		(int)M_HTTP_HEADER_UNKNOWN, (int)M_HTTP_HEADER_UNKNOWN, (int)M_HTTP_HEADER_CONTENT_LENGTH);
+
+	/* All at once, then one more byte each read so lines are split. */
+	for (i=0; i<2; i++) {
+		buf      = M_buf_create();
+		hr       = M_http_reader_create(&cbs, M_HTTP_READER_NONE, buf);
+		len_read = 0;
+		avail    = (i == 0) ? len : 0;
+		res      = M_HTTP_ERROR_MOREDATA;
+		do {
+			size_t myread = 0;
+
+			if (avail < len)
+				avail++;
+			res       = M_http_reader_read(hr, (const unsigned char *)http_header_view + len_read, avail - len_read, &myread);
+			len_read += myread;
+		} while (res == M_HTTP_ERROR_MOREDATA && avail < len);
+
+		ck_assert_msg(res == M_HTTP_ERROR_SUCCESS, "%zu: Read failed: %d", i, res);
+		ck_assert_msg(len_read == len, "%zu: Did not read full message: got %zu, expected %zu", i, len_read, len);
+		out = M_buf_finish_str(buf, NULL);
+		ck_assert_msg(M_str_eq(out, expected), "%zu: Headers do not match: got '%s', expected '%s'", i, out, expected);
+		M_free(out);
+		M_http_reader_destroy(hr);
+	}
+
+	M_free(expected);
+}
+END_TEST
+
+START_TEST(check_header_id)
+{
+	M_http_header_id_t id;
+
+	ck_assert_msg(M_http_header_id_from_str("content-type", 12) == M_HTTP_HEADER_CONTENT_TYPE, "content-type not found");
+	ck_assert_msg(M_http_header_id_from_str("Content-Typex", 12) == M_HTTP_HEADER_CONTENT_TYPE, "Length not honored");
+	ck_assert_msg(M_http_header_id_from_str("Content-Typ", 11) == M_HTTP_HEADER_UNKNOWN, "Prefix matched");
+	ck_assert_msg(M_http_header_id_from_str("X-Unknown", 9) == M_HTTP_HEADER_UNKNOWN, "Unknown header matched");
+	ck_assert_msg(M_http_header_id_from_str("A", 1) == M_HTTP_HEADER_UNKNOWN, "Single character matched");
+	ck_assert_msg(M_http_header_id_from_str(NULL, 0) == M_HTTP_HEADER_UNKNOWN, "NULL matched");
+	ck_assert_msg(M_http_header_id_to_str(M_HTTP_HEADER_UNKNOWN) == NULL, "Unknown has a name");
+
+	/* Every name maps back to its own id regardless of case. */
+	for (id=M_HTTP_HEADER_UNKNOWN+1; M_http_header_id_to_str(id) != NULL; id++) {
+		const char *name = M_http_header_id_to_str(id);
+		char       *lower = M_strdup_lower(name);
+
+		ck_assert_msg(M_http_header_id_from_str(name, M_str_len(name)) == id, "%s did not map to its id", name);
+		ck_assert_msg(M_http_header_id_from_str(lower, M_str_len(lower)) == id, "%s did not map to its id", lower);
+		M_free(lower);
+	}
+	ck_assert_msg(id == M_HTTP_HEADER_X_REQUESTED_WITH+1, "Not all header names were checked");
+}
+END_TEST
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 int main(void)
@@ -1227,6 +1333,8 @@ int main(void)
 	add_test(suite, check_header_format);
 	add_test(suite, check_query_string);
 	add_test(suite, check_body_len);
+	add_test(suite, check_header_view);
+	add_test(suite, check_header_id);
 
 	sr = srunner_create(suite);
 	if (getenv("CK_LOG_FILE_NAME")==NULL) srunner_set_log(sr, "check_http_reader.log");
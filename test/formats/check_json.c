@@ -599,6 +599,86 @@ START_TEST(check_json_jsonpath_array)
 }
 END_TEST
 
+static M_bool check_json_jsonpath_compiled_count(M_json_node_t *node, void *thunk)
+{
+	size_t *count = thunk;
+
+	(void)node;
+	(*count)++;
+	/* Stop after the second match. */
+	return *count < 2;
+}
+
+static void check_json_jsonpath_compiled_search(const M_json_node_t *json, const char *search)
+{
+	M_json_jsonpath_t  *jsonpath;
+	M_json_node_t     **results;
+	M_json_node_t     **compiled_results;
+	size_t              num_matches;
+	size_t              num_compiled;
+	size_t              count;
+	size_t              i;
+
+	jsonpath = M_json_jsonpath_compile(search);
+	ck_assert_msg(jsonpath != NULL, "'%s': could not compile", search);
+
+	/* Evaluate more than once to ensure nothing in the compiled expression changes. */
+	for (i=0; i<2; i++) {
+		results          = M_json_jsonpath(json, search, &num_matches);
+		compiled_results = M_json_jsonpath_eval(jsonpath, json, &num_compiled);
+		ck_assert_msg(num_compiled == num_matches, "'%s': got %zu matches, expected %zu", search, num_compiled, num_matches);
+		if (num_matches > 0) {
+			ck_assert_msg(M_mem_eq(results, compiled_results, num_matches * sizeof(*results)), "'%s': matches differ", search);
+			ck_assert_msg(M_json_jsonpath_first(jsonpath, json) == results[0], "'%s': first match differs", search);
+		} else {
+			ck_assert_msg(M_json_jsonpath_first(jsonpath, json) == NULL, "'%s': first match found", search);
+		}
+
+		count = 0;
+		ck_assert_msg(M_json_jsonpath_foreach(jsonpath, json, check_json_jsonpath_compiled_count, &count) == M_MIN(num_matches, 2), "'%s': foreach did not stop", search);
+		ck_assert_msg(count == M_MIN(num_matches, 2), "'%s': foreach called %zu times", search, count);
+
+		M_free(results);
+		M_free(compiled_results);
+	}
+
+	M_json_jsonpath_destroy(jsonpath);
+}
+
+START_TEST(check_json_jsonpath_compiled)
+{
+	M_json_node_t *json;
+	size_t         i;
+
+	json = M_json_read(JSONPATH_BOOKS, M_str_len(JSONPATH_BOOKS), M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+	ck_assert_msg(json != NULL, "JSONPath books string could not be parsed");
+	for (i=0; check_json_jsonpath_book_data[i].search!=NULL; i++) {
+		check_json_jsonpath_compiled_search(json, check_json_jsonpath_book_data[i].search);
+	}
+	M_json_node_destroy(json);
+
+	json = M_json_read(JSONPATH_STR, M_str_len(JSONPATH_STR), M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+	ck_assert_msg(json != NULL, "JSONPath string could not be parsed");
+	for (i=0; check_json_jsonpath_str_data[i].search!=NULL; i++) {
+		check_json_jsonpath_compiled_search(json, check_json_jsonpath_str_data[i].search);
+	}
+	M_json_node_destroy(json);
+
+	json = M_json_read(JSONPATH_ARRAY, M_str_len(JSONPATH_ARRAY), M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+	ck_assert_msg(json != NULL, "JSONPath array string could not be parsed");
+	check_json_jsonpath_compiled_search(json, "$[1]");
+	check_json_jsonpath_compiled_search(json, "$.[1]");
+	check_json_jsonpath_compiled_search(json, "$..[0]");
+	check_json_jsonpath_compiled_search(json, "$..[-1,0]");
+	check_json_jsonpath_compiled_search(json, "$..[1,-9]");
+	M_json_node_destroy(json);
+
+	/* Expressions must start with '$'. */
+	ck_assert(M_json_jsonpath_compile("a.b") == NULL);
+	ck_assert(M_json_jsonpath_compile("") == NULL);
+}
+END_TEST
+
 START_TEST(check_json_values)
 {
 	M_json_node_t *json;
@@ -863,6 +943,579 @@ START_TEST(check_json_large_number)
 }
 END_TEST
 
+/* Builds a tree from stream reader callbacks so the result can be compared against M_json_read. */
+typedef struct {
+	M_json_node_t *root;
+	M_json_node_t *node;
+	char          *key;
+} check_json_stream_t;
+
+static M_json_error_t check_json_stream_add(check_json_stream_t *s, M_json_node_t *node)
+{
+	if (s->root == NULL) {
+		s->root = node;
+	} else if (M_json_node_type(s->node) == M_JSON_TYPE_OBJECT) {
+		M_json_object_insert(s->node, s->key, node);
+	} else {
+		M_json_array_insert(s->node, node);
+	}
+	if (M_json_node_type(node) == M_JSON_TYPE_OBJECT || M_json_node_type(node) == M_JSON_TYPE_ARRAY)
+		s->node = node;
+	return M_JSON_ERROR_SUCCESS;
+}
+
+static M_json_error_t check_json_stream_object_start(void *thunk)
+{
+	return check_json_stream_add(thunk, M_json_node_create(M_JSON_TYPE_OBJECT));
+}
+
+static M_json_error_t check_json_stream_array_start(void *thunk)
+{
+	return check_json_stream_add(thunk, M_json_node_create(M_JSON_TYPE_ARRAY));
+}
+
+static M_json_error_t check_json_stream_end(void *thunk)
+{
+	check_json_stream_t *s = thunk;
+
+	s->node = M_json_get_parent(s->node);
+	return M_JSON_ERROR_SUCCESS;
+}
+
+static M_json_error_t check_json_stream_key(const char *key, void *thunk)
+{
+	check_json_stream_t *s = thunk;
+
+	M_free(s->key);
+	s->key = M_strdup(key);
+	return M_JSON_ERROR_SUCCESS;
+}
+
+static M_json_error_t check_json_stream_string(const char *val, void *thunk)
+{
+	M_json_node_t *node = M_json_node_create(M_JSON_TYPE_STRING);
+
+	M_json_set_string(node, val);
+	return check_json_stream_add(thunk, node);
+}
+
+static M_json_error_t check_json_stream_integer(M_int64 val, void *thunk)
+{
+	M_json_node_t *node = M_json_node_create(M_JSON_TYPE_INTEGER);
+
+	M_json_set_int(node, val);
+	return check_json_stream_add(thunk, node);
+}
+
+static M_json_error_t check_json_stream_decimal(const M_decimal_t *val, void *thunk)
+{
+	M_json_node_t *node = M_json_node_create(M_JSON_TYPE_DECIMAL);
+
+	M_json_set_decimal(node, val);
+	return check_json_stream_add(thunk, node);
+}
+
+static M_json_error_t check_json_stream_bool(M_bool val, void *thunk)
+{
+	M_json_node_t *node = M_json_node_create(M_JSON_TYPE_BOOL);
+
+	M_json_set_bool(node, val);
+	return check_json_stream_add(thunk, node);
+}
+
+static M_json_error_t check_json_stream_null(void *thunk)
+{
+	return check_json_stream_add(thunk, M_json_node_create(M_JSON_TYPE_NULL));
+}
+
+static M_json_error_t check_json_stream_match_str(const char *search, M_json_node_t *node, void *thunk)
+{
+	M_list_str_t *matches = thunk;
+	char         *out;
+
+	(void)search;
+	out = M_json_write(node, M_JSON_WRITER_NONE, NULL);
+	M_list_str_insert(matches, out);
+	M_free(out);
+	M_json_node_destroy(node);
+	return M_JSON_ERROR_SUCCESS;
+}
+
+static const struct M_json_reader_callbacks check_json_stream_cbs = {
+	check_json_stream_object_start,
+	check_json_stream_end,
+	check_json_stream_array_start,
+	check_json_stream_end,
+	check_json_stream_key,
+	check_json_stream_string,
+	check_json_stream_integer,
+	check_json_stream_decimal,
+	check_json_stream_bool,
+	check_json_stream_null
+};
+
+/* Feed data split at split, or one byte at a time if split is 0. */
+static M_json_error_t check_json_stream_feed(M_json_reader_t *reader, const char *data, size_t split)
+{
+	M_json_error_t res = M_JSON_ERROR_SUCCESS;
+	size_t         len = M_str_len(data);
+	size_t         i;
+
+	if (split == 0) {
+		for (i=0; i<len && res == M_JSON_ERROR_SUCCESS; i++) {
+			res = M_json_reader_read(reader, data+i, 1);
+		}
+	} else {
+		res = M_json_reader_read(reader, data, split);
+		if (res == M_JSON_ERROR_SUCCESS) {
+			res = M_json_reader_read(reader, data+split, len-split);
+		}
+	}
+	if (res == M_JSON_ERROR_SUCCESS)
+		res = M_json_reader_finish(reader);
+	return res;
+}
+
+/* Stream matches must be the same values M_json_jsonpath finds. Each value is only
+ * delivered once by the stream so values M_json_jsonpath reaches more than one way
+ * are only counted once. Order isn't compared. */
+static void check_json_stream_jsonpath_compare(const char *data, const char *search, size_t split)
+{
+	M_json_node_t    *json;
+	M_json_node_t   **results;
+	M_json_reader_t  *reader;
+	M_list_str_t     *expected;
+	M_list_str_t     *got;
+	M_json_error_t    error;
+	char             *out;
+	char             *expected_str;
+	char             *got_str;
+	size_t            num_matches = 0;
+	size_t            i;
+	size_t            j;
+
+	json = M_json_read(data, M_str_len(data), M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+	ck_assert_msg(json != NULL, "JSON could not be parsed: '%s'", data);
+	results  = M_json_jsonpath(json, search, &num_matches);
+	expected = M_list_str_create(M_LIST_STR_SORTASC);
+	for (i=0; i<num_matches; i++) {
+		for (j=0; j<i && results[j]!=results[i]; j++)
+			;
+		if (j < i)
+			continue;
+		out = M_json_write(results[i], M_JSON_WRITER_NONE, NULL);
+		M_list_str_insert(expected, out);
+		M_free(out);
+	}
+	M_free(results);
+	M_json_node_destroy(json);
+
+	got    = M_list_str_create(M_LIST_STR_SORTASC);
+	reader = M_json_reader_create(NULL, M_JSON_READER_NONE, got);
+	ck_assert_msg(M_json_reader_add_jsonpath(reader, search, check_json_stream_match_str), "Could not add '%s'", search);
+	error  = check_json_stream_feed(reader, data, split);
+	ck_assert_msg(error == M_JSON_ERROR_SUCCESS, "JSON (split %zu) '%s' could not be stream parsed: %d", split, data, error);
+	M_json_reader_destroy(reader);
+
+	expected_str = M_list_str_join(expected, '\n');
+	got_str      = M_list_str_join(got, '\n');
+	ck_assert_msg(M_str_eq(got_str, expected_str), "Stream matches for '%s' on '%s' (split %zu) differ from M_json_jsonpath:\ngot='%s'\nexpected='%s'", search, data, split, got_str, expected_str);
+	M_free(expected_str);
+	M_free(got_str);
+	M_list_str_destroy(expected);
+	M_list_str_destroy(got);
+}
+
+START_TEST(check_json_stream_valid)
+{
+	M_json_node_t       *json;
+	M_json_reader_t     *reader;
+	check_json_stream_t  s;
+	M_json_error_t       error;
+	char                *expected;
+	char                *out;
+	size_t               len;
+	size_t               split;
+	size_t               i;
+
+	for (i=0; check_json_valid_data[i].data!=NULL; i++) {
+		json     = M_json_read(check_json_valid_data[i].data, M_str_len(check_json_valid_data[i].data), M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+		expected = M_json_write(json, M_JSON_WRITER_NONE, NULL);
+		M_json_node_destroy(json);
+		len      = M_str_len(check_json_valid_data[i].data);
+
+		for (split=0; split<len; split++) {
+			M_mem_set(&s, 0, sizeof(s));
+
+			/* Callbacks. */
+			reader = M_json_reader_create(&check_json_stream_cbs, M_JSON_READER_NONE, &s);
+			error  = check_json_stream_feed(reader, check_json_valid_data[i].data, split);
+			ck_assert_msg(error == M_JSON_ERROR_SUCCESS, "JSON (%zu, split %zu) '%s' could not be stream parsed: %d", i, split, check_json_valid_data[i].data, error);
+			M_json_reader_destroy(reader);
+
+			out = M_json_write(s.root, M_JSON_WRITER_NONE, NULL);
+			ck_assert_msg(M_str_eq(out, expected), "Stream output not as expected (%zu, split %zu):\ngot='%s'\nexpected='%s'", i, split, out, expected);
+			M_free(out);
+			M_json_node_destroy(s.root);
+			M_free(s.key);
+
+			/* Subtrees are materialized the same no matter where the data is split. */
+			check_json_stream_jsonpath_compare(check_json_valid_data[i].data, "$..*", split);
+			check_json_stream_jsonpath_compare(check_json_valid_data[i].data, "$..[*]", split);
+		}
+
+		M_free(expected);
+	}
+}
+END_TEST
+
+START_TEST(check_json_stream_invalid)
+{
+	M_json_reader_t     *reader;
+	check_json_stream_t  s;
+	M_json_error_t       error;
+	size_t               len;
+	size_t               split;
+	size_t               i;
+
+	for (i=0; check_json_invalid_data[i].data!=NULL; i++) {
+		len = M_str_len(check_json_invalid_data[i].data);
+		for (split=0; split<=len; split++) {
+			M_mem_set(&s, 0, sizeof(s));
+			reader = M_json_reader_create(&check_json_stream_cbs, M_JSON_READER_NONE, &s);
+			error  = check_json_stream_feed(reader, check_json_invalid_data[i].data, split);
+			ck_assert_msg(error != M_JSON_ERROR_SUCCESS, "Invalid JSON was stream parsed (%zu, split %zu): %s", i, split, check_json_invalid_data[i].data);
+			/* Errors are sticky. */
+			ck_assert_msg(M_json_reader_read(reader, "[]", 2) == error, "Error was not kept (%zu)", i);
+			M_json_reader_destroy(reader);
+			M_json_node_destroy(s.root);
+			M_free(s.key);
+		}
+	}
+
+	/* Flags are shared with M_json_read. */
+	for (i=0; check_json_reader_flags_data[i].data!=NULL; i++) {
+		char *out;
+
+		M_mem_set(&s, 0, sizeof(s));
+		reader = M_json_reader_create(&check_json_stream_cbs, check_json_reader_flags_data[i].reader_flags, &s);
+		error  = check_json_stream_feed(reader, check_json_reader_flags_data[i].data, 0);
+		if (check_json_reader_flags_data[i].will_error) {
+			ck_assert_msg(error != M_JSON_ERROR_SUCCESS, "Invalid JSON was stream parsed (%zu): %s", i, check_json_reader_flags_data[i].data);
+		} else {
+			ck_assert_msg(error == M_JSON_ERROR_SUCCESS, "JSON (%zu) '%s' could not be stream parsed: %d", i, check_json_reader_flags_data[i].data, error);
+			out = M_json_write(s.root, M_JSON_WRITER_NUMBER_NOCOMPAT, NULL);
+			ck_assert_msg(M_str_eq(out, check_json_reader_flags_data[i].out), "Stream output not as expected (%zu):\ngot='%s'\nexpected='%s'", i, out, check_json_reader_flags_data[i].out);
+			M_free(out);
+		}
+		M_json_reader_destroy(reader);
+		M_json_node_destroy(s.root);
+		M_free(s.key);
+	}
+
+	M_mem_set(&s, 0, sizeof(s));
+	reader = M_json_reader_create(&check_json_stream_cbs, M_JSON_READER_OBJECT_UNIQUE_KEYS, &s);
+	error  = check_json_stream_feed(reader, JSON_OBJECT_UNIQUE_KEYS, 0);
+	ck_assert_msg(error == M_JSON_ERROR_DUPLICATE_KEY, "Duplicate key was stream parsed: %d", error);
+	M_json_reader_destroy(reader);
+	M_json_node_destroy(s.root);
+	M_free(s.key);
+}
+END_TEST
+
+typedef struct {
+	size_t        num_matches;
+	M_json_type_t type;
+} check_json_stream_match_t;
+
+static M_json_error_t check_json_stream_match(const char *search, M_json_node_t *node, void *thunk)
+{
+	check_json_stream_match_t *m = thunk;
+
+	if (m->type != M_JSON_TYPE_UNKNOWN)
+		ck_assert_msg(M_json_node_type(node) == m->type, "Unexpected type for '%s': got %d, expected %d", search, M_json_node_type(node), m->type);
+	m->num_matches++;
+	M_json_node_destroy(node);
+	return M_JSON_ERROR_SUCCESS;
+}
+
+#define JSONPATH_NESTED_ARRAYS "[[1,[2,3]],{\"a\":[4,{\"b\":5}]},6,[[7]]]"
+#define JSONPATH_NESTED_OBJECTS "{\"a\":{\"a\":{\"a\":1}},\"b\":[{\"a\":2},[{\"a\":3}]],\"c\":[]}"
+
+static struct {
+	const char *data;
+	const char *search;
+} check_json_stream_jsonpath_data[] = {
+	{ JSONPATH_NESTED_ARRAYS,  "$.*"       },
+	{ JSONPATH_NESTED_ARRAYS,  "$[*]"      },
+	{ JSONPATH_NESTED_ARRAYS,  "$..[0]"    },
+	{ JSONPATH_NESTED_ARRAYS,  "$..*..*"   },
+	{ JSONPATH_NESTED_ARRAYS,  "$..[*]"    },
+	{ JSONPATH_NESTED_ARRAYS,  "$[0][1]"   },
+	{ JSONPATH_NESTED_ARRAYS,  "$[1:3]"    },
+	{ JSONPATH_NESTED_ARRAYS,  "$[0:4:3]"  },
+	{ JSONPATH_NESTED_ARRAYS,  "$..[1:]"   },
+	{ JSONPATH_NESTED_ARRAYS,  "$[*].a"    },
+	{ JSONPATH_NESTED_ARRAYS,  "$..a[1].b" },
+	{ JSONPATH_NESTED_OBJECTS, "$.*"       },
+	{ JSONPATH_NESTED_OBJECTS, "$..a"      },
+	{ JSONPATH_NESTED_OBJECTS, "$..a..a"   },
+	{ JSONPATH_NESTED_OBJECTS, "$..*..*"   },
+	{ JSONPATH_NESTED_OBJECTS, "$..[0]"    },
+	{ JSONPATH_NESTED_OBJECTS, "$.b[*].a"  },
+	{ JSONPATH_NESTED_OBJECTS, "$..b..a"   },
+	{ JSONPATH_NESTED_OBJECTS, "$.A.a"     },
+	{ JSONPATH_NESTED_OBJECTS, "$[0]"      },
+	{ NULL,                    NULL        }
+};
+
+START_TEST(check_json_stream_jsonpath)
+{
+	M_json_reader_t           *reader;
+	check_json_stream_match_t  m;
+	M_json_error_t             error;
+	size_t                     i;
+
+	for (i=0; check_json_jsonpath_book_data[i].search!=NULL; i++) {
+		M_mem_set(&m, 0, sizeof(m));
+		m.type = check_json_jsonpath_book_data[i].type;
+
+		reader = M_json_reader_create(NULL, M_JSON_READER_NONE, &m);
+		ck_assert_msg(M_json_reader_add_jsonpath(reader, check_json_jsonpath_book_data[i].search, check_json_stream_match), "Could not add (%zu): '%s'", i, check_json_jsonpath_book_data[i].search);
+		error = check_json_stream_feed(reader, JSONPATH_BOOKS, 0);
+		ck_assert_msg(error == M_JSON_ERROR_SUCCESS, "JSONPath books string could not be stream parsed: %d", error);
+		ck_assert_msg(m.num_matches == check_json_jsonpath_book_data[i].num_matches, "Unexpected matches found (%zu): '%s'. Got %zu, expected %zu matches", i, check_json_jsonpath_book_data[i].search, m.num_matches, check_json_jsonpath_book_data[i].num_matches);
+		M_json_reader_destroy(reader);
+	}
+
+	for (i=0; check_json_jsonpath_book_data[i].search!=NULL; i++) {
+		check_json_stream_jsonpath_compare(JSONPATH_BOOKS, check_json_jsonpath_book_data[i].search, 0);
+	}
+	for (i=0; check_json_stream_jsonpath_data[i].search!=NULL; i++) {
+		check_json_stream_jsonpath_compare(check_json_stream_jsonpath_data[i].data, check_json_stream_jsonpath_data[i].search, 0);
+	}
+
+	/* Offsets from the end of an array can't be known until the array has been read. */
+	reader = M_json_reader_create(NULL, M_JSON_READER_NONE, NULL);
+	ck_assert_msg(!M_json_reader_add_jsonpath(reader, "$.store.book[-1]", check_json_stream_match), "Negative offset was accepted");
+	ck_assert_msg(!M_json_reader_add_jsonpath(reader, "$.store.book[2:0:-1]", check_json_stream_match), "Negative step was accepted");
+	ck_assert_msg(!M_json_reader_add_jsonpath(reader, "store.book", check_json_stream_match), "Missing '$' was accepted");
+	ck_assert_msg(!M_json_reader_add_jsonpath(reader, "$.store..", check_json_stream_match), "Trailing '..' was accepted");
+	/* M_json_jsonpath never matches the root. */
+	ck_assert_msg(!M_json_reader_add_jsonpath(reader, "$", check_json_stream_match), "'$' was accepted");
+	M_json_reader_destroy(reader);
+}
+END_TEST
+
+/* Walk a tree and generate the same document using the stream writer. */
+static M_bool check_json_stream_write_node(M_json_writer_t *writer, const M_json_node_t *node)
+{
+	M_list_str_t *keys;
+	size_t        len;
+	size_t        i;
+	M_bool        ret = M_TRUE;
+
+	switch (M_json_node_type(node)) {
+		case M_JSON_TYPE_OBJECT:
+			if (!M_json_writer_object_begin(writer))
+				return M_FALSE;
+			keys = M_json_object_keys(node);
+			len  = M_list_str_len(keys);
+			for (i=0; i<len && ret; i++) {
+				ret = M_json_writer_key(writer, M_list_str_at(keys, i)) &&
+					check_json_stream_write_node(writer, M_json_object_value(node, M_list_str_at(keys, i)));
+			}
+			M_list_str_destroy(keys);
+			return ret && M_json_writer_object_end(writer);
+		case M_JSON_TYPE_ARRAY:
+			if (!M_json_writer_array_begin(writer))
+				return M_FALSE;
+			len = M_json_array_len(node);
+			for (i=0; i<len && ret; i++) {
+				ret = check_json_stream_write_node(writer, M_json_array_at(node, i));
+			}
+			return ret && M_json_writer_array_end(writer);
+		case M_JSON_TYPE_STRING:
+			return M_json_writer_string(writer, M_json_get_string(node));
+		case M_JSON_TYPE_INTEGER:
+			return M_json_writer_integer(writer, M_json_get_int(node));
+		case M_JSON_TYPE_DECIMAL:
+			return M_json_writer_decimal(writer, M_json_get_decimal(node));
+		case M_JSON_TYPE_BOOL:
+			return M_json_writer_bool(writer, M_json_get_bool(node));
+		case M_JSON_TYPE_NULL:
+			return M_json_writer_null(writer);
+		case M_JSON_TYPE_UNKNOWN:
+			break;
+	}
+	return M_FALSE;
+}
+
+static M_bool check_json_stream_flush(M_buf_t *buf, void *thunk)
+{
+	M_buf_add_bytes(thunk, M_buf_peek(buf), M_buf_len(buf));
+	M_buf_truncate(buf, 0);
+	return M_TRUE;
+}
+
+START_TEST(check_json_stream_writer)
+{
+	M_json_node_t   *json;
+	M_json_writer_t *writer;
+	M_buf_t         *buf;
+	char            *expected;
+	char            *out;
+	size_t           i;
+
+	for (i=0; check_json_valid_data[i].data!=NULL; i++) {
+		json     = M_json_read(check_json_valid_data[i].data, M_str_len(check_json_valid_data[i].data), M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+		expected = M_json_write(json, check_json_valid_data[i].writer_flags, NULL);
+
+		/* Caller's buffer. */
+		buf    = M_buf_create();
+		writer = M_json_writer_create(buf, check_json_valid_data[i].writer_flags);
+		ck_assert_msg(check_json_stream_write_node(writer, json), "Could not write (%zu)", i);
+		ck_assert_msg(M_json_writer_finish(writer), "Could not finish (%zu)", i);
+		M_json_writer_destroy(writer);
+		out = M_buf_finish_str(buf, NULL);
+		ck_assert_msg(M_str_eq(out, expected), "Stream output not as expected (%zu):\ngot='%s'\nexpected='%s'", i, out, expected);
+		M_free(out);
+
+		/* Flushed a few bytes at a time. */
+		buf    = M_buf_create();
+		writer = M_json_writer_create_flush(check_json_stream_flush, 3, check_json_valid_data[i].writer_flags, buf);
+		ck_assert_msg(check_json_stream_write_node(writer, json), "Could not write (%zu)", i);
+		ck_assert_msg(M_json_writer_finish(writer), "Could not finish (%zu)", i);
+		M_json_writer_destroy(writer);
+		out = M_buf_finish_str(buf, NULL);
+		ck_assert_msg(M_str_eq(out, expected), "Flushed output not as expected (%zu):\ngot='%s'\nexpected='%s'", i, out, expected);
+		M_free(out);
+
+		/* Whole node. */
+		buf    = M_buf_create();
+		writer = M_json_writer_create(buf, check_json_valid_data[i].writer_flags);
+		ck_assert_msg(M_json_writer_node(writer, json), "Could not write node (%zu)", i);
+		ck_assert_msg(M_json_writer_finish(writer), "Could not finish (%zu)", i);
+		M_json_writer_destroy(writer);
+		out = M_buf_finish_str(buf, NULL);
+		ck_assert_msg(M_str_eq(out, expected), "Node output not as expected (%zu):\ngot='%s'\nexpected='%s'", i, out, expected);
+		M_free(out);
+
+		M_free(expected);
+		M_json_node_destroy(json);
+	}
+
+	/* Misuse. */
+	buf    = M_buf_create();
+	writer = M_json_writer_create(buf, M_JSON_WRITER_NONE);
+	ck_assert_msg(!M_json_writer_key(writer, "a"), "Key written outside of object");
+	ck_assert_msg(!M_json_writer_array_end(writer), "Array closed before opened");
+	ck_assert_msg(M_json_writer_object_begin(writer), "Could not start object");
+	ck_assert_msg(!M_json_writer_integer(writer, 1), "Value written without key");
+	ck_assert_msg(!M_json_writer_finish(writer), "Incomplete document finished");
+	ck_assert_msg(M_json_writer_key(writer, "a\"/b"), "Could not write key");
+	ck_assert_msg(!M_json_writer_key(writer, "c"), "Key written after key");
+	ck_assert_msg(!M_json_writer_object_end(writer), "Object closed with key missing value");
+	ck_assert_msg(M_json_writer_string(writer, "x\ty"), "Could not write value");
+	ck_assert_msg(!M_json_writer_array_end(writer), "Array end closed object");
+	ck_assert_msg(M_json_writer_object_end(writer), "Could not end object");
+	ck_assert_msg(!M_json_writer_null(writer), "Value written after root");
+	ck_assert_msg(M_json_writer_finish(writer), "Could not finish");
+	M_json_writer_destroy(writer);
+	out = M_buf_finish_str(buf, NULL);
+	ck_assert_msg(M_str_eq(out, "{\"a\\\"\\/b\":\"x\\ty\"}"), "Misuse output not as expected: '%s'", out);
+	M_free(out);
+}
+END_TEST
+
+START_TEST(check_json_compact)
+{
+	M_json_node_t  *json;
+	M_json_node_t  *compact;
+	M_json_node_t  *node;
+	M_json_node_t  *taken;
+	M_json_node_t **matches;
+	M_list_str_t   *keys;
+	M_buf_t        *buf;
+	char           *expected;
+	char           *out;
+	size_t          num_matches;
+	size_t          i;
+
+	for (i=0; check_json_valid_data[i].data!=NULL; i++) {
+		json    = M_json_read(check_json_valid_data[i].data, M_str_len(check_json_valid_data[i].data), M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+		compact = M_json_read(check_json_valid_data[i].data, M_str_len(check_json_valid_data[i].data), M_JSON_READER_COMPACT, NULL, NULL, NULL, NULL);
+		ck_assert_msg(compact != NULL, "JSON (%zu) '%s' could not be parsed compact", i, check_json_valid_data[i].data);
+
+		expected = M_json_write(json, check_json_valid_data[i].writer_flags|M_JSON_WRITER_PRETTYPRINT_SPACE, NULL);
+		out      = M_json_write(compact, check_json_valid_data[i].writer_flags|M_JSON_WRITER_PRETTYPRINT_SPACE, NULL);
+		ck_assert_msg(M_str_eq(out, expected), "Compact output not as expected (%zu):\ngot='%s'\nexpected='%s'", i, out, expected);
+		M_free(out);
+		M_free(expected);
+
+		M_json_node_destroy(compact);
+		M_json_node_destroy(json);
+	}
+
+	/* Large enough for the object to be indexed, with a repeated key that keeps its place. */
+	buf = M_buf_create();
+	M_buf_add_str(buf, "{");
+	for (i=0; i<20; i++)
+		M_bprintf(buf, "\"k%zu\":%zu,", i, i);
+	M_buf_add_str(buf, "\"k3\":\"three\",\"list\":[1,\"two\",{\"x\":true}]}");
+	out  = M_buf_finish_str(buf, NULL);
+	json = M_json_read(out, M_str_len(out), M_JSON_READER_COMPACT, NULL, NULL, NULL, NULL);
+	M_free(out);
+	ck_assert_msg(json != NULL, "Could not parse compact object");
+
+	ck_assert_msg(M_json_object_num_children(json) == 21, "Wrong number of children: %zu", M_json_object_num_children(json));
+	ck_assert_msg(M_json_object_value_int(json, "k19") == 19, "Wrong k19");
+	ck_assert_msg(M_str_eq(M_json_object_value_string(json, "k3"), "three"), "Repeated key not replaced");
+	ck_assert_msg(M_json_object_value(json, "K1") == NULL, "Keys matched case insensitive");
+	keys = M_json_object_keys(json);
+	ck_assert_msg(M_str_eq(M_list_str_at(keys, 3), "k3") && M_str_eq(M_list_str_at(keys, 20), "list"), "Keys out of order");
+	M_list_str_destroy(keys);
+
+	matches = M_json_jsonpath(json, "$.list[2].x", &num_matches);
+	ck_assert_msg(num_matches == 1 && M_json_get_bool(matches[0]), "JSONPath did not match");
+	M_free(matches);
+
+	/* Modifying. */
+	ck_assert_msg(M_json_object_insert_string(json, "k0", "zero"), "Could not replace key");
+	ck_assert_msg(M_json_object_insert_int(json, "new", 5), "Could not insert key");
+	ck_assert_msg(!M_json_object_insert_int(json, "", 5), "Inserted empty key");
+	ck_assert_msg(M_str_eq(M_json_object_value_string(json, "k0"), "zero"), "Inserted key not found");
+	ck_assert_msg(M_json_object_value_int(json, "new") == 5, "New key not found");
+	ck_assert_msg(M_json_set_string(M_json_object_value(json, "k3"), "tres"), "Could not set string");
+	M_json_node_destroy(M_json_object_value(json, "k1"));
+	ck_assert_msg(M_json_object_value(json, "k1") == NULL, "Destroyed node still present");
+
+	node = M_json_object_value(json, "list");
+	ck_assert_msg(M_json_array_len(node) == 3, "Wrong array length");
+	ck_assert_msg(M_json_array_insert_at_string(node, "first", 0), "Could not insert into array");
+	ck_assert_msg(M_json_array_insert_int(node, 4), "Could not append to array");
+	ck_assert_msg(M_str_eq(M_json_array_at_string(node, 0), "first") && M_str_eq(M_json_array_at_string(node, 2), "two") && M_json_array_at_int(node, 4) == 4, "Array modified incorrectly");
+
+	/* Nodes taken out of the tree outlive it. */
+	taken = M_json_array_at(node, 3);
+	M_json_take_from_parent(taken);
+	ck_assert_msg(M_json_array_len(node) == 4, "Taken node still in array");
+	M_json_take_from_parent(node);
+	ck_assert_msg(M_json_object_value(json, "list") == NULL, "Taken node still in object");
+
+	out = M_json_write(json, M_JSON_WRITER_NONE, NULL);
+	ck_assert_msg(M_str_eq(out, "{\"k0\":\"zero\",\"k2\":2,\"k3\":\"tres\",\"k4\":4,\"k5\":5,\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9,\"k10\":10,\"k11\":11,\"k12\":12,\"k13\":13,\"k14\":14,\"k15\":15,\"k16\":16,\"k17\":17,\"k18\":18,\"k19\":19,\"new\":5}"), "Modified output not as expected: '%s'", out);
+	M_free(out);
+	M_json_node_destroy(json);
+
+	ck_assert_msg(M_json_object_insert(taken, "y", node), "Could not move node between taken nodes");
+	out = M_json_write(taken, M_JSON_WRITER_NONE, NULL);
+	ck_assert_msg(M_str_eq(out, "{\"x\":true,\"y\":[\"first\",1,\"two\",4]}"), "Taken output not as expected: '%s'", out);
+	M_free(out);
+	M_json_node_destroy(taken);
+}
+END_TEST
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 Suite *M_json_suite(void)
@@ -874,12 +1527,18 @@ Suite *M_json_suite(void)
 	TCase *tc_json_jsonpath_book;
 	TCase *tc_json_jsonpath_str;
 	TCase *tc_json_jsonpath_array;
+	TCase *tc_json_jsonpath_compiled;
 	TCase *tc_json_values;
 	TCase *tc_json_parent_object;
 	TCase *tc_json_parent_array;
 	TCase *tc_json_object_unique_keys;
 	TCase *tc_json_object_get_string;
 	TCase *tc_json_large_number;
+	TCase *tc_json_stream_valid;
+	TCase *tc_json_stream_invalid;
+	TCase *tc_json_stream_jsonpath;
+	TCase *tc_json_stream_writer;
+	TCase *tc_json_compact;
 
 	suite = suite_create("json");
 
@@ -913,6 +1572,11 @@ Suite *M_json_suite(void)
 	tcase_set_timeout(tc_json_jsonpath_array, 300);
 	suite_add_tcase(suite, tc_json_jsonpath_array);
 
+	tc_json_jsonpath_compiled = tcase_create("check_json_jsonpath_compiled");
+	tcase_add_test(tc_json_jsonpath_compiled, check_json_jsonpath_compiled);
+	tcase_set_timeout(tc_json_jsonpath_compiled, 300);
+	suite_add_tcase(suite, tc_json_jsonpath_compiled);
+
 	tc_json_values = tcase_create("check_json_values");
 	tcase_add_test(tc_json_values, check_json_values);
 	tcase_set_timeout(tc_json_values, 300);
@@ -943,6 +1607,31 @@ Suite *M_json_suite(void)
 	tcase_set_timeout(tc_json_large_number, 300);
 	suite_add_tcase(suite, tc_json_large_number);
 
+	tc_json_stream_valid = tcase_create("check_json_stream_valid");
+	tcase_add_test(tc_json_stream_valid, check_json_stream_valid);
+	tcase_set_timeout(tc_json_stream_valid, 300);
+	suite_add_tcase(suite, tc_json_stream_valid);
+
+	tc_json_stream_invalid = tcase_create("check_json_stream_invalid");
+	tcase_add_test(tc_json_stream_invalid, check_json_stream_invalid);
+	tcase_set_timeout(tc_json_stream_invalid, 300);
+	suite_add_tcase(suite, tc_json_stream_invalid);
+
+	tc_json_stream_jsonpath = tcase_create("check_json_stream_jsonpath");
+	tcase_add_test(tc_json_stream_jsonpath, check_json_stream_jsonpath);
+	tcase_set_timeout(tc_json_stream_jsonpath, 300);
+	suite_add_tcase(suite, tc_json_stream_jsonpath);
+
+	tc_json_stream_writer = tcase_create("check_json_stream_writer");
+	tcase_add_test(tc_json_stream_writer, check_json_stream_writer);
+	tcase_set_timeout(tc_json_stream_writer, 300);
+	suite_add_tcase(suite, tc_json_stream_writer);
+
+	tc_json_compact = tcase_create("check_json_compact");
+	tcase_add_test(tc_json_compact, check_json_compact);
+	tcase_set_timeout(tc_json_compact, 300);
+	suite_add_tcase(suite, tc_json_compact);
+
 	return suite;
 }
 
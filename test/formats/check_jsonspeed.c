@@ -0,0 +1,180 @@
+#include "m_config.h"
+#include <stdlib.h>
+#include <check.h>
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_formats.h>
+
+/* Measures M_json_read throughput on a few representative documents. Each
+ * document is also read with a leading comment, which the fast path doesn't
+ * handle, to compare against the recursive reader and make sure both produce
+ * the same tree. The compact representation is measured as well. */
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#define TARGET_BYTES (16 * 1024 * 1024)
+
+/* Many small objects, the typical API message shape. */
+static char *gen_small_objects(void)
+{
+	M_buf_t *buf = M_buf_create();
+	size_t   i;
+
+	M_buf_add_str(buf, "[\n");
+	for (i=0; i<20000; i++) {
+		M_buf_add_str(buf, i == 0 ? "  " : ",\n  ");
+		M_bprintf(buf, "{ \"id\": %zu, \"name\": \"user%zu\", \"active\": %s, \"score\": %zu.%02zu, \"tags\": [\"a\", \"b\"], \"parent\": null }",
+			i, i, (i & 1) ? "true" : "false", i % 1000, i % 100);
+	}
+	M_buf_add_str(buf, "\n]\n");
+	return M_buf_finish_str(buf, NULL);
+}
+
+/* One large flat array of numbers. */
+static char *gen_large_array(void)
+{
+	M_buf_t *buf = M_buf_create();
+	size_t   i;
+
+	M_buf_add_byte(buf, '[');
+	for (i=0; i<200000; i++) {
+		if (i != 0)
+			M_buf_add_byte(buf, ',');
+		M_bprintf(buf, "%lld", (long long)((i * 7919) % 1000003) - 500000);
+	}
+	M_buf_add_byte(buf, ']');
+	return M_buf_finish_str(buf, NULL);
+}
+
+/* Long strings, some with escapes. */
+static char *gen_string_heavy(void)
+{
+	M_buf_t *buf = M_buf_create();
+	size_t   i;
+	size_t   j;
+
+	M_buf_add_str(buf, "{\"docs\":[");
+	for (i=0; i<5000; i++) {
+		if (i != 0)
+			M_buf_add_byte(buf, ',');
+		M_bprintf(buf, "{\"title\":\"Document %zu\",\"body\":\"", i);
+		for (j=0; j<8; j++)
+			M_buf_add_str(buf, "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor. ");
+		if (i % 4 == 0)
+			M_buf_add_str(buf, "Escaped \\\"quote\\\", tab\\t, path C:\\\\dir\\\\file and \\u00e9.");
+		M_buf_add_str(buf, "\"}");
+	}
+	M_buf_add_str(buf, "]}");
+	return M_buf_finish_str(buf, NULL);
+}
+
+static double check_jsonspeed_run(const char *name, const char *data, size_t len, M_uint32 flags)
+{
+	M_timeval_t    start;
+	M_json_node_t *node;
+	M_uint64       ms;
+	size_t         iters = TARGET_BYTES / len + 1;
+	size_t         i;
+
+	M_time_elapsed_start(&start);
+	for (i=0; i<iters; i++) {
+		node = M_json_read(data, len, flags, NULL, NULL, NULL, NULL);
+		ck_assert_msg(node != NULL, "%s: failed to parse", name);
+		M_json_node_destroy(node);
+	}
+	ms = M_time_elapsed(&start);
+	if (ms == 0)
+		ms = 1;
+
+	return ((double)(len * iters) / (1024 * 1024)) / ((double)ms / 1000);
+}
+
+static void check_jsonspeed_doc(const char *name, char *doc)
+{
+	M_json_node_t *node;
+	M_json_node_t *legacy_node;
+	M_json_node_t *compact_node;
+	char          *legacy_doc;
+	char          *out;
+	char          *legacy_out;
+	char          *compact_out;
+	size_t         len;
+	double         fast_mbs;
+	double         legacy_mbs;
+	double         compact_mbs;
+
+	len        = M_str_len(doc);
+	legacy_doc = M_malloc(len + 5);
+	M_mem_copy(legacy_doc, "/**/", 4);
+	M_mem_copy(legacy_doc + 4, doc, len + 1);
+
+	node        = M_json_read(doc, len, M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+	legacy_node  = M_json_read(legacy_doc, len + 4, M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+	compact_node = M_json_read(doc, len, M_JSON_READER_COMPACT, NULL, NULL, NULL, NULL);
+	ck_assert_msg(node != NULL && legacy_node != NULL && compact_node != NULL, "%s: failed to parse", name);
+	out         = M_json_write(node, M_JSON_WRITER_NONE, NULL);
+	legacy_out  = M_json_write(legacy_node, M_JSON_WRITER_NONE, NULL);
+	compact_out = M_json_write(compact_node, M_JSON_WRITER_NONE, NULL);
+	ck_assert_msg(M_str_eq(out, legacy_out), "%s: readers produced different output", name);
+	ck_assert_msg(M_str_eq(out, compact_out), "%s: compact tree produced different output", name);
+	M_free(out);
+	M_free(legacy_out);
+	M_free(compact_out);
+	M_json_node_destroy(node);
+	M_json_node_destroy(legacy_node);
+	M_json_node_destroy(compact_node);
+
+	fast_mbs    = check_jsonspeed_run(name, doc, len, M_JSON_READER_NONE);
+	legacy_mbs  = check_jsonspeed_run(name, legacy_doc, len + 4, M_JSON_READER_NONE);
+	compact_mbs = check_jsonspeed_run(name, doc, len, M_JSON_READER_COMPACT);
+
+	M_printf("%-14s %8zu bytes: %8.1f MB/s (recursive reader %8.1f MB/s, compact %8.1f MB/s)\n", name, len, fast_mbs, legacy_mbs, compact_mbs);
+
+	M_free(legacy_doc);
+	M_free(doc);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+START_TEST(check_jsonspeed)
+{
+	check_jsonspeed_doc("small objects", gen_small_objects());
+	check_jsonspeed_doc("large array", gen_large_array());
+	check_jsonspeed_doc("string heavy", gen_string_heavy());
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static Suite *jsonspeed_suite(void)
+{
+	Suite *suite;
+	TCase *tc;
+
+	suite = suite_create("jsonspeed");
+
+	tc = tcase_create("jsonspeed");
+	tcase_add_test(tc, check_jsonspeed);
+	tcase_set_timeout(tc, 300);
+	suite_add_tcase(suite, tc);
+
+	return suite;
+}
+
+int main(int argc, char **argv)
+{
+	SRunner *sr;
+	int      nf;
+
+	(void)argc;
+	(void)argv;
+
+	sr = srunner_create(jsonspeed_suite());
+	if (getenv("CK_LOG_FILE_NAME")==NULL) srunner_set_log(sr, "check_jsonspeed.log");
+
+	srunner_run_all(sr, CK_NORMAL);
+	nf = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return nf == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
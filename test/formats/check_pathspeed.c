@@ -0,0 +1,354 @@
+#include "m_config.h"
+#include <stdlib.h>
+#include <check.h>
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_formats.h>
+
+/* Measures the per document cost of evaluating a fixed set of JSONPath and
+ * XPath expressions, the way message routing does. Each document is searched
+ * with the string based functions, with compiled expressions, and with
+ * compiled expressions stopping at the first match. */
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#define NUM_DOCS   2000
+#define NUM_ITEMS  10
+
+static const char *check_pathspeed_fields[] = {
+	"type", "version", "merchant", "terminal", "currency", "amount", "account", "expdate", "cardholder", "reference", NULL
+};
+
+static const char *check_pathspeed_item_fields[] = {
+	"sku", "qty", "price", "desc", "tax", NULL
+};
+
+static char *gen_json(size_t n)
+{
+	M_buf_t *buf = M_buf_create();
+	size_t   i;
+
+	M_buf_add_str(buf, "{\"header\":{");
+	for (i=0; check_pathspeed_fields[i]!=NULL; i++) {
+		M_bprintf(buf, "%s\"%s\":\"%s%zu\"", i==0?"":",", check_pathspeed_fields[i], check_pathspeed_fields[i], n+i);
+	}
+	M_buf_add_str(buf, "},\"body\":{\"items\":[");
+	for (i=0; i<NUM_ITEMS; i++) {
+		M_bprintf(buf, "%s{\"sku\":\"S%zu\",\"qty\":%zu,\"price\":%zu.%02zu,\"desc\":\"Item %zu\",\"tax\":%s}",
+			i==0?"":",", n*NUM_ITEMS+i, i+1, (n+i)%100, i, i, (i & 1)?"true":"false");
+	}
+	M_bprintf(buf, "]},\"meta\":{\"source\":\"pos\",\"seq\":%zu,\"trace\":{\"id\":\"t%zu\",\"hops\":[1,2,3]}}}", n, n);
+	return M_buf_finish_str(buf, NULL);
+}
+
+static char *gen_xml(size_t n)
+{
+	M_buf_t *buf = M_buf_create();
+	size_t   i;
+
+	M_buf_add_str(buf, "<msg><header>");
+	for (i=0; check_pathspeed_fields[i]!=NULL; i++) {
+		M_bprintf(buf, "<%s>%s%zu</%s>", check_pathspeed_fields[i], check_pathspeed_fields[i], n+i, check_pathspeed_fields[i]);
+	}
+	M_buf_add_str(buf, "</header><body><items>");
+	for (i=0; i<NUM_ITEMS; i++) {
+		M_bprintf(buf, "<item tax=\"%s\"><sku>S%zu</sku><qty>%zu</qty><price>%zu.%02zu</price><desc>Item %zu</desc></item>",
+			(i & 1)?"yes":"no", n*NUM_ITEMS+i, i+1, (n+i)%100, i, i);
+	}
+	M_bprintf(buf, "</items></body><meta source=\"pos\"><seq>%zu</seq><trace id=\"t%zu\"><hop>1</hop><hop>2</hop><hop>3</hop></trace></meta></msg>", n, n);
+	return M_buf_finish_str(buf, NULL);
+}
+
+/* 50 expressions mixing direct paths, wildcards, recursion and indexing. */
+static M_list_str_t *gen_json_exprs(void)
+{
+	M_list_str_t *exprs = M_list_str_create(M_LIST_STR_NONE);
+	char          expr[128];
+	size_t        i;
+
+	for (i=0; check_pathspeed_fields[i]!=NULL; i++) {
+		M_snprintf(expr, sizeof(expr), "$.header.%s", check_pathspeed_fields[i]);
+		M_list_str_insert(exprs, expr);
+		M_snprintf(expr, sizeof(expr), "$..%s", check_pathspeed_fields[i]);
+		M_list_str_insert(exprs, expr);
+	}
+	for (i=0; i<NUM_ITEMS; i++) {
+		M_snprintf(expr, sizeof(expr), "$.body.items[%zu].sku", i);
+		M_list_str_insert(exprs, expr);
+	}
+	for (i=0; check_pathspeed_item_fields[i]!=NULL; i++) {
+		M_snprintf(expr, sizeof(expr), "$.body.items[*].%s", check_pathspeed_item_fields[i]);
+		M_list_str_insert(exprs, expr);
+	}
+	M_list_str_insert(exprs, "$.body.items[0:5].price");
+	M_list_str_insert(exprs, "$.body.items[::2].qty");
+	M_list_str_insert(exprs, "$.body.items[-1].desc");
+	M_list_str_insert(exprs, "$.body.items[0,3,7].tax");
+	M_list_str_insert(exprs, "$.meta.*");
+	M_list_str_insert(exprs, "$.meta.trace.hops[-1]");
+	M_list_str_insert(exprs, "$..hops[*]");
+	M_list_str_insert(exprs, "$..trace.id");
+	M_list_str_insert(exprs, "$.meta.source");
+	M_list_str_insert(exprs, "$.header.*");
+	M_list_str_insert(exprs, "$.body.items[1:3].*");
+	M_list_str_insert(exprs, "$..items[2].price");
+	M_list_str_insert(exprs, "$.meta.trace.*");
+	M_list_str_insert(exprs, "$.body.items[-2:].sku");
+	M_list_str_insert(exprs, "$.missing.value");
+
+	return exprs;
+}
+
+static M_list_str_t *gen_xml_exprs(void)
+{
+	M_list_str_t *exprs = M_list_str_create(M_LIST_STR_NONE);
+	char          expr[128];
+	size_t        i;
+
+	for (i=0; check_pathspeed_fields[i]!=NULL; i++) {
+		M_snprintf(expr, sizeof(expr), "/msg/header/%s", check_pathspeed_fields[i]);
+		M_list_str_insert(exprs, expr);
+		M_snprintf(expr, sizeof(expr), "//%s/text()", check_pathspeed_fields[i]);
+		M_list_str_insert(exprs, expr);
+	}
+	for (i=0; i<NUM_ITEMS; i++) {
+		M_snprintf(expr, sizeof(expr), "/msg/body/items/item[%zu]/sku", i+1);
+		M_list_str_insert(exprs, expr);
+	}
+	for (i=0; check_pathspeed_item_fields[i]!=NULL; i++) {
+		M_snprintf(expr, sizeof(expr), "/msg/body/items/*/%s", check_pathspeed_item_fields[i]);
+		M_list_str_insert(exprs, expr);
+	}
+	M_list_str_insert(exprs, "//item[position() <= 5]/price");
+	M_list_str_insert(exprs, "//item[@tax='yes']/qty");
+	M_list_str_insert(exprs, "//item[last()]/desc");
+	M_list_str_insert(exprs, "//item[@tax]");
+	M_list_str_insert(exprs, "/msg/meta/*");
+	M_list_str_insert(exprs, "/msg/meta/trace/hop[last()]");
+	M_list_str_insert(exprs, "//hop");
+	M_list_str_insert(exprs, "//trace[@id]");
+	M_list_str_insert(exprs, "/msg/meta[@source=\"pos\"]/seq");
+	M_list_str_insert(exprs, "/msg/header/*");
+	M_list_str_insert(exprs, "//item[2]/*");
+	M_list_str_insert(exprs, "//items/item[position() > 8]/sku");
+	M_list_str_insert(exprs, "/msg/meta/trace/*");
+	M_list_str_insert(exprs, "//item[last()-1]/sku");
+	M_list_str_insert(exprs, "/msg/missing/value");
+
+	return exprs;
+}
+
+static double check_pathspeed_usec(const M_timeval_t *start)
+{
+	M_uint64 ms = M_time_elapsed(start);
+
+	if (ms == 0)
+		ms = 1;
+	return (double)ms * 1000 / NUM_DOCS;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+START_TEST(check_pathspeed_json)
+{
+	M_json_node_t      **docs;
+	M_json_jsonpath_t  **compiled;
+	M_json_node_t      **matches;
+	M_json_node_t      **compiled_matches;
+	M_list_str_t        *exprs;
+	M_timeval_t          start;
+	char                *data;
+	size_t               num_exprs;
+	size_t               num_matches;
+	size_t               num_compiled;
+	size_t               total          = 0;
+	size_t               total_compiled = 0;
+	size_t               i;
+	size_t               j;
+	double               legacy_usec;
+	double               compiled_usec;
+	double               first_usec;
+
+	exprs     = gen_json_exprs();
+	num_exprs = M_list_str_len(exprs);
+	docs      = M_malloc(NUM_DOCS * sizeof(*docs));
+	compiled  = M_malloc(num_exprs * sizeof(*compiled));
+
+	for (i=0; i<NUM_DOCS; i++) {
+		data    = gen_json(i);
+		docs[i] = M_json_read(data, M_str_len(data), M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+		ck_assert_msg(docs[i] != NULL, "document %zu failed to parse", i);
+		M_free(data);
+	}
+	for (j=0; j<num_exprs; j++) {
+		compiled[j] = M_json_jsonpath_compile(M_list_str_at(exprs, j));
+		ck_assert_msg(compiled[j] != NULL, "'%s' failed to compile", M_list_str_at(exprs, j));
+
+		/* Both need to find the same thing. */
+		matches          = M_json_jsonpath(docs[0], M_list_str_at(exprs, j), &num_matches);
+		compiled_matches = M_json_jsonpath_eval(compiled[j], docs[0], &num_compiled);
+		ck_assert_msg(num_matches == num_compiled, "'%s': got %zu compiled matches, expected %zu", M_list_str_at(exprs, j), num_compiled, num_matches);
+		M_free(matches);
+		M_free(compiled_matches);
+	}
+
+	M_time_elapsed_start(&start);
+	for (i=0; i<NUM_DOCS; i++) {
+		for (j=0; j<num_exprs; j++) {
+			matches  = M_json_jsonpath(docs[i], M_list_str_at(exprs, j), &num_matches);
+			total   += num_matches;
+			M_free(matches);
+		}
+	}
+	legacy_usec = check_pathspeed_usec(&start);
+
+	M_time_elapsed_start(&start);
+	for (i=0; i<NUM_DOCS; i++) {
+		for (j=0; j<num_exprs; j++) {
+			matches         = M_json_jsonpath_eval(compiled[j], docs[i], &num_matches);
+			total_compiled += num_matches;
+			M_free(matches);
+		}
+	}
+	compiled_usec = check_pathspeed_usec(&start);
+	ck_assert_msg(total == total_compiled, "compiled matched %zu, expected %zu", total_compiled, total);
+
+	M_time_elapsed_start(&start);
+	for (i=0; i<NUM_DOCS; i++) {
+		for (j=0; j<num_exprs; j++) {
+			M_json_jsonpath_first(compiled[j], docs[i]);
+		}
+	}
+	first_usec = check_pathspeed_usec(&start);
+
+	M_printf("jsonpath %2zu expressions: %8.1f us/doc (compiled %8.1f us/doc, first match %8.1f us/doc)\n", num_exprs, legacy_usec, compiled_usec, first_usec);
+
+	for (i=0; i<NUM_DOCS; i++)
+		M_json_node_destroy(docs[i]);
+	for (j=0; j<num_exprs; j++)
+		M_json_jsonpath_destroy(compiled[j]);
+	M_free(docs);
+	M_free(compiled);
+	M_list_str_destroy(exprs);
+}
+END_TEST
+
+START_TEST(check_pathspeed_xml)
+{
+	M_xml_node_t  **docs;
+	M_xml_xpath_t **compiled;
+	M_xml_node_t  **matches;
+	M_xml_node_t  **compiled_matches;
+	M_list_str_t   *exprs;
+	M_timeval_t     start;
+	char           *data;
+	size_t          num_exprs;
+	size_t          num_matches;
+	size_t          num_compiled;
+	size_t          total          = 0;
+	size_t          total_compiled = 0;
+	size_t          i;
+	size_t          j;
+	double          legacy_usec;
+	double          compiled_usec;
+	double          first_usec;
+
+	exprs     = gen_xml_exprs();
+	num_exprs = M_list_str_len(exprs);
+	docs      = M_malloc(NUM_DOCS * sizeof(*docs));
+	compiled  = M_malloc(num_exprs * sizeof(*compiled));
+
+	for (i=0; i<NUM_DOCS; i++) {
+		data    = gen_xml(i);
+		docs[i] = M_xml_read(data, M_str_len(data), M_XML_READER_NONE, NULL, NULL, NULL, NULL);
+		ck_assert_msg(docs[i] != NULL, "document %zu failed to parse", i);
+		M_free(data);
+	}
+	for (j=0; j<num_exprs; j++) {
+		compiled[j] = M_xml_xpath_compile(M_list_str_at(exprs, j), M_XML_READER_NONE);
+		ck_assert_msg(compiled[j] != NULL, "'%s' failed to compile", M_list_str_at(exprs, j));
+
+		/* Both need to find the same thing. */
+		matches          = M_xml_xpath(docs[0], M_list_str_at(exprs, j), M_XML_READER_NONE, &num_matches);
+		compiled_matches = M_xml_xpath_eval(compiled[j], docs[0], &num_compiled);
+		ck_assert_msg(num_matches == num_compiled, "'%s': got %zu compiled matches, expected %zu", M_list_str_at(exprs, j), num_compiled, num_matches);
+		M_free(matches);
+		M_free(compiled_matches);
+	}
+
+	M_time_elapsed_start(&start);
+	for (i=0; i<NUM_DOCS; i++) {
+		for (j=0; j<num_exprs; j++) {
+			matches  = M_xml_xpath(docs[i], M_list_str_at(exprs, j), M_XML_READER_NONE, &num_matches);
+			total   += num_matches;
+			M_free(matches);
+		}
+	}
+	legacy_usec = check_pathspeed_usec(&start);
+
+	M_time_elapsed_start(&start);
+	for (i=0; i<NUM_DOCS; i++) {
+		for (j=0; j<num_exprs; j++) {
+			matches         = M_xml_xpath_eval(compiled[j], docs[i], &num_matches);
+			total_compiled += num_matches;
+			M_free(matches);
+		}
+	}
+	compiled_usec = check_pathspeed_usec(&start);
+	ck_assert_msg(total == total_compiled, "compiled matched %zu, expected %zu", total_compiled, total);
+
+	M_time_elapsed_start(&start);
+	for (i=0; i<NUM_DOCS; i++) {
+		for (j=0; j<num_exprs; j++) {
+			M_xml_xpath_first(compiled[j], docs[i]);
+		}
+	}
+	first_usec = check_pathspeed_usec(&start);
+
+	M_printf("xpath    %2zu expressions: %8.1f us/doc (compiled %8.1f us/doc, first match %8.1f us/doc)\n", num_exprs, legacy_usec, compiled_usec, first_usec);
+
+	for (i=0; i<NUM_DOCS; i++)
+		M_xml_node_destroy(docs[i]);
+	for (j=0; j<num_exprs; j++)
+		M_xml_xpath_destroy(compiled[j]);
+	M_free(docs);
+	M_free(compiled);
+	M_list_str_destroy(exprs);
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static Suite *pathspeed_suite(void)
+{
+	Suite *suite;
+	TCase *tc;
+
+	suite = suite_create("pathspeed");
+
+	tc = tcase_create("pathspeed");
+	tcase_add_test(tc, check_pathspeed_json);
+	tcase_add_test(tc, check_pathspeed_xml);
+	tcase_set_timeout(tc, 300);
+	suite_add_tcase(suite, tc);
+
+	return suite;
+}
+
+int main(int argc, char **argv)
+{
+	SRunner *sr;
+	int      nf;
+
+	(void)argc;
+	(void)argv;
+
+	sr = srunner_create(pathspeed_suite());
+	if (getenv("CK_LOG_FILE_NAME")==NULL) srunner_set_log(sr, "check_pathspeed.log");
+
+	srunner_run_all(sr, CK_NORMAL);
+	nf = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return nf == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
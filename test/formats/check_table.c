@@ -213,6 +213,185 @@ START_TEST(check_table_markdown)
 }
 END_TEST
 
+START_TEST(check_table_typed_sort)
+{
+	M_table_t     *table;
+	M_table_t     *typed;
+	M_hash_dict_t *ids;
+	const char    *names[] = { "delta", "alpha", "Charlie", "bravo", "echo" };
+	const char    *const_temp;
+	const char    *prev_name;
+	char           buf[64];
+	M_decimal_t    dec;
+	M_decimal_t    prev_dec;
+	M_int64        val;
+	M_int64        prev;
+	size_t         numrows = 2000;
+	size_t         i;
+
+	table = M_table_create(M_TABLE_NONE);
+	M_table_column_insert(table, "id");
+	M_table_column_insert(table, "amount");
+	M_table_column_insert(table, "price");
+	M_table_column_insert(table, "name");
+
+	for (i=0; i<numrows; i++) {
+		M_table_row_insert(table);
+		M_snprintf(buf, sizeof(buf), "%zu", i);
+		M_table_cell_set_at(table, i, 0, buf);
+		/* Leave some cells empty. */
+		if (i % 97 != 0) {
+			M_snprintf(buf, sizeof(buf), "%lld", (long long)((i * 7919) % 4099) - 2000);
+			M_table_cell_set_at(table, i, 1, buf);
+		}
+		M_snprintf(buf, sizeof(buf), "%s%zu.%02zu", (i & 1) ? "-" : "", (i * 31) % 500, i % 100);
+		M_table_cell_set_at(table, i, 2, buf);
+		M_table_cell_set_at(table, i, 3, names[i % (sizeof(names)/sizeof(*names))]);
+	}
+
+	typed = M_table_duplicate(table);
+	ck_assert_msg(M_table_column_set_type(typed, "amount", M_TABLE_COLTYPE_INT64), "Could not set amount type");
+	ck_assert_msg(M_table_column_set_type(typed, "price", M_TABLE_COLTYPE_DECIMAL), "Could not set price type");
+	ck_assert_msg(M_table_column_set_type(typed, "name", M_TABLE_COLTYPE_DICT), "Could not set name type");
+	ck_assert_msg(M_table_column_type(typed, 1) == M_TABLE_COLTYPE_INT64, "Wrong amount type");
+	ck_assert_msg(M_table_column_type(typed, 0) == M_TABLE_COLTYPE_STRING, "Wrong id type");
+
+	/* Remember which amount goes with each id so we know the rows stayed together. */
+	ids = M_hash_dict_create(16, 75, M_HASH_DICT_NONE);
+	for (i=0; i<numrows; i++) {
+		const_temp = M_table_cell_at(table, i, 1);
+		M_hash_dict_insert(ids, M_table_cell_at(table, i, 0), const_temp == NULL ? "" : const_temp);
+	}
+
+	/* Integer sort, empty cells first. */
+	M_table_column_sort_data(typed, "amount", NULL, NULL, NULL, NULL);
+	ck_assert_msg(M_table_row_count(typed) == numrows, "Wrong number of rows after sort");
+	prev = M_INT64_MIN;
+	for (i=0; i<numrows; i++) {
+		const_temp = M_table_cell_at(typed, i, 1);
+		ck_assert_msg(M_str_eq(M_hash_dict_get_direct(ids, M_table_cell_at(typed, i, 0)), const_temp == NULL ? "" : const_temp), "%zu: row data was not kept together", i);
+		if (i < (numrows + 96) / 97) {
+			ck_assert_msg(const_temp == NULL, "%zu: expected empty cells first", i);
+			continue;
+		}
+		ck_assert_msg(M_table_cell_int64_at(typed, i, 1, &val), "%zu: no amount", i);
+		ck_assert_msg(val >= prev, "%zu: %lld sorted after %lld", i, (long long)val, (long long)prev);
+		prev = val;
+	}
+
+	/* Decimal sort. */
+	M_table_column_sort_data(typed, "price", NULL, NULL, NULL, NULL);
+	for (i=0; i<numrows; i++) {
+		ck_assert_msg(M_table_cell_decimal_at(typed, i, 2, &dec), "%zu: no price", i);
+		if (i > 0)
+			ck_assert_msg(M_decimal_cmp(&prev_dec, &dec) <= 0, "%zu: price out of order", i);
+		M_decimal_duplicate(&prev_dec, &dec);
+	}
+
+	/* Dictionary sort with integer secondary sort matches sorting the strings. */
+	M_table_column_sort_data(typed, "name", NULL, "id", M_sort_compar_str, NULL);
+	M_table_column_sort_data(table, "name", M_sort_compar_str, "id", M_sort_compar_str, NULL);
+	prev_name = NULL;
+	for (i=0; i<numrows; i++) {
+		const_temp = M_table_cell_at(typed, i, 3);
+		ck_assert_msg(prev_name == NULL || M_str_cmpsort(prev_name, const_temp) <= 0, "%zu: name out of order", i);
+		ck_assert_msg(M_str_eq(const_temp, M_table_cell_at(table, i, 3)), "%zu: name does not match string sort", i);
+		ck_assert_msg(M_str_eq(M_table_cell_at(typed, i, 0), M_table_cell_at(table, i, 0)), "%zu: secondary sort does not match", i);
+		prev_name = const_temp;
+	}
+
+	M_hash_dict_destroy(ids);
+	M_table_destroy(typed);
+	M_table_destroy(table);
+}
+END_TEST
+
+START_TEST(check_table_typed_values)
+{
+	M_table_t     *table;
+	M_table_t     *table2;
+	M_hash_dict_t *dict;
+	const char    *const_temp;
+	char          *out;
+	M_int64        val;
+	M_decimal_t    dec;
+
+	table = M_table_create(M_TABLE_NONE);
+	M_table_column_insert(table, "num");
+	M_table_column_insert(table, "dec");
+	M_table_column_insert(table, "str");
+
+	M_table_row_insert(table);
+	M_table_row_insert(table);
+	M_table_row_insert(table);
+	M_table_cell_set_at(table, 0, 0, "+05");
+	M_table_cell_set_at(table, 1, 0, "abc");
+	M_table_cell_set_at(table, 0, 1, "1.50");
+	M_table_cell_set_at(table, 2, 1, "-3");
+	M_table_cell_set_at(table, 0, 2, "x,y");
+
+	/* A value that isn't a number prevents the conversion. */
+	ck_assert_msg(!M_table_column_set_type_at(table, 0, M_TABLE_COLTYPE_INT64), "Converted column with invalid value");
+	ck_assert_msg(M_table_column_type(table, 0) == M_TABLE_COLTYPE_STRING, "Column type changed after failed conversion");
+	ck_assert_msg(M_str_eq(M_table_cell_at(table, 1, 0), "abc"), "Value changed after failed conversion");
+
+	M_table_cell_clear_at(table, 1, 0);
+	ck_assert_msg(M_table_column_set_type_at(table, 0, M_TABLE_COLTYPE_INT64), "Could not convert num");
+	ck_assert_msg(M_table_column_set_type_at(table, 1, M_TABLE_COLTYPE_DECIMAL), "Could not convert dec");
+
+	const_temp = M_table_cell_at(table, 0, 0);
+	ck_assert_msg(M_str_eq(const_temp, "5"), "Wrong normalized value: got '%s'", const_temp);
+	ck_assert_msg(M_table_cell_at(table, 1, 0) == NULL, "Cleared cell has a value");
+	ck_assert_msg(!M_table_cell_set_at(table, 1, 0, "12a"), "Set invalid value");
+	ck_assert_msg(!M_table_cell_set(table, 1, "dec", "1.2.3", M_TABLE_INSERT_NONE), "Set invalid decimal");
+	ck_assert_msg(M_table_cell_set_int64_at(table, 1, 0, -42), "Could not set integer");
+	ck_assert_msg(M_table_cell_int64_at(table, 1, 0, &val) && val == -42, "Wrong integer value");
+	ck_assert_msg(M_table_cell_set_int64_at(table, 1, 2, 7), "Could not set integer on string column");
+	ck_assert_msg(M_str_eq(M_table_cell_at(table, 1, 2), "7"), "Wrong integer on string column");
+	ck_assert_msg(M_table_cell_decimal_at(table, 2, 1, &dec) && M_decimal_to_int(&dec, 0) == -3, "Wrong decimal value");
+
+	/* Rows using typed columns. */
+	dict = M_hash_dict_create(8, 75, M_HASH_DICT_NONE);
+	M_hash_dict_insert(dict, "num", "nope");
+	ck_assert_msg(!M_table_row_insert_dict(table, dict, M_TABLE_INSERT_NONE, NULL), "Inserted row with invalid value");
+	ck_assert_msg(M_table_row_count(table) == 3, "Row added after invalid insert");
+	M_hash_dict_insert(dict, "num", "9");
+	ck_assert_msg(M_table_row_insert_dict(table, dict, M_TABLE_INSERT_NONE, NULL), "Could not insert row");
+	ck_assert_msg(M_str_eq(M_table_cell_at(table, 3, 0), "9"), "Wrong value in inserted row");
+	M_hash_dict_destroy(dict);
+
+	/* Removed rows don't leave values behind for new rows. */
+	M_table_row_remove(table, 3);
+	M_table_row_insert(table);
+	ck_assert_msg(M_table_cell_at(table, 3, 0) == NULL, "New row has old value");
+	ck_assert_msg(M_table_row_remove_empty_rows(table) == 1, "Wrong number of empty rows removed");
+	M_table_cell_clear_at(table, 2, 1);
+	ck_assert_msg(M_table_row_remove_empty_rows(table) == 1, "Row with only typed values not removed");
+	ck_assert_msg(M_table_row_count(table) == 2, "Wrong number of rows");
+
+	/* Output. */
+	out = M_table_write_csv(table, ',', '"', M_TRUE);
+	ck_assert_msg(M_str_eq(out, "num,dec,str\r\n5,1.5,\"x,y\"\r\n-42,,7"), "Wrong CSV: got '%s'", out);
+	M_free(out);
+
+	out = M_table_write_json(table, M_JSON_WRITER_NONE);
+	ck_assert_msg(M_str_eq(out, "[{\"num\":5,\"dec\":1.5,\"str\":\"x,y\"},{\"num\":-42,\"str\":\"7\"}]"), "Wrong JSON: got '%s'", out);
+
+	table2 = M_table_create(M_TABLE_NONE);
+	ck_assert_msg(M_table_load_json(table2, out, M_str_len(out)), "Could not load JSON with numbers");
+	ck_assert_msg(M_str_eq(M_table_cell(table2, 1, "num"), "-42"), "Wrong number loaded from JSON");
+	M_table_destroy(table2);
+	M_free(out);
+
+	/* Back to strings. */
+	ck_assert_msg(M_table_column_set_type_at(table, 0, M_TABLE_COLTYPE_STRING), "Could not convert back to string");
+	ck_assert_msg(M_str_eq(M_table_cell_at(table, 1, 0), "-42"), "Value lost converting back to string");
+	ck_assert_msg(M_table_cell_set_at(table, 1, 0, "abc"), "Could not set string value");
+
+	M_table_destroy(table);
+}
+END_TEST
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 static Suite *test_suite(void)
@@ -242,6 +421,14 @@ static Suite *test_suite(void)
 	tcase_add_test(tc, check_table_markdown);
 	suite_add_tcase(suite, tc);
 
+	tc = tcase_create("table_typed_sort");
+	tcase_add_test(tc, check_table_typed_sort);
+	suite_add_tcase(suite, tc);
+
+	tc = tcase_create("table_typed_values");
+	tcase_add_test(tc, check_table_typed_values);
+	suite_add_tcase(suite, tc);
+
 	return suite;
 }
 
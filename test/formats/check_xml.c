@@ -463,6 +463,412 @@ START_TEST(check_xml_xpath_text_first)
 }
 END_TEST
 
+static M_bool check_xml_xpath_compiled_count(M_xml_node_t *node, void *thunk)
+{
+	size_t *count = thunk;
+
+	(void)node;
+	(*count)++;
+	/* Stop after the second match. */
+	return *count < 2;
+}
+
+START_TEST(check_xml_xpath_compiled)
+{
+	M_xml_xpath_t  *xpath;
+	M_xml_node_t  **results;
+	M_xml_node_t  **compiled_results;
+	M_xml_node_t   *x;
+	M_xml_node_t   *x2;
+	size_t          num_matches;
+	size_t          num_compiled;
+	size_t          count;
+	size_t          i;
+	size_t          j;
+
+	x  = M_xml_read(XML2, M_str_len(XML2), M_XML_READER_NONE, NULL, NULL, NULL, NULL);
+	x2 = M_xml_read(XML2, M_str_len(XML2), M_XML_READER_NONE, NULL, NULL, NULL, NULL);
+	ck_assert_msg(x != NULL && x2 != NULL, "XML could not be parsed");
+
+	for (i=0; check_xml_xpath_data[i].search!=NULL; i++) {
+		/* Expressions that can never match don't compile. */
+		xpath = M_xml_xpath_compile(check_xml_xpath_data[i].search, M_XML_READER_NONE);
+		if (xpath == NULL) {
+			ck_assert_msg(check_xml_xpath_data[i].num_matches == 0, "(%zu) '%s': could not compile", i, check_xml_xpath_data[i].search);
+			continue;
+		}
+
+		/* The same compiled expression is used for multiple documents. */
+		for (j=0; j<2; j++) {
+			results          = M_xml_xpath(j==0?x:x2, check_xml_xpath_data[i].search, M_XML_READER_NONE, &num_matches);
+			compiled_results = M_xml_xpath_eval(xpath, j==0?x:x2, &num_compiled);
+			ck_assert_msg(num_compiled == num_matches, "(%zu) '%s': got %zu matches, expected %zu", i, check_xml_xpath_data[i].search, num_compiled, num_matches);
+			if (num_matches > 0) {
+				ck_assert_msg(M_mem_eq(results, compiled_results, num_matches * sizeof(*results)), "(%zu) '%s': matches differ", i, check_xml_xpath_data[i].search);
+				ck_assert_msg(M_xml_xpath_first(xpath, j==0?x:x2) == results[0], "(%zu) '%s': first match differs", i, check_xml_xpath_data[i].search);
+			} else {
+				ck_assert_msg(M_xml_xpath_first(xpath, j==0?x:x2) == NULL, "(%zu) '%s': first match found", i, check_xml_xpath_data[i].search);
+			}
+
+			count = 0;
+			ck_assert_msg(M_xml_xpath_foreach(xpath, j==0?x:x2, check_xml_xpath_compiled_count, &count) == M_MIN(num_matches, 2), "(%zu) '%s': foreach did not stop", i, check_xml_xpath_data[i].search);
+			ck_assert_msg(count == M_MIN(num_matches, 2), "(%zu) '%s': foreach called %zu times", i, check_xml_xpath_data[i].search, count);
+
+			M_free(results);
+			M_free(compiled_results);
+		}
+
+		M_xml_xpath_destroy(xpath);
+	}
+
+	/* Expressions that can never match are rejected. */
+	ck_assert(M_xml_xpath_compile("a/b[1", M_XML_READER_NONE) == NULL);
+	ck_assert(M_xml_xpath_compile("a/b[0]", M_XML_READER_NONE) == NULL);
+	ck_assert(M_xml_xpath_compile("a/b[position()]", M_XML_READER_NONE) == NULL);
+	ck_assert(M_xml_xpath_compile("a/b[]", M_XML_READER_NONE) == NULL);
+
+	M_xml_node_destroy(x);
+	M_xml_node_destroy(x2);
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Rebuild the tree from stream callbacks to compare with M_xml_read. */
+typedef struct {
+	M_xml_node_t *doc;
+	M_xml_node_t *node;
+	M_list_str_t *matches;
+} check_xml_reader_state_t;
+
+static void check_xml_reader_copy_attributes(M_xml_node_t *node, const M_hash_dict_t *attributes)
+{
+	M_hash_dict_enum_t *hashenum;
+	const char         *key;
+	const char         *val;
+
+	M_hash_dict_enumerate(attributes, &hashenum);
+	while (M_hash_dict_enumerate_next(attributes, hashenum, &key, &val)) {
+		ck_assert(M_xml_node_insert_attribute(node, key, val, 0, M_FALSE));
+	}
+	M_hash_dict_enumerate_free(hashenum);
+}
+
+static M_xml_error_t check_xml_reader_element_start(const char *name, const M_hash_dict_t *attributes, void *thunk)
+{
+	check_xml_reader_state_t *state = thunk;
+
+	state->node = M_xml_create_element(name, state->node);
+	check_xml_reader_copy_attributes(state->node, attributes);
+	return M_XML_ERROR_SUCCESS;
+}
+
+static M_xml_error_t check_xml_reader_element_end(const char *name, void *thunk)
+{
+	check_xml_reader_state_t *state = thunk;
+
+	ck_assert_msg(M_str_eq(name, M_xml_node_name(state->node)), "end '%s' doesn't match start '%s'", name, M_xml_node_name(state->node));
+	state->node = M_xml_node_parent(state->node);
+	return M_XML_ERROR_SUCCESS;
+}
+
+static M_xml_error_t check_xml_reader_text(const char *text, void *thunk)
+{
+	check_xml_reader_state_t *state = thunk;
+
+	M_xml_create_text(text, 0, state->node);
+	return M_XML_ERROR_SUCCESS;
+}
+
+static M_xml_error_t check_xml_reader_comment(const char *comment, void *thunk)
+{
+	check_xml_reader_state_t *state = thunk;
+
+	M_xml_create_comment(comment, state->node);
+	return M_XML_ERROR_SUCCESS;
+}
+
+static M_xml_error_t check_xml_reader_processing_instruction(const char *name, const M_hash_dict_t *attributes, void *thunk)
+{
+	check_xml_reader_state_t *state = thunk;
+
+	check_xml_reader_copy_attributes(M_xml_create_processing_instruction(name, state->node), attributes);
+	return M_XML_ERROR_SUCCESS;
+}
+
+static M_xml_error_t check_xml_reader_declaration(const char *name, const char *tag_data, void *thunk)
+{
+	check_xml_reader_state_t *state = thunk;
+
+	M_xml_create_declaration_with_tag_data(name, tag_data, state->node);
+	return M_XML_ERROR_SUCCESS;
+}
+
+static M_xml_error_t check_xml_reader_match(const char *search, M_xml_node_t *node, void *thunk)
+{
+	check_xml_reader_state_t *state = thunk;
+	char                     *out;
+
+	(void)search;
+
+	ck_assert_msg(M_xml_node_parent(node) == NULL, "match has a parent");
+	out = M_xml_write(node, M_XML_WRITER_NONE, NULL);
+	M_list_str_insert(state->matches, out);
+	M_free(out);
+	M_xml_node_destroy(node);
+	return M_XML_ERROR_SUCCESS;
+}
+
+static M_xml_reader_t *check_xml_reader_create(check_xml_reader_state_t *state, M_uint32 flags)
+{
+	struct M_xml_reader_callbacks cbs;
+
+	state->doc     = M_xml_create_doc();
+	state->node    = state->doc;
+	state->matches = M_list_str_create(M_LIST_STR_NONE);
+
+	M_mem_set(&cbs, 0, sizeof(cbs));
+	cbs.element_start_func          = check_xml_reader_element_start;
+	cbs.element_end_func            = check_xml_reader_element_end;
+	cbs.text_func                   = check_xml_reader_text;
+	cbs.comment_func                = check_xml_reader_comment;
+	cbs.processing_instruction_func = check_xml_reader_processing_instruction;
+	cbs.declaration_func            = check_xml_reader_declaration;
+	return M_xml_reader_create(&cbs, flags, state);
+}
+
+static void check_xml_reader_destroy(M_xml_reader_t *reader, check_xml_reader_state_t *state)
+{
+	M_xml_reader_destroy(reader);
+	M_xml_node_destroy(state->doc);
+	M_list_str_destroy(state->matches);
+}
+
+/* Feed data in chunks of the given size, 0 for all at once. */
+static M_xml_error_t check_xml_reader_run(M_xml_reader_t *reader, const char *data, size_t len, size_t chunk)
+{
+	M_xml_error_t res;
+	size_t        i;
+
+	if (chunk == 0)
+		chunk = M_MAX(len, 1);
+	for (i=0; i<len; i+=chunk) {
+		res = M_xml_reader_read(reader, data+i, M_MIN(chunk, len-i));
+		if (res != M_XML_ERROR_SUCCESS) {
+			return res;
+		}
+	}
+	return M_xml_reader_finish(reader);
+}
+
+static struct {
+	const char *data;
+	M_uint32    flags;
+} check_xml_reader_data[] = {
+	{ XML1,                                            M_XML_READER_NONE                                            },
+	{ XML2,                                            M_XML_READER_NONE                                            },
+	{ XML3,                                            M_XML_READER_NONE                                            },
+	{ XML4,                                            M_XML_READER_NONE                                            },
+	{ XML4,                                            M_XML_READER_IGNORE_COMMENTS                                 },
+	{ XML5,                                            M_XML_READER_NONE                                            },
+	{ "<a>b</A>",                                      M_XML_READER_TAG_CASECMP                                     },
+	{ "<a a=\"&amp;\">&amp;</a>",                      M_XML_READER_NONE                                            },
+	{ "<a a=\"&amp;\">&amp;</a>",                      M_XML_READER_DONT_DECODE_ATTRS|M_XML_READER_DONT_DECODE_TEXT },
+	{ "<a><b>x&#xD;</b>\r\n</a>",                      M_XML_READER_NONE                                            },
+	{ "\x7f\x0a\x3c 123>a\x7f\x0a\x3c/\x20 123 >",     M_XML_READER_NONE                                            },
+	{ "<!DOCTYPE html>\n<h l='en'><!-- x -- y -->a<![CDATA[<b> & ]]]>c</h>\n", M_XML_READER_NONE                    },
+	{ "<! -x><a b='>' c=\"'\" d>t<? pi q = '?>' ?></a>", M_XML_READER_NONE                                          },
+	{ "text<a></a>  ",                                 M_XML_READER_NONE                                            },
+	{ NULL, 0 }
+};
+
+START_TEST(check_xml_reader)
+{
+	check_xml_reader_state_t  state;
+	M_xml_reader_t           *reader;
+	M_xml_node_t             *x;
+	M_xml_error_t             res;
+	char                     *expected;
+	char                     *out;
+	size_t                    len;
+	size_t                    chunk;
+	size_t                    i;
+
+	for (i=0; check_xml_reader_data[i].data!=NULL; i++) {
+		len = M_str_len(check_xml_reader_data[i].data);
+		x   = M_xml_read(check_xml_reader_data[i].data, len, check_xml_reader_data[i].flags, NULL, NULL, NULL, NULL);
+		ck_assert_msg(x != NULL, "(%zu) XML could not be parsed", i);
+		expected = M_xml_write(x, M_XML_WRITER_NONE, NULL);
+		M_xml_node_destroy(x);
+
+		/* Every chunk size, down to a byte at a time, must produce the same tree. */
+		for (chunk=0; chunk<=len; chunk++) {
+			reader = check_xml_reader_create(&state, check_xml_reader_data[i].flags);
+			res    = check_xml_reader_run(reader, check_xml_reader_data[i].data, len, chunk);
+			ck_assert_msg(res == M_XML_ERROR_SUCCESS, "(%zu) chunk %zu: read failed: %s", i, chunk, M_xml_errcode_to_str(res));
+			ck_assert_msg(state.node == state.doc, "(%zu) chunk %zu: elements left open", i, chunk);
+			out = M_xml_write(state.doc, M_XML_WRITER_NONE, NULL);
+			ck_assert_msg(M_str_eq(out, expected), "(%zu) chunk %zu: got='%s', expected='%s'", i, chunk, out, expected);
+			M_free(out);
+			check_xml_reader_destroy(reader, &state);
+		}
+		M_free(expected);
+	}
+}
+END_TEST
+
+static const char *check_xml_reader_invalid_data[] = {
+	"<a><b></a>",
+	"<a/><!-- c -->",
+	"<a/>x",
+	"</a>",
+	"<a",
+	"<",
+	"< ",
+	"<<a>",
+	"<a><!-- abc",
+	"<a><![CDATA[abc]]",
+	"<a><!-",
+	"<a><?pi",
+	"<a b='>",
+	"<a>\n<b>\n</a>",
+	"  \n",
+	NULL
+};
+
+static void check_xml_reader_invalid_cmp(const char *data)
+{
+	check_xml_reader_state_t  state;
+	M_xml_reader_t           *reader;
+	M_xml_node_t             *x;
+	M_xml_error_t             res;
+	M_xml_error_t             eh;
+	size_t                    eh_pos;
+	size_t                    pos;
+	size_t                    len;
+	size_t                    chunk;
+
+	len = M_str_len(data);
+	x   = M_xml_read(data, len, M_XML_READER_NONE, NULL, &eh, NULL, &eh_pos);
+	ck_assert_msg(x == NULL, "Invalid xml '%s' parsed successfully", data);
+
+	for (chunk=0; chunk<=len; chunk++) {
+		reader = check_xml_reader_create(&state, M_XML_READER_NONE);
+		res    = check_xml_reader_run(reader, data, len, chunk);
+		M_xml_reader_error_pos(reader, NULL, &pos);
+		ck_assert_msg(res == eh, "'%s' chunk %zu: error incorrect. got=%s, expected=%s", data, chunk, M_xml_errcode_to_str(res), M_xml_errcode_to_str(eh));
+		ck_assert_msg(pos == eh_pos, "'%s' chunk %zu: position incorrect. got=%zu, expected=%zu", data, chunk, pos, eh_pos);
+		check_xml_reader_destroy(reader, &state);
+	}
+}
+
+START_TEST(check_xml_reader_invalid)
+{
+	check_xml_reader_state_t  state;
+	M_xml_reader_t           *reader;
+	size_t                    line;
+	size_t                    pos;
+	size_t                    i;
+
+	for (i=0; check_xml_invalid_data[i].data!=NULL; i++)
+		check_xml_reader_invalid_cmp(check_xml_invalid_data[i].data);
+	for (i=0; check_xml_reader_invalid_data[i]!=NULL; i++)
+		check_xml_reader_invalid_cmp(check_xml_reader_invalid_data[i]);
+
+	/* Errors in a tag are reported at the start of the tag. */
+	reader = check_xml_reader_create(&state, M_XML_READER_NONE);
+	ck_assert(check_xml_reader_run(reader, "<a>\n  <b>\n  </a>", 16, 0) == M_XML_ERROR_UNEXPECTED_CLOSE);
+	M_xml_reader_error_pos(reader, &line, &pos);
+	ck_assert_msg(line == 3 && pos == 3, "got line=%zu, pos=%zu", line, pos);
+	/* Stopped readers keep returning the error. */
+	ck_assert(M_xml_reader_read(reader, "<c/>", 4) == M_XML_ERROR_UNEXPECTED_CLOSE);
+	ck_assert(M_xml_reader_finish(reader) == M_XML_ERROR_UNEXPECTED_CLOSE);
+	check_xml_reader_destroy(reader, &state);
+}
+END_TEST
+
+static const char *check_xml_reader_xpath_invalid[] = {
+	"",
+	"/",
+	"a/",
+	"//",
+	"a/../b",
+	"a/text()",
+	"a[last()]",
+	"a[-1]",
+	"a[0]",
+	"a[@x][1]",
+	"a[1][2]",
+	"a[1",
+	"[1]",
+	NULL
+};
+
+START_TEST(check_xml_reader_xpath)
+{
+	check_xml_reader_state_t   state;
+	M_xml_reader_t            *reader;
+	M_xml_node_t              *x;
+	M_xml_node_t             **results;
+	M_xml_error_t              res;
+	char                      *out;
+	size_t                     num_matches;
+	size_t                     chunk;
+	size_t                     tested = 0;
+	size_t                     i;
+	size_t                     j;
+
+	x = M_xml_read(XML2, M_str_len(XML2), M_XML_READER_NONE, NULL, NULL, NULL, NULL);
+	ck_assert_msg(x != NULL, "XML could not be parsed");
+
+	/* Every expression that can be evaluated on a stream matches the same elements as M_xml_xpath. */
+	for (i=0; check_xml_xpath_data[i].search!=NULL; i++) {
+		for (chunk=0; chunk<=7; chunk+=7) {
+			reader = check_xml_reader_create(&state, M_XML_READER_NONE);
+			if (!M_xml_reader_add_xpath(reader, check_xml_xpath_data[i].search, check_xml_reader_match)) {
+				check_xml_reader_destroy(reader, &state);
+				break;
+			}
+			res = check_xml_reader_run(reader, XML2, M_str_len(XML2), chunk);
+			ck_assert_msg(res == M_XML_ERROR_SUCCESS, "(%zu) '%s': read failed: %s", i, check_xml_xpath_data[i].search, M_xml_errcode_to_str(res));
+
+			results = M_xml_xpath(x, check_xml_xpath_data[i].search, M_XML_READER_NONE, &num_matches);
+			ck_assert_msg(M_list_str_len(state.matches) == num_matches, "(%zu) '%s': got %zu matches, expected %zu", i, check_xml_xpath_data[i].search, M_list_str_len(state.matches), num_matches);
+			for (j=0; j<num_matches; j++) {
+				out = M_xml_write(results[j], M_XML_WRITER_NONE, NULL);
+				ck_assert_msg(M_str_eq(out, M_list_str_at(state.matches, j)), "(%zu) '%s': match %zu got='%s', expected='%s'", i, check_xml_xpath_data[i].search, j, M_list_str_at(state.matches, j), out);
+				M_free(out);
+			}
+			M_free(results);
+			check_xml_reader_destroy(reader, &state);
+			tested++;
+		}
+	}
+	ck_assert_msg(tested > 0, "No expressions were tested");
+	M_xml_node_destroy(x);
+
+	for (i=0; check_xml_reader_xpath_invalid[i]!=NULL; i++) {
+		reader = M_xml_reader_create(NULL, M_XML_READER_NONE, NULL);
+		ck_assert_msg(!M_xml_reader_add_xpath(reader, check_xml_reader_xpath_invalid[i], check_xml_reader_match), "'%s' should not be accepted", check_xml_reader_xpath_invalid[i]);
+		M_xml_reader_destroy(reader);
+	}
+
+	/* Nested matches are each delivered and positions only count elements with the tag. */
+	reader = check_xml_reader_create(&state, M_XML_READER_NONE);
+	ck_assert(M_xml_reader_add_xpath(reader, "//b", check_xml_reader_match));
+	ck_assert(M_xml_reader_add_xpath(reader, "/a/c[2]", check_xml_reader_match));
+	ck_assert(M_xml_reader_read(reader, "<a>t<b><c/><b x='1'/></b><c>1</c>u<c>2</c></a>", 46) == M_XML_ERROR_SUCCESS);
+	ck_assert(M_xml_reader_finish(reader) == M_XML_ERROR_SUCCESS);
+	ck_assert_msg(M_list_str_len(state.matches) == 3, "got %zu matches", M_list_str_len(state.matches));
+	ck_assert(M_str_eq(M_list_str_at(state.matches, 0), "<b x=\"1\"/>"));
+	ck_assert(M_str_eq(M_list_str_at(state.matches, 1), "<b><c/><b x=\"1\"/></b>"));
+	ck_assert(M_str_eq(M_list_str_at(state.matches, 2), "<c>2</c>"));
+	/* Paths can't be added once reading has started. */
+	ck_assert(!M_xml_reader_add_xpath(reader, "//c", check_xml_reader_match));
+	check_xml_reader_destroy(reader, &state);
+}
+END_TEST
+
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
@@ -478,6 +884,10 @@ int main(void)
 	add_test(suite, check_xml_invalid);
 	add_test(suite, check_xml_xpath);
 	add_test(suite, check_xml_xpath_text_first);
+	add_test(suite, check_xml_xpath_compiled);
+	add_test(suite, check_xml_reader);
+	add_test(suite, check_xml_reader_invalid);
+	add_test(suite, check_xml_reader_xpath);
 
 	sr = srunner_create(suite);
 	if (getenv("CK_LOG_FILE_NAME")==NULL) srunner_set_log(sr, "check_xml.log");
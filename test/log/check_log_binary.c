@@ -0,0 +1,452 @@
+#include "m_config.h"
+#include <stdlib.h>
+#include <check.h>
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_thread.h>
+#include <mstdlib/mstdlib_io.h>
+#include <mstdlib/mstdlib_log.h>
+
+#define TAG_INFO   (1 << 0)
+#define TAG_DEBUG  (1 << 1)
+
+#define FMT_ID     7
+#define FILE_PATH  "check_log_binary_file.txt"
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/* Time format without any conversions, so decoded lines are predictable ("T: <message>"). Modules are flushed
+ * on destroy.
+ */
+static M_log_t *log_create(M_uint64 accepted_tags, M_bool binary, M_log_module_t **mod)
+{
+	M_log_t *log;
+
+	log = M_log_create(M_LOG_LINE_END_UNIX, M_TRUE, NULL);
+	ck_assert_msg(M_log_set_time_format(log, "T") == M_LOG_SUCCESS, "couldn't set time format");
+
+	ck_assert_msg(M_log_module_add_membuf(log, 1024 * 1024, 3600, NULL, NULL, mod) == M_LOG_SUCCESS,
+		"couldn't add membuf module");
+	ck_assert_msg(M_log_module_membuf_set_binary(log, *mod, binary) == M_LOG_SUCCESS, "couldn't set binary mode");
+	ck_assert_msg(M_log_module_set_accepted_tags(log, *mod, accepted_tags) == M_LOG_SUCCESS,
+		"couldn't set accepted tags");
+
+	return log;
+}
+
+
+static M_buf_t *take_membuf(M_log_t *log, M_log_module_t *mod)
+{
+	M_buf_t *buf = NULL;
+
+	ck_assert_msg(M_log_module_take_membuf(log, mod, &buf) == M_LOG_SUCCESS, "couldn't take membuf");
+	return buf;
+}
+
+
+/* Buffer contents aren't NULL terminated. */
+static M_bool buf_eq(M_buf_t *buf, const char *str)
+{
+	return M_buf_len(buf) == M_str_len(str) && M_mem_eq(M_buf_peek(buf), str, M_buf_len(buf));
+}
+
+
+/* Decode all records in buf, they must all be consumed. */
+static char *decode_all(M_log_t *log, M_buf_t *buf)
+{
+	M_buf_t       *out = M_buf_create();
+	size_t         len_consumed;
+	M_log_error_t  err;
+
+	err = M_log_binary_decode(log, (const unsigned char *)M_buf_peek(buf), M_buf_len(buf), out, &len_consumed);
+	ck_assert_msg(err == M_LOG_SUCCESS, "decode failed: %s", M_log_err_to_str(err));
+	ck_assert_msg(len_consumed == M_buf_len(buf), "decode consumed %zu of %zu bytes", len_consumed, M_buf_len(buf));
+
+	return M_buf_finish_str(out, NULL);
+}
+
+
+/* Log a single message with a newly registered format, and return it decoded. */
+static char *round_trip(const char *fmt, va_list ap)
+{
+	M_log_t        *log;
+	M_log_module_t *mod;
+	M_buf_t        *buf;
+	char           *out;
+	M_log_error_t   err;
+
+	log = log_create(M_LOG_ALL_TAGS, M_TRUE, &mod);
+
+	err = M_log_binary_register_format(log, FMT_ID, fmt);
+	ck_assert_msg(err == M_LOG_SUCCESS, "%s: register failed: %s", fmt, M_log_err_to_str(err));
+
+	err = M_log_binary_vprintf(log, TAG_INFO, NULL, FMT_ID, ap);
+	ck_assert_msg(err == M_LOG_SUCCESS, "%s: printf failed: %s", fmt, M_log_err_to_str(err));
+
+	buf = take_membuf(log, mod);
+	out = decode_all(log, buf);
+
+	M_buf_cancel(buf);
+	M_log_destroy(log);
+	return out;
+}
+
+
+/* Decoded message must match what M_log_printf() would have output. */
+static void check_fmt(const char *fmt, ...)
+{
+	char    *out;
+	char    *msg;
+	char    *line;
+	va_list  ap;
+
+	va_start(ap, fmt);
+	M_vasprintf(&msg, fmt, ap);
+	va_end(ap);
+	M_asprintf(&line, "T: %s\n", msg);
+
+	va_start(ap, fmt);
+	out = round_trip(fmt, ap);
+	va_end(ap);
+
+	ck_assert_msg(M_str_eq(out, line), "%s: got '%s', expected '%s'", fmt, out, line);
+
+	M_free(line);
+	M_free(msg);
+	M_free(out);
+}
+
+
+static void check_fmt_lines(const char *expected, const char *fmt, ...)
+{
+	char    *out;
+	va_list  ap;
+
+	va_start(ap, fmt);
+	out = round_trip(fmt, ap);
+	va_end(ap);
+
+	ck_assert_msg(M_str_eq(out, expected), "%s: got '%s', expected '%s'", fmt, out, expected);
+
+	M_free(out);
+}
+
+
+START_TEST(check_round_trip)
+{
+	int x = 0;
+
+	check_fmt("no conversions");
+	check_fmt("100%%");
+	check_fmt("%d|%i|%5d|%-5d|%05d|%+d|% d", -3, 4, 42, 7, 9, 1, 2);
+	check_fmt("%u|%x|%X|%#x|%o|%#o", 7U, 255U, 255U, 31U, 15U, 15U);
+	check_fmt("%hd|%hu|%hhd|%hhu", (short)-2, (unsigned short)65535, (char)-5, (unsigned char)200);
+	check_fmt("%ld|%lu|%lld|%llu|%llx", -70000L, 70000UL, (long long)(-M_INT64_MAX), (unsigned long long)M_UINT64_MAX,
+		(unsigned long long)0xDEADBEEFULL);
+	check_fmt("%zu|%zd|%I64u|%I32d|%Iu", (size_t)12, (ssize_t)-12, (M_uint64)5000000000ULL, (M_int32)-8, (size_t)9);
+	check_fmt("%*d|%-*d|%.*d|%*.*d|%*d", 5, 12, 5, 34, 3, 56, 6, 4, 78, -4, 9);
+	check_fmt("%f|%.2f|%8.3f|%-8.1f|%e|%E|%g|%G", 1.5, 3.14159, -2.5, 2.25, 1000.0, 0.001, 0.25, 1e20);
+	check_fmt("%*.*f|%*f", 8, 1, 3.14159, 10, -1.0);
+	check_fmt("%c%c%c|%3c|%-3c|", 'a', 'b', 'c', 'x', 'y');
+	check_fmt("%s|%8s|%-8s|%.3s|%*.*s|%*s", "str", "right", "left", "abcdef", 5, 2, "def", 4, "ab");
+	check_fmt("[%s][%5s]", "", "");
+	check_fmt("%s|%10s|%-10s|%.2s|%*s", (char *)NULL, (char *)NULL, (char *)NULL, (char *)NULL, 8, (char *)NULL);
+	check_fmt("%p|%p|%P", &x, NULL, &x);
+	check_fmt("mixed %s=%d (%c, %.1f, %p) %s", "key", 42, 'q', 0.5, &x, (char *)NULL);
+
+	/* NULL strings are output the same way M_log_printf() outputs them. */
+	check_fmt_lines("T: a=<NULL> b=x\n", "a=%s b=%s", (char *)NULL, "x");
+}
+END_TEST
+
+
+START_TEST(check_multiline)
+{
+	check_fmt_lines("T: first 1\nT: second two\n", "first %d\nsecond %s", 1, "two");
+	check_fmt_lines("T: trailing space\n", "trailing %s  \r\n\r\n", "space");
+	check_fmt_lines("T: a\nT: b\n", "%s", "a\r\n\r\nb");
+	check_fmt_lines("", "%s", "");
+}
+END_TEST
+
+
+START_TEST(check_partial)
+{
+	M_log_t        *log;
+	M_log_module_t *mod;
+	M_buf_t        *buf;
+	M_buf_t        *out;
+	size_t          len_consumed;
+	size_t          first_len;
+
+	log = log_create(M_LOG_ALL_TAGS, M_TRUE, &mod);
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "record %d %s") == M_LOG_SUCCESS);
+
+	/* Size of a single record. */
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, FMT_ID, 1, "one") == M_LOG_SUCCESS);
+	buf       = take_membuf(log, mod);
+	first_len = M_buf_len(buf);
+	M_buf_cancel(buf);
+	ck_assert_msg(first_len > 0, "nothing was captured");
+
+	M_log_destroy(log);
+	log = log_create(M_LOG_ALL_TAGS, M_TRUE, &mod);
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "record %d %s") == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, FMT_ID, 1, "one") == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, FMT_ID, 2, "two") == M_LOG_SUCCESS);
+	buf = take_membuf(log, mod);
+	ck_assert_msg(M_buf_len(buf) == first_len * 2, "expected two records of %zu bytes, got %zu bytes", first_len,
+		M_buf_len(buf));
+
+	/* Less than a header, nothing can be decoded. */
+	out = M_buf_create();
+	ck_assert(M_log_binary_decode(log, (const unsigned char *)M_buf_peek(buf), 10, out, &len_consumed) == M_LOG_SUCCESS);
+	ck_assert_msg(len_consumed == 0, "consumed %zu bytes of a partial header", len_consumed);
+	ck_assert_msg(M_buf_len(out) == 0, "partial header was decoded: '%.*s'", (int)M_buf_len(out), M_buf_peek(out));
+
+	/* Second record is cut short, only the first one is decoded. */
+	ck_assert(M_log_binary_decode(log, (const unsigned char *)M_buf_peek(buf), M_buf_len(buf) - 1, out,
+		&len_consumed) == M_LOG_SUCCESS);
+	ck_assert_msg(len_consumed == first_len, "consumed %zu bytes, expected %zu", len_consumed, first_len);
+	ck_assert_msg(buf_eq(out, "T: record 1 one\n"), "got '%.*s'", (int)M_buf_len(out), M_buf_peek(out));
+
+	/* Feed the rest in again. */
+	ck_assert(M_log_binary_decode(log, (const unsigned char *)M_buf_peek(buf) + len_consumed,
+		M_buf_len(buf) - len_consumed, out, &len_consumed) == M_LOG_SUCCESS);
+	ck_assert_msg(len_consumed == first_len, "consumed %zu bytes, expected %zu", len_consumed, first_len);
+	ck_assert_msg(buf_eq(out, "T: record 1 one\nT: record 2 two\n"), "got '%.*s'", (int)M_buf_len(out),
+		M_buf_peek(out));
+
+	M_buf_cancel(out);
+	M_buf_cancel(buf);
+	M_log_destroy(log);
+}
+END_TEST
+
+
+START_TEST(check_invalid_id)
+{
+	M_log_t        *log;
+	M_log_t        *decode_log;
+	M_log_module_t *mod;
+	M_buf_t        *buf;
+	char           *out;
+
+	log = log_create(M_LOG_ALL_TAGS, M_TRUE, &mod);
+
+	/* Reserved ID and bad format strings can't be registered. */
+	ck_assert(M_log_binary_register_format(log, M_LOG_BINARY_FORMAT_TEXT, "text %d") == M_LOG_INVALID_PARAMS);
+	ck_assert(M_log_binary_register_format(log, FMT_ID, NULL) == M_LOG_INVALID_PARAMS);
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "bad %q") == M_LOG_INVALID_FORMAT);
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "cut short %") == M_LOG_INVALID_FORMAT);
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "%hld") == M_LOG_INVALID_FORMAT);
+
+	/* Unregistered and reserved IDs can't be logged. */
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, FMT_ID, 1) == M_LOG_INVALID_FORMAT);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, M_LOG_BINARY_FORMAT_TEXT, 1) == M_LOG_INVALID_PARAMS);
+
+	/* Decoding with a log that doesn't know the format outputs a placeholder and keeps going. */
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "known %d") == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_register_format(log, FMT_ID + 1, "also known %d") == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, FMT_ID, 1) == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, FMT_ID + 1, 2) == M_LOG_SUCCESS);
+	buf = take_membuf(log, mod);
+
+	decode_log = log_create(M_LOG_ALL_TAGS, M_TRUE, &mod);
+	ck_assert(M_log_binary_register_format(decode_log, FMT_ID + 1, "also known %d") == M_LOG_SUCCESS);
+	out = decode_all(decode_log, buf);
+	ck_assert_msg(M_str_eq(out, "T: <unregistered binary log format ID 7>\nT: also known 2\n"), "got '%s'", out);
+	M_free(out);
+
+	/* Replacing a format changes how existing records are decoded. */
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "replaced %d") == M_LOG_SUCCESS);
+	out = decode_all(log, buf);
+	ck_assert_msg(M_str_eq(out, "T: replaced 1\nT: also known 2\n"), "got '%s'", out);
+	M_free(out);
+
+	M_buf_cancel(buf);
+	M_log_destroy(decode_log);
+	M_log_destroy(log);
+}
+END_TEST
+
+
+START_TEST(check_mixed)
+{
+	M_log_t        *log;
+	M_log_module_t *mod;
+	M_buf_t        *buf;
+	char           *out;
+
+	log = log_create(M_LOG_ALL_TAGS, M_TRUE, &mod);
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "binary %d %s") == M_LOG_SUCCESS);
+
+	ck_assert(M_log_printf(log, TAG_INFO, NULL, "text %d", 1) == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, FMT_ID, 2, "two") == M_LOG_SUCCESS);
+	ck_assert(M_log_write(log, TAG_INFO, NULL, "text 3\ntext 4") == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, FMT_ID, 5, (char *)NULL) == M_LOG_SUCCESS);
+
+	buf = take_membuf(log, mod);
+	out = decode_all(log, buf);
+	ck_assert_msg(M_str_eq(out, "T: text 1\nT: binary 2 two\nT: text 3\nT: text 4\nT: binary 5 <NULL>\n"),
+		"got '%s'", out);
+
+	M_free(out);
+	M_buf_cancel(buf);
+	M_log_destroy(log);
+}
+END_TEST
+
+
+static M_bool filter_cb(M_uint64 tag, void *filter_thunk, void *msg_thunk)
+{
+	(void)tag;
+	(void)filter_thunk;
+	return M_str_eq(msg_thunk, "keep");
+}
+
+
+START_TEST(check_tag_filter)
+{
+	M_log_t        *log;
+	M_log_module_t *mod;
+	M_buf_t        *buf;
+	char           *out;
+
+	log = log_create(TAG_INFO, M_TRUE, &mod);
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "tag %d") == M_LOG_SUCCESS);
+
+	/* Tags must be a single power of two. */
+	ck_assert(M_log_binary_printf(log, TAG_INFO | TAG_DEBUG, NULL, FMT_ID, 0) == M_LOG_INVALID_TAG);
+
+	/* Tag no module accepts is skipped before the format is looked up. */
+	ck_assert(M_log_binary_printf(log, TAG_DEBUG, NULL, FMT_ID, 1) == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_DEBUG, NULL, FMT_ID + 1, 1) == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, NULL, FMT_ID, 2) == M_LOG_SUCCESS);
+
+	/* Filter callback sees the per-message thunk. */
+	ck_assert(M_log_module_set_filter(log, mod, filter_cb, NULL, NULL) == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, (void *)"drop", FMT_ID, 3) == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, (void *)"keep", FMT_ID, 4) == M_LOG_SUCCESS);
+
+	buf = take_membuf(log, mod);
+	out = decode_all(log, buf);
+	ck_assert_msg(M_str_eq(out, "T: tag 2\nT: tag 4\n"), "got '%s'", out);
+
+	M_free(out);
+	M_buf_cancel(buf);
+	M_log_destroy(log);
+}
+END_TEST
+
+
+static void prefix_cb(M_buf_t *buf, M_uint64 tag, void *prefix_thunk, void *msg_thunk)
+{
+	(void)tag;
+	(void)prefix_thunk;
+	M_bprintf(buf, " <%s>: ", (const char *)msg_thunk);
+}
+
+
+START_TEST(check_text_modules)
+{
+	M_log_t        *log;
+	M_log_module_t *mod;
+	M_log_module_t *file_mod;
+	char           *text;
+	char           *file_data = NULL;
+	const char     *expected;
+	size_t          i;
+
+	(void)M_fs_delete(FILE_PATH, M_FALSE, NULL, M_FS_PROGRESS_NOEXTRA);
+
+	/* Text membuf is formatted on the logging thread, file module formats on its writer thread. */
+	log = log_create(M_LOG_ALL_TAGS, M_FALSE, &mod);
+	ck_assert(M_log_module_add_file(log, FILE_PATH, 0, 0, 0, 1024 * 1024, NULL, NULL, &file_mod) == M_LOG_SUCCESS);
+	ck_assert(M_log_module_set_accepted_tags(log, file_mod, M_LOG_ALL_TAGS) == M_LOG_SUCCESS);
+	ck_assert(M_log_set_tag_name(log, TAG_INFO, "INFO") == M_LOG_SUCCESS);
+	ck_assert(M_log_set_prefix(log, prefix_cb, NULL, NULL) == M_LOG_SUCCESS);
+
+	/* Formats are replaced while messages using them may still be queued. */
+	for (i=0; i<100; i++) {
+		ck_assert(M_log_binary_register_format(log, FMT_ID, "msg %d %s\nnext %c") == M_LOG_SUCCESS);
+		ck_assert(M_log_binary_printf(log, TAG_INFO, (void *)"th", FMT_ID, 1, (char *)NULL, 'z') == M_LOG_SUCCESS);
+	}
+	ck_assert(M_log_binary_register_format(log, FMT_ID, "last %s") == M_LOG_SUCCESS);
+	ck_assert(M_log_binary_printf(log, TAG_INFO, (void *)"th", FMT_ID, "one") == M_LOG_SUCCESS);
+
+	text = M_buf_finish_str(take_membuf(log, mod), NULL);
+	M_log_destroy_blocking(log, 5000);
+
+	ck_assert(M_fs_file_read_bytes(FILE_PATH, 0, (unsigned char **)&file_data, NULL) == M_FS_ERROR_SUCCESS);
+	ck_assert_msg(M_str_eq(file_data, text), "file '%s' doesn't match membuf '%s'", file_data, text);
+
+	expected = "T [INFO] <th>: msg 1 <NULL>\nT [INFO] <th>: next z\n";
+	ck_assert_msg(M_str_eq_start(text, expected), "got '%s', expected it to start with '%s'", text, expected);
+	ck_assert_msg(M_str_eq_end(text, "T [INFO] <th>: last one\n"), "got '%s'", text);
+	ck_assert_msg(M_str_len(text) == 100 * M_str_len(expected) + M_str_len("T [INFO] <th>: last one\n"),
+		"unexpected output length %zu", M_str_len(text));
+
+	M_free(file_data);
+	M_free(text);
+	(void)M_fs_delete(FILE_PATH, M_FALSE, NULL, M_FS_PROGRESS_NOEXTRA);
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static Suite *test_suite(void)
+{
+	Suite *suite;
+	TCase *tc;
+
+	suite = suite_create("log_binary");
+
+	tc = tcase_create("round_trip");
+	tcase_add_test(tc, check_round_trip);
+	suite_add_tcase(suite, tc);
+
+	tc = tcase_create("multiline");
+	tcase_add_test(tc, check_multiline);
+	suite_add_tcase(suite, tc);
+
+	tc = tcase_create("partial");
+	tcase_add_test(tc, check_partial);
+	suite_add_tcase(suite, tc);
+
+	tc = tcase_create("invalid_id");
+	tcase_add_test(tc, check_invalid_id);
+	suite_add_tcase(suite, tc);
+
+	tc = tcase_create("mixed");
+	tcase_add_test(tc, check_mixed);
+	suite_add_tcase(suite, tc);
+
+	tc = tcase_create("tag_filter");
+	tcase_add_test(tc, check_tag_filter);
+	suite_add_tcase(suite, tc);
+
+	tc = tcase_create("text_modules");
+	tcase_add_test(tc, check_text_modules);
+	suite_add_tcase(suite, tc);
+
+	return suite;
+}
+
+int main(int argc, char **argv)
+{
+	SRunner *sr;
+	int      nf;
+
+	(void)argc;
+	(void)argv;
+
+	sr = srunner_create(test_suite());
+	if (getenv("CK_LOG_FILE_NAME")==NULL) srunner_set_log(sr, "check_log_binary.log");
+
+	srunner_run_all(sr, CK_NORMAL);
+	nf = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return nf == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,417 @@
+#include "m_config.h"
+#include <stdlib.h>
+#include <check.h>
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_io.h>
+#include <mstdlib/mstdlib_net.h>
+
+#define MAX_TIMEOUT 30000
+#define MAX_CONNS   16
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+typedef enum {
+	SERVER_KEEPALIVE = 0, /* Keep every connection open. */
+	SERVER_CLOSE,         /* Respond with Connection: close and disconnect. */
+	SERVER_DROP_SECOND    /* Disconnect without responding to the second request on a connection. */
+} server_mode_t;
+
+typedef struct {
+	M_io_t     *io;
+	M_parser_t *parser;
+	size_t      requests;
+} server_conn_t;
+
+typedef struct {
+	M_event_t     *el;
+	M_io_t        *listen;
+	M_uint16       port;
+	server_mode_t  mode;
+	server_conn_t  conns[MAX_CONNS];
+	size_t         accepted;
+	size_t         requests;
+} server_t;
+
+typedef struct {
+	M_event_t         *el;
+	M_dns_t           *dns;
+	M_net_http_pool_t *pool;
+	M_http_method_t    method;
+	char               url[64];
+	size_t             total;
+	size_t             started;
+	size_t             done;
+	size_t             failed;
+	M_bool             sequential;
+} client_t;
+
+static server_conn_t *server_conn(server_t *srv, M_io_t *io)
+{
+	size_t i;
+
+	for (i=0; i<MAX_CONNS; i++) {
+		if (srv->conns[i].io == io) {
+			return &srv->conns[i];
+		}
+	}
+	return NULL;
+}
+
+static void server_conn_close(server_conn_t *conn)
+{
+	M_io_destroy(conn->io);
+	M_parser_destroy(conn->parser);
+	conn->io     = NULL;
+	conn->parser = NULL;
+}
+
+static void server_respond(server_t *srv, server_conn_t *conn)
+{
+	const char *resp;
+	size_t      len;
+
+	/* Requests don't have a body so everything up to the end of the headers is the request. */
+	while (M_parser_consume_until(conn->parser, (const unsigned char *)"\r\n\r\n", 4, M_TRUE) != 0) {
+		conn->requests++;
+		srv->requests++;
+
+		if (srv->mode == SERVER_DROP_SECOND && conn->requests == 2) {
+			server_conn_close(conn);
+			return;
+		}
+
+		if (srv->mode == SERVER_CLOSE) {
+			resp = "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 2\r\n\r\nok";
+		} else {
+			resp = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+		}
+		M_io_write(conn->io, (const unsigned char *)resp, M_str_len(resp), &len);
+
+		if (srv->mode == SERVER_CLOSE) {
+			M_io_disconnect(conn->io);
+			return;
+		}
+	}
+}
+
+static void server_cb(M_event_t *el, M_event_type_t etype, M_io_t *io, void *thunk)
+{
+	server_t      *srv = thunk;
+	server_conn_t *conn;
+	M_io_t        *newio;
+	size_t         i;
+
+	(void)el;
+
+	if (etype == M_EVENT_TYPE_ACCEPT) {
+		while (M_io_accept(&newio, io) == M_IO_ERROR_SUCCESS) {
+			for (i=0; i<MAX_CONNS; i++) {
+				if (srv->conns[i].io == NULL) {
+					break;
+				}
+			}
+			ck_assert_msg(i < MAX_CONNS, "server ran out of connections");
+			srv->conns[i].io       = newio;
+			srv->conns[i].parser   = M_parser_create(M_PARSER_FLAG_NONE);
+			srv->conns[i].requests = 0;
+			srv->accepted++;
+			M_event_add(srv->el, newio, server_cb, srv);
+		}
+		return;
+	}
+
+	conn = server_conn(srv, io);
+	if (conn == NULL) {
+		return;
+	}
+
+	switch (etype) {
+		case M_EVENT_TYPE_READ:
+			if (M_io_read_into_parser(io, conn->parser) == M_IO_ERROR_SUCCESS) {
+				server_respond(srv, conn);
+				break;
+			}
+			/* Fall through. */
+		case M_EVENT_TYPE_DISCONNECTED:
+		case M_EVENT_TYPE_ERROR:
+			if (conn->io != NULL) {
+				server_conn_close(conn);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static void server_start(server_t *srv, M_event_t *el, server_mode_t mode)
+{
+	M_io_error_t ioerr;
+
+	M_mem_set(srv, 0, sizeof(*srv));
+	srv->el   = el;
+	srv->mode = mode;
+	srv->port = (M_uint16)M_rand_range(NULL, 10000, 48000);
+	while ((ioerr = M_io_net_server_create(&srv->listen, srv->port, "127.0.0.1", M_IO_NET_IPV4)) == M_IO_ERROR_ADDRINUSE) {
+		srv->port = (M_uint16)M_rand_range(NULL, 10000, 48000);
+	}
+	ck_assert_msg(ioerr == M_IO_ERROR_SUCCESS, "could not create server: %s", M_io_error_string(ioerr));
+	M_event_add(el, srv->listen, server_cb, srv);
+}
+
+static void server_stop(server_t *srv)
+{
+	size_t i;
+
+	for (i=0; i<MAX_CONNS; i++) {
+		if (srv->conns[i].io != NULL) {
+			server_conn_close(&srv->conns[i]);
+		}
+	}
+	M_io_destroy(srv->listen);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void client_send(client_t *client);
+
+static void client_done_cb(M_net_error_t net_error, M_http_error_t http_error, const M_http_simple_read_t *simple, const char *error, void *thunk)
+{
+	client_t *client = thunk;
+
+	(void)http_error;
+	(void)error;
+
+	client->done++;
+	if (net_error != M_NET_ERROR_SUCCESS || M_http_simple_read_status_code(simple) != 200) {
+		client->failed++;
+	}
+
+	if (client->done == client->total) {
+		M_event_done(client->el);
+		return;
+	}
+
+	if (client->sequential) {
+		client_send(client);
+	}
+}
+
+static void client_send(client_t *client)
+{
+	M_net_http_simple_t *hs;
+
+	hs = M_net_http_simple_create(client->el, client->dns, client_done_cb);
+	ck_assert_msg(M_net_http_simple_set_pool(hs, client->pool), "could not set pool");
+	M_net_http_simple_set_message(hs, client->method, NULL, NULL, NULL, NULL, NULL, 0);
+	M_net_http_simple_set_timeouts(hs, 5000, 5000, 10000);
+	client->started++;
+	ck_assert_msg(M_net_http_simple_send(hs, client->url, client), "could not send request");
+}
+
+static void client_run(client_t *client, M_event_t *el, M_dns_t *dns, M_net_http_pool_t *pool, const server_t *srv, size_t total, M_bool sequential)
+{
+	size_t i;
+
+	M_mem_set(client, 0, sizeof(*client));
+	client->el         = el;
+	client->dns        = dns;
+	client->pool       = pool;
+	client->method     = M_HTTP_METHOD_GET;
+	client->total      = total;
+	client->sequential = sequential;
+	M_snprintf(client->url, sizeof(client->url), "http://127.0.0.1:%u/", (unsigned int)srv->port);
+
+	if (sequential) {
+		client_send(client);
+	} else {
+		for (i=0; i<total; i++) {
+			client_send(client);
+		}
+	}
+
+	ck_assert_msg(M_event_loop(el, MAX_TIMEOUT) == M_EVENT_ERR_DONE, "event loop did not finish");
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+START_TEST(check_pool_reuse)
+{
+	M_event_t         *el   = M_event_create(M_EVENT_FLAG_NONE);
+	M_dns_t           *dns  = M_dns_create(el);
+	M_net_http_pool_t *pool = M_net_http_pool_create(el);
+	server_t           srv;
+	client_t           client;
+	M_uint64           hits;
+	M_uint64           misses;
+	size_t             idle;
+
+	server_start(&srv, el, SERVER_KEEPALIVE);
+	client_run(&client, el, dns, pool, &srv, 5, M_TRUE);
+
+	ck_assert_msg(client.failed == 0, "%zu requests failed", client.failed);
+	ck_assert_msg(srv.accepted == 1, "expected 1 connection, got %zu", srv.accepted);
+	ck_assert_msg(srv.requests == 5, "expected 5 requests, got %zu", srv.requests);
+
+	M_net_http_pool_stats(pool, &hits, &misses);
+	ck_assert_msg(hits == 4 && misses == 1, "expected 4 hits and 1 miss, got %llu and %llu", (unsigned long long)hits, (unsigned long long)misses);
+	ck_assert_msg(M_net_http_pool_host_connections(pool, "127.0.0.1", srv.port, &idle) == 1 && idle == 1, "expected 1 idle connection");
+
+	M_net_http_pool_destroy(pool);
+	server_stop(&srv);
+	M_dns_destroy(dns);
+	M_event_destroy(el);
+}
+END_TEST
+
+START_TEST(check_pool_close)
+{
+	M_event_t         *el   = M_event_create(M_EVENT_FLAG_NONE);
+	M_dns_t           *dns  = M_dns_create(el);
+	M_net_http_pool_t *pool = M_net_http_pool_create(el);
+	server_t           srv;
+	client_t           client;
+	M_uint64           hits;
+	M_uint64           misses;
+	size_t             idle;
+
+	/* Connection: close in the response must prevent reuse. */
+	server_start(&srv, el, SERVER_CLOSE);
+	client_run(&client, el, dns, pool, &srv, 3, M_TRUE);
+
+	ck_assert_msg(client.failed == 0, "%zu requests failed", client.failed);
+	ck_assert_msg(srv.accepted == 3, "expected 3 connections, got %zu", srv.accepted);
+
+	M_net_http_pool_stats(pool, &hits, &misses);
+	ck_assert_msg(hits == 0 && misses == 3, "expected 0 hits and 3 misses, got %llu and %llu", (unsigned long long)hits, (unsigned long long)misses);
+	ck_assert_msg(M_net_http_pool_host_connections(pool, "127.0.0.1", srv.port, &idle) == 0 && idle == 0, "expected no pooled connections");
+
+	M_net_http_pool_destroy(pool);
+	server_stop(&srv);
+	M_dns_destroy(dns);
+	M_event_destroy(el);
+}
+END_TEST
+
+START_TEST(check_pool_max_per_host)
+{
+	M_event_t         *el   = M_event_create(M_EVENT_FLAG_NONE);
+	M_dns_t           *dns  = M_dns_create(el);
+	M_net_http_pool_t *pool = M_net_http_pool_create(el);
+	server_t           srv;
+	client_t           client;
+	size_t             idle;
+
+	/* Requests above the limit wait for a connection to be returned. */
+	M_net_http_pool_set_max_per_host(pool, 2);
+	server_start(&srv, el, SERVER_KEEPALIVE);
+	client_run(&client, el, dns, pool, &srv, 8, M_FALSE);
+
+	ck_assert_msg(client.failed == 0, "%zu requests failed", client.failed);
+	ck_assert_msg(srv.accepted == 2, "expected 2 connections, got %zu", srv.accepted);
+	ck_assert_msg(srv.requests == 8, "expected 8 requests, got %zu", srv.requests);
+	ck_assert_msg(M_net_http_pool_host_connections(pool, "127.0.0.1", srv.port, &idle) == 2 && idle == 2, "expected 2 idle connections");
+
+	M_net_http_pool_destroy(pool);
+	server_stop(&srv);
+	M_dns_destroy(dns);
+	M_event_destroy(el);
+}
+END_TEST
+
+START_TEST(check_pool_retry)
+{
+	M_event_t         *el   = M_event_create(M_EVENT_FLAG_NONE);
+	M_dns_t           *dns  = M_dns_create(el);
+	M_net_http_pool_t *pool = M_net_http_pool_create(el);
+	server_t           srv;
+	client_t           client;
+
+	/* The server drops the reused connection without responding. The
+	 * request is idempotent so it's sent again on a new connection. */
+	server_start(&srv, el, SERVER_DROP_SECOND);
+	client_run(&client, el, dns, pool, &srv, 2, M_TRUE);
+
+	ck_assert_msg(client.failed == 0, "%zu requests failed", client.failed);
+	ck_assert_msg(srv.accepted == 2, "expected 2 connections, got %zu", srv.accepted);
+	ck_assert_msg(srv.requests == 3, "expected 3 requests, got %zu", srv.requests);
+
+	M_net_http_pool_destroy(pool);
+	server_stop(&srv);
+	M_dns_destroy(dns);
+	M_event_destroy(el);
+}
+END_TEST
+
+START_TEST(check_pool_no_retry)
+{
+	M_event_t         *el   = M_event_create(M_EVENT_FLAG_NONE);
+	M_dns_t           *dns  = M_dns_create(el);
+	M_net_http_pool_t *pool = M_net_http_pool_create(el);
+	server_t           srv;
+	client_t           client;
+
+	/* A POST may have been processed so it must not be sent twice. */
+	server_start(&srv, el, SERVER_DROP_SECOND);
+	M_mem_set(&client, 0, sizeof(client));
+	client.el         = el;
+	client.dns        = dns;
+	client.pool       = pool;
+	client.method     = M_HTTP_METHOD_POST;
+	client.total      = 2;
+	client.sequential = M_TRUE;
+	M_snprintf(client.url, sizeof(client.url), "http://127.0.0.1:%u/", (unsigned int)srv.port);
+	client_send(&client);
+	ck_assert_msg(M_event_loop(el, MAX_TIMEOUT) == M_EVENT_ERR_DONE, "event loop did not finish");
+
+	ck_assert_msg(client.failed == 1, "expected 1 failed request, got %zu", client.failed);
+	ck_assert_msg(srv.accepted == 1, "expected 1 connection, got %zu", srv.accepted);
+	ck_assert_msg(srv.requests == 2, "expected 2 requests, got %zu", srv.requests);
+
+	M_net_http_pool_destroy(pool);
+	server_stop(&srv);
+	M_dns_destroy(dns);
+	M_event_destroy(el);
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static Suite *http_pool_suite(void)
+{
+	Suite *suite;
+	TCase *tc;
+
+	suite = suite_create("http_pool");
+
+	tc = tcase_create("http_pool");
+	tcase_add_test(tc, check_pool_reuse);
+	tcase_add_test(tc, check_pool_close);
+	tcase_add_test(tc, check_pool_max_per_host);
+	tcase_add_test(tc, check_pool_retry);
+	tcase_add_test(tc, check_pool_no_retry);
+	tcase_set_timeout(tc, 120);
+	suite_add_tcase(suite, tc);
+
+	return suite;
+}
+
+int main(int argc, char **argv)
+{
+	SRunner *sr;
+	int      nf;
+
+	(void)argc;
+	(void)argv;
+
+	sr = srunner_create(http_pool_suite());
+	if (getenv("CK_LOG_FILE_NAME")==NULL) srunner_set_log(sr, "check_http_pool.log");
+
+	srunner_run_all(sr, CK_NORMAL);
+	nf = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	M_library_cleanup();
+
+	return nf == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
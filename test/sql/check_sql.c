@@ -5,6 +5,8 @@
 #include <mstdlib/mstdlib.h>
 #include <mstdlib/mstdlib_sql.h>
 #include <mstdlib/mstdlib_formats.h>
+#include <mstdlib/mstdlib_io.h>
+#include <mstdlib/mstdlib_thread.h>
 
 #define DEBUG 0
 #define INSERT_ROWS 10000
@@ -307,7 +309,7 @@ static M_sql_error_t check_sql_trans(M_sql_trans_t *trans, void *arg, char *erro
 	return err;
 }
 
-static M_sql_connpool_t *check_connect_pool(void)
+static M_sql_connpool_t *check_create_pool_flags(M_sql_connpool_flags_t flags)
 {
 	M_sql_connpool_t *pool    = NULL;
 	const char       *driver;
@@ -346,18 +348,36 @@ static M_sql_connpool_t *check_connect_pool(void)
 	}
 
 	/* Connect */
-	err = M_sql_connpool_create(&pool, driver, conn_str, username, password, M_str_to_uint32(sql_conns), M_SQL_CONNPOOL_FLAG_PRESPAWN_ALL, error, sizeof(error));
+	err = M_sql_connpool_create(&pool, driver, conn_str, username, password, M_str_to_uint32(sql_conns), flags, error, sizeof(error));
 	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_connpool_create failed: %s: %s", M_sql_error_string(err), error);
 
 	M_printf("SQL Driver        : %s (%s) v%s\n", M_sql_connpool_driver_display_name(pool), M_sql_connpool_driver_name(pool), M_sql_connpool_driver_version(pool));
 
 	ck_assert_msg(M_sql_connpool_add_trace(pool, sql_trace, NULL) == M_TRUE, "M_sql_connpool_add_trace() failed");
 
+	return pool;
+}
+
+static M_sql_connpool_t *check_create_pool(void)
+{
+	return check_create_pool_flags(M_SQL_CONNPOOL_FLAG_PRESPAWN_ALL);
+}
+
+static void check_start_pool(M_sql_connpool_t *pool)
+{
+	M_sql_error_t err;
+	char          error[256];
+
 	err = M_sql_connpool_start(pool, error, sizeof(error));
 	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_connpool_start failed: %s: %s", M_sql_error_string(err), error);
 
 	M_printf("SQL Server Version: %s\n", M_sql_connpool_server_version(pool));
+}
 
+static M_sql_connpool_t *check_connect_pool(void)
+{
+	M_sql_connpool_t *pool = check_create_pool();
+	check_start_pool(pool);
 	return pool;
 }
 
@@ -369,6 +389,73 @@ static M_sql_connpool_t *check_connect_pool(void)
  *      - rollbacks/deadlocks work (multithreaded test?)
  */
 
+static M_sql_stmt_t *check_report_query(M_sql_connpool_t *pool)
+{
+	M_sql_error_t  err;
+	M_sql_stmt_t  *stmt = M_sql_stmt_create();
+
+	/* Small batches so the report spans many fetches */
+	M_sql_stmt_set_max_fetch_rows(stmt, 100);
+	M_sql_stmt_prepare(stmt, "SELECT * FROM \"foo\" ORDER BY \"key\"");
+	err = M_sql_stmt_execute(pool, stmt);
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS_ROW, "M_sql_stmt_execute(SELECT) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+	return stmt;
+}
+
+typedef struct {
+	M_buf_t *buf;
+	size_t   writes;
+} check_report_out_t;
+
+static M_bool check_report_write(const unsigned char *data, size_t data_len, void *thunk)
+{
+	check_report_out_t *rout = thunk;
+
+	M_buf_add_bytes(rout->buf, data, data_len);
+	rout->writes++;
+	return M_TRUE;
+}
+
+static void check_report_stream(M_sql_connpool_t *pool)
+{
+	M_sql_error_t       err;
+	M_sql_report_t     *report    = M_sql_report_create(M_SQL_REPORT_FLAG_PASSTHRU_UNLISTED);
+	M_sql_stmt_t       *stmt;
+	check_report_out_t  rout;
+	char               *out;
+	size_t              out_len;
+	unsigned char      *file_data = NULL;
+	size_t              file_len  = 0;
+	char                error[256];
+
+	stmt = check_report_query(pool);
+	err  = M_sql_report_process(report, stmt, NULL, &out, &out_len, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_report_process() failed: %s: %s", M_sql_error_string(err), error);
+	M_sql_stmt_destroy(stmt);
+
+	rout.buf    = M_buf_create();
+	rout.writes = 0;
+	stmt        = check_report_query(pool);
+	err         = M_sql_report_process_stream(report, stmt, NULL, check_report_write, &rout, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_report_process_stream() failed: %s: %s", M_sql_error_string(err), error);
+	ck_assert_msg(M_buf_len(rout.buf) == out_len && M_mem_eq(M_buf_peek(rout.buf), out, out_len), "streamed report does not match");
+	ck_assert_msg(rout.writes > 1, "expected report to be written in chunks, %zu writes", rout.writes);
+	M_sql_stmt_destroy(stmt);
+	M_buf_cancel(rout.buf);
+
+	stmt = check_report_query(pool);
+	err  = M_sql_report_process_file(report, stmt, NULL, "./check_sql_report.csv", error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_report_process_file() failed: %s: %s", M_sql_error_string(err), error);
+	M_sql_stmt_destroy(stmt);
+	ck_assert_msg(M_fs_file_read_bytes("./check_sql_report.csv", 0, &file_data, &file_len) == M_FS_ERROR_SUCCESS, "unable to read report file");
+	ck_assert_msg(file_len == out_len && M_mem_eq(file_data, out, out_len), "report file does not match");
+	M_fs_delete("./check_sql_report.csv", M_FALSE, NULL, M_FS_PROGRESS_NOEXTRA);
+
+	M_free(file_data);
+	M_free(out);
+	M_sql_report_destroy(report);
+}
+
 START_TEST(check_sql)
 {
 	M_sql_error_t     err;
@@ -552,6 +639,9 @@ START_TEST(check_sql)
 	}
 	M_sql_stmt_destroy(stmt);
 
+	/* Report output written out as it is generated */
+	check_report_stream(pool);
+
 	/* Close connections */
 	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
 
@@ -701,6 +791,1453 @@ START_TEST(check_tabledata)
 END_TEST
 
 
+#define ASYNC_ROWS 50
+
+typedef struct {
+	M_sql_connpool_t *pool;
+	M_event_t        *el;
+	size_t            inserted;
+	size_t            failed;
+	M_int64           sum;
+	M_int64           count;
+} check_async_t;
+
+static M_sql_error_t check_async_sum(M_sql_trans_t *trans, void *arg, char *error, size_t error_size)
+{
+	check_async_t *data = arg;
+	M_sql_stmt_t  *stmt;
+	M_sql_error_t  err;
+
+	stmt = M_sql_stmt_create();
+	M_sql_stmt_prepare(stmt, "SELECT SUM(\"val\") FROM \"bar\"");
+	err  = M_sql_trans_execute(trans, stmt);
+	if (err == M_SQL_ERROR_SUCCESS)
+		err = M_sql_stmt_result_int64(stmt, 0, 0, &data->sum);
+	if (err != M_SQL_ERROR_SUCCESS)
+		M_snprintf(error, error_size, "%s", M_sql_stmt_get_error_string(stmt));
+	M_sql_stmt_destroy(stmt);
+	return err;
+}
+
+static void check_async_count_cb(M_sql_stmt_t *stmt, M_sql_error_t err, void *thunk)
+{
+	check_async_t *data = thunk;
+
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "async SELECT COUNT failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+	data->count = M_sql_stmt_result_int64_direct(stmt, 0, 0);
+	M_sql_stmt_destroy(stmt);
+
+	M_event_done(data->el);
+}
+
+static void check_async_sum_cb(M_sql_error_t err, const char *error, void *thunk)
+{
+	check_async_t *data = thunk;
+	M_sql_stmt_t  *stmt;
+
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "async transaction failed: %s: %s", M_sql_error_string(err), error);
+
+	stmt = M_sql_stmt_create();
+	M_sql_stmt_prepare(stmt, "SELECT COUNT(*) FROM \"bar\"");
+	ck_assert_msg(M_sql_stmt_execute_async(data->pool, stmt, data->el, check_async_count_cb, data), "M_sql_stmt_execute_async(SELECT) failed");
+}
+
+static void check_async_insert_cb(M_sql_stmt_t *stmt, M_sql_error_t err, void *thunk)
+{
+	check_async_t *data = thunk;
+
+	if (err != M_SQL_ERROR_SUCCESS) {
+		M_printf("async INSERT failed: %s: %s\n", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+		data->failed++;
+	}
+	M_sql_stmt_destroy(stmt);
+
+	data->inserted++;
+	if (data->inserted != ASYNC_ROWS)
+		return;
+
+	ck_assert_msg(M_sql_trans_process_async(data->pool, M_SQL_ISOLATION_READCOMMITTED, check_async_sum, data, data->el, check_async_sum_cb, data), "M_sql_trans_process_async() failed");
+}
+
+START_TEST(check_async)
+{
+	M_sql_error_t     err;
+	M_sql_table_t    *table;
+	M_sql_stmt_t     *stmt;
+	check_async_t     data;
+	char              error[256];
+	size_t            queued;
+	size_t            running;
+	M_uint64          wait_avg_ms;
+	M_uint64          wait_max_ms;
+	size_t            i;
+
+	M_mem_set(&data, 0, sizeof(data));
+	data.pool = check_connect_pool();
+	data.el   = M_event_create(M_EVENT_FLAG_NONE);
+
+	if (M_sql_table_exists(data.pool, "bar")) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "DROP TABLE \"bar\"");
+		err  = M_sql_stmt_execute(data.pool, stmt);
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(DROP TABLE) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+		M_sql_stmt_destroy(stmt);
+	}
+
+	table = M_sql_table_create("bar");
+	ck_assert_msg(M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NOTNULL, "key", M_SQL_DATA_TYPE_INT64, 0, NULL), "M_sql_table_add_col(key) failed");
+	ck_assert_msg(M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NOTNULL, "val", M_SQL_DATA_TYPE_INT32, 0, NULL), "M_sql_table_add_col(val) failed");
+	ck_assert_msg(M_sql_table_add_pk_col(table, "key"), "M_sql_table_add_pk_col(key) failed");
+	err = M_sql_table_execute(data.pool, table, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_table_execute() failed: %s", error);
+	M_sql_table_destroy(table);
+
+	/* Group inserts are bound to the preparing thread. */
+	stmt = M_sql_stmt_groupinsert_prepare(data.pool, "INSERT INTO \"bar\" (\"key\", \"val\") VALUES (?, ?)");
+	ck_assert_msg(!M_sql_stmt_execute_async(data.pool, stmt, data.el, check_async_insert_cb, &data), "M_sql_stmt_execute_async() should reject group inserts");
+	M_sql_stmt_bind_int64(stmt, 0);
+	M_sql_stmt_bind_int32(stmt, 0);
+	err = M_sql_stmt_execute(data.pool, stmt);
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(group INSERT) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+	M_sql_stmt_destroy(stmt);
+
+	for (i=1; i<=ASYNC_ROWS; i++) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "INSERT INTO \"bar\" (\"key\", \"val\") VALUES (?, ?)");
+		M_sql_stmt_bind_int64(stmt, (M_int64)i);
+		M_sql_stmt_bind_int32(stmt, (M_int32)i);
+		ck_assert_msg(M_sql_stmt_execute_async(data.pool, stmt, data.el, check_async_insert_cb, &data), "M_sql_stmt_execute_async(INSERT %zu) failed", i);
+	}
+
+	/* Still running, can't be destroyed. */
+	ck_assert_msg(M_sql_connpool_destroy(data.pool) == M_SQL_ERROR_INUSE, "M_sql_connpool_destroy() should fail while requests are pending");
+
+	ck_assert_msg(M_event_loop(data.el, 30000) == M_EVENT_ERR_DONE, "event loop did not finish");
+
+	ck_assert_msg(data.failed == 0, "%zu async inserts failed", data.failed);
+	ck_assert_msg(data.count == ASYNC_ROWS + 1, "expected %d rows, got %lld", ASYNC_ROWS + 1, (long long)data.count);
+	ck_assert_msg(data.sum == (ASYNC_ROWS * (ASYNC_ROWS + 1)) / 2, "wrong sum %lld", (long long)data.sum);
+
+	M_sql_connpool_async_stats(data.pool, &queued, &running, &wait_avg_ms, &wait_max_ms);
+	ck_assert_msg(queued == 0 && running == 0, "expected no pending requests, have %zu queued and %zu running", queued, running);
+	ck_assert_msg(wait_avg_ms <= wait_max_ms, "average wait %llu greater than max %llu", (unsigned long long)wait_avg_ms, (unsigned long long)wait_max_ms);
+	ck_assert_msg(!M_sql_connpool_set_async_workers(data.pool, 4), "M_sql_connpool_set_async_workers() should fail after use");
+
+	ck_assert_msg(M_sql_connpool_destroy(data.pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+	M_event_destroy(data.el);
+
+	M_library_cleanup();
+}
+END_TEST
+
+#define BATCH_ROWS 10
+
+typedef struct {
+	M_int64       first_key;
+	M_int64       count;
+	M_sql_error_t stmt_err[BATCH_ROWS + 1];
+} check_batch_t;
+
+static M_sql_error_t check_batch_insert(M_sql_trans_t *trans, void *arg, char *error, size_t error_size)
+{
+	check_batch_t *data = arg;
+	M_sql_stmt_t  *stmts[BATCH_ROWS + 1];
+	M_sql_error_t  err;
+	size_t         i;
+
+	for (i=0; i<BATCH_ROWS; i++) {
+		stmts[i] = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmts[i], "INSERT INTO \"baz\" (\"key\", \"val\") VALUES (?, ?)");
+		M_sql_stmt_bind_int64(stmts[i], data->first_key + (M_int64)i);
+		M_sql_stmt_bind_int32(stmts[i], (M_int32)i);
+	}
+	stmts[BATCH_ROWS] = M_sql_stmt_create();
+	M_sql_stmt_prepare(stmts[BATCH_ROWS], "SELECT COUNT(*) FROM \"baz\"");
+
+	err = M_sql_trans_execute_batch(trans, stmts, BATCH_ROWS + 1);
+	if (err != M_SQL_ERROR_SUCCESS)
+		M_snprintf(error, error_size, "%s", M_sql_error_string(err));
+
+	for (i=0; i<BATCH_ROWS + 1; i++) {
+		data->stmt_err[i] = M_sql_stmt_get_error(stmts[i]);
+	}
+	if (data->stmt_err[BATCH_ROWS] == M_SQL_ERROR_SUCCESS)
+		data->count = M_sql_stmt_result_int64_direct(stmts[BATCH_ROWS], 0, 0);
+
+	for (i=0; i<BATCH_ROWS + 1; i++) {
+		M_sql_stmt_destroy(stmts[i]);
+	}
+
+	return err;
+}
+
+START_TEST(check_batch)
+{
+	M_sql_connpool_t *pool;
+	M_sql_error_t     err;
+	M_sql_table_t    *table;
+	M_sql_stmt_t     *stmt;
+	M_sql_trans_t    *trans;
+	M_sql_stmt_t     *stmts[2];
+	check_batch_t     data;
+	char              error[256];
+	size_t            i;
+
+	pool = check_connect_pool();
+
+	if (M_sql_table_exists(pool, "baz")) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "DROP TABLE \"baz\"");
+		err  = M_sql_stmt_execute(pool, stmt);
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(DROP TABLE) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+		M_sql_stmt_destroy(stmt);
+	}
+
+	table = M_sql_table_create("baz");
+	ck_assert_msg(M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NOTNULL, "key", M_SQL_DATA_TYPE_INT64, 0, NULL), "M_sql_table_add_col(key) failed");
+	ck_assert_msg(M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NOTNULL, "val", M_SQL_DATA_TYPE_INT32, 0, NULL), "M_sql_table_add_col(val) failed");
+	ck_assert_msg(M_sql_table_add_pk_col(table, "key"), "M_sql_table_add_pk_col(key) failed");
+	err = M_sql_table_execute(pool, table, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_table_execute() failed: %s", error);
+	M_sql_table_destroy(table);
+
+	/* Each statement gets its own result, including rows */
+	M_mem_set(&data, 0, sizeof(data));
+	data.first_key = 1;
+	err = M_sql_trans_process(pool, M_SQL_ISOLATION_SERIALIZABLE, check_batch_insert, &data, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "batch failed: %s", error);
+	for (i=0; i<BATCH_ROWS + 1; i++) {
+		ck_assert_msg(data.stmt_err[i] == M_SQL_ERROR_SUCCESS, "batch statement %zu failed: %s", i, M_sql_error_string(data.stmt_err[i]));
+	}
+	ck_assert_msg(data.count == BATCH_ROWS, "expected %d rows, got %lld", BATCH_ROWS, (long long)data.count);
+
+	/* Overlaps the existing keys from the second statement on, the failure is
+	 * reported on that statement, later ones aren't run and the batch rolls back */
+	M_mem_set(&data, 0, sizeof(data));
+	data.first_key = 0;
+	err = M_sql_trans_process(pool, M_SQL_ISOLATION_SERIALIZABLE, check_batch_insert, &data, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_QUERY_CONSTRAINT, "expected constraint failure, got %s: %s", M_sql_error_string(err), error);
+	ck_assert_msg(data.stmt_err[0] == M_SQL_ERROR_SUCCESS, "first statement should have succeeded: %s", M_sql_error_string(data.stmt_err[0]));
+	ck_assert_msg(data.stmt_err[1] == M_SQL_ERROR_QUERY_CONSTRAINT, "second statement should have conflicted: %s", M_sql_error_string(data.stmt_err[1]));
+	for (i=2; i<BATCH_ROWS + 1; i++) {
+		ck_assert_msg(data.stmt_err[i] == M_SQL_ERROR_QUERY_FAILURE, "statement %zu should not have executed: %s", i, M_sql_error_string(data.stmt_err[i]));
+	}
+
+	stmt = M_sql_stmt_create();
+	M_sql_stmt_prepare(stmt, "SELECT COUNT(*) FROM \"baz\"");
+	err = M_sql_stmt_execute(pool, stmt);
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(SELECT) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+	ck_assert_msg(M_sql_stmt_result_int64_direct(stmt, 0, 0) == BATCH_ROWS, "rolled back batch left rows behind");
+	M_sql_stmt_destroy(stmt);
+
+	/* Statements can't be left with rows to fetch */
+	err = M_sql_trans_begin(&trans, pool, M_SQL_ISOLATION_READCOMMITTED, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_trans_begin() failed: %s", error);
+	for (i=0; i<2; i++) {
+		stmts[i] = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmts[i], "SELECT \"key\" FROM \"baz\"");
+	}
+	M_sql_stmt_set_max_fetch_rows(stmts[1], 2);
+	err = M_sql_trans_execute_batch(trans, stmts, 2);
+	ck_assert_msg(err == M_SQL_ERROR_INVALID_USE, "expected invalid use, got %s", M_sql_error_string(err));
+	for (i=0; i<2; i++) {
+		M_sql_stmt_destroy(stmts[i]);
+	}
+	M_sql_trans_rollback(trans);
+
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	M_library_cleanup();
+}
+END_TEST
+
+/* Just enough of the PostgreSQL wire protocol to run the driver against, so its
+ * pipeline support is exercised without a real server.  Keys inserted into any
+ * table are tracked, SELECT COUNT(*) counts them and any other SELECT returns
+ * them.  Duplicate keys fail with a unique violation. */
+typedef struct {
+	M_io_t           *server;
+	volatile M_uint32 stop;
+	M_list_u64_t     *keys;          /*!< Committed keys */
+	M_list_u64_t     *trans_keys;    /*!< Keys inserted by the open transaction */
+	M_bool            in_trans;
+	M_bool            trans_failed;
+	M_hash_dict_t    *prepared;      /*!< Statement name to query */
+	char             *portal_query;  /*!< Query bound to the unnamed portal */
+	M_int64           portal_key;    /*!< First parameter bound to the unnamed portal */
+	M_bool            failed;        /*!< Skipping messages until the next sync */
+	size_t            executes;      /*!< Executions since the last sync */
+	size_t            max_pipelined; /*!< Most executions received before a sync */
+} check_pgsql_server_t;
+
+static void check_pgsql_msg(M_buf_t *out, char type, M_buf_t *payload)
+{
+	M_buf_add_byte(out, (unsigned char)type);
+	M_buf_add_uintbin(out, M_buf_len(payload) + 4, 4, M_ENDIAN_BIG);
+	M_buf_add_bytes(out, M_buf_peek(payload), M_buf_len(payload));
+	M_buf_truncate(payload, 0);
+}
+
+static const char *check_pgsql_str(const unsigned char *data, size_t len, size_t *pos)
+{
+	const char *str = (const char *)data + *pos;
+
+	if (*pos >= len || M_mem_chr(str, 0, len - *pos) == NULL)
+		return "";
+	*pos += M_str_len(str) + 1;
+	return str;
+}
+
+static M_int64 check_pgsql_int(const unsigned char *data, size_t len, size_t *pos, size_t width)
+{
+	M_uint64 val = 0;
+	size_t   i;
+
+	for (i=0; i<width && *pos < len; i++) {
+		val = (val << 8) | data[(*pos)++];
+	}
+	if (width == 2)
+		return (M_int16)val;
+	if (width == 4)
+		return (M_int32)val;
+	return (M_int64)val;
+}
+
+static void check_pgsql_ready(check_pgsql_server_t *srv, M_buf_t *out, M_buf_t *payload)
+{
+	M_buf_add_byte(payload, (unsigned char)(!srv->in_trans ? 'I' : srv->trans_failed ? 'E' : 'T'));
+	check_pgsql_msg(out, 'Z', payload);
+}
+
+static void check_pgsql_rowdesc(M_buf_t *out, M_buf_t *payload, const char *colname)
+{
+	M_buf_add_uintbin(payload, 1, 2, M_ENDIAN_BIG);
+	M_buf_add_str(payload, colname);
+	M_buf_add_byte(payload, 0);
+	M_buf_add_uintbin(payload, 0, 4, M_ENDIAN_BIG);           /* Table */
+	M_buf_add_uintbin(payload, 0, 2, M_ENDIAN_BIG);           /* Column */
+	M_buf_add_uintbin(payload, 20, 4, M_ENDIAN_BIG);          /* INT8OID */
+	M_buf_add_uintbin(payload, 8, 2, M_ENDIAN_BIG);           /* Size */
+	M_buf_add_uintbin(payload, 0xFFFFFFFF, 4, M_ENDIAN_BIG);  /* Modifier */
+	M_buf_add_uintbin(payload, 0, 2, M_ENDIAN_BIG);           /* Text */
+	check_pgsql_msg(out, 'T', payload);
+}
+
+static void check_pgsql_datarow(M_buf_t *out, M_buf_t *payload, M_uint64 val)
+{
+	char num[32];
+
+	M_snprintf(num, sizeof(num), "%llu", val);
+	M_buf_add_uintbin(payload, 1, 2, M_ENDIAN_BIG);
+	M_buf_add_uintbin(payload, M_str_len(num), 4, M_ENDIAN_BIG);
+	M_buf_add_str(payload, num);
+	check_pgsql_msg(out, 'D', payload);
+}
+
+static void check_pgsql_complete(M_buf_t *out, M_buf_t *payload, const char *tag)
+{
+	M_buf_add_str(payload, tag);
+	M_buf_add_byte(payload, 0);
+	check_pgsql_msg(out, 'C', payload);
+}
+
+static void check_pgsql_execute(check_pgsql_server_t *srv, M_buf_t *out, M_buf_t *payload)
+{
+	const char *query = srv->portal_query;
+	size_t      i;
+	char        tag[32];
+
+	srv->executes++;
+
+	if (M_str_caseeq_start(query, "INSERT")) {
+		if (M_list_u64_index_of(srv->keys, (M_uint64)srv->portal_key, NULL) || M_list_u64_index_of(srv->trans_keys, (M_uint64)srv->portal_key, NULL)) {
+			M_buf_add_str(payload, "SERROR");
+			M_buf_add_byte(payload, 0);
+			M_buf_add_str(payload, "C23505");
+			M_buf_add_byte(payload, 0);
+			M_buf_add_str(payload, "Mduplicate key value violates unique constraint");
+			M_buf_add_byte(payload, 0);
+			M_buf_add_byte(payload, 0);
+			check_pgsql_msg(out, 'E', payload);
+			srv->failed       = M_TRUE;
+			srv->trans_failed = srv->in_trans;
+			return;
+		}
+		M_list_u64_insert(srv->in_trans ? srv->trans_keys : srv->keys, (M_uint64)srv->portal_key);
+		check_pgsql_complete(out, payload, "INSERT 0 1");
+	} else if (M_str_caseeq_start(query, "SELECT COUNT")) {
+		check_pgsql_datarow(out, payload, M_list_u64_len(srv->keys) + M_list_u64_len(srv->trans_keys));
+		check_pgsql_complete(out, payload, "SELECT 1");
+	} else if (M_str_caseeq_start(query, "SELECT")) {
+		for (i=0; i<M_list_u64_len(srv->keys); i++) {
+			check_pgsql_datarow(out, payload, M_list_u64_at(srv->keys, i));
+		}
+		for (i=0; i<M_list_u64_len(srv->trans_keys); i++) {
+			check_pgsql_datarow(out, payload, M_list_u64_at(srv->trans_keys, i));
+		}
+		M_snprintf(tag, sizeof(tag), "SELECT %zu", M_list_u64_len(srv->keys) + M_list_u64_len(srv->trans_keys));
+		check_pgsql_complete(out, payload, tag);
+	} else if (M_str_caseeq_start(query, "BEGIN")) {
+		srv->in_trans = M_TRUE;
+		check_pgsql_complete(out, payload, "BEGIN");
+	} else if (M_str_caseeq_start(query, "COMMIT") || M_str_caseeq_start(query, "ROLLBACK")) {
+		/* Like a real server, committing a failed transaction rolls it back */
+		if (M_str_caseeq_start(query, "COMMIT") && !srv->trans_failed) {
+			M_list_u64_merge(&srv->keys, srv->trans_keys, M_FALSE);
+			check_pgsql_complete(out, payload, "COMMIT");
+		} else {
+			M_list_u64_destroy(srv->trans_keys);
+			check_pgsql_complete(out, payload, "ROLLBACK");
+		}
+		srv->trans_keys   = M_list_u64_create(M_LIST_U64_SORTASC);
+		srv->in_trans     = M_FALSE;
+		srv->trans_failed = M_FALSE;
+	} else {
+		check_pgsql_complete(out, payload, "SET");
+	}
+}
+
+/* Handles one complete message, returns M_FALSE if more data is needed. */
+static M_bool check_pgsql_message(check_pgsql_server_t *srv, M_parser_t *in, M_buf_t *out, M_bool *started, M_bool *done)
+{
+	M_buf_t       *payload = M_buf_create();
+	unsigned char *data;
+	unsigned char  type    = 0;
+	M_int64        len;
+	size_t         pos     = 0;
+	const char    *name;
+
+	/* Startup and encryption requests don't have a type byte */
+	if (!*started) {
+		if (M_parser_len(in) < 8)
+			goto more;
+		len = check_pgsql_int(M_parser_peek(in), 4, &pos, 4);
+		if (len < 8 || M_parser_len(in) < (size_t)len)
+			goto more;
+		M_parser_consume(in, 4);
+		len -= 4;
+		data = M_malloc((size_t)len);
+		M_parser_read_bytes(in, (size_t)len, data);
+		pos  = 0;
+		if (check_pgsql_int(data, (size_t)len, &pos, 4) != 196608) {
+			/* SSL and GSS encryption aren't supported */
+			M_buf_add_byte(out, 'N');
+		} else {
+			*started = M_TRUE;
+			M_buf_add_uintbin(payload, 0, 4, M_ENDIAN_BIG);
+			check_pgsql_msg(out, 'R', payload);
+			M_buf_add_bytes(payload, "server_version\0" "15.0\0", 20);
+			check_pgsql_msg(out, 'S', payload);
+			M_buf_add_bytes(payload, "client_encoding\0" "UTF8\0", 21);
+			check_pgsql_msg(out, 'S', payload);
+			M_buf_add_bytes(payload, "standard_conforming_strings\0" "on\0", 31);
+			check_pgsql_msg(out, 'S', payload);
+			M_buf_add_uintbin(payload, 1, 4, M_ENDIAN_BIG);
+			M_buf_add_uintbin(payload, 1, 4, M_ENDIAN_BIG);
+			check_pgsql_msg(out, 'K', payload);
+			check_pgsql_ready(srv, out, payload);
+		}
+		M_free(data);
+		M_buf_cancel(payload);
+		return M_TRUE;
+	}
+
+	if (M_parser_len(in) < 5)
+		goto more;
+	type = M_parser_peek(in)[0];
+	pos  = 1;
+	len  = check_pgsql_int(M_parser_peek(in), 5, &pos, 4);
+	if (len < 4 || M_parser_len(in) < (size_t)len + 1)
+		goto more;
+	M_parser_consume(in, 5);
+	len -= 4;
+	pos  = 0;
+	data = M_malloc_zero((size_t)len + 1);
+	M_parser_read_bytes(in, (size_t)len, data);
+
+	/* After an error everything up to the sync point is discarded */
+	if (srv->failed && type != 'S' && type != 'X') {
+		type = 0;
+	}
+
+	switch (type) {
+		case 'P': /* Parse */
+			name = check_pgsql_str(data, (size_t)len, &pos);
+			M_hash_dict_insert(srv->prepared, name, check_pgsql_str(data, (size_t)len, &pos));
+			check_pgsql_msg(out, '1', payload);
+			break;
+		case 'B': { /* Bind */
+			M_int64 num_fmts;
+			M_int64 fmt = 0;
+			M_int64 num_params;
+			M_int64 plen;
+
+			check_pgsql_str(data, (size_t)len, &pos);
+			name     = check_pgsql_str(data, (size_t)len, &pos);
+			num_fmts = check_pgsql_int(data, (size_t)len, &pos, 2);
+			if (num_fmts > 0) {
+				fmt  = check_pgsql_int(data, (size_t)len, &pos, 2);
+				pos += (size_t)(num_fmts - 1) * 2;
+			}
+			M_free(srv->portal_query);
+			srv->portal_query = M_strdup(M_hash_dict_get_direct(srv->prepared, name));
+			srv->portal_key   = 0;
+			num_params        = check_pgsql_int(data, (size_t)len, &pos, 2);
+			if (num_params > 0) {
+				plen = check_pgsql_int(data, (size_t)len, &pos, 4);
+				if (fmt == 1 && (plen == 2 || plen == 4 || plen == 8)) {
+					srv->portal_key = check_pgsql_int(data, (size_t)len, &pos, (size_t)plen);
+				} else if (plen > 0) {
+					srv->portal_key = M_str_to_int64((const char *)data + pos);
+				}
+			}
+			check_pgsql_msg(out, '2', payload);
+			break;
+		}
+		case 'D': /* Describe */
+			if (data[0] == 'S') {
+				pos  = 1;
+				name = M_hash_dict_get_direct(srv->prepared, check_pgsql_str(data, (size_t)len, &pos));
+				M_buf_add_uintbin(payload, 0, 2, M_ENDIAN_BIG);
+				check_pgsql_msg(out, 't', payload);
+			} else {
+				name = srv->portal_query;
+			}
+			if (M_str_caseeq_start(name, "SELECT COUNT")) {
+				check_pgsql_rowdesc(out, payload, "count");
+			} else if (M_str_caseeq_start(name, "SELECT")) {
+				check_pgsql_rowdesc(out, payload, "key");
+			} else {
+				check_pgsql_msg(out, 'n', payload);
+			}
+			break;
+		case 'E': /* Execute */
+			check_pgsql_execute(srv, out, payload);
+			break;
+		case 'C': /* Close */
+			check_pgsql_msg(out, '3', payload);
+			break;
+		case 'S': /* Sync */
+			if (srv->executes > srv->max_pipelined)
+				srv->max_pipelined = srv->executes;
+			srv->executes = 0;
+			srv->failed   = M_FALSE;
+			check_pgsql_ready(srv, out, payload);
+			break;
+		case 'Q': /* Simple query, only used for DEALLOCATE */
+			check_pgsql_complete(out, payload, "DEALLOCATE");
+			check_pgsql_ready(srv, out, payload);
+			break;
+		case 'X': /* Terminate */
+			*done = M_TRUE;
+			break;
+		default:
+			break;
+	}
+
+	M_free(data);
+	M_buf_cancel(payload);
+	return M_TRUE;
+
+more:
+	M_buf_cancel(payload);
+	return M_FALSE;
+}
+
+static void check_pgsql_serve(check_pgsql_server_t *srv, M_io_t *io)
+{
+	M_parser_t  *in      = M_parser_create(M_PARSER_FLAG_NONE);
+	M_buf_t     *out     = M_buf_create();
+	M_bool       started = M_FALSE;
+	M_bool       done    = M_FALSE;
+	M_io_error_t ioerr;
+
+	srv->prepared = M_hash_dict_create(16, 75, M_HASH_DICT_NONE);
+
+	if (M_io_block_connect(io) != M_IO_ERROR_SUCCESS)
+		done = M_TRUE;
+
+	while (!done) {
+		ioerr = M_io_block_read_into_parser(io, in, 50);
+		if (ioerr != M_IO_ERROR_SUCCESS && ioerr != M_IO_ERROR_WOULDBLOCK)
+			break;
+
+		while (!done && check_pgsql_message(srv, in, out, &started, &done))
+			;
+
+		while (M_buf_len(out) != 0) {
+			ioerr = M_io_block_write_from_buf(io, out, 50);
+			if (ioerr != M_IO_ERROR_SUCCESS && ioerr != M_IO_ERROR_WOULDBLOCK) {
+				done = M_TRUE;
+				break;
+			}
+		}
+	}
+
+	/* A transaction left open by a lost connection is rolled back */
+	M_list_u64_destroy(srv->trans_keys);
+	srv->trans_keys   = M_list_u64_create(M_LIST_U64_SORTASC);
+	srv->in_trans     = M_FALSE;
+	srv->trans_failed = M_FALSE;
+	srv->failed       = M_FALSE;
+	srv->executes     = 0;
+
+	M_io_destroy(io);
+	M_parser_destroy(in);
+	M_buf_cancel(out);
+	M_hash_dict_destroy(srv->prepared);
+	srv->prepared = NULL;
+	M_free(srv->portal_query);
+	srv->portal_query = NULL;
+}
+
+static void *check_pgsql_server_thread(void *arg)
+{
+	check_pgsql_server_t *srv = arg;
+	M_io_t               *io;
+
+	while (M_atomic_add_u32(&srv->stop, 0) == 0) {
+		if (M_io_block_accept(&io, srv->server, 50) == M_IO_ERROR_SUCCESS)
+			check_pgsql_serve(srv, io);
+	}
+	return NULL;
+}
+
+/* M_sql_trans_process() would retry a lost connection forever, run the batch
+ * directly so a driver failure is reported. */
+static M_sql_error_t check_pgsql_batch(M_sql_connpool_t *pool, check_batch_t *data, char *error, size_t error_size)
+{
+	M_sql_trans_t *trans;
+	M_sql_error_t  err;
+
+	err = M_sql_trans_begin(&trans, pool, M_SQL_ISOLATION_SERIALIZABLE, error, error_size);
+	if (err != M_SQL_ERROR_SUCCESS)
+		return err;
+
+	err = check_batch_insert(trans, data, error, error_size);
+	if (err != M_SQL_ERROR_SUCCESS) {
+		M_sql_trans_rollback(trans);
+		return err;
+	}
+
+	return M_sql_trans_commit(trans, error, error_size);
+}
+
+START_TEST(check_pgsql_pipeline)
+{
+	check_pgsql_server_t srv;
+	M_sql_connpool_t    *pool  = NULL;
+	M_thread_attr_t     *attr;
+	M_threadid_t         thread;
+	M_sql_error_t        err;
+	M_sql_trans_t       *trans;
+	M_sql_stmt_t        *stmts[2];
+	check_batch_t        data;
+	M_int64              sum   = 0;
+	char                 conn_str[64];
+	char                 error[256];
+	size_t               i;
+
+	M_mem_set(&srv, 0, sizeof(srv));
+	srv.keys       = M_list_u64_create(M_LIST_U64_SORTASC);
+	srv.trans_keys = M_list_u64_create(M_LIST_U64_SORTASC);
+	ck_assert(M_io_net_server_create(&srv.server, 0, "127.0.0.1", M_IO_NET_IPV4) == M_IO_ERROR_SUCCESS);
+
+	attr = M_thread_attr_create();
+	M_thread_attr_set_create_joinable(attr, M_TRUE);
+	thread = M_thread_create(attr, check_pgsql_server_thread, &srv);
+	M_thread_attr_destroy(attr);
+
+	/* The driver is optional, nothing to test if it wasn't built */
+	M_snprintf(conn_str, sizeof(conn_str), "host=127.0.0.1:%u;db=check", (unsigned int)M_io_net_get_port(srv.server));
+	err = M_sql_connpool_create(&pool, "postgresql", conn_str, "check", "check", 1, M_SQL_CONNPOOL_FLAG_PRESPAWN_ALL, error, sizeof(error));
+	if (err == M_SQL_ERROR_CONN_NODRIVER) {
+		M_printf("postgresql driver not available, skipping: %s\n", error);
+	} else {
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_connpool_create failed: %s: %s", M_sql_error_string(err), error);
+		check_start_pool(pool);
+
+		/* Prepares, executions and row results are all pipelined */
+		M_mem_set(&data, 0, sizeof(data));
+		data.first_key = 1;
+		err = check_pgsql_batch(pool, &data, error, sizeof(error));
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "batch failed: %s", error);
+		for (i=0; i<BATCH_ROWS + 1; i++) {
+			ck_assert_msg(data.stmt_err[i] == M_SQL_ERROR_SUCCESS, "batch statement %zu failed: %s", i, M_sql_error_string(data.stmt_err[i]));
+		}
+		ck_assert_msg(data.count == BATCH_ROWS, "expected %d rows, got %lld", BATCH_ROWS, (long long)data.count);
+		ck_assert_msg(srv.max_pipelined == BATCH_ROWS + 1, "expected %d pipelined executions, got %zu", BATCH_ROWS + 1, srv.max_pipelined);
+
+		/* Statements are already prepared this time */
+		M_mem_set(&data, 0, sizeof(data));
+		data.first_key = BATCH_ROWS + 1;
+		err = check_pgsql_batch(pool, &data, error, sizeof(error));
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "batch failed: %s", error);
+		ck_assert_msg(data.count == BATCH_ROWS * 2, "expected %d rows, got %lld", BATCH_ROWS * 2, (long long)data.count);
+
+		/* A failure is reported on its statement and the rest are skipped */
+		M_mem_set(&data, 0, sizeof(data));
+		data.first_key = 0;
+		err = check_pgsql_batch(pool, &data, error, sizeof(error));
+		ck_assert_msg(err == M_SQL_ERROR_QUERY_CONSTRAINT, "expected constraint failure, got %s: %s", M_sql_error_string(err), error);
+		ck_assert_msg(data.stmt_err[0] == M_SQL_ERROR_SUCCESS, "first statement should have succeeded: %s", M_sql_error_string(data.stmt_err[0]));
+		ck_assert_msg(data.stmt_err[1] == M_SQL_ERROR_QUERY_CONSTRAINT, "second statement should have conflicted: %s", M_sql_error_string(data.stmt_err[1]));
+		for (i=2; i<BATCH_ROWS + 1; i++) {
+			ck_assert_msg(data.stmt_err[i] == M_SQL_ERROR_QUERY_FAILURE, "statement %zu should not have executed: %s", i, M_sql_error_string(data.stmt_err[i]));
+		}
+
+		/* Multiple rows from a pipelined statement */
+		err = M_sql_trans_begin(&trans, pool, M_SQL_ISOLATION_READCOMMITTED, error, sizeof(error));
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_trans_begin() failed: %s", error);
+		stmts[0] = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmts[0], "SELECT \"key\" FROM \"baz\"");
+		stmts[1] = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmts[1], "SELECT COUNT(*) FROM \"baz\"");
+		err = M_sql_trans_execute_batch(trans, stmts, 2);
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "batch failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmts[0]));
+		ck_assert_msg(M_sql_stmt_result_num_rows(stmts[0]) == BATCH_ROWS * 2, "expected %d rows, got %zu", BATCH_ROWS * 2, M_sql_stmt_result_num_rows(stmts[0]));
+		for (i=0; i<M_sql_stmt_result_num_rows(stmts[0]); i++) {
+			sum += M_sql_stmt_result_int64_direct(stmts[0], i, 0);
+		}
+		ck_assert_msg(sum == (BATCH_ROWS * 2) * (BATCH_ROWS * 2 + 1) / 2, "unexpected keys returned");
+		ck_assert_msg(M_sql_stmt_result_int64_direct(stmts[1], 0, 0) == BATCH_ROWS * 2, "rolled back batch left rows behind");
+		for (i=0; i<2; i++) {
+			M_sql_stmt_destroy(stmts[i]);
+		}
+		ck_assert_msg(M_sql_trans_commit(trans, error, sizeof(error)) == M_SQL_ERROR_SUCCESS, "M_sql_trans_commit() failed: %s", error);
+
+		ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+	}
+
+	M_atomic_inc_u32(&srv.stop);
+	M_thread_join(thread, NULL);
+	M_io_destroy(srv.server);
+	M_list_u64_destroy(srv.keys);
+	M_list_u64_destroy(srv.trans_keys);
+
+	M_library_cleanup();
+}
+END_TEST
+
+#define BULKLOAD_ROWS 25000
+
+START_TEST(check_bulkload)
+{
+	M_sql_connpool_t *pool;
+	M_sql_error_t     err;
+	M_sql_table_t    *table;
+	M_sql_stmt_t     *stmt;
+	M_sql_bulkload_t *bulk;
+	char              error[256];
+	char              text[32];
+	M_uint64          rows;
+	M_uint64          elapsed_ms;
+	M_uint64          rows_per_sec;
+	M_int64           i;
+
+	pool = check_connect_pool();
+
+	if (M_sql_table_exists(pool, "bulk")) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "DROP TABLE \"bulk\"");
+		err  = M_sql_stmt_execute(pool, stmt);
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(DROP TABLE) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+		M_sql_stmt_destroy(stmt);
+	}
+
+	table = M_sql_table_create("bulk");
+	ck_assert_msg(M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NOTNULL, "key", M_SQL_DATA_TYPE_INT64, 0, NULL), "M_sql_table_add_col(key) failed");
+	ck_assert_msg(M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NONE, "name", M_SQL_DATA_TYPE_TEXT, 32, NULL), "M_sql_table_add_col(name) failed");
+	ck_assert_msg(M_sql_table_add_pk_col(table, "key"), "M_sql_table_add_pk_col(key) failed");
+	err = M_sql_table_execute(pool, table, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_table_execute() failed: %s", error);
+	M_sql_table_destroy(table);
+
+	bulk = M_sql_bulkload_create(pool, "bulk", 10000);
+	ck_assert_msg(M_sql_bulkload_stmt(bulk) == NULL, "statement should require columns");
+	ck_assert_msg(M_sql_bulkload_add_col(bulk, "key"), "M_sql_bulkload_add_col(key) failed");
+	ck_assert_msg(M_sql_bulkload_add_col(bulk, "name"), "M_sql_bulkload_add_col(name) failed");
+
+	for (i=1; i<=BULKLOAD_ROWS; i++) {
+		stmt = M_sql_bulkload_stmt(bulk);
+		ck_assert_msg(stmt != NULL, "M_sql_bulkload_stmt() failed");
+		M_sql_stmt_bind_int64(stmt, i);
+		if (i % 100 == 0) {
+			M_sql_stmt_bind_text_const(stmt, NULL, 0);
+		} else {
+			M_snprintf(text, sizeof(text), "row\t%lld", (long long)i);
+			M_sql_stmt_bind_text_dup(stmt, text, 0);
+		}
+		err = M_sql_bulkload_row_finish(bulk, error, sizeof(error));
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_bulkload_row_finish(%lld) failed: %s: %s", (long long)i, M_sql_error_string(err), error);
+
+		/* Incomplete rows are discarded */
+		if (i == 5) {
+			ck_assert_msg(!M_sql_bulkload_add_col(bulk, "other"), "columns can't be added after binding");
+			M_sql_stmt_bind_int64(M_sql_bulkload_stmt(bulk), BULKLOAD_ROWS + 1);
+			err = M_sql_bulkload_row_finish(bulk, error, sizeof(error));
+			ck_assert_msg(err == M_SQL_ERROR_INVALID_USE, "incomplete row should be rejected, got %s", M_sql_error_string(err));
+		}
+	}
+
+	/* Two batches committed so far, the rest waits for flush */
+	M_sql_bulkload_stats(bulk, &rows, NULL, NULL);
+	ck_assert_msg(rows == 20000, "expected 20000 committed rows, have %llu", (unsigned long long)rows);
+
+	err = M_sql_bulkload_flush(bulk, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_bulkload_flush() failed: %s: %s", M_sql_error_string(err), error);
+
+	M_sql_bulkload_stats(bulk, &rows, &elapsed_ms, &rows_per_sec);
+	ck_assert_msg(rows == BULKLOAD_ROWS, "expected %d committed rows, have %llu", BULKLOAD_ROWS, (unsigned long long)rows);
+	ck_assert_msg(rows_per_sec > 0, "rows/sec not calculated");
+	M_printf("Bulk loaded %llu rows in %llu ms (%llu rows/sec)\n", (unsigned long long)rows, (unsigned long long)elapsed_ms, (unsigned long long)rows_per_sec);
+	M_sql_bulkload_destroy(bulk);
+
+	stmt = M_sql_stmt_create();
+	M_sql_stmt_prepare(stmt, "SELECT COUNT(*), SUM(\"key\"), COUNT(\"name\") FROM \"bulk\"");
+	err = M_sql_stmt_execute(pool, stmt);
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(SELECT) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+	ck_assert_msg(M_sql_stmt_result_int64_direct(stmt, 0, 0) == BULKLOAD_ROWS, "wrong row count %lld", (long long)M_sql_stmt_result_int64_direct(stmt, 0, 0));
+	ck_assert_msg(M_sql_stmt_result_int64_direct(stmt, 0, 1) == ((M_int64)BULKLOAD_ROWS * (BULKLOAD_ROWS + 1)) / 2, "wrong key sum");
+	ck_assert_msg(M_sql_stmt_result_int64_direct(stmt, 0, 2) == BULKLOAD_ROWS - (BULKLOAD_ROWS / 100), "wrong non-NULL name count");
+	M_sql_stmt_destroy(stmt);
+
+	stmt = M_sql_stmt_create();
+	M_sql_stmt_prepare(stmt, "SELECT \"name\" FROM \"bulk\" WHERE \"key\" = ?");
+	M_sql_stmt_bind_int64(stmt, 42);
+	err = M_sql_stmt_execute(pool, stmt);
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(SELECT) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+	ck_assert_msg(M_str_eq(M_sql_stmt_result_text_direct(stmt, 0, 0), "row\t42"), "value not loaded intact: %s", M_sql_stmt_result_text_direct(stmt, 0, 0));
+	M_sql_stmt_destroy(stmt);
+
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	M_library_cleanup();
+}
+END_TEST
+
+#define AFFINITY_THREADS 8
+#define AFFINITY_QUERIES 50
+
+static M_uint64 check_affinity_acquires(M_sql_connpool_t *pool)
+{
+	M_uint64 hist[M_SQL_CONNPOOL_WAIT_BUCKETS];
+	M_uint64 total = 0;
+	size_t   i;
+
+	M_sql_connpool_acquire_stats(pool, M_FALSE, hist, NULL);
+	for (i=0; i<M_SQL_CONNPOOL_WAIT_BUCKETS; i++)
+		total += hist[i];
+	return total;
+}
+
+static void *check_affinity_thread(void *arg)
+{
+	M_sql_connpool_t *pool = arg;
+	M_sql_stmt_t     *stmt;
+	M_sql_error_t     err;
+	size_t            i;
+
+	for (i=0; i<AFFINITY_QUERIES; i++) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "SELECT COUNT(*) FROM \"foo\"");
+		err  = M_sql_stmt_execute(pool, stmt);
+		M_sql_stmt_destroy(stmt);
+		if (err != M_SQL_ERROR_SUCCESS)
+			return NULL;
+	}
+	return pool;
+}
+
+START_TEST(check_affinity)
+{
+	M_sql_connpool_t *pool;
+	M_threadid_t      threads[AFFINITY_THREADS];
+	M_thread_attr_t  *attr;
+	void             *rv;
+	M_uint64          hits;
+	M_uint64          acquires;
+	size_t            conns;
+	size_t            i;
+
+	pool = check_connect_pool();
+
+	/* Sequential use from one thread keeps reclaiming the connection it released */
+	acquires = check_affinity_acquires(pool);
+	ck_assert_msg(check_affinity_thread(pool) != NULL, "sequential queries failed");
+	M_sql_connpool_acquire_stats(pool, M_FALSE, NULL, &hits);
+	ck_assert_msg(hits >= AFFINITY_QUERIES - 1, "expected at least %d affinity hits, have %llu", AFFINITY_QUERIES - 1, (unsigned long long)hits);
+	ck_assert_msg(check_affinity_acquires(pool) - acquires == AFFINITY_QUERIES, "histogram doesn't account for every acquisition");
+
+	/* More threads than connections, parked connections must be taken over by waiters */
+	acquires = check_affinity_acquires(pool);
+	attr     = M_thread_attr_create();
+	M_thread_attr_set_create_joinable(attr, M_TRUE);
+	for (i=0; i<AFFINITY_THREADS; i++)
+		threads[i] = M_thread_create(attr, check_affinity_thread, pool);
+	M_thread_attr_destroy(attr);
+	for (i=0; i<AFFINITY_THREADS; i++) {
+		rv = NULL;
+		M_thread_join(threads[i], &rv);
+		ck_assert_msg(rv != NULL, "thread %zu queries failed", i);
+	}
+	ck_assert_msg(check_affinity_acquires(pool) - acquires == AFFINITY_THREADS * AFFINITY_QUERIES, "histogram doesn't account for every acquisition");
+
+	ck_assert_msg(M_sql_connpool_conn_utilization(pool, M_FALSE, 0) <= 100, "utilization out of range");
+	ck_assert_msg(M_sql_connpool_conn_utilization(pool, M_FALSE, 1000) == 0, "utilization of invalid id");
+
+	/* Parked connections don't count as in use */
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	/* A parked connection is idle, another thread takes it over rather than
+	 * establishing a new connection */
+	pool = check_create_pool_flags(M_SQL_CONNPOOL_FLAG_NONE);
+	check_start_pool(pool);
+	ck_assert_msg(check_affinity_thread(pool) != NULL, "sequential queries failed");
+	conns = M_sql_connpool_active_conns(pool, M_FALSE);
+	ck_assert_msg(M_sql_connpool_idle_conns(pool, M_FALSE) == conns, "expected all %zu connections idle, have %zu", conns, M_sql_connpool_idle_conns(pool, M_FALSE));
+
+	attr = M_thread_attr_create();
+	M_thread_attr_set_create_joinable(attr, M_TRUE);
+	threads[0] = M_thread_create(attr, check_affinity_thread, pool);
+	M_thread_attr_destroy(attr);
+	rv = NULL;
+	M_thread_join(threads[0], &rv);
+	ck_assert_msg(rv != NULL, "thread queries failed");
+	ck_assert_msg(M_sql_connpool_active_conns(pool, M_FALSE) == conns, "expected %zu connections, have %zu", conns, M_sql_connpool_active_conns(pool, M_FALSE));
+
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	M_library_cleanup();
+}
+END_TEST
+
+static void check_stmt_cache_exec(M_sql_connpool_t *pool, M_sql_stmt_t *stmt, const char *query)
+{
+	M_sql_error_t err;
+
+	if (query != NULL) {
+		M_sql_stmt_prepare(stmt, query);
+	} else {
+		M_sql_stmt_bind_clear(stmt);
+	}
+	M_sql_stmt_bind_int64(stmt, 1);
+	err = M_sql_stmt_execute(pool, stmt);
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute() failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+}
+
+START_TEST(check_stmt_cache)
+{
+	static const char * const queries[] = {
+		"SELECT COUNT(*) FROM \"foo\" WHERE \"key\" = ?",
+		"SELECT COUNT(*) FROM \"foo\" WHERE \"key\" > ?",
+		"SELECT COUNT(*) FROM \"foo\" WHERE \"key\" < ?",
+	};
+	M_sql_connpool_t *pool;
+	M_sql_stmt_t     *stmt;
+	M_uint64          hits;
+	M_uint64          misses;
+	M_uint64          evictions;
+	M_uint64          start_hits;
+	M_uint64          start_misses;
+	size_t            num_queries;
+	size_t            i;
+
+	/* Round robin over more queries than the cache holds never hits */
+	pool = check_create_pool();
+	ck_assert_msg(!M_sql_connpool_set_stmt_cache(pool, 2, 3), "prepare_hot larger than cache should be rejected");
+	ck_assert_msg(M_sql_connpool_set_stmt_cache(pool, 2, 0), "M_sql_connpool_set_stmt_cache() failed");
+	check_start_pool(pool);
+	ck_assert_msg(!M_sql_connpool_set_stmt_cache(pool, 4, 0), "cache can't be configured once started");
+
+	/* Drivers may run their own queries on connect */
+	M_sql_connpool_stmt_cache_stats(pool, &start_hits, &start_misses, NULL, NULL);
+	for (i=0; i<15; i++) {
+		stmt = M_sql_stmt_create();
+		check_stmt_cache_exec(pool, stmt, queries[i % 3]);
+		M_sql_stmt_destroy(stmt);
+	}
+	M_sql_connpool_stmt_cache_stats(pool, &hits, &misses, &evictions, &num_queries);
+	ck_assert_msg(hits == start_hits, "expected no hits, have %llu", (unsigned long long)(hits - start_hits));
+	ck_assert_msg(misses - start_misses == 15, "expected 15 misses, have %llu", (unsigned long long)(misses - start_misses));
+	ck_assert_msg(evictions >= 12, "expected at least 12 evictions, have %llu", (unsigned long long)evictions);
+	ck_assert_msg(num_queries >= 3, "expected at least 3 distinct queries, have %zu", num_queries);
+
+	/* A reused handle keeps its id, and stays cached */
+	stmt = M_sql_stmt_create();
+	check_stmt_cache_exec(pool, stmt, queries[0]);
+	for (i=0; i<10; i++)
+		check_stmt_cache_exec(pool, stmt, NULL);
+	M_sql_stmt_destroy(stmt);
+	M_sql_connpool_stmt_cache_stats(pool, &hits, NULL, NULL, NULL);
+	ck_assert_msg(hits - start_hits >= 9, "expected at least 9 hits, have %llu", (unsigned long long)(hits - start_hits));
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	/* New connections prepare the most used query up front */
+	pool = check_create_pool();
+	ck_assert_msg(M_sql_connpool_set_stmt_cache(pool, 4, 1), "M_sql_connpool_set_stmt_cache() failed");
+	check_start_pool(pool);
+
+	for (i=0; i<10; i++) {
+		stmt = M_sql_stmt_create();
+		check_stmt_cache_exec(pool, stmt, queries[i == 0?1:0]);
+		M_sql_stmt_destroy(stmt);
+	}
+
+	/* Idle out every connection */
+	M_sql_connpool_set_timeouts(pool, -1, 1, -1);
+	M_thread_sleep(2100000);
+	M_sql_connpool_stmt_cache_stats(pool, &start_hits, &start_misses, NULL, NULL);
+
+	stmt = M_sql_stmt_create();
+	check_stmt_cache_exec(pool, stmt, queries[0]);
+	M_sql_stmt_destroy(stmt);
+
+	M_sql_connpool_stmt_cache_stats(pool, &hits, &misses, NULL, NULL);
+	ck_assert_msg(hits == start_hits + 1 && misses == start_misses, "hot query not prepared on new connection (hits %llu, misses %llu)",
+		(unsigned long long)(hits - start_hits), (unsigned long long)(misses - start_misses));
+
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	M_library_cleanup();
+}
+END_TEST
+
+static char *check_result_cache_get(M_sql_connpool_t *pool, M_int64 key, M_uint64 ttl_ms)
+{
+	M_sql_error_t  err;
+	M_sql_stmt_t  *stmt = M_sql_stmt_create();
+	char          *val  = NULL;
+
+	M_sql_stmt_prepare(stmt, "SELECT \"val\" FROM \"rcache\" WHERE \"key\" = ?");
+	M_sql_stmt_bind_int64(stmt, key);
+	M_sql_stmt_set_result_cache(stmt, ttl_ms, "rcache");
+	err = M_sql_stmt_execute(pool, stmt);
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute() failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+	ck_assert_msg(M_sql_stmt_result_num_cols(stmt) == 1, "expected 1 column, have %zu", M_sql_stmt_result_num_cols(stmt));
+	ck_assert_msg(M_str_eq(M_sql_stmt_result_col_name(stmt, 0), "val"), "unexpected column name %s", M_sql_stmt_result_col_name(stmt, 0));
+
+	if (M_sql_stmt_result_num_rows(stmt) != 0)
+		val = M_strdup(M_sql_stmt_result_text_byname_direct(stmt, 0, "val"));
+	M_sql_stmt_destroy(stmt);
+	return val;
+}
+
+static void check_result_cache_expect(M_sql_connpool_t *pool, M_int64 key, M_uint64 ttl_ms, const char *val, M_bool hit)
+{
+	M_uint64  hits;
+	M_uint64  misses;
+	M_uint64  new_hits;
+	M_uint64  new_misses;
+	char     *out;
+
+	M_sql_connpool_result_cache_stats(pool, &hits, &misses, NULL, NULL);
+	out = check_result_cache_get(pool, key, ttl_ms);
+	M_sql_connpool_result_cache_stats(pool, &new_hits, &new_misses, NULL, NULL);
+
+	ck_assert_msg(M_str_eq(out, val), "key %lld: expected '%s', have '%s'", key, val, out);
+	ck_assert_msg(new_hits == hits + (hit?1:0) && new_misses == misses + (hit?0:1), "key %lld: expected %s", key, hit?"hit":"miss");
+	M_free(out);
+}
+
+static void check_result_cache_update(M_sql_connpool_t *pool, const char *val)
+{
+	M_sql_error_t  err;
+	M_sql_stmt_t  *stmt = M_sql_stmt_create();
+
+	M_sql_stmt_prepare(stmt, "UPDATE \"rcache\" SET \"val\" = ? WHERE \"key\" = 1");
+	M_sql_stmt_bind_text_const(stmt, val, 0);
+	err = M_sql_stmt_execute(pool, stmt);
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(UPDATE) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+	M_sql_stmt_destroy(stmt);
+}
+
+START_TEST(check_result_cache)
+{
+	M_sql_error_t     err;
+	M_sql_connpool_t *pool;
+	M_sql_table_t    *table;
+	M_sql_stmt_t     *stmt;
+	M_sql_trans_t    *trans  = NULL;
+	M_hash_dict_t    *dict;
+	M_int64           id     = 0;
+	M_uint64          hits;
+	M_uint64          misses;
+	size_t            entries;
+	size_t            bytes;
+	char              error[256];
+	M_sql_tabledata_t td[] = {
+		{ "key", "id",  0,  M_SQL_DATA_TYPE_INT64, M_SQL_TABLEDATA_FLAG_ID|M_SQL_TABLEDATA_FLAG_ID_REQUIRED, NULL, NULL },
+		{ "val", "val", 32, M_SQL_DATA_TYPE_TEXT,  M_SQL_TABLEDATA_FLAG_EDITABLE,                            NULL, NULL }
+	};
+
+	pool = check_connect_pool();
+
+	if (M_sql_table_exists(pool, "rcache")) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "DROP TABLE \"rcache\"");
+		err  = M_sql_stmt_execute(pool, stmt);
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(DROP TABLE) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+		M_sql_stmt_destroy(stmt);
+	}
+
+	table = M_sql_table_create("rcache");
+	M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NONE, "key", M_SQL_DATA_TYPE_INT64, 0,  NULL);
+	M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NONE, "val", M_SQL_DATA_TYPE_TEXT,  32, NULL);
+	M_sql_table_add_pk_col(table, "key");
+	err = M_sql_table_execute(pool, table, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_table_execute() failed: %s", error);
+	M_sql_table_destroy(table);
+
+	dict = M_hash_dict_create(16, 75, M_HASH_DICT_CASECMP);
+	M_hash_dict_insert(dict, "id", "1");
+	M_hash_dict_insert(dict, "val", "one");
+	err = M_sql_tabledata_add(pool, "rcache", td, sizeof(td)/sizeof(*td), fetch_dict, NULL, dict, &id, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_tabledata_add() failed: %s", error);
+
+	/* Disabled by default */
+	M_free(check_result_cache_get(pool, 1, 60000));
+	M_sql_connpool_result_cache_stats(pool, &hits, &misses, &entries, NULL);
+	ck_assert_msg(hits == 0 && misses == 0 && entries == 0, "cache should be disabled by default");
+
+	ck_assert_msg(M_sql_connpool_set_result_cache(pool, 1024 * 1024), "M_sql_connpool_set_result_cache() failed");
+	check_result_cache_expect(pool, 1, 60000, "one", M_FALSE);
+	check_result_cache_expect(pool, 1, 60000, "one", M_TRUE);
+	check_result_cache_expect(pool, 2, 60000, NULL,  M_FALSE);
+	check_result_cache_expect(pool, 2, 60000, NULL,  M_TRUE);
+
+	/* Changes made without the tabledata functions aren't seen until invalidated */
+	check_result_cache_update(pool, "uno");
+	check_result_cache_expect(pool, 1, 60000, "one", M_TRUE);
+	M_sql_connpool_result_cache_invalidate(pool, "RCACHE");
+	check_result_cache_expect(pool, 1, 60000, "uno", M_FALSE);
+	check_result_cache_expect(pool, 1, 60000, "uno", M_TRUE);
+
+	/* Only invalidated if the transaction commits */
+	err = M_sql_trans_begin(&trans, pool, M_SQL_ISOLATION_READCOMMITTED, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_trans_begin() failed: %s", error);
+	M_sql_trans_result_cache_invalidate(trans, "rcache");
+	M_sql_trans_rollback(trans);
+	check_result_cache_expect(pool, 1, 60000, "uno", M_TRUE);
+
+	/* Tabledata invalidates automatically */
+	M_hash_dict_remove(dict, "val");
+	M_hash_dict_insert(dict, "val", "eins");
+	err = M_sql_tabledata_edit(pool, "rcache", td, sizeof(td)/sizeof(*td), fetch_dict, NULL, dict, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_tabledata_edit() failed: %s", error);
+	check_result_cache_expect(pool, 1, 60000, "eins", M_FALSE);
+	check_result_cache_expect(pool, 2, 60000, NULL,   M_FALSE);
+
+	/* Expiry */
+	M_sql_connpool_result_cache_invalidate(pool, NULL);
+	check_result_cache_expect(pool, 1, 50, "eins", M_FALSE);
+	check_result_cache_expect(pool, 1, 50, "eins", M_TRUE);
+	M_thread_sleep(100000);
+	check_result_cache_expect(pool, 1, 50, "eins", M_FALSE);
+
+	/* Results larger than the limit aren't kept */
+	M_sql_connpool_result_cache_stats(pool, NULL, NULL, &entries, &bytes);
+	ck_assert_msg(entries == 1 && bytes > 0, "expected 1 entry, have %zu (%zu bytes)", entries, bytes);
+	M_sql_connpool_set_result_cache(pool, bytes - 1);
+	M_sql_connpool_result_cache_stats(pool, NULL, NULL, &entries, &bytes);
+	ck_assert_msg(entries == 0 && bytes == 0, "expected no entries, have %zu (%zu bytes)", entries, bytes);
+	check_result_cache_expect(pool, 1, 60000, "eins", M_FALSE);
+	check_result_cache_expect(pool, 1, 60000, "eins", M_FALSE);
+
+	M_hash_dict_destroy(dict);
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	M_library_cleanup();
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static M_int64 check_tabledata_bulk_count(M_sql_connpool_t *pool, const char *where)
+{
+	M_sql_stmt_t *stmt;
+	M_buf_t      *query = M_buf_create();
+	M_int64       cnt   = -1;
+
+	M_buf_add_str(query, "SELECT COUNT(*) FROM \"bulkdata\"");
+	M_buf_add_str(query, where);
+	stmt = M_sql_stmt_create();
+	M_sql_stmt_prepare_buf(stmt, query);
+	ck_assert_msg(M_sql_stmt_execute(pool, stmt) == M_SQL_ERROR_SUCCESS, "count failed: %s", M_sql_stmt_get_error_string(stmt));
+	M_sql_stmt_result_int64(stmt, 0, 0, &cnt);
+	M_sql_stmt_destroy(stmt);
+	return cnt;
+}
+
+
+START_TEST(check_tabledata_bulk)
+{
+	M_sql_error_t                 err;
+	M_sql_connpool_t             *pool;
+	M_sql_table_t                *table;
+	M_sql_stmt_t                 *stmt;
+	M_hash_dict_t                *dicts[250];
+	M_sql_tabledata_bulk_batch_t *batches     = NULL;
+	size_t                        num_batches = 0;
+	size_t                        i;
+	char                          error[256];
+	M_sql_tabledata_t             td[] = {
+		{ "key", "id",  0,  M_SQL_DATA_TYPE_INT64, M_SQL_TABLEDATA_FLAG_ID|M_SQL_TABLEDATA_FLAG_ID_REQUIRED, NULL, NULL },
+		{ "val", "val", 32, M_SQL_DATA_TYPE_TEXT,  M_SQL_TABLEDATA_FLAG_EDITABLE,                            NULL, NULL }
+	};
+
+	pool = check_connect_pool();
+
+	if (M_sql_table_exists(pool, "bulkdata")) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "DROP TABLE \"bulkdata\"");
+		err  = M_sql_stmt_execute(pool, stmt);
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(DROP TABLE) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+		M_sql_stmt_destroy(stmt);
+	}
+
+	table = M_sql_table_create("bulkdata");
+	ck_assert(M_sql_tabledata_to_table(table, td, sizeof(td)/sizeof(*td)));
+	M_sql_table_add_pk_col(table, "key");
+	err = M_sql_table_execute(pool, table, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_table_execute() failed: %s", error);
+	M_sql_table_destroy(table);
+
+	for (i=0; i<sizeof(dicts)/sizeof(*dicts); i++) {
+		char id[32];
+
+		M_snprintf(id, sizeof(id), "%zu", i + 1);
+		dicts[i] = M_hash_dict_create(8, 75, M_HASH_DICT_CASECMP);
+		M_hash_dict_insert(dicts[i], "id", id);
+		M_hash_dict_insert(dicts[i], "val", "add");
+	}
+
+	/* A duplicate id fails only the batch it lands in.  Duplicate an id from
+	 * within the same batch so the result doesn't depend on batch ordering. */
+	M_hash_dict_insert(dicts[120], "id", "101");
+	err = M_sql_tabledata_bulk(pool, M_SQL_TABLEDATA_BULK_ADD, "bulkdata", td, sizeof(td)/sizeof(*td), fetch_dict, NULL,
+		(void * const *)dicts, sizeof(dicts)/sizeof(*dicts), 100, 2, &batches, &num_batches, error, sizeof(error));
+	ck_assert_msg(M_sql_error_is_error(err), "bulk add with duplicate should fail");
+	ck_assert_msg(num_batches == 3, "expected 3 batches, got %zu", num_batches);
+	ck_assert_msg(batches[0].err == M_SQL_ERROR_SUCCESS && batches[2].err == M_SQL_ERROR_SUCCESS, "unaffected batches should succeed");
+	ck_assert_msg(M_sql_error_is_error(batches[1].err) && batches[1].failed_record == 120, "batch 1 should fail at record 120, got %zu: %s", batches[1].failed_record, batches[1].error);
+	ck_assert_msg(batches[2].first_record == 200 && batches[2].num_records == 50, "unexpected batch range");
+	M_free(batches);
+	ck_assert_msg(check_tabledata_bulk_count(pool, "") == 150, "expected 150 rows");
+
+	/* Upsert fills in the missing batch and updates the rest */
+	M_hash_dict_insert(dicts[120], "id", "121");
+	for (i=0; i<sizeof(dicts)/sizeof(*dicts); i++) {
+		M_hash_dict_insert(dicts[i], "val", "upsert");
+	}
+	err = M_sql_tabledata_bulk(pool, M_SQL_TABLEDATA_BULK_UPSERT, "bulkdata", td, sizeof(td)/sizeof(*td), fetch_dict, NULL,
+		(void * const *)dicts, sizeof(dicts)/sizeof(*dicts), 0, 2, NULL, NULL, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "bulk upsert failed: %s", error);
+	ck_assert_msg(check_tabledata_bulk_count(pool, " WHERE \"val\" = 'upsert'") == 250, "expected 250 upserted rows");
+
+	for (i=0; i<sizeof(dicts)/sizeof(*dicts); i++) {
+		M_hash_dict_destroy(dicts[i]);
+	}
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	M_library_cleanup();
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void check_native_result_verify(M_sql_stmt_t *stmt)
+{
+	M_int64     i64;
+	M_int32     i32;
+	M_bool      b;
+	M_bool      is_null;
+	const char *text;
+
+	ck_assert_msg(M_sql_stmt_result_num_rows(stmt) == 2, "expected 2 rows, got %zu", M_sql_stmt_result_num_rows(stmt));
+
+	ck_assert(M_sql_stmt_result_int64(stmt, 0, 0, &i64) == M_SQL_ERROR_SUCCESS && i64 == 5000000000LL);
+	ck_assert(M_sql_stmt_result_int32(stmt, 0, 0, &i32) == M_SQL_ERROR_INVALID_TYPE);
+	ck_assert(M_sql_stmt_result_text(stmt, 0, 0, &text) == M_SQL_ERROR_SUCCESS && M_str_eq(text, "5000000000"));
+	ck_assert(M_sql_stmt_result_text(stmt, 1, 0, &text) == M_SQL_ERROR_SUCCESS && M_str_eq(text, "-7"));
+	ck_assert(M_sql_stmt_result_int32(stmt, 1, 0, &i32) == M_SQL_ERROR_SUCCESS && i32 == -7);
+
+	ck_assert(M_sql_stmt_result_bool(stmt, 0, 1, &b) == M_SQL_ERROR_SUCCESS && b == M_TRUE);
+	ck_assert(M_sql_stmt_result_bool(stmt, 1, 1, &b) == M_SQL_ERROR_SUCCESS && b == M_FALSE);
+	ck_assert(M_sql_stmt_result_bool(stmt, 0, 0, &b) == M_SQL_ERROR_INVALID_TYPE);
+
+	ck_assert(M_sql_stmt_result_isnull(stmt, 0, 2, &is_null) == M_SQL_ERROR_SUCCESS && !is_null);
+	ck_assert(M_sql_stmt_result_isnull(stmt, 1, 2, &is_null) == M_SQL_ERROR_SUCCESS && is_null);
+	ck_assert(M_sql_stmt_result_int32(stmt, 1, 2, &i32) == M_SQL_ERROR_SUCCESS && i32 == 0);
+	ck_assert(M_sql_stmt_result_text(stmt, 0, 3, &text) == M_SQL_ERROR_SUCCESS && M_str_eq(text, "a"));
+}
+
+
+START_TEST(check_native_result)
+{
+	M_sql_error_t     err;
+	M_sql_connpool_t *pool;
+	M_sql_table_t    *table;
+	M_sql_stmt_t     *stmt;
+	M_uint64          hits;
+	size_t            i;
+	char              error[256];
+
+	pool = check_connect_pool();
+
+	if (M_sql_table_exists(pool, "nativeint")) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "DROP TABLE \"nativeint\"");
+		err  = M_sql_stmt_execute(pool, stmt);
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(DROP TABLE) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+		M_sql_stmt_destroy(stmt);
+	}
+
+	table = M_sql_table_create("nativeint");
+	M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NONE, "big",   M_SQL_DATA_TYPE_INT64, 0,  NULL);
+	M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NONE, "flag",  M_SQL_DATA_TYPE_BOOL,  0,  NULL);
+	M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NONE, "small", M_SQL_DATA_TYPE_INT32, 0,  NULL);
+	M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NONE, "name",  M_SQL_DATA_TYPE_TEXT,  16, NULL);
+	M_sql_table_add_pk_col(table, "big");
+	err = M_sql_table_execute(pool, table, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_table_execute() failed: %s", error);
+	M_sql_table_destroy(table);
+
+	stmt = M_sql_stmt_create();
+	M_sql_stmt_prepare(stmt, "INSERT INTO \"nativeint\" (\"big\", \"flag\", \"small\", \"name\") VALUES (?, ?, ?, ?)");
+	M_sql_stmt_bind_int64(stmt, 5000000000LL);
+	M_sql_stmt_bind_bool(stmt, M_TRUE);
+	M_sql_stmt_bind_int32(stmt, 1);
+	M_sql_stmt_bind_text_const(stmt, "a", 0);
+	M_sql_stmt_bind_new_row(stmt);
+	M_sql_stmt_bind_int64(stmt, -7);
+	M_sql_stmt_bind_bool(stmt, M_FALSE);
+	M_sql_stmt_bind_int32_null(stmt);
+	M_sql_stmt_bind_text_const(stmt, "b", 0);
+	err = M_sql_stmt_execute(pool, stmt);
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "insert failed: %s", M_sql_stmt_get_error_string(stmt));
+	M_sql_stmt_destroy(stmt);
+
+	/* Second pass is served from the result cache */
+	ck_assert(M_sql_connpool_set_result_cache(pool, 1024 * 1024));
+	for (i=0; i<2; i++) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "SELECT \"big\", \"flag\", \"small\", \"name\" FROM \"nativeint\" ORDER BY \"big\" DESC");
+		M_sql_stmt_set_result_cache(stmt, 60000, "nativeint");
+		err = M_sql_stmt_execute(pool, stmt);
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "select failed: %s", M_sql_stmt_get_error_string(stmt));
+		check_native_result_verify(stmt);
+		M_sql_stmt_destroy(stmt);
+	}
+	M_sql_connpool_result_cache_stats(pool, &hits, NULL, NULL, NULL);
+	ck_assert_msg(hits == 1, "expected 1 cache hit, got %llu", hits);
+
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	M_library_cleanup();
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static void check_profile_exec(M_sql_connpool_t *pool, const char *query)
+{
+	M_sql_stmt_t *stmt = M_sql_stmt_create();
+
+	M_sql_stmt_prepare(stmt, query);
+	ck_assert_msg(M_sql_stmt_execute(pool, stmt) == M_SQL_ERROR_SUCCESS, "%s failed: %s", query, M_sql_stmt_get_error_string(stmt));
+	M_sql_stmt_destroy(stmt);
+}
+
+
+START_TEST(check_profile)
+{
+	M_sql_error_t     err;
+	M_sql_connpool_t *pool;
+	M_sql_table_t    *table;
+	M_sql_stmt_t     *stmt;
+	M_table_t        *prof;
+	M_json_node_t    *json;
+	char             *out;
+	M_int64           val;
+	M_uint64          dropped;
+	size_t            col;
+	size_t            i;
+	char              error[256];
+
+	pool = check_connect_pool();
+
+	if (M_sql_table_exists(pool, "prof")) {
+		stmt = M_sql_stmt_create();
+		M_sql_stmt_prepare(stmt, "DROP TABLE \"prof\"");
+		err  = M_sql_stmt_execute(pool, stmt);
+		ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_stmt_execute(DROP TABLE) failed: %s: %s", M_sql_error_string(err), M_sql_stmt_get_error_string(stmt));
+		M_sql_stmt_destroy(stmt);
+	}
+
+	table = M_sql_table_create("prof");
+	M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NONE, "key", M_SQL_DATA_TYPE_INT64, 0,  NULL);
+	M_sql_table_add_col(table, M_SQL_TABLE_COL_FLAG_NONE, "val", M_SQL_DATA_TYPE_TEXT,  32, NULL);
+	M_sql_table_add_pk_col(table, "key");
+	err = M_sql_table_execute(pool, table, error, sizeof(error));
+	ck_assert_msg(err == M_SQL_ERROR_SUCCESS, "M_sql_table_execute() failed: %s", error);
+	M_sql_table_destroy(table);
+
+	/* Disabled by default */
+	check_profile_exec(pool, "INSERT INTO \"prof\" (\"key\", \"val\") VALUES (1, 'one')");
+	prof = M_sql_connpool_profile_table(pool, NULL);
+	ck_assert_msg(M_table_row_count(prof) == 0, "profiler should be disabled by default");
+	M_table_destroy(prof);
+
+	/* Literals are normalized so these are the same query */
+	ck_assert(M_sql_connpool_set_profile(pool, 16));
+	check_profile_exec(pool, "INSERT INTO \"prof\" (\"key\", \"val\") VALUES (2, 'two')");
+	check_profile_exec(pool, "INSERT INTO \"prof\" (\"key\", \"val\") VALUES (3, 'it''s three')");
+	for (i=0; i<3; i++) {
+		check_profile_exec(pool, "SELECT \"key\", \"val\" FROM \"prof\" WHERE \"key\" >= 1");
+	}
+
+	prof = M_sql_connpool_profile_table(pool, &dropped);
+	ck_assert_msg(M_table_row_count(prof) == 2, "expected 2 profiled queries, got %zu", M_table_row_count(prof));
+	ck_assert_msg(dropped == 0, "nothing should be dropped");
+	for (i=0; i<M_table_row_count(prof); i++) {
+		const char *query = M_table_cell(prof, i, "query");
+
+		if (M_str_eq(query, "INSERT INTO \"prof\" (\"key\", \"val\") VALUES (?, ?)")) {
+			ck_assert(M_table_column_idx(prof, "count", &col) && M_table_cell_int64_at(prof, i, col, &val) && val == 2);
+		} else if (M_str_eq(query, "SELECT \"key\", \"val\" FROM \"prof\" WHERE \"key\" >= ?")) {
+			ck_assert(M_table_column_idx(prof, "count", &col) && M_table_cell_int64_at(prof, i, col, &val) && val == 3);
+			ck_assert(M_table_column_idx(prof, "rows", &col) && M_table_cell_int64_at(prof, i, col, &val) && val == 9);
+			ck_assert(M_table_column_idx(prof, "bytes", &col) && M_table_cell_int64_at(prof, i, col, &val) && val > 0);
+			ck_assert(M_table_column_idx(prof, "errors", &col) && M_table_cell_int64_at(prof, i, col, &val) && val == 0);
+		} else {
+			ck_abort_msg("unexpected query: %s", query);
+		}
+	}
+	M_table_destroy(prof);
+
+	out  = M_sql_connpool_profile_json(pool, M_JSON_WRITER_NONE);
+	json = M_json_read(out, M_str_len(out), M_JSON_READER_NONE, NULL, NULL, NULL, NULL);
+	ck_assert_msg(json != NULL && M_json_array_len(json) == 2, "invalid profile json: %s", out);
+	ck_assert(M_json_node_type(M_json_object_value(M_json_array_at(json, 0), "count")) == M_JSON_TYPE_INTEGER);
+	M_json_node_destroy(json);
+	M_free(out);
+
+	/* Queries beyond the limit are dropped */
+	M_sql_connpool_profile_reset(pool);
+	ck_assert(M_sql_connpool_set_profile(pool, 1));
+	check_profile_exec(pool, "SELECT COUNT(*) FROM \"prof\"");
+	check_profile_exec(pool, "SELECT \"val\" FROM \"prof\"");
+	prof = M_sql_connpool_profile_table(pool, &dropped);
+	ck_assert_msg(M_table_row_count(prof) == 1 && dropped == 1, "expected 1 query and 1 dropped, got %zu and %llu", M_table_row_count(prof), dropped);
+	M_table_destroy(prof);
+
+	ck_assert_msg(M_sql_connpool_destroy(pool) == M_SQL_ERROR_SUCCESS, "M_sql_connpool_destroy() failed");
+
+	M_library_cleanup();
+}
+END_TEST
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 static Suite *sql_suite(void)
@@ -714,6 +2251,16 @@ static Suite *sql_suite(void)
 	tcase_set_timeout(tc, 30);
 	tcase_add_test(tc, check_sql);
 	tcase_add_test(tc, check_tabledata);
+	tcase_add_test(tc, check_async);
+	tcase_add_test(tc, check_batch);
+	tcase_add_test(tc, check_pgsql_pipeline);
+	tcase_add_test(tc, check_bulkload);
+	tcase_add_test(tc, check_affinity);
+	tcase_add_test(tc, check_stmt_cache);
+	tcase_add_test(tc, check_result_cache);
+	tcase_add_test(tc, check_native_result);
+	tcase_add_test(tc, check_tabledata_bulk);
+	tcase_add_test(tc, check_profile);
 	suite_add_tcase(suite, tc);
 
 	return suite;
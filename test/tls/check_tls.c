@@ -1,6 +1,9 @@
 #include "m_config.h"
 #include <stdlib.h>
 #include <check.h>
+#ifdef __linux__
+#  include <unistd.h>
+#endif
 
 #include <mstdlib/mstdlib.h>
 #include <mstdlib/mstdlib_thread.h>
@@ -901,6 +904,217 @@ START_TEST(check_tls_sendanddisconnect)
 END_TEST
 
 
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#define KTLS_DATA_SIZE ((256 * 1024) + 7)
+
+typedef struct {
+	M_io_t        *listener;
+	unsigned char *data;          /* What the server sends */
+	int            fd;            /* File with the same contents for sendfile, -1 if unavailable */
+	size_t         sent;
+	M_buf_t       *received;
+	M_tls_ktls_t   server_ktls;
+	M_bool         used_sendfile;
+	M_bool         failed;
+} ktls_test_t;
+
+/* The kernel lists the tls ULP once its module is loaded */
+static M_bool ktls_kernel_loaded(void)
+{
+	unsigned char  *ulps = NULL;
+	char          **parts;
+	size_t          num  = 0;
+	size_t          i;
+	M_bool          ret  = M_FALSE;
+
+	if (M_fs_file_read_bytes("/proc/sys/net/ipv4/tcp_available_ulp", 0, &ulps, NULL) != M_FS_ERROR_SUCCESS)
+		return M_FALSE;
+
+	parts = M_str_explode_str(' ', M_str_trim((char *)ulps), &num);
+	for (i=0; i<num; i++) {
+		if (M_str_eq(parts[i], "tls"))
+			ret = M_TRUE;
+	}
+	M_str_explode_free(parts, num);
+	M_free(ulps);
+	return ret;
+}
+
+static void ktls_serverconn_cb(M_event_t *event, M_event_type_t type, M_io_t *comm, void *data)
+{
+	ktls_test_t  *test = data;
+	M_io_error_t  ioerr;
+	size_t        len;
+
+	switch (type) {
+		case M_EVENT_TYPE_CONNECTED:
+			test->server_ktls = M_tls_get_ktls(comm, M_IO_LAYER_FIND_FIRST_ID);
+			event_debug("ktls serverconn %p connected, ktls send:%s recv:%s", comm,
+				(test->server_ktls & M_TLS_KTLS_SEND)?"yes":"no", (test->server_ktls & M_TLS_KTLS_RECV)?"yes":"no");
+			/* Fallthru */
+		case M_EVENT_TYPE_WRITE:
+			while (test->sent < KTLS_DATA_SIZE) {
+				len   = 0;
+				ioerr = M_tls_sendfile(comm, M_IO_LAYER_FIND_FIRST_ID, test->fd, test->sent, KTLS_DATA_SIZE - test->sent, &len);
+				if (ioerr == M_IO_ERROR_SUCCESS) {
+					test->used_sendfile = M_TRUE;
+				} else if (ioerr == M_IO_ERROR_NOTIMPL || ioerr == M_IO_ERROR_INVALID) {
+					/* Not offloaded (or no file), must not have sent anything in the clear */
+					if (test->fd != -1 && (test->server_ktls & M_TLS_KTLS_SEND))
+						test->failed = M_TRUE;
+					ioerr = M_io_write(comm, test->data + test->sent, KTLS_DATA_SIZE - test->sent, &len);
+				}
+				if (ioerr != M_IO_ERROR_SUCCESS)
+					break;
+				test->sent += len;
+			}
+			if (test->sent == KTLS_DATA_SIZE)
+				M_io_disconnect(comm);
+			break;
+		case M_EVENT_TYPE_DISCONNECTED:
+		case M_EVENT_TYPE_ERROR:
+			if (type == M_EVENT_TYPE_ERROR)
+				test->failed = M_TRUE;
+			M_io_destroy(comm);
+			if (M_event_num_objects(event) == 0)
+				M_event_done(event);
+			break;
+		default:
+			break;
+	}
+}
+
+static void ktls_server_cb(M_event_t *event, M_event_type_t type, M_io_t *comm, void *data)
+{
+	ktls_test_t *test = data;
+	M_io_t      *newcomm;
+
+	if (type != M_EVENT_TYPE_ACCEPT)
+		return;
+
+	if (M_io_accept(&newcomm, comm) == M_IO_ERROR_SUCCESS) {
+		M_event_add(event, newcomm, ktls_serverconn_cb, test);
+		M_io_destroy(comm);
+		test->listener = NULL;
+	}
+}
+
+static void ktls_client_cb(M_event_t *event, M_event_type_t type, M_io_t *comm, void *data)
+{
+	ktls_test_t *test = data;
+
+	switch (type) {
+		case M_EVENT_TYPE_READ:
+			M_io_read_into_buf(comm, test->received);
+			break;
+		case M_EVENT_TYPE_DISCONNECTED:
+		case M_EVENT_TYPE_ERROR:
+			if (type == M_EVENT_TYPE_ERROR)
+				test->failed = M_TRUE;
+			M_io_destroy(comm);
+			if (M_event_num_objects(event) == 0)
+				M_event_done(event);
+			break;
+		default:
+			break;
+	}
+}
+
+START_TEST(check_tls_ktls)
+{
+	M_event_t         *event;
+	M_io_t            *netclient;
+	M_tls_x509_t      *x509;
+	M_tls_serverctx_t *serverctx;
+	M_tls_clientctx_t *clientctx;
+	M_event_err_t      err;
+	ktls_test_t        test;
+	char              *key;
+	char              *cert;
+	size_t             i;
+	M_bool             supported;
+	M_bool             kernel;
+
+	M_mem_set(&test, 0, sizeof(test));
+	test.fd       = -1;
+	test.received = M_buf_create();
+	test.data     = M_malloc(KTLS_DATA_SIZE);
+	for (i=0; i<KTLS_DATA_SIZE; i++)
+		test.data[i] = (unsigned char)(i % 251);
+
+#ifdef __linux__
+	{
+		char path[] = "/tmp/check_tls_ktls_XXXXXX";
+		test.fd = mkstemp(path);
+		ck_assert_msg(test.fd != -1, "failed to create temp file");
+		unlink(path);
+		ck_assert_msg(write(test.fd, test.data, KTLS_DATA_SIZE) == KTLS_DATA_SIZE, "failed to write temp file");
+	}
+#endif
+
+	key  = M_tls_rsa_generate_key(2048);
+	ck_assert_msg(key != NULL, "failed to generate RSA private key");
+	x509 = M_tls_x509_new(key);
+	ck_assert_msg(x509 != NULL, "failed to generate X509 cert");
+	M_tls_x509_txt_add(x509, M_TLS_X509_TXT_COMMONNAME, "localhost", M_FALSE);
+	cert = M_tls_x509_selfsign(x509, 365 * 24 * 60 * 60 /* 1 year */);
+	ck_assert_msg(cert != NULL, "failed to self-sign");
+	M_tls_x509_destroy(x509);
+
+	serverctx = M_tls_serverctx_create((const M_uint8 *)key, M_str_len(key), (const M_uint8 *)cert, M_str_len(cert), NULL, 0);
+	ck_assert_msg(serverctx != NULL, "failed to create serverctx");
+	clientctx = M_tls_clientctx_create();
+	ck_assert_msg(clientctx != NULL, "failed to create clientctx");
+	M_tls_clientctx_set_verify_level(clientctx, M_TLS_VERIFY_NONE);
+	M_free(key);
+	M_free(cert);
+
+	/* Whether or not the build supports it, connections must work. If the kernel
+	 * can't offload they fall back to user space. */
+	supported = M_tls_serverctx_set_ktls(serverctx, M_TRUE);
+	ck_assert_msg(M_tls_clientctx_set_ktls(clientctx, M_TRUE) == supported, "client and server kTLS support differ");
+	kernel    = ktls_kernel_loaded();
+
+	event = M_event_create(M_EVENT_FLAG_NONE);
+
+	ck_assert_msg(M_io_net_server_create(&test.listener, 0, "127.0.0.1", M_IO_NET_ANY) == M_IO_ERROR_SUCCESS, "failed to create listener");
+	ck_assert_msg(M_io_tls_server_add(test.listener, serverctx, NULL) == M_IO_ERROR_SUCCESS, "failed to add tls to listener");
+	M_event_add(event, test.listener, ktls_server_cb, &test);
+
+	ck_assert_msg(M_io_net_client_create(&netclient, NULL, "127.0.0.1", M_io_net_get_port(test.listener), M_IO_NET_ANY) == M_IO_ERROR_SUCCESS, "failed to create client");
+	ck_assert_msg(M_io_tls_client_add(netclient, clientctx, "localhost", NULL) == M_IO_ERROR_SUCCESS, "failed to add tls to client");
+	M_event_add(event, netclient, ktls_client_cb, &test);
+
+	err = M_event_loop(event, 20000);
+	event_debug("ktls supported by build:%s, server ktls send:%s recv:%s, sendfile used:%s", supported?"yes":"no",
+		(test.server_ktls & M_TLS_KTLS_SEND)?"yes":"no", (test.server_ktls & M_TLS_KTLS_RECV)?"yes":"no", test.used_sendfile?"yes":"no");
+
+	ck_assert_msg(err == M_EVENT_ERR_DONE, "expected M_EVENT_ERR_DONE got %s", event_err_msg(err));
+	ck_assert_msg(!test.failed, "connection error or data sent unencrypted");
+	ck_assert_msg(supported || test.server_ktls == M_TLS_KTLS_NONE, "kTLS reported active but not supported");
+	if (supported && kernel) {
+		ck_assert_msg(test.server_ktls & M_TLS_KTLS_SEND, "kernel tls module loaded but send not offloaded");
+	} else {
+		M_printf("check_tls_ktls: skipping offload check, %s\n", supported?"kernel tls module not loaded":"kTLS not supported by this build");
+	}
+	ck_assert_msg(test.used_sendfile == ((test.server_ktls & M_TLS_KTLS_SEND) && test.fd != -1), "sendfile used without kTLS or not used with kTLS");
+	ck_assert_msg(M_buf_len(test.received) == KTLS_DATA_SIZE, "expected %zu bytes got %zu", (size_t)KTLS_DATA_SIZE, M_buf_len(test.received));
+	ck_assert_msg(M_mem_eq(M_buf_peek(test.received), test.data, KTLS_DATA_SIZE), "received data does not match");
+
+	M_event_destroy(event);
+	M_tls_clientctx_destroy(clientctx);
+	M_tls_serverctx_destroy(serverctx);
+	M_buf_cancel(test.received);
+	M_free(test.data);
+#ifdef __linux__
+	close(test.fd);
+#endif
+	M_library_cleanup();
+}
+END_TEST
+
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 static Suite *tls_suite(void)
@@ -920,6 +1134,11 @@ static Suite *tls_suite(void)
 	tcase_add_test(tc, check_tls_sendanddisconnect);
 	suite_add_tcase(suite, tc);
 
+	tc = tcase_create("tls ktls");
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, check_tls_ktls);
+	suite_add_tcase(suite, tc);
+
 	return suite;
 }
 
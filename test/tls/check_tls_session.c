@@ -0,0 +1,378 @@
+#include "m_config.h"
+#include <stdlib.h>
+#include <check.h>
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_thread.h>
+#include <mstdlib/mstdlib_io.h>
+#include <mstdlib/mstdlib_tls.h>
+#include "../../tls/m_tls_clientctx_int.h"
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#define CHECK_TLS_SESSION_TIMEOUT 5000
+
+typedef struct {
+	M_tls_serverctx_t *serverctx;
+	M_tls_clientctx_t *clientctx;
+	M_io_t            *netserver;
+	M_dns_t           *dns;
+	M_uint16           port;
+	char              *key;
+	char              *cert;
+} check_tls_session_t;
+
+static M_bool tls_gen_key_cert(char **key, char **cert)
+{
+	M_tls_x509_t *x509;
+
+	*key = M_tls_rsa_generate_key(2048);
+	if (*key == NULL)
+		return M_FALSE;
+
+	x509 = M_tls_x509_new(*key);
+	if (x509 == NULL)
+		return M_FALSE;
+	if (!M_tls_x509_txt_add(x509, M_TLS_X509_TXT_COMMONNAME, "localhost", M_FALSE) ||
+		!M_tls_x509_txt_SAN_add(x509, M_TLS_X509_SAN_TYPE_DNS, "localhost", M_TRUE) ||
+		!M_tls_x509_txt_SAN_add(x509, M_TLS_X509_SAN_TYPE_IP, "127.0.0.1", M_TRUE) ||
+		!M_tls_x509_txt_SAN_add(x509, M_TLS_X509_SAN_TYPE_IP, "::1", M_TRUE))
+	{
+		M_tls_x509_destroy(x509);
+		return M_FALSE;
+	}
+
+	*cert = M_tls_x509_selfsign(x509, 365 * 24 * 60 * 60 /* 1 year */);
+	M_tls_x509_destroy(x509);
+	return *cert != NULL;
+}
+
+static void check_tls_session_setup(check_tls_session_t *s)
+{
+	M_mem_set(s, 0, sizeof(*s));
+
+	ck_assert_msg(tls_gen_key_cert(&s->key, &s->cert), "failed to generate key and cert");
+
+	s->clientctx = M_tls_clientctx_create();
+	ck_assert_msg(s->clientctx != NULL, "failed to create clientctx");
+	ck_assert_msg(M_tls_clientctx_set_trust_cert(s->clientctx, (const M_uint8 *)s->cert, M_str_len(s->cert)), "failed to set server cert trust");
+
+	s->serverctx = M_tls_serverctx_create((const M_uint8 *)s->key, M_str_len(s->key), (const M_uint8 *)s->cert, M_str_len(s->cert), NULL, 0);
+	ck_assert_msg(s->serverctx != NULL, "failed to create serverctx");
+
+	ck_assert_msg(M_io_net_server_create(&s->netserver, 0 /* any port */, NULL, M_IO_NET_ANY) == M_IO_ERROR_SUCCESS, "failed to create net server");
+	s->port = M_io_net_get_port(s->netserver);
+	ck_assert_msg(M_io_tls_server_add(s->netserver, s->serverctx, NULL) == M_IO_ERROR_SUCCESS, "failed to wrap net server with tls");
+
+	s->dns = M_dns_create(NULL);
+}
+
+static void check_tls_session_cleanup(check_tls_session_t *s)
+{
+	M_io_destroy(s->netserver);
+	M_tls_clientctx_destroy(s->clientctx);
+	M_tls_serverctx_destroy(s->serverctx);
+	M_dns_destroy(s->dns);
+	M_free(s->key);
+	M_free(s->cert);
+	M_library_cleanup();
+}
+
+/* Accept a single connection, greet the client and wait for it to go away. */
+static void *check_tls_session_serve(void *arg)
+{
+	check_tls_session_t *s      = arg;
+	M_io_t              *conn   = NULL;
+	M_parser_t          *parser = M_parser_create(M_PARSER_FLAG_NONE);
+	size_t               len;
+	M_io_error_t         err;
+
+	if (M_io_block_accept(&conn, s->netserver, CHECK_TLS_SESSION_TIMEOUT) != M_IO_ERROR_SUCCESS)
+		goto done;
+
+	if (M_io_block_connect(conn) != M_IO_ERROR_SUCCESS)
+		goto done;
+
+	/* TLSv1.3 tickets are sent before this so the client has them once it reads the greeting. */
+	if (M_io_block_write(conn, (const unsigned char *)"HelloWorld", 10, &len, CHECK_TLS_SESSION_TIMEOUT) != M_IO_ERROR_SUCCESS)
+		goto done;
+
+	do {
+		err = M_io_block_read_into_parser(conn, parser, CHECK_TLS_SESSION_TIMEOUT);
+	} while (err == M_IO_ERROR_SUCCESS);
+
+done:
+	M_io_destroy(conn);
+	M_parser_destroy(parser);
+	return NULL;
+}
+
+/* Make a connection and report whether the session was resumed. */
+static M_bool check_tls_session_connect(check_tls_session_t *s)
+{
+	M_thread_attr_t *attr   = M_thread_attr_create();
+	M_parser_t      *parser = M_parser_create(M_PARSER_FLAG_NONE);
+	M_io_t          *conn   = NULL;
+	M_threadid_t     thread;
+	M_io_error_t     err;
+	size_t           layer_id;
+	M_bool           reused;
+
+	M_thread_attr_set_create_joinable(attr, M_TRUE);
+	thread = M_thread_create(attr, check_tls_session_serve, s);
+	M_thread_attr_destroy(attr);
+
+	ck_assert_msg(M_io_net_client_create(&conn, s->dns, "localhost", s->port, M_IO_NET_ANY) == M_IO_ERROR_SUCCESS, "failed to create client");
+	ck_assert_msg(M_io_tls_client_add(conn, s->clientctx, NULL, &layer_id) == M_IO_ERROR_SUCCESS, "failed to wrap net client with tls");
+	ck_assert_msg(M_io_block_connect(conn) == M_IO_ERROR_SUCCESS, "failed to connect");
+
+	do {
+		err = M_io_block_read_into_parser(conn, parser, CHECK_TLS_SESSION_TIMEOUT);
+	} while (err == M_IO_ERROR_SUCCESS && M_parser_len(parser) < 10);
+	ck_assert_msg(M_parser_compare_str(parser, "HelloWorld", 0, M_FALSE), "greeting not received: %d", (int)err);
+
+	reused = M_tls_get_sessionreused(conn, layer_id);
+
+	M_io_block_disconnect(conn);
+	M_io_destroy(conn);
+	M_parser_destroy(parser);
+	M_thread_join(thread, NULL);
+
+	return reused;
+}
+
+static M_uint64 check_tls_session_stat(M_tls_clientctx_t *ctx, M_tls_session_statistic_t type)
+{
+	return M_tls_clientctx_get_session_statistic(ctx, type);
+}
+
+/* A session good for 5 minutes, established age seconds ago. */
+static SSL_SESSION *check_tls_session_new(long age)
+{
+	SSL_SESSION *session = SSL_SESSION_new();
+
+	SSL_SESSION_set_time(session, (long)M_time() - age);
+	SSL_SESSION_set_timeout(session, 300);
+	return session;
+}
+
+static void check_tls_session_ticket_key(unsigned char *key, unsigned char id)
+{
+	/* Distinct name, HMAC secret and AES key per id. */
+	M_mem_set(key, id, M_TLS_SERVERCTX_TICKET_KEY_LEN);
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+START_TEST(check_tls_session_cache)
+{
+	M_tls_clientctx_t *ctx = M_tls_clientctx_create();
+	SSL_SESSION       *s1;
+	SSL_SESSION       *s2;
+	SSL_SESSION       *s3;
+	SSL_SESSION       *session;
+
+	ck_assert(!M_tls_clientctx_set_session_cache_limits(ctx, 0, 2));
+	ck_assert(M_tls_clientctx_set_session_cache_limits(ctx, 2, 2));
+
+	/* Insert and lookup. */
+	s1 = check_tls_session_new(0);
+	M_tls_clientctx_session_store(ctx, "a:443", s1);
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_STORED) == 1);
+	ck_assert_msg(M_tls_clientctx_session_take(ctx, "b:443") == NULL, "session returned for another host");
+	ck_assert_msg(M_tls_clientctx_session_take(ctx, "a:444") == NULL, "session returned for another port");
+	/* Host names are case insensitive. */
+	session = M_tls_clientctx_session_take(ctx, "A:443");
+	ck_assert_msg(session == s1, "stored session not returned");
+	SSL_SESSION_free(session);
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_STORED) == 0);
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_HITS) == 1);
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_MISSES) == 2);
+
+	/* A session is only handed out once. */
+	ck_assert_msg(M_tls_clientctx_session_take(ctx, "a:443") == NULL, "session returned twice");
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_MISSES) == 3);
+
+	/* The newest session is used first and the oldest is evicted when a host is full. */
+	s1 = check_tls_session_new(2);
+	s2 = check_tls_session_new(1);
+	s3 = check_tls_session_new(0);
+	M_tls_clientctx_session_store(ctx, "a:443", s1);
+	M_tls_clientctx_session_store(ctx, "a:443", s2);
+	M_tls_clientctx_session_store(ctx, "a:443", s3);
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_STORED) == 2);
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_EVICTIONS) == 1);
+	session = M_tls_clientctx_session_take(ctx, "a:443");
+	ck_assert_msg(session == s3, "newest session not returned first");
+	SSL_SESSION_free(session);
+	session = M_tls_clientctx_session_take(ctx, "a:443");
+	ck_assert_msg(session == s2, "oldest session not evicted");
+	SSL_SESSION_free(session);
+	ck_assert(M_tls_clientctx_session_take(ctx, "a:443") == NULL);
+
+	/* The least recently used host is evicted once there are too many. */
+	M_tls_clientctx_session_store(ctx, "a:443", check_tls_session_new(0));
+	M_tls_clientctx_session_store(ctx, "b:443", check_tls_session_new(0));
+	M_tls_clientctx_session_store(ctx, "a:443", check_tls_session_new(0));
+	M_tls_clientctx_session_store(ctx, "c:443", check_tls_session_new(0));
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_STORED) == 3);
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_EVICTIONS) == 2);
+	ck_assert_msg(M_tls_clientctx_session_take(ctx, "b:443") == NULL, "least recently used host not evicted");
+	session = M_tls_clientctx_session_take(ctx, "c:443");
+	ck_assert(session != NULL);
+	SSL_SESSION_free(session);
+
+	/* Expired sessions are dropped when looked up and the next newest is used. */
+	s1 = check_tls_session_new(0);
+	M_tls_clientctx_session_store(ctx, "c:443", s1);
+	M_tls_clientctx_session_store(ctx, "c:443", check_tls_session_new(600));
+	session = M_tls_clientctx_session_take(ctx, "c:443");
+	ck_assert_msg(session == s1, "expired session returned");
+	SSL_SESSION_free(session);
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_EVICTIONS) == 3);
+	M_tls_clientctx_session_store(ctx, "c:443", check_tls_session_new(600));
+	ck_assert_msg(M_tls_clientctx_session_take(ctx, "c:443") == NULL, "expired session returned");
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_EVICTIONS) == 4);
+
+	/* Nothing is stored once resumption is disabled. */
+	ck_assert(M_tls_clientctx_set_session_resumption(ctx, M_FALSE));
+	M_tls_clientctx_session_store(ctx, "c:443", check_tls_session_new(0));
+	ck_assert_msg(M_tls_clientctx_session_take(ctx, "c:443") == NULL, "session stored while disabled");
+
+	/* The remaining sessions for "a" are released with the context. */
+	ck_assert(check_tls_session_stat(ctx, M_TLS_SESSION_STATISTIC_STORED) == 2);
+	M_tls_clientctx_destroy(ctx);
+	M_library_cleanup();
+}
+END_TEST
+
+START_TEST(check_tls_session_resume)
+{
+	check_tls_session_t s;
+	int                 protocols[] = { M_TLS_PROTOCOL_TLSv1_2, M_TLS_PROTOCOL_TLSv1_3 };
+
+	check_tls_session_setup(&s);
+	ck_assert(M_tls_clientctx_set_protocols(s.clientctx, protocols[_i]));
+
+	ck_assert_msg(!check_tls_session_connect(&s), "first connection was resumed");
+	ck_assert_msg(check_tls_session_stat(s.clientctx, M_TLS_SESSION_STATISTIC_STORED) > 0, "session not stored");
+	ck_assert_msg(check_tls_session_connect(&s), "not resumed");
+	ck_assert(check_tls_session_stat(s.clientctx, M_TLS_SESSION_STATISTIC_HITS) == 1);
+	ck_assert(check_tls_session_stat(s.clientctx, M_TLS_SESSION_STATISTIC_MISSES) == 1);
+
+	/* Cached sessions aren't offered once resumption is disabled. */
+	ck_assert(M_tls_clientctx_set_session_resumption(s.clientctx, M_FALSE));
+	ck_assert_msg(!check_tls_session_connect(&s), "resumed with resumption disabled");
+
+	check_tls_session_cleanup(&s);
+}
+END_TEST
+
+START_TEST(check_tls_session_ticket_keys)
+{
+	check_tls_session_t s;
+	unsigned char       key[M_TLS_SERVERCTX_TICKET_KEY_LEN];
+
+	check_tls_session_setup(&s);
+
+	/* Only keep the newest ticket so we know which key it was encrypted with. */
+	ck_assert(M_tls_clientctx_set_session_cache_limits(s.clientctx, 16, 1));
+
+	check_tls_session_ticket_key(key, 1);
+	ck_assert(M_tls_serverctx_set_ticket_keys(s.serverctx, key, sizeof(key)));
+	ck_assert(!M_tls_serverctx_set_ticket_keys(s.serverctx, key, sizeof(key)-1));
+
+	ck_assert_msg(!check_tls_session_connect(&s), "first connection was resumed");
+	ck_assert_msg(check_tls_session_connect(&s), "not resumed with the current key");
+
+	/* Tickets are only used once and one encrypted with the current key isn't renewed. */
+	ck_assert_msg(!check_tls_session_connect(&s), "resumed without a ticket");
+
+	/* Key 1 becomes the previous key. */
+	check_tls_session_ticket_key(key, 2);
+	ck_assert(M_tls_serverctx_rotate_ticket_key(s.serverctx, key, sizeof(key), 2));
+	ck_assert_msg(check_tls_session_connect(&s), "not resumed with the previous key");
+
+	/* The ticket was renewed with key 2 which is now the previous key. */
+	check_tls_session_ticket_key(key, 3);
+	ck_assert(M_tls_serverctx_rotate_ticket_key(s.serverctx, key, sizeof(key), 2));
+	ck_assert_msg(check_tls_session_connect(&s), "not resumed with the renewed ticket");
+
+	/* Key 3 is pushed out of the ring. */
+	check_tls_session_ticket_key(key, 4);
+	ck_assert(M_tls_serverctx_rotate_ticket_key(s.serverctx, key, sizeof(key), 2));
+	check_tls_session_ticket_key(key, 5);
+	ck_assert(M_tls_serverctx_rotate_ticket_key(s.serverctx, key, sizeof(key), 2));
+	ck_assert_msg(!check_tls_session_connect(&s), "resumed with a key that was rotated out");
+	ck_assert_msg(check_tls_session_connect(&s), "not resumed after a full handshake");
+
+	check_tls_session_cleanup(&s);
+}
+END_TEST
+
+START_TEST(check_tls_session_ticket_keys_sni)
+{
+	check_tls_session_t  s;
+	M_tls_serverctx_t   *child;
+	unsigned char        key[M_TLS_SERVERCTX_TICKET_KEY_LEN];
+
+	check_tls_session_setup(&s);
+	check_tls_session_ticket_key(key, 1);
+
+	/* A child can't bring its own key ring. */
+	child = M_tls_serverctx_create((const M_uint8 *)s.key, M_str_len(s.key), (const M_uint8 *)s.cert, M_str_len(s.cert), NULL, 0);
+	ck_assert(M_tls_serverctx_set_ticket_keys(child, key, sizeof(key)));
+	ck_assert_msg(!M_tls_serverctx_SNI_ctx_add(s.serverctx, child), "child with ticket keys was added");
+	ck_assert(M_tls_serverctx_set_ticket_keys(child, NULL, 0));
+	ck_assert(M_tls_serverctx_SNI_ctx_add(s.serverctx, child));
+
+	/* Or set one once it's a child. */
+	ck_assert_msg(!M_tls_serverctx_set_ticket_keys(child, key, sizeof(key)), "ticket keys set on child");
+	ck_assert_msg(!M_tls_serverctx_rotate_ticket_key(child, key, sizeof(key), 2), "ticket key rotated on child");
+	ck_assert(M_tls_serverctx_set_ticket_keys(s.serverctx, key, sizeof(key)));
+
+	check_tls_session_cleanup(&s);
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static Suite *tls_session_suite(void)
+{
+	Suite *suite;
+	TCase *tc;
+
+	suite = suite_create("tls_session");
+
+	tc = tcase_create("tls_session_cache");
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, check_tls_session_cache);
+	tcase_add_loop_test(tc, check_tls_session_resume, 0, 2);
+	suite_add_tcase(suite, tc);
+
+	tc = tcase_create("tls_session_ticket_keys");
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, check_tls_session_ticket_keys);
+	tcase_add_test(tc, check_tls_session_ticket_keys_sni);
+	suite_add_tcase(suite, tc);
+
+	return suite;
+}
+
+int main(int argc, char **argv)
+{
+	SRunner *sr;
+	int      nf;
+
+	(void)argc;
+	(void)argv;
+
+	sr = srunner_create(tls_session_suite());
+	if (getenv("CK_LOG_FILE_NAME")==NULL) srunner_set_log(sr, "check_tls_session.log");
+
+	srunner_run_all(sr, CK_NORMAL);
+	nf = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return nf == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,240 @@
+#include "m_config.h"
+#include <stdlib.h>
+#include <check.h>
+
+#include <mstdlib/mstdlib.h>
+#include <mstdlib/mstdlib_thread.h>
+#include <mstdlib/mstdlib_io.h>
+#include <mstdlib/mstdlib_tls.h>
+
+/* Measures how long the server's event loop is stalled while a burst of
+ * clients handshake at the same time, with and without handshake offload. */
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#define NUM_CLIENTS      64
+#define TICK_INTERVAL_MS 5
+
+typedef struct {
+	M_event_t   *event;
+	M_io_t      *listener;
+	size_t       num_done;
+	M_timeval_t  last_tick;
+	M_uint64     max_tick_delay_ms;
+} hs_server_t;
+
+static void hs_tick_cb(M_event_t *event, M_event_type_t type, M_io_t *io, void *arg)
+{
+	hs_server_t *server = arg;
+	M_uint64     elapsed;
+
+	(void)event;
+	(void)type;
+	(void)io;
+
+	elapsed = M_time_elapsed(&server->last_tick);
+	if (elapsed > TICK_INTERVAL_MS && elapsed - TICK_INTERVAL_MS > server->max_tick_delay_ms)
+		server->max_tick_delay_ms = elapsed - TICK_INTERVAL_MS;
+	M_time_elapsed_start(&server->last_tick);
+}
+
+static void hs_serverconn_cb(M_event_t *event, M_event_type_t type, M_io_t *io, void *arg)
+{
+	hs_server_t *server = arg;
+
+	switch (type) {
+		case M_EVENT_TYPE_CONNECTED:
+			M_io_write(io, (const unsigned char *)"x", 1, NULL);
+			M_io_disconnect(io);
+			break;
+		case M_EVENT_TYPE_DISCONNECTED:
+		case M_EVENT_TYPE_ERROR:
+			M_io_destroy(io);
+			server->num_done++;
+			if (server->num_done == NUM_CLIENTS) {
+				M_io_destroy(server->listener);
+				server->listener = NULL;
+				M_event_done_with_disconnect(event, 0, 1000);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static void hs_listener_cb(M_event_t *event, M_event_type_t type, M_io_t *io, void *arg)
+{
+	M_io_t *newio;
+
+	if (type != M_EVENT_TYPE_ACCEPT)
+		return;
+
+	while (M_io_accept(&newio, io) == M_IO_ERROR_SUCCESS) {
+		M_event_add(event, newio, hs_serverconn_cb, arg);
+	}
+}
+
+static void hs_client_cb(M_event_t *event, M_event_type_t type, M_io_t *io, void *arg)
+{
+	unsigned char buf[64];
+	size_t        len;
+	size_t       *num_done = arg;
+
+	switch (type) {
+		case M_EVENT_TYPE_READ:
+			M_io_read(io, buf, sizeof(buf), &len);
+			break;
+		case M_EVENT_TYPE_DISCONNECTED:
+		case M_EVENT_TYPE_ERROR:
+			M_io_destroy(io);
+			(*num_done)++;
+			if (*num_done == NUM_CLIENTS)
+				M_event_done(event);
+			break;
+		default:
+			break;
+	}
+}
+
+static void *hs_client_thread(void *arg)
+{
+	M_event_loop(arg, 30000);
+	return NULL;
+}
+
+static M_uint64 check_tlshandshake_run(const char *key, const char *cert, M_threadpool_t *pool)
+{
+	hs_server_t        server;
+	M_event_t         *client_event;
+	M_event_timer_t   *tick;
+	M_tls_serverctx_t *serverctx;
+	M_tls_clientctx_t *clientctx;
+	M_thread_attr_t   *tattr;
+	M_threadid_t       tid;
+	M_event_err_t      err;
+	M_uint16           port;
+	size_t             clients_done = 0;
+	size_t             i;
+
+	M_mem_set(&server, 0, sizeof(server));
+
+	serverctx = M_tls_serverctx_create((const M_uint8 *)key, M_str_len(key), (const M_uint8 *)cert, M_str_len(cert), NULL, 0);
+	ck_assert_msg(serverctx != NULL, "failed to create serverctx");
+	/* Every connection should do a full handshake */
+	M_tls_serverctx_set_session_resumption(serverctx, M_FALSE);
+	if (pool != NULL)
+		ck_assert_msg(M_tls_serverctx_set_handshake_threadpool(serverctx, pool), "failed to set handshake pool");
+
+	clientctx = M_tls_clientctx_create();
+	ck_assert_msg(clientctx != NULL, "failed to create clientctx");
+	M_tls_clientctx_set_session_resumption(clientctx, M_FALSE);
+	M_tls_clientctx_set_verify_level(clientctx, M_TLS_VERIFY_NONE);
+
+	server.event = M_event_create(M_EVENT_FLAG_NONE);
+	ck_assert_msg(M_io_net_server_create(&server.listener, 0, "127.0.0.1", M_IO_NET_ANY) == M_IO_ERROR_SUCCESS, "failed to create listener");
+	port = M_io_net_get_port(server.listener);
+	ck_assert_msg(M_io_tls_server_add(server.listener, serverctx, NULL) == M_IO_ERROR_SUCCESS, "failed to add tls to listener");
+	M_event_add(server.event, server.listener, hs_listener_cb, &server);
+
+	tick = M_event_timer_add(server.event, hs_tick_cb, &server);
+	M_time_elapsed_start(&server.last_tick);
+	M_event_timer_start(tick, TICK_INTERVAL_MS);
+
+	/* Clients run on their own loop so their half of the handshake doesn't count against the server */
+	client_event = M_event_create(M_EVENT_FLAG_NONE);
+	for (i=0; i<NUM_CLIENTS; i++) {
+		M_io_t *io = NULL;
+		ck_assert_msg(M_io_net_client_create(&io, NULL, "127.0.0.1", port, M_IO_NET_ANY) == M_IO_ERROR_SUCCESS, "failed to create client");
+		M_io_tls_client_add(io, clientctx, "localhost", NULL);
+		M_event_add(client_event, io, hs_client_cb, &clients_done);
+	}
+
+	tattr = M_thread_attr_create();
+	M_thread_attr_set_create_joinable(tattr, M_TRUE);
+	tid   = M_thread_create(tattr, hs_client_thread, client_event);
+	M_thread_attr_destroy(tattr);
+
+	err = M_event_loop(server.event, 30000);
+	M_thread_join(tid, NULL);
+
+	ck_assert_msg(err == M_EVENT_ERR_DONE, "server loop did not complete");
+	ck_assert_msg(server.num_done == NUM_CLIENTS, "expected %d server connections got %zu", NUM_CLIENTS, server.num_done);
+	ck_assert_msg(clients_done == NUM_CLIENTS, "expected %d client connections got %zu", NUM_CLIENTS, clients_done);
+
+	M_event_timer_remove(tick);
+	M_event_destroy(client_event);
+	M_event_destroy(server.event);
+	M_tls_clientctx_destroy(clientctx);
+	M_tls_serverctx_destroy(serverctx);
+
+	return server.max_tick_delay_ms;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+START_TEST(check_tlshandshake)
+{
+	M_tls_x509_t   *x509;
+	M_threadpool_t *pool;
+	char           *key;
+	char           *cert;
+	M_uint64        inline_ms;
+	M_uint64        offload_ms;
+
+	key  = M_tls_rsa_generate_key(2048);
+	ck_assert_msg(key != NULL, "failed to generate RSA private key");
+	x509 = M_tls_x509_new(key);
+	ck_assert_msg(x509 != NULL, "failed to generate X509 cert");
+	M_tls_x509_txt_add(x509, M_TLS_X509_TXT_COMMONNAME, "localhost", M_FALSE);
+	cert = M_tls_x509_selfsign(x509, 365 * 24 * 60 * 60 /* 1 year */);
+	ck_assert_msg(cert != NULL, "failed to self-sign");
+	M_tls_x509_destroy(x509);
+
+	inline_ms  = check_tlshandshake_run(key, cert, NULL);
+
+	pool       = M_threadpool_create(0, 4, 1000, SIZE_MAX);
+	offload_ms = check_tlshandshake_run(key, cert, pool);
+	M_threadpool_destroy(pool);
+
+	M_printf("%d concurrent handshakes, max event loop stall: inline %llums, offloaded %llums\n", NUM_CLIENTS, inline_ms, offload_ms);
+
+	M_free(key);
+	M_free(cert);
+	M_library_cleanup();
+}
+END_TEST
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static Suite *tlshandshake_suite(void)
+{
+	Suite *suite;
+	TCase *tc;
+
+	suite = suite_create("tlshandshake");
+
+	tc = tcase_create("tlshandshake");
+	tcase_add_test(tc, check_tlshandshake);
+	tcase_set_timeout(tc, 120);
+	suite_add_tcase(suite, tc);
+
+	return suite;
+}
+
+int main(int argc, char **argv)
+{
+	SRunner *sr;
+	int      nf;
+
+	(void)argc;
+	(void)argv;
+
+	sr = srunner_create(tlshandshake_suite());
+	if (getenv("CK_LOG_FILE_NAME")==NULL) srunner_set_log(sr, "check_tlshandshake.log");
+
+	srunner_run_all(sr, CK_NORMAL);
+	nf = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return nf == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -39,6 +39,9 @@
 #include "m_tls_clientctx_int.h"
 #include "m_tls_serverctx_int.h"
 #include "m_tls_hostvalidate.h"
+#ifdef M_TLS_KTLS
+#  include <linux/tls.h>
+#endif
 
 /* If this is defined, writes will be buffered rather than written directly to the underlying io object */
 //#define TLS_BUFFER_WRITES
@@ -64,6 +67,7 @@ struct M_io_handle {
 	M_tls_clientctx_t *clientctx;
 	M_tls_serverctx_t *serverctx;
 	char              *hostname;
+	char              *hostport;  /*!< host:port key for the client session cache, set while ssl is valid */
 	SSL               *ssl;
 	BIO               *bio_glue;
 #ifdef TLS_BUFFER_WRITES
@@ -72,11 +76,31 @@ struct M_io_handle {
 	M_tls_state_t      state;
 	M_tls_stateflags_t state_flags;
 	M_bool             is_client;
+	M_tls_ktls_t       ktls;      /*!< Directions the kernel is encrypting/decrypting */
+	unsigned char      ktls_rectype; /*!< Record type of the next BIO write if not application data (kTLS only) */
 	M_event_timer_t   *timer;
 	M_io_error_t       last_io_err;
 	M_timeval_t        negotiation_start;
 	M_uint64           negotiation_time;
 	char               error[256];
+
+	/* Server handshake offload to a thread pool. While offload_running is set the
+	 * SSL object belongs to the worker and the BIO only uses the offload buffers.
+	 *
+	 * The worker never touches the io object or event loop. Anything that does
+	 * (including M_event_trigger_signal()) takes the event lock, which may be held by
+	 * whoever is waiting on the worker in reset. Completion is instead signaled by
+	 * writing to offload_signal_w which isn't registered with any event so writing
+	 * to it doesn't take any locks. The read end is registered with the event loop. */
+	M_threadpool_parent_t *offload_pool;
+	M_thread_mutex_t      *offload_lock;
+	M_thread_cond_t       *offload_cond;
+	M_io_t                *offload_signal_r;
+	M_io_t                *offload_signal_w;
+	M_buf_t               *offload_in;      /*!< Data read from the lower layer not yet consumed by OpenSSL  */
+	M_buf_t               *offload_out;     /*!< Data written by OpenSSL not yet written to the lower layer  */
+	M_bool                 offload_running;
+	int                    offload_err;     /*!< SSL_get_error() result of the last offloaded SSL_accept()   */
 };
 
 
@@ -99,6 +123,7 @@ static int BIO_get_shutdown(BIO *a)
 
 
 static void M_tls_bio_method_new(void);
+static void M_io_tls_offload_done_cb(M_event_t *event, M_event_type_t type, M_io_t *io_dummy, void *cb_data);
 
 static M_uint64 M_tls_get_negotiation_timeout_ms(M_io_handle_t *handle)
 {
@@ -501,6 +526,170 @@ cert_err:
 }
 
 
+/*! Write any data produced by an offloaded handshake to the lower layer. */
+static void M_io_tls_offload_flush(M_io_layer_t *layer)
+{
+	M_io_handle_t *handle = M_io_layer_get_handle(layer);
+	M_io_error_t   err;
+	size_t         write_len;
+
+	if (M_buf_len(handle->offload_out) == 0)
+		return;
+
+	write_len = M_buf_len(handle->offload_out);
+	err       = M_io_layer_write(M_io_layer_get_io(layer), M_io_layer_get_index(layer)-1, (const unsigned char *)M_buf_peek(handle->offload_out), &write_len, NULL);
+	if (err != M_IO_ERROR_SUCCESS) {
+		if (err != M_IO_ERROR_WOULDBLOCK)
+			handle->last_io_err = err;
+		return;
+	}
+	M_buf_drop(handle->offload_out, write_len);
+}
+
+
+static void M_io_tls_offload_task(void *arg)
+{
+	M_io_handle_t *handle = arg;
+	unsigned char  signal = 0;
+	size_t         len    = 1;
+	int            rv;
+
+	/* The OpenSSL error queue is per thread so the error needs to be
+	 * pulled here rather than when the result is processed. */
+	ERR_clear_error();
+	rv                  = SSL_accept(handle->ssl);
+	handle->offload_err = (rv == 1)?SSL_ERROR_NONE:SSL_get_error(handle->ssl, rv);
+	if (handle->offload_err != SSL_ERROR_NONE && handle->offload_err != SSL_ERROR_WANT_READ && handle->offload_err != SSL_ERROR_WANT_WRITE) {
+		M_io_tls_error_string(handle->offload_err, handle->error, sizeof(handle->error));
+	}
+
+	/* Signal before clearing offload_running, reset can destroy the pipe as soon
+	 * as it's cleared. The completion callback waits for it to be cleared. */
+	M_io_write(handle->offload_signal_w, &signal, 1, &len);
+
+	M_thread_mutex_lock(handle->offload_lock);
+	handle->offload_running = M_FALSE;
+	M_thread_cond_broadcast(handle->offload_cond);
+	M_thread_mutex_unlock(handle->offload_lock);
+}
+
+
+/*! Hand the next handshake step to the thread pool.
+ *
+ * All data available from the lower layer is read up front since the worker
+ * can't touch the io object. Only the event thread reads or writes the lower
+ * layer. */
+static void M_io_tls_offload_accept(M_io_layer_t *layer)
+{
+	M_io_handle_t *handle = M_io_layer_get_handle(layer);
+	M_io_t        *io     = M_io_layer_get_io(layer);
+	unsigned char  buf[16 * 1024];
+	size_t         len;
+	M_io_error_t   err;
+	M_bool         running;
+	void          *args[1];
+
+	M_thread_mutex_lock(handle->offload_lock);
+	running = handle->offload_running;
+	M_thread_mutex_unlock(handle->offload_lock);
+
+	/* Completion will pick up anything that arrives in the meantime. */
+	if (running)
+		return;
+
+	M_io_tls_offload_flush(layer);
+
+	do {
+		len = sizeof(buf);
+		err = M_io_layer_read(io, M_io_layer_get_index(layer)-1, buf, &len, NULL);
+		if (err == M_IO_ERROR_SUCCESS)
+			M_buf_add_bytes(handle->offload_in, buf, len);
+	} while (err == M_IO_ERROR_SUCCESS && len > 0);
+
+	if (err != M_IO_ERROR_SUCCESS && err != M_IO_ERROR_WOULDBLOCK)
+		handle->last_io_err = err;
+
+	/* The server side of the handshake can only progress with more data from
+	 * the client. Disconnects and errors are delivered as their own events. */
+	if (M_buf_len(handle->offload_in) == 0)
+		return;
+
+	if (handle->offload_signal_r == NULL) {
+		if (M_io_pipe_create(M_IO_PIPE_NONE, &handle->offload_signal_r, &handle->offload_signal_w) != M_IO_ERROR_SUCCESS) {
+			handle->state = M_TLS_STATE_ERROR;
+			M_snprintf(handle->error, sizeof(handle->error), "Failed to create handshake offload signal");
+			M_io_layer_softevent_add(layer, M_TRUE, M_EVENT_TYPE_ERROR, M_IO_ERROR_ERROR);
+			return;
+		}
+		M_event_add(M_io_get_event(io), handle->offload_signal_r, M_io_tls_offload_done_cb, layer);
+	}
+
+	handle->offload_running = M_TRUE;
+	args[0]                 = handle;
+	M_threadpool_dispatch(handle->offload_pool, M_io_tls_offload_task, args, 1);
+}
+
+
+static void M_io_tls_offload_done_cb(M_event_t *event, M_event_type_t type, M_io_t *io_dummy, void *cb_data)
+{
+	M_io_layer_t  *layer  = cb_data;
+	M_io_handle_t *handle = M_io_layer_get_handle(layer);
+	unsigned char  buf[16];
+	size_t         len;
+
+	(void)event;
+
+	if (type != M_EVENT_TYPE_READ)
+		return;
+
+	/* Only one step is ever outstanding so the contents don't matter. */
+	do {
+		len = sizeof(buf);
+	} while (M_io_read(io_dummy, buf, len, &len) == M_IO_ERROR_SUCCESS && len > 0);
+
+	layer = M_io_layer_acquire(M_io_layer_get_io(layer), M_io_layer_get_index(layer), NULL);
+
+	/* The worker signals right before it's done. */
+	M_thread_mutex_lock(handle->offload_lock);
+	while (handle->offload_running)
+		M_thread_cond_wait(handle->offload_cond, handle->offload_lock);
+	M_thread_mutex_unlock(handle->offload_lock);
+
+	/* Negotiation may have timed out while the worker was running. */
+	if (handle->state != M_TLS_STATE_ACCEPTING) {
+		M_io_layer_release(layer);
+		return;
+	}
+
+	M_io_tls_offload_flush(layer);
+
+	switch (handle->offload_err) {
+		case SSL_ERROR_NONE:
+			handle->state            = M_TLS_STATE_CONNECTED;
+			M_event_timer_remove(handle->timer);
+			handle->timer            = NULL;
+			handle->negotiation_time = M_time_elapsed(&handle->negotiation_start);
+
+			M_io_layer_softevent_add(layer, M_TRUE, M_EVENT_TYPE_CONNECTED, M_IO_ERROR_SUCCESS);
+			/* Application data may already be buffered in offload_in or within OpenSSL */
+			M_io_layer_softevent_add(layer, M_TRUE, M_EVENT_TYPE_READ, M_IO_ERROR_SUCCESS);
+			break;
+		case SSL_ERROR_WANT_READ:
+		case SSL_ERROR_WANT_WRITE:
+			/* More data may have arrived while the worker was running. */
+			M_io_tls_offload_accept(layer);
+			break;
+		default:
+			handle->state            = M_TLS_STATE_ERROR;
+			handle->negotiation_time = M_time_elapsed(&handle->negotiation_start);
+			M_io_layer_softevent_add(layer, M_TRUE, M_EVENT_TYPE_ERROR, M_IO_ERROR_ERROR);
+			break;
+	}
+
+	M_io_layer_release(layer);
+}
+
+
 static M_bool M_io_tls_process_state_accepting(M_io_layer_t *layer, M_event_type_t *type)
 {
 	M_io_handle_t *handle   = M_io_layer_get_handle(layer);
@@ -511,6 +700,10 @@ static M_bool M_io_tls_process_state_accepting(M_io_layer_t *layer, M_event_type
 		case M_EVENT_TYPE_CONNECTED:
 		case M_EVENT_TYPE_READ:
 		case M_EVENT_TYPE_WRITE:
+			if (handle->offload_pool != NULL) {
+				M_io_tls_offload_accept(layer);
+				return M_TRUE; /* Internally consumed i/o, completion is signaled separately */
+			}
 			ERR_clear_error();
 			rv = SSL_accept(handle->ssl);
 			if (rv == 1) {
@@ -589,6 +782,7 @@ static M_bool M_io_tls_process_state_connected(M_io_layer_t *layer, M_event_type
 		case M_EVENT_TYPE_WRITE:
 			/* Flush write buffer */
 			M_io_tls_flush_write_buf(layer);
+			M_io_tls_offload_flush(layer);
 
 			if (handle->state_flags & M_TLS_STATEFLAG_READ_WANT_WRITE) {
 				/* Prefer rewriting this event to a "read" which will get processed
@@ -745,6 +939,20 @@ static int M_tls_bio_read(BIO *b, char *buf, int len)
 		return -1;
 	}
 
+	/* Data read on behalf of an offloaded handshake is consumed first. The worker
+	 * must never touch the io object itself. */
+	if (handle->offload_running || M_buf_len(handle->offload_in) != 0) {
+		BIO_clear_retry_flags(b);
+		read_len = M_MIN((size_t)len, M_buf_len(handle->offload_in));
+		if (read_len == 0) {
+			BIO_set_retry_read(b);
+			return -1;
+		}
+		M_mem_copy(buf, M_buf_peek(handle->offload_in), read_len);
+		M_buf_drop(handle->offload_in, read_len);
+		return (int)read_len;
+	}
+
 	read_len = (size_t)len;
 	err      = M_io_layer_read(M_io_layer_get_io(layer), M_io_layer_get_index(layer)-1, (unsigned char *)buf, &read_len, NULL);
 //M_dprintf(1, "%s(): request size %zu, read %zu\n", __FUNCTION__, (size_t)len, (size_t)read_len);
@@ -786,6 +994,20 @@ static int M_tls_bio_write(BIO *b, const char *buf, int len)
 		return -1;
 	}
 
+	if (handle->offload_running) {
+		M_buf_add_bytes(handle->offload_out, buf, (size_t)len);
+		return len;
+	}
+
+	/* Data from an offloaded handshake must go out first. */
+	if (M_buf_len(handle->offload_out) != 0) {
+		M_io_tls_offload_flush(layer);
+		if (M_buf_len(handle->offload_out) != 0) {
+			BIO_set_retry_write(b);
+			return -1;
+		}
+	}
+
 #ifdef TLS_BUFFER_WRITES
 	write_len  = 2 * 1024 * 1024; /* 2MB buffer */
 	write_len -= M_buf_len(handle->write_buf);
@@ -802,7 +1024,19 @@ static int M_tls_bio_write(BIO *b, const char *buf, int len)
 	return (int)write_len;
 #else
 	write_len           = (size_t)len;
+#ifdef M_TLS_KTLS
+	/* OpenSSL sets the record type before each write of anything other than application data */
+	if (handle->ktls_rectype != 0) {
+		M_io_net_ktls_set_record_type(M_io_layer_get_io(layer), handle->ktls_rectype);
+		handle->last_io_err = M_io_layer_write(M_io_layer_get_io(layer), M_io_layer_get_index(layer)-1, (const unsigned char *)buf, &write_len, NULL);
+		M_io_net_ktls_set_record_type(M_io_layer_get_io(layer), 0);
+		handle->ktls_rectype = 0;
+	} else {
+		handle->last_io_err = M_io_layer_write(M_io_layer_get_io(layer), M_io_layer_get_index(layer)-1, (const unsigned char *)buf, &write_len, NULL);
+	}
+#else
 	handle->last_io_err = M_io_layer_write(M_io_layer_get_io(layer), M_io_layer_get_index(layer)-1, (const unsigned char *)buf, &write_len, NULL);
+#endif
 //M_dprintf(1, "%s(): request size %zu, write %zu\n", __FUNCTION__, (size_t)len, (size_t)write_len);
 
 	if (handle->last_io_err != M_IO_ERROR_SUCCESS) {
@@ -821,8 +1055,62 @@ static int M_tls_bio_write(BIO *b, const char *buf, int len)
 }
 
 
+#ifdef M_TLS_KTLS
+/* Called by OpenSSL when keys change if SSL_OP_ENABLE_KTLS is set. Returning false
+ * leaves encryption in user space for that direction. */
+static M_bool M_io_tls_ktls_start(M_io_layer_t *layer, M_bool is_send, const void *crypto_info)
+{
+	M_io_handle_t                *handle = M_io_layer_get_handle(layer);
+	const struct tls_crypto_info *info   = crypto_info;
+	size_t                        len;
+
+	/* Offloaded handshakes call this from the worker which must not touch the io object */
+	if (handle->offload_pool != NULL || info == NULL)
+		return M_FALSE;
+
+	/* The kernel takes over the socket so nothing can sit between it and us */
+	if (M_io_layer_get_index(layer) != 1)
+		return M_FALSE;
+
+	switch (info->cipher_type) {
+		case TLS_CIPHER_AES_GCM_128:
+			len = sizeof(struct tls12_crypto_info_aes_gcm_128);
+			break;
+#ifdef TLS_CIPHER_AES_GCM_256
+		case TLS_CIPHER_AES_GCM_256:
+			len = sizeof(struct tls12_crypto_info_aes_gcm_256);
+			break;
+#endif
+#ifdef TLS_CIPHER_AES_CCM_128
+		case TLS_CIPHER_AES_CCM_128:
+			len = sizeof(struct tls12_crypto_info_aes_ccm_128);
+			break;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+		case TLS_CIPHER_CHACHA20_POLY1305:
+			len = sizeof(struct tls12_crypto_info_chacha20_poly1305);
+			break;
+#endif
+		default:
+			return M_FALSE;
+	}
+
+	if (!M_io_net_ktls_enable(M_io_layer_get_io(layer), is_send, crypto_info, len))
+		return M_FALSE;
+
+	handle->ktls |= is_send?M_TLS_KTLS_SEND:M_TLS_KTLS_RECV;
+	return M_TRUE;
+}
+#endif
+
+
 static long M_tls_bio_ctrl(BIO *b, int cmd, long num, void *ptr)
 {
+#ifdef M_TLS_KTLS
+	M_io_layer_t  *layer  = BIO_get_data(b);
+	M_io_handle_t *handle = M_io_layer_get_handle(layer);
+#endif
+
 	(void)b;
 	(void)num;
 	(void)ptr;
@@ -836,6 +1124,26 @@ static long M_tls_bio_ctrl(BIO *b, int cmd, long num, void *ptr)
 		case BIO_CTRL_FLUSH:
 			/* Required internally by OpenSSL, no-op though */
 			return 1;
+#ifdef M_TLS_KTLS
+		case BIO_CTRL_SET_KTLS:
+			if (layer == NULL)
+				return 0;
+			return M_io_tls_ktls_start(layer, num?M_TRUE:M_FALSE, ptr)?1:0;
+		case BIO_CTRL_GET_KTLS_SEND:
+			return (handle != NULL && handle->ktls & M_TLS_KTLS_SEND)?1:0;
+		case BIO_CTRL_GET_KTLS_RECV:
+			return (handle != NULL && handle->ktls & M_TLS_KTLS_RECV)?1:0;
+		case BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG:
+			if (handle == NULL)
+				return 0;
+			handle->ktls_rectype = (unsigned char)num;
+			return 1;
+		case BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG:
+			if (handle == NULL)
+				return 0;
+			handle->ktls_rectype = 0;
+			return 1;
+#endif
 	}
 	return 0;
 }
@@ -908,20 +1216,22 @@ static M_bool M_io_tls_init_cb(M_io_layer_t *layer)
 
 	/* Attempt to look up session object to use */
 	if (!M_str_isempty(handle->hostname) && handle->clientctx->sessions_enabled) {
-		char        *hostport = NULL;
 		SSL_SESSION *session;
-		M_asprintf(&hostport, "%s:%u", handle->hostname, (unsigned int)M_io_net_get_port(io));
 
-		/* Attempt to resume session */
-		M_thread_mutex_lock(handle->clientctx->lock);
-		session = M_hash_strvp_multi_get_direct(handle->clientctx->sessions, hostport, 0);
+		M_asprintf(&handle->hostport, "%s:%u", handle->hostname, (unsigned int)M_io_net_get_port(io));
+
+		/* The clientctx new session callback uses this to know which host a
+		 * session (or TLSv1.3 ticket) it's handed belongs to. */
+		SSL_set_app_data(handle->ssl, handle->hostport);
+
+		/* Attempt to resume session. Sessions are removed from the cache when
+		 * taken so they're never used by two connections at once. */
+		session = M_tls_clientctx_session_take(handle->clientctx, handle->hostport);
 		if (session) {
 			SSL_set_session(handle->ssl, session);
-			/* This will also reduce the reference count on that session */
-			M_hash_strvp_multi_remove(handle->clientctx->sessions, hostport, 0, M_TRUE);
+			/* SSL_set_session() holds its own reference */
+			SSL_SESSION_free(session);
 		}
-		M_thread_mutex_unlock(handle->clientctx->lock);
-		M_free(hostport);
 	}
 
 	if (!M_str_isempty(handle->hostname)) {
@@ -1123,71 +1433,73 @@ static M_bool M_io_tls_disconnect_cb(M_io_layer_t *layer)
 }
 
 
-static void M_io_tls_save_client_session(M_io_handle_t *handle, unsigned int port)
+static void M_io_tls_save_client_session(M_io_handle_t *handle)
 {
-	char        *hostport = NULL;
 	SSL_SESSION *session;
 
-	if (!handle->is_client || M_str_isempty(handle->hostname) || !handle->clientctx->sessions_enabled)
+	if (!handle->is_client || handle->hostport == NULL)
+		return;
+
+	/* New sessions are delivered to the clientctx by the new session callback
+	 * as they're received. The only thing left to do is put back a resumed
+	 * session so it can be used again. */
+	if (!SSL_session_reused(handle->ssl))
 		return;
 
 	session = SSL_get1_session(handle->ssl);
 #if OPENSSL_VERSION_NUMBER >= 0x1010100fL && !defined(LIBRESSL_VERSION_NUMBER)
-	/* The TLSv1.3 spec recommends sessions are only reused once.
+	/* The TLSv1.3 spec recommends sessions are only reused once. The server
+	 * will have sent new tickets which were already stored.
 	 *
 	 * If it's not resumable we won't store it because it's not useable.
 	 */
 	if (session != NULL &&
-			(!SSL_SESSION_is_resumable(session) ||
-				(SSL_session_reused(handle->ssl) && M_str_caseeq(SSL_get_version(handle->ssl), "TLSv1.3"))))
+			(!SSL_SESSION_is_resumable(session) || M_str_caseeq(SSL_get_version(handle->ssl), "TLSv1.3")))
 	{
 		SSL_SESSION_free(session);
 		session = NULL;
 	}
 #endif
 
-
-	if (session != NULL) {
-		M_asprintf(&hostport, "%s:%u", handle->hostname, port);
-
-		M_thread_mutex_lock(handle->clientctx->lock);
-		M_hash_strvp_insert(handle->clientctx->sessions, hostport, session);
-		M_thread_mutex_unlock(handle->clientctx->lock);
-
-		M_free(hostport);
-	}
+	M_tls_clientctx_session_store(handle->clientctx, handle->hostport, session);
 }
 
 
 static M_bool M_io_tls_reset_cb(M_io_layer_t *layer)
 {
 	M_io_handle_t *handle = M_io_layer_get_handle(layer);
-	M_io_t        *io     = M_io_layer_get_io(layer);
 
 	if (handle == NULL)
 		return M_FALSE;
 
+	/* An offloaded handshake step owns the SSL object until it finishes. This is
+	 * at most a single handshake step and the worker never needs anything we may
+	 * be holding. */
+	if (handle->offload_lock != NULL) {
+		M_thread_mutex_lock(handle->offload_lock);
+		while (handle->offload_running)
+			M_thread_cond_wait(handle->offload_cond, handle->offload_lock);
+		M_thread_mutex_unlock(handle->offload_lock);
+	}
+	M_event_remove(handle->offload_signal_r);
+	M_io_destroy(handle->offload_signal_r);
+	M_io_destroy(handle->offload_signal_w);
+	handle->offload_signal_r = NULL;
+	handle->offload_signal_w = NULL;
+	M_buf_truncate(handle->offload_in, 0);
+	M_buf_truncate(handle->offload_out, 0);
+
 	/* Save session */
 	if (handle->state == M_TLS_STATE_CONNECTED || handle->state == M_TLS_STATE_SHUTDOWN || handle->state == M_TLS_STATE_DISCONNECTED) {
 		/* Tell OpenSSL that shutdown was successful otherwise it may not mark the session as resumable */
 		SSL_set_shutdown(handle->ssl, SSL_SENT_SHUTDOWN|SSL_RECEIVED_SHUTDOWN);
 	}
 
-	/* If client connection, we have additional work to do to save the session.
-	 *
-	 * OpenSSL supports a callback based system for receiving sessions that can
-	 * be stored but we're not using it. The callback method is necessary for
-	 * TLSv1.3 when attempting to store the session during negotiation. v1.3
-	 * will generate the session after the handshake has completed so unlike
-	 * <= v1.2 where there was a specific place during handshake it could be pulled
-	 * that's no longer possible.
-	 *
-	 * The above does not apply to us because we only store session at shutdown.
-	 * Saving sessions will work with v1.3 due to this. Making this code fully
-	 * support v1.3 sessions.
-	 */
+	/* If client connection, a resumed session may need to be returned to the
+	 * cache. Newly negotiated sessions were already stored by the clientctx's
+	 * new session callback. */
 	if (handle->ssl != NULL && handle->state != M_TLS_STATE_INIT) {
-		M_io_tls_save_client_session(handle, (unsigned int)M_io_net_get_port(io));
+		M_io_tls_save_client_session(handle);
 	}
 
 	if (handle->ssl != NULL) {
@@ -1195,6 +1507,8 @@ static M_bool M_io_tls_reset_cb(M_io_layer_t *layer)
 	}
 
 	handle->ssl              = NULL;
+	M_free(handle->hostport);
+	handle->hostport         = NULL;
 	/* SSL_free() auto-frees the bio BIO_free(handle->bio_glue); */
 	handle->bio_glue         = NULL;
 #ifdef TLS_BUFFER_WRITES
@@ -1205,6 +1519,8 @@ static M_bool M_io_tls_reset_cb(M_io_layer_t *layer)
 	handle->timer            = NULL;
 	handle->state            = M_TLS_STATE_INIT;
 	handle->state_flags      = 0;
+	handle->ktls             = M_TLS_KTLS_NONE;
+	handle->ktls_rectype     = 0;
 	handle->last_io_err      = M_IO_ERROR_SUCCESS;
 	M_mem_set(&handle->negotiation_start, 0, sizeof(handle->negotiation_start));
 	handle->negotiation_time = 0;
@@ -1234,6 +1550,11 @@ static void M_io_tls_destroy_cb(M_io_layer_t *layer)
 	M_free(handle->hostname);
 	handle->hostname = NULL;
 
+	M_buf_cancel(handle->offload_in);
+	M_buf_cancel(handle->offload_out);
+	M_thread_cond_destroy(handle->offload_cond);
+	M_thread_mutex_destroy(handle->offload_lock);
+
 	M_free(handle);
 }
 
@@ -1301,8 +1622,12 @@ M_io_error_t M_io_tls_client_add(M_io_t *io, M_tls_clientctx_t *ctx, const char
 
 	handle->hostname = M_strdup(hostname);
 
-	/* Add buffer layer to improve performance */
-	M_io_add_buffer(io, NULL, 16 * 1024 * 1024, 16 * 1024 * 1024);
+	/* Add buffer layer to improve performance. kTLS needs to be directly on top of
+	 * the socket, buffering happens in the kernel instead. */
+	M_thread_mutex_lock(ctx->lock);
+	if (!M_tls_ctx_get_ktls(ctx->ctx))
+		M_io_add_buffer(io, NULL, 16 * 1024 * 1024, 16 * 1024 * 1024);
+	M_thread_mutex_unlock(ctx->lock);
 
 	callbacks = M_io_callbacks_create();
 	M_io_callbacks_reg_init(callbacks, M_io_tls_init_cb);
@@ -1342,6 +1667,14 @@ static M_bool M_io_tls_setup_server(M_io_layer_t *layer)
 	/* Initialize SSL handle */
 	handle->ssl = SSL_new(handle->serverctx->ctx);
 
+	handle->offload_pool = M_tls_serverctx_get_handshake_pool(handle->serverctx);
+	if (handle->offload_pool != NULL) {
+		handle->offload_lock = M_thread_mutex_create(M_THREAD_MUTEXATTR_NONE);
+		handle->offload_cond = M_thread_cond_create(M_THREAD_CONDATTR_NONE);
+		handle->offload_in   = M_buf_create();
+		handle->offload_out  = M_buf_create();
+	}
+
 	/* If DHE negotiation is enabled, set it up now */
 	if (handle->serverctx->dh) {
 		EVP_PKEY_up_ref(handle->serverctx->dh);
@@ -1380,8 +1713,12 @@ M_io_error_t M_io_tls_server_add(M_io_t *io, M_tls_serverctx_t *ctx, size_t *lay
 	M_io_callbacks_reg_init(callbacks, M_io_tls_init_cb);
 	if (M_io_get_type(io) == M_IO_TYPE_LISTENER) {
 		M_io_callbacks_reg_accept(callbacks, M_io_tls_accept_cb);
-		/* Add buffer layer to improve performance */
-		M_io_add_buffer(io, NULL, 16 * 1024 * 1024, 16 * 1024 * 1024);
+		/* Add buffer layer to improve performance. kTLS needs to be directly on top of
+		 * the socket, buffering happens in the kernel instead. */
+		M_thread_mutex_lock(ctx->lock);
+		if (!M_tls_ctx_get_ktls(ctx->ctx))
+			M_io_add_buffer(io, NULL, 16 * 1024 * 1024, 16 * 1024 * 1024);
+		M_thread_mutex_unlock(ctx->lock);
 	}
 	M_io_callbacks_reg_read(callbacks, M_io_tls_read_cb);
 	M_io_callbacks_reg_write(callbacks, M_io_tls_write_cb);
@@ -1680,3 +2017,67 @@ M_uint64 M_tls_get_negotiation_time_ms(M_io_t *io, size_t id)
 
 	return ret;
 }
+
+
+/* Query the BIOs the same way OpenSSL does when deciding whether records go to the kernel. */
+static M_tls_ktls_t M_io_tls_ktls_state(M_io_handle_t *handle)
+{
+	M_tls_ktls_t ktls = M_TLS_KTLS_NONE;
+
+#ifdef M_TLS_KTLS
+	if (handle->ssl == NULL)
+		return ktls;
+	if (BIO_get_ktls_send(SSL_get_wbio(handle->ssl)))
+		ktls |= M_TLS_KTLS_SEND;
+	if (BIO_get_ktls_recv(SSL_get_rbio(handle->ssl)))
+		ktls |= M_TLS_KTLS_RECV;
+#else
+	(void)handle;
+#endif
+
+	return ktls;
+}
+
+
+M_tls_ktls_t M_tls_get_ktls(M_io_t *io, size_t id)
+{
+	M_io_layer_t  *layer  = M_io_layer_acquire(io, id, "TLS");
+	M_io_handle_t *handle = M_io_layer_get_handle(layer);
+	M_tls_ktls_t   ret;
+
+	if (layer == NULL)
+		return M_TLS_KTLS_NONE;
+
+	ret = M_io_tls_ktls_state(handle);
+
+	M_io_layer_release(layer);
+
+	return ret;
+}
+
+
+M_io_error_t M_tls_sendfile(M_io_t *io, size_t id, int fd, M_uint64 offset, size_t len, size_t *len_written)
+{
+	M_io_layer_t  *layer  = M_io_layer_acquire(io, id, "TLS");
+	M_io_handle_t *handle = M_io_layer_get_handle(layer);
+	M_io_error_t   err;
+
+	if (len_written != NULL)
+		*len_written = 0;
+
+	if (layer == NULL)
+		return M_IO_ERROR_INVALID;
+
+	if (handle->state != M_TLS_STATE_CONNECTED) {
+		err = M_IO_ERROR_NOTCONNECTED;
+	} else if (!(M_io_tls_ktls_state(handle) & M_TLS_KTLS_SEND)) {
+		/* Data would go out unencrypted */
+		err = M_IO_ERROR_NOTIMPL;
+	} else {
+		err = M_io_net_sendfile(io, fd, offset, len, len_written);
+	}
+
+	M_io_layer_release(layer);
+
+	return err;
+}
@@ -34,7 +34,10 @@
 #include "m_tls_clientctx_int.h"
 
 
-/*! Used when destroying the hashtable */
+#define M_TLS_CLIENTCTX_SESSION_HOSTS    1024
+#define M_TLS_CLIENTCTX_SESSION_PER_HOST 4
+
+/*! Used when destroying the per host list */
 static void M_tls_clientctx_session_destroy(void *session)
 {
 	if (session != NULL)
@@ -42,6 +45,137 @@ static void M_tls_clientctx_session_destroy(void *session)
 }
 
 
+/*! Used when the cache drops a host, either because it was evicted, removed or the cache destroyed.
+ *  ctx->lock is always held when the cache is modified. */
+static void M_tls_clientctx_host_destroy(void *arg)
+{
+	M_tls_clientctx_host_t *host = arg;
+	size_t                  len;
+
+	if (host == NULL)
+		return;
+
+	/* Hosts are only removed explicitly once they're empty, so anything left
+	 * here is being evicted. */
+	len                            = M_llist_len(host->sessions);
+	host->ctx->sessions_cnt       -= len;
+	host->ctx->sessions_evictions += len;
+
+	M_llist_destroy(host->sessions, M_TRUE);
+	M_free(host);
+}
+
+
+static M_bool M_tls_clientctx_session_expired(SSL_SESSION *session, M_int64 now)
+{
+	return (M_int64)SSL_SESSION_get_time(session) + (M_int64)SSL_SESSION_get_timeout(session) <= now;
+}
+
+
+SSL_SESSION *M_tls_clientctx_session_take(M_tls_clientctx_t *ctx, const char *hostport)
+{
+	M_tls_clientctx_host_t *host;
+	SSL_SESSION            *session = NULL;
+	M_int64                 now     = M_time();
+
+	if (ctx == NULL || M_str_isempty(hostport))
+		return NULL;
+
+	M_thread_mutex_lock(ctx->lock);
+
+	host = M_cache_strvp_get_direct(ctx->sessions, hostport);
+	if (host != NULL) {
+		/* Newest is at the end and has the most lifetime left. */
+		while (session == NULL && M_llist_len(host->sessions) > 0) {
+			session = M_llist_take_node(M_llist_last(host->sessions));
+			ctx->sessions_cnt--;
+			if (M_tls_clientctx_session_expired(session, now)) {
+				SSL_SESSION_free(session);
+				session = NULL;
+				ctx->sessions_evictions++;
+			}
+		}
+
+		if (M_llist_len(host->sessions) == 0)
+			M_cache_strvp_remove(ctx->sessions, hostport);
+	}
+
+	if (session != NULL) {
+		ctx->sessions_hits++;
+	} else {
+		ctx->sessions_misses++;
+	}
+
+	M_thread_mutex_unlock(ctx->lock);
+	return session;
+}
+
+
+void M_tls_clientctx_session_store(M_tls_clientctx_t *ctx, const char *hostport, SSL_SESSION *session)
+{
+	struct M_llist_callbacks  cbs  = { NULL, NULL, NULL, M_tls_clientctx_session_destroy };
+	M_tls_clientctx_host_t   *host;
+
+	if (session == NULL)
+		return;
+
+	if (ctx == NULL || M_str_isempty(hostport)) {
+		SSL_SESSION_free(session);
+		return;
+	}
+
+	M_thread_mutex_lock(ctx->lock);
+
+	if (!ctx->sessions_enabled) {
+		M_thread_mutex_unlock(ctx->lock);
+		SSL_SESSION_free(session);
+		return;
+	}
+
+	host = M_cache_strvp_get_direct(ctx->sessions, hostport);
+	if (host == NULL) {
+		host           = M_malloc_zero(sizeof(*host));
+		host->ctx      = ctx;
+		host->sessions = M_llist_create(&cbs, M_LLIST_NONE);
+		/* If the cache is full the least recently used host will be evicted. */
+		M_cache_strvp_insert(ctx->sessions, hostport, host);
+	}
+
+	M_llist_insert(host->sessions, session);
+	ctx->sessions_cnt++;
+
+	while (M_llist_len(host->sessions) > ctx->sessions_per_host) {
+		M_llist_remove_node(M_llist_first(host->sessions));
+		ctx->sessions_cnt--;
+		ctx->sessions_evictions++;
+	}
+
+	M_thread_mutex_unlock(ctx->lock);
+}
+
+
+/*! OpenSSL new session callback. Called once the handshake completes for TLS <= 1.2
+ *  and whenever a ticket arrives post-handshake for TLS 1.3. The connection's
+ *  app data is the host:port the session belongs to. */
+static int M_tls_clientctx_session_new_cb(SSL *ssl, SSL_SESSION *session)
+{
+	M_tls_clientctx_t *ctx      = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+	const char        *hostport = SSL_get_app_data(ssl);
+
+#if OPENSSL_VERSION_NUMBER >= 0x1010100fL && !defined(LIBRESSL_VERSION_NUMBER)
+	if (!SSL_SESSION_is_resumable(session))
+		return 0;
+#endif
+
+	if (ctx == NULL || M_str_isempty(hostport))
+		return 0;
+
+	/* Returning 1 tells OpenSSL we've taken the reference. */
+	M_tls_clientctx_session_store(ctx, hostport, session);
+	return 1;
+}
+
+
 M_tls_clientctx_t *M_tls_clientctx_create(void)
 {
 	M_tls_clientctx_t *ctx;
@@ -56,8 +190,14 @@ M_tls_clientctx_t *M_tls_clientctx_create(void)
 	}
 	ctx->lock                   = M_thread_mutex_create(M_THREAD_MUTEXATTR_NONE);
 
-	/* Session support */
-	ctx->sessions               = M_hash_strvp_create(16, 75, M_HASH_STRVP_MULTI_VALUE, M_tls_clientctx_session_destroy);
+	/* Session support. Sessions are captured via callback as soon as OpenSSL
+	 * hands them to us so TLSv1.3 tickets sent after the handshake are not missed.
+	 * We keep our own store so it can be bounded and shared across connections. */
+	ctx->sessions               = M_cache_strvp_create(M_TLS_CLIENTCTX_SESSION_HOSTS, M_CACHE_STRVP_CASECMP, M_tls_clientctx_host_destroy);
+	ctx->sessions_per_host      = M_TLS_CLIENTCTX_SESSION_PER_HOST;
+	SSL_CTX_set_app_data(ctx->ctx, ctx);
+	SSL_CTX_set_session_cache_mode(ctx->ctx, SSL_SESS_CACHE_CLIENT|SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ctx->ctx, M_tls_clientctx_session_new_cb);
 
 	ctx->verify_level           = M_TLS_VERIFY_FULL;
 
@@ -83,7 +223,7 @@ M_bool M_tls_clientctx_upref(M_tls_clientctx_t *ctx)
 
 static void M_tls_clientctx_destroy_real(M_tls_clientctx_t *ctx)
 {
-	M_hash_strvp_destroy(ctx->sessions, M_TRUE);
+	M_cache_strvp_destroy(ctx->sessions);
 	M_tls_ctx_destroy(ctx->ctx);
 	/* Locked when we entered */
 	M_thread_mutex_unlock(ctx->lock);
@@ -349,6 +489,75 @@ M_bool M_tls_clientctx_set_session_resumption(M_tls_clientctx_t *ctx, M_bool ena
 	return M_TRUE;
 }
 
+M_bool M_tls_clientctx_set_session_cache_limits(M_tls_clientctx_t *ctx, size_t max_hosts, size_t max_per_host)
+{
+	if (ctx == NULL || max_hosts == 0 || max_per_host == 0)
+		return M_FALSE;
+
+	M_thread_mutex_lock(ctx->lock);
+	/* Shrinking evicts the least recently used hosts. */
+	M_cache_strvp_set_max_size(ctx->sessions, max_hosts);
+	/* Per host lists are trimmed lazily on the next store. */
+	ctx->sessions_per_host = max_per_host;
+	M_thread_mutex_unlock(ctx->lock);
+	return M_TRUE;
+}
+
+M_bool M_tls_clientctx_set_session_tickets(M_tls_clientctx_t *ctx, M_bool enable)
+{
+	if (ctx == NULL)
+		return M_FALSE;
+
+	M_thread_mutex_lock(ctx->lock);
+	if (enable) {
+		SSL_CTX_clear_options(ctx->ctx, SSL_OP_NO_TICKET);
+	} else {
+		SSL_CTX_set_options(ctx->ctx, SSL_OP_NO_TICKET);
+	}
+	M_thread_mutex_unlock(ctx->lock);
+	return M_TRUE;
+}
+
+M_bool M_tls_clientctx_set_ktls(M_tls_clientctx_t *ctx, M_bool enable)
+{
+	M_bool retval;
+
+	if (ctx == NULL)
+		return M_FALSE;
+
+	M_thread_mutex_lock(ctx->lock);
+	retval = M_tls_ctx_set_ktls(ctx->ctx, enable);
+	M_thread_mutex_unlock(ctx->lock);
+
+	return retval;
+}
+
+M_uint64 M_tls_clientctx_get_session_statistic(M_tls_clientctx_t *ctx, M_tls_session_statistic_t type)
+{
+	M_uint64 ret = 0;
+
+	if (ctx == NULL)
+		return 0;
+
+	M_thread_mutex_lock(ctx->lock);
+	switch (type) {
+		case M_TLS_SESSION_STATISTIC_HITS:
+			ret = ctx->sessions_hits;
+			break;
+		case M_TLS_SESSION_STATISTIC_MISSES:
+			ret = ctx->sessions_misses;
+			break;
+		case M_TLS_SESSION_STATISTIC_EVICTIONS:
+			ret = ctx->sessions_evictions;
+			break;
+		case M_TLS_SESSION_STATISTIC_STORED:
+			ret = ctx->sessions_cnt;
+			break;
+	}
+	M_thread_mutex_unlock(ctx->lock);
+	return ret;
+}
+
 char *M_tls_clientctx_get_cipherlist(M_tls_clientctx_t *ctx)
 {
 	char *ret = NULL;
@@ -30,10 +30,28 @@ struct M_tls_clientctx {
 	M_thread_mutex_t    *lock;                   /*!< Mutex to protect concurrent access                                 */
 	SSL_CTX             *ctx;                    /*!< OpenSSL's context                                                  */
 	size_t               ref_cnt;                /*!< Reference count to prevent destroy of CTX while connections active */
-	M_hash_strvp_t      *sessions;               /*!< Storage of session handles for future renegotiation                */
+	M_cache_strvp_t     *sessions;               /*!< host:port -> M_tls_clientctx_host_t, LRU bounded by host count     */
+	size_t               sessions_per_host;      /*!< Maximum number of sessions retained per host:port                  */
+	size_t               sessions_cnt;           /*!< Number of sessions currently stored across all hosts               */
+	M_uint64             sessions_hits;          /*!< Number of lookups that returned a session                          */
+	M_uint64             sessions_misses;        /*!< Number of lookups that did not return a session                    */
+	M_uint64             sessions_evictions;     /*!< Number of sessions dropped due to capacity limits or expiration    */
 	M_tls_verify_level_t verify_level;           /*!< Certificate verification level                                     */
 	M_bool               sessions_enabled;       /*!< Whether or not session resumption is desired                       */
 	M_uint64             negotiation_timeout_ms; /*!< Amount of time negotiation can take                                */
 };
 
+/*! Sessions stored for a single host:port */
+typedef struct {
+	M_tls_clientctx_t *ctx;      /*!< Owning context, used for accounting when evicted from the cache */
+	M_llist_t         *sessions; /*!< SSL_SESSION objects, oldest first                               */
+} M_tls_clientctx_host_t;
+
+/*! Take ownership of the newest usable session stored for host:port. Locks ctx.
+ *  Returns NULL if there is none. Caller must SSL_SESSION_free() the result. */
+SSL_SESSION *M_tls_clientctx_session_take(M_tls_clientctx_t *ctx, const char *hostport);
+
+/*! Store a session for host:port, taking ownership of the reference. Locks ctx. */
+void M_tls_clientctx_session_store(M_tls_clientctx_t *ctx, const char *hostport, SSL_SESSION *session);
+
 #endif
@@ -836,6 +836,33 @@ M_bool M_tls_ctx_set_trust_ca_dir(SSL_CTX *ctx, STACK_OF(X509) *trustlist_cache,
 }
 
 
+M_bool M_tls_ctx_set_ktls(SSL_CTX *ctx, M_bool enable)
+{
+#ifdef M_TLS_KTLS
+	if (enable) {
+		SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+	} else {
+		SSL_CTX_clear_options(ctx, SSL_OP_ENABLE_KTLS);
+	}
+	return M_TRUE;
+#else
+	(void)ctx;
+	return enable?M_FALSE:M_TRUE;
+#endif
+}
+
+
+M_bool M_tls_ctx_get_ktls(SSL_CTX *ctx)
+{
+#ifdef M_TLS_KTLS
+	return (SSL_CTX_get_options(ctx) & SSL_OP_ENABLE_KTLS)?M_TRUE:M_FALSE;
+#else
+	(void)ctx;
+	return M_FALSE;
+#endif
+}
+
+
 unsigned char *M_tls_alpn_list(M_list_str_t *apps, size_t *applen)
 {
 	M_buf_t      *buf    = M_buf_create();
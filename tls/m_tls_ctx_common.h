@@ -26,6 +26,29 @@
 
 #include <openssl/ssl.h>
 
+/* Kernel TLS offload requires Linux and an OpenSSL 3.x built with support for it. OpenSSL
+ * hands the keys to our BIO and has it send non application data records through BIO
+ * controls. OpenSSL 3.x doesn't export those in its public headers (bio.h only lists
+ * them in a comment) but their values are part of the BIO ABI and fixed for 3.x. Any
+ * other version has to export them. */
+#if defined(__linux__) && defined(HAVE_LINUX_TLS_H) && defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS) && \
+	!defined(LIBRESSL_VERSION_NUMBER) && defined(BIO_CTRL_GET_KTLS_SEND) && defined(BIO_CTRL_GET_KTLS_RECV)
+#  if OPENSSL_VERSION_NUMBER >= 0x30000000L && OPENSSL_VERSION_NUMBER < 0x40000000L
+#    ifndef BIO_CTRL_SET_KTLS
+#      define BIO_CTRL_SET_KTLS                  72
+#    endif
+#    ifndef BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG
+#      define BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG 74
+#    endif
+#    ifndef BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG
+#      define BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG    75
+#    endif
+#  endif
+#  if defined(BIO_CTRL_SET_KTLS) && defined(BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG) && defined(BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG)
+#    define M_TLS_KTLS 1
+#  endif
+#endif
+
 SSL_CTX *M_tls_ctx_init(M_bool is_server);
 
 /* Duplicates a server ctx, except for the server key/cert */
@@ -44,6 +67,9 @@ M_bool M_tls_ctx_set_trust_cert(SSL_CTX *ctx, STACK_OF(X509) *trustlist_cache, c
 M_bool M_tls_ctx_set_trust_cert_file(SSL_CTX *ctx, STACK_OF(X509) *trustlist_cache, const char *path);
 M_bool M_tls_ctx_set_trust_ca_dir(SSL_CTX *ctx, STACK_OF(X509) *trustlist_cache, const char *path, const char *pattern);
 char *M_tls_ctx_get_cipherlist(SSL_CTX *ctx);
+/*! Returns false if kTLS isn't supported by this build */
+M_bool M_tls_ctx_set_ktls(SSL_CTX *ctx, M_bool enable);
+M_bool M_tls_ctx_get_ktls(SSL_CTX *ctx);
 
 unsigned char *M_tls_alpn_list(M_list_str_t *apps, size_t *applen);
 
@@ -31,9 +31,12 @@
 #include <openssl/x509v3.h> /* For X509_check_host() */
 #include <openssl/pem.h>
 #include <openssl/err.h>
+#include <openssl/rand.h>
 #if OPENSSL_VERSION_NUMBER >= 0x3000000fL
 #  include <openssl/core_names.h>
 #  include <openssl/param_build.h>
+#else
+#  include <openssl/hmac.h>
 #endif
 #include "base/m_defs_int.h"
 #include "m_tls_serverctx_int.h"
@@ -247,6 +250,9 @@ M_tls_serverctx_t *M_tls_serverctx_create(const unsigned char *key, size_t key_l
 	SSL_CTX_set_tlsext_servername_callback(sslctx, M_tls_serverctx_sni_cb);
 	SSL_CTX_set_tlsext_servername_arg(sslctx, ctx);
 
+	/* Used by callbacks that don't take an argument (session tickets) */
+	SSL_CTX_set_app_data(sslctx, ctx);
+
 	M_tls_serverctx_set_session_support(sslctx, ctx->sessions_enabled);
 
 	return ctx;
@@ -315,6 +321,13 @@ M_bool M_tls_serverctx_SNI_ctx_add(M_tls_serverctx_t *ctx, M_tls_serverctx_t *ch
 	M_thread_mutex_lock(ctx->lock);
 	M_thread_mutex_lock(child->lock);
 
+	/* Tickets are always handled with the parent's key ring, the child's would never be used */
+	if (child->ticket_keys_cnt != 0) {
+		M_thread_mutex_unlock(child->lock);
+		M_thread_mutex_unlock(ctx->lock);
+		return M_FALSE;
+	}
+
 	child->parent = ctx;
 
 	if (ctx->children == NULL) {
@@ -481,6 +494,15 @@ static void M_tls_serverctx_destroy_real(M_tls_serverctx_t *ctx)
 		EVP_PKEY_free(ctx->dh);
 	M_list_destroy(ctx->children, M_TRUE);
 	M_free(ctx->alpn_apps);
+	if (ctx->ticket_keys != NULL) {
+		M_mem_set(ctx->ticket_keys, 0, ctx->ticket_keys_cnt * M_TLS_SERVERCTX_TICKET_KEY_LEN);
+		M_free(ctx->ticket_keys);
+	}
+	if (ctx->handshake_pool != NULL) {
+		/* Connections hold a reference so nothing should be outstanding. */
+		M_threadpool_parent_wait(ctx->handshake_pool);
+		M_threadpool_parent_destroy(ctx->handshake_pool);
+	}
 
 	/* Locked when entered */
 	M_thread_mutex_unlock(ctx->lock);
@@ -798,6 +820,209 @@ M_bool M_tls_serverctx_set_session_resumption(M_tls_serverctx_t *ctx, M_bool ena
 }
 
 
+/* Ticket key layout: 16 byte key name, 32 byte HMAC-SHA256 secret, 32 byte AES-256 key.
+ * This is the same layout nginx and others use for 80 byte ticket key files. */
+#define M_TLS_TICKET_NAME_LEN 16
+#define M_TLS_TICKET_HMAC_OFF 16
+#define M_TLS_TICKET_AES_OFF  48
+
+/*! Find the key to use for a ticket, copying it out so the lock isn't held during crypto.
+ *  Returns 1 if it's the current key, 2 if it's an older key (ticket should be renewed), 0 if not found. */
+static int M_tls_serverctx_ticket_key_get(SSL *ssl, const unsigned char *name, unsigned char *key)
+{
+	M_tls_serverctx_t *ctx = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+	size_t             i;
+	int                ret = 0;
+
+	if (ctx == NULL)
+		return 0;
+
+	/* SNI children share the parent's key ring. */
+	if (ctx->parent)
+		ctx = ctx->parent;
+
+	M_thread_mutex_lock(ctx->lock);
+	for (i=0; i<ctx->ticket_keys_cnt; i++) {
+		const unsigned char *k = ctx->ticket_keys + (i * M_TLS_SERVERCTX_TICKET_KEY_LEN);
+
+		/* Encryption always uses the current key. */
+		if (name == NULL || M_mem_eq(k, name, M_TLS_TICKET_NAME_LEN)) {
+			M_mem_copy(key, k, M_TLS_SERVERCTX_TICKET_KEY_LEN);
+			ret = (i == 0)?1:2;
+			break;
+		}
+	}
+	M_thread_mutex_unlock(ctx->lock);
+
+	return ret;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x3000000fL
+static int M_tls_serverctx_ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *cctx, EVP_MAC_CTX *hctx, int enc)
+#else
+static int M_tls_serverctx_ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *cctx, HMAC_CTX *hctx, int enc)
+#endif
+{
+	unsigned char key[M_TLS_SERVERCTX_TICKET_KEY_LEN];
+	int           ret;
+#if OPENSSL_VERSION_NUMBER >= 0x3000000fL
+	OSSL_PARAM    params[3];
+	char          digest[] = "SHA256";
+#endif
+
+	ret = M_tls_serverctx_ticket_key_get(ssl, enc?NULL:key_name, key);
+	if (ret == 0) {
+		/* Unknown key (or no keys when encrypting), client will do a full handshake. */
+		return enc?-1:0;
+	}
+
+	if (enc) {
+		if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+			ret = -1;
+			goto done;
+		}
+		M_mem_copy(key_name, key, M_TLS_TICKET_NAME_LEN);
+		if (EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key + M_TLS_TICKET_AES_OFF, iv) != 1) {
+			ret = -1;
+			goto done;
+		}
+	} else {
+		if (EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key + M_TLS_TICKET_AES_OFF, iv) != 1) {
+			ret = -1;
+			goto done;
+		}
+	}
+
+#if OPENSSL_VERSION_NUMBER >= 0x3000000fL
+	params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key + M_TLS_TICKET_HMAC_OFF, 32);
+	params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0);
+	params[2] = OSSL_PARAM_construct_end();
+	if (EVP_MAC_CTX_set_params(hctx, params) != 1)
+		ret = -1;
+#else
+	if (HMAC_Init_ex(hctx, key + M_TLS_TICKET_HMAC_OFF, 32, EVP_sha256(), NULL) != 1)
+		ret = -1;
+#endif
+
+done:
+	M_mem_set(key, 0, sizeof(key));
+	return ret;
+}
+
+
+/* Expects ctx to be locked. */
+static void M_tls_serverctx_set_ticket_cb(M_tls_serverctx_t *ctx)
+{
+	if (ctx->ticket_keys_cnt == 0) {
+		/* Revert to OpenSSL's internal per context keys. */
+#if OPENSSL_VERSION_NUMBER >= 0x3000000fL
+		SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx->ctx, NULL);
+#else
+		SSL_CTX_set_tlsext_ticket_key_cb(ctx->ctx, NULL);
+#endif
+		return;
+	}
+
+#if OPENSSL_VERSION_NUMBER >= 0x3000000fL
+	SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx->ctx, M_tls_serverctx_ticket_key_cb);
+#else
+	SSL_CTX_set_tlsext_ticket_key_cb(ctx->ctx, M_tls_serverctx_ticket_key_cb);
+#endif
+}
+
+
+M_bool M_tls_serverctx_set_ticket_keys(M_tls_serverctx_t *ctx, const unsigned char *keys, size_t keys_len)
+{
+	/* SNI children use the parent's key ring. */
+	if (ctx == NULL || ctx->parent || (keys == NULL && keys_len != 0) || keys_len % M_TLS_SERVERCTX_TICKET_KEY_LEN != 0)
+		return M_FALSE;
+
+	M_thread_mutex_lock(ctx->lock);
+
+	if (ctx->ticket_keys != NULL) {
+		M_mem_set(ctx->ticket_keys, 0, ctx->ticket_keys_cnt * M_TLS_SERVERCTX_TICKET_KEY_LEN);
+		M_free(ctx->ticket_keys);
+	}
+	ctx->ticket_keys     = NULL;
+	ctx->ticket_keys_cnt = 0;
+
+	if (keys_len != 0) {
+		ctx->ticket_keys     = M_memdup(keys, keys_len);
+		ctx->ticket_keys_cnt = keys_len / M_TLS_SERVERCTX_TICKET_KEY_LEN;
+	}
+
+	M_tls_serverctx_set_ticket_cb(ctx);
+
+	M_thread_mutex_unlock(ctx->lock);
+	return M_TRUE;
+}
+
+
+M_bool M_tls_serverctx_set_ticket_keys_file(M_tls_serverctx_t *ctx, const char *path)
+{
+	M_bool         retval;
+	unsigned char *keys = NULL;
+	size_t         len  = 0;
+
+	if (ctx == NULL || ctx->parent || M_str_isempty(path))
+		return M_FALSE;
+
+	if (M_fs_file_read_bytes(path, 0, &keys, &len) != M_FS_ERROR_SUCCESS)
+		return M_FALSE;
+
+	/* An empty file would disable our key ring which isn't what someone loading keys wants. */
+	retval = M_FALSE;
+	if (len != 0)
+		retval = M_tls_serverctx_set_ticket_keys(ctx, keys, len);
+
+	M_mem_set(keys, 0, len);
+	M_free(keys);
+	return retval;
+}
+
+
+M_bool M_tls_serverctx_rotate_ticket_key(M_tls_serverctx_t *ctx, const unsigned char *key, size_t key_len, size_t max_keys)
+{
+	unsigned char *keys;
+	size_t         cnt;
+
+	if (ctx == NULL || ctx->parent || (key != NULL && key_len != M_TLS_SERVERCTX_TICKET_KEY_LEN))
+		return M_FALSE;
+
+	if (max_keys == 0)
+		max_keys = 2;
+
+	M_thread_mutex_lock(ctx->lock);
+
+	cnt  = M_MIN(ctx->ticket_keys_cnt + 1, max_keys);
+	keys = M_malloc(cnt * M_TLS_SERVERCTX_TICKET_KEY_LEN);
+
+	if (key != NULL) {
+		M_mem_copy(keys, key, M_TLS_SERVERCTX_TICKET_KEY_LEN);
+	} else if (RAND_bytes(keys, M_TLS_SERVERCTX_TICKET_KEY_LEN) != 1) {
+		M_thread_mutex_unlock(ctx->lock);
+		M_free(keys);
+		return M_FALSE;
+	}
+
+	/* Previous keys are kept for decryption only, newest first. */
+	if (cnt > 1)
+		M_mem_copy(keys + M_TLS_SERVERCTX_TICKET_KEY_LEN, ctx->ticket_keys, (cnt - 1) * M_TLS_SERVERCTX_TICKET_KEY_LEN);
+
+	if (ctx->ticket_keys != NULL) {
+		M_mem_set(ctx->ticket_keys, 0, ctx->ticket_keys_cnt * M_TLS_SERVERCTX_TICKET_KEY_LEN);
+		M_free(ctx->ticket_keys);
+	}
+	ctx->ticket_keys     = keys;
+	ctx->ticket_keys_cnt = cnt;
+
+	M_tls_serverctx_set_ticket_cb(ctx);
+
+	M_thread_mutex_unlock(ctx->lock);
+	return M_TRUE;
+}
+
+
 M_bool M_tls_serverctx_set_negotiation_timeout_ms(M_tls_serverctx_t *ctx, M_uint64 timeout_ms)
 {
 	if (ctx == NULL || ctx->parent)
@@ -909,3 +1134,49 @@ M_bool M_tls_serverctx_set_dhparam_file(M_tls_serverctx_t *ctx, const char *dhpa
 }
 
 
+M_bool M_tls_serverctx_set_handshake_threadpool(M_tls_serverctx_t *ctx, M_threadpool_t *pool)
+{
+	if (ctx == NULL || pool == NULL)
+		return M_FALSE;
+
+	M_thread_mutex_lock(ctx->lock);
+	/* Connections reference the pool directly so it can't be swapped out. */
+	if (ctx->handshake_pool != NULL) {
+		M_thread_mutex_unlock(ctx->lock);
+		return M_FALSE;
+	}
+	ctx->handshake_pool = M_threadpool_parent_create(pool);
+	M_thread_mutex_unlock(ctx->lock);
+
+	return M_TRUE;
+}
+
+
+M_bool M_tls_serverctx_set_ktls(M_tls_serverctx_t *ctx, M_bool enable)
+{
+	M_bool retval;
+
+	if (ctx == NULL)
+		return M_FALSE;
+
+	M_thread_mutex_lock(ctx->lock);
+	retval = M_tls_ctx_set_ktls(ctx->ctx, enable);
+	M_thread_mutex_unlock(ctx->lock);
+
+	return retval;
+}
+
+
+M_threadpool_parent_t *M_tls_serverctx_get_handshake_pool(M_tls_serverctx_t *ctx)
+{
+	M_threadpool_parent_t *pool;
+
+	if (ctx == NULL)
+		return NULL;
+
+	M_thread_mutex_lock(ctx->lock);
+	pool = ctx->handshake_pool;
+	M_thread_mutex_unlock(ctx->lock);
+
+	return pool;
+}
@@ -41,8 +41,15 @@ struct M_tls_serverctx {
 	M_bool              sessions_enabled;       /*!< Whether or not to enable session resumption support                */
 	unsigned char      *alpn_apps;              /*!< ALPN supported applications                                        */
 	size_t              alpn_apps_len;          /*!< ALPN supported applications length                                 */
+	unsigned char      *ticket_keys;            /*!< Session ticket key ring, M_TLS_SERVERCTX_TICKET_KEY_LEN each,
+	                                                 first is used for encryption. NULL uses OpenSSL's internal keys    */
+	size_t              ticket_keys_cnt;        /*!< Number of keys in the ticket key ring                              */
+	M_threadpool_parent_t *handshake_pool;      /*!< If set, handshakes are performed on this pool                      */
 };
 
 void M_tls_serverctx_refcnt_decrement(M_tls_serverctx_t *ctx);
 
+/*! Thread pool to run handshakes on, or NULL if handshakes run on the event thread. Locks ctx. */
+M_threadpool_parent_t *M_tls_serverctx_get_handshake_pool(M_tls_serverctx_t *ctx);
+
 #endif